@@ -28,20 +28,53 @@ namespace absl_ports {
 // annotation checks.
 class ICING_LOCKABLE shared_mutex {
  public:
-  void lock() ICING_EXCLUSIVE_LOCK_FUNCTION() { m_.lock(); }
+  shared_mutex() = default;
+
+  // If prefer_writers is true, new readers are held off while a writer waits,
+  // so that a steady stream of overlapping readers can't starve writers.
+  // Readers must then never acquire the mutex recursively, since a writer that
+  // starts waiting in between would deadlock with them.
+  explicit shared_mutex(bool prefer_writers)
+      : prefer_writers_(prefer_writers) {}
+
+  void lock() ICING_EXCLUSIVE_LOCK_FUNCTION() {
+    if (prefer_writers_) {
+      std::lock_guard<std::mutex> gate_lock(writer_gate_);
+      m_.lock();
+      return;
+    }
+    m_.lock();
+  }
   bool try_lock() ICING_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
     return m_.try_lock();
   }
   void unlock() ICING_UNLOCK_FUNCTION() { m_.unlock(); }
 
-  void lock_shared() ICING_SHARED_LOCK_FUNCTION() { m_.lock_shared(); }
+  void lock_shared() ICING_SHARED_LOCK_FUNCTION() {
+    if (prefer_writers_) {
+      std::lock_guard<std::mutex> gate_lock(writer_gate_);
+    }
+    m_.lock_shared();
+  }
   bool try_lock_shared() ICING_SHARED_TRYLOCK_FUNCTION(true) {
+    if (prefer_writers_) {
+      if (!writer_gate_.try_lock()) {
+        return false;
+      }
+      writer_gate_.unlock();
+    }
     return m_.try_lock_shared();
   }
   void unlock_shared() ICING_UNLOCK_FUNCTION() { m_.unlock_shared(); }
 
  private:
   std::shared_mutex m_;
+
+  const bool prefer_writers_ = false;
+
+  // With prefer_writers_, held by writers while they wait for m_, and passed
+  // through by readers before they wait for it.
+  std::mutex writer_gate_;
 };
 
 // Simple wrapper around std::unique_lock with annotations to allow thread
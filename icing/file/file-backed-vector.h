@@ -244,6 +244,10 @@ class FileBackedVector {
   //   INTERNAL_ERROR on IO error
   libtextclassifier3::StatusOr<int64_t> GetElementsFileSize() const;
 
+  // Drops the mapped elements from memory. They are read back from the file
+  // when next accessed. Returns the number of bytes that were resident.
+  int64_t ReleaseCleanPages() { return mmapped_file_->ReleaseCleanPages(); }
+
   // Accessors.
   const T* array() const {
     return reinterpret_cast<const T*>(mmapped_file_->region());
@@ -272,8 +276,9 @@ class FileBackedVector {
   // Grow file by at least this many elements if array is growable.
   static constexpr int64_t kGrowElements = 1u << 14;  // 16K
 
-  // Max number of elements that can be held by the vector.
-  static constexpr int64_t kMaxNumElements = 1u << 20;  // 1M
+  // Max number of elements that can be held by the vector. This must be large
+  // enough to hold one element per valid DocumentId.
+  static constexpr int64_t kMaxNumElements = 1u << 24;  // 16M
 
   // Can only be created through the factory ::Create function
   FileBackedVector(const Filesystem& filesystem, const std::string& file_path,
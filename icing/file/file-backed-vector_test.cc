@@ -268,7 +268,7 @@ TEST_F(FileBackedVectorTest, IncrementalCrc_OverlappingChanges) {
 
 TEST_F(FileBackedVectorTest, Grow) {
   // This is the same value as FileBackedVector::kMaxNumElts
-  constexpr int32_t kMaxNumElts = 1U << 20;
+  constexpr int32_t kMaxNumElts = 1U << 24;
 
   ASSERT_TRUE(filesystem_.Truncate(fd_, 0));
 
@@ -30,6 +30,8 @@
 namespace icing {
 namespace lib {
 
+class InMemoryFileTree;
+
 // Closes fd when it goes out of scope, if fd >= 0.
 class ScopedFd {
  public:
@@ -232,6 +234,13 @@ class Filesystem {
 
   virtual int64_t SetPosition(int fd, int offset) const;
 
+  // Returns the InMemoryFileTree holding this filesystem's files, or nullptr if
+  // they live on disk. Components that still go through IcingFilesystem use
+  // this to reach the same files.
+  virtual std::shared_ptr<InMemoryFileTree> GetInMemoryFileTree() const {
+    return nullptr;
+  }
+
   // Increments to_increment by size if size is valid, or sets to_increment
   // to kBadFileSize if either size or to_increment is kBadFileSize.
   static void IncrementByOrSetInvalid(int64_t size, int64_t* to_increment);
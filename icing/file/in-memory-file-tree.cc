@@ -0,0 +1,328 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/file/in-memory-file-tree.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sys/syscall.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "icing/absl_ports/mutex.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/filesystem.h"
+#include "icing/legacy/core/icing-string-util.h"
+#include "icing/util/logging.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+// The size of the block for st_blocks returned by fstat().
+constexpr int kStatBlockSize = 512;
+
+// Creates an anonymous memory-backed file. Returns -1 and sets errno on
+// failure.
+int CreateMemfd(const std::string& name) {
+#if defined(__linux__) || defined(__ANDROID__)
+  // Not all libcs we build against expose memfd_create(), so go through the
+  // syscall directly. 1 is MFD_CLOEXEC.
+  return syscall(SYS_memfd_create, name.c_str(), 1u);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+// Returns true if any '/'-separated component of relative_path is in exclude.
+bool IsExcluded(std::string_view relative_path,
+                const std::unordered_set<std::string>& exclude) {
+  if (exclude.empty()) {
+    return false;
+  }
+  size_t start = 0;
+  while (start <= relative_path.length()) {
+    size_t end = relative_path.find('/', start);
+    if (end == std::string_view::npos) {
+      end = relative_path.length();
+    }
+    if (exclude.find(std::string(relative_path.substr(start, end - start))) !=
+        exclude.end()) {
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
+std::string DirectoryPrefix(const std::string& path) {
+  return path == "/" ? path : absl_ports::StrCat(path, "/");
+}
+
+}  // namespace
+
+std::string InMemoryFileTree::NormalizePath(std::string_view path) {
+  std::string normalized;
+  normalized.reserve(path.length());
+  for (char c : path) {
+    if (c == '/' && !normalized.empty() && normalized.back() == '/') {
+      continue;
+    }
+    normalized.push_back(c);
+  }
+  if (normalized.length() > 1 && normalized.back() == '/') {
+    normalized.pop_back();
+  }
+  return normalized;
+}
+
+bool InMemoryFileTree::ParentExists(const std::string& path) const {
+  size_t last_slash = path.find_last_of('/');
+  if (last_slash == std::string::npos || last_slash == 0) {
+    return true;
+  }
+  auto itr = nodes_.find(path.substr(0, last_slash));
+  return itr != nodes_.end() && itr->second.is_directory;
+}
+
+std::map<std::string, InMemoryFileTree::Node>::const_iterator
+InMemoryFileTree::DescendantsBegin(const std::string& path) const {
+  return nodes_.lower_bound(DirectoryPrefix(path));
+}
+
+std::map<std::string, InMemoryFileTree::Node>::const_iterator
+InMemoryFileTree::DescendantsEnd(const std::string& path) const {
+  // '0' is the character right after '/', so this is the first key that no
+  // longer starts with the directory prefix.
+  std::string end_key = DirectoryPrefix(path);
+  end_key.back() = '/' + 1;
+  return nodes_.lower_bound(end_key);
+}
+
+int InMemoryFileTree::Open(std::string_view path, int flags, bool create) {
+  std::string key = NormalizePath(path);
+  absl_ports::unique_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end()) {
+    if (!create || !ParentExists(key)) {
+      errno = ENOENT;
+      return -1;
+    }
+    int memfd = CreateMemfd(key);
+    if (memfd < 0) {
+      ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+          "Unable to create in-memory file %s: %s", key.c_str(),
+          strerror(errno));
+      return -1;
+    }
+    Node node;
+    node.memfd.reset(memfd);
+    itr = nodes_.emplace(key, std::move(node)).first;
+  } else if (itr->second.is_directory) {
+    errno = EISDIR;
+    return -1;
+  }
+
+  // Reopening through procfs, unlike dup(), gives the new fd its own open file
+  // description, so it gets its own file offset just like open(2) on a path.
+  std::string proc_path =
+      absl_ports::StrCat("/proc/self/fd/", std::to_string(*itr->second.memfd));
+  return open(proc_path.c_str(), flags);
+}
+
+bool InMemoryFileTree::FileExists(std::string_view path) const {
+  std::string key = NormalizePath(path);
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  return itr != nodes_.end() && !itr->second.is_directory;
+}
+
+bool InMemoryFileTree::DirectoryExists(std::string_view path) const {
+  std::string key = NormalizePath(path);
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  return itr != nodes_.end() && itr->second.is_directory;
+}
+
+bool InMemoryFileTree::CreateDirectory(std::string_view path) {
+  std::string key = NormalizePath(path);
+  absl_ports::unique_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr != nodes_.end()) {
+    return itr->second.is_directory;
+  }
+  if (!ParentExists(key)) {
+    errno = ENOENT;
+    return false;
+  }
+  Node node;
+  node.is_directory = true;
+  nodes_.emplace(std::move(key), std::move(node));
+  return true;
+}
+
+bool InMemoryFileTree::DeleteFile(std::string_view path) {
+  std::string key = NormalizePath(path);
+  absl_ports::unique_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end()) {
+    return true;
+  }
+  if (itr->second.is_directory) {
+    errno = EISDIR;
+    return false;
+  }
+  // Any fds or mappings still open on the file keep its memory alive, just
+  // like after unlink(2).
+  nodes_.erase(itr);
+  return true;
+}
+
+bool InMemoryFileTree::DeleteDirectory(std::string_view path, bool recursive) {
+  std::string key = NormalizePath(path);
+  absl_ports::unique_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end()) {
+    return true;
+  }
+  if (!itr->second.is_directory) {
+    errno = ENOTDIR;
+    return false;
+  }
+  auto begin = DescendantsBegin(key);
+  auto end = DescendantsEnd(key);
+  if (begin != end && !recursive) {
+    errno = ENOTEMPTY;
+    return false;
+  }
+  nodes_.erase(begin, end);
+  nodes_.erase(key);
+  return true;
+}
+
+bool InMemoryFileTree::ListDirectory(
+    std::string_view path, const std::unordered_set<std::string>& exclude,
+    bool recursive, std::vector<std::string>* entries) const {
+  std::string key = NormalizePath(path);
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end() || !itr->second.is_directory) {
+    errno = itr == nodes_.end() ? ENOENT : ENOTDIR;
+    return false;
+  }
+  size_t prefix_length = DirectoryPrefix(key).length();
+  for (auto child = DescendantsBegin(key); child != DescendantsEnd(key);
+       ++child) {
+    std::string_view relative_path =
+        std::string_view(child->first).substr(prefix_length);
+    if (!recursive && relative_path.find('/') != std::string_view::npos) {
+      continue;
+    }
+    if (IsExcluded(relative_path, exclude)) {
+      continue;
+    }
+    entries->push_back(std::string(relative_path));
+  }
+  return true;
+}
+
+bool InMemoryFileTree::Rename(std::string_view old_path,
+                              std::string_view new_path) {
+  std::string old_key = NormalizePath(old_path);
+  std::string new_key = NormalizePath(new_path);
+  absl_ports::unique_lock l(&mutex_);
+  if (nodes_.find(old_key) == nodes_.end()) {
+    errno = ENOENT;
+    return false;
+  }
+  if (old_key == new_key) {
+    return true;
+  }
+  if (!ParentExists(new_key)) {
+    errno = ENOENT;
+    return false;
+  }
+
+  // Replace whatever is at new_path.
+  nodes_.erase(DescendantsBegin(new_key), DescendantsEnd(new_key));
+  nodes_.erase(new_key);
+
+  // Move the node and everything under it.
+  std::vector<std::map<std::string, Node>::node_type> moved;
+  moved.push_back(nodes_.extract(old_key));
+  for (auto itr = DescendantsBegin(old_key); itr != DescendantsEnd(old_key);) {
+    moved.push_back(nodes_.extract(itr++));
+  }
+  for (auto& node : moved) {
+    node.key() = absl_ports::StrCat(
+        new_key, std::string_view(node.key()).substr(old_key.length()));
+    nodes_.insert(std::move(node));
+  }
+  return true;
+}
+
+int64_t InMemoryFileTree::GetFileSize(std::string_view path) const {
+  std::string key = NormalizePath(path);
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end() || itr->second.is_directory) {
+    return kBadFileSize;
+  }
+  struct stat st;
+  if (fstat(*itr->second.memfd, &st) < 0) {
+    return kBadFileSize;
+  }
+  return st.st_size;
+}
+
+int64_t InMemoryFileTree::GetMemoryUsage(std::string_view path,
+                                         bool recursive) const {
+  std::string key = NormalizePath(path);
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = nodes_.find(key);
+  if (itr == nodes_.end()) {
+    return kBadFileSize;
+  }
+  struct stat st;
+  if (!itr->second.is_directory) {
+    return fstat(*itr->second.memfd, &st) == 0 ? st.st_blocks * kStatBlockSize
+                                               : kBadFileSize;
+  }
+  int64_t usage = 0;
+  if (!recursive) {
+    return usage;
+  }
+  for (auto child = DescendantsBegin(key); child != DescendantsEnd(key);
+       ++child) {
+    if (!child->second.is_directory && fstat(*child->second.memfd, &st) == 0) {
+      usage += st.st_blocks * kStatBlockSize;
+    }
+  }
+  return usage;
+}
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,124 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A directory tree that lives entirely in anonymous memory.
+//
+// Every file is backed by a memfd, so the fds handed out by Open() are real
+// file descriptors. Reads, writes, ftruncate and mmap on them behave exactly
+// like they do on disk-backed files, but never touch storage. Only the
+// namespace (paths and directories) is emulated here.
+//
+// The tree owns the memory of all of its files. Everything is released when
+// the tree is destroyed and no fds or mappings to its files remain.
+//
+// This class is thread-safe.
+
+#ifndef ICING_FILE_IN_MEMORY_FILE_TREE_H_
+#define ICING_FILE_IN_MEMORY_FILE_TREE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "icing/absl_ports/mutex.h"
+#include "icing/absl_ports/thread_annotations.h"
+#include "icing/file/filesystem.h"
+
+namespace icing {
+namespace lib {
+
+class InMemoryFileTree {
+ public:
+  static constexpr int64_t kBadFileSize = -1;
+
+  InMemoryFileTree() = default;
+  InMemoryFileTree(const InMemoryFileTree&) = delete;
+  InMemoryFileTree& operator=(const InMemoryFileTree&) = delete;
+
+  // Opens a new fd on the file at path with the given open(2) flags. The new
+  // fd has its own file offset. If create is true and the file doesn't exist,
+  // it is created as long as its parent directory exists.
+  //
+  // Returns the fd on success, or -1 on failure.
+  int Open(std::string_view path, int flags, bool create);
+
+  bool FileExists(std::string_view path) const;
+  bool DirectoryExists(std::string_view path) const;
+
+  // Creates a directory if it does not yet exist. The parent directory must
+  // exist. Returns false if the parent is missing or path is a file.
+  bool CreateDirectory(std::string_view path);
+
+  // Deletes a file. Returns true on success or if it did not exist.
+  bool DeleteFile(std::string_view path);
+
+  // Deletes a directory and, if recursive, everything under it. A
+  // non-recursive delete fails on non-empty directories. Returns true on
+  // success or if it did not exist.
+  bool DeleteDirectory(std::string_view path, bool recursive);
+
+  // Lists the entries of a directory with the same semantics as
+  // Filesystem::ListDirectory. Entries are appended to entries.
+  bool ListDirectory(std::string_view path,
+                     const std::unordered_set<std::string>& exclude,
+                     bool recursive, std::vector<std::string>* entries) const;
+
+  // Renames a file or a directory, including everything under it. Anything
+  // already at new_path is replaced.
+  bool Rename(std::string_view old_path, std::string_view new_path);
+
+  // Returns the size of the file at path, or kBadFileSize if there is none.
+  int64_t GetFileSize(std::string_view path) const;
+
+  // Returns the memory used by the file at path, or by everything under it if
+  // it is a directory and recursive is true. Returns kBadFileSize if there is
+  // nothing at path.
+  int64_t GetMemoryUsage(std::string_view path, bool recursive) const;
+
+ private:
+  struct Node {
+    bool is_directory = false;
+    // The memfd owning the file contents. Invalid for directories.
+    ScopedFd memfd;
+  };
+
+  // Strips repeated and trailing slashes so that equivalent paths map to the
+  // same key.
+  static std::string NormalizePath(std::string_view path);
+
+  // Returns true if the parent of the normalized path exists. Top-level paths
+  // always have an existing parent.
+  bool ParentExists(const std::string& path) const
+      ICING_SHARED_LOCKS_REQUIRED(mutex_);
+
+  // Returns the range of nodes strictly under the normalized directory path.
+  std::map<std::string, Node>::const_iterator DescendantsBegin(
+      const std::string& path) const ICING_SHARED_LOCKS_REQUIRED(mutex_);
+  std::map<std::string, Node>::const_iterator DescendantsEnd(
+      const std::string& path) const ICING_SHARED_LOCKS_REQUIRED(mutex_);
+
+  mutable absl_ports::shared_mutex mutex_;
+
+  // All files and directories, keyed by normalized path. Being ordered keeps
+  // everything under a directory contiguous.
+  std::map<std::string, Node> nodes_ ICING_GUARDED_BY(mutex_);
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_FILE_IN_MEMORY_FILE_TREE_H_
@@ -0,0 +1,177 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/file/in-memory-filesystem.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/in-memory-file-tree.h"
+#include "icing/legacy/core/icing-string-util.h"
+#include "icing/util/logging.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+int64_t ToFilesystemSize(int64_t size) {
+  return size == InMemoryFileTree::kBadFileSize ? Filesystem::kBadFileSize
+                                                : size;
+}
+
+}  // namespace
+
+bool InMemoryFilesystem::DeleteFile(const char* file_name) const {
+  ICING_VLOG(1) << IcingStringUtil::StringPrintf("Deleting file %s", file_name);
+  if (!file_tree_->DeleteFile(file_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting file %s failed: %s", file_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool InMemoryFilesystem::DeleteDirectory(const char* dir_name) const {
+  if (!file_tree_->DeleteDirectory(dir_name, /*recursive=*/false)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool InMemoryFilesystem::DeleteDirectoryRecursively(
+    const char* dir_name) const {
+  if (!file_tree_->DeleteDirectory(dir_name, /*recursive=*/true)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool InMemoryFilesystem::CopyDirectory(const char* src_dir,
+                                       const char* dst_dir,
+                                       bool recursive) const {
+  std::vector<std::string> entries;
+  if (!file_tree_->ListDirectory(src_dir, /*exclude=*/{}, recursive,
+                                 &entries)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Unable to list directory %s: %s", src_dir, strerror(errno));
+    return false;
+  }
+  for (const std::string& entry : entries) {
+    std::string full_src_path = absl_ports::StrCat(src_dir, "/", entry);
+    // Directories are copied when writing a non-directory file, so no
+    // explicit copying of a directory is required.
+    if (!file_tree_->FileExists(full_src_path)) {
+      continue;
+    }
+    std::string full_dst_path = absl_ports::StrCat(dst_dir, "/", entry);
+    if (!CopyFile(full_src_path.c_str(), full_dst_path.c_str())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool InMemoryFilesystem::FileExists(const char* file_name) const {
+  return file_tree_->FileExists(file_name);
+}
+
+bool InMemoryFilesystem::DirectoryExists(const char* dir_name) const {
+  return file_tree_->DirectoryExists(dir_name);
+}
+
+bool InMemoryFilesystem::ListDirectory(
+    const char* dir_name, const std::unordered_set<std::string>& exclude,
+    bool recursive, std::vector<std::string>* entries) const {
+  if (!file_tree_->ListDirectory(dir_name, exclude, recursive, entries)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Unable to list directory %s: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int InMemoryFilesystem::OpenForWrite(const char* file_name) const {
+  int fd = file_tree_->Open(file_name, O_RDWR, /*create=*/true);
+  if (fd < 0) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Opening file %s for write failed: %s", file_name, strerror(errno));
+  }
+  return fd;
+}
+
+int InMemoryFilesystem::OpenForAppend(const char* file_name) const {
+  int fd = OpenForWrite(file_name);
+  if (fd >= 0) {
+    lseek(fd, 0, SEEK_END);
+  }
+  return fd;
+}
+
+int InMemoryFilesystem::OpenForRead(const char* file_name) const {
+  int fd = file_tree_->Open(file_name, O_RDONLY, /*create=*/false);
+  if (fd < 0) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Opening file %s for read failed: %s", file_name, strerror(errno));
+  }
+  return fd;
+}
+
+int64_t InMemoryFilesystem::GetFileSize(const char* filename) const {
+  return ToFilesystemSize(file_tree_->GetFileSize(filename));
+}
+
+bool InMemoryFilesystem::RenameFile(const char* old_name,
+                                    const char* new_name) const {
+  if (!file_tree_->Rename(old_name, new_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Unable to rename file %s to %s: %s", old_name, new_name,
+        strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool InMemoryFilesystem::CreateDirectory(const char* dir_name) const {
+  if (!file_tree_->CreateDirectory(dir_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Creating directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int64_t InMemoryFilesystem::GetFileDiskUsage(const char* path) const {
+  return ToFilesystemSize(
+      file_tree_->GetMemoryUsage(path, /*recursive=*/false));
+}
+
+int64_t InMemoryFilesystem::GetDiskUsage(const char* path) const {
+  return ToFilesystemSize(file_tree_->GetMemoryUsage(path, /*recursive=*/true));
+}
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,82 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_FILE_IN_MEMORY_FILESYSTEM_H_
+#define ICING_FILE_IN_MEMORY_FILESYSTEM_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "icing/file/filesystem.h"
+#include "icing/file/in-memory-file-tree.h"
+
+namespace icing {
+namespace lib {
+
+// A Filesystem whose files live in an InMemoryFileTree instead of on disk.
+//
+// All fd-based operations, including mmap through MemoryMappedFile, work
+// unchanged on the memfds handed out by the tree. DataSync is a no-op since
+// there is nothing to sync to.
+//
+// An IcingInMemoryFilesystem sharing the same tree sees the same files.
+class InMemoryFilesystem : public Filesystem {
+ public:
+  explicit InMemoryFilesystem(std::shared_ptr<InMemoryFileTree> file_tree)
+      : file_tree_(std::move(file_tree)) {}
+
+  bool DeleteFile(const char* file_name) const override;
+  bool DeleteDirectory(const char* dir_name) const override;
+  bool DeleteDirectoryRecursively(const char* dir_name) const override;
+  bool CopyDirectory(const char* src_dir, const char* dst_dir,
+                     bool recursive) const override;
+  bool FileExists(const char* file_name) const override;
+  bool DirectoryExists(const char* dir_name) const override;
+  bool ListDirectory(const char* dir_name,
+                     const std::unordered_set<std::string>& exclude,
+                     bool recursive,
+                     std::vector<std::string>* entries) const override;
+  int OpenForWrite(const char* file_name) const override;
+  int OpenForAppend(const char* file_name) const override;
+  int OpenForRead(const char* file_name) const override;
+  int64_t GetFileSize(int fd) const override {
+    return Filesystem::GetFileSize(fd);
+  }
+  int64_t GetFileSize(const char* filename) const override;
+  bool DataSync(int fd) const override { return true; }
+  bool RenameFile(const char* old_name, const char* new_name) const override;
+  bool CreateDirectory(const char* dir_name) const override;
+  int64_t GetDiskUsage(int fd) const override {
+    return Filesystem::GetDiskUsage(fd);
+  }
+  int64_t GetFileDiskUsage(const char* path) const override;
+  int64_t GetDiskUsage(const char* path) const override;
+  std::shared_ptr<InMemoryFileTree> GetInMemoryFileTree() const override {
+    return file_tree_;
+  }
+
+  // Pulls in the overloads that aren't overridden here.
+  using Filesystem::ListDirectory;
+
+ private:
+  std::shared_ptr<InMemoryFileTree> file_tree_;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_FILE_IN_MEMORY_FILESYSTEM_H_
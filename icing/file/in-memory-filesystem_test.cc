@@ -0,0 +1,240 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/file/in-memory-filesystem.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/in-memory-file-tree.h"
+#include "icing/legacy/index/icing-in-memory-filesystem.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+class InMemoryFilesystemTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    file_tree_ = std::make_shared<InMemoryFileTree>();
+    filesystem_ = std::make_unique<InMemoryFilesystem>(file_tree_);
+    // Deliberately a path that also exists on disk, to make sure nothing leaks
+    // through to the real filesystem.
+    base_dir_ = GetTestTempDir() + "/in_memory_filesystem_test";
+    ASSERT_TRUE(filesystem_->CreateDirectoryRecursively(base_dir_.c_str()));
+  }
+
+  std::shared_ptr<InMemoryFileTree> file_tree_;
+  std::unique_ptr<InMemoryFilesystem> filesystem_;
+  std::string base_dir_;
+};
+
+TEST_F(InMemoryFilesystemTest, NothingIsWrittenToDisk) {
+  std::string file = base_dir_ + "/file";
+  ScopedFd fd(filesystem_->OpenForWrite(file.c_str()));
+  ASSERT_TRUE(fd.is_valid());
+  ASSERT_TRUE(filesystem_->Write(fd.get(), "hello", 5));
+
+  EXPECT_TRUE(filesystem_->FileExists(file.c_str()));
+  Filesystem disk_filesystem;
+  EXPECT_FALSE(disk_filesystem.FileExists(file.c_str()));
+  EXPECT_FALSE(disk_filesystem.DirectoryExists(base_dir_.c_str()));
+}
+
+TEST_F(InMemoryFilesystemTest, OpenForReadMissingFileFails) {
+  std::string file = base_dir_ + "/missing";
+  EXPECT_THAT(filesystem_->OpenForRead(file.c_str()), Eq(-1));
+  EXPECT_FALSE(filesystem_->FileExists(file.c_str()));
+}
+
+TEST_F(InMemoryFilesystemTest, OpenForWriteRequiresParentDirectory) {
+  std::string file = base_dir_ + "/missing_dir/file";
+  EXPECT_THAT(filesystem_->OpenForWrite(file.c_str()), Eq(-1));
+}
+
+TEST_F(InMemoryFilesystemTest, FdsHaveIndependentOffsets) {
+  std::string file = base_dir_ + "/file";
+  ScopedFd write_fd(filesystem_->OpenForWrite(file.c_str()));
+  ASSERT_TRUE(filesystem_->Write(write_fd.get(), "abcdef", 6));
+
+  ScopedFd read_fd(filesystem_->OpenForRead(file.c_str()));
+  ASSERT_TRUE(read_fd.is_valid());
+  char buf[3];
+  ASSERT_TRUE(filesystem_->Read(read_fd.get(), buf, 3));
+  EXPECT_THAT(std::string(buf, 3), Eq("abc"));
+
+  // Reopening for write doesn't truncate and starts at the beginning.
+  ScopedFd rewrite_fd(filesystem_->OpenForWrite(file.c_str()));
+  EXPECT_THAT(filesystem_->GetCurrentPosition(rewrite_fd.get()), Eq(0));
+  EXPECT_THAT(filesystem_->GetFileSize(file.c_str()), Eq(6));
+
+  ScopedFd append_fd(filesystem_->OpenForAppend(file.c_str()));
+  EXPECT_THAT(filesystem_->GetCurrentPosition(append_fd.get()), Eq(6));
+}
+
+TEST_F(InMemoryFilesystemTest, MmapSeesWrites) {
+  std::string file = base_dir_ + "/file";
+  ScopedFd fd(filesystem_->OpenForWrite(file.c_str()));
+  ASSERT_TRUE(filesystem_->Grow(fd.get(), 4096));
+
+  void* mapped =
+      mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+  ASSERT_NE(mapped, MAP_FAILED);
+  memcpy(mapped, "mapped", 6);
+  munmap(mapped, 4096);
+
+  char buf[6];
+  ASSERT_TRUE(filesystem_->PRead(file.c_str(), buf, 6, 0));
+  EXPECT_THAT(std::string(buf, 6), Eq("mapped"));
+}
+
+TEST_F(InMemoryFilesystemTest, ListDirectory) {
+  std::string dir = base_dir_ + "/dir";
+  std::string sub_dir = dir + "/sub";
+  ASSERT_TRUE(filesystem_->CreateDirectoryRecursively(sub_dir.c_str()));
+  ASSERT_TRUE(filesystem_->Write((dir + "/a").c_str(), "a", 1));
+  ASSERT_TRUE(filesystem_->Write((sub_dir + "/b").c_str(), "b", 1));
+  // A sibling sharing the prefix must not show up.
+  ASSERT_TRUE(filesystem_->Write((base_dir_ + "/dir2").c_str(), "c", 1));
+
+  std::vector<std::string> entries;
+  ASSERT_TRUE(filesystem_->ListDirectory(dir.c_str(), &entries));
+  EXPECT_THAT(entries, UnorderedElementsAre("a", "sub"));
+
+  entries.clear();
+  ASSERT_TRUE(filesystem_->ListDirectory(dir.c_str(), /*exclude=*/{},
+                                         /*recursive=*/true, &entries));
+  EXPECT_THAT(entries, UnorderedElementsAre("a", "sub", "sub/b"));
+
+  entries.clear();
+  ASSERT_TRUE(filesystem_->ListDirectory(dir.c_str(), /*exclude=*/{"sub"},
+                                         /*recursive=*/true, &entries));
+  EXPECT_THAT(entries, ElementsAre("a"));
+}
+
+TEST_F(InMemoryFilesystemTest, DeleteDirectory) {
+  std::string dir = base_dir_ + "/dir";
+  ASSERT_TRUE(filesystem_->CreateDirectory(dir.c_str()));
+  ASSERT_TRUE(filesystem_->Write((dir + "/a").c_str(), "a", 1));
+
+  EXPECT_FALSE(filesystem_->DeleteDirectory(dir.c_str()));
+  EXPECT_TRUE(filesystem_->DeleteDirectoryRecursively(dir.c_str()));
+  EXPECT_FALSE(filesystem_->DirectoryExists(dir.c_str()));
+  EXPECT_FALSE(filesystem_->FileExists((dir + "/a").c_str()));
+  // Deleting something that doesn't exist succeeds.
+  EXPECT_TRUE(filesystem_->DeleteDirectoryRecursively(dir.c_str()));
+}
+
+TEST_F(InMemoryFilesystemTest, DeletedFileStaysReadableThroughOpenFd) {
+  std::string file = base_dir_ + "/file";
+  ASSERT_TRUE(filesystem_->Write(file.c_str(), "data", 4));
+  ScopedFd fd(filesystem_->OpenForRead(file.c_str()));
+
+  ASSERT_TRUE(filesystem_->DeleteFile(file.c_str()));
+  EXPECT_FALSE(filesystem_->FileExists(file.c_str()));
+
+  char buf[4];
+  ASSERT_TRUE(filesystem_->Read(fd.get(), buf, 4));
+  EXPECT_THAT(std::string(buf, 4), Eq("data"));
+}
+
+TEST_F(InMemoryFilesystemTest, SwapDirectories) {
+  std::string one = base_dir_ + "/one";
+  std::string two = base_dir_ + "/two";
+  ASSERT_TRUE(filesystem_->CreateDirectory(one.c_str()));
+  ASSERT_TRUE(filesystem_->CreateDirectory(two.c_str()));
+  ASSERT_TRUE(filesystem_->Write((one + "/file").c_str(), "1", 1));
+  ASSERT_TRUE(filesystem_->Write((two + "/file").c_str(), "22", 2));
+
+  ASSERT_TRUE(filesystem_->SwapFiles(one.c_str(), two.c_str()));
+  EXPECT_THAT(filesystem_->GetFileSize((one + "/file").c_str()), Eq(2));
+  EXPECT_THAT(filesystem_->GetFileSize((two + "/file").c_str()), Eq(1));
+  EXPECT_FALSE(filesystem_->DirectoryExists((one + ".tmp").c_str()));
+}
+
+TEST_F(InMemoryFilesystemTest, CopyDirectory) {
+  std::string src = base_dir_ + "/src";
+  std::string dst = base_dir_ + "/dst";
+  ASSERT_TRUE(filesystem_->CreateDirectoryRecursively((src + "/sub").c_str()));
+  ASSERT_TRUE(filesystem_->Write((src + "/a").c_str(), "a", 1));
+  ASSERT_TRUE(filesystem_->Write((src + "/sub/b").c_str(), "bb", 2));
+
+  ASSERT_TRUE(
+      filesystem_->CopyDirectory(src.c_str(), dst.c_str(), /*recursive=*/true));
+  EXPECT_THAT(filesystem_->GetFileSize((dst + "/a").c_str()), Eq(1));
+  EXPECT_THAT(filesystem_->GetFileSize((dst + "/sub/b").c_str()), Eq(2));
+}
+
+TEST_F(InMemoryFilesystemTest, MissingFileSizes) {
+  std::string file = base_dir_ + "/missing";
+  EXPECT_THAT(filesystem_->GetFileSize(file.c_str()),
+              Eq(Filesystem::kBadFileSize));
+  EXPECT_THAT(filesystem_->GetDiskUsage(file.c_str()),
+              Eq(Filesystem::kBadFileSize));
+}
+
+TEST_F(InMemoryFilesystemTest, DiskUsageCountsMemory) {
+  std::string dir = base_dir_ + "/dir";
+  ASSERT_TRUE(filesystem_->CreateDirectory(dir.c_str()));
+  EXPECT_THAT(filesystem_->GetDiskUsage(dir.c_str()), Eq(0));
+
+  std::string data(8192, 'x');
+  ASSERT_TRUE(filesystem_->Write((dir + "/a").c_str(), data.data(),
+                                 data.size()));
+  EXPECT_THAT(filesystem_->GetFileDiskUsage((dir + "/a").c_str()), Ge(8192));
+  EXPECT_THAT(filesystem_->GetDiskUsage(dir.c_str()), Ge(8192));
+}
+
+TEST_F(InMemoryFilesystemTest, SharedWithIcingInMemoryFilesystem) {
+  IcingInMemoryFilesystem icing_filesystem(file_tree_);
+  std::string file = base_dir_ + "/file";
+  ASSERT_TRUE(filesystem_->Write(file.c_str(), "data", 4));
+
+  EXPECT_TRUE(icing_filesystem.FileExists(file.c_str()));
+  EXPECT_THAT(icing_filesystem.GetFileSize(file.c_str()), Eq(4));
+
+  ASSERT_TRUE(icing_filesystem.DeleteFile(file.c_str()));
+  EXPECT_FALSE(filesystem_->FileExists(file.c_str()));
+  EXPECT_THAT(icing_filesystem.GetFileSize(file.c_str()),
+              Eq(IcingFilesystem::kBadFileSize));
+}
+
+TEST_F(InMemoryFilesystemTest, SeparateTreesAreIsolated) {
+  InMemoryFilesystem other_filesystem(std::make_shared<InMemoryFileTree>());
+  EXPECT_FALSE(other_filesystem.DirectoryExists(base_dir_.c_str()));
+
+  std::vector<std::string> entries;
+  ASSERT_TRUE(filesystem_->ListDirectory(base_dir_.c_str(), &entries));
+  EXPECT_THAT(entries, IsEmpty());
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -26,6 +26,7 @@
 #include "icing/file/filesystem.h"
 #include "icing/legacy/core/icing-string-util.h"
 #include "icing/util/math-util.h"
+#include "icing/util/page-util.h"
 
 namespace icing {
 namespace lib {
@@ -184,6 +185,14 @@ libtextclassifier3::Status MemoryMappedFile::OptimizeFor(
   return libtextclassifier3::Status::OK;
 }
 
+int64_t MemoryMappedFile::ReleaseCleanPages() {
+  if (mmap_result_ == nullptr ||
+      strategy_ == Strategy::READ_WRITE_MANUAL_SYNC) {
+    return 0;
+  }
+  return page_util::ReleasePages(mmap_result_, adjusted_mmap_size_);
+}
+
 void MemoryMappedFile::Swap(MemoryMappedFile* other) {
   std::swap(filesystem_, other->filesystem_);
   std::swap(file_path_, other->file_path_);
@@ -129,6 +129,14 @@ class MemoryMappedFile {
   };
   libtextclassifier3::Status OptimizeFor(AccessPattern access_pattern);
 
+  // Drops the pages of the mapped region from memory. They are read back from
+  // the file when next accessed. Returns the number of bytes that were
+  // resident.
+  //
+  // NOTE: Does nothing for READ_WRITE_MANUAL_SYNC, whose changes only live in
+  // memory until PersistToDisk() is called.
+  int64_t ReleaseCleanPages();
+
   // Accessors to the memory-mapped region. Returns null if nothing is mapped.
   const char* region() const { return region_; }
   char* mutable_region() { return region_; }
@@ -53,6 +53,7 @@
 #ifndef ICING_FILE_PORTABLE_FILE_BACKED_PROTO_LOG_H_
 #define ICING_FILE_PORTABLE_FILE_BACKED_PROTO_LOG_H_
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -325,6 +326,21 @@ class PortableFileBackedProtoLog {
   //   INTERNAL_ERROR on IO error
   libtextclassifier3::StatusOr<int64_t> WriteProto(const ProtoT& proto);
 
+  // Appends the record located at file_offset in other_log to this log as is,
+  // without decompressing, parsing or re-serializing the proto. Both logs must
+  // have the same compress option. Like with WriteProto, users do not need to
+  // sync the file after copying.
+  //
+  // Returns:
+  //   Offset of the newly appended proto in file on success
+  //   INVALID_ARGUMENT if the logs' compress options differ or if the stored
+  //     proto is too large for this log, as decided by Options.max_proto_size
+  //   NOT_FOUND if the proto at the given offset has been erased
+  //   OUT_OF_RANGE_ERROR if file_offset exceeds other_log's file size
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::StatusOr<int64_t> CopyRecordFrom(
+      const PortableFileBackedProtoLog& other_log, int64_t file_offset);
+
   // Reads out a proto located at file_offset from the file.
   //
   // Returns:
@@ -334,6 +350,28 @@ class PortableFileBackedProtoLog {
   //   INTERNAL_ERROR on IO error
   libtextclassifier3::StatusOr<ProtoT> ReadProto(int64_t file_offset) const;
 
+  // Same as above, but parses the proto into the given one, replacing its
+  // contents. This lets callers choose where the proto is allocated, e.g. on
+  // an arena.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if the proto at the given offset has been erased
+  //   OUT_OF_RANGE_ERROR if file_offset exceeds file size
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status ReadProto(int64_t file_offset,
+                                       ProtoT* proto) const;
+
+  // Reads the protos located at file_offsets into protos, which must hold as
+  // many. The log is mapped once for all of them rather than once per proto,
+  // which pays off most when file_offsets are sorted.
+  //
+  // Returns:
+  //   The status of reading each proto, as ReadProto would return it
+  std::vector<libtextclassifier3::Status> ReadProtos(
+      const std::vector<int64_t>& file_offsets,
+      const std::vector<ProtoT*>& protos) const;
+
   // Erases the data of a proto located at file_offset from the file.
   //
   // Returns:
@@ -342,6 +380,16 @@ class PortableFileBackedProtoLog {
   //   INTERNAL_ERROR on IO error
   libtextclassifier3::Status EraseProto(int64_t file_offset);
 
+  // Returns the number of bytes that the proto located at file_offset takes
+  // up in the file, including its metadata, whether it has been erased or not.
+  //
+  // Returns:
+  //   Size of the proto's record on success
+  //   OUT_OF_RANGE_ERROR if file_offset exceeds file size
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::StatusOr<int64_t> GetRecordSize(
+      int64_t file_offset) const;
+
   // Calculates and returns the disk usage in bytes. Rounds up to the nearest
   // block size.
   //
@@ -515,6 +563,28 @@ class PortableFileBackedProtoLog {
   static libtextclassifier3::StatusOr<int32_t> ReadProtoMetadata(
       MemoryMappedFile* mmapped_file, int64_t file_offset, int64_t file_size);
 
+  // Checks the magic number of a proto's host byte order metadata.
+  //
+  // Returns:
+  //   OK if the magic number is valid
+  //   INTERNAL_ERROR otherwise
+  static libtextclassifier3::Status CheckProtoMagic(
+      int32_t host_order_metadata);
+
+  // Parses the proto located at file_offset into proto. region must map the
+  // file from region_offset up to file_size.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if the proto at the given offset has been erased
+  //   OUT_OF_RANGE_ERROR if file_offset is outside of the region
+  //   INTERNAL_ERROR if the proto's metadata is invalid
+  libtextclassifier3::Status ParseProtoFromRegion(const char* region,
+                                                  int64_t region_offset,
+                                                  int64_t file_size,
+                                                  int64_t file_offset,
+                                                  ProtoT* proto) const;
+
   // Writes metadata of a proto to the fd. Takes in a host byte order endianness
   // metadata and converts it into a portable metadata before writing.
   //
@@ -929,9 +999,57 @@ PortableFileBackedProtoLog<ProtoT>::WriteProto(const ProtoT& proto) {
   return current_position;
 }
 
+template <typename ProtoT>
+libtextclassifier3::StatusOr<int64_t>
+PortableFileBackedProtoLog<ProtoT>::CopyRecordFrom(
+    const PortableFileBackedProtoLog& other_log, int64_t file_offset) {
+  if (other_log.header_->GetCompressFlag() != header_->GetCompressFlag()) {
+    return absl_ports::InvalidArgumentError(IcingStringUtil::StringPrintf(
+        "Inconsistent compress option, expected %d, actual %d",
+        header_->GetCompressFlag(), other_log.header_->GetCompressFlag()));
+  }
+
+  int64_t file_size = other_log.filesystem_->GetFileSize(other_log.fd_.get());
+  MemoryMappedFile mmapped_file(*other_log.filesystem_, other_log.file_path_,
+                                MemoryMappedFile::Strategy::READ_ONLY);
+  ICING_ASSIGN_OR_RETURN(
+      int32_t host_order_metadata,
+      ReadProtoMetadata(&mmapped_file, file_offset, file_size));
+  int stored_size = GetProtoSize(host_order_metadata);
+  if (stored_size > header_->GetMaxProtoSize()) {
+    return absl_ports::InvalidArgumentError(IcingStringUtil::StringPrintf(
+        "Stored proto size, %d, was greater than max_proto_size, %d",
+        stored_size, header_->GetMaxProtoSize()));
+  }
+
+  ICING_RETURN_IF_ERROR(mmapped_file.Remap(
+      file_offset + sizeof(host_order_metadata), stored_size));
+  if (IsEmptyBuffer(mmapped_file.region(), mmapped_file.region_size())) {
+    return absl_ports::NotFoundError("The proto data has been erased.");
+  }
+
+  int64_t current_position = filesystem_->GetCurrentPosition(fd_.get());
+  ICING_RETURN_IF_ERROR(
+      WriteProtoMetadata(filesystem_, fd_.get(), host_order_metadata));
+  if (!filesystem_->Write(fd_.get(), mmapped_file.region(), stored_size)) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to write proto to: ", file_path_));
+  }
+
+  return current_position;
+}
+
 template <typename ProtoT>
 libtextclassifier3::StatusOr<ProtoT>
 PortableFileBackedProtoLog<ProtoT>::ReadProto(int64_t file_offset) const {
+  ProtoT proto;
+  ICING_RETURN_IF_ERROR(ReadProto(file_offset, &proto));
+  return proto;
+}
+
+template <typename ProtoT>
+libtextclassifier3::Status PortableFileBackedProtoLog<ProtoT>::ReadProto(
+    int64_t file_offset, ProtoT* proto) const {
   int64_t file_size = filesystem_->GetFileSize(fd_.get());
   MemoryMappedFile mmapped_file(*filesystem_, file_path_,
                                 MemoryMappedFile::Strategy::READ_ONLY);
@@ -964,15 +1082,112 @@ PortableFileBackedProtoLog<ProtoT>::ReadProto(int64_t file_offset) const {
       mmapped_file.mutable_region(), stored_size);
 
   // Deserialize proto
-  ProtoT proto;
   if (header_->GetCompressFlag()) {
     google::protobuf::io::GzipInputStream decompress_stream(&proto_stream);
-    proto.ParseFromZeroCopyStream(&decompress_stream);
+    proto->ParseFromZeroCopyStream(&decompress_stream);
   } else {
-    proto.ParseFromZeroCopyStream(&proto_stream);
+    proto->ParseFromZeroCopyStream(&proto_stream);
   }
 
-  return proto;
+  return libtextclassifier3::Status::OK;
+}
+
+template <typename ProtoT>
+std::vector<libtextclassifier3::Status>
+PortableFileBackedProtoLog<ProtoT>::ReadProtos(
+    const std::vector<int64_t>& file_offsets,
+    const std::vector<ProtoT*>& protos) const {
+  std::vector<libtextclassifier3::Status> statuses;
+  statuses.reserve(file_offsets.size());
+  if (file_offsets.empty()) {
+    return statuses;
+  }
+
+  int64_t file_size = filesystem_->GetFileSize(fd_.get());
+  int64_t region_offset =
+      *std::min_element(file_offsets.begin(), file_offsets.end());
+  MemoryMappedFile mmapped_file(*filesystem_, file_path_,
+                                MemoryMappedFile::Strategy::READ_ONLY);
+  if (region_offset < 0 || region_offset >= file_size ||
+      !mmapped_file.Remap(region_offset, file_size - region_offset).ok()) {
+    // Mapping everything at once isn't possible, e.g. because some offset is
+    // invalid or there isn't enough address space. Read the protos one by one
+    // instead.
+    for (size_t i = 0; i < file_offsets.size(); ++i) {
+      statuses.push_back(ReadProto(file_offsets[i], protos[i]));
+    }
+    return statuses;
+  }
+
+  for (size_t i = 0; i < file_offsets.size(); ++i) {
+    statuses.push_back(ParseProtoFromRegion(mmapped_file.region(),
+                                            region_offset, file_size,
+                                            file_offsets[i], protos[i]));
+  }
+  return statuses;
+}
+
+template <typename ProtoT>
+libtextclassifier3::Status
+PortableFileBackedProtoLog<ProtoT>::ParseProtoFromRegion(
+    const char* region, int64_t region_offset, int64_t file_size,
+    int64_t file_offset, ProtoT* proto) const {
+  if (file_offset < region_offset || file_offset >= file_size) {
+    return absl_ports::OutOfRangeError(IcingStringUtil::StringPrintf(
+        "Trying to read from a location, %lld, out of range of the mapped "
+        "region [%lld, %lld)",
+        static_cast<long long>(file_offset),
+        static_cast<long long>(region_offset),
+        static_cast<long long>(file_size)));
+  }
+
+  int32_t portable_metadata;
+  int metadata_size = sizeof(portable_metadata);
+  if (file_offset + metadata_size >= file_size) {
+    return absl_ports::InternalError(IcingStringUtil::StringPrintf(
+        "Wrong metadata offset %lld, metadata doesn't fit in "
+        "with file range [0, %lld)",
+        static_cast<long long>(file_offset),
+        static_cast<long long>(file_size)));
+  }
+  const char* metadata_start = region + (file_offset - region_offset);
+  memcpy(&portable_metadata, metadata_start, metadata_size);
+  int32_t metadata = gntohl(portable_metadata);
+  ICING_RETURN_IF_ERROR(CheckProtoMagic(metadata));
+
+  int stored_size = GetProtoSize(metadata);
+  if (file_offset + metadata_size + stored_size > file_size) {
+    return absl_ports::InternalError(IcingStringUtil::StringPrintf(
+        "Proto of size %d at offset %lld doesn't fit in file range [0, %lld)",
+        stored_size, static_cast<long long>(file_offset),
+        static_cast<long long>(file_size)));
+  }
+  const char* proto_start = metadata_start + metadata_size;
+  if (IsEmptyBuffer(proto_start, stored_size)) {
+    return absl_ports::NotFoundError("The proto data has been erased.");
+  }
+
+  google::protobuf::io::ArrayInputStream proto_stream(proto_start,
+                                                      stored_size);
+  if (header_->GetCompressFlag()) {
+    google::protobuf::io::GzipInputStream decompress_stream(&proto_stream);
+    proto->ParseFromZeroCopyStream(&decompress_stream);
+  } else {
+    proto->ParseFromZeroCopyStream(&proto_stream);
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+template <typename ProtoT>
+libtextclassifier3::StatusOr<int64_t>
+PortableFileBackedProtoLog<ProtoT>::GetRecordSize(int64_t file_offset) const {
+  int64_t file_size = filesystem_->GetFileSize(fd_.get());
+  MemoryMappedFile mmapped_file(*filesystem_, file_path_,
+                                MemoryMappedFile::Strategy::READ_ONLY);
+  ICING_ASSIGN_OR_RETURN(
+      int32_t metadata,
+      ReadProtoMetadata(&mmapped_file, file_offset, file_size));
+  return sizeof(metadata) + GetProtoSize(metadata);
 }
 
 template <typename ProtoT>
@@ -1150,15 +1365,20 @@ PortableFileBackedProtoLog<ProtoT>::ReadProtoMetadata(
   // Need to switch it back to host order endianness after reading from disk.
   int32_t host_order_metadata = gntohl(portable_metadata);
 
-  // Checks magic number
+  ICING_RETURN_IF_ERROR(CheckProtoMagic(host_order_metadata));
+  return host_order_metadata;
+}
+
+template <typename ProtoT>
+libtextclassifier3::Status PortableFileBackedProtoLog<ProtoT>::CheckProtoMagic(
+    int32_t host_order_metadata) {
   uint8_t stored_k_proto_magic = GetProtoMagic(host_order_metadata);
   if (stored_k_proto_magic != kProtoMagic) {
     return absl_ports::InternalError(IcingStringUtil::StringPrintf(
         "Failed to read kProtoMagic, expected %d, actual %d", kProtoMagic,
         stored_k_proto_magic));
   }
-
-  return host_order_metadata;
+  return libtextclassifier3::Status::OK;
 }
 
 template <typename ProtoT>
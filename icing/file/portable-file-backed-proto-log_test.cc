@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -41,6 +42,7 @@ using ::testing::Not;
 using ::testing::NotNull;
 using ::testing::Pair;
 using ::testing::Return;
+using ::testing::SizeIs;
 
 using Header = PortableFileBackedProtoLog<DocumentProto>::Header;
 
@@ -969,6 +971,153 @@ TEST_F(PortableFileBackedProtoLogTest, EraseProtoShouldReturnNotFound) {
               IsOkAndHolds(EqualsProto(document2)));
 }
 
+TEST_F(PortableFileBackedProtoLogTest, GetRecordSizeOfErasedProto) {
+  DocumentProto document1 =
+      DocumentBuilder().SetKey("namespace", "uri1").Build();
+  DocumentProto document2 =
+      DocumentBuilder().SetKey("namespace", "uri2").Build();
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PortableFileBackedProtoLog<DocumentProto>::CreateResult create_result,
+      PortableFileBackedProtoLog<DocumentProto>::Create(
+          &filesystem_, file_path_,
+          PortableFileBackedProtoLog<DocumentProto>::Options(compress_,
+                                                             max_proto_size_)));
+  auto proto_log = std::move(create_result.proto_log);
+  ASSERT_FALSE(create_result.has_data_loss());
+
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document1_offset,
+                             proto_log->WriteProto(document1));
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document2_offset,
+                             proto_log->WriteProto(document2));
+
+  // Records are laid out back to back, and erasing keeps their size.
+  EXPECT_THAT(proto_log->GetRecordSize(document1_offset),
+              IsOkAndHolds(document2_offset - document1_offset));
+  ICING_ASSERT_OK(proto_log->EraseProto(document1_offset));
+  EXPECT_THAT(proto_log->GetRecordSize(document1_offset),
+              IsOkAndHolds(document2_offset - document1_offset));
+
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t elements_size,
+                             proto_log->GetElementsFileSize());
+  EXPECT_THAT(proto_log->GetRecordSize(document1_offset + elements_size),
+              StatusIs(libtextclassifier3::StatusCode::OUT_OF_RANGE));
+}
+
+TEST_F(PortableFileBackedProtoLogTest, CopyRecordFrom) {
+  DocumentProto document1 =
+      DocumentBuilder().SetKey("namespace", "uri1").Build();
+  DocumentProto document2 =
+      DocumentBuilder().SetKey("namespace", "uri2").Build();
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PortableFileBackedProtoLog<DocumentProto>::CreateResult create_result,
+      PortableFileBackedProtoLog<DocumentProto>::Create(
+          &filesystem_, file_path_,
+          PortableFileBackedProtoLog<DocumentProto>::Options(compress_,
+                                                             max_proto_size_)));
+  auto proto_log = std::move(create_result.proto_log);
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document1_offset,
+                             proto_log->WriteProto(document1));
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document2_offset,
+                             proto_log->WriteProto(document2));
+  ICING_ASSERT_OK(proto_log->EraseProto(document1_offset));
+
+  std::string copy_file_path = file_path_ + "_copy";
+  filesystem_.DeleteFile(copy_file_path.c_str());
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        PortableFileBackedProtoLog<DocumentProto>::CreateResult
+            copy_create_result,
+        PortableFileBackedProtoLog<DocumentProto>::Create(
+            &filesystem_, copy_file_path,
+            PortableFileBackedProtoLog<DocumentProto>::Options(
+                compress_, max_proto_size_)));
+    auto copy_log = std::move(copy_create_result.proto_log);
+
+    EXPECT_THAT(copy_log->CopyRecordFrom(*proto_log, document1_offset),
+                StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        int64_t copied_offset,
+        copy_log->CopyRecordFrom(*proto_log, document2_offset));
+    EXPECT_THAT(copy_log->ReadProto(copied_offset),
+                IsOkAndHolds(EqualsProto(document2)));
+    EXPECT_THAT(copy_log->GetRecordSize(copied_offset),
+                IsOkAndHolds(Eq(proto_log->GetRecordSize(document2_offset)
+                                    .ValueOrDie())));
+    ICING_EXPECT_OK(copy_log->PersistToDisk());
+  }
+
+  // The copied record is covered by the copy's checksum.
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        PortableFileBackedProtoLog<DocumentProto>::CreateResult
+            copy_create_result,
+        PortableFileBackedProtoLog<DocumentProto>::Create(
+            &filesystem_, copy_file_path,
+            PortableFileBackedProtoLog<DocumentProto>::Options(
+                compress_, max_proto_size_)));
+    EXPECT_FALSE(copy_create_result.has_data_loss());
+  }
+
+  // Records can't be copied between logs that compress differently.
+  filesystem_.DeleteFile(copy_file_path.c_str());
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        PortableFileBackedProtoLog<DocumentProto>::CreateResult
+            copy_create_result,
+        PortableFileBackedProtoLog<DocumentProto>::Create(
+            &filesystem_, copy_file_path,
+            PortableFileBackedProtoLog<DocumentProto>::Options(
+                !compress_, max_proto_size_)));
+    EXPECT_THAT(copy_create_result.proto_log->CopyRecordFrom(*proto_log,
+                                                             document2_offset),
+                StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+  }
+  filesystem_.DeleteFile(copy_file_path.c_str());
+}
+
+TEST_F(PortableFileBackedProtoLogTest, ReadProtosInAnyOrder) {
+  DocumentProto document1 =
+      DocumentBuilder().SetKey("namespace", "uri1").Build();
+  DocumentProto document2 =
+      DocumentBuilder().SetKey("namespace", "uri2").Build();
+  DocumentProto document3 =
+      DocumentBuilder().SetKey("namespace", "uri3").Build();
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PortableFileBackedProtoLog<DocumentProto>::CreateResult create_result,
+      PortableFileBackedProtoLog<DocumentProto>::Create(
+          &filesystem_, file_path_,
+          PortableFileBackedProtoLog<DocumentProto>::Options(compress_,
+                                                             max_proto_size_)));
+  auto proto_log = std::move(create_result.proto_log);
+  ASSERT_FALSE(create_result.has_data_loss());
+
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document1_offset,
+                             proto_log->WriteProto(document1));
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document2_offset,
+                             proto_log->WriteProto(document2));
+  ICING_ASSERT_OK_AND_ASSIGN(int64_t document3_offset,
+                             proto_log->WriteProto(document3));
+  ICING_ASSERT_OK(proto_log->EraseProto(document2_offset));
+
+  std::vector<DocumentProto> documents(4);
+  std::vector<libtextclassifier3::Status> statuses = proto_log->ReadProtos(
+      {document3_offset, document1_offset, document2_offset,
+       document3_offset + 1000000},
+      {&documents[0], &documents[1], &documents[2], &documents[3]});
+  ASSERT_THAT(statuses, SizeIs(4));
+  ICING_EXPECT_OK(statuses[0]);
+  EXPECT_THAT(documents[0], EqualsProto(document3));
+  ICING_EXPECT_OK(statuses[1]);
+  EXPECT_THAT(documents[1], EqualsProto(document1));
+  EXPECT_THAT(statuses[2],
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(statuses[3],
+              StatusIs(libtextclassifier3::StatusCode::OUT_OF_RANGE));
+}
+
 TEST_F(PortableFileBackedProtoLogTest, ChecksumShouldBeCorrectWithErasedProto) {
   DocumentProto document1 =
       DocumentBuilder().SetKey("namespace", "uri1").Build();
@@ -14,10 +14,14 @@
 
 #include "icing/icing-search-engine.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -30,11 +34,15 @@
 #include "icing/file/destructible-file.h"
 #include "icing/file/file-backed-proto.h"
 #include "icing/file/filesystem.h"
+#include "icing/file/in-memory-filesystem.h"
 #include "icing/index/hit/doc-hit-info.h"
 #include "icing/index/index-processor.h"
 #include "icing/index/index.h"
 #include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/index/main/segmented-main-index.h"
 #include "icing/legacy/index/icing-filesystem.h"
+#include "icing/legacy/index/icing-in-memory-filesystem.h"
+#include "icing/performance-calibrator.h"
 #include "icing/proto/document.pb.h"
 #include "icing/proto/initialize.pb.h"
 #include "icing/proto/internal/optimize.pb.h"
@@ -61,9 +69,11 @@
 #include "icing/tokenization/language-segmenter.h"
 #include "icing/transform/normalizer-factory.h"
 #include "icing/transform/normalizer.h"
+#include "icing/util/background-worker.h"
 #include "icing/util/clock.h"
 #include "icing/util/crc32.h"
 #include "icing/util/logging.h"
+#include "icing/util/operation-scheduler.h"
 #include "icing/util/status-macros.h"
 #include "icing/util/tokenized-document.h"
 #include "unicode/uloc.h"
@@ -78,6 +88,45 @@ constexpr std::string_view kIndexSubfolderName = "index_dir";
 constexpr std::string_view kSchemaSubfolderName = "schema_dir";
 constexpr std::string_view kSetSchemaMarkerFilename = "set_schema_marker";
 constexpr std::string_view kOptimizeStatusFilename = "optimize_status";
+constexpr std::string_view kDeviceProfileFilename = "device_profile";
+
+// Number of documents the background indexer indexes before letting other
+// calls in. Bounds how long a Put or Search waits behind it.
+constexpr int kAsyncIndexingBatchSize = 4;
+
+// Number of queries whose next page may be waiting to be prefetched. Bounds the
+// work queued up by clients that issue queries faster than they page.
+constexpr size_t kMaxPendingPrefetches = 8;
+
+// The maximum number of scans with more pages to hold on to. Clients are
+// expected to run few scans at once, so the oldest ones are evicted beyond
+// this.
+constexpr int kMaxNumScanStates = 16;
+
+// Applies the projections of result_spec to the documents.
+void ProjectDocuments(const GetResultSpecProto& result_spec,
+                      const std::vector<DocumentProto*>& documents) {
+  std::unordered_map<std::string, ProjectionTree> projection_tree_map;
+  for (const TypePropertyMask& type_field_mask :
+       result_spec.type_property_masks()) {
+    projection_tree_map.insert(
+        {type_field_mask.schema_type(), ProjectionTree(type_field_mask)});
+  }
+  if (projection_tree_map.empty()) {
+    return;
+  }
+  auto wildcard_projection_tree_itr = projection_tree_map.find(
+      std::string(ProjectionTree::kSchemaTypeWildcard));
+  for (DocumentProto* document : documents) {
+    auto itr = projection_tree_map.find(document->schema());
+    if (itr != projection_tree_map.end()) {
+      projector::Project(itr->second.root().children, document);
+    } else if (wildcard_projection_tree_itr != projection_tree_map.end()) {
+      projector::Project(wildcard_projection_tree_itr->second.root().children,
+                         document);
+    }
+  }
+}
 
 libtextclassifier3::Status ValidateOptions(
     const IcingSearchEngineOptions& options) {
@@ -88,6 +137,43 @@ libtextclassifier3::Status ValidateOptions(
     return absl_ports::InvalidArgumentError(
         "Options::max_tokens_per_doc must be greater than zero.");
   }
+  if ((options.has_max_query_length() && options.max_query_length() <= 0) ||
+      (options.has_num_to_score() && options.num_to_score() <= 0) ||
+      (options.has_max_num_total_hits() &&
+       options.max_num_total_hits() <= 0)) {
+    return absl_ports::InvalidArgumentError(
+        "Options::max_query_length, num_to_score and max_num_total_hits must "
+        "be greater than zero.");
+  }
+  if (options.champion_list_size() < 0) {
+    return absl_ports::InvalidArgumentError(
+        "Options::champion_list_size must not be negative.");
+  }
+  if (options.max_backfill_hits_per_merge() < -1) {
+    return absl_ports::InvalidArgumentError(
+        "Options::max_backfill_hits_per_merge must be at least -1.");
+  }
+  if (options.segmented_main_index() && options.champion_list_size() > 0) {
+    return absl_ports::InvalidArgumentError(
+        "Options::segmented_main_index can't be combined with champion "
+        "lists.");
+  }
+  if (options.num_namespace_partitions() < 0 ||
+      options.num_namespace_partitions() > Index::kMaxNamespacePartitions) {
+    return absl_ports::InvalidArgumentError(absl_ports::StrCat(
+        "Options::num_namespace_partitions must be in [0, ",
+        std::to_string(Index::kMaxNamespacePartitions), "]."));
+  }
+  if (options.num_namespace_partitions() > 0 &&
+      options.champion_list_size() > 0) {
+    return absl_ports::InvalidArgumentError(
+        "Options::num_namespace_partitions can't be combined with champion "
+        "lists.");
+  }
+  if (options.max_search_catch_up_documents() < -1) {
+    return absl_ports::InvalidArgumentError(
+        "Options::max_search_catch_up_documents must be at least -1.");
+  }
   return libtextclassifier3::Status::OK;
 }
 
@@ -238,12 +324,38 @@ void TransformStatus(const libtextclassifier3::Status& internal_status,
   status_proto->set_message(internal_status.error_message());
 }
 
+std::unique_ptr<const Filesystem> CreateFilesystem(
+    const std::shared_ptr<InMemoryFileTree>& file_tree) {
+  if (file_tree != nullptr) {
+    return std::make_unique<InMemoryFilesystem>(file_tree);
+  }
+  return std::make_unique<Filesystem>();
+}
+
+std::unique_ptr<const IcingFilesystem> CreateIcingFilesystem(
+    const std::shared_ptr<InMemoryFileTree>& file_tree) {
+  if (file_tree != nullptr) {
+    return std::make_unique<IcingInMemoryFilesystem>(file_tree);
+  }
+  return std::make_unique<IcingFilesystem>();
+}
+
 }  // namespace
 
 IcingSearchEngine::IcingSearchEngine(const IcingSearchEngineOptions& options,
                                      std::unique_ptr<const JniCache> jni_cache)
-    : IcingSearchEngine(options, std::make_unique<Filesystem>(),
-                        std::make_unique<IcingFilesystem>(),
+    : IcingSearchEngine(options,
+                        options.in_memory()
+                            ? std::make_shared<InMemoryFileTree>()
+                            : nullptr,
+                        std::move(jni_cache)) {}
+
+IcingSearchEngine::IcingSearchEngine(
+    const IcingSearchEngineOptions& options,
+    std::shared_ptr<InMemoryFileTree> file_tree,
+    std::unique_ptr<const JniCache> jni_cache)
+    : IcingSearchEngine(options, CreateFilesystem(file_tree),
+                        CreateIcingFilesystem(file_tree),
                         std::make_unique<Clock>(), std::move(jni_cache)) {}
 
 IcingSearchEngine::IcingSearchEngine(
@@ -255,11 +367,33 @@ IcingSearchEngine::IcingSearchEngine(
       filesystem_(std::move(filesystem)),
       icing_filesystem_(std::move(icing_filesystem)),
       clock_(std::move(clock)),
+      scheduler_(options_.enable_priority_scheduling()),
       jni_cache_(std::move(jni_cache)) {
   ICING_VLOG(1) << "Creating IcingSearchEngine in dir: " << options_.base_dir();
+  if (options_.enable_async_indexing()) {
+    indexing_worker_ = std::make_unique<BackgroundWorker>(
+        [this]() { return CatchUpIndex(); });
+  }
+  if (options_.segmented_main_index()) {
+    segment_compaction_worker_ = std::make_unique<BackgroundWorker>(
+        [this]() { return CompactIndexSegments(); });
+  }
 }
 
 IcingSearchEngine::~IcingSearchEngine() {
+  // Stop indexing before anything it depends on goes away. Whatever is left
+  // unindexed is picked up by the next Initialize().
+  indexing_worker_.reset();
+  segment_compaction_worker_.reset();
+  dead_term_collection_worker_.reset();
+  std::unique_ptr<BackgroundWorker> prefetch_worker;
+  {
+    // The worker can't be destroyed under prefetch_mutex_, which its task
+    // acquires.
+    absl_ports::unique_lock l(&prefetch_mutex_);
+    prefetch_worker = std::move(prefetch_worker_);
+  }
+  prefetch_worker.reset();
   if (initialized_) {
     if (PersistToDisk(PersistType::FULL).status().code() != StatusProto::OK) {
       ICING_LOG(ERROR)
@@ -272,6 +406,8 @@ InitializeResultProto IcingSearchEngine::Initialize() {
   // This method does both read and write so we need a writer lock. Using two
   // locks (reader and writer) has the chance to be interrupted during
   // switching.
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
   return InternalInitialize();
 }
@@ -309,6 +445,7 @@ libtextclassifier3::Status IcingSearchEngine::InitializeMembers(
     InitializeStatsProto* initialize_stats) {
   ICING_RETURN_ERROR_IF_NULL(initialize_stats);
   ICING_RETURN_IF_ERROR(InitializeOptions());
+  InitializePerformanceConfiguration();
   ICING_RETURN_IF_ERROR(InitializeSchemaStore(initialize_stats));
 
   // TODO(b/156383798) : Resolve how to specify the locale.
@@ -348,7 +485,7 @@ libtextclassifier3::Status IcingSearchEngine::InitializeMembers(
     // We're going to need to build the index from scratch. So just delete its
     // files now.
     const std::string index_dir = MakeIndexDirectoryPath(options_.base_dir());
-    Index::Options index_options(index_dir, options_.index_merge_size());
+    Index::Options index_options = CreateIndexOptions(index_dir);
     if (!filesystem_->DeleteDirectoryRecursively(index_dir.c_str()) ||
         !filesystem_->CreateDirectoryRecursively(index_dir.c_str())) {
       return absl_ports::InternalError(
@@ -387,6 +524,7 @@ libtextclassifier3::Status IcingSearchEngine::InitializeMembers(
 
   result_state_manager_ = std::make_unique<ResultStateManager>(
       performance_configuration_.max_num_total_hits, *document_store_);
+  scan_state_manager_ = std::make_unique<ScanStateManager>(kMaxNumScanStates);
 
   return status;
 }
@@ -403,6 +541,40 @@ libtextclassifier3::Status IcingSearchEngine::InitializeOptions() {
   return libtextclassifier3::Status::OK;
 }
 
+void IcingSearchEngine::InitializePerformanceConfiguration() {
+  PerformanceConfiguration configuration;
+  configuration.index_merge_size = options_.index_merge_size();
+  if (options_.enable_performance_calibration()) {
+    std::string profile_filename =
+        absl_ports::StrCat(options_.base_dir(), "/", kDeviceProfileFilename);
+    auto profile_or = performance_calibrator::GetOrCreateDeviceProfile(
+        *filesystem_, profile_filename, options_.base_dir(), *clock_);
+    if (profile_or.ok()) {
+      configuration =
+          PerformanceConfiguration::FromDeviceProfile(profile_or.ValueOrDie());
+      if (options_.has_index_merge_size()) {
+        configuration.index_merge_size = options_.index_merge_size();
+      }
+    } else {
+      // The defaults work on any device, so there's no reason to fail.
+      ICING_LOG(WARNING) << "Failed to calibrate, using default thresholds: "
+                         << profile_or.status().error_message();
+    }
+  }
+
+  // Explicitly set options always win.
+  if (options_.has_max_query_length()) {
+    configuration.max_query_length = options_.max_query_length();
+  }
+  if (options_.has_num_to_score()) {
+    configuration.num_to_score = options_.num_to_score();
+  }
+  if (options_.has_max_num_total_hits()) {
+    configuration.max_num_total_hits = options_.max_num_total_hits();
+  }
+  performance_configuration_ = configuration;
+}
+
 libtextclassifier3::Status IcingSearchEngine::InitializeSchemaStore(
     InitializeStatsProto* initialize_stats) {
   ICING_RETURN_ERROR_IF_NULL(initialize_stats);
@@ -443,6 +615,39 @@ libtextclassifier3::Status IcingSearchEngine::InitializeDocumentStore(
   return libtextclassifier3::Status::OK;
 }
 
+Index::Options IcingSearchEngine::CreateIndexOptions(
+    const std::string& index_dir) {
+  Index::Options index_options(index_dir,
+                               performance_configuration_.index_merge_size);
+  index_options.champion_list_size = options_.champion_list_size();
+  index_options.segmented_main_index = options_.segmented_main_index();
+  index_options.max_backfill_hits_per_merge =
+      options_.max_backfill_hits_per_merge();
+  index_options.num_namespace_partitions = options_.num_namespace_partitions();
+  index_options.front_coded_main_lexicon = options_.front_coded_main_lexicon();
+  index_options.get_document_score =
+      [this](DocumentId document_id) -> libtextclassifier3::StatusOr<int32_t> {
+    // Only called while merging the index, which holds mutex_.
+    ICING_ASSIGN_OR_RETURN(
+        DocumentAssociatedScoreData score_data,
+        document_store_->GetDocumentAssociatedScoreData(document_id));
+    return score_data.document_score();
+  };
+  return index_options;
+}
+
+bool IcingSearchEngine::IsIndexPartitionEmpty(NamespaceId namespace_id) {
+  int partition = index_->GetPartition(namespace_id);
+  for (const std::string& name_space : document_store_->GetAllNamespaces()) {
+    auto namespace_id_or = document_store_->GetNamespaceId(name_space);
+    if (!namespace_id_or.ok() ||
+        index_->GetPartition(namespace_id_or.ValueOrDie()) == partition) {
+      return false;
+    }
+  }
+  return true;
+}
+
 libtextclassifier3::Status IcingSearchEngine::InitializeIndex(
     InitializeStatsProto* initialize_stats) {
   ICING_RETURN_ERROR_IF_NULL(initialize_stats);
@@ -453,7 +658,7 @@ libtextclassifier3::Status IcingSearchEngine::InitializeIndex(
     return absl_ports::InternalError(
         absl_ports::StrCat("Could not create directory: ", index_dir));
   }
-  Index::Options index_options(index_dir, options_.index_merge_size());
+  Index::Options index_options = CreateIndexOptions(index_dir);
 
   InitializeStatsProto::RecoveryCause recovery_cause;
   auto index_or =
@@ -501,6 +706,8 @@ SetSchemaResultProto IcingSearchEngine::SetSchema(
   SetSchemaResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -545,6 +752,8 @@ SetSchemaResultProto IcingSearchEngine::SetSchema(
 
   libtextclassifier3::Status status;
   if (set_schema_result.success) {
+    // Documents may be deleted or have their properties reinterpreted.
+    result_state_manager_->InvalidatePrefetchedResults();
     if (lost_previous_schema) {
       // No previous schema to calculate a diff against. We have to go through
       // and revalidate all the Documents in the DocumentStore
@@ -596,6 +805,8 @@ GetSchemaResultProto IcingSearchEngine::GetSchema() {
   GetSchemaResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -619,6 +830,8 @@ GetSchemaTypeResultProto IcingSearchEngine::GetSchemaType(
   GetSchemaTypeResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -642,6 +855,11 @@ PutResultProto IcingSearchEngine::Put(const DocumentProto& document) {
 }
 
 PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
+  return Put(std::move(document), OperationPriority::kInteractiveWrite);
+}
+
+PutResultProto IcingSearchEngine::Put(DocumentProto&& document,
+                                      OperationPriority priority) {
   ICING_VLOG(1) << "Writing document to document store";
 
   std::unique_ptr<Timer> put_timer = clock_->GetNewTimer();
@@ -651,10 +869,15 @@ PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
   PutDocumentStatsProto* put_document_stats =
       result_proto.mutable_put_document_stats();
 
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
   // Lock must be acquired before validation because the DocumentStore uses
   // the schema file to validate, and the schema could be changed in
   // SetSchema() which is protected by the same mutex.
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(priority, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  put_document_stats->set_queue_wait_latency_ms(
+      queue_wait_timer->GetElapsedMilliseconds());
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -662,6 +885,24 @@ PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
     return result_proto;
   }
 
+  if (indexing_worker_ != nullptr) {
+    // Tokenizing takes about as long as indexing, so leave both to the
+    // background. The document store still validates the document, and
+    // indexing_worker_ fills in its length in tokens once it's tokenized.
+    result_state_manager_->InvalidatePrefetchedResults();
+    auto document_id_or = document_store_->Put(
+        std::move(document), /*num_tokens=*/0, put_document_stats);
+    if (!document_id_or.ok()) {
+      TransformStatus(document_id_or.status(), result_status);
+      put_document_stats->set_latency_ms(put_timer->GetElapsedMilliseconds());
+      return result_proto;
+    }
+    indexing_worker_->Notify();
+    result_status->set_code(StatusProto::OK);
+    put_document_stats->set_latency_ms(put_timer->GetElapsedMilliseconds());
+    return result_proto;
+  }
+
   auto tokenized_document_or = TokenizedDocument::Create(
       schema_store_.get(), language_segmenter_.get(), std::move(document));
   if (!tokenized_document_or.ok()) {
@@ -672,6 +913,8 @@ PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
   TokenizedDocument tokenized_document(
       std::move(tokenized_document_or).ValueOrDie());
 
+  // The put may replace a document that a prefetched page refers to.
+  result_state_manager_->InvalidatePrefetchedResults();
   auto document_id_or =
       document_store_->Put(tokenized_document.document(),
                            tokenized_document.num_tokens(), put_document_stats);
@@ -681,6 +924,13 @@ PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
     return result_proto;
   }
   DocumentId document_id = document_id_or.ValueOrDie();
+  auto namespace_id_or = document_store_->GetNamespaceId(
+      tokenized_document.document().namespace_());
+  if (!namespace_id_or.ok()) {
+    TransformStatus(namespace_id_or.status(), result_status);
+    put_document_stats->set_latency_ms(put_timer->GetElapsedMilliseconds());
+    return result_proto;
+  }
 
   auto index_processor_or = IndexProcessor::Create(
       normalizer_.get(), index_.get(), CreateIndexProcessorOptions(options_),
@@ -693,8 +943,10 @@ PutResultProto IcingSearchEngine::Put(DocumentProto&& document) {
   std::unique_ptr<IndexProcessor> index_processor =
       std::move(index_processor_or).ValueOrDie();
 
-  auto status = index_processor->IndexDocument(tokenized_document, document_id,
-                                               put_document_stats);
+  auto status = index_processor->IndexDocument(
+      tokenized_document, document_id, namespace_id_or.ValueOrDie(),
+      put_document_stats);
+  ScheduleSegmentCompaction();
 
   TransformStatus(status, result_status);
   put_document_stats->set_latency_ms(put_timer->GetElapsedMilliseconds());
@@ -707,6 +959,8 @@ GetResultProto IcingSearchEngine::Get(const std::string_view name_space,
   GetResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -746,11 +1000,97 @@ GetResultProto IcingSearchEngine::Get(const std::string_view name_space,
   return result_proto;
 }
 
+BatchGetResultProto IcingSearchEngine::BatchGet(
+    const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+    const GetResultSpecProto& result_spec) {
+  BatchGetResultProto result_proto;
+  StatusProto* result_status = result_proto.mutable_status();
+
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return result_proto;
+  }
+
+  std::vector<DocumentProto*> documents;
+  documents.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    documents.push_back(result_proto.add_results()->mutable_document());
+  }
+
+  std::vector<libtextclassifier3::Status> statuses =
+      document_store_->BatchGet(keys, documents);
+  std::vector<DocumentProto*> found_documents;
+  found_documents.reserve(documents.size());
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    GetResultProto* get_result_proto = result_proto.mutable_results(i);
+    if (!statuses[i].ok()) {
+      TransformStatus(statuses[i], get_result_proto->mutable_status());
+      get_result_proto->clear_document();
+      continue;
+    }
+    found_documents.push_back(documents[i]);
+    get_result_proto->mutable_status()->set_code(StatusProto::OK);
+  }
+  ProjectDocuments(result_spec, found_documents);
+
+  result_status->set_code(StatusProto::OK);
+  return result_proto;
+}
+
+GetByUriPrefixResultProto IcingSearchEngine::GetByUriPrefix(
+    std::string_view name_space, std::string_view uri_prefix,
+    const GetResultSpecProto& result_spec) {
+  GetByUriPrefixResultProto result_proto;
+  StatusProto* result_status = result_proto.mutable_status();
+
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return result_proto;
+  }
+
+  std::vector<DocumentId> document_ids =
+      document_store_->GetDocumentIdsByUriPrefix(name_space, uri_prefix);
+  std::vector<DocumentProto*> documents;
+  documents.reserve(document_ids.size());
+  for (size_t i = 0; i < document_ids.size(); ++i) {
+    documents.push_back(result_proto.add_documents());
+  }
+
+  std::vector<libtextclassifier3::Status> statuses =
+      document_store_->BatchGet(document_ids, documents);
+  for (const libtextclassifier3::Status& status : statuses) {
+    if (!status.ok()) {
+      // The documents were all found to exist above, so this is a real error.
+      ICING_LOG(ERROR) << status.error_message()
+                       << "Failed to get documents with uri prefix: "
+                       << uri_prefix;
+      TransformStatus(status, result_status);
+      result_proto.clear_documents();
+      return result_proto;
+    }
+  }
+
+  ProjectDocuments(result_spec, documents);
+
+  result_status->set_code(StatusProto::OK);
+  return result_proto;
+}
+
 ReportUsageResultProto IcingSearchEngine::ReportUsage(
     const UsageReport& usage_report) {
   ReportUsageResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -768,6 +1108,8 @@ GetAllNamespacesResultProto IcingSearchEngine::GetAllNamespaces() {
   GetAllNamespacesResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -792,7 +1134,11 @@ DeleteResultProto IcingSearchEngine::Delete(const std::string_view name_space,
   DeleteResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -800,11 +1146,13 @@ DeleteResultProto IcingSearchEngine::Delete(const std::string_view name_space,
   }
 
   DeleteStatsProto* delete_stats = result_proto.mutable_delete_stats();
+  delete_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   delete_stats->set_delete_type(DeleteStatsProto::DeleteType::SINGLE);
 
   std::unique_ptr<Timer> delete_timer = clock_->GetNewTimer();
   // TODO(b/144458732): Implement a more robust version of TC_RETURN_IF_ERROR
   // that can support error logging.
+  result_state_manager_->InvalidatePrefetchedResults();
   libtextclassifier3::Status status = document_store_->Delete(name_space, uri);
   if (!status.ok()) {
     ICING_LOG(ERROR) << status.error_message()
@@ -826,7 +1174,11 @@ DeleteByNamespaceResultProto IcingSearchEngine::DeleteByNamespace(
 
   DeleteByNamespaceResultProto delete_result;
   StatusProto* result_status = delete_result.mutable_status();
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -834,11 +1186,14 @@ DeleteByNamespaceResultProto IcingSearchEngine::DeleteByNamespace(
   }
 
   DeleteStatsProto* delete_stats = delete_result.mutable_delete_stats();
+  delete_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   delete_stats->set_delete_type(DeleteStatsProto::DeleteType::NAMESPACE);
 
   std::unique_ptr<Timer> delete_timer = clock_->GetNewTimer();
   // TODO(b/144458732): Implement a more robust version of TC_RETURN_IF_ERROR
   // that can support error logging.
+  result_state_manager_->InvalidatePrefetchedResults();
+  auto namespace_id_or = document_store_->GetNamespaceId(name_space);
   DocumentStore::DeleteByGroupResult doc_store_result =
       document_store_->DeleteByNamespace(name_space);
   if (!doc_store_result.status.ok()) {
@@ -848,6 +1203,26 @@ DeleteByNamespaceResultProto IcingSearchEngine::DeleteByNamespace(
     return delete_result;
   }
 
+  // If no other namespace with documents left shares the partition of the
+  // namespace, drop the partition instead of looking for dead terms.
+  bool partition_reset = false;
+  if (index_->is_partitioned() && namespace_id_or.ok() &&
+      IsIndexPartitionEmpty(namespace_id_or.ValueOrDie())) {
+    libtextclassifier3::Status status =
+        index_->ResetPartition(namespace_id_or.ValueOrDie());
+    if (status.ok()) {
+      partition_reset = true;
+    } else {
+      ICING_LOG(WARNING) << "Failed to reset index partition: "
+                         << status.error_message();
+    }
+  }
+  if (!partition_reset && doc_store_result.num_docs_deleted > 0) {
+    // Deleting a whole namespace usually leaves terms behind that no other
+    // document has.
+    ScheduleDeadIndexTermCollection();
+  }
+
   result_status->set_code(StatusProto::OK);
   delete_stats->set_latency_ms(delete_timer->GetElapsedMilliseconds());
   delete_stats->set_num_documents_deleted(doc_store_result.num_docs_deleted);
@@ -860,7 +1235,11 @@ DeleteBySchemaTypeResultProto IcingSearchEngine::DeleteBySchemaType(
 
   DeleteBySchemaTypeResultProto delete_result;
   StatusProto* result_status = delete_result.mutable_status();
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -868,11 +1247,13 @@ DeleteBySchemaTypeResultProto IcingSearchEngine::DeleteBySchemaType(
   }
 
   DeleteStatsProto* delete_stats = delete_result.mutable_delete_stats();
+  delete_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   delete_stats->set_delete_type(DeleteStatsProto::DeleteType::SCHEMA_TYPE);
 
   std::unique_ptr<Timer> delete_timer = clock_->GetNewTimer();
   // TODO(b/144458732): Implement a more robust version of TC_RETURN_IF_ERROR
   // that can support error logging.
+  result_state_manager_->InvalidatePrefetchedResults();
   DocumentStore::DeleteByGroupResult doc_store_result =
       document_store_->DeleteBySchemaType(schema_type);
   if (!doc_store_result.status.ok()) {
@@ -882,6 +1263,56 @@ DeleteBySchemaTypeResultProto IcingSearchEngine::DeleteBySchemaType(
     return delete_result;
   }
 
+  if (doc_store_result.num_docs_deleted > 0) {
+    // Deleting a whole schema type usually leaves terms behind that no other
+    // document has.
+    ScheduleDeadIndexTermCollection();
+  }
+
+  result_status->set_code(StatusProto::OK);
+  delete_stats->set_latency_ms(delete_timer->GetElapsedMilliseconds());
+  delete_stats->set_num_documents_deleted(doc_store_result.num_docs_deleted);
+  return delete_result;
+}
+
+DeleteByUriPrefixResultProto IcingSearchEngine::DeleteByUriPrefix(
+    const std::string_view name_space, const std::string_view uri_prefix) {
+  ICING_VLOG(1) << "Deleting uri prefix from doc store";
+
+  DeleteByUriPrefixResultProto delete_result;
+  StatusProto* result_status = delete_result.mutable_status();
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
+  absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return delete_result;
+  }
+
+  DeleteStatsProto* delete_stats = delete_result.mutable_delete_stats();
+  delete_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
+  delete_stats->set_delete_type(DeleteStatsProto::DeleteType::URI_PREFIX);
+
+  std::unique_ptr<Timer> delete_timer = clock_->GetNewTimer();
+  result_state_manager_->InvalidatePrefetchedResults();
+  DocumentStore::DeleteByGroupResult doc_store_result =
+      document_store_->DeleteByUriPrefix(name_space, uri_prefix);
+  if (!doc_store_result.status.ok()) {
+    ICING_LOG(ERROR) << doc_store_result.status.error_message()
+                     << "Failed to delete uri prefix: " << uri_prefix;
+    TransformStatus(doc_store_result.status, result_status);
+    return delete_result;
+  }
+
+  if (doc_store_result.num_docs_deleted > 0) {
+    // The documents under a uri prefix often share terms that no other
+    // document has.
+    ScheduleDeadIndexTermCollection();
+  }
+
   result_status->set_code(StatusProto::OK);
   delete_stats->set_latency_ms(delete_timer->GetElapsedMilliseconds());
   delete_stats->set_num_documents_deleted(doc_store_result.num_docs_deleted);
@@ -896,7 +1327,11 @@ DeleteByQueryResultProto IcingSearchEngine::DeleteByQuery(
   DeleteByQueryResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -904,6 +1339,7 @@ DeleteByQueryResultProto IcingSearchEngine::DeleteByQuery(
   }
 
   DeleteStatsProto* delete_stats = result_proto.mutable_delete_stats();
+  delete_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   delete_stats->set_delete_type(DeleteStatsProto::DeleteType::QUERY);
 
 
@@ -915,6 +1351,15 @@ DeleteByQueryResultProto IcingSearchEngine::DeleteByQuery(
     return result_proto;
   }
 
+  // Documents that were put but not indexed yet must be deleted too, so all of
+  // them are indexed first, regardless of max_search_catch_up_documents.
+  IndexRestorationResult catch_up_result = RestoreIndexIfNeeded();
+  if (!catch_up_result.status.ok() &&
+      !absl_ports::IsDataLoss(catch_up_result.status)) {
+    TransformStatus(catch_up_result.status, result_status);
+    return result_proto;
+  }
+
   // Gets unordered results from query processor
   auto query_processor_or = QueryProcessor::Create(
       index_.get(), language_segmenter_.get(), normalizer_.get(),
@@ -936,6 +1381,7 @@ DeleteByQueryResultProto IcingSearchEngine::DeleteByQuery(
 
   ICING_VLOG(2) << "Deleting the docs that matched the query.";
   int num_deleted = 0;
+  result_state_manager_->InvalidatePrefetchedResults();
 
   while (query_results.root_iterator->Advance().ok()) {
     ICING_VLOG(3) << "Deleting doc "
@@ -968,6 +1414,8 @@ PersistToDiskResultProto IcingSearchEngine::PersistToDisk(
   PersistToDiskResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -975,11 +1423,62 @@ PersistToDiskResultProto IcingSearchEngine::PersistToDisk(
     return result_proto;
   }
 
+  if (options_.in_memory()) {
+    // Nothing outlives the engine in memory, so there is nothing to persist.
+    result_status->set_code(StatusProto::OK);
+    return result_proto;
+  }
+
   auto status = InternalPersistToDisk(persist_type);
   TransformStatus(status, result_status);
   return result_proto;
 }
 
+TrimMemoryResultProto IcingSearchEngine::TrimMemory(
+    TrimMemoryLevel::Code level) {
+  ICING_VLOG(1) << "Trimming memory at level " << level;
+
+  TrimMemoryResultProto result_proto;
+  StatusProto* result_status = result_proto.mutable_status();
+
+  if (level == TrimMemoryLevel::UNKNOWN) {
+    result_status->set_code(StatusProto::INVALID_ARGUMENT);
+    result_status->set_message("TrimMemoryLevel must be specified.");
+    return result_proto;
+  }
+
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
+  absl_ports::unique_lock l(&mutex_);
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return result_proto;
+  }
+
+  result_proto.set_released_cache_bytes(normalizer_->ReleaseCaches() +
+                                        index_->ReleaseInMemoryFreeLists());
+
+  if (level >= TrimMemoryLevel::MODERATE) {
+    // Dropping pages of files that only live in memory frees nothing.
+    if (!options_.in_memory()) {
+      result_proto.set_released_mapped_bytes(
+          document_store_->ReleaseCleanPages() + index_->ReleaseCleanPages());
+    }
+
+    // Keep the most recent query, which is the one most likely to be paged
+    // through still.
+    int num_states_to_keep = level >= TrimMemoryLevel::CRITICAL ? 0 : 1;
+    int num_released_hits =
+        result_state_manager_->InvalidateOldestResultStates(num_states_to_keep);
+    result_proto.set_released_result_state_bytes(
+        static_cast<int64_t>(num_released_hits) * sizeof(ScoredDocumentHit));
+  }
+
+  result_status->set_code(StatusProto::OK);
+  return result_proto;
+}
+
 // Optimizes Icing's storage
 //
 // Steps:
@@ -992,7 +1491,11 @@ OptimizeResultProto IcingSearchEngine::Optimize() {
   OptimizeResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
@@ -1001,6 +1504,7 @@ OptimizeResultProto IcingSearchEngine::Optimize() {
 
   std::unique_ptr<Timer> optimize_timer = clock_->GetNewTimer();
   OptimizeStatsProto* optimize_stats = result_proto.mutable_optimize_stats();
+  optimize_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   int64_t before_size = filesystem_->GetDiskUsage(options_.base_dir().c_str());
   if (before_size != Filesystem::kBadFileSize) {
     optimize_stats->set_storage_size_before(before_size);
@@ -1049,6 +1553,8 @@ OptimizeResultProto IcingSearchEngine::Optimize() {
   IndexRestorationResult index_restoration_status = RestoreIndexIfNeeded();
   optimize_stats->set_index_restoration_latency_ms(
       optimize_index_timer->GetElapsedMilliseconds());
+  // The rebuilt index only has the terms of the remaining documents.
+  has_dead_index_terms_ = false;
   // DATA_LOSS means that we have successfully re-added content to the index.
   // Some indexed content was lost, but otherwise the index is in a valid state
   // and can be queried.
@@ -1102,6 +1608,8 @@ GetOptimizeInfoResultProto IcingSearchEngine::GetOptimizeInfo() {
   GetOptimizeInfoResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
@@ -1138,6 +1646,7 @@ GetOptimizeInfoResultProto IcingSearchEngine::GetOptimizeInfo() {
   if (doc_store_optimize_info.optimizable_docs == 0) {
     // Can return early since there's nothing to calculate on the index side
     result_proto.set_estimated_optimizable_bytes(0);
+    result_proto.set_estimated_index_optimizable_bytes(0);
     result_status->set_code(StatusProto::OK);
     return result_proto;
   }
@@ -1150,10 +1659,23 @@ GetOptimizeInfoResultProto IcingSearchEngine::GetOptimizeInfo() {
   }
   int64_t index_elements_size = index_elements_size_or.ValueOrDie();
 
+  // The hits of a document take up space in proportion to its number of
+  // tokens. Fall back to the share of documents if there are no token counts.
+  int64_t index_optimizable_bytes;
+  if (doc_store_optimize_info.total_tokens > 0) {
+    index_optimizable_bytes = index_elements_size *
+                              doc_store_optimize_info.optimizable_tokens /
+                              doc_store_optimize_info.total_tokens;
+  } else {
+    index_optimizable_bytes = index_elements_size *
+                              doc_store_optimize_info.optimizable_docs /
+                              doc_store_optimize_info.total_docs;
+  }
+
   // Sum up the optimizable sizes from DocumentStore and Index
+  result_proto.set_estimated_index_optimizable_bytes(index_optimizable_bytes);
   result_proto.set_estimated_optimizable_bytes(
-      index_elements_size * doc_store_optimize_info.optimizable_docs /
-          doc_store_optimize_info.total_docs +
+      index_optimizable_bytes +
       doc_store_optimize_info.estimated_optimizable_bytes);
 
   result_status->set_code(StatusProto::OK);
@@ -1162,6 +1684,8 @@ GetOptimizeInfoResultProto IcingSearchEngine::GetOptimizeInfo() {
 
 StorageInfoResultProto IcingSearchEngine::GetStorageInfo() {
   StorageInfoResultProto result;
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     result.mutable_status()->set_code(StatusProto::FAILED_PRECONDITION);
@@ -1202,28 +1726,83 @@ SearchResultProto IcingSearchEngine::Search(
     const SearchSpecProto& search_spec, const ScoringSpecProto& scoring_spec,
     const ResultSpecProto& result_spec) {
   SearchResultProto result_proto;
-  StatusProto* result_status = result_proto.mutable_status();
-  // TODO(b/146008613) Explore ideas to make this function read-only.
-  absl_ports::unique_lock l(&mutex_);
+  Search(search_spec, scoring_spec, result_spec, &result_proto);
+  return result_proto;
+}
+
+void IcingSearchEngine::Search(const SearchSpecProto& search_spec,
+                               const ScoringSpecProto& scoring_spec,
+                               const ResultSpecProto& result_spec,
+                               SearchResultProto* result_proto) {
+  StatusProto* result_status = result_proto->mutable_status();
+  int64_t queue_wait_latency_ms = 0;
+  bool has_pending_documents = false;
+  if (indexing_worker_ != nullptr &&
+      options_.max_search_catch_up_documents() != 0) {
+    // Most of the time indexing_worker_ has already caught up, so check that
+    // with a shared lock first rather than queueing every query behind
+    // writers.
+    std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+    OperationScheduler::Admission admission = scheduler_.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    absl_ports::shared_lock l(&mutex_);
+    queue_wait_latency_ms += queue_wait_timer->GetElapsedMilliseconds();
+    has_pending_documents = initialized_ &&
+                            index_->last_added_document_id() !=
+                                document_store_->last_added_document_id();
+  }
+  if (has_pending_documents) {
+    // Documents that were put but not indexed yet should still be visible to
+    // this query, so catch up on up to max_search_catch_up_documents of them
+    // first. The rest are left to indexing_worker_. Unlike the query itself,
+    // that writes to the index, so it needs mutex_ exclusively.
+    std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+    OperationScheduler::Admission admission = scheduler_.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/true);
+    absl_ports::unique_lock l(&mutex_);
+    queue_wait_latency_ms += queue_wait_timer->GetElapsedMilliseconds();
+    if (initialized_) {
+      int max_num_documents = options_.max_search_catch_up_documents() < 0
+                                  ? std::numeric_limits<int>::max()
+                                  : options_.max_search_catch_up_documents();
+      IndexRestorationResult catch_up_result =
+          RestoreIndexIfNeeded(max_num_documents);
+      if (!catch_up_result.status.ok()) {
+        ICING_LOG(WARNING)
+            << "Failed to index pending documents before search: "
+            << catch_up_result.status.error_message();
+      }
+    }
+  }
+
+  // Queries only read the stores and the index, so they run alongside each
+  // other and other readers, and only wait for writers. Puts that land in
+  // between are left to indexing_worker_, like any put after this call.
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  queue_wait_latency_ms += queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
-    return result_proto;
+    return;
   }
 
-  QueryStatsProto* query_stats = result_proto.mutable_query_stats();
+  QueryStatsProto* query_stats = result_proto->mutable_query_stats();
+  query_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   query_stats->set_query_length(search_spec.query().length());
   std::unique_ptr<Timer> overall_timer = clock_->GetNewTimer();
 
   libtextclassifier3::Status status = ValidateResultSpec(result_spec);
   if (!status.ok()) {
     TransformStatus(status, result_status);
-    return result_proto;
+    return;
   }
   status = ValidateSearchSpec(search_spec, performance_configuration_);
   if (!status.ok()) {
     TransformStatus(status, result_status);
-    return result_proto;
+    return;
   }
 
   query_stats->set_num_namespaces_filtered(
@@ -1241,15 +1820,24 @@ SearchResultProto IcingSearchEngine::Search(
       document_store_.get(), schema_store_.get());
   if (!query_processor_or.ok()) {
     TransformStatus(query_processor_or.status(), result_status);
-    return result_proto;
+    return;
   }
   std::unique_ptr<QueryProcessor> query_processor =
       std::move(query_processor_or).ValueOrDie();
 
-  auto query_results_or = query_processor->ParseSearch(search_spec);
+  // The results of queries ranked by descending document score can be taken
+  // from the champion lists until they run out.
+  bool use_champion_lists =
+      options_.champion_list_size() > 0 &&
+      scoring_spec.rank_by() ==
+          ScoringSpecProto::RankingStrategy::DOCUMENT_SCORE &&
+      scoring_spec.order_by() == ScoringSpecProto::Order::DESC;
+  auto query_results_or = query_processor->ParseSearch(
+      search_spec, use_champion_lists ? Index::HitScope::kChampions
+                                      : Index::HitScope::kAll);
   if (!query_results_or.ok()) {
     TransformStatus(query_results_or.status(), result_status);
-    return result_proto;
+    return;
   }
   QueryProcessor::QueryResults query_results =
       std::move(query_results_or).ValueOrDie();
@@ -1269,7 +1857,7 @@ SearchResultProto IcingSearchEngine::Search(
           ScoringProcessor::Create(scoring_spec, document_store_.get());
   if (!scoring_processor_or.ok()) {
     TransformStatus(scoring_processor_or.status(), result_status);
-    return result_proto;
+    return;
   }
   std::unique_ptr<ScoringProcessor> scoring_processor =
       std::move(scoring_processor_or).ValueOrDie();
@@ -1281,21 +1869,70 @@ SearchResultProto IcingSearchEngine::Search(
       component_timer->GetElapsedMilliseconds());
   query_stats->set_num_documents_scored(result_document_hits.size());
 
+  std::optional<ChampionRank> champion_threshold =
+      query_results.champion_threshold;
+  std::vector<ScoredDocumentHit> lower_tier_document_hits;
+  DocumentId last_merged_document_id = index_->last_merged_document_id();
+  if (champion_threshold.has_value()) {
+    // Only the hits that rank at or above the threshold are complete. The
+    // hits below it are complete for the documents in the lite index, and
+    // the ones of the main index get scored when they are needed.
+    ScoredDocumentHit threshold_hit(champion_threshold->document_id,
+                                    kSectionIdMaskNone,
+                                    champion_threshold->document_score);
+    auto lower_tier_begin = std::partition(
+        result_document_hits.begin(), result_document_hits.end(),
+        [&threshold_hit](const ScoredDocumentHit& hit) {
+          return !(hit < threshold_hit);
+        });
+    for (auto itr = lower_tier_begin; itr != result_document_hits.end();
+         ++itr) {
+      if (last_merged_document_id == kInvalidDocumentId ||
+          itr->document_id() > last_merged_document_id) {
+        lower_tier_document_hits.push_back(std::move(*itr));
+      }
+    }
+    result_document_hits.erase(lower_tier_begin, result_document_hits.end());
+  }
+
   // Returns early for empty result
-  if (result_document_hits.empty()) {
+  if (result_document_hits.empty() && !champion_threshold.has_value()) {
     result_status->set_code(StatusProto::OK);
-    return result_proto;
+    return;
   }
 
   component_timer = clock_->GetNewTimer();
+  ResultState result_state(std::move(result_document_hits),
+                           std::move(query_results.query_terms), search_spec,
+                           scoring_spec, result_spec, *document_store_);
+  if (champion_threshold.has_value()) {
+    result_state.SetLowerTier(
+        [this, search_spec, scoring_spec,
+         champion_threshold = *champion_threshold, last_merged_document_id,
+         lower_tier_document_hits = std::move(lower_tier_document_hits)]()
+            mutable
+            -> libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> {
+          std::vector<ScoredDocumentHit> hits =
+              std::move(lower_tier_document_hits);
+          if (last_merged_document_id != kInvalidDocumentId) {
+            ICING_ASSIGN_OR_RETURN(
+                std::vector<ScoredDocumentHit> merged_hits,
+                ScoreMergedHitsBelowChampions(search_spec, scoring_spec,
+                                              champion_threshold,
+                                              last_merged_document_id));
+            hits.insert(hits.end(),
+                        std::make_move_iterator(merged_hits.begin()),
+                        std::make_move_iterator(merged_hits.end()));
+          }
+          return hits;
+        });
+  }
   // Ranks and paginates results
   libtextclassifier3::StatusOr<PageResultState> page_result_state_or =
-      result_state_manager_->RankAndPaginate(ResultState(
-          std::move(result_document_hits), std::move(query_results.query_terms),
-          search_spec, scoring_spec, result_spec, *document_store_));
+      result_state_manager_->RankAndPaginate(std::move(result_state));
   if (!page_result_state_or.ok()) {
     TransformStatus(page_result_state_or.status(), result_status);
-    return result_proto;
+    return;
   }
   PageResultState page_result_state =
       std::move(page_result_state_or).ValueOrDie();
@@ -1311,56 +1948,106 @@ SearchResultProto IcingSearchEngine::Search(
     result_state_manager_->InvalidateResultState(
         page_result_state.next_page_token);
     TransformStatus(result_retriever_or.status(), result_status);
-    return result_proto;
+    return;
   }
   std::unique_ptr<ResultRetriever> result_retriever =
       std::move(result_retriever_or).ValueOrDie();
 
-  libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>
-      results_or = result_retriever->RetrieveResults(page_result_state);
-  if (!results_or.ok()) {
+  // The results are built directly in the final search result proto.
+  status = result_retriever->RetrieveResults(page_result_state,
+                                             result_proto->mutable_results());
+  if (!status.ok()) {
+    result_proto->clear_results();
     result_state_manager_->InvalidateResultState(
         page_result_state.next_page_token);
-    TransformStatus(results_or.status(), result_status);
-    return result_proto;
-  }
-  std::vector<SearchResultProto::ResultProto> results =
-      std::move(results_or).ValueOrDie();
-
-  // Assembles the final search result proto
-  result_proto.mutable_results()->Reserve(results.size());
-  for (SearchResultProto::ResultProto& result : results) {
-    result_proto.mutable_results()->Add(std::move(result));
+    TransformStatus(status, result_status);
+    return;
   }
   result_status->set_code(StatusProto::OK);
   if (page_result_state.next_page_token != kInvalidNextPageToken) {
-    result_proto.set_next_page_token(page_result_state.next_page_token);
+    result_proto->set_next_page_token(page_result_state.next_page_token);
+    if (page_result_state.prefetch_next_page) {
+      SchedulePrefetch(page_result_state.next_page_token);
+    }
   }
   query_stats->set_document_retrieval_latency_ms(
       component_timer->GetElapsedMilliseconds());
   query_stats->set_latency_ms(overall_timer->GetElapsedMilliseconds());
   query_stats->set_num_results_returned_current_page(
-      result_proto.results_size());
+      result_proto->results_size());
   query_stats->set_num_results_with_snippets(
-      std::min(result_proto.results_size(),
+      std::min(result_proto->results_size(),
                result_spec.snippet_spec().num_to_snippet()));
-  return result_proto;
+  return;
+}
+
+libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>>
+IcingSearchEngine::ScoreMergedHitsBelowChampions(
+    const SearchSpecProto& search_spec, const ScoringSpecProto& scoring_spec,
+    ChampionRank champion_threshold, DocumentId last_merged_document_id) {
+  DocumentId current_last_merged_document_id =
+      index_->last_merged_document_id();
+  if (current_last_merged_document_id == kInvalidDocumentId ||
+      current_last_merged_document_id < last_merged_document_id) {
+    return absl_ports::FailedPreconditionError(
+        "The index has been rebuilt since the search.");
+  }
+
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<QueryProcessor> query_processor,
+      QueryProcessor::Create(index_.get(), language_segmenter_.get(),
+                             normalizer_.get(), document_store_.get(),
+                             schema_store_.get()));
+  ICING_ASSIGN_OR_RETURN(
+      QueryProcessor::QueryResults query_results,
+      query_processor->ParseSearch(search_spec, Index::HitScope::kMain));
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<ScoringProcessor> scoring_processor,
+      ScoringProcessor::Create(scoring_spec, document_store_.get()));
+  std::vector<ScoredDocumentHit> hits =
+      scoring_processor->Score(std::move(query_results.root_iterator),
+                               performance_configuration_.num_to_score,
+                               &query_results.query_term_iterators);
+
+  ScoredDocumentHit threshold_hit(champion_threshold.document_id,
+                                  kSectionIdMaskNone,
+                                  champion_threshold.document_score);
+  // Documents merged since the search weren't part of its results.
+  hits.erase(std::remove_if(hits.begin(), hits.end(),
+                            [&](const ScoredDocumentHit& hit) {
+                              return hit.document_id() >
+                                         last_merged_document_id ||
+                                     !(hit < threshold_hit);
+                            }),
+             hits.end());
+  return hits;
 }
 
 SearchResultProto IcingSearchEngine::GetNextPage(uint64_t next_page_token) {
   SearchResultProto result_proto;
-  StatusProto* result_status = result_proto.mutable_status();
+  GetNextPage(next_page_token, &result_proto);
+  return result_proto;
+}
+
+void IcingSearchEngine::GetNextPage(uint64_t next_page_token,
+                                    SearchResultProto* result_proto) {
+  StatusProto* result_status = result_proto->mutable_status();
 
   // ResultStateManager has its own writer lock, so here we only need a reader
   // lock for other components.
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
+  int64_t queue_wait_latency_ms = queue_wait_timer->GetElapsedMilliseconds();
   if (!initialized_) {
     result_status->set_code(StatusProto::FAILED_PRECONDITION);
     result_status->set_message("IcingSearchEngine has not been initialized!");
-    return result_proto;
+    return;
   }
 
-  QueryStatsProto* query_stats = result_proto.mutable_query_stats();
+  QueryStatsProto* query_stats = result_proto->mutable_query_stats();
+  query_stats->set_queue_wait_latency_ms(queue_wait_latency_ms);
   query_stats->set_is_first_page(false);
 
   std::unique_ptr<Timer> overall_timer = clock_->GetNewTimer();
@@ -1375,42 +2062,49 @@ SearchResultProto IcingSearchEngine::GetNextPage(uint64_t next_page_token) {
       // Real error, pass up.
       TransformStatus(page_result_state_or.status(), result_status);
     }
-    return result_proto;
+    return;
   }
 
   PageResultState page_result_state =
       std::move(page_result_state_or).ValueOrDie();
   query_stats->set_requested_page_size(page_result_state.requested_page_size);
 
-  // Retrieves the document protos.
-  auto result_retriever_or =
-      ResultRetriever::Create(document_store_.get(), schema_store_.get(),
-                              language_segmenter_.get(), normalizer_.get());
-  if (!result_retriever_or.ok()) {
-    TransformStatus(result_retriever_or.status(), result_status);
-    return result_proto;
-  }
-  std::unique_ptr<ResultRetriever> result_retriever =
-      std::move(result_retriever_or).ValueOrDie();
-
-  libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>
-      results_or = result_retriever->RetrieveResults(page_result_state);
-  if (!results_or.ok()) {
-    TransformStatus(results_or.status(), result_status);
-    return result_proto;
-  }
-  std::vector<SearchResultProto::ResultProto> results =
-      std::move(results_or).ValueOrDie();
+  if (page_result_state.prefetched_results.has_value()) {
+    // Prefetched results are moved in, which copies them if result_proto is
+    // on an arena.
+    std::vector<SearchResultProto::ResultProto>& results =
+        *page_result_state.prefetched_results;
+    result_proto->mutable_results()->Reserve(results.size());
+    for (SearchResultProto::ResultProto& result : results) {
+      *result_proto->add_results() = std::move(result);
+    }
+  } else {
+    // Retrieves the document protos.
+    auto result_retriever_or =
+        ResultRetriever::Create(document_store_.get(), schema_store_.get(),
+                                language_segmenter_.get(), normalizer_.get());
+    if (!result_retriever_or.ok()) {
+      TransformStatus(result_retriever_or.status(), result_status);
+      return;
+    }
+    std::unique_ptr<ResultRetriever> result_retriever =
+        std::move(result_retriever_or).ValueOrDie();
 
-  // Assembles the final search result proto
-  result_proto.mutable_results()->Reserve(results.size());
-  for (SearchResultProto::ResultProto& result : results) {
-    result_proto.mutable_results()->Add(std::move(result));
+    libtextclassifier3::Status status = result_retriever->RetrieveResults(
+        page_result_state, result_proto->mutable_results());
+    if (!status.ok()) {
+      result_proto->clear_results();
+      TransformStatus(status, result_status);
+      return;
+    }
   }
 
   result_status->set_code(StatusProto::OK);
   if (page_result_state.next_page_token != kInvalidNextPageToken) {
-    result_proto.set_next_page_token(page_result_state.next_page_token);
+    result_proto->set_next_page_token(page_result_state.next_page_token);
+    if (page_result_state.prefetch_next_page) {
+      SchedulePrefetch(page_result_state.next_page_token);
+    }
   }
 
   // The only thing that we're doing is document retrieval. So document
@@ -1420,17 +2114,19 @@ SearchResultProto IcingSearchEngine::GetNextPage(uint64_t next_page_token) {
       overall_timer->GetElapsedMilliseconds());
   query_stats->set_latency_ms(overall_timer->GetElapsedMilliseconds());
   query_stats->set_num_results_returned_current_page(
-      result_proto.results_size());
+      result_proto->results_size());
   int num_left_to_snippet =
       std::max(page_result_state.snippet_context.snippet_spec.num_to_snippet() -
                    page_result_state.num_previously_returned,
                0);
   query_stats->set_num_results_with_snippets(
-      std::min(result_proto.results_size(), num_left_to_snippet));
-  return result_proto;
+      std::min(result_proto->results_size(), num_left_to_snippet));
+  return;
 }
 
 void IcingSearchEngine::InvalidateNextPageToken(uint64_t next_page_token) {
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
   absl_ports::shared_lock l(&mutex_);
   if (!initialized_) {
     ICING_LOG(ERROR) << "IcingSearchEngine has not been initialized!";
@@ -1439,6 +2135,142 @@ void IcingSearchEngine::InvalidateNextPageToken(uint64_t next_page_token) {
   result_state_manager_->InvalidateResultState(next_page_token);
 }
 
+ScanResultProto IcingSearchEngine::Scan(const ScanSpecProto& scan_spec,
+                                        const GetResultSpecProto& result_spec) {
+  ScanResultProto result_proto;
+  StatusProto* result_status = result_proto.mutable_status();
+
+  // Scans are bulk reads, so they let interactive calls go first.
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return result_proto;
+  }
+
+  if (scan_spec.num_per_page() <= 0) {
+    result_status->set_code(StatusProto::INVALID_ARGUMENT);
+    result_status->set_message(absl_ports::StrCat(
+        "ScanSpecProto.num_per_page cannot be negative or zero: ",
+        std::to_string(scan_spec.num_per_page())));
+    return result_proto;
+  }
+
+  ScanState scan_state;
+  for (const std::string& name_space : scan_spec.namespace_filters()) {
+    auto namespace_id_or = document_store_->GetNamespaceId(name_space);
+    if (namespace_id_or.ok()) {
+      scan_state.namespace_ids.insert(namespace_id_or.ValueOrDie());
+    }
+  }
+  for (const std::string& schema_type : scan_spec.schema_type_filters()) {
+    auto schema_type_id_or = schema_store_->GetSchemaTypeId(schema_type);
+    if (schema_type_id_or.ok()) {
+      scan_state.schema_type_ids.insert(schema_type_id_or.ValueOrDie());
+    }
+  }
+  if ((!scan_spec.namespace_filters().empty() &&
+       scan_state.namespace_ids.empty()) ||
+      (!scan_spec.schema_type_filters().empty() &&
+       scan_state.schema_type_ids.empty())) {
+    // None of the requested namespaces or schema types exist, so no documents
+    // can pass the filters.
+    result_status->set_code(StatusProto::OK);
+    return result_proto;
+  }
+  scan_state.num_per_page = scan_spec.num_per_page();
+  scan_state.result_spec = result_spec;
+  scan_state.next_document_id = 0;
+
+  libtextclassifier3::Status status = ScanNextPage(&scan_state, &result_proto);
+  if (!status.ok()) {
+    TransformStatus(status, result_status);
+    return result_proto;
+  }
+  if (scan_state.next_document_id != kInvalidDocumentId) {
+    result_proto.set_next_page_token(
+        scan_state_manager_->Add(std::move(scan_state)));
+  }
+  result_status->set_code(StatusProto::OK);
+  return result_proto;
+}
+
+ScanResultProto IcingSearchEngine::GetNextScanPage(uint64_t next_page_token) {
+  ScanResultProto result_proto;
+  StatusProto* result_status = result_proto.mutable_status();
+
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(OperationPriority::kMaintenance, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    result_status->set_code(StatusProto::FAILED_PRECONDITION);
+    result_status->set_message("IcingSearchEngine has not been initialized!");
+    return result_proto;
+  }
+
+  auto scan_state_or = scan_state_manager_->Get(next_page_token);
+  if (!scan_state_or.ok()) {
+    // This means that the token has been invalidated or the scan is done.
+    result_status->set_code(StatusProto::OK);
+    return result_proto;
+  }
+  ScanState scan_state = std::move(scan_state_or).ValueOrDie();
+
+  libtextclassifier3::Status status = ScanNextPage(&scan_state, &result_proto);
+  if (!status.ok()) {
+    TransformStatus(status, result_status);
+    return result_proto;
+  }
+  if (scan_state.next_document_id == kInvalidDocumentId ||
+      !scan_state_manager_->Update(next_page_token, std::move(scan_state))
+           .ok()) {
+    scan_state_manager_->Invalidate(next_page_token);
+  } else {
+    result_proto.set_next_page_token(next_page_token);
+  }
+  result_status->set_code(StatusProto::OK);
+  return result_proto;
+}
+
+void IcingSearchEngine::InvalidateScanToken(uint64_t next_page_token) {
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    ICING_LOG(ERROR) << "IcingSearchEngine has not been initialized!";
+    return;
+  }
+  scan_state_manager_->Invalidate(next_page_token);
+}
+
+libtextclassifier3::Status IcingSearchEngine::ScanNextPage(
+    ScanState* scan_state, ScanResultProto* result_proto) {
+  std::vector<DocumentId> document_ids = document_store_->ScanDocumentIds(
+      scan_state->namespace_ids, scan_state->schema_type_ids,
+      scan_state->num_per_page, &scan_state->next_document_id);
+
+  std::vector<DocumentProto*> documents;
+  documents.reserve(document_ids.size());
+  for (size_t i = 0; i < document_ids.size(); ++i) {
+    documents.push_back(result_proto->add_documents());
+  }
+  // The documents are read in one pass over the document log, since their
+  // ids, and so their offsets in the log, are ascending.
+  std::vector<libtextclassifier3::Status> statuses =
+      document_store_->BatchGet(document_ids, documents);
+  for (const libtextclassifier3::Status& status : statuses) {
+    if (!status.ok()) {
+      result_proto->clear_documents();
+      return status;
+    }
+  }
+
+  ProjectDocuments(scan_state->result_spec, documents);
+  return libtextclassifier3::Status::OK;
+}
+
 libtextclassifier3::Status IcingSearchEngine::OptimizeDocumentStore(
     OptimizeStatsProto* optimize_stats) {
   // Gets the current directory path and an empty tmp directory path for
@@ -1470,6 +2302,7 @@ libtextclassifier3::Status IcingSearchEngine::OptimizeDocumentStore(
   // result_state_manager_ depends on document_store_. So we need to reset it at
   // the same time that we reset the document_store_.
   result_state_manager_.reset();
+  scan_state_manager_.reset();
   document_store_.reset();
 
   // When swapping files, always put the current working directory at the
@@ -1508,6 +2341,7 @@ libtextclassifier3::Status IcingSearchEngine::OptimizeDocumentStore(
     document_store_ = std::move(create_result_or.ValueOrDie().document_store);
     result_state_manager_ = std::make_unique<ResultStateManager>(
         performance_configuration_.max_num_total_hits, *document_store_);
+    scan_state_manager_ = std::make_unique<ScanStateManager>(kMaxNumScanStates);
 
     // Potential data loss
     // TODO(b/147373249): Find a way to detect true data loss error
@@ -1530,6 +2364,7 @@ libtextclassifier3::Status IcingSearchEngine::OptimizeDocumentStore(
   document_store_ = std::move(create_result_or.ValueOrDie().document_store);
   result_state_manager_ = std::make_unique<ResultStateManager>(
       performance_configuration_.max_num_total_hits, *document_store_);
+  scan_state_manager_ = std::make_unique<ScanStateManager>(kMaxNumScanStates);
 
   // Deletes tmp directory
   if (!filesystem_->DeleteDirectoryRecursively(
@@ -1542,6 +2377,12 @@ libtextclassifier3::Status IcingSearchEngine::OptimizeDocumentStore(
 
 IcingSearchEngine::IndexRestorationResult
 IcingSearchEngine::RestoreIndexIfNeeded() {
+  return RestoreIndexIfNeeded(
+      /*max_num_documents=*/std::numeric_limits<int>::max());
+}
+
+IcingSearchEngine::IndexRestorationResult
+IcingSearchEngine::RestoreIndexIfNeeded(int max_num_documents) {
   DocumentId last_stored_document_id =
       document_store_->last_added_document_id();
   DocumentId last_indexed_document_id = index_->last_added_document_id();
@@ -1576,6 +2417,10 @@ IcingSearchEngine::RestoreIndexIfNeeded() {
     // Nothing to restore. Just return.
     return {libtextclassifier3::Status::OK, false};
   }
+  DocumentId last_document_to_reindex = static_cast<DocumentId>(
+      std::min(static_cast<int64_t>(last_stored_document_id),
+               static_cast<int64_t>(first_document_to_reindex) +
+                   max_num_documents - 1));
 
   auto index_processor_or = IndexProcessor::Create(
       normalizer_.get(), index_.get(), CreateIndexProcessorOptions(options_),
@@ -1588,17 +2433,19 @@ IcingSearchEngine::RestoreIndexIfNeeded() {
 
   ICING_VLOG(1) << "Restoring index by replaying documents from document id "
                 << first_document_to_reindex << " to document id "
-                << last_stored_document_id;
+                << last_document_to_reindex;
   libtextclassifier3::Status overall_status;
   for (DocumentId document_id = first_document_to_reindex;
-       document_id <= last_stored_document_id; ++document_id) {
+       document_id <= last_document_to_reindex; ++document_id) {
     libtextclassifier3::StatusOr<DocumentProto> document_or =
         document_store_->Get(document_id);
 
     if (!document_or.ok()) {
       if (absl_ports::IsInvalidArgument(document_or.status()) ||
           absl_ports::IsNotFound(document_or.status())) {
-        // Skips invalid and non-existing documents.
+        // Skips invalid and non-existing documents, but remembers that they
+        // have been dealt with so that they aren't looked at again.
+        index_->set_last_added_document_id(document_id);
         continue;
       } else {
         // Returns other errors
@@ -1606,6 +2453,11 @@ IcingSearchEngine::RestoreIndexIfNeeded() {
       }
     }
     DocumentProto document(std::move(document_or).ValueOrDie());
+    libtextclassifier3::StatusOr<NamespaceId> namespace_id_or =
+        document_store_->GetNamespaceId(document.namespace_());
+    if (!namespace_id_or.ok()) {
+      return {namespace_id_or.status(), true};
+    }
 
     libtextclassifier3::StatusOr<TokenizedDocument> tokenized_document_or =
         TokenizedDocument::Create(schema_store_.get(),
@@ -1616,9 +2468,15 @@ IcingSearchEngine::RestoreIndexIfNeeded() {
     }
     TokenizedDocument tokenized_document(
         std::move(tokenized_document_or).ValueOrDie());
+    // Documents put with async indexing are stored before they're tokenized.
+    libtextclassifier3::Status status = document_store_->SetLengthInTokens(
+        document_id, tokenized_document.num_tokens());
+    if (!status.ok()) {
+      return {status, true};
+    }
 
-    libtextclassifier3::Status status =
-        index_processor->IndexDocument(tokenized_document, document_id);
+    status = index_processor->IndexDocument(tokenized_document, document_id,
+                                            namespace_id_or.ValueOrDie());
     if (!status.ok()) {
       if (!absl_ports::IsDataLoss(status)) {
         // Real error. Stop recovering and pass it up.
@@ -1630,9 +2488,248 @@ IcingSearchEngine::RestoreIndexIfNeeded() {
     }
   }
 
+  ScheduleSegmentCompaction();
   return {overall_status, true};
 }
 
+OperationScheduler::Admission IcingSearchEngine::AdmitBackgroundWork(
+    std::string_view name, OperationPriority priority, bool exclusive) {
+  std::unique_ptr<Timer> queue_wait_timer = clock_->GetNewTimer();
+  OperationScheduler::Admission admission =
+      scheduler_.Admit(priority, exclusive);
+  ICING_VLOG(1) << name << " waited "
+                << queue_wait_timer->GetElapsedMilliseconds()
+                << " ms to be admitted and was overtaken "
+                << admission.num_overtaken() << " times";
+  return admission;
+}
+
+bool IcingSearchEngine::CatchUpIndex() {
+  OperationScheduler::Admission admission =
+      AdmitBackgroundWork("Indexing", OperationPriority::kBackgroundWrite,
+                          /*exclusive=*/true);
+  absl_ports::unique_lock l(&mutex_);
+  if (!initialized_) {
+    // Initialize() will restore the index anyway.
+    return false;
+  }
+  IndexRestorationResult catch_up_result =
+      RestoreIndexIfNeeded(kAsyncIndexingBatchSize);
+  if (!catch_up_result.status.ok()) {
+    ICING_LOG(WARNING) << "Failed to index pending documents: "
+                       << catch_up_result.status.error_message();
+    if (!absl_ports::IsDataLoss(catch_up_result.status)) {
+      // Retrying would most likely fail the same way. Wait for the next Put
+      // or Search to try again.
+      return false;
+    }
+  }
+  return index_->last_added_document_id() !=
+         document_store_->last_added_document_id();
+}
+
+void IcingSearchEngine::ScheduleSegmentCompaction() {
+  if (segment_compaction_worker_ != nullptr &&
+      index_->WantsSegmentCompaction()) {
+    segment_compaction_worker_->Notify();
+  }
+}
+
+bool IcingSearchEngine::CompactIndexSegments() {
+  // Compaction only bounds the number of segments that queries look at, so it
+  // yields to everything else. Segments are immutable, so the compacted
+  // segment is written alongside queries, and only swapping it in waits for
+  // them.
+  std::unique_ptr<SegmentedMainIndex::Compaction> compaction;
+  {
+    OperationScheduler::Admission admission = AdmitBackgroundWork(
+        "Segment compaction", OperationPriority::kMaintenance,
+        /*exclusive=*/false);
+    absl_ports::shared_lock l(&mutex_);
+    if (!initialized_) {
+      return false;
+    }
+    auto compaction_or = index_->PrepareSegmentCompaction();
+    if (!compaction_or.ok()) {
+      ICING_LOG(WARNING) << "Failed to compact index segments: "
+                         << compaction_or.status().error_message();
+      // Retrying would most likely fail the same way. Wait for the next merge
+      // to try again.
+      return false;
+    }
+    compaction = std::move(compaction_or).ValueOrDie();
+    if (compaction == nullptr) {
+      return false;
+    }
+  }
+
+  OperationScheduler::Admission admission =
+      AdmitBackgroundWork("Segment compaction swap",
+                          OperationPriority::kMaintenance, /*exclusive=*/true);
+  absl_ports::unique_lock l(&mutex_);
+  if (!initialized_) {
+    return false;
+  }
+  libtextclassifier3::StatusOr<bool> more_to_compact_or =
+      index_->CommitSegmentCompaction(std::move(compaction));
+  if (absl_ports::IsFailedPrecondition(more_to_compact_or.status())) {
+    // The index changed in between. Start over if there's still something to
+    // compact.
+    return index_->WantsSegmentCompaction();
+  }
+  if (!more_to_compact_or.ok()) {
+    ICING_LOG(WARNING) << "Failed to compact index segments: "
+                       << more_to_compact_or.status().error_message();
+    return false;
+  }
+  return more_to_compact_or.ValueOrDie();
+}
+
+void IcingSearchEngine::ScheduleDeadIndexTermCollection() {
+  has_dead_index_terms_ = true;
+  ++num_bulk_deletes_;
+  if (dead_term_collection_worker_ == nullptr) {
+    dead_term_collection_worker_ = std::make_unique<BackgroundWorker>(
+        [this]() { return CollectDeadIndexTerms(); });
+  }
+  dead_term_collection_worker_->Notify();
+}
+
+bool IcingSearchEngine::CollectDeadIndexTerms() {
+  // Finding the dead terms reads every posting list of the main index, so it
+  // yields to everything else and runs alongside queries. Only deleting them
+  // waits for the queries. Bulk deletes that come in meanwhile are collected
+  // by the next run.
+  Index::DeadTerms dead_terms;
+  uint64_t num_bulk_deletes;
+  {
+    OperationScheduler::Admission admission =
+        AdmitBackgroundWork("Dead term collection",
+                            OperationPriority::kMaintenance,
+                            /*exclusive=*/false);
+    absl_ports::shared_lock l(&mutex_);
+    if (!initialized_ || !has_dead_index_terms_) {
+      return false;
+    }
+    num_bulk_deletes = num_bulk_deletes_;
+    auto dead_terms_or = index_->FindDeadTerms([this](DocumentId document_id) {
+      return document_store_->DoesDocumentExist(document_id);
+    });
+    if (!dead_terms_or.ok()) {
+      ICING_LOG(WARNING) << "Failed to find dead index terms: "
+                         << dead_terms_or.status().error_message();
+      // Retrying would most likely fail the same way. Wait for the next bulk
+      // delete to try again.
+      return false;
+    }
+    dead_terms = std::move(dead_terms_or).ValueOrDie();
+  }
+
+  OperationScheduler::Admission admission =
+      AdmitBackgroundWork("Dead term deletion",
+                          OperationPriority::kMaintenance, /*exclusive=*/true);
+  absl_ports::unique_lock l(&mutex_);
+  if (!initialized_ || !has_dead_index_terms_) {
+    return false;
+  }
+  libtextclassifier3::StatusOr<int> num_terms_deleted_or =
+      index_->DeleteDeadTerms(std::move(dead_terms));
+  if (absl_ports::IsFailedPrecondition(num_terms_deleted_or.status())) {
+    // The index was merged in between, so the terms may have new hits. Look
+    // for them again.
+    return true;
+  }
+  if (num_terms_deleted_or.ok()) {
+    ICING_VLOG(1) << "Deleted " << num_terms_deleted_or.ValueOrDie()
+                  << " dead index terms";
+    if (num_bulk_deletes == num_bulk_deletes_) {
+      has_dead_index_terms_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  // The lexicon may have been replaced without all posting lists of the
+  // deleted terms being freed, so start over from the documents. Reindexing
+  // all of them here would hold mutex_ for as long as that takes, so it is
+  // left to indexing_worker_, which does it a few documents at a time, or to
+  // the next Initialize().
+  ICING_LOG(WARNING) << "Failed to delete dead index terms, rebuilding index: "
+                     << num_terms_deleted_or.status().error_message();
+  has_dead_index_terms_ = false;
+  libtextclassifier3::Status status = index_->Reset();
+  if (!status.ok()) {
+    ICING_LOG(ERROR) << "Failed to reset index: " << status.error_message();
+  }
+  if (status.ok() && indexing_worker_ != nullptr) {
+    indexing_worker_->Notify();
+  } else {
+    // Puts index their documents right away, which would skip the ones that
+    // weren't reindexed yet.
+    initialized_ = false;
+  }
+  return false;
+}
+
+void IcingSearchEngine::SchedulePrefetch(uint64_t next_page_token) {
+  absl_ports::unique_lock l(&prefetch_mutex_);
+  if (pending_prefetch_tokens_.size() >= kMaxPendingPrefetches) {
+    // Prefetching can't keep up. The oldest queries are the least likely to
+    // still be paged through.
+    pending_prefetch_tokens_.pop_front();
+  }
+  pending_prefetch_tokens_.push_back(next_page_token);
+  if (prefetch_worker_ == nullptr) {
+    prefetch_worker_ = std::make_unique<BackgroundWorker>(
+        [this]() { return PrefetchNextPage(); });
+  }
+  prefetch_worker_->Notify();
+}
+
+bool IcingSearchEngine::PrefetchNextPage() {
+  uint64_t next_page_token;
+  bool has_more_tokens;
+  {
+    absl_ports::unique_lock l(&prefetch_mutex_);
+    if (pending_prefetch_tokens_.empty()) {
+      return false;
+    }
+    next_page_token = pending_prefetch_tokens_.front();
+    pending_prefetch_tokens_.pop_front();
+    has_more_tokens = !pending_prefetch_tokens_.empty();
+  }
+
+  // Nobody is waiting for a prefetch, so it yields to everything else.
+  OperationScheduler::Admission admission =
+      AdmitBackgroundWork("Prefetch", OperationPriority::kMaintenance,
+                          /*exclusive=*/false);
+  absl_ports::shared_lock l(&mutex_);
+  if (!initialized_) {
+    return has_more_tokens;
+  }
+
+  auto result_retriever_or =
+      ResultRetriever::Create(document_store_.get(), schema_store_.get(),
+                              language_segmenter_.get(), normalizer_.get());
+  if (!result_retriever_or.ok()) {
+    ICING_LOG(WARNING) << "Failed to create result retriever for prefetching: "
+                       << result_retriever_or.status().error_message();
+    return has_more_tokens;
+  }
+  std::unique_ptr<ResultRetriever> result_retriever =
+      std::move(result_retriever_or).ValueOrDie();
+  libtextclassifier3::Status status = result_state_manager_->PrefetchNextPage(
+      next_page_token, [&result_retriever](const PageResultState& page) {
+        return result_retriever->RetrieveResults(page);
+      });
+  if (!status.ok()) {
+    // GetNextPage will retrieve the page itself and report the error then.
+    ICING_LOG(WARNING) << "Failed to prefetch next page: "
+                       << status.error_message();
+  }
+  return has_more_tokens;
+}
+
 libtextclassifier3::StatusOr<bool> IcingSearchEngine::LostPreviousSchema() {
   auto status_or = schema_store_->GetSchema();
   if (status_or.ok()) {
@@ -1662,6 +2759,8 @@ ResetResultProto IcingSearchEngine::Reset() {
   ResetResultProto result_proto;
   StatusProto* result_status = result_proto.mutable_status();
 
+  OperationScheduler::Admission admission = scheduler_.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
   absl_ports::unique_lock l(&mutex_);
 
   initialized_ = false;
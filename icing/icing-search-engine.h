@@ -16,9 +16,12 @@
 #define ICING_ICING_SEARCH_ENGINE_H_
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "icing/jni/jni-cache.h"
 #include "icing/text_classifier/lib3/utils/base/status.h"
@@ -26,11 +29,14 @@
 #include "icing/absl_ports/mutex.h"
 #include "icing/absl_ports/thread_annotations.h"
 #include "icing/file/filesystem.h"
+#include "icing/file/in-memory-file-tree.h"
 #include "icing/index/index.h"
+#include "icing/index/main/champion-list-store.h"
 #include "icing/legacy/index/icing-filesystem.h"
 #include "icing/performance-configuration.h"
 #include "icing/proto/document.pb.h"
 #include "icing/proto/initialize.pb.h"
+#include "icing/proto/memory.pb.h"
 #include "icing/proto/optimize.pb.h"
 #include "icing/proto/persist.pb.h"
 #include "icing/proto/reset.pb.h"
@@ -40,12 +46,18 @@
 #include "icing/proto/storage.pb.h"
 #include "icing/proto/usage.pb.h"
 #include "icing/result/result-state-manager.h"
+#include "icing/result/scan-state-manager.h"
 #include "icing/schema/schema-store.h"
+#include "icing/scoring/scored-document-hit.h"
+#include "icing/store/document-id.h"
 #include "icing/store/document-store.h"
+#include "icing/store/namespace-id.h"
 #include "icing/tokenization/language-segmenter.h"
 #include "icing/transform/normalizer.h"
+#include "icing/util/background-worker.h"
 #include "icing/util/clock.h"
 #include "icing/util/crc32.h"
+#include "icing/util/operation-scheduler.h"
 
 namespace icing {
 namespace lib {
@@ -176,6 +188,11 @@ class IcingSearchEngine {
   // indexed. Documents are automatically written to disk, callers can also
   // call PersistToDisk() to flush changes immediately.
   //
+  // If options.enable_async_indexing() is set, the document is only validated
+  // and stored, and tokenized and indexed on a background thread after this
+  // returns. Errors from tokenizing or indexing it are logged rather than
+  // returned.
+  //
   // Returns:
   //   OK on success
   //   OUT_OF_SPACE if exceeds maximum number of allowed documents
@@ -197,6 +214,14 @@ class IcingSearchEngine {
   PutResultProto Put(const DocumentProto& document)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Same as Put(DocumentProto&& document), but runs at the given priority
+  // when options.enable_priority_scheduling() is set. Clients syncing large
+  // amounts of data in the background should use
+  // OperationPriority::kBackgroundWrite so that interactive calls don't queue
+  // up behind them. The plain Put() runs at kInteractiveWrite.
+  PutResultProto Put(DocumentProto&& document, OperationPriority priority)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
   // Finds and returns the document identified by the given key (namespace +
   // uri)
   //
@@ -208,6 +233,30 @@ class IcingSearchEngine {
   GetResultProto Get(std::string_view name_space, std::string_view uri,
                      const GetResultSpecProto& result_spec);
 
+  // Finds and returns the documents identified by the given keys (namespace +
+  // uri), in the order of the keys. This is cheaper than calling Get for each
+  // key, since the documents are read in the order that they're stored in.
+  //
+  // Returns:
+  //   The result of getting each document, as Get would return it, on success
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  BatchGetResultProto BatchGet(
+      const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+      const GetResultSpecProto& result_spec) ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Finds and returns the documents in the given namespace whose uris start
+  // with uri_prefix, ordered by uri. This takes time proportional to the
+  // number of matching documents, so it's suited to operations on groups of
+  // documents that share a uri prefix, e.g. "thread/123/".
+  //
+  // Returns:
+  //   The matching documents, which may be none, on success
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  //   INTERNAL_ERROR on IO error
+  GetByUriPrefixResultProto GetByUriPrefix(
+      std::string_view name_space, std::string_view uri_prefix,
+      const GetResultSpecProto& result_spec) ICING_LOCKS_EXCLUDED(mutex_);
+
   // Reports usage. The corresponding usage scores of the specified document in
   // the report will be updated.
   //
@@ -268,6 +317,22 @@ class IcingSearchEngine {
   DeleteBySchemaTypeResultProto DeleteBySchemaType(std::string_view schema_type)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Deletes all Documents in the given namespace whose uris start with
+  // uri_prefix. Delete changes are automatically applied to disk, callers can
+  // also call PersistToDisk() to flush changes immediately.
+  //
+  // NOTE: Space is not reclaimed for deleted documents until Optimize() is
+  // called.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if no document with the uri prefix exists in the namespace
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  //   INTERNAL_ERROR on IO error
+  DeleteByUriPrefixResultProto DeleteByUriPrefix(std::string_view name_space,
+                                                 std::string_view uri_prefix)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
   // Deletes all Documents that match the query specified in search_spec. Delete
   // changes are automatically applied to disk, callers can also call
   // PersistToDisk() to flush changes immediately.
@@ -275,6 +340,10 @@ class IcingSearchEngine {
   // NOTE: Space is not reclaimed for deleted documents until Optimize() is
   // called.
   //
+  // If options.enable_async_indexing() is set, documents that haven't been
+  // indexed yet are indexed first, so that the query sees all documents that
+  // were put before this call.
+  //
   // Returns:
   //   OK on success
   //   NOT_FOUND if the query doesn't match any documents
@@ -291,6 +360,20 @@ class IcingSearchEngine {
   // result cache in memory. Please refer to each proto file for spec
   // definitions.
   //
+  // Searches run concurrently with each other and with other calls that only
+  // read, such as Get and GetNextPage. They don't run concurrently with calls
+  // that write, such as Put and Delete, or with the background indexing
+  // thread: they wait for the ones that are running, and the ones that are
+  // waiting go first.
+  //
+  // If options.enable_async_indexing() is set and the background thread hasn't
+  // indexed all put documents yet, the search first indexes up to
+  // options.max_search_catch_up_documents() of them itself, which waits for
+  // all other calls and adds the time to tokenize and index that many
+  // documents to the search's latency. If more documents than that are
+  // waiting, the most recently put ones may be missing from the results until
+  // the background thread catches up.
+  //
   // Returns a SearchResultProto with status:
   //   OK with results on success
   //   INVALID_ARGUMENT if any of specs is invalid
@@ -302,6 +385,14 @@ class IcingSearchEngine {
                            const ResultSpecProto& result_spec)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Same as above, but fills in result_proto, which must be empty. It may be
+  // allocated on an arena, in which case all of the results are built on that
+  // arena, from decoding the documents to snippeting them.
+  void Search(const SearchSpecProto& search_spec,
+              const ScoringSpecProto& scoring_spec,
+              const ResultSpecProto& result_spec,
+              SearchResultProto* result_proto) ICING_LOCKS_EXCLUDED(mutex_);
+
   // Fetches the next page of results of a previously executed query. Results
   // can be empty if next-page token is invalid. Invalid next page tokens are
   // tokens that are either zero or were previously passed to
@@ -318,11 +409,53 @@ class IcingSearchEngine {
   SearchResultProto GetNextPage(uint64_t next_page_token)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Same as above, but fills in result_proto, which must be empty. It may be
+  // allocated on an arena, in which case the results are built on that arena.
+  // Prefetched results are copied onto it.
+  void GetNextPage(uint64_t next_page_token, SearchResultProto* result_proto)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
   // Invalidates the next-page token so that no more results of the related
   // query can be returned.
   void InvalidateNextPageToken(uint64_t next_page_token)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Starts a scan over all documents that pass the filters of scan_spec, and
+  // returns its first page. Documents are returned in the order that they're
+  // stored in and read sequentially, without any scoring or ranking, which
+  // makes scans suited to exporting the whole corpus or large parts of it.
+  // result_spec's projections are applied to the returned documents.
+  //
+  // If there are more pages, ScanResultProto.next_page_token is set to a
+  // non-zero token that can be passed to GetNextScanPage(). Documents that are
+  // added or updated while the scan is ongoing may or may not be returned by
+  // it, and updated documents may be returned twice. Optimize() invalidates
+  // all tokens.
+  //
+  // Returns a ScanResultProto with status:
+  //   OK with the first page on success
+  //   INVALID_ARGUMENT if num_per_page isn't positive
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  //   INTERNAL_ERROR on IO error
+  ScanResultProto Scan(const ScanSpecProto& scan_spec,
+                       const GetResultSpecProto& result_spec)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Fetches the next page of a scan started by Scan(). Results are empty if
+  // the token is zero, unknown or was passed to InvalidateScanToken().
+  //
+  // Returns a ScanResultProto with status:
+  //   OK with the next page on success
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  //   INTERNAL_ERROR on IO error
+  ScanResultProto GetNextScanPage(uint64_t next_page_token)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Invalidates the scan token so that no more pages of the scan can be
+  // returned.
+  void InvalidateScanToken(uint64_t next_page_token)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
   // Makes sure that every update/delete received till this point is flushed
   // to disk. If the app crashes after a call to PersistToDisk(), Icing
   // would be able to fully recover all data written up to this point.
@@ -344,6 +477,8 @@ class IcingSearchEngine {
   // that was recently written. All read APIs will include the most recent
   // updates/deletes regardless of the data being flushed to disk.
   //
+  // If options.in_memory() is set, this is a no-op.
+  //
   // Returns:
   //   OK on success
   //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
@@ -351,6 +486,20 @@ class IcingSearchEngine {
   PersistToDiskResultProto PersistToDisk(PersistType::Code persist_type)
       ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Gives back as much memory as the given level calls for. See
+  // TrimMemoryLevel for what each level does. Clients should call this when
+  // the system signals that it's running low on memory.
+  //
+  // Nothing is lost by trimming memory, but the calls that follow may be
+  // slower while caches and memory-mapped pages are brought back in.
+  //
+  // Returns:
+  //   OK on success, with an estimate of the bytes released
+  //   FAILED_PRECONDITION IcingSearchEngine has not been initialized yet
+  //   INVALID_ARGUMENT if level is UNKNOWN
+  TrimMemoryResultProto TrimMemory(TrimMemoryLevel::Code level)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
   // Allows Icing to run tasks that are too expensive and/or unnecessary to be
   // executed in real-time, but are useful to keep it fast and be
   // resource-efficient. This method purely optimizes the internal files and
@@ -412,6 +561,12 @@ class IcingSearchEngine {
                     std::unique_ptr<const JniCache> jni_cache = nullptr);
 
  private:
+  // Creates the engine on top of in-memory filesystems sharing file_tree, or on
+  // top of the real filesystem if file_tree is null.
+  IcingSearchEngine(const IcingSearchEngineOptions& options,
+                    std::shared_ptr<InMemoryFileTree> file_tree,
+                    std::unique_ptr<const JniCache> jni_cache);
+
   const IcingSearchEngineOptions options_;
   const std::unique_ptr<const Filesystem> filesystem_;
   const std::unique_ptr<const IcingFilesystem> icing_filesystem_;
@@ -421,8 +576,8 @@ class IcingSearchEngine {
   const std::unique_ptr<const Clock> clock_;
 
   // Provides key thresholds that affects the running time and memory of major
-  // components in Icing search engine.
-  const PerformanceConfiguration performance_configuration_;
+  // components in Icing search engine. Set up in Initialize.
+  PerformanceConfiguration performance_configuration_ ICING_GUARDED_BY(mutex_);
 
   // Used to manage pagination state of query results. Even though
   // ResultStateManager has its own reader-writer lock, mutex_ must still be
@@ -432,8 +587,53 @@ class IcingSearchEngine {
   std::unique_ptr<ResultStateManager> result_state_manager_
       ICING_GUARDED_BY(mutex_);
 
-  // Used to provide reader and writer locks
-  absl_ports::shared_mutex mutex_;
+  // Holds the scans that have more pages. Like result_state_manager_, it's
+  // recreated along with document_store_, since it holds DocumentIds.
+  std::unique_ptr<ScanStateManager> scan_state_manager_
+      ICING_GUARDED_BY(mutex_);
+
+  // Decides the order in which public calls get to acquire mutex_. Every call
+  // is admitted here first, exclusively iff it takes mutex_ exclusively.
+  OperationScheduler scheduler_;
+
+  // Used to provide reader and writer locks. Waiting writers hold off new
+  // readers, so that back-to-back queries can't starve Put and the background
+  // workers. No call may acquire it while already holding it.
+  absl_ports::shared_mutex mutex_{/*prefer_writers=*/true};
+
+  // Indexes put documents in the background when
+  // options_.enable_async_indexing() is set, null otherwise.
+  std::unique_ptr<BackgroundWorker> indexing_worker_;
+
+  // Compacts the segments of the segmented main index in the background when
+  // options_.segmented_main_index() is set, null otherwise.
+  std::unique_ptr<BackgroundWorker> segment_compaction_worker_;
+
+  // Deletes the terms of the index that only deleted documents had, after
+  // bulk deletes. Created by the first of them.
+  std::unique_ptr<BackgroundWorker> dead_term_collection_worker_
+      ICING_GUARDED_BY(mutex_);
+
+  // Whether documents were deleted in bulk since the dead terms of the index
+  // were last deleted.
+  bool has_dead_index_terms_ ICING_GUARDED_BY(mutex_) = false;
+
+  // The number of bulk deletes so far. Tells CollectDeadIndexTerms whether
+  // bulk deletes came in while it was looking for dead terms.
+  uint64_t num_bulk_deletes_ ICING_GUARDED_BY(mutex_) = 0;
+
+  // Guards the prefetching state below. Never held while acquiring mutex_.
+  absl_ports::shared_mutex prefetch_mutex_;
+
+  // Next-page tokens of the queries whose next page should be prefetched,
+  // oldest first.
+  std::deque<uint64_t> pending_prefetch_tokens_
+      ICING_GUARDED_BY(prefetch_mutex_);
+
+  // Prefetches next pages in the background. Created by the first query that
+  // asks for it.
+  std::unique_ptr<BackgroundWorker> prefetch_worker_
+      ICING_GUARDED_BY(prefetch_mutex_);
 
   // Stores and processes the schema
   std::unique_ptr<SchemaStore> schema_store_ ICING_GUARDED_BY(mutex_);
@@ -486,6 +686,12 @@ class IcingSearchEngine {
   libtextclassifier3::Status InitializeOptions()
       ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Sets up performance_configuration_ from the defaults, or from the device
+  // profile if calibration is enabled, and then applies the thresholds set in
+  // the options. Falls back to the defaults if the device can't be probed.
+  void InitializePerformanceConfiguration()
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Do any initialization/recovery necessary to create a SchemaStore instance.
   //
   // Returns:
@@ -511,6 +717,17 @@ class IcingSearchEngine {
       InitializeStatsProto* initialize_stats)
       ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Returns the options of the index in index_dir.
+  Index::Options CreateIndexOptions(const std::string& index_dir)
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns true if no namespace with documents left shares the index
+  // partition of namespace_id.
+  //
+  // REQUIRES: index_->is_partitioned()
+  bool IsIndexPartitionEmpty(NamespaceId namespace_id)
+      ICING_SHARED_LOCKS_REQUIRED(mutex_);
+
   // Do any initialization/recovery necessary to create a DocumentStore
   // instance.
   //
@@ -587,6 +804,80 @@ class IcingSearchEngine {
   IndexRestorationResult RestoreIndexIfNeeded()
       ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Same as above, but stops after looking at max_num_documents documents.
+  IndexRestorationResult RestoreIndexIfNeeded(int max_num_documents)
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Admits the background work called name and logs how long it waited and
+  // how many later operations overtook it.
+  OperationScheduler::Admission AdmitBackgroundWork(std::string_view name,
+                                                    OperationPriority priority,
+                                                    bool exclusive)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Indexes the next few documents that were put since the index was last
+  // brought up to date, and returns whether there are more to index. Runs on
+  // indexing_worker_ when async indexing is enabled.
+  bool CatchUpIndex() ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Wakes up segment_compaction_worker_ if merges left segments of the
+  // segmented main index to compact.
+  void ScheduleSegmentCompaction() ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Compacts one run of segments of the segmented main index, and returns
+  // whether there are more. The compacted segment is written under a shared
+  // lock, and only swapped in under an exclusive one. Runs on
+  // segment_compaction_worker_.
+  bool CompactIndexSegments() ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Wakes up dead_term_collection_worker_ after documents were deleted in
+  // bulk, creating it if needed.
+  void ScheduleDeadIndexTermCollection() ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Deletes the terms of the index that only deleted documents had, and
+  // returns whether it should run again. The dead terms are found under a
+  // shared lock, and only deleted under an exclusive one. If deleting them
+  // fails, the index is reset and rebuilt by indexing_worker_, or by the next
+  // Initialize() if async indexing is disabled. Runs on
+  // dead_term_collection_worker_.
+  bool CollectDeadIndexTerms() ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Scores the documents up to last_merged_document_id that match the query
+  // in search_spec and rank below champion_threshold. Only reads the main
+  // index, so a shared lock on mutex_ suffices.
+  //
+  // Not annotated since this runs from the lower tier loaders of ResultStates,
+  // but mutex_ must be held.
+  //
+  // Returns:
+  //   The scored document hits on success
+  //   FAILED_PRECONDITION if the main index lost documents since the search
+  //   Any error from processing the query
+  libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>>
+  ScoreMergedHitsBelowChampions(const SearchSpecProto& search_spec,
+                                const ScoringSpecProto& scoring_spec,
+                                ChampionRank champion_threshold,
+                                DocumentId last_merged_document_id);
+
+  // Fills result_proto with the next page of the scan and moves the scan past
+  // it.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status ScanNextPage(ScanState* scan_state,
+                                          ScanResultProto* result_proto)
+      ICING_SHARED_LOCKS_REQUIRED(mutex_);
+
+  // Queues up prefetching the next page of the query with next_page_token.
+  void SchedulePrefetch(uint64_t next_page_token)
+      ICING_LOCKS_EXCLUDED(prefetch_mutex_);
+
+  // Prefetches the next page of the oldest query queued up by
+  // SchedulePrefetch, and returns whether there are more. Runs on
+  // prefetch_worker_.
+  bool PrefetchNextPage() ICING_LOCKS_EXCLUDED(mutex_, prefetch_mutex_);
+
   // If we lost the schema during a previous failure, it may "look" the same as
   // not having a schema set before: we don't have a schema proto file. So do
   // some extra checks to differentiate between having-lost the schema, and
@@ -14,6 +14,8 @@
 
 #include <unistd.h>
 
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -24,11 +26,14 @@
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "testing/base/public/benchmark.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <google/protobuf/arena.h>
+#include "icing/absl_ports/str_cat.h"
 #include "icing/document-builder.h"
 #include "icing/file/filesystem.h"
 #include "icing/icing-search-engine.h"
@@ -64,6 +69,30 @@
 //
 //    $ adb shell /data/local/tmp/icing-search-engine_benchmark --benchmarks=all
 
+// Counts the heap allocations made while counting is enabled, so that
+// benchmarks can report how many allocations an operation takes.
+namespace {
+
+std::atomic<bool> count_allocations{false};
+std::atomic<int64_t> num_allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (count_allocations.load(std::memory_order_relaxed)) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    std::abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
 namespace icing {
 namespace lib {
 
@@ -652,6 +681,77 @@ void BM_Get(benchmark::State& state) {
 }
 BENCHMARK(BM_Get);
 
+void BM_BatchGet(benchmark::State& state) {
+  bool use_batch_get = state.range(0);
+  int num_keys = state.range(1);
+  constexpr int kNumDocuments = 10000;
+
+  std::string test_dir = GetTestTempDir() + "/icing/benchmark";
+  Filesystem filesystem;
+  DestructibleDirectory ddir(filesystem, test_dir);
+
+  SchemaProto schema =
+      SchemaBuilder()
+          .AddType(SchemaTypeConfigBuilder().SetType("Message").AddProperty(
+              PropertyConfigBuilder()
+                  .SetName("body")
+                  .SetDataTypeString(TermMatchType::PREFIX,
+                                     StringIndexingConfig::TokenizerType::PLAIN)
+                  .SetCardinality(PropertyConfigProto::Cardinality::OPTIONAL)))
+          .Build();
+
+  IcingSearchEngineOptions options;
+  options.set_base_dir(test_dir);
+  options.set_index_merge_size(kIcingFullIndexSize);
+  IcingSearchEngine icing(options);
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(schema).status(), ProtoIsOk());
+
+  std::default_random_engine random;
+  std::vector<std::string> language = CreateLanguages(kLanguageSize, &random);
+  std::uniform_int_distribution<size_t> word_picker(0, language.size() - 1);
+  std::vector<std::string> uris;
+  for (int i = 0; i < kNumDocuments; ++i) {
+    std::string body;
+    for (int j = 0; j < kAvgDocumentSize / kAvgTokenLen; ++j) {
+      absl_ports::StrAppend(&body, language[word_picker(random)], " ");
+    }
+    uris.push_back(std::to_string(i));
+    DocumentProto document = DocumentBuilder()
+                                 .SetKey("namespace", uris.back())
+                                 .SetSchema("Message")
+                                 .AddStringProperty("body", body)
+                                 .Build();
+    ASSERT_THAT(icing.Put(std::move(document)).status(), ProtoIsOk());
+  }
+
+  // A list of known documents in no particular order, like a UI would show.
+  std::uniform_int_distribution<size_t> uri_picker(0, uris.size() - 1);
+  std::vector<std::pair<std::string_view, std::string_view>> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back({"namespace", uris[uri_picker(random)]});
+  }
+
+  for (auto s : state) {
+    if (use_batch_get) {
+      benchmark::DoNotOptimize(
+          icing.BatchGet(keys, GetResultSpecProto::default_instance()));
+    } else {
+      for (const auto& [name_space, uri] : keys) {
+        benchmark::DoNotOptimize(
+            icing.Get(name_space, uri, GetResultSpecProto::default_instance()));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_keys);
+}
+BENCHMARK(BM_BatchGet)
+    // Arguments: use_batch_get, num_keys
+    ->ArgPair(0, 50)
+    ->ArgPair(1, 50)
+    ->ArgPair(0, 200)
+    ->ArgPair(1, 200);
+
 void BM_Delete(benchmark::State& state) {
   // Initialize the filesystem
   std::string test_dir = GetTestTempDir() + "/icing/benchmark";
@@ -745,6 +845,333 @@ void BM_PutMaxAllowedDocuments(benchmark::State& state) {
 }
 BENCHMARK(BM_PutMaxAllowedDocuments);
 
+// Builds a short-lived engine, fills it, queries it and tears it down again,
+// like a per-session index would. Compares the in-memory backend against a
+// directory on tmpfs, which has no device I/O either, so the difference is the
+// cost of going through the kernel's file layer (file creation, msync, fsync).
+void BM_EphemeralEngine(benchmark::State& state) {
+  bool in_memory = state.range(0);
+  int num_docs = state.range(1);
+
+  // Prefer tmpfs for the disk-backed runs when it is available.
+  Filesystem filesystem;
+  std::string test_dir = filesystem.DirectoryExists("/dev/shm")
+                             ? "/dev/shm/icing_ephemeral_benchmark"
+                             : GetTestTempDir() + "/icing/benchmark";
+  DestructibleDirectory ddir(filesystem, test_dir);
+
+  SchemaProto schema =
+      SchemaBuilder()
+          .AddType(SchemaTypeConfigBuilder().SetType("Message").AddProperty(
+              PropertyConfigBuilder()
+                  .SetName("body")
+                  .SetDataTypeString(TermMatchType::PREFIX,
+                                     StringIndexingConfig::TokenizerType::PLAIN)
+                  .SetCardinality(PropertyConfigProto::Cardinality::OPTIONAL)))
+          .Build();
+
+  std::default_random_engine random;
+  std::vector<std::string> language = CreateLanguages(kLanguageSize, &random);
+  std::uniform_int_distribution<size_t> word_picker(0, language.size() - 1);
+  std::vector<DocumentProto> documents;
+  documents.reserve(num_docs);
+  for (int i = 0; i < num_docs; ++i) {
+    std::string body;
+    for (int j = 0; j < 20; ++j) {
+      absl_ports::StrAppend(&body, language[word_picker(random)], " ");
+    }
+    documents.push_back(DocumentBuilder()
+                            .SetKey("namespace", std::to_string(i))
+                            .SetSchema("Message")
+                            .AddStringProperty("body", std::move(body))
+                            .Build());
+  }
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query(language[0].substr(0, 1));
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(10);
+
+  IcingSearchEngineOptions options;
+  options.set_base_dir(test_dir);
+  options.set_in_memory(in_memory);
+  for (auto s : state) {
+    {
+      IcingSearchEngine icing(options);
+      ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+      ASSERT_THAT(icing.SetSchema(schema).status(), ProtoIsOk());
+      for (const DocumentProto& document : documents) {
+        ASSERT_THAT(icing.Put(document).status(), ProtoIsOk());
+      }
+      benchmark::DoNotOptimize(icing.Search(
+          search_spec, ScoringSpecProto::default_instance(), result_spec));
+    }
+
+    // Start every iteration from an empty directory, like a new session.
+    state.PauseTiming();
+    if (!in_memory) {
+      filesystem.DeleteDirectoryRecursively(test_dir.c_str());
+    }
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * num_docs);
+}
+BENCHMARK(BM_EphemeralEngine)
+    // Arguments: in_memory, num_documents
+    ->ArgPair(0, 10)
+    ->ArgPair(1, 10)
+    ->ArgPair(0, 100)
+    ->ArgPair(1, 100)
+    ->ArgPair(0, 1000)
+    ->ArgPair(1, 1000);
+
+void BM_PutLatencyByDocumentLength(benchmark::State& state) {
+  bool async_indexing = state.range(0);
+  int num_words = state.range(1);
+
+  std::string test_dir = GetTestTempDir() + "/icing/benchmark";
+  Filesystem filesystem;
+  DestructibleDirectory ddir(filesystem, test_dir);
+
+  SchemaProto schema =
+      SchemaBuilder()
+          .AddType(SchemaTypeConfigBuilder().SetType("Message").AddProperty(
+              PropertyConfigBuilder()
+                  .SetName("body")
+                  .SetDataTypeString(TermMatchType::PREFIX,
+                                     StringIndexingConfig::TokenizerType::PLAIN)
+                  .SetCardinality(PropertyConfigProto::Cardinality::OPTIONAL)))
+          .Build();
+
+  std::default_random_engine random;
+  std::vector<std::string> language = CreateLanguages(kLanguageSize, &random);
+  std::uniform_int_distribution<size_t> word_picker(0, language.size() - 1);
+  std::string body;
+  for (int i = 0; i < num_words; ++i) {
+    absl_ports::StrAppend(&body, language[word_picker(random)], " ");
+  }
+
+  IcingSearchEngineOptions options;
+  options.set_base_dir(test_dir);
+  options.set_enable_async_indexing(async_indexing);
+  IcingSearchEngine icing(options);
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(schema).status(), ProtoIsOk());
+
+  int uri = 0;
+  for (auto s : state) {
+    DocumentProto document = DocumentBuilder()
+                                 .SetKey("namespace", std::to_string(uri++))
+                                 .SetSchema("Message")
+                                 .AddStringProperty("body", body)
+                                 .Build();
+    benchmark::DoNotOptimize(icing.Put(std::move(document)));
+  }
+}
+BENCHMARK(BM_PutLatencyByDocumentLength)
+    // Arguments: async_indexing, num_words
+    ->ArgPair(0, 10)
+    ->ArgPair(1, 10)
+    ->ArgPair(0, 1000)
+    ->ArgPair(1, 1000)
+    ->ArgPair(0, 10000)
+    ->ArgPair(1, 10000);
+
+void BM_SearchAllocationsPerPage(benchmark::State& state) {
+  bool use_arena = state.range(0);
+  int num_documents = state.range(1);
+
+  std::string test_dir = GetTestTempDir() + "/icing/benchmark";
+  Filesystem filesystem;
+  DestructibleDirectory ddir(filesystem, test_dir);
+
+  SchemaProto schema =
+      SchemaBuilder()
+          .AddType(SchemaTypeConfigBuilder().SetType("Message").AddProperty(
+              PropertyConfigBuilder()
+                  .SetName("body")
+                  .SetDataTypeString(TermMatchType::PREFIX,
+                                     StringIndexingConfig::TokenizerType::PLAIN)
+                  .SetCardinality(PropertyConfigProto::Cardinality::OPTIONAL)))
+          .Build();
+
+  IcingSearchEngineOptions options;
+  options.set_base_dir(test_dir);
+  options.set_index_merge_size(kIcingFullIndexSize);
+  IcingSearchEngine icing(options);
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(schema).status(), ProtoIsOk());
+
+  std::default_random_engine random;
+  std::vector<std::string> language = CreateLanguages(kLanguageSize, &random);
+  std::uniform_int_distribution<size_t> word_picker(0, language.size() - 1);
+  for (int i = 0; i < num_documents; ++i) {
+    // Every document matches the query below.
+    std::string body = "message";
+    for (int j = 0; j < kAvgDocumentSize / kAvgTokenLen; ++j) {
+      absl_ports::StrAppend(&body, " ", language[word_picker(random)]);
+    }
+    DocumentProto document = DocumentBuilder()
+                                 .SetKey("namespace", std::to_string(i))
+                                 .SetSchema("Message")
+                                 .AddStringProperty("body", body)
+                                 .Build();
+    ASSERT_THAT(icing.Put(std::move(document)).status(), ProtoIsOk());
+  }
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(kNumPerPage);
+  result_spec.mutable_snippet_spec()->set_num_to_snippet(kNumToSnippet);
+  result_spec.mutable_snippet_spec()->set_num_matches_per_property(
+      kMatchesPerProperty);
+
+  // Reused across searches the way that the JNI layer reuses its arena.
+  google::protobuf::Arena arena;
+
+  int64_t num_pages = 0;
+  num_allocations.store(0);
+  for (auto s : state) {
+    count_allocations.store(true);
+    if (use_arena) {
+      SearchResultProto* search_result_proto =
+          google::protobuf::Arena::CreateMessage<SearchResultProto>(&arena);
+      icing.Search(search_spec, ScoringSpecProto::default_instance(),
+                   result_spec, search_result_proto);
+      uint64_t next_page_token = search_result_proto->next_page_token();
+      ++num_pages;
+      while (next_page_token != kInvalidNextPageToken) {
+        SearchResultProto* next_page_result_proto =
+            google::protobuf::Arena::CreateMessage<SearchResultProto>(&arena);
+        icing.GetNextPage(next_page_token, next_page_result_proto);
+        next_page_token = next_page_result_proto->next_page_token();
+        ++num_pages;
+      }
+      arena.Reset();
+    } else {
+      SearchResultProto search_result_proto = icing.Search(
+          search_spec, ScoringSpecProto::default_instance(), result_spec);
+      uint64_t next_page_token = search_result_proto.next_page_token();
+      ++num_pages;
+      while (next_page_token != kInvalidNextPageToken) {
+        search_result_proto = icing.GetNextPage(next_page_token);
+        next_page_token = search_result_proto.next_page_token();
+        ++num_pages;
+      }
+    }
+    count_allocations.store(false);
+  }
+  state.counters["AllocationsPerPage"] =
+      static_cast<double>(num_allocations.load()) / num_pages;
+}
+BENCHMARK(BM_SearchAllocationsPerPage)
+    // Arguments: use_arena, num_documents
+    ->ArgPair(0, 100)
+    ->ArgPair(1, 100)
+    ->ArgPair(0, 1000)
+    ->ArgPair(1, 1000);
+
+// The engine shared by the threads of BM_MixedSearchAndPut. Set up and torn
+// down by the first thread, outside of the timed loop.
+Filesystem mixed_workload_filesystem;
+std::unique_ptr<DestructibleDirectory> mixed_workload_dir;
+std::unique_ptr<IcingSearchEngine> mixed_workload_icing;
+
+// The first thread keeps putting documents while all others search, to
+// measure how much writes hold up concurrent searches. Every thread runs the
+// same number of iterations, so this is the throughput of a fixed mix of one
+// Put per threads - 1 searches. Puts and searches per second are reported
+// separately.
+void BM_MixedSearchAndPut(benchmark::State& state) {
+  bool async_indexing = state.range(0);
+  constexpr int kNumDocuments = 1000;
+
+  std::default_random_engine random(state.thread_index());
+  std::vector<std::string> language = CreateLanguages(kLanguageSize, &random);
+  std::uniform_int_distribution<size_t> word_picker(0, language.size() - 1);
+  auto create_document = [&](int uri) {
+    // Every document matches the query below.
+    std::string body = "message";
+    for (int i = 0; i < kAvgDocumentSize / kAvgTokenLen; ++i) {
+      absl_ports::StrAppend(&body, " ", language[word_picker(random)]);
+    }
+    return DocumentBuilder()
+        .SetKey("namespace", std::to_string(uri))
+        .SetSchema("Message")
+        .AddStringProperty("body", body)
+        .Build();
+  };
+
+  if (state.thread_index() == 0) {
+    std::string test_dir = GetTestTempDir() + "/icing/benchmark";
+    mixed_workload_dir = std::make_unique<DestructibleDirectory>(
+        mixed_workload_filesystem, test_dir);
+
+    SchemaProto schema =
+        SchemaBuilder()
+            .AddType(SchemaTypeConfigBuilder().SetType("Message").AddProperty(
+                PropertyConfigBuilder()
+                    .SetName("body")
+                    .SetDataTypeString(
+                        TermMatchType::PREFIX,
+                        StringIndexingConfig::TokenizerType::PLAIN)
+                    .SetCardinality(
+                        PropertyConfigProto::Cardinality::OPTIONAL)))
+            .Build();
+
+    IcingSearchEngineOptions options;
+    options.set_base_dir(test_dir);
+    options.set_enable_async_indexing(async_indexing);
+    mixed_workload_icing = std::make_unique<IcingSearchEngine>(options);
+    ASSERT_THAT(mixed_workload_icing->Initialize().status(), ProtoIsOk());
+    ASSERT_THAT(mixed_workload_icing->SetSchema(schema).status(),
+                ProtoIsOk());
+    for (int i = 0; i < kNumDocuments; ++i) {
+      ASSERT_THAT(mixed_workload_icing->Put(create_document(i)).status(),
+                  ProtoIsOk());
+    }
+  }
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(kNumPerPage);
+
+  // All threads wait for the first one to set up the engine before the loop
+  // starts.
+  int uri = kNumDocuments;
+  for (auto s : state) {
+    if (state.thread_index() == 0) {
+      benchmark::DoNotOptimize(
+          mixed_workload_icing->Put(create_document(uri++)));
+    } else {
+      SearchResultProto search_result_proto = mixed_workload_icing->Search(
+          search_spec, ScoringSpecProto::default_instance(), result_spec);
+      mixed_workload_icing->InvalidateNextPageToken(
+          search_result_proto.next_page_token());
+    }
+  }
+  state.counters[state.thread_index() == 0 ? "puts" : "searches"] =
+      benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+
+  // All threads are done with the engine once the loop ends.
+  if (state.thread_index() == 0) {
+    mixed_workload_icing.reset();
+    mixed_workload_dir.reset();
+  }
+}
+BENCHMARK(BM_MixedSearchAndPut)
+    // Arguments: async_indexing
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(2, 8)
+    ->UseRealTime();
+
 }  // namespace
 
 }  // namespace lib
@@ -14,16 +14,21 @@
 
 #include "icing/icing-search-engine.h"
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <utility>
+#include <vector>
 
 #include "icing/jni/jni-cache.h"
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <google/protobuf/arena.h>
 #include "icing/document-builder.h"
 #include "icing/file/filesystem.h"
 #include "icing/file/mock-filesystem.h"
@@ -42,6 +47,7 @@
 #include "icing/schema-builder.h"
 #include "icing/schema/schema-store.h"
 #include "icing/schema/section.h"
+#include "icing/scoring/scored-document-hit.h"
 #include "icing/store/document-log-creator.h"
 #include "icing/testing/common-matchers.h"
 #include "icing/testing/fake-clock.h"
@@ -325,6 +331,68 @@ TEST_F(IcingSearchEngineTest, InitializingAgainSavesNonPersistedData) {
       EqualsProto(expected_get_result_proto));
 }
 
+TEST_F(IcingSearchEngineTest, InMemoryEngineNeverTouchesDisk) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  std::string base_dir = GetTestBaseDir() + "/in_memory";
+  options.set_base_dir(base_dir);
+  options.set_in_memory(true);
+  // Merge often so that the main index is exercised too.
+  options.set_index_merge_size(1);
+
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document_one = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document_two = CreateMessageDocument("namespace", "uri2");
+  ASSERT_THAT(icing.Put(document_one).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document_two).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Delete("namespace", "uri1").status(), ProtoIsOk());
+  ASSERT_THAT(icing.Optimize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.PersistToDisk(PersistType::FULL).status(), ProtoIsOk());
+  // Reinitializing the same instance reloads the in-memory files.
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document_two;
+
+  SearchResultProto search_result_proto =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+  EXPECT_FALSE(filesystem()->DirectoryExists(base_dir.c_str()));
+}
+
+TEST_F(IcingSearchEngineTest, InMemoryEnginesAreIndependent) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_in_memory(true);
+
+  DocumentProto document = CreateMessageDocument("namespace", "uri");
+  {
+    IcingSearchEngine icing(options, GetTestJniCache());
+    ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+    ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+    ASSERT_THAT(icing.Put(document).status(), ProtoIsOk());
+  }
+
+  // A new instance with the same base_dir starts out empty.
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  EXPECT_THAT(icing.GetSchema().status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+  EXPECT_THAT(
+      icing.Get("namespace", "uri", GetResultSpecProto::default_instance())
+          .status(),
+      ProtoStatusIs(StatusProto::NOT_FOUND));
+}
+
 TEST_F(IcingSearchEngineTest, MaxIndexMergeSizeReturnsInvalidArgument) {
   IcingSearchEngineOptions options = GetDefaultIcingOptions();
   options.set_index_merge_size(std::numeric_limits<int32_t>::max());
@@ -388,6 +456,73 @@ TEST_F(IcingSearchEngineTest, GoodMaxTokensPerDocSizeReturnsOk) {
   EXPECT_THAT(icing.Initialize().status(), ProtoIsOk());
 }
 
+TEST_F(IcingSearchEngineTest, ZeroMaxQueryLengthReturnsInvalidArgument) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_max_query_length(0);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  EXPECT_THAT(icing.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, NegativeNumToScoreReturnsInvalidArgument) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_num_to_score(-1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  EXPECT_THAT(icing.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, MaxQueryLengthOptionRejectsLongerQueries) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_max_query_length(5);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("hello");
+  EXPECT_THAT(icing
+                  .Search(search_spec, GetDefaultScoringSpec(),
+                          ResultSpecProto::default_instance())
+                  .status(),
+              ProtoIsOk());
+
+  search_spec.set_query("hello!");
+  EXPECT_THAT(icing
+                  .Search(search_spec, GetDefaultScoringSpec(),
+                          ResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, PerformanceCalibrationSavesDeviceProfile) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_performance_calibration(true);
+  const std::string profile_filename = GetTestBaseDir() + "/device_profile";
+  {
+    IcingSearchEngine icing(options, GetTestJniCache());
+    ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+    ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+    ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri")).status(),
+                ProtoIsOk());
+  }
+  EXPECT_TRUE(filesystem()->FileExists(profile_filename.c_str()));
+
+  // The thresholds derived from the saved profile work.
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  SearchResultProto results =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(results.status(), ProtoIsOk());
+  EXPECT_THAT(results.results(), SizeIs(1));
+}
+
 TEST_F(IcingSearchEngineTest, NegativeMaxTokenLenReturnsInvalidArgument) {
   IcingSearchEngineOptions options = GetDefaultIcingOptions();
   options.set_max_token_length(-1);
@@ -1727,6 +1862,288 @@ TEST_F(IcingSearchEngineTest, GetDocumentWildCardProjectionEmpty) {
               EqualsProto(expected_get_result_proto));
 }
 
+TEST_F(IcingSearchEngineTest, BatchGetReturnsResultsInRequestOrder) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  // Replacing document1 stores it after document3.
+  document1 = DocumentBuilder(document1).SetScore(5).Build();
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Delete("namespace", "uri2").status(), ProtoIsOk());
+
+  BatchGetResultProto batch_get_result_proto = icing.BatchGet(
+      {{"namespace", "uri3"},
+       {"namespace", "uri2"},
+       {"namespace", "nonexistent"},
+       {"namespace", "uri1"},
+       {"namespace", "uri3"}},
+      GetResultSpecProto::default_instance());
+  EXPECT_THAT(batch_get_result_proto.status(), ProtoIsOk());
+  ASSERT_THAT(batch_get_result_proto.results(), SizeIs(5));
+  EXPECT_THAT(batch_get_result_proto.results(0).status(), ProtoIsOk());
+  EXPECT_THAT(batch_get_result_proto.results(0).document(),
+              EqualsProto(document3));
+  EXPECT_THAT(batch_get_result_proto.results(1).status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+  EXPECT_FALSE(batch_get_result_proto.results(1).has_document());
+  EXPECT_THAT(batch_get_result_proto.results(2).status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+  EXPECT_THAT(batch_get_result_proto.results(3).status(), ProtoIsOk());
+  EXPECT_THAT(batch_get_result_proto.results(3).document(),
+              EqualsProto(document1));
+  EXPECT_THAT(batch_get_result_proto.results(4).status(), ProtoIsOk());
+  EXPECT_THAT(batch_get_result_proto.results(4).document(),
+              EqualsProto(document3));
+
+  // The results match those of Get.
+  for (const auto& [uri, result] :
+       std::vector<std::pair<std::string, GetResultProto>>{
+           {"uri1", batch_get_result_proto.results(3)},
+           {"uri3", batch_get_result_proto.results(0)}}) {
+    EXPECT_THAT(icing.Get("namespace", uri,
+                          GetResultSpecProto::default_instance()),
+                EqualsProto(result));
+  }
+}
+
+TEST_F(IcingSearchEngineTest, BatchGetAppliesProjection) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+
+  GetResultSpecProto result_spec;
+  TypePropertyMask* mask = result_spec.add_type_property_masks();
+  mask->set_schema_type("*");
+  mask->add_paths("");
+
+  BatchGetResultProto batch_get_result_proto = icing.BatchGet(
+      {{"namespace", "uri2"}, {"namespace", "uri1"}}, result_spec);
+  EXPECT_THAT(batch_get_result_proto.status(), ProtoIsOk());
+  ASSERT_THAT(batch_get_result_proto.results(), SizeIs(2));
+  document1.clear_properties();
+  document2.clear_properties();
+  EXPECT_THAT(batch_get_result_proto.results(0).document(),
+              EqualsProto(document2));
+  EXPECT_THAT(batch_get_result_proto.results(1).document(),
+              EqualsProto(document1));
+}
+
+TEST_F(IcingSearchEngineTest, BatchGetBeforeInitializationShouldFail) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  EXPECT_THAT(icing
+                  .BatchGet({{"namespace", "uri"}},
+                            GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::FAILED_PRECONDITION));
+}
+
+TEST_F(IcingSearchEngineTest, GetByUriPrefixReturnsDocumentsInUriOrder) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "thread/1/b");
+  DocumentProto document2 = CreateMessageDocument("namespace", "thread/1/a");
+  DocumentProto document3 = CreateMessageDocument("namespace", "thread/2/a");
+  DocumentProto document4 = CreateMessageDocument("namespace2", "thread/1/a");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document4).status(), ProtoIsOk());
+
+  GetByUriPrefixResultProto result_proto = icing.GetByUriPrefix(
+      "namespace", "thread/1/", GetResultSpecProto::default_instance());
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(),
+              ElementsAre(EqualsProto(document2), EqualsProto(document1)));
+
+  // Optimize rebuilds the document store, and the uri prefixes with it.
+  ASSERT_THAT(icing.Delete("namespace", "thread/1/a").status(), ProtoIsOk());
+  ASSERT_THAT(icing.Optimize().status(), ProtoIsOk());
+  result_proto = icing.GetByUriPrefix("namespace", "thread/",
+                                      GetResultSpecProto::default_instance());
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(),
+              ElementsAre(EqualsProto(document1), EqualsProto(document3)));
+
+  result_proto = icing.GetByUriPrefix("namespace", "thread/3/",
+                                      GetResultSpecProto::default_instance());
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(), IsEmpty());
+}
+
+TEST_F(IcingSearchEngineTest, GetByUriPrefixAppliesProjection) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document = CreateMessageDocument("namespace", "thread/1/a");
+  ASSERT_THAT(icing.Put(document).status(), ProtoIsOk());
+
+  GetResultSpecProto result_spec;
+  TypePropertyMask* mask = result_spec.add_type_property_masks();
+  mask->set_schema_type("Message");
+  mask->add_paths("");
+
+  GetByUriPrefixResultProto result_proto =
+      icing.GetByUriPrefix("namespace", "thread/1/", result_spec);
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  document.clear_properties();
+  EXPECT_THAT(result_proto.documents(), ElementsAre(EqualsProto(document)));
+}
+
+TEST_F(IcingSearchEngineTest, GetByUriPrefixBeforeInitializationShouldFail) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  EXPECT_THAT(icing
+                  .GetByUriPrefix("namespace", "thread/",
+                                  GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::FAILED_PRECONDITION));
+}
+
+TEST_F(IcingSearchEngineTest, ScanReturnsAllDocumentsInPages) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  DocumentProto document4 = CreateMessageDocument("namespace", "uri4");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document4).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Delete("namespace", "uri2").status(), ProtoIsOk());
+
+  ScanSpecProto scan_spec;
+  scan_spec.set_num_per_page(2);
+  ScanResultProto result_proto =
+      icing.Scan(scan_spec, GetResultSpecProto::default_instance());
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(),
+              ElementsAre(EqualsProto(document1), EqualsProto(document3)));
+  EXPECT_THAT(result_proto.next_page_token(), Ne(kInvalidNextPageToken));
+
+  uint64_t next_page_token = result_proto.next_page_token();
+  result_proto = icing.GetNextScanPage(next_page_token);
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(), ElementsAre(EqualsProto(document4)));
+  EXPECT_THAT(result_proto.next_page_token(), Eq(kInvalidNextPageToken));
+
+  // The scan is done, so its token has been invalidated.
+  result_proto = icing.GetNextScanPage(next_page_token);
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(), IsEmpty());
+}
+
+TEST_F(IcingSearchEngineTest, ScanAppliesFiltersAndProjection) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreatePersonAndEmailSchema()).status(),
+              ProtoIsOk());
+
+  DocumentProto email1 = DocumentBuilder()
+                             .SetKey("namespace1", "email1")
+                             .SetSchema("Email")
+                             .AddStringProperty("subject", "subject1")
+                             .SetCreationTimestampMs(1000)
+                             .Build();
+  DocumentProto email2 = DocumentBuilder()
+                             .SetKey("namespace2", "email2")
+                             .SetSchema("Email")
+                             .AddStringProperty("subject", "subject2")
+                             .SetCreationTimestampMs(1000)
+                             .Build();
+  DocumentProto person = DocumentBuilder()
+                             .SetKey("namespace1", "person")
+                             .SetSchema("Person")
+                             .AddStringProperty("name", "Meg Ryan")
+                             .SetCreationTimestampMs(1000)
+                             .Build();
+  ASSERT_THAT(icing.Put(email1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(email2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(person).status(), ProtoIsOk());
+
+  ScanSpecProto scan_spec;
+  scan_spec.add_namespace_filters("namespace1");
+  scan_spec.add_schema_type_filters("Email");
+  GetResultSpecProto result_spec;
+  TypePropertyMask* mask = result_spec.add_type_property_masks();
+  mask->set_schema_type("Email");
+  mask->add_paths("");
+
+  ScanResultProto result_proto = icing.Scan(scan_spec, result_spec);
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  email1.clear_properties();
+  EXPECT_THAT(result_proto.documents(), ElementsAre(EqualsProto(email1)));
+  EXPECT_THAT(result_proto.next_page_token(), Eq(kInvalidNextPageToken));
+
+  // Unknown namespaces match no documents.
+  scan_spec.clear_namespace_filters();
+  scan_spec.add_namespace_filters("nonexistent");
+  result_proto = icing.Scan(scan_spec, result_spec);
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(), IsEmpty());
+}
+
+TEST_F(IcingSearchEngineTest, OptimizeInvalidatesScanTokens) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri1")).status(),
+              ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri2")).status(),
+              ProtoIsOk());
+
+  ScanSpecProto scan_spec;
+  scan_spec.set_num_per_page(1);
+  ScanResultProto result_proto =
+      icing.Scan(scan_spec, GetResultSpecProto::default_instance());
+  ASSERT_THAT(result_proto.status(), ProtoIsOk());
+  ASSERT_THAT(result_proto.next_page_token(), Ne(kInvalidNextPageToken));
+
+  // Optimize reassigns DocumentIds, so the scan can't resume.
+  ASSERT_THAT(icing.Optimize().status(), ProtoIsOk());
+  result_proto = icing.GetNextScanPage(result_proto.next_page_token());
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  EXPECT_THAT(result_proto.documents(), IsEmpty());
+}
+
+TEST_F(IcingSearchEngineTest, ScanWithNonPositiveNumPerPageShouldFail) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+
+  ScanSpecProto scan_spec;
+  scan_spec.set_num_per_page(0);
+  EXPECT_THAT(
+      icing.Scan(scan_spec, GetResultSpecProto::default_instance()).status(),
+      ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, ScanBeforeInitializationShouldFail) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  EXPECT_THAT(icing
+                  .Scan(ScanSpecProto::default_instance(),
+                        GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::FAILED_PRECONDITION));
+  EXPECT_THAT(icing.GetNextScanPage(1).status(),
+              ProtoStatusIs(StatusProto::FAILED_PRECONDITION));
+}
+
 TEST_F(IcingSearchEngineTest, GetDocumentProjectionMultipleFieldPaths) {
   IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
   ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
@@ -2226,24 +2643,103 @@ TEST_F(IcingSearchEngineTest, SearchShouldReturnMultiplePages) {
                                        expected_search_result_proto));
 }
 
-TEST_F(IcingSearchEngineTest, SearchWithNoScoringShouldReturnMultiplePages) {
-  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
-  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
-  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+TEST_F(IcingSearchEngineTest, ChampionListsShouldNotChangeResults) {
+  auto search_all_pages = [](IcingSearchEngine* icing,
+                             int* num_documents_scored_on_first_page) {
+    SearchSpecProto search_spec;
+    search_spec.set_term_match_type(TermMatchType::EXACT_ONLY);
+    search_spec.set_query("message");
+    ResultSpecProto result_spec;
+    result_spec.set_num_per_page(3);
 
-  // Creates and inserts 5 documents
-  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
-  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
-  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
-  DocumentProto document4 = CreateMessageDocument("namespace", "uri4");
-  DocumentProto document5 = CreateMessageDocument("namespace", "uri5");
-  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
-  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
-  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
-  ASSERT_THAT(icing.Put(document4).status(), ProtoIsOk());
-  ASSERT_THAT(icing.Put(document5).status(), ProtoIsOk());
+    std::vector<std::string> uris;
+    SearchResultProto search_result_proto =
+        icing->Search(search_spec, GetDefaultScoringSpec(), result_spec);
+    EXPECT_THAT(search_result_proto.status(), ProtoIsOk());
+    *num_documents_scored_on_first_page =
+        search_result_proto.query_stats().num_documents_scored();
+    std::vector<std::string> page_uris =
+        GetUrisFromSearchResults(search_result_proto);
+    uris.insert(uris.end(), page_uris.begin(), page_uris.end());
+    while (search_result_proto.next_page_token() != kInvalidNextPageToken) {
+      search_result_proto =
+          icing->GetNextPage(search_result_proto.next_page_token());
+      EXPECT_THAT(search_result_proto.status(), ProtoIsOk());
+      page_uris = GetUrisFromSearchResults(search_result_proto);
+      uris.insert(uris.end(), page_uris.begin(), page_uris.end());
+    }
+    return uris;
+  };
+  auto put_documents = [](IcingSearchEngine* icing) {
+    ASSERT_THAT(icing->SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+    for (int i = 0; i < 10; ++i) {
+      DocumentProto document =
+          DocumentBuilder(CreateMessageDocument("namespace",
+                                                "uri" + std::to_string(i)))
+              .SetScore((i * 7) % 10)
+              .Build();
+      ASSERT_THAT(icing->Put(document).status(), ProtoIsOk());
+    }
+    // Documents that are deleted must not show up in either tier.
+    ASSERT_THAT(icing->Delete("namespace", "uri3").status(), ProtoIsOk());
+  };
 
-  SearchSpecProto search_spec;
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  // Merge after every document so that the champion lists get built.
+  options.set_index_merge_size(1);
+
+  std::vector<std::string> expected_uris;
+  int num_documents_scored_without_champion_lists;
+  {
+    IcingSearchEngine icing(options, GetTestJniCache());
+    ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+    put_documents(&icing);
+    expected_uris =
+        search_all_pages(&icing, &num_documents_scored_without_champion_lists);
+    ASSERT_THAT(icing.Reset().status(), ProtoIsOk());
+  }
+  EXPECT_THAT(expected_uris, SizeIs(9));
+  EXPECT_THAT(num_documents_scored_without_champion_lists, Eq(9));
+
+  options.set_champion_list_size(3);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  put_documents(&icing);
+  int num_documents_scored_with_champion_lists;
+  EXPECT_THAT(
+      search_all_pages(&icing, &num_documents_scored_with_champion_lists),
+      Eq(expected_uris));
+  // Only the champions had to be scored for the first page.
+  EXPECT_THAT(num_documents_scored_with_champion_lists,
+              Lt(num_documents_scored_without_champion_lists));
+}
+
+TEST_F(IcingSearchEngineTest, NegativeChampionListSizeShouldReturnError) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_champion_list_size(-1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  EXPECT_THAT(icing.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, SearchWithNoScoringShouldReturnMultiplePages) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  // Creates and inserts 5 documents
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  DocumentProto document4 = CreateMessageDocument("namespace", "uri4");
+  DocumentProto document5 = CreateMessageDocument("namespace", "uri5");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document4).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document5).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
   search_spec.set_term_match_type(TermMatchType::PREFIX);
   search_spec.set_query("message");
 
@@ -2297,6 +2793,171 @@ TEST_F(IcingSearchEngineTest, SearchWithNoScoringShouldReturnMultiplePages) {
                                        expected_search_result_proto));
 }
 
+TEST_F(IcingSearchEngineTest, SearchWithPrefetchShouldReturnMultiplePages) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+  result_spec.set_prefetch_next_page(true);
+
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document3;
+  SearchResultProto search_result_proto =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  EXPECT_THAT(search_result_proto.next_page_token(), Gt(kInvalidNextPageToken));
+  uint64_t next_page_token = search_result_proto.next_page_token();
+  expected_search_result_proto.set_next_page_token(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+
+  // Whether or not the pages below have been prefetched by the time they're
+  // requested, they're the same.
+  expected_search_result_proto.clear_results();
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  search_result_proto = icing.GetNextPage(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+
+  expected_search_result_proto.clear_results();
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document1;
+  expected_search_result_proto.clear_next_page_token();
+  search_result_proto = icing.GetNextPage(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+
+  expected_search_result_proto.clear_results();
+  search_result_proto = icing.GetNextPage(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, SearchOnArenaShouldReturnSamePages) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+  result_spec.set_prefetch_next_page(true);
+  result_spec.mutable_snippet_spec()->set_num_to_snippet(3);
+  result_spec.mutable_snippet_spec()->set_num_matches_per_property(1);
+
+  google::protobuf::Arena arena;
+  SearchResultProto* search_result_proto =
+      google::protobuf::Arena::CreateMessage<SearchResultProto>(&arena);
+  icing.Search(search_spec, GetDefaultScoringSpec(), result_spec,
+               search_result_proto);
+  ASSERT_THAT(search_result_proto->status(), ProtoIsOk());
+  ASSERT_THAT(search_result_proto->results(), SizeIs(1));
+  EXPECT_THAT(search_result_proto->results(0).document(),
+              EqualsProto(document3));
+  EXPECT_THAT(search_result_proto->results(0).snippet().entries(), SizeIs(1));
+  uint64_t next_page_token = search_result_proto->next_page_token();
+  EXPECT_THAT(next_page_token, Gt(kInvalidNextPageToken));
+
+  // The remaining pages may have been prefetched off the arena already.
+  SearchResultProto* next_page_result_proto =
+      google::protobuf::Arena::CreateMessage<SearchResultProto>(&arena);
+  icing.GetNextPage(next_page_token, next_page_result_proto);
+  ASSERT_THAT(next_page_result_proto->status(), ProtoIsOk());
+  ASSERT_THAT(next_page_result_proto->results(), SizeIs(1));
+  EXPECT_THAT(next_page_result_proto->results(0).document(),
+              EqualsProto(document2));
+  EXPECT_THAT(next_page_result_proto->results(0).snippet().entries(),
+              SizeIs(1));
+
+  next_page_result_proto =
+      google::protobuf::Arena::CreateMessage<SearchResultProto>(&arena);
+  icing.GetNextPage(next_page_token, next_page_result_proto);
+  ASSERT_THAT(next_page_result_proto->status(), ProtoIsOk());
+  ASSERT_THAT(next_page_result_proto->results(), SizeIs(1));
+  EXPECT_THAT(next_page_result_proto->results(0).document(),
+              EqualsProto(document1));
+  EXPECT_THAT(next_page_result_proto->next_page_token(),
+              Eq(kInvalidNextPageToken));
+}
+
+TEST_F(IcingSearchEngineTest, WritesAreVisibleInPrefetchedPages) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document1 = CreateMessageDocument("namespace", "uri1");
+  DocumentProto document2 = CreateMessageDocument("namespace", "uri2");
+  DocumentProto document3 = CreateMessageDocument("namespace", "uri3");
+  DocumentProto document4 = CreateMessageDocument("namespace", "uri4");
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document4).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+  result_spec.set_prefetch_next_page(true);
+
+  SearchResultProto search_result_proto =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  ASSERT_THAT(search_result_proto.results(), SizeIs(1));
+  uint64_t next_page_token = search_result_proto.next_page_token();
+
+  // Gives the next page a chance to be prefetched before the write below. The
+  // page must reflect the write either way.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_THAT(icing.Delete("namespace", "uri3").status(), ProtoIsOk());
+
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  expected_search_result_proto.set_next_page_token(next_page_token);
+  search_result_proto = icing.GetNextPage(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+
+  // Replacing document1 drops it from the results of this query, which leaves
+  // no more results.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+
+  expected_search_result_proto.clear_results();
+  expected_search_result_proto.clear_next_page_token();
+  search_result_proto = icing.GetNextPage(next_page_token);
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+}
+
 TEST_F(IcingSearchEngineTest, ShouldReturnMultiplePagesWithSnippets) {
   IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
   ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
@@ -2576,6 +3237,7 @@ TEST_F(IcingSearchEngineTest, GetOptimizeInfoHasCorrectStats) {
     EXPECT_THAT(optimize_info.status(), ProtoIsOk());
     EXPECT_THAT(optimize_info.optimizable_docs(), Eq(0));
     EXPECT_THAT(optimize_info.estimated_optimizable_bytes(), Eq(0));
+    EXPECT_THAT(optimize_info.estimated_index_optimizable_bytes(), Eq(0));
     EXPECT_THAT(optimize_info.time_since_last_optimize_ms(), Eq(0));
 
     // Deletes document1
@@ -2586,6 +3248,8 @@ TEST_F(IcingSearchEngineTest, GetOptimizeInfoHasCorrectStats) {
     EXPECT_THAT(optimize_info.optimizable_docs(), Eq(1));
     EXPECT_THAT(optimize_info.estimated_optimizable_bytes(), Gt(0));
     EXPECT_THAT(optimize_info.time_since_last_optimize_ms(), Eq(0));
+    EXPECT_THAT(optimize_info.estimated_index_optimizable_bytes(),
+                Le(optimize_info.estimated_optimizable_bytes()));
     int64_t first_estimated_optimizable_bytes =
         optimize_info.estimated_optimizable_bytes();
 
@@ -2861,6 +3525,7 @@ TEST_F(IcingSearchEngineTest, DeleteBySchemaType) {
   DeleteStatsProto exp_stats;
   exp_stats.set_delete_type(DeleteStatsProto::DeleteType::SCHEMA_TYPE);
   exp_stats.set_latency_ms(7);
+  exp_stats.set_queue_wait_latency_ms(7);
   exp_stats.set_num_documents_deleted(1);
   EXPECT_THAT(result_proto.delete_stats(), EqualsProto(exp_stats));
 
@@ -2969,6 +3634,66 @@ TEST_F(IcingSearchEngineTest, DeleteSchemaTypeByQuery) {
                                        expected_search_result_proto));
 }
 
+TEST_F(IcingSearchEngineTest, DeleteByUriPrefix) {
+  DocumentProto document1 = CreateMessageDocument("namespace", "thread/1/a");
+  DocumentProto document2 = CreateMessageDocument("namespace", "thread/1/b");
+  DocumentProto document3 = CreateMessageDocument("namespace", "thread/2/a");
+
+  auto fake_clock = std::make_unique<FakeClock>();
+  fake_clock->SetTimerElapsedMilliseconds(7);
+  TestIcingSearchEngine icing(GetDefaultIcingOptions(),
+                              std::make_unique<Filesystem>(),
+                              std::make_unique<IcingFilesystem>(),
+                              std::move(fake_clock), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+
+  DeleteByUriPrefixResultProto result_proto =
+      icing.DeleteByUriPrefix("namespace", "thread/1/");
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+  DeleteStatsProto exp_stats;
+  exp_stats.set_delete_type(DeleteStatsProto::DeleteType::URI_PREFIX);
+  exp_stats.set_latency_ms(7);
+  exp_stats.set_queue_wait_latency_ms(7);
+  exp_stats.set_num_documents_deleted(2);
+  EXPECT_THAT(result_proto.delete_stats(), EqualsProto(exp_stats));
+
+  EXPECT_THAT(icing
+                  .Get("namespace", "thread/1/a",
+                       GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+  EXPECT_THAT(icing
+                  .Get("namespace", "thread/1/b",
+                       GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+  EXPECT_THAT(icing
+                  .Get("namespace", "thread/2/a",
+                       GetResultSpecProto::default_instance())
+                  .status(),
+              ProtoIsOk());
+
+  // The deleted documents don't match queries anymore.
+  SearchSpecProto search_spec;
+  search_spec.set_query("message");
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  SearchResultProto search_result_proto =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(search_result_proto.status(), ProtoIsOk());
+  ASSERT_THAT(search_result_proto.results(), SizeIs(1));
+  EXPECT_THAT(search_result_proto.results(0).document(),
+              EqualsProto(document3));
+
+  // Nothing is left to delete under the prefix.
+  EXPECT_THAT(icing.DeleteByUriPrefix("namespace", "thread/1/").status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+}
+
 TEST_F(IcingSearchEngineTest, DeleteByNamespace) {
   DocumentProto document1 =
       DocumentBuilder()
@@ -3029,6 +3754,7 @@ TEST_F(IcingSearchEngineTest, DeleteByNamespace) {
   DeleteStatsProto exp_stats;
   exp_stats.set_delete_type(DeleteStatsProto::DeleteType::NAMESPACE);
   exp_stats.set_latency_ms(7);
+  exp_stats.set_queue_wait_latency_ms(7);
   exp_stats.set_num_documents_deleted(2);
   EXPECT_THAT(result_proto.delete_stats(), EqualsProto(exp_stats));
 
@@ -3048,26 +3774,277 @@ TEST_F(IcingSearchEngineTest, DeleteByNamespace) {
       icing.Get("namespace1", "uri2", GetResultSpecProto::default_instance()),
       EqualsProto(expected_get_result_proto));
 
-  expected_get_result_proto.mutable_status()->set_code(StatusProto::OK);
-  expected_get_result_proto.mutable_status()->clear_message();
-  *expected_get_result_proto.mutable_document() = document3;
-  EXPECT_THAT(
-      icing.Get("namespace3", "uri3", GetResultSpecProto::default_instance()),
-      EqualsProto(expected_get_result_proto));
+  expected_get_result_proto.mutable_status()->set_code(StatusProto::OK);
+  expected_get_result_proto.mutable_status()->clear_message();
+  *expected_get_result_proto.mutable_document() = document3;
+  EXPECT_THAT(
+      icing.Get("namespace3", "uri3", GetResultSpecProto::default_instance()),
+      EqualsProto(expected_get_result_proto));
+
+  // Search for "message", only document3 should show up.
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document3;
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::EXACT_ONLY);
+  search_spec.set_query("message");
+  SearchResultProto search_result_proto =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
+                                       expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, DeleteByNamespaceDeletesDeadIndexTermsLater) {
+  DocumentProto document1 =
+      DocumentBuilder()
+          .SetKey("namespace1", "uri1")
+          .SetSchema("Message")
+          .AddStringProperty("body", "kiwi")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+  DocumentProto document2 =
+      DocumentBuilder()
+          .SetKey("namespace2", "uri2")
+          .SetSchema("Message")
+          .AddStringProperty("body", "mango")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+
+  // Merge the index after every document so that the terms reach the main
+  // index.
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_index_merge_size(1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+
+  // Dead terms are deleted in the background, whenever nothing else waits.
+  EXPECT_THAT(icing.DeleteByNamespace("namespace1").status(), ProtoIsOk());
+
+  // The index keeps working whether or not its lexicon was rebuilt yet.
+  DocumentProto document3 =
+      DocumentBuilder(document1).SetKey("namespace1", "uri3").Build();
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("ki");
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document3;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+
+  search_spec.set_query("mango");
+  expected_search_result_proto.clear_results();
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, DeleteByUriPrefixDeletesDeadIndexTermsLater) {
+  DocumentProto document1 =
+      DocumentBuilder()
+          .SetKey("namespace", "prefix/uri1")
+          .SetSchema("Message")
+          .AddStringProperty("body", "kiwi")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+  DocumentProto document2 =
+      DocumentBuilder()
+          .SetKey("namespace", "uri2")
+          .SetSchema("Message")
+          .AddStringProperty("body", "mango")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+
+  // Merge the index after every document so that the terms reach the main
+  // index.
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_index_merge_size(1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+
+  EXPECT_THAT(icing.DeleteByUriPrefix("namespace", "prefix/").status(),
+              ProtoIsOk());
+
+  // Puts and searches keep working while the dead terms are looked for.
+  DocumentProto document3 =
+      DocumentBuilder(document1).SetKey("namespace", "prefix/uri3").Build();
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("ki");
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document3;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+
+  search_spec.set_query("mango");
+  expected_search_result_proto.clear_results();
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, DeleteByNamespaceResetsNamespacePartition) {
+  DocumentProto document1 =
+      DocumentBuilder()
+          .SetKey("namespace1", "uri1")
+          .SetSchema("Message")
+          .AddStringProperty("body", "kiwi")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+  DocumentProto document2 =
+      DocumentBuilder()
+          .SetKey("namespace2", "uri2")
+          .SetSchema("Message")
+          .AddStringProperty("body", "kiwi")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_num_namespace_partitions(2);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document1).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(document2).status(), ProtoIsOk());
+
+  // The namespaces are in different partitions, so the partition of
+  // namespace1 is dropped instead of looking for dead terms.
+  DeleteByNamespaceResultProto result_proto =
+      icing.DeleteByNamespace("namespace1");
+  EXPECT_THAT(result_proto.status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("kiwi");
+  search_spec.add_namespace_filters("namespace2");
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+
+  // The partition keeps working after being dropped.
+  DocumentProto document3 =
+      DocumentBuilder(document1).SetKey("namespace1", "uri3").Build();
+  ASSERT_THAT(icing.Put(document3).status(), ProtoIsOk());
+  search_spec.clear_namespace_filters();
+  expected_search_result_proto.clear_results();
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document3;
+  *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+      document2;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, ChangingNumNamespacePartitionsRebuildsIndex) {
+  DocumentProto document =
+      DocumentBuilder()
+          .SetKey("namespace1", "uri1")
+          .SetSchema("Message")
+          .AddStringProperty("body", "kiwi")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  {
+    IcingSearchEngine icing(options, GetTestJniCache());
+    ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+    ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+    ASSERT_THAT(icing.Put(document).status(), ProtoIsOk());
+  }
+
+  options.set_num_namespace_partitions(3);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
 
-  // Search for "message", only document3 should show up.
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("kiwi");
+  search_spec.add_namespace_filters("namespace1");
   SearchResultProto expected_search_result_proto;
   expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
   *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
-      document3;
+      document;
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                           ResultSpecProto::default_instance()),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
+}
+
+TEST_F(IcingSearchEngineTest, InvalidNumNamespacePartitionsIsRejected) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_num_namespace_partitions(-1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  EXPECT_THAT(icing.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+
+  options.set_num_namespace_partitions(2);
+  options.set_champion_list_size(10);
+  IcingSearchEngine icing_with_champions(options, GetTestJniCache());
+  EXPECT_THAT(icing_with_champions.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, SegmentedMainIndexCompactsInTheBackground) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_segmented_main_index(true);
+  // Every Put merges into a new segment, which leaves runs of segments for
+  // the background compaction.
+  options.set_index_merge_size(1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  SearchResultProto expected_search_result_proto;
+  expected_search_result_proto.mutable_status()->set_code(StatusProto::OK);
+  for (int i = 0; i < 10; ++i) {
+    DocumentProto document =
+        CreateMessageDocument("namespace", "uri" + std::to_string(i));
+    ASSERT_THAT(icing.Put(document).status(), ProtoIsOk());
+    *expected_search_result_proto.mutable_results()->Add()->mutable_document() =
+        document;
+  }
+  std::reverse(expected_search_result_proto.mutable_results()->begin(),
+               expected_search_result_proto.mutable_results()->end());
+
   SearchSpecProto search_spec;
-  search_spec.set_term_match_type(TermMatchType::EXACT_ONLY);
-  search_spec.set_query("message");
-  SearchResultProto search_result_proto =
-      icing.Search(search_spec, GetDefaultScoringSpec(),
-                   ResultSpecProto::default_instance());
-  EXPECT_THAT(search_result_proto, EqualsSearchResultIgnoreStatsAndScores(
-                                       expected_search_result_proto));
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("mess");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(10);
+  EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(), result_spec),
+              EqualsSearchResultIgnoreStatsAndScores(
+                  expected_search_result_proto));
 }
 
 TEST_F(IcingSearchEngineTest, DeleteNamespaceByQuery) {
@@ -3189,6 +4166,7 @@ TEST_F(IcingSearchEngineTest, DeleteByQuery) {
   DeleteStatsProto exp_stats;
   exp_stats.set_delete_type(DeleteStatsProto::DeleteType::QUERY);
   exp_stats.set_latency_ms(7);
+  exp_stats.set_queue_wait_latency_ms(7);
   exp_stats.set_num_documents_deleted(1);
   EXPECT_THAT(result_proto.delete_stats(), EqualsProto(exp_stats));
 
@@ -5459,6 +6437,101 @@ TEST_F(IcingSearchEngineTest, PersistToDisk) {
       EqualsProto(expected_get_result_proto));
 }
 
+TEST_F(IcingSearchEngineTest, TrimMemoryBeforeInitializeFails) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  EXPECT_THAT(icing.TrimMemory(TrimMemoryLevel::LOW).status(),
+              ProtoStatusIs(StatusProto::FAILED_PRECONDITION));
+}
+
+TEST_F(IcingSearchEngineTest, TrimMemoryUnknownLevelFails) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  EXPECT_THAT(icing.TrimMemory(TrimMemoryLevel::UNKNOWN).status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
+}
+
+TEST_F(IcingSearchEngineTest, TrimMemoryModerateKeepsMostRecentResultState) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri1")).status(),
+              ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri2")).status(),
+              ProtoIsOk());
+  ASSERT_THAT(icing.PersistToDisk(PersistType::FULL).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+
+  SearchResultProto older_results =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  ASSERT_THAT(older_results.status(), ProtoIsOk());
+  SearchResultProto newer_results =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  ASSERT_THAT(newer_results.status(), ProtoIsOk());
+
+  TrimMemoryResultProto trim_result =
+      icing.TrimMemory(TrimMemoryLevel::MODERATE);
+  EXPECT_THAT(trim_result.status(), ProtoIsOk());
+  EXPECT_THAT(trim_result.released_result_state_bytes(),
+              Eq(sizeof(ScoredDocumentHit)));
+
+  // The older query's remaining results have been dropped.
+  EXPECT_THAT(icing.GetNextPage(older_results.next_page_token()).results(),
+              IsEmpty());
+  EXPECT_THAT(icing.GetNextPage(newer_results.next_page_token()).results(),
+              SizeIs(1));
+
+  // Everything that was released is brought back in as needed.
+  SearchResultProto results =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(results.status(), ProtoIsOk());
+  EXPECT_THAT(results.results(), SizeIs(2));
+  EXPECT_THAT(
+      icing.Get("namespace", "uri1", GetResultSpecProto::default_instance())
+          .status(),
+      ProtoIsOk());
+}
+
+TEST_F(IcingSearchEngineTest, TrimMemoryCriticalDropsAllResultStates) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri1")).status(),
+              ProtoIsOk());
+  ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", "uri2")).status(),
+              ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+
+  SearchResultProto results =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  ASSERT_THAT(results.status(), ProtoIsOk());
+
+  // Lower levels don't touch result states.
+  TrimMemoryResultProto trim_result = icing.TrimMemory(TrimMemoryLevel::LOW);
+  EXPECT_THAT(trim_result.status(), ProtoIsOk());
+  EXPECT_THAT(trim_result.released_mapped_bytes(), Eq(0));
+  EXPECT_THAT(trim_result.released_result_state_bytes(), Eq(0));
+
+  trim_result = icing.TrimMemory(TrimMemoryLevel::CRITICAL);
+  EXPECT_THAT(trim_result.status(), ProtoIsOk());
+  EXPECT_THAT(trim_result.released_result_state_bytes(),
+              Eq(sizeof(ScoredDocumentHit)));
+  EXPECT_THAT(icing.GetNextPage(results.next_page_token()).results(),
+              IsEmpty());
+}
+
 TEST_F(IcingSearchEngineTest, NoPersistToDiskLiteDoesntPersistPut) {
   IcingSearchEngine icing1(GetDefaultIcingOptions(), GetTestJniCache());
   EXPECT_THAT(icing1.Initialize().status(), ProtoIsOk());
@@ -6930,6 +8003,332 @@ TEST_F(IcingSearchEngineTest, PutDocumentShouldLogFunctionLatency) {
   PutResultProto put_result_proto = icing.Put(document);
   EXPECT_THAT(put_result_proto.status(), ProtoIsOk());
   EXPECT_THAT(put_result_proto.put_document_stats().latency_ms(), Eq(10));
+  EXPECT_THAT(put_result_proto.put_document_stats().queue_wait_latency_ms(),
+              Eq(10));
+}
+
+TEST_F(IcingSearchEngineTest, ConcurrentSearchesSeeConsistentResults) {
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  constexpr int kNumDocuments = 100;
+  constexpr int kNumReaders = 4;
+  std::atomic<int> num_documents_put(0);
+  std::thread writer([&icing, &num_documents_put]() {
+    for (int i = 0; i < kNumDocuments; ++i) {
+      DocumentProto document =
+          CreateMessageDocument("namespace", "uri" + std::to_string(i));
+      EXPECT_THAT(icing.Put(document).status(), ProtoIsOk());
+      num_documents_put.store(i + 1, std::memory_order_release);
+    }
+  });
+
+  // Every search sees at least the documents put before it started, and never
+  // fewer than an earlier search of the same thread did.
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(kNumDocuments);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kNumReaders; ++i) {
+    readers.emplace_back([&]() {
+      int last_num_results = 0;
+      while (last_num_results < kNumDocuments) {
+        int min_num_results =
+            num_documents_put.load(std::memory_order_acquire);
+        SearchResultProto search_result =
+            icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+        ASSERT_THAT(search_result.status(), ProtoIsOk());
+        int num_results = search_result.results_size();
+        EXPECT_THAT(num_results, Ge(min_num_results));
+        EXPECT_THAT(num_results, Ge(last_num_results));
+        last_num_results = num_results;
+      }
+    });
+  }
+  writer.join();
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+}
+
+TEST_F(IcingSearchEngineTest, PriorityScheduledCallsAllComplete) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_priority_scheduling(true);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  constexpr int kNumWriters = 2;
+  constexpr int kNumDocumentsPerWriter = 50;
+  std::vector<std::thread> writers;
+  for (int i = 0; i < kNumWriters; ++i) {
+    writers.emplace_back([&icing, i]() {
+      for (int j = 0; j < kNumDocumentsPerWriter; ++j) {
+        DocumentProto document = CreateMessageDocument(
+            "namespace",
+            "uri" + std::to_string(i) + "_" + std::to_string(j));
+        EXPECT_THAT(icing
+                        .Put(std::move(document),
+                             OperationPriority::kBackgroundWrite)
+                        .status(),
+                    ProtoIsOk());
+      }
+    });
+  }
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  for (int i = 0; i < 20; ++i) {
+    SearchResultProto search_result =
+        icing.Search(search_spec, GetDefaultScoringSpec(),
+                     ResultSpecProto::default_instance());
+    EXPECT_THAT(search_result.status(), ProtoIsOk());
+    EXPECT_TRUE(search_result.query_stats().has_queue_wait_latency_ms());
+  }
+  for (std::thread& writer : writers) {
+    writer.join();
+  }
+
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(kNumWriters * kNumDocumentsPerWriter);
+  SearchResultProto search_result =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  EXPECT_THAT(search_result.status(), ProtoIsOk());
+  EXPECT_THAT(search_result.results(),
+              SizeIs(kNumWriters * kNumDocumentsPerWriter));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingSearchSeesOwnWrites) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(100);
+
+  for (int i = 0; i < 20; ++i) {
+    PutResultProto put_result = icing.Put(
+        CreateMessageDocument("namespace", "uri" + std::to_string(i)));
+    ASSERT_THAT(put_result.status(), ProtoIsOk());
+    // Indexing happens after Put returns.
+    EXPECT_FALSE(put_result.put_document_stats().has_index_latency_ms());
+
+    // Whether or not the background thread got to it yet, the document has to
+    // show up.
+    SearchResultProto search_result =
+        icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+    ASSERT_THAT(search_result.status(), ProtoIsOk());
+    EXPECT_THAT(search_result.results(), SizeIs(i + 1));
+  }
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingSearchesRunAlongsidePuts) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  // The last search has to see all documents, however far behind the
+  // background thread is.
+  options.set_max_search_catch_up_documents(-1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(100);
+
+  constexpr int kNumReaders = 4;
+  constexpr int kNumDocuments = 50;
+  std::atomic<bool> done_writing(false);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kNumReaders; ++i) {
+    readers.emplace_back([&]() {
+      while (!done_writing) {
+        EXPECT_THAT(icing.Search(search_spec, GetDefaultScoringSpec(),
+                                 result_spec)
+                        .status(),
+                    ProtoIsOk());
+      }
+    });
+  }
+  // Back-to-back searches must not keep the puts waiting.
+  for (int i = 0; i < kNumDocuments; ++i) {
+    EXPECT_THAT(
+        icing.Put(CreateMessageDocument("namespace", "uri" + std::to_string(i)))
+            .status(),
+        ProtoIsOk());
+  }
+  done_writing = true;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+
+  SearchResultProto search_result =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  EXPECT_THAT(search_result.status(), ProtoIsOk());
+  EXPECT_THAT(search_result.results(), SizeIs(kNumDocuments));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingSkipsDeletedDocuments) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  options.set_max_search_catch_up_documents(-1);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  for (int i = 0; i < 10; ++i) {
+    std::string uri = "uri" + std::to_string(i);
+    ASSERT_THAT(icing.Put(CreateMessageDocument("namespace", uri)).status(),
+                ProtoIsOk());
+    ASSERT_THAT(icing.Delete("namespace", uri).status(), ProtoIsOk());
+  }
+  ASSERT_THAT(
+      icing.Put(CreateMessageDocument("namespace", "kept")).status(),
+      ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  SearchResultProto search_result =
+      icing.Search(search_spec, GetDefaultScoringSpec(),
+                   ResultSpecProto::default_instance());
+  EXPECT_THAT(search_result.status(), ProtoIsOk());
+  ASSERT_THAT(search_result.results(), SizeIs(1));
+  EXPECT_THAT(search_result.results(0).document().uri(), Eq("kept"));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingPutStillValidatesDocuments) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  DocumentProto document = CreateMessageDocument("namespace", "uri");
+  document.set_schema("UnknownType");
+  EXPECT_THAT(icing.Put(document).status(),
+              ProtoStatusIs(StatusProto::NOT_FOUND));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingFillsInDocumentLength) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+  DocumentProto long_document =
+      DocumentBuilder()
+          .SetKey("namespace", "long")
+          .SetSchema("Message")
+          .AddStringProperty("body", "message with many more words in it")
+          .SetCreationTimestampMs(kDefaultCreationTimestampMs)
+          .Build();
+  ASSERT_THAT(icing.Put(long_document).status(), ProtoIsOk());
+  ASSERT_THAT(
+      icing.Put(CreateMessageDocument("namespace", "short")).status(),
+      ProtoIsOk());
+
+  // Put didn't know the lengths of the documents yet. BM25F only ranks the
+  // shorter document first if they were filled in when they were indexed.
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ScoringSpecProto scoring_spec = GetDefaultScoringSpec();
+  scoring_spec.set_rank_by(
+      ScoringSpecProto::RankingStrategy::RELEVANCE_SCORE);
+  SearchResultProto search_result = icing.Search(
+      search_spec, scoring_spec, ResultSpecProto::default_instance());
+  ASSERT_THAT(search_result.status(), ProtoIsOk());
+  ASSERT_THAT(search_result.results(), SizeIs(2));
+  EXPECT_THAT(search_result.results(0).document().uri(), Eq("short"));
+  EXPECT_THAT(search_result.results(0).score(),
+              Gt(search_result.results(1).score()));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingCatchesUpOnNextInitialize) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  {
+    IcingSearchEngine icing(options, GetTestJniCache());
+    ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+    ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+    for (int i = 0; i < 50; ++i) {
+      ASSERT_THAT(icing
+                      .Put(CreateMessageDocument("namespace",
+                                                 "uri" + std::to_string(i)))
+                      .status(),
+                  ProtoIsOk());
+    }
+    // Destroyed right away, most likely with documents left to index.
+  }
+
+  IcingSearchEngine icing(GetDefaultIcingOptions(), GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(100);
+  SearchResultProto search_result =
+      icing.Search(search_spec, GetDefaultScoringSpec(), result_spec);
+  EXPECT_THAT(search_result.status(), ProtoIsOk());
+  EXPECT_THAT(search_result.results(), SizeIs(50));
+}
+
+TEST_F(IcingSearchEngineTest, AsyncIndexingDeleteByQuerySeesPendingDocuments) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_enable_async_indexing(true);
+  // Searches don't index anything themselves, so only DeleteByQuery can make
+  // sure that the documents it deletes are indexed.
+  options.set_max_search_catch_up_documents(0);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  ASSERT_THAT(icing.Initialize().status(), ProtoIsOk());
+  ASSERT_THAT(icing.SetSchema(CreateMessageSchema()).status(), ProtoIsOk());
+
+  constexpr int kNumDocuments = 50;
+  for (int i = 0; i < kNumDocuments; ++i) {
+    ASSERT_THAT(icing
+                    .Put(CreateMessageDocument("namespace",
+                                               "uri" + std::to_string(i)))
+                    .status(),
+                ProtoIsOk());
+  }
+
+  SearchSpecProto search_spec;
+  search_spec.set_term_match_type(TermMatchType::PREFIX);
+  search_spec.set_query("message");
+  DeleteByQueryResultProto delete_result = icing.DeleteByQuery(search_spec);
+  ASSERT_THAT(delete_result.status(), ProtoIsOk());
+  EXPECT_THAT(delete_result.delete_stats().num_documents_deleted(),
+              Eq(kNumDocuments));
+
+  for (int i = 0; i < kNumDocuments; ++i) {
+    EXPECT_THAT(icing
+                    .Get("namespace", "uri" + std::to_string(i),
+                         GetResultSpecProto::default_instance())
+                    .status(),
+                ProtoStatusIs(StatusProto::NOT_FOUND));
+  }
+}
+
+TEST_F(IcingSearchEngineTest, InvalidMaxSearchCatchUpDocumentsIsRejected) {
+  IcingSearchEngineOptions options = GetDefaultIcingOptions();
+  options.set_max_search_catch_up_documents(-2);
+  IcingSearchEngine icing(options, GetTestJniCache());
+  EXPECT_THAT(icing.Initialize().status(),
+              ProtoStatusIs(StatusProto::INVALID_ARGUMENT));
 }
 
 TEST_F(IcingSearchEngineTest, PutDocumentShouldLogDocumentStoreStats) {
@@ -7297,6 +8696,7 @@ TEST_F(IcingSearchEngineTest, QueryStatsProtoTest) {
   exp_stats.set_num_documents_scored(5);
   exp_stats.set_num_results_with_snippets(2);
   exp_stats.set_latency_ms(5);
+  exp_stats.set_queue_wait_latency_ms(5);
   exp_stats.set_parse_query_latency_ms(5);
   exp_stats.set_scoring_latency_ms(5);
   exp_stats.set_ranking_latency_ms(5);
@@ -7315,6 +8715,7 @@ TEST_F(IcingSearchEngineTest, QueryStatsProtoTest) {
   exp_stats.set_num_results_returned_current_page(2);
   exp_stats.set_num_results_with_snippets(1);
   exp_stats.set_latency_ms(5);
+  exp_stats.set_queue_wait_latency_ms(5);
   exp_stats.set_document_retrieval_latency_ms(5);
   EXPECT_THAT(search_result.query_stats(), EqualsProto(exp_stats));
 
@@ -7330,6 +8731,7 @@ TEST_F(IcingSearchEngineTest, QueryStatsProtoTest) {
   exp_stats.set_num_results_returned_current_page(1);
   exp_stats.set_num_results_with_snippets(0);
   exp_stats.set_latency_ms(5);
+  exp_stats.set_queue_wait_latency_ms(5);
   exp_stats.set_document_retrieval_latency_ms(5);
   EXPECT_THAT(search_result.query_stats(), EqualsProto(exp_stats));
 }
@@ -7362,6 +8764,7 @@ TEST_F(IcingSearchEngineTest, OptimizeStatsProtoTest) {
 
   OptimizeStatsProto expected;
   expected.set_latency_ms(5);
+  expected.set_queue_wait_latency_ms(5);
   expected.set_document_store_optimize_latency_ms(5);
   expected.set_index_restoration_latency_ms(5);
   expected.set_num_original_documents(3);
@@ -7393,6 +8796,7 @@ TEST_F(IcingSearchEngineTest, OptimizeStatsProtoTest) {
 
   expected = OptimizeStatsProto();
   expected.set_latency_ms(5);
+  expected.set_queue_wait_latency_ms(5);
   expected.set_document_store_optimize_latency_ms(5);
   expected.set_index_restoration_latency_ms(5);
   expected.set_num_original_documents(1);
@@ -35,7 +35,10 @@ enum FlagOffset {
   kHasTermFrequency = 2,
   kNumFlags = 3,
 };
-static_assert(kDocumentIdBits + kSectionIdBits + kNumFlags <=
+// At least the most significant bit must stay unused. Otherwise a hit for
+// document_id 0 in kMaxSectionId with all flags set would have every bit set
+// and be indistinguishable from Hit::kInvalidValue.
+static_assert(kDocumentIdBits + kSectionIdBits + kNumFlags <
                   sizeof(Hit::Value) * 8,
               "HitOverflow");
 
@@ -86,7 +86,7 @@ class Hit {
 
  private:
   // Value and TermFrequency must be in this order.
-  // Value bits layout: 5 unused + 20 document_id + 4 section id + 3 flags.
+  // Value bits layout: 1 unused + 24 document_id + 4 section id + 3 flags.
   Value value_;
   TermFrequency term_frequency_;
 } __attribute__((packed));
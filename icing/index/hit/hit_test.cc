@@ -101,6 +101,23 @@ TEST(HitTest, Valid) {
 
   Hit minimum_section_id_hit(0, kSomeDocumentId, kSomeTermFrequency);
   EXPECT_THAT(minimum_section_id_hit.is_valid(), IsTrue());
+
+  // The hit with every encoded bit set must not collide with kInvalidValue.
+  Hit all_bits_set_hit(kMaxSectionId, 0, kSomeTermFrequency,
+                       /*is_in_prefix_section=*/true, /*is_prefix_hit=*/true);
+  EXPECT_THAT(all_bits_set_hit.is_valid(), IsTrue());
+}
+
+TEST(HitTest, DocumentIdRoundTripsAcrossFullRange) {
+  for (DocumentId document_id :
+       {kMinDocumentId, DocumentId{1} << 20, kMaxDocumentId}) {
+    Hit hit(kMaxSectionId, document_id, kSomeTermFrequency,
+            /*is_in_prefix_section=*/true, /*is_prefix_hit=*/true);
+    EXPECT_THAT(hit.document_id(), Eq(document_id));
+    EXPECT_THAT(hit.section_id(), Eq(kMaxSectionId));
+    EXPECT_THAT(hit.is_in_prefix_section(), IsTrue());
+    EXPECT_THAT(hit.is_prefix_hit(), IsTrue());
+  }
 }
 
 TEST(HitTest, Comparison) {
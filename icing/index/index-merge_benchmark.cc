@@ -0,0 +1,238 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "testing/base/public/benchmark.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/index.h"
+#include "icing/legacy/index/icing-filesystem.h"
+#include "icing/proto/logging.pb.h"
+#include "icing/proto/term.pb.h"
+#include "icing/schema/section.h"
+#include "icing/store/document-id.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+
+// This is a benchmark for Index::Merge, which merges the lite index into the
+// main index. Documents are made of terms drawn from a vocabulary with a
+// Zipfian distribution, like words in natural language, and the terms share
+// prefixes so that merges add branch points and backfill them.
+//
+// The benchmark first merges a few batches of documents so that the main index
+// isn't empty, then measures merging one batch of documents at a time. The
+// averages of the merge stats are reported as counters.
+//
+// Run on a Linux workstation:
+//    $ blaze build -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/index:index-merge_benchmark
+//
+//    $ blaze-bin/icing/index/index-merge_benchmark --benchmarks=all
+//
+// Run on an Android device:
+//    $ blaze build --copt="-DGOOGLE_COMMANDLINEFLAGS_FULL_API=1"
+//    --config=android_arm64 -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/index:index-merge_benchmark
+//
+//    $ adb push blaze-bin/icing/index/index-merge_benchmark /data/local/tmp/
+//
+//    $ adb shell /data/local/tmp/index-merge_benchmark --benchmarks=all
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+constexpr int kNumTermsPerDocument = 200;
+constexpr int kNumPrefillMerges = 5;
+
+// Returns num_terms distinct terms made of one to four syllables, so that
+// terms share prefixes the way words do.
+std::vector<std::string> CreateVocabulary(int num_terms) {
+  static constexpr char kOnsets[] = "bcdfghjklmnprstvwz";
+  static constexpr char kVowels[] = "aeiou";
+  std::mt19937 random(/*seed=*/12345);
+  std::uniform_int_distribution<int> num_syllables_distribution(1, 4);
+  std::uniform_int_distribution<int> onset_distribution(0,
+                                                        sizeof(kOnsets) - 2);
+  std::uniform_int_distribution<int> vowel_distribution(0,
+                                                        sizeof(kVowels) - 2);
+  std::unordered_set<std::string> seen;
+  std::vector<std::string> terms;
+  terms.reserve(num_terms);
+  while (static_cast<int>(terms.size()) < num_terms) {
+    std::string term;
+    int num_syllables = num_syllables_distribution(random);
+    for (int i = 0; i < num_syllables; ++i) {
+      term.push_back(kOnsets[onset_distribution(random)]);
+      term.push_back(kVowels[vowel_distribution(random)]);
+    }
+    if (seen.insert(term).second) {
+      terms.push_back(std::move(term));
+    }
+  }
+  return terms;
+}
+
+// Draws terms from a vocabulary, with the i-th term being drawn with a
+// probability proportional to 1 / (i + 1).
+class ZipfianTermSampler {
+ public:
+  explicit ZipfianTermSampler(const std::vector<std::string>* vocabulary)
+      : vocabulary_(*vocabulary), random_(/*seed=*/54321) {
+    std::vector<double> weights;
+    weights.reserve(vocabulary_.size());
+    for (size_t i = 0; i < vocabulary_.size(); ++i) {
+      weights.push_back(1.0 / (i + 1));
+    }
+    distribution_ =
+        std::discrete_distribution<int>(weights.begin(), weights.end());
+  }
+
+  const std::string& Sample() { return vocabulary_[distribution_(random_)]; }
+
+ private:
+  const std::vector<std::string>& vocabulary_;
+  std::mt19937 random_;
+  std::discrete_distribution<int> distribution_;
+};
+
+// Adds num_documents documents to the lite index, starting at
+// *next_document_id.
+void AddDocuments(Index* index, ZipfianTermSampler* sampler, int num_documents,
+                  DocumentId* next_document_id) {
+  for (int i = 0; i < num_documents; ++i) {
+    DocumentId document_id = (*next_document_id)++;
+    SectionId section_id = document_id % (kMaxSectionId + 1);
+    Index::Editor editor =
+        index->Edit(document_id, section_id, TermMatchType::PREFIX,
+                    /*namespace_id=*/0);
+    for (int j = 0; j < kNumTermsPerDocument; ++j) {
+      ICING_ASSERT_OK(editor.BufferTerm(sampler->Sample().c_str()));
+    }
+    ICING_ASSERT_OK(editor.IndexAllBufferedTerms());
+    index->set_last_added_document_id(document_id);
+  }
+}
+
+// Adds the stats of one merge to the running totals.
+void AddMergeStats(const IndexMergeStatsProto& merge_stats,
+                   IndexMergeStatsProto* totals) {
+  totals->set_num_lite_hits(totals->num_lite_hits() +
+                            merge_stats.num_lite_hits());
+  totals->set_num_new_main_terms(totals->num_new_main_terms() +
+                                 merge_stats.num_new_main_terms());
+  totals->set_num_branch_points_added(totals->num_branch_points_added() +
+                                      merge_stats.num_branch_points_added());
+  totals->set_num_backfill_hits(totals->num_backfill_hits() +
+                                merge_stats.num_backfill_hits());
+  totals->set_num_posting_lists_allocated(
+      totals->num_posting_lists_allocated() +
+      merge_stats.num_posting_lists_allocated());
+  totals->set_num_posting_lists_moved(totals->num_posting_lists_moved() +
+                                      merge_stats.num_posting_lists_moved());
+  totals->set_num_blocks_touched(totals->num_blocks_touched() +
+                                 merge_stats.num_blocks_touched());
+  totals->set_posting_list_bytes_allocated(
+      totals->posting_list_bytes_allocated() +
+      merge_stats.posting_list_bytes_allocated());
+  totals->set_bytes_written(totals->bytes_written() +
+                            merge_stats.bytes_written());
+  totals->set_merge_lexicon_latency_ms(totals->merge_lexicon_latency_ms() +
+                                       merge_stats.merge_lexicon_latency_ms());
+  totals->set_translate_and_expand_latency_ms(
+      totals->translate_and_expand_latency_ms() +
+      merge_stats.translate_and_expand_latency_ms());
+  totals->set_add_hits_latency_ms(totals->add_hits_latency_ms() +
+                                  merge_stats.add_hits_latency_ms());
+  totals->set_reset_latency_ms(totals->reset_latency_ms() +
+                               merge_stats.reset_latency_ms());
+}
+
+void BM_Merge(benchmark::State& state) {
+  int num_terms = state.range(0);
+  int num_documents_per_merge = state.range(1);
+
+  Filesystem filesystem;
+  IcingFilesystem icing_filesystem;
+  std::string index_dir = GetTestTempDir() + "/index_merge_benchmark";
+  filesystem.DeleteDirectoryRecursively(index_dir.c_str());
+  Index::Options options(index_dir, /*index_merge_size=*/4 * 1024 * 1024);
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<Index> index,
+      Index::Create(options, &filesystem, &icing_filesystem));
+
+  std::vector<std::string> vocabulary = CreateVocabulary(num_terms);
+  ZipfianTermSampler sampler(&vocabulary);
+  DocumentId next_document_id = 0;
+  for (int i = 0; i < kNumPrefillMerges; ++i) {
+    AddDocuments(index.get(), &sampler, num_documents_per_merge,
+                 &next_document_id);
+    ICING_ASSERT_OK(index->Merge());
+  }
+
+  IndexMergeStatsProto totals;
+  for (auto _ : state) {
+    state.PauseTiming();
+    if (next_document_id + num_documents_per_merge > kMaxDocumentId) {
+      state.SkipWithError("Ran out of document ids");
+      break;
+    }
+    AddDocuments(index.get(), &sampler, num_documents_per_merge,
+                 &next_document_id);
+    state.ResumeTiming();
+
+    IndexMergeStatsProto merge_stats;
+    ICING_ASSERT_OK(index->Merge(&merge_stats));
+    AddMergeStats(merge_stats, &totals);
+  }
+
+  auto average = [](double total) {
+    return benchmark::Counter(total, benchmark::Counter::kAvgIterations);
+  };
+  state.counters["lite_hits"] = average(totals.num_lite_hits());
+  state.counters["new_terms"] = average(totals.num_new_main_terms());
+  state.counters["branch_points"] = average(totals.num_branch_points_added());
+  state.counters["backfill_hits"] = average(totals.num_backfill_hits());
+  state.counters["pl_allocated"] =
+      average(totals.num_posting_lists_allocated());
+  state.counters["pl_moved"] = average(totals.num_posting_lists_moved());
+  state.counters["blocks_touched"] = average(totals.num_blocks_touched());
+  state.counters["pl_bytes_allocated"] =
+      average(totals.posting_list_bytes_allocated());
+  state.counters["bytes_written"] = average(totals.bytes_written());
+  state.counters["lexicon_ms"] = average(totals.merge_lexicon_latency_ms());
+  state.counters["translate_ms"] =
+      average(totals.translate_and_expand_latency_ms());
+  state.counters["add_hits_ms"] = average(totals.add_hits_latency_ms());
+  state.counters["reset_ms"] = average(totals.reset_latency_ms());
+
+  index.reset();
+  filesystem.DeleteDirectoryRecursively(index_dir.c_str());
+}
+BENCHMARK(BM_Merge)
+    ->ArgPair(10000, 100)
+    ->ArgPair(10000, 1000)
+    ->ArgPair(100000, 100)
+    ->ArgPair(100000, 1000);
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
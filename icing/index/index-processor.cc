@@ -55,7 +55,7 @@ IndexProcessor::Create(const Normalizer* normalizer, Index* index,
 
 libtextclassifier3::Status IndexProcessor::IndexDocument(
     const TokenizedDocument& tokenized_document, DocumentId document_id,
-    PutDocumentStatsProto* put_document_stats) {
+    NamespaceId namespace_id, PutDocumentStatsProto* put_document_stats) {
   std::unique_ptr<Timer> index_timer = clock_.GetNewTimer();
 
   if (index_->last_added_document_id() != kInvalidDocumentId &&
@@ -68,10 +68,9 @@ libtextclassifier3::Status IndexProcessor::IndexDocument(
   uint32_t num_tokens = 0;
   libtextclassifier3::Status overall_status;
   for (const TokenizedSection& section : tokenized_document.sections()) {
-    // TODO(b/152934343): pass real namespace ids in
     Index::Editor editor =
         index_->Edit(document_id, section.metadata.id,
-                     section.metadata.term_match_type, /*namespace_id=*/0);
+                     section.metadata.term_match_type, namespace_id);
     for (std::string_view token : section.token_sequence) {
       if (++num_tokens > options_.max_tokens_per_document) {
         // Index all tokens buffered so far.
@@ -128,7 +127,10 @@ libtextclassifier3::Status IndexProcessor::IndexDocument(
     ICING_VLOG(1) << "Merging the index at docid " << document_id << ".";
 
     std::unique_ptr<Timer> merge_timer = clock_.GetNewTimer();
-    libtextclassifier3::Status merge_status = index_->Merge();
+    libtextclassifier3::Status merge_status =
+        index_->Merge(put_document_stats != nullptr
+                          ? put_document_stats->mutable_index_merge_stats()
+                          : nullptr);
 
     if (!merge_status.ok()) {
       ICING_LOG(ERROR) << "Index merging failed. Clearing index.";
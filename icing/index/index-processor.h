@@ -23,6 +23,7 @@
 #include "icing/proto/document.pb.h"
 #include "icing/schema/section-manager.h"
 #include "icing/store/document-id.h"
+#include "icing/store/namespace-id.h"
 #include "icing/tokenization/token.h"
 #include "icing/transform/normalizer.h"
 #include "icing/util/tokenized-document.h"
@@ -60,7 +61,8 @@ class IndexProcessor {
       const Normalizer* normalizer, Index* index, const Options& options,
       const Clock* clock);
 
-  // Add tokenized document to the index, associated with document_id. If the
+  // Add tokenized document to the index, associated with document_id and
+  // namespace_id, which decides the partition of a partitioned index. If the
   // number of tokens in the document exceeds max_tokens_per_document, then only
   // the first max_tokens_per_document will be added to the index. All tokens of
   // length exceeding max_token_length will be shortened to max_token_length.
@@ -81,6 +83,7 @@ class IndexProcessor {
   //   INTERNAL_ERROR if any other errors occur
   libtextclassifier3::Status IndexDocument(
       const TokenizedDocument& tokenized_document, DocumentId document_id,
+      NamespaceId namespace_id = 0,
       PutDocumentStatsProto* put_document_stats = nullptr);
 
  private:
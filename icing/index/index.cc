@@ -14,10 +14,16 @@
 
 #include "icing/index/index.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
@@ -29,6 +35,8 @@
 #include "icing/index/lite/doc-hit-info-iterator-term-lite.h"
 #include "icing/index/lite/lite-index.h"
 #include "icing/index/main/doc-hit-info-iterator-term-main.h"
+#include "icing/index/main/doc-hit-info-iterator-term-segmented.h"
+#include "icing/index/main/main-index-merger.h"
 #include "icing/index/term-id-codec.h"
 #include "icing/index/term-property-id.h"
 #include "icing/legacy/core/icing-string-util.h"
@@ -37,6 +45,7 @@
 #include "icing/proto/term.pb.h"
 #include "icing/schema/section.h"
 #include "icing/store/document-id.h"
+#include "icing/util/clock.h"
 #include "icing/util/logging.h"
 #include "icing/util/status-macros.h"
 
@@ -64,6 +73,86 @@ std::string MakeMainIndexFilepath(const std::string& base_dir) {
   return base_dir + "/idx/main";
 }
 
+std::string MakeSegmentedMainIndexFilepath(const std::string& base_dir) {
+  return base_dir + "/idx/segments";
+}
+
+std::string MakeUnpartitionedIndexDirPath(const std::string& base_dir) {
+  return base_dir + "/idx";
+}
+
+std::string MakePartitionsDirPath(const std::string& base_dir) {
+  return base_dir + "/partitions";
+}
+
+std::string MakePartitionDirPath(const std::string& base_dir, int partition) {
+  return absl_ports::StrCat(MakePartitionsDirPath(base_dir), "/",
+                            std::to_string(partition));
+}
+
+// Holds the number of partitions the partitions directory was created with.
+std::string MakeNumPartitionsFilepath(const std::string& base_dir) {
+  return MakePartitionsDirPath(base_dir) + "/num_partitions";
+}
+
+// Adds the sizes a and b, which are -1 if unknown.
+int64_t AddSizes(int64_t a, int64_t b) {
+  if (a < 0 || b < 0) {
+    return -1;
+  }
+  return a + b;
+}
+
+// Adds the stats of the merge of one partition to merge_stats.
+void AddMergeStats(const IndexMergeStatsProto& partition_merge_stats,
+                   IndexMergeStatsProto* merge_stats) {
+  merge_stats->set_num_lite_hits(merge_stats->num_lite_hits() +
+                                 partition_merge_stats.num_lite_hits());
+  merge_stats->set_num_lite_terms(merge_stats->num_lite_terms() +
+                                  partition_merge_stats.num_lite_terms());
+  merge_stats->set_num_new_main_terms(
+      merge_stats->num_new_main_terms() +
+      partition_merge_stats.num_new_main_terms());
+  merge_stats->set_num_branch_points_added(
+      merge_stats->num_branch_points_added() +
+      partition_merge_stats.num_branch_points_added());
+  merge_stats->set_num_backfill_hits(merge_stats->num_backfill_hits() +
+                                     partition_merge_stats.num_backfill_hits());
+  merge_stats->set_backfill_bytes(merge_stats->backfill_bytes() +
+                                  partition_merge_stats.backfill_bytes());
+  merge_stats->set_num_pending_backfills(
+      merge_stats->num_pending_backfills() +
+      partition_merge_stats.num_pending_backfills());
+  merge_stats->set_num_posting_lists_allocated(
+      merge_stats->num_posting_lists_allocated() +
+      partition_merge_stats.num_posting_lists_allocated());
+  merge_stats->set_num_posting_lists_freed(
+      merge_stats->num_posting_lists_freed() +
+      partition_merge_stats.num_posting_lists_freed());
+  merge_stats->set_num_posting_lists_moved(
+      merge_stats->num_posting_lists_moved() +
+      partition_merge_stats.num_posting_lists_moved());
+  merge_stats->set_num_blocks_touched(
+      merge_stats->num_blocks_touched() +
+      partition_merge_stats.num_blocks_touched());
+  merge_stats->set_posting_list_bytes_allocated(
+      merge_stats->posting_list_bytes_allocated() +
+      partition_merge_stats.posting_list_bytes_allocated());
+  merge_stats->set_bytes_written(merge_stats->bytes_written() +
+                                 partition_merge_stats.bytes_written());
+  merge_stats->set_merge_lexicon_latency_ms(
+      merge_stats->merge_lexicon_latency_ms() +
+      partition_merge_stats.merge_lexicon_latency_ms());
+  merge_stats->set_translate_and_expand_latency_ms(
+      merge_stats->translate_and_expand_latency_ms() +
+      partition_merge_stats.translate_and_expand_latency_ms());
+  merge_stats->set_add_hits_latency_ms(
+      merge_stats->add_hits_latency_ms() +
+      partition_merge_stats.add_hits_latency_ms());
+  merge_stats->set_reset_latency_ms(merge_stats->reset_latency_ms() +
+                                    partition_merge_stats.reset_latency_ms());
+}
+
 IcingDynamicTrie::Options GetMainLexiconOptions() {
   // The default values for IcingDynamicTrie::Options is fine for the main
   // lexicon.
@@ -146,6 +235,45 @@ libtextclassifier3::StatusOr<std::unique_ptr<Index>> Index::Create(
     const IcingFilesystem* icing_filesystem) {
   ICING_RETURN_ERROR_IF_NULL(filesystem);
   ICING_RETURN_ERROR_IF_NULL(icing_filesystem);
+  if (options.segmented_main_index && options.champion_list_size > 0) {
+    return absl_ports::InvalidArgumentError(
+        "Champion lists aren't supported by the segmented main index.");
+  }
+  if (options.num_namespace_partitions < 0 ||
+      options.num_namespace_partitions > kMaxNamespacePartitions) {
+    return absl_ports::InvalidArgumentError(IcingStringUtil::StringPrintf(
+        "Number of namespace partitions %d isn't in [0, %d].",
+        options.num_namespace_partitions, kMaxNamespacePartitions));
+  }
+  if (options.num_namespace_partitions > 0) {
+    if (options.champion_list_size > 0) {
+      return absl_ports::InvalidArgumentError(
+          "Champion lists aren't supported by a partitioned index.");
+    }
+    return CreatePartitioned(options, filesystem, icing_filesystem);
+  }
+
+  // Drop the partitions of an index that used to be partitioned. The caller
+  // finds the index empty and rebuilds it.
+  const std::string partitions_dir = MakePartitionsDirPath(options.base_dir);
+  if (filesystem->DirectoryExists(partitions_dir.c_str()) &&
+      !filesystem->DeleteDirectoryRecursively(partitions_dir.c_str())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to delete ", partitions_dir));
+  }
+
+  // Likewise drop the index if its main lexicon is of the other type.
+  MainIndex::LexiconType lexicon_type =
+      options.front_coded_main_lexicon ? MainIndex::LexiconType::kFrontCoded
+                                       : MainIndex::LexiconType::kDynamicTrie;
+  const std::string unpartitioned_dir =
+      MakeUnpartitionedIndexDirPath(options.base_dir);
+  if (MainIndex::HasLexiconOfOtherType(MakeMainIndexFilepath(options.base_dir),
+                                       *filesystem, lexicon_type) &&
+      !filesystem->DeleteDirectoryRecursively(unpartitioned_dir.c_str())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to delete ", unpartitioned_dir));
+  }
 
   ICING_ASSIGN_OR_RETURN(LiteIndex::Options lite_index_options,
                          CreateLiteIndexOptions(options));
@@ -161,13 +289,393 @@ libtextclassifier3::StatusOr<std::unique_ptr<Index>> Index::Create(
   ICING_ASSIGN_OR_RETURN(
       std::unique_ptr<MainIndex> main_index,
       MainIndex::Create(MakeMainIndexFilepath(options.base_dir), filesystem,
-                        icing_filesystem));
-  return std::unique_ptr<Index>(new Index(options, std::move(term_id_codec),
-                                          std::move(lite_index),
-                                          std::move(main_index), filesystem));
+                        icing_filesystem,
+                        {options.champion_list_size,
+                         options.get_document_score},
+                        lexicon_type));
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<SegmentedMainIndex> segmented_main_index,
+      SegmentedMainIndex::Create(
+          MakeSegmentedMainIndexFilepath(options.base_dir), filesystem));
+  main_index->set_max_backfill_hits_per_merge(
+      options.max_backfill_hits_per_merge);
+  return std::unique_ptr<Index>(
+      new Index(options, std::move(term_id_codec), std::move(lite_index),
+                std::move(main_index), std::move(segmented_main_index),
+                filesystem));
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<Index>> Index::CreatePartitioned(
+    const Options& options, const Filesystem* filesystem,
+    const IcingFilesystem* icing_filesystem) {
+  // Drop the index if it used to be unpartitioned or had a different number of
+  // partitions. The caller finds the index empty and rebuilds it.
+  const std::string unpartitioned_dir =
+      MakeUnpartitionedIndexDirPath(options.base_dir);
+  if (filesystem->DirectoryExists(unpartitioned_dir.c_str()) &&
+      !filesystem->DeleteDirectoryRecursively(unpartitioned_dir.c_str())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to delete ", unpartitioned_dir));
+  }
+  const std::string partitions_dir = MakePartitionsDirPath(options.base_dir);
+  const std::string num_partitions_file =
+      MakeNumPartitionsFilepath(options.base_dir);
+  int32_t num_partitions = -1;
+  if (!filesystem->FileExists(num_partitions_file.c_str()) ||
+      !filesystem->Read(num_partitions_file.c_str(), &num_partitions,
+                        sizeof(num_partitions)) ||
+      num_partitions != options.num_namespace_partitions) {
+    if (!filesystem->DeleteDirectoryRecursively(partitions_dir.c_str()) ||
+        !filesystem->CreateDirectoryRecursively(partitions_dir.c_str())) {
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Failed to recreate ", partitions_dir));
+    }
+    num_partitions = options.num_namespace_partitions;
+    if (!filesystem->Write(num_partitions_file.c_str(), &num_partitions,
+                           sizeof(num_partitions))) {
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Failed to write ", num_partitions_file));
+    }
+  }
+
+  std::vector<std::unique_ptr<Index>> partitions;
+  partitions.reserve(options.num_namespace_partitions);
+  for (int i = 0; i < options.num_namespace_partitions; ++i) {
+    Options partition_options = options;
+    partition_options.base_dir = MakePartitionDirPath(options.base_dir, i);
+    partition_options.num_namespace_partitions = 0;
+    ICING_ASSIGN_OR_RETURN(
+        std::unique_ptr<Index> partition,
+        Index::Create(partition_options, filesystem, icing_filesystem));
+    partitions.push_back(std::move(partition));
+  }
+  std::unique_ptr<Index> index(
+      new Index(options, std::move(partitions), filesystem));
+
+  // Partitions are persisted separately, so they may disagree on the last
+  // added document after a crash. Start over rather than keep track of the
+  // documents each partition is missing.
+  for (const std::unique_ptr<Index>& partition : index->partitions_) {
+    if (partition->last_added_document_id() !=
+        index->partitions_.front()->last_added_document_id()) {
+      ICING_LOG(WARNING) << "Namespace partitions are out of sync. Resetting "
+                            "the index.";
+      ICING_RETURN_IF_ERROR(index->Reset());
+      break;
+    }
+  }
+  return index;
+}
+
+libtextclassifier3::Status Index::Reset() {
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    ICING_RETURN_IF_ERROR(partition->Reset());
+  }
+  if (is_partitioned()) {
+    return libtextclassifier3::Status::OK;
+  }
+  ICING_RETURN_IF_ERROR(lite_index_->Reset());
+  ICING_RETURN_IF_ERROR(segmented_main_index_->Reset());
+  return main_index_->Reset();
+}
+
+libtextclassifier3::Status Index::ResetPartition(NamespaceId namespace_id) {
+  if (!is_partitioned()) {
+    return absl_ports::FailedPreconditionError("Index isn't partitioned.");
+  }
+  // Keep the partition in sync with the others.
+  DocumentId last_added_document_id = this->last_added_document_id();
+  Index* partition = partitions_[GetPartition(namespace_id)].get();
+  ICING_RETURN_IF_ERROR(partition->Reset());
+  if (last_added_document_id != kInvalidDocumentId) {
+    partition->set_last_added_document_id(last_added_document_id);
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<Index::DeadTerms> Index::FindDeadTerms(
+    const std::function<bool(DocumentId)>& is_document_live) const {
+  DeadTerms dead_terms;
+  if (!is_partitioned()) {
+    ICING_ASSIGN_OR_RETURN(MainIndex::DeadTerms main_dead_terms,
+                           main_index_->FindDeadTerms(is_document_live));
+    dead_terms.push_back(std::move(main_dead_terms));
+    return dead_terms;
+  }
+  for (const std::unique_ptr<Index>& partition : partitions_) {
+    ICING_ASSIGN_OR_RETURN(
+        MainIndex::DeadTerms partition_dead_terms,
+        partition->main_index_->FindDeadTerms(is_document_live));
+    dead_terms.push_back(std::move(partition_dead_terms));
+  }
+  return dead_terms;
+}
+
+libtextclassifier3::StatusOr<int> Index::DeleteDeadTerms(DeadTerms dead_terms) {
+  if (!is_partitioned()) {
+    if (dead_terms.size() != 1) {
+      return absl_ports::FailedPreconditionError(
+          "Dead terms were found in a partitioned index.");
+    }
+    return main_index_->DeleteDeadTerms(std::move(dead_terms.front()));
+  }
+  if (dead_terms.size() != partitions_.size()) {
+    return absl_ports::FailedPreconditionError(
+        "Dead terms were found in an index with other partitions.");
+  }
+  int num_terms_deleted = 0;
+  bool any_partition_changed = false;
+  for (int i = 0; i < partitions_.size(); ++i) {
+    auto num_partition_terms_deleted_or =
+        partitions_[i]->main_index_->DeleteDeadTerms(std::move(dead_terms[i]));
+    if (absl_ports::IsFailedPrecondition(
+            num_partition_terms_deleted_or.status())) {
+      any_partition_changed = true;
+      continue;
+    }
+    ICING_RETURN_IF_ERROR(num_partition_terms_deleted_or.status());
+    num_terms_deleted += num_partition_terms_deleted_or.ValueOrDie();
+  }
+  if (any_partition_changed) {
+    return absl_ports::FailedPreconditionError(
+        "Main index of a partition changed since the dead terms were found.");
+  }
+  return num_terms_deleted;
+}
+
+void Index::Warm() {
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    partition->Warm();
+  }
+  if (!is_partitioned()) {
+    lite_index_->Warm();
+    main_index_->Warm();
+  }
+}
+
+libtextclassifier3::Status Index::PersistToDisk() {
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    ICING_RETURN_IF_ERROR(partition->PersistToDisk());
+  }
+  if (is_partitioned()) {
+    return libtextclassifier3::Status::OK;
+  }
+  ICING_RETURN_IF_ERROR(lite_index_->PersistToDisk());
+  return main_index_->PersistToDisk();
+}
+
+int64_t Index::ReleaseCleanPages() {
+  if (!is_partitioned()) {
+    return lite_index_->ReleaseCleanPages() + main_index_->ReleaseCleanPages();
+  }
+  int64_t num_bytes = 0;
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    num_bytes += partition->ReleaseCleanPages();
+  }
+  return num_bytes;
+}
+
+int64_t Index::ReleaseInMemoryFreeLists() {
+  if (!is_partitioned()) {
+    return main_index_->ReleaseInMemoryFreeLists();
+  }
+  int64_t num_bytes = 0;
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    num_bytes += partition->ReleaseInMemoryFreeLists();
+  }
+  return num_bytes;
+}
+
+DocumentId Index::last_merged_document_id() const {
+  if (is_partitioned()) {
+    DocumentId min_document_id = partitions_.front()->last_merged_document_id();
+    for (const std::unique_ptr<Index>& partition : partitions_) {
+      DocumentId document_id = partition->last_merged_document_id();
+      if (document_id == kInvalidDocumentId) {
+        return kInvalidDocumentId;
+      }
+      min_document_id = std::min(min_document_id, document_id);
+    }
+    return min_document_id;
+  }
+  DocumentId main_document_id = main_index_->last_added_document_id();
+  DocumentId segmented_document_id =
+      segmented_main_index_->last_added_document_id();
+  if (main_document_id == kInvalidDocumentId) {
+    return segmented_document_id;
+  }
+  if (segmented_document_id == kInvalidDocumentId) {
+    return main_document_id;
+  }
+  return std::max(main_document_id, segmented_document_id);
+}
+
+void Index::GetDebugInfo(int verbosity, std::string* out) const {
+  for (int i = 0; i < partitions_.size(); ++i) {
+    absl_ports::StrAppend(out, "Partition ", std::to_string(i), "\n");
+    partitions_[i]->GetDebugInfo(verbosity, out);
+  }
+  if (!is_partitioned()) {
+    lite_index_->GetDebugInfo(verbosity, out);
+    main_index_->GetDebugInfo(verbosity, out);
+    segmented_main_index_->GetDebugInfo(verbosity, out);
+  }
+}
+
+libtextclassifier3::StatusOr<int64_t> Index::GetElementsSize() const {
+  if (is_partitioned()) {
+    int64_t size = 0;
+    for (const std::unique_ptr<Index>& partition : partitions_) {
+      ICING_ASSIGN_OR_RETURN(int64_t partition_size,
+                             partition->GetElementsSize());
+      size += partition_size;
+    }
+    return size;
+  }
+  ICING_ASSIGN_OR_RETURN(int64_t lite_index_size,
+                         lite_index_->GetElementsSize());
+  ICING_ASSIGN_OR_RETURN(int64_t main_index_size,
+                         main_index_->GetElementsSize());
+  ICING_ASSIGN_OR_RETURN(int64_t segmented_main_index_size,
+                         segmented_main_index_->GetElementsSize());
+  return lite_index_size + main_index_size + segmented_main_index_size;
+}
+
+bool Index::WantsMerge() const {
+  if (!is_partitioned()) {
+    return lite_index_->WantsMerge();
+  }
+  for (const std::unique_ptr<Index>& partition : partitions_) {
+    if (partition->WantsMerge()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Index::WantsSegmentCompaction() const {
+  if (!is_partitioned()) {
+    return segmented_main_index_->WantsCompaction();
+  }
+  for (const std::unique_ptr<Index>& partition : partitions_) {
+    if (partition->WantsSegmentCompaction()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+libtextclassifier3::StatusOr<bool> Index::CompactSegments() {
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<SegmentedMainIndex::Compaction> compaction,
+      PrepareSegmentCompaction());
+  if (compaction == nullptr) {
+    return false;
+  }
+  return CommitSegmentCompaction(std::move(compaction));
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<SegmentedMainIndex::Compaction>>
+Index::PrepareSegmentCompaction() const {
+  if (!is_partitioned()) {
+    return segmented_main_index_->PrepareCompaction();
+  }
+  for (const std::unique_ptr<Index>& partition : partitions_) {
+    if (partition->WantsSegmentCompaction()) {
+      return partition->PrepareSegmentCompaction();
+    }
+  }
+  return nullptr;
+}
+
+libtextclassifier3::StatusOr<bool> Index::CommitSegmentCompaction(
+    std::unique_ptr<SegmentedMainIndex::Compaction> compaction) {
+  if (!is_partitioned()) {
+    ICING_RETURN_IF_ERROR(
+        segmented_main_index_->CommitCompaction(std::move(compaction)));
+    return WantsSegmentCompaction();
+  }
+  for (std::unique_ptr<Index>& partition : partitions_) {
+    if (partition->segmented_main_index_->PreparedCompaction(*compaction)) {
+      ICING_RETURN_IF_ERROR(
+          partition->CommitSegmentCompaction(std::move(compaction)).status());
+      return WantsSegmentCompaction();
+    }
+  }
+  return absl_ports::FailedPreconditionError(
+      "Compaction was prepared by another index");
+}
+
+libtextclassifier3::Status Index::Merge(IndexMergeStatsProto* merge_stats) {
+  IndexMergeStatsProto unused_merge_stats;
+  if (merge_stats == nullptr) {
+    merge_stats = &unused_merge_stats;
+  }
+  if (is_partitioned()) {
+    // Only merge the partitions that filled up, unless the caller merges
+    // regardless.
+    bool merge_all = !WantsMerge();
+    for (std::unique_ptr<Index>& partition : partitions_) {
+      if (!merge_all && !partition->WantsMerge()) {
+        continue;
+      }
+      IndexMergeStatsProto partition_merge_stats;
+      ICING_RETURN_IF_ERROR(partition->Merge(&partition_merge_stats));
+      AddMergeStats(partition_merge_stats, merge_stats);
+    }
+    return libtextclassifier3::Status::OK;
+  }
+  merge_stats->set_num_lite_hits(lite_index_->size());
+  merge_stats->set_num_lite_terms(lite_index_->lexicon().size());
+  if (options_.segmented_main_index) {
+    ICING_RETURN_IF_ERROR(
+        segmented_main_index_->Merge(*lite_index_, *term_id_codec_));
+  } else {
+    Timer merge_lexicon_timer;
+    ICING_ASSIGN_OR_RETURN(MainIndex::LexiconMergeOutputs outputs,
+                           main_index_->MergeLexicon(lite_index_->lexicon()));
+    merge_stats->set_merge_lexicon_latency_ms(
+        merge_lexicon_timer.GetElapsedMilliseconds());
+    merge_stats->set_num_new_main_terms(outputs.num_new_terms);
+    merge_stats->set_num_branch_points_added(outputs.num_new_branch_points);
+
+    Timer translate_timer;
+    ICING_ASSIGN_OR_RETURN(std::vector<TermIdHitPair> term_id_hit_pairs,
+                           MainIndexMerger::TranslateAndExpandLiteHits(
+                               *lite_index_, *term_id_codec_, outputs));
+    merge_stats->set_translate_and_expand_latency_ms(
+        translate_timer.GetElapsedMilliseconds());
+
+    Timer add_hits_timer;
+    ICING_RETURN_IF_ERROR(main_index_->AddHits(
+        *term_id_codec_, std::move(outputs.backfill_map),
+        std::move(term_id_hit_pairs), lite_index_->last_added_document_id(),
+        merge_stats));
+    merge_stats->set_add_hits_latency_ms(
+        add_hits_timer.GetElapsedMilliseconds());
+  }
+
+  Timer reset_timer;
+  ICING_RETURN_IF_ERROR(lite_index_->Reset());
+  merge_stats->set_reset_latency_ms(reset_timer.GetElapsedMilliseconds());
+  return libtextclassifier3::Status::OK;
 }
 
 libtextclassifier3::Status Index::TruncateTo(DocumentId document_id) {
+  if (is_partitioned()) {
+    for (std::unique_ptr<Index>& partition : partitions_) {
+      ICING_RETURN_IF_ERROR(partition->TruncateTo(document_id));
+    }
+    // Partitions that merged at different times may have been truncated to
+    // different documents.
+    for (const std::unique_ptr<Index>& partition : partitions_) {
+      if (partition->last_added_document_id() !=
+          partitions_.front()->last_added_document_id()) {
+        return Reset();
+      }
+    }
+    return libtextclassifier3::Status::OK;
+  }
   if (lite_index_->last_added_document_id() != kInvalidDocumentId &&
       lite_index_->last_added_document_id() > document_id) {
     ICING_VLOG(1) << "Clipping to " << document_id
@@ -182,32 +690,85 @@ libtextclassifier3::Status Index::TruncateTo(DocumentId document_id) {
                   << main_index_->last_added_document_id();
     ICING_RETURN_IF_ERROR(main_index_->Reset());
   }
+  if (segmented_main_index_->last_added_document_id() != kInvalidDocumentId &&
+      segmented_main_index_->last_added_document_id() > document_id) {
+    ICING_VLOG(1) << "Clipping to " << document_id
+                  << ". Throwing out segmented main index which is at "
+                  << segmented_main_index_->last_added_document_id();
+    ICING_RETURN_IF_ERROR(segmented_main_index_->Reset());
+  }
   return libtextclassifier3::Status::OK;
 }
 
 libtextclassifier3::StatusOr<std::unique_ptr<DocHitInfoIterator>>
 Index::GetIterator(const std::string& term, SectionIdMask section_id_mask,
                    TermMatchType::Code term_match_type) {
+  return GetIterator(term, section_id_mask, term_match_type, HitScope::kAll,
+                     /*champion_threshold=*/nullptr, /*namespace_ids=*/{});
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<DocHitInfoIterator>>
+Index::GetIterator(const std::string& term, SectionIdMask section_id_mask,
+                   TermMatchType::Code term_match_type, HitScope hit_scope,
+                   std::optional<ChampionRank>* champion_threshold,
+                   const std::vector<NamespaceId>& namespace_ids) {
+  if (is_partitioned()) {
+    std::vector<std::unique_ptr<DocHitInfoIterator>> partition_itrs;
+    for (int partition : GetPartitions(namespace_ids)) {
+      ICING_ASSIGN_OR_RETURN(
+          std::unique_ptr<DocHitInfoIterator> partition_itr,
+          partitions_[partition]->GetIterator(
+              term, section_id_mask, term_match_type, hit_scope,
+              champion_threshold, /*namespace_ids=*/{}));
+      partition_itrs.push_back(std::move(partition_itr));
+    }
+    return CreateOrIterator(std::move(partition_itrs));
+  }
+  bool champions_only = hit_scope == HitScope::kChampions;
   std::unique_ptr<DocHitInfoIterator> lite_itr;
   std::unique_ptr<DocHitInfoIterator> main_itr;
+  std::unique_ptr<DocHitInfoIterator> segmented_itr;
+  libtextclassifier3::StatusOr<ChampionRank> threshold_or;
   switch (term_match_type) {
     case TermMatchType::EXACT_ONLY:
       lite_itr = std::make_unique<DocHitInfoIteratorTermLiteExact>(
           term_id_codec_.get(), lite_index_.get(), term, section_id_mask);
       main_itr = std::make_unique<DocHitInfoIteratorTermMainExact>(
-          main_index_.get(), term, section_id_mask);
+          main_index_.get(), term, section_id_mask, champions_only);
+      segmented_itr = std::make_unique<DocHitInfoIteratorTermSegmentedExact>(
+          segmented_main_index_.get(), term, section_id_mask);
+      if (champions_only) {
+        threshold_or = main_index_->GetChampionThresholdForExactTerm(term);
+      }
       break;
     case TermMatchType::PREFIX:
       lite_itr = std::make_unique<DocHitInfoIteratorTermLitePrefix>(
           term_id_codec_.get(), lite_index_.get(), term, section_id_mask);
       main_itr = std::make_unique<DocHitInfoIteratorTermMainPrefix>(
-          main_index_.get(), term, section_id_mask);
+          main_index_.get(), term, section_id_mask, champions_only);
+      segmented_itr = std::make_unique<DocHitInfoIteratorTermSegmentedPrefix>(
+          segmented_main_index_.get(), term, section_id_mask);
+      if (champions_only) {
+        threshold_or = main_index_->GetChampionThresholdForPrefixTerm(term);
+      }
       break;
     default:
       return absl_ports::InvalidArgumentError(
           absl_ports::StrCat("Invalid TermMatchType: ",
                              TermMatchType::Code_Name(term_match_type)));
   }
+  if (champions_only && threshold_or.ok() &&
+      (!champion_threshold->has_value() ||
+       **champion_threshold < threshold_or.ValueOrDie())) {
+    *champion_threshold = threshold_or.ValueOrDie();
+  }
+  if (segmented_main_index_->num_segments() > 0) {
+    main_itr = std::make_unique<DocHitInfoIteratorOr>(std::move(main_itr),
+                                                      std::move(segmented_itr));
+  }
+  if (hit_scope == HitScope::kMain) {
+    return main_itr;
+  }
   return std::make_unique<DocHitInfoIteratorOr>(std::move(lite_itr),
                                                 std::move(main_itr));
 }
@@ -263,6 +824,18 @@ Index::FindTermsByPrefix(const std::string& prefix,
     return term_metadata_list;
   }
 
+  if (is_partitioned()) {
+    for (int partition : GetPartitions(namespace_ids)) {
+      ICING_ASSIGN_OR_RETURN(std::vector<TermMetadata> partition_term_metadata,
+                             partitions_[partition]->FindTermsByPrefix(
+                                 prefix, namespace_ids, num_to_return));
+      term_metadata_list = MergeTermMetadatas(
+          std::move(term_metadata_list), std::move(partition_term_metadata),
+          num_to_return);
+    }
+    return term_metadata_list;
+  }
+
   // Get results from the LiteIndex.
   ICING_ASSIGN_OR_RETURN(
       std::vector<TermMetadata> lite_term_metadata_list,
@@ -272,11 +845,95 @@ Index::FindTermsByPrefix(const std::string& prefix,
   ICING_ASSIGN_OR_RETURN(
       std::vector<TermMetadata> main_term_metadata_list,
       main_index_->FindTermsByPrefix(prefix, namespace_ids, num_to_return));
+  if (segmented_main_index_->num_segments() > 0) {
+    ICING_ASSIGN_OR_RETURN(
+        std::vector<TermMetadata> segmented_term_metadata_list,
+        segmented_main_index_->FindTermsByPrefix(prefix, namespace_ids,
+                                                 num_to_return));
+    main_term_metadata_list = MergeTermMetadatas(
+        std::move(main_term_metadata_list),
+        std::move(segmented_term_metadata_list), num_to_return);
+  }
 
   return MergeTermMetadatas(std::move(lite_term_metadata_list),
                             std::move(main_term_metadata_list), num_to_return);
 }
 
+libtextclassifier3::StatusOr<std::vector<TermMetadata>>
+Index::FindTermsByPrefix(
+    const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
+    int num_to_return,
+    const std::function<bool(DocumentId)>& is_document_live) {
+  std::vector<TermMetadata> live_term_metadata_list;
+  // Whether a term is live is only known once its hits are read, so the
+  // candidates are looked up in growing batches until enough of them are live
+  // or there are no more.
+  std::unordered_map<std::string, bool> is_term_live;
+  int num_candidates = num_to_return;
+  while (true) {
+    ICING_ASSIGN_OR_RETURN(
+        std::vector<TermMetadata> candidates,
+        FindTermsByPrefix(prefix, namespace_ids, num_candidates));
+    live_term_metadata_list.clear();
+    for (TermMetadata& candidate : candidates) {
+      if (live_term_metadata_list.size() >= num_to_return) {
+        break;
+      }
+      auto itr = is_term_live.find(candidate.content);
+      if (itr == is_term_live.end()) {
+        ICING_ASSIGN_OR_RETURN(
+            bool live, HasLiveExactHits(candidate.content, namespace_ids,
+                                        is_document_live));
+        itr = is_term_live.emplace(candidate.content, live).first;
+      }
+      if (itr->second) {
+        live_term_metadata_list.push_back(std::move(candidate));
+      }
+    }
+    if (live_term_metadata_list.size() >= num_to_return ||
+        candidates.size() < num_candidates ||
+        num_candidates > std::numeric_limits<int>::max() / 2) {
+      return live_term_metadata_list;
+    }
+    num_candidates *= 2;
+  }
+}
+
+libtextclassifier3::StatusOr<bool> Index::HasLiveExactHits(
+    const std::string& term, const std::vector<NamespaceId>& namespace_ids,
+    const std::function<bool(DocumentId)>& is_document_live) {
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      GetIterator(term, kSectionIdMaskAll, TermMatchType::EXACT_ONLY,
+                  HitScope::kAll, /*champion_threshold=*/nullptr,
+                  namespace_ids));
+  while (itr->Advance().ok()) {
+    if (is_document_live(itr->doc_hit_info().document_id())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<int> Index::GetPartitions(
+    const std::vector<NamespaceId>& namespace_ids) const {
+  std::vector<int> partitions;
+  if (namespace_ids.empty()) {
+    partitions.reserve(partitions_.size());
+    for (int i = 0; i < partitions_.size(); ++i) {
+      partitions.push_back(i);
+    }
+    return partitions;
+  }
+  for (NamespaceId namespace_id : namespace_ids) {
+    partitions.push_back(GetPartition(namespace_id));
+  }
+  std::sort(partitions.begin(), partitions.end());
+  partitions.erase(std::unique(partitions.begin(), partitions.end()),
+                   partitions.end());
+  return partitions;
+}
+
 IndexStorageInfoProto Index::GetStorageInfo() const {
   IndexStorageInfoProto storage_info;
   int64_t directory_size = filesystem_->GetDiskUsage(options_.base_dir.c_str());
@@ -285,6 +942,33 @@ IndexStorageInfoProto Index::GetStorageInfo() const {
   } else {
     storage_info.set_index_size(-1);
   }
+  if (is_partitioned()) {
+    for (const std::unique_ptr<Index>& partition : partitions_) {
+      IndexStorageInfoProto partition_info = partition->GetStorageInfo();
+      storage_info.set_lite_index_lexicon_size(
+          AddSizes(storage_info.lite_index_lexicon_size(),
+                   partition_info.lite_index_lexicon_size()));
+      storage_info.set_lite_index_hit_buffer_size(
+          AddSizes(storage_info.lite_index_hit_buffer_size(),
+                   partition_info.lite_index_hit_buffer_size()));
+      storage_info.set_main_index_lexicon_size(
+          AddSizes(storage_info.main_index_lexicon_size(),
+                   partition_info.main_index_lexicon_size()));
+      storage_info.set_main_index_storage_size(
+          AddSizes(storage_info.main_index_storage_size(),
+                   partition_info.main_index_storage_size()));
+      storage_info.set_main_index_block_size(
+          partition_info.main_index_block_size());
+      storage_info.set_num_blocks(
+          AddSizes(storage_info.num_blocks(), partition_info.num_blocks()));
+      if (!storage_info.has_min_free_fraction() ||
+          partition_info.min_free_fraction() <
+              storage_info.min_free_fraction()) {
+        storage_info.set_min_free_fraction(partition_info.min_free_fraction());
+      }
+    }
+    return storage_info;
+  }
   storage_info = lite_index_->GetStorageInfo(std::move(storage_info));
   return main_index_->GetStorageInfo(std::move(storage_info));
 }
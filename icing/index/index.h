@@ -15,11 +15,15 @@
 #ifndef ICING_INDEX_INDEX_H_
 #define ICING_INDEX_INDEX_H_
 
+#include <algorithm>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
@@ -29,15 +33,18 @@
 #include "icing/index/lite/lite-index.h"
 #include "icing/index/main/main-index-merger.h"
 #include "icing/index/main/main-index.h"
+#include "icing/index/main/segmented-main-index.h"
 #include "icing/index/term-id-codec.h"
 #include "icing/index/term-metadata.h"
 #include "icing/legacy/index/icing-filesystem.h"
+#include "icing/proto/logging.pb.h"
 #include "icing/proto/storage.pb.h"
 #include "icing/proto/term.pb.h"
 #include "icing/schema/section.h"
 #include "icing/store/document-id.h"
 #include "icing/store/namespace-id.h"
 #include "icing/util/crc32.h"
+#include "icing/util/status-macros.h"
 
 namespace icing {
 namespace lib {
@@ -70,8 +77,39 @@ class Index {
 
     std::string base_dir;
     int32_t index_merge_size;
+
+    // The number of best ranked documents kept in the champion lists of the
+    // main index. See MainIndex::ChampionListOptions.
+    int32_t champion_list_size = 0;
+    MainIndex::GetDocumentScoreFn get_document_score;
+
+    // Whether merges write new segments of a SegmentedMainIndex instead of
+    // updating the MainIndex in place. Hits already in either one stay
+    // searchable when this changes. Can't be combined with champion lists.
+    bool segmented_main_index = false;
+
+    // The number of hits a merge may copy into new prefix branch points of the
+    // main index. See MainIndex::set_max_backfill_hits_per_merge.
+    int32_t max_backfill_hits_per_merge = -1;
+
+    // The number of partitions to split the index into by namespace. The hits
+    // of a namespace go to partition namespace_id % num_namespace_partitions,
+    // which has its own lite index, main index and lexicons. Queries only
+    // look at the partitions of the namespaces they are restricted to. 0
+    // keeps all hits in one index. The index is cleared when this changes.
+    // Can't be combined with champion lists.
+    int32_t num_namespace_partitions = 0;
+
+    // Whether the main lexicon is a FrontCodedLexicon instead of an
+    // IcingDynamicTrie. See MainIndex::LexiconType. The index is cleared when
+    // this changes.
+    bool front_coded_main_lexicon = false;
   };
 
+  // The maximum number of namespace partitions. Every partition keeps a few
+  // files open.
+  static constexpr int kMaxNamespacePartitions = 64;
+
   // Creates an instance of Index in the directory pointed by file_dir.
   //
   // Returns:
@@ -85,27 +123,87 @@ class Index {
 
   // Clears all files created by the index. Returns OK if all files were
   // cleared.
-  libtextclassifier3::Status Reset() {
-    ICING_RETURN_IF_ERROR(lite_index_->Reset());
-    return main_index_->Reset();
+  libtextclassifier3::Status Reset();
+
+  // Whether the index is split into partitions by namespace.
+  bool is_partitioned() const { return !partitions_.empty(); }
+
+  // Returns the partition that the hits of namespace_id go to.
+  //
+  // REQUIRES: is_partitioned()
+  int GetPartition(NamespaceId namespace_id) const {
+    return namespace_id % partitions_.size();
+  }
+
+  // Clears the partition that the hits of namespace_id go to, e.g. once all
+  // documents of the namespaces in it were deleted. The other partitions are
+  // left alone.
+  //
+  // Returns:
+  //   OK on success
+  //   FAILED_PRECONDITION if the index isn't partitioned
+  //   INTERNAL on I/O errors
+  libtextclassifier3::Status ResetPartition(NamespaceId namespace_id);
+
+  // The dead terms of the main index of every partition, or of the index if
+  // it isn't partitioned.
+  using DeadTerms = std::vector<MainIndex::DeadTerms>;
+
+  // Finds the terms of the main index that only have hits of documents for
+  // which is_document_live returns false, see MainIndex::FindDeadTerms. Only
+  // reads the index, so it may run alongside queries, but not alongside calls
+  // that change the index.
+  //
+  // Returns:
+  //   The dead terms on success
+  //   INTERNAL on I/O errors
+  libtextclassifier3::StatusOr<DeadTerms> FindDeadTerms(
+      const std::function<bool(DocumentId)>& is_document_live) const;
+
+  // Deletes the dead terms, so that they stop taking up space. Terms of the
+  // lite index go away with the next merge. Segments keep their terms until
+  // the index is reset.
+  //
+  // Returns:
+  //   The number of terms deleted on success
+  //   FAILED_PRECONDITION if the main index of a partition changed since
+  //     dead_terms were found. The dead terms of the other partitions are
+  //     still deleted.
+  //   INTERNAL on I/O errors
+  libtextclassifier3::StatusOr<int> DeleteDeadTerms(DeadTerms dead_terms);
+
+  // Finds the dead terms and deletes them, see above.
+  libtextclassifier3::StatusOr<int> DeleteDeadTerms(
+      const std::function<bool(DocumentId)>& is_document_live) {
+    ICING_ASSIGN_OR_RETURN(DeadTerms dead_terms,
+                           FindDeadTerms(is_document_live));
+    return DeleteDeadTerms(std::move(dead_terms));
   }
 
   // Brings components of the index into memory in anticipation of a query in
   // order to reduce latency.
-  void Warm() {
-    lite_index_->Warm();
-    main_index_->Warm();
-  }
+  void Warm();
 
   // Syncs all the data and metadata changes to disk.
   //
   // Returns:
   //   OK on success
   //   INTERNAL on I/O errors
-  libtextclassifier3::Status PersistToDisk() {
-    ICING_RETURN_IF_ERROR(lite_index_->PersistToDisk());
-    return main_index_->PersistToDisk();
-  }
+  libtextclassifier3::Status PersistToDisk();
+
+  // Drops memory-mapped pages that can be read back from disk from memory.
+  //
+  // Returns:
+  //   The number of bytes that were resident
+  int64_t ReleaseCleanPages();
+
+  // Returns the main index's in-memory cache of free posting lists to the
+  // on-disk free lists. Reusing those posting lists afterwards costs a disk
+  // read.
+  //
+  // Returns:
+  //   The number of bytes released
+  int64_t ReleaseInMemoryFreeLists();
 
   // Discard parts of the index if they contain data for document ids greater
   // than document_id.
@@ -120,16 +218,32 @@ class Index {
   // DocumentIds are always inserted in increasing order. Returns the largest
   // document_id added to the index.
   DocumentId last_added_document_id() const {
+    if (is_partitioned()) {
+      // All partitions are told about every document.
+      return partitions_.front()->last_added_document_id();
+    }
     DocumentId lite_document_id = lite_index_->last_added_document_id();
     if (lite_document_id != kInvalidDocumentId) {
       return lite_document_id;
     }
-    return main_index_->last_added_document_id();
+    return last_merged_document_id();
   }
 
+  // Returns the largest document_id merged into the main index, or
+  // kInvalidDocumentId if there is none. The hits of all documents up to it are
+  // in the main index and the hits of all later ones are in the lite index.
+  // Partitions are merged separately, so this is the smallest one of theirs.
+  DocumentId last_merged_document_id() const;
+
   // Sets last_added_document_id to document_id so long as document_id >
   // last_added_document_id()
   void set_last_added_document_id(DocumentId document_id) {
+    for (std::unique_ptr<Index>& partition : partitions_) {
+      partition->set_last_added_document_id(document_id);
+    }
+    if (is_partitioned()) {
+      return;
+    }
     DocumentId lite_document_id = lite_index_->last_added_document_id();
     if (lite_document_id == kInvalidDocumentId ||
         document_id >= lite_document_id) {
@@ -142,10 +256,7 @@ class Index {
   //                 index.
   // verbosity > 0, more detailed debug information including raw postings
   //                lists.
-  void GetDebugInfo(int verbosity, std::string* out) const {
-    lite_index_->GetDebugInfo(verbosity, out);
-    main_index_->GetDebugInfo(verbosity, out);
-  }
+  void GetDebugInfo(int verbosity, std::string* out) const;
 
   // Returns the byte size of the all the elements held in the index. This
   // excludes the size of any internal metadata of the index, e.g. the index's
@@ -154,13 +265,7 @@ class Index {
   // Returns:
   //   Byte size on success
   //   INTERNAL_ERROR on IO error
-  libtextclassifier3::StatusOr<int64_t> GetElementsSize() const {
-    ICING_ASSIGN_OR_RETURN(int64_t lite_index_size,
-                           lite_index_->GetElementsSize());
-    ICING_ASSIGN_OR_RETURN(int64_t main_index_size,
-                           main_index_->GetElementsSize());
-    return lite_index_size + main_index_size;
-  }
+  libtextclassifier3::StatusOr<int64_t> GetElementsSize() const;
 
   // Calculates the StorageInfo for the Index.
   //
@@ -180,6 +285,35 @@ class Index {
       const std::string& term, SectionIdMask section_id_mask,
       TermMatchType::Code term_match_type);
 
+  // Which hits an iterator returns.
+  enum class HitScope {
+    // All hits of the term.
+    kAll,
+    // The hits in the lite index and in the term's champion list in the main
+    // index, or all hits of the term if it has no champion list.
+    kChampions,
+    // The hits in the main index and its segments.
+    kMain,
+  };
+
+  // Like GetIterator, but the iterator returns the hits in hit_scope. For
+  // kChampions, champion_threshold is raised to the threshold of the term's
+  // champion list, if it has one. The iterator returns every matching document
+  // that ranks at or above the threshold.
+  //
+  // If the index is partitioned and namespace_ids isn't empty, only the
+  // partitions of those namespaces are searched. The iterator may still
+  // return hits of other namespaces in the same partitions.
+  //
+  // Returns:
+  //   unique ptr to a valid DocHitInfoIterator that matches the term
+  //   INVALID_ARGUMENT if given an invalid term_match_type
+  libtextclassifier3::StatusOr<std::unique_ptr<DocHitInfoIterator>> GetIterator(
+      const std::string& term, SectionIdMask section_id_mask,
+      TermMatchType::Code term_match_type, HitScope hit_scope,
+      std::optional<ChampionRank>* champion_threshold,
+      const std::vector<NamespaceId>& namespace_ids);
+
   // Finds terms with the given prefix in the given namespaces. If
   // 'namespace_ids' is empty, returns results from all the namespaces. The
   // input prefix must be normalized, otherwise inaccurate results may be
@@ -193,6 +327,19 @@ class Index {
       const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
       int num_to_return);
 
+  // Like FindTermsByPrefix, but skips the terms that have no exact hit of a
+  // document for which is_document_live returns true, e.g. because all of
+  // their documents were deleted. This reads the hits of the terms it returns
+  // and skips, so it is slower than the above.
+  //
+  // Returns:
+  //   A list of TermMetadata on success
+  //   INTERNAL_ERROR if failed to access term data.
+  libtextclassifier3::StatusOr<std::vector<TermMetadata>> FindTermsByPrefix(
+      const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
+      int num_to_return,
+      const std::function<bool(DocumentId)>& is_document_live);
+
   // A class that can be used to add hits to the index.
   //
   // An editor groups hits from a particular section within a document together
@@ -233,47 +380,112 @@ class Index {
   };
   Editor Edit(DocumentId document_id, SectionId section_id,
               TermMatchType::Code term_match_type, NamespaceId namespace_id) {
+    if (is_partitioned()) {
+      return partitions_[GetPartition(namespace_id)]->Edit(
+          document_id, section_id, term_match_type, namespace_id);
+    }
     return Editor(term_id_codec_.get(), lite_index_.get(), document_id,
                   section_id, term_match_type, namespace_id);
   }
 
-  bool WantsMerge() const { return lite_index_->WantsMerge(); }
+  // Returns true if the lite index, or that of any partition, wants a merge.
+  bool WantsMerge() const;
 
-  // Merges newly-added hits in the LiteIndex into the MainIndex.
+  // Merges newly-added hits in the LiteIndex into the MainIndex. Fills in
+  // merge_stats if it isn't null. With a segmented main index, only the lite
+  // index sizes and the reset latency are filled in. With a partitioned index,
+  // only the partitions whose lite index wants a merge are merged, or all of
+  // them if none does, and merge_stats holds the sums of their stats.
   //
   // RETURNS:
   //  - INTERNAL on IO error while writing to the MainIndex.
   //  - RESOURCE_EXHAUSTED error if unable to grow the index.
-  libtextclassifier3::Status Merge() {
-    ICING_ASSIGN_OR_RETURN(MainIndex::LexiconMergeOutputs outputs,
-                           main_index_->MergeLexicon(lite_index_->lexicon()));
-    ICING_ASSIGN_OR_RETURN(std::vector<TermIdHitPair> term_id_hit_pairs,
-                           MainIndexMerger::TranslateAndExpandLiteHits(
-                               *lite_index_, *term_id_codec_, outputs));
-    ICING_RETURN_IF_ERROR(main_index_->AddHits(
-        *term_id_codec_, std::move(outputs.backfill_map),
-        std::move(term_id_hit_pairs), lite_index_->last_added_document_id()));
-    return lite_index_->Reset();
-  }
+  libtextclassifier3::Status Merge(IndexMergeStatsProto* merge_stats = nullptr);
+
+  // Returns true if the segmented main index, or that of any partition, has
+  // segments to compact. Merges leave compaction to CompactSegments, so that
+  // callers can run it in the background.
+  bool WantsSegmentCompaction() const;
+
+  // Compacts one run of segments of the segmented main index, or of the first
+  // partition that has one.
+  //
+  // RETURNS:
+  //  - Whether there are more segments to compact on success
+  //  - DATA_LOSS if a segment is corrupted
+  //  - INTERNAL on IO error
+  libtextclassifier3::StatusOr<bool> CompactSegments();
+
+  // Writes the compacted segment of one run of segments of the segmented main
+  // index, or of the first partition that has one, without changing the
+  // index. Only reads the index, so it may run alongside queries.
+  //
+  // RETURNS:
+  //  - The compaction on success, or nullptr if there's nothing to compact
+  //  - DATA_LOSS if a segment is corrupted
+  //  - INTERNAL on IO error
+  libtextclassifier3::StatusOr<std::unique_ptr<SegmentedMainIndex::Compaction>>
+  PrepareSegmentCompaction() const;
+
+  // Swaps a compaction from PrepareSegmentCompaction into the index.
+  //
+  // RETURNS:
+  //  - Whether there are more segments to compact on success
+  //  - FAILED_PRECONDITION if the index was changed or replaced since the
+  //    compaction was prepared. The compaction is dropped.
+  //  - INTERNAL on IO error
+  libtextclassifier3::StatusOr<bool> CommitSegmentCompaction(
+      std::unique_ptr<SegmentedMainIndex::Compaction> compaction);
 
  private:
   Index(const Options& options, std::unique_ptr<TermIdCodec> term_id_codec,
         std::unique_ptr<LiteIndex> lite_index,
-        std::unique_ptr<MainIndex> main_index, const Filesystem* filesystem)
+        std::unique_ptr<MainIndex> main_index,
+        std::unique_ptr<SegmentedMainIndex> segmented_main_index,
+        const Filesystem* filesystem)
       : lite_index_(std::move(lite_index)),
         main_index_(std::move(main_index)),
+        segmented_main_index_(std::move(segmented_main_index)),
         options_(options),
         term_id_codec_(std::move(term_id_codec)),
         filesystem_(filesystem) {}
 
+  Index(const Options& options, std::vector<std::unique_ptr<Index>> partitions,
+        const Filesystem* filesystem)
+      : options_(options),
+        partitions_(std::move(partitions)),
+        filesystem_(filesystem) {}
+
+  // Creates an index that is split into options.num_namespace_partitions
+  // partitions, each of which is an unpartitioned index.
+  static libtextclassifier3::StatusOr<std::unique_ptr<Index>> CreatePartitioned(
+      const Options& options, const Filesystem* filesystem,
+      const IcingFilesystem* icing_filesystem);
+
+  // Returns the distinct partitions of namespace_ids in increasing order, or
+  // all partitions if namespace_ids is empty.
+  std::vector<int> GetPartitions(
+      const std::vector<NamespaceId>& namespace_ids) const;
+
   libtextclassifier3::StatusOr<std::vector<TermMetadata>> FindLiteTermsByPrefix(
       const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
       int num_to_return);
 
+  // Whether term has an exact hit of a document in namespace_ids for which
+  // is_document_live returns true.
+  libtextclassifier3::StatusOr<bool> HasLiveExactHits(
+      const std::string& term, const std::vector<NamespaceId>& namespace_ids,
+      const std::function<bool(DocumentId)>& is_document_live);
+
+  // Only set if the index isn't partitioned.
   std::unique_ptr<LiteIndex> lite_index_;
   std::unique_ptr<MainIndex> main_index_;
+  std::unique_ptr<SegmentedMainIndex> segmented_main_index_;
   const Options options_;
   std::unique_ptr<TermIdCodec> term_id_codec_;
+
+  // Only set if the index is partitioned.
+  std::vector<std::unique_ptr<Index>> partitions_;
   const Filesystem* filesystem_;
 };
 
@@ -28,7 +28,9 @@
 #include "gtest/gtest.h"
 #include "icing/file/filesystem.h"
 #include "icing/index/hit/doc-hit-info.h"
+#include "icing/index/iterator/doc-hit-info-iterator-and.h"
 #include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/index/main/segmented-main-index.h"
 #include "icing/legacy/index/icing-filesystem.h"
 #include "icing/legacy/index/icing-mock-filesystem.h"
 #include "icing/proto/storage.pb.h"
@@ -46,6 +48,7 @@ namespace lib {
 namespace {
 
 using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
 using ::testing::Eq;
 using ::testing::Ge;
 using ::testing::Gt;
@@ -1222,6 +1225,83 @@ TEST_F(IndexTest, FindTermByPrefixShouldReturnTermsFromBothIndices) {
                   EqualsTermMetadata("fool", 1))));
 }
 
+TEST_F(IndexTest, FindTermByPrefixShouldSkipTermsWithoutLiveDocuments) {
+  Index::Editor edit =
+      index_->Edit(kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY,
+                   /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+
+  ICING_ASSERT_OK(index_->Merge());
+
+  edit = index_->Edit(kDocumentId2, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("food"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId3, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fox"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+
+  // Documents 0 and 2 were deleted, so 'foo' in the main index and 'food' in
+  // the lite index are skipped, even if that takes more than num_to_return
+  // lookups.
+  auto is_document_live = [](DocumentId document_id) {
+    return document_id == kDocumentId1 || document_id == kDocumentId3;
+  };
+  EXPECT_THAT(index_->FindTermsByPrefix(/*prefix=*/"f", /*namespace_ids=*/{0},
+                                        /*num_to_return=*/2, is_document_live),
+              IsOkAndHolds(UnorderedElementsAre(
+                  EqualsTermMetadata("fool", kMinSizePlApproxHits),
+                  EqualsTermMetadata("fox", 1))));
+  EXPECT_THAT(index_->FindTermsByPrefix(/*prefix=*/"f", /*namespace_ids=*/{0},
+                                        /*num_to_return=*/1, is_document_live),
+              IsOkAndHolds(SizeIs(1)));
+  EXPECT_THAT(
+      index_->FindTermsByPrefix(/*prefix=*/"f", /*namespace_ids=*/{0},
+                                /*num_to_return=*/10,
+                                [](DocumentId document_id) { return false; }),
+      IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(IndexTest, DeleteDeadTermsFailsIfIndexWasMergedSinceFound) {
+  Index::Editor edit =
+      index_->Edit(kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY,
+                   /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  ICING_ASSERT_OK(index_->Merge());
+
+  auto is_document_live = [](DocumentId document_id) {
+    return document_id != kDocumentId0;
+  };
+  ICING_ASSERT_OK_AND_ASSIGN(Index::DeadTerms dead_terms,
+                             index_->FindDeadTerms(is_document_live));
+
+  // 'foo' gets a live hit in between.
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  ICING_ASSERT_OK(index_->Merge());
+
+  EXPECT_THAT(index_->DeleteDeadTerms(std::move(dead_terms)),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+  EXPECT_THAT(index_->DeleteDeadTerms(is_document_live), IsOkAndHolds(0));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId1, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+}
+
 TEST_F(IndexTest, GetElementsSize) {
   // Check empty index.
   ICING_ASSERT_OK_AND_ASSIGN(int64_t size, index_->GetElementsSize());
@@ -1618,6 +1698,176 @@ TEST_F(IndexTest, TruncateToThrowsOutBothIndices) {
   EXPECT_THAT(GetHits(std::move(itr)), IsEmpty());
 }
 
+TEST_F(IndexTest, SegmentedMainIndexWithChampionListsShouldFail) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.champion_list_size = 10;
+  options.segmented_main_index = true;
+  EXPECT_THAT(Index::Create(options, &filesystem_, &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+}
+
+TEST_F(IndexTest, SegmentedMainIndexHitsAcrossMerges) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.segmented_main_index = true;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::PREFIX, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+
+  edit = index_->Edit(kDocumentId1, kSectionId3, TermMatchType::PREFIX,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foot"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+  ICING_ASSERT_OK(index_->Merge());
+
+  edit = index_->Edit(kDocumentId2, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId2);
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId2));
+
+  // Hits come from the lite index and both segments.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("fool", kSectionIdMaskAll,
+                          TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId2, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId1, std::vector<SectionId>{kSectionId3}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::PREFIX));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId1, std::vector<SectionId>{kSectionId3}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+
+  EXPECT_THAT(index_->FindTermsByPrefix(/*prefix=*/"foo", /*namespace_ids=*/{0},
+                                        /*num_to_return=*/10),
+              IsOkAndHolds(UnorderedElementsAre(
+                  EqualsTermMetadata("fool", 3),
+                  EqualsTermMetadata("foot", 1))));
+}
+
+TEST_F(IndexTest, SegmentedMainIndexCompactsSegmentsSeparately) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.segmented_main_index = true;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_FALSE(index_->WantsSegmentCompaction());
+
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor; ++document_id) {
+    Index::Editor edit =
+        index_->Edit(document_id, kSectionId2, TermMatchType::EXACT_ONLY,
+                     /*namespace_id=*/0);
+    EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+    EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+    index_->set_last_added_document_id(document_id);
+    ICING_ASSERT_OK(index_->Merge());
+  }
+  EXPECT_TRUE(index_->WantsSegmentCompaction());
+  EXPECT_THAT(index_->CompactSegments(), IsOkAndHolds(false));
+  EXPECT_FALSE(index_->WantsSegmentCompaction());
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll,
+                          TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(GetHits(std::move(itr)),
+              SizeIs(SegmentedMainIndex::kMergeFactor));
+}
+
+TEST_F(IndexTest, SegmentedMainIndexSurvivesModeChange) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.segmented_main_index = true;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  Index::Editor edit = index_->Edit(
+      kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+
+  // Segments written before switching back to the main index stay searchable.
+  options.segmented_main_index = false;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId0));
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+  ICING_ASSERT_OK(index_->Merge());
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId1, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+}
+
+TEST_F(IndexTest, AndIteratorSkipsOverHits) {
+  // "foo" is in every document and "bar" in every 50th one, so intersecting
+  // them skips over most hits of "foo", across several posting lists once
+  // they're merged.
+  constexpr int kNumDocuments = 3000;
+  std::vector<DocumentId> expected_document_ids;
+  for (DocumentId document_id = 0; document_id < kNumDocuments;
+       ++document_id) {
+    Index::Editor edit =
+        index_->Edit(document_id, kSectionId2, TermMatchType::EXACT_ONLY,
+                     /*namespace_id=*/0);
+    EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+    if (document_id % 50 == 7) {
+      EXPECT_THAT(edit.BufferTerm("bar"), IsOk());
+      expected_document_ids.insert(expected_document_ids.begin(),
+                                   document_id);
+    }
+    EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+    index_->set_last_added_document_id(document_id);
+  }
+
+  auto get_document_ids = [this]() -> std::vector<DocumentId> {
+    std::vector<std::unique_ptr<DocHitInfoIterator>> iterators;
+    iterators.push_back(
+        index_->GetIterator("bar", kSectionIdMaskAll, TermMatchType::EXACT_ONLY)
+            .ValueOrDie());
+    iterators.push_back(
+        index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY)
+            .ValueOrDie());
+    std::unique_ptr<DocHitInfoIterator> itr =
+        CreateAndIterator(std::move(iterators));
+    std::vector<DocumentId> document_ids;
+    while (itr->Advance().ok()) {
+      document_ids.push_back(itr->doc_hit_info().document_id());
+    }
+    return document_ids;
+  };
+  EXPECT_THAT(get_document_ids(), ElementsAreArray(expected_document_ids));
+
+  ICING_ASSERT_OK(index_->Merge());
+  EXPECT_THAT(get_document_ids(), ElementsAreArray(expected_document_ids));
+}
+
 TEST_F(IndexTest, IndexStorageInfoProto) {
   // Add two documents to the lite index and merge them into main.
   {
@@ -1645,6 +1895,365 @@ TEST_F(IndexTest, IndexStorageInfoProto) {
   EXPECT_THAT(storage_info.min_free_fraction(), Ge(0));
 }
 
+TEST_F(IndexTest, MergeFillsInMergeStats) {
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::PREFIX, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("foot"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::PREFIX,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+
+  // "foo" becomes a branch point.
+  IndexMergeStatsProto merge_stats;
+  ICING_ASSERT_OK(index_->Merge(&merge_stats));
+  EXPECT_THAT(merge_stats.num_lite_hits(), Eq(3));
+  EXPECT_THAT(merge_stats.num_lite_terms(), Eq(2));
+  EXPECT_THAT(merge_stats.num_new_main_terms(), Eq(2));
+  EXPECT_THAT(merge_stats.num_branch_points_added(), Eq(1));
+  EXPECT_THAT(merge_stats.num_backfill_hits(), Eq(0));
+  EXPECT_THAT(merge_stats.num_posting_lists_allocated(), Eq(3));
+  EXPECT_THAT(merge_stats.num_posting_lists_freed(), Eq(0));
+  EXPECT_THAT(merge_stats.num_blocks_touched(), Gt(0));
+  EXPECT_THAT(merge_stats.posting_list_bytes_allocated(), Gt(0));
+  EXPECT_THAT(merge_stats.bytes_written(), Gt(0));
+  EXPECT_THAT(merge_stats.merge_lexicon_latency_ms(), Ge(0));
+  EXPECT_THAT(merge_stats.reset_latency_ms(), Ge(0));
+
+  // "fo" becomes a branch point and gets the hits of "foo" backfilled.
+  edit = index_->Edit(kDocumentId2, kSectionId2, TermMatchType::PREFIX,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fox"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId2);
+  merge_stats.Clear();
+  ICING_ASSERT_OK(index_->Merge(&merge_stats));
+  EXPECT_THAT(merge_stats.num_lite_hits(), Eq(2));
+  EXPECT_THAT(merge_stats.num_lite_terms(), Eq(2));
+  EXPECT_THAT(merge_stats.num_new_main_terms(), Eq(1));
+  EXPECT_THAT(merge_stats.num_branch_points_added(), Eq(1));
+  EXPECT_THAT(merge_stats.num_backfill_hits(), Eq(2));
+  EXPECT_THAT(merge_stats.num_posting_lists_allocated(), Gt(0));
+  EXPECT_THAT(merge_stats.num_blocks_touched(), Gt(0));
+}
+
+TEST_F(IndexTest, MergeStatsCountHitsPrependedInPlace) {
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::EXACT_ONLY,
+                                    /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+
+  // The second hit of "foo" fits into its existing posting list.
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+  IndexMergeStatsProto merge_stats;
+  ICING_ASSERT_OK(index_->Merge(&merge_stats));
+  EXPECT_THAT(merge_stats.num_posting_lists_allocated(), Eq(0));
+  EXPECT_THAT(merge_stats.posting_list_bytes_allocated(), Eq(0));
+  EXPECT_THAT(merge_stats.bytes_written(), Gt(0));
+}
+
+TEST_F(IndexTest, MergeStatsCountPostingListMoves) {
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::EXACT_ONLY,
+                                    /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+
+  // The hits of "foo" outgrow its posting list.
+  for (DocumentId document_id = 1; document_id < 100; ++document_id) {
+    edit = index_->Edit(document_id, kSectionId2, TermMatchType::EXACT_ONLY,
+                        /*namespace_id=*/0);
+    EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+    EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  }
+  index_->set_last_added_document_id(99);
+  IndexMergeStatsProto merge_stats;
+  ICING_ASSERT_OK(index_->Merge(&merge_stats));
+  EXPECT_THAT(merge_stats.num_new_main_terms(), Eq(0));
+  EXPECT_THAT(merge_stats.num_posting_lists_moved(), Eq(1));
+  EXPECT_THAT(merge_stats.num_posting_lists_freed(), Eq(1));
+  EXPECT_THAT(merge_stats.num_posting_lists_allocated(), Eq(1));
+  EXPECT_THAT(merge_stats.num_blocks_touched(), Eq(2));
+}
+
+TEST_F(IndexTest, PartitionedIndexRejectsInvalidOptions) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = -1;
+  EXPECT_THAT(Index::Create(options, &filesystem_, &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+  options.num_namespace_partitions = Index::kMaxNamespacePartitions + 1;
+  EXPECT_THAT(Index::Create(options, &filesystem_, &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+  options.num_namespace_partitions = 2;
+  options.champion_list_size = 10;
+  EXPECT_THAT(Index::Create(options, &filesystem_, &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+}
+
+TEST_F(IndexTest, PartitionedIndexOnlySearchesPartitionsOfNamespaces) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  ASSERT_TRUE(index_->is_partitioned());
+
+  // Namespaces 0 and 2 share a partition.
+  for (NamespaceId namespace_id = 0; namespace_id < 3; ++namespace_id) {
+    DocumentId document_id = namespace_id;
+    Index::Editor edit = index_->Edit(document_id, kSectionId2,
+                                      TermMatchType::PREFIX, namespace_id);
+    EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+    EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+    index_->set_last_added_document_id(document_id);
+    if (document_id == kDocumentId1) {
+      ICING_ASSERT_OK(index_->Merge());
+    }
+  }
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId2));
+  EXPECT_THAT(index_->last_merged_document_id(), Eq(kDocumentId1));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("fo", kSectionIdMaskAll, TermMatchType::PREFIX));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId2, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId1, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      itr, index_->GetIterator("fo", kSectionIdMaskAll, TermMatchType::PREFIX,
+                               Index::HitScope::kAll,
+                               /*champion_threshold=*/nullptr,
+                               /*namespace_ids=*/{1}));
+  EXPECT_THAT(GetHits(std::move(itr)),
+              ElementsAre(EqualsDocHitInfo(
+                  kDocumentId1, std::vector<SectionId>{kSectionId2})));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      itr, index_->GetIterator("foo", kSectionIdMaskAll,
+                               TermMatchType::EXACT_ONLY, Index::HitScope::kAll,
+                               /*champion_threshold=*/nullptr,
+                               /*namespace_ids=*/{0, 2}));
+  EXPECT_THAT(
+      GetHits(std::move(itr)),
+      ElementsAre(
+          EqualsDocHitInfo(kDocumentId2, std::vector<SectionId>{kSectionId2}),
+          EqualsDocHitInfo(kDocumentId0, std::vector<SectionId>{kSectionId2})));
+}
+
+TEST_F(IndexTest, PartitionedIndexSumsMergeStats) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::PREFIX, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("bar"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::PREFIX,
+                      /*namespace_id=*/1);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+
+  // Each partition has a lexicon of its own, so "foo" is new to both.
+  IndexMergeStatsProto merge_stats;
+  ICING_ASSERT_OK(index_->Merge(&merge_stats));
+  EXPECT_THAT(merge_stats.num_lite_hits(), Eq(3));
+  EXPECT_THAT(merge_stats.num_lite_terms(), Eq(3));
+  EXPECT_THAT(merge_stats.num_new_main_terms(), Eq(3));
+  EXPECT_THAT(index_->last_merged_document_id(), Eq(kDocumentId1));
+}
+
+TEST_F(IndexTest, PartitionedIndexFindTermsByPrefix) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::PREFIX, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("foot"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::PREFIX,
+                      /*namespace_id=*/1);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.BufferTerm("fox"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+
+  EXPECT_THAT(index_->FindTermsByPrefix("fo", /*namespace_ids=*/{},
+                                        /*num_to_return=*/10),
+              IsOkAndHolds(ElementsAre(EqualsTermMetadata("fool", 2),
+                                       EqualsTermMetadata("foot", 1),
+                                       EqualsTermMetadata("fox", 1))));
+  EXPECT_THAT(index_->FindTermsByPrefix("fo", /*namespace_ids=*/{1},
+                                        /*num_to_return=*/10),
+              IsOkAndHolds(ElementsAre(EqualsTermMetadata("fool", 1),
+                                       EqualsTermMetadata("fox", 1))));
+}
+
+TEST_F(IndexTest, PartitionedIndexResetPartition) {
+  EXPECT_THAT(index_->ResetPartition(/*namespace_id=*/0),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  for (NamespaceId namespace_id = 0; namespace_id < 2; ++namespace_id) {
+    DocumentId document_id = namespace_id;
+    Index::Editor edit = index_->Edit(document_id, kSectionId2,
+                                      TermMatchType::EXACT_ONLY, namespace_id);
+    EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+    EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+    index_->set_last_added_document_id(document_id);
+  }
+  ICING_ASSERT_OK(index_->Merge());
+
+  ICING_ASSERT_OK(index_->ResetPartition(/*namespace_id=*/0));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId1));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(GetHits(std::move(itr)),
+              ElementsAre(EqualsDocHitInfo(
+                  kDocumentId1, std::vector<SectionId>{kSectionId2})));
+
+  // The partition keeps up with the others after being reset.
+  ICING_ASSERT_OK(index_->PersistToDisk());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId1));
+}
+
+TEST_F(IndexTest, PartitionedIndexIsClearedWhenLayoutChanges) {
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::EXACT_ONLY,
+                                    /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.num_namespace_partitions = 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kInvalidDocumentId));
+  edit = index_->Edit(kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  // The same number of partitions keeps the index.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId0));
+
+  options.num_namespace_partitions = 3;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kInvalidDocumentId));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(GetHits(std::move(itr)), IsEmpty());
+  edit = index_->Edit(kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  options.num_namespace_partitions = 0;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_FALSE(index_->is_partitioned());
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kInvalidDocumentId));
+}
+
+TEST_F(IndexTest, FrontCodedMainLexicon) {
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.front_coded_main_lexicon = true;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::PREFIX, /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("fool"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  edit = index_->Edit(kDocumentId1, kSectionId2, TermMatchType::PREFIX,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foot"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId1);
+  ICING_ASSERT_OK(index_->Merge());
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  // The lexicon is read back when the index is created again.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::PREFIX));
+  std::vector<SectionId> sections = {kSectionId2};
+  EXPECT_THAT(GetHits(std::move(itr)),
+              ElementsAre(EqualsDocHitInfo(kDocumentId1, sections),
+                          EqualsDocHitInfo(kDocumentId0, sections)));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kDocumentId1));
+}
+
+TEST_F(IndexTest, IndexIsClearedWhenMainLexiconTypeChanges) {
+  Index::Editor edit = index_->Edit(kDocumentId0, kSectionId2,
+                                    TermMatchType::EXACT_ONLY,
+                                    /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  Index::Options options(index_dir_, /*index_merge_size=*/1024 * 1024);
+  options.front_coded_main_lexicon = true;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kInvalidDocumentId));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<DocHitInfoIterator> itr,
+      index_->GetIterator("foo", kSectionIdMaskAll, TermMatchType::EXACT_ONLY));
+  EXPECT_THAT(GetHits(std::move(itr)), IsEmpty());
+  edit = index_->Edit(kDocumentId0, kSectionId2, TermMatchType::EXACT_ONLY,
+                      /*namespace_id=*/0);
+  EXPECT_THAT(edit.BufferTerm("foo"), IsOk());
+  EXPECT_THAT(edit.IndexAllBufferedTerms(), IsOk());
+  index_->set_last_added_document_id(kDocumentId0);
+  ICING_ASSERT_OK(index_->Merge());
+  ICING_ASSERT_OK(index_->PersistToDisk());
+
+  options.front_coded_main_lexicon = false;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index_, Index::Create(options, &filesystem_, &icing_filesystem_));
+  EXPECT_THAT(index_->last_added_document_id(), Eq(kInvalidDocumentId));
+}
+
 }  // namespace
 
 }  // namespace lib
@@ -87,6 +87,21 @@ libtextclassifier3::Status DocHitInfoIteratorAnd::Advance() {
     return absl_ports::ResourceExhaustedError(
         "No more DocHitInfos in iterator");
   }
+  return AlignIterators();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorAnd::SkipTo(
+    DocumentId document_id) {
+  if (!short_->SkipTo(document_id).ok()) {
+    doc_hit_info_ = DocHitInfo(kInvalidDocumentId);
+    hit_intersect_section_ids_mask_ = kSectionIdMaskNone;
+    return absl_ports::ResourceExhaustedError(
+        "No more DocHitInfos in iterator");
+  }
+  return AlignIterators();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorAnd::AlignIterators() {
   DocumentId short_doc_id = short_->doc_hit_info().document_id();
 
   // Then AdvanceTo on long
@@ -143,6 +158,26 @@ libtextclassifier3::Status DocHitInfoIteratorAndNary::Advance() {
     return absl_ports::ResourceExhaustedError(
         "No more DocHitInfos in iterator");
   }
+  return AlignIterators();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorAndNary::SkipTo(
+    DocumentId document_id) {
+  if (iterators_.size() < 2) {
+    return absl_ports::InvalidArgumentError(
+        "Not enough iterators to AND together");
+  }
+
+  if (!iterators_.at(0)->SkipTo(document_id).ok()) {
+    doc_hit_info_ = DocHitInfo(kInvalidDocumentId);
+    hit_intersect_section_ids_mask_ = kSectionIdMaskNone;
+    return absl_ports::ResourceExhaustedError(
+        "No more DocHitInfos in iterator");
+  }
+  return AlignIterators();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorAndNary::AlignIterators() {
   DocumentId potential_document_id =
       iterators_.at(0)->doc_hit_info().document_id();
 
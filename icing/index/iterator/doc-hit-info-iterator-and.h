@@ -22,6 +22,7 @@
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/store/document-id.h"
 
 namespace icing {
 namespace lib {
@@ -40,6 +41,8 @@ class DocHitInfoIteratorAnd : public DocHitInfoIterator {
                                  std::unique_ptr<DocHitInfoIterator> long_it);
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override;
 
   int32_t GetNumLeafAdvanceCalls() const override;
@@ -60,6 +63,10 @@ class DocHitInfoIteratorAnd : public DocHitInfoIterator {
   }
 
  private:
+  // Advances short_ and long_ until they are at the same document_id, starting
+  // from the one short_ was just advanced to.
+  libtextclassifier3::Status AlignIterators();
+
   std::unique_ptr<DocHitInfoIterator> short_;
   std::unique_ptr<DocHitInfoIterator> long_;
 };
@@ -74,6 +81,8 @@ class DocHitInfoIteratorAndNary : public DocHitInfoIterator {
 
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override;
 
   int32_t GetNumLeafAdvanceCalls() const override;
@@ -94,6 +103,10 @@ class DocHitInfoIteratorAndNary : public DocHitInfoIterator {
   }
 
  private:
+  // Advances the iterators until they are all at the same document_id,
+  // starting from the one the first iterator was just advanced to.
+  libtextclassifier3::Status AlignIterators();
+
   std::vector<std::unique_ptr<DocHitInfoIterator>> iterators_;
 };
 
@@ -173,6 +173,52 @@ TEST(DocHitInfoIteratorAndTest, AdvanceNestedIterators) {
   EXPECT_THAT(GetDocumentIds(outer_iter.get()), ElementsAre(10, 6, 2));
 }
 
+TEST(DocHitInfoIteratorAndTest, AdvanceSkewedIterators) {
+  // The short iterator has a hit in every 100th document, so the long one skips
+  // over most of its hits.
+  std::vector<DocHitInfo> short_vector;
+  std::vector<DocHitInfo> long_vector;
+  std::vector<DocumentId> expected_document_ids;
+  for (DocumentId document_id = 1000; document_id >= 0; --document_id) {
+    long_vector.push_back(DocHitInfo(document_id));
+    if (document_id % 100 == 50) {
+      short_vector.push_back(DocHitInfo(document_id));
+      expected_document_ids.push_back(document_id);
+    }
+  }
+
+  DocHitInfoIteratorAnd and_iter(
+      std::make_unique<DocHitInfoIteratorDummy>(short_vector),
+      std::make_unique<DocHitInfoIteratorDummy>(long_vector));
+
+  EXPECT_THAT(GetDocumentIds(&and_iter),
+              ElementsAreArray(expected_document_ids));
+}
+
+TEST(DocHitInfoIteratorAndTest, SkipTo) {
+  std::vector<DocHitInfo> first_vector = {
+      DocHitInfo(10), DocHitInfo(9), DocHitInfo(8), DocHitInfo(7),
+      DocHitInfo(6),  DocHitInfo(5), DocHitInfo(4), DocHitInfo(3),
+      DocHitInfo(2),  DocHitInfo(1), DocHitInfo(0)};
+  std::vector<DocHitInfo> second_vector = {DocHitInfo(10), DocHitInfo(8),
+                                           DocHitInfo(6),  DocHitInfo(4),
+                                           DocHitInfo(2),  DocHitInfo(0)};
+
+  DocHitInfoIteratorAnd and_iter(
+      std::make_unique<DocHitInfoIteratorDummy>(first_vector),
+      std::make_unique<DocHitInfoIteratorDummy>(second_vector));
+
+  ICING_ASSERT_OK(and_iter.SkipTo(7));
+  EXPECT_THAT(and_iter.doc_hit_info().document_id(), Eq(6));
+  ICING_ASSERT_OK(and_iter.SkipTo(3));
+  EXPECT_THAT(and_iter.doc_hit_info().document_id(), Eq(2));
+  // Skipping to a larger document_id just advances.
+  ICING_ASSERT_OK(and_iter.SkipTo(8));
+  EXPECT_THAT(and_iter.doc_hit_info().document_id(), Eq(0));
+  EXPECT_THAT(and_iter.SkipTo(0),
+              StatusIs(libtextclassifier3::StatusCode::RESOURCE_EXHAUSTED));
+}
+
 TEST(DocHitInfoIteratorAndTest, SectionIdMask) {
   // Arbitrary section ids for the documents in the DocHitInfoIterators.
   // Created to test correct section_id_mask behavior.
@@ -425,6 +471,29 @@ TEST(DocHitInfoIteratorAndNaryTest, Advance) {
   EXPECT_THAT(GetDocumentIds(&and_iter), ElementsAre(6, 0));
 }
 
+TEST(DocHitInfoIteratorAndNaryTest, SkipTo) {
+  std::vector<DocHitInfo> first_vector = {
+      DocHitInfo(10), DocHitInfo(9), DocHitInfo(8), DocHitInfo(7),
+      DocHitInfo(6),  DocHitInfo(5), DocHitInfo(4), DocHitInfo(3),
+      DocHitInfo(2),  DocHitInfo(1), DocHitInfo(0)};
+  std::vector<DocHitInfo> second_vector = {DocHitInfo(10), DocHitInfo(8),
+                                           DocHitInfo(6),  DocHitInfo(4),
+                                           DocHitInfo(2),  DocHitInfo(0)};
+  std::vector<DocHitInfo> third_vector = {DocHitInfo(10), DocHitInfo(6),
+                                          DocHitInfo(4), DocHitInfo(0)};
+
+  std::vector<std::unique_ptr<DocHitInfoIterator>> iterators;
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(first_vector));
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(second_vector));
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(third_vector));
+  DocHitInfoIteratorAndNary and_iter(std::move(iterators));
+
+  ICING_ASSERT_OK(and_iter.SkipTo(5));
+  EXPECT_THAT(and_iter.doc_hit_info().document_id(), Eq(4));
+  ICING_ASSERT_OK(and_iter.Advance());
+  EXPECT_THAT(and_iter.doc_hit_info().document_id(), Eq(0));
+}
+
 TEST(DocHitInfoIteratorAndNaryTest, SectionIdMask) {
   // Arbitrary section ids for the documents in the DocHitInfoIterators.
   // Created to test correct section_id_mask behavior.
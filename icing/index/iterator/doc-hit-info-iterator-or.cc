@@ -14,6 +14,7 @@
 
 #include "icing/index/iterator/doc-hit-info-iterator-or.h"
 
+#include <algorithm>
 #include <cstdint>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
@@ -86,6 +87,38 @@ libtextclassifier3::Status DocHitInfoIteratorOr::Advance() {
     }
   }
 
+  return ChooseCurrent();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorOr::SkipTo(
+    DocumentId document_id) {
+  if (doc_hit_info_.document_id() != kInvalidDocumentId &&
+      doc_hit_info_.document_id() <= document_id) {
+    // Whatever comes next is below the current document_id.
+    return Advance();
+  }
+  // Skip the children that are above document_id. The ones that are already
+  // at or below it haven't been returned yet.
+  if (left_document_id_ != kInvalidDocumentId &&
+      left_document_id_ > document_id) {
+    if (left_->SkipTo(document_id).ok()) {
+      left_document_id_ = left_->doc_hit_info().document_id();
+    } else {
+      left_document_id_ = kInvalidDocumentId;
+    }
+  }
+  if (right_document_id_ != kInvalidDocumentId &&
+      right_document_id_ > document_id) {
+    if (right_->SkipTo(document_id).ok()) {
+      right_document_id_ = right_->doc_hit_info().document_id();
+    } else {
+      right_document_id_ = kInvalidDocumentId;
+    }
+  }
+  return ChooseCurrent();
+}
+
+libtextclassifier3::Status DocHitInfoIteratorOr::ChooseCurrent() {
   // Done, we either found a match or we reached the end of potential
   // DocHitInfos
   if (left_document_id_ == kInvalidDocumentId &&
@@ -155,7 +188,31 @@ libtextclassifier3::Status DocHitInfoIteratorOrNary::Advance() {
         "No more DocHitInfos in iterator");
   }
   // The maximum possible doc id for the current Advance() call.
-  const DocumentId next_document_id_max = doc_hit_info_.document_id() - 1;
+  return AdvanceToAtMost(doc_hit_info_.document_id() - 1);
+}
+
+libtextclassifier3::Status DocHitInfoIteratorOrNary::SkipTo(
+    DocumentId document_id) {
+  current_iterators_.clear();
+  if (iterators_.size() < 2) {
+    return absl_ports::InvalidArgumentError(
+        "Not enough iterators to OR together");
+  }
+
+  if (doc_hit_info_.document_id() == 0) {
+    // 0 is the smallest (last) DocumentId, can't advance further. Reset to
+    // invalid values and return directly
+    doc_hit_info_ = DocHitInfo(kInvalidDocumentId);
+    hit_intersect_section_ids_mask_ = kSectionIdMaskNone;
+    return absl_ports::ResourceExhaustedError(
+        "No more DocHitInfos in iterator");
+  }
+  return AdvanceToAtMost(
+      std::min(document_id, doc_hit_info_.document_id() - 1));
+}
+
+libtextclassifier3::Status DocHitInfoIteratorOrNary::AdvanceToAtMost(
+    DocumentId next_document_id_max) {
   doc_hit_info_ = DocHitInfo(kInvalidDocumentId);
   DocumentId next_document_id = kInvalidDocumentId;
   // Go through the iterators and try to find the maximum document_id that is
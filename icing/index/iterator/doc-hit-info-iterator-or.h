@@ -19,6 +19,7 @@
 #include <string>
 
 #include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/store/document-id.h"
 
 namespace icing {
 namespace lib {
@@ -36,6 +37,8 @@ class DocHitInfoIteratorOr : public DocHitInfoIterator {
 
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override;
 
   int32_t GetNumLeafAdvanceCalls() const override;
@@ -59,6 +62,9 @@ class DocHitInfoIteratorOr : public DocHitInfoIterator {
   }
 
  private:
+  // Sets doc_hit_info_ to the larger document_id of left_ and right_.
+  libtextclassifier3::Status ChooseCurrent();
+
   std::unique_ptr<DocHitInfoIterator> left_;
   std::unique_ptr<DocHitInfoIterator> right_;
   // Pointer to the chosen iterator that points to the current doc_hit_info_. If
@@ -79,6 +85,8 @@ class DocHitInfoIteratorOrNary : public DocHitInfoIterator {
 
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override;
 
   int32_t GetNumLeafAdvanceCalls() const override;
@@ -99,6 +107,10 @@ class DocHitInfoIteratorOrNary : public DocHitInfoIterator {
   }
 
  private:
+  // Advances to the largest document_id of the iterators that is at most
+  // next_document_id_max.
+  libtextclassifier3::Status AdvanceToAtMost(DocumentId next_document_id_max);
+
   std::vector<std::unique_ptr<DocHitInfoIterator>> iterators_;
   // Pointers to the iterators that point to the current doc_hit_info_.
   // current_iterators_ does not own the iterators it points to.
@@ -153,6 +153,29 @@ TEST(DocHitInfoIteratorOrTest, AdvanceNestedIterators) {
   EXPECT_THAT(GetDocumentIds(outer_iter.get()), ElementsAre(10, 9, 8, 7, 6, 5));
 }
 
+TEST(DocHitInfoIteratorOrTest, SkipTo) {
+  std::vector<DocHitInfo> first_vector = {DocHitInfo(10), DocHitInfo(8),
+                                          DocHitInfo(6), DocHitInfo(4)};
+  std::vector<DocHitInfo> second_vector = {DocHitInfo(9), DocHitInfo(6),
+                                           DocHitInfo(3)};
+
+  DocHitInfoIteratorOr or_iter(
+      std::make_unique<DocHitInfoIteratorDummy>(first_vector),
+      std::make_unique<DocHitInfoIteratorDummy>(second_vector));
+
+  ICING_ASSERT_OK(or_iter.Advance());
+  EXPECT_THAT(or_iter.doc_hit_info().document_id(), Eq(10));
+  ICING_ASSERT_OK(or_iter.SkipTo(7));
+  EXPECT_THAT(or_iter.doc_hit_info().document_id(), Eq(6));
+  // Skipping to a larger document_id just advances.
+  ICING_ASSERT_OK(or_iter.SkipTo(7));
+  EXPECT_THAT(or_iter.doc_hit_info().document_id(), Eq(4));
+  ICING_ASSERT_OK(or_iter.Advance());
+  EXPECT_THAT(or_iter.doc_hit_info().document_id(), Eq(3));
+  EXPECT_THAT(or_iter.SkipTo(2),
+              StatusIs(libtextclassifier3::StatusCode::RESOURCE_EXHAUSTED));
+}
+
 TEST(DocHitInfoIteratorOrTest, SectionIdMask) {
   // Arbitrary section ids for the documents in the DocHitInfoIterators.
   // Created to test correct section_id_mask behavior.
@@ -431,6 +454,22 @@ TEST(DocHitInfoIteratorOrNaryTest, Advance) {
   EXPECT_THAT(GetDocumentIds(&or_iter), ElementsAre(7, 6, 5, 4, 3, 2, 1, 0));
 }
 
+TEST(DocHitInfoIteratorOrNaryTest, SkipTo) {
+  std::vector<DocHitInfo> first_vector = {DocHitInfo(7), DocHitInfo(0)};
+  std::vector<DocHitInfo> second_vector = {DocHitInfo(6), DocHitInfo(1)};
+  std::vector<DocHitInfo> third_vector = {DocHitInfo(5), DocHitInfo(2)};
+
+  std::vector<std::unique_ptr<DocHitInfoIterator>> iterators;
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(first_vector));
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(second_vector));
+  iterators.push_back(std::make_unique<DocHitInfoIteratorDummy>(third_vector));
+  DocHitInfoIteratorOrNary or_iter(std::move(iterators));
+
+  ICING_ASSERT_OK(or_iter.SkipTo(4));
+  EXPECT_THAT(or_iter.doc_hit_info().document_id(), Eq(2));
+  EXPECT_THAT(GetDocumentIds(&or_iter), ElementsAre(1, 0));
+}
+
 TEST(DocHitInfoIteratorOrNaryTest, SectionIdMask) {
   // Arbitrary section ids for the documents in the DocHitInfoIterators.
   // Created to test correct section_id_mask behavior.
@@ -54,6 +54,13 @@ class DocHitInfoIteratorDummy : public DocHitInfoIterator {
         "No more DocHitInfos in iterator");
   }
 
+  // Imitates behavior of DocHitInfoIteratorTermLite
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override {
+    index_ = GallopTo(doc_hit_infos_, index_, doc_hit_infos_.size(),
+                      document_id);
+    return Advance();
+  }
+
   // Imitates behavior of DocHitInfoIteratorTermMain/DocHitInfoIteratorTermLite
   void PopulateMatchedTermsStats(
       std::vector<TermMatchInfo>* matched_terms_stats,
@@ -15,10 +15,12 @@
 #ifndef ICING_INDEX_ITERATOR_DOC_HIT_INFO_ITERATOR_H_
 #define ICING_INDEX_ITERATOR_DOC_HIT_INFO_ITERATOR_H_
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
@@ -26,6 +28,7 @@
 #include "icing/index/hit/doc-hit-info.h"
 #include "icing/schema/section.h"
 #include "icing/store/document-id.h"
+#include "icing/util/status-macros.h"
 
 namespace icing {
 namespace lib {
@@ -71,6 +74,25 @@ class DocHitInfoIterator {
   //   RESOUCE_EXHAUSTED if we've run out of document_ids to iterate over
   virtual libtextclassifier3::Status Advance() = 0;
 
+  // Advances to the next DocHitInfo whose document_id is at most document_id,
+  // skipping the ones in between. This is the same as calling Advance() until
+  // then, which is what the default implementation does. Iterators that hold
+  // their DocHitInfos in memory search for it instead.
+  //
+  // Returns:
+  //   OK if was able to advance to such a document_id.
+  //   INVALID_ARGUMENT if there are less than 2 iterators for an AND/OR
+  //       iterator
+  //   RESOUCE_EXHAUSTED if we've run out of document_ids to iterate over
+  virtual libtextclassifier3::Status SkipTo(DocumentId document_id) {
+    while (true) {
+      ICING_RETURN_IF_ERROR(Advance());
+      if (doc_hit_info_.document_id() <= document_id) {
+        return libtextclassifier3::Status::OK;
+      }
+    }
+  }
+
   // Returns the DocHitInfo that the iterator is currently at. The DocHitInfo
   // will have a kInvalidDocumentId if Advance() was not called after
   // construction or if Advance returned an error.
@@ -113,10 +135,8 @@ class DocHitInfoIterator {
   // document_id.
   libtextclassifier3::StatusOr<DocumentId> AdvanceTo(DocHitInfoIterator* it,
                                                      DocumentId document_id) {
-    while (it->Advance().ok()) {
-      if (it->doc_hit_info().document_id() <= document_id) {
-        return it->doc_hit_info().document_id();
-      }
+    if (it->SkipTo(document_id).ok()) {
+      return it->doc_hit_info().document_id();
     }
 
     // Didn't find anything for the other iterator, reset to invalid values and
@@ -126,6 +146,40 @@ class DocHitInfoIterator {
     return absl_ports::ResourceExhaustedError(
         "No more DocHitInfos in iterator");
   }
+
+  // Returns the index of the first DocHitInfo in doc_hit_infos[begin, end)
+  // whose document_id is at most document_id, or end if there is none.
+  // doc_hit_infos must be in descending document_id order.
+  //
+  // The next few DocHitInfos are checked one by one, since intersecting lists
+  // of similar sizes rarely skips far. After that, the search gallops ahead in
+  // steps that double in size and then binary searches the last step, so that
+  // skipping k DocHitInfos takes O(log k) comparisons.
+  static int GallopTo(const std::vector<DocHitInfo>& doc_hit_infos, int begin,
+                      int end, DocumentId document_id) {
+    constexpr int kNumLinearProbes = 8;
+    int linear_end = std::min(end, begin + kNumLinearProbes);
+    for (; begin < linear_end; ++begin) {
+      if (doc_hit_infos[begin].document_id() <= document_id) {
+        return begin;
+      }
+    }
+    // All DocHitInfos before begin are above document_id.
+    int step = 1;
+    while (begin + step < end &&
+           doc_hit_infos[begin + step].document_id() > document_id) {
+      begin += step + 1;
+      step *= 2;
+    }
+    // The first DocHitInfo at most document_id is in [begin, begin + step].
+    auto itr = std::partition_point(
+        doc_hit_infos.begin() + begin,
+        doc_hit_infos.begin() + std::min(end, begin + step + 1),
+        [document_id](const DocHitInfo& doc_hit_info) {
+          return doc_hit_info.document_id() > document_id;
+        });
+    return itr - doc_hit_infos.begin();
+  }
 };  // namespace DocHitInfoIterator
 
 }  // namespace lib
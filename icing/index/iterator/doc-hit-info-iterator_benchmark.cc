@@ -78,8 +78,6 @@ void BM_DocHitInfoIteratorAndBenchmark(benchmark::State& state) {
   std::vector<DocHitInfo> first_infos((starting_docid / interval) + 1);
   std::generate(first_infos.begin(), first_infos.end(),
                 GeneratorEveryOtherN(starting_docid, interval));
-  std::unique_ptr<DocHitInfoIterator> first_iter =
-      std::make_unique<DocHitInfoIteratorDummy>(first_infos);
 
   // Second iterator: An iterator with 1/4 of the hits as first_iter. If
   // starting_docid is 1024 and interval is 2, docids
@@ -88,15 +86,16 @@ void BM_DocHitInfoIteratorAndBenchmark(benchmark::State& state) {
   std::vector<DocHitInfo> second_infos((starting_docid / interval) + 1);
   std::generate(second_infos.begin(), second_infos.end(),
                 GeneratorEveryOtherN(starting_docid, interval));
-  std::unique_ptr<DocHitInfoIterator> second_iter =
-      std::make_unique<DocHitInfoIteratorDummy>(second_infos);
-
-  std::vector<std::unique_ptr<DocHitInfoIterator>> iters;
-  iters.push_back(std::move(first_iter));
-  iters.push_back(std::move(second_iter));
-  std::unique_ptr<DocHitInfoIterator> and_iter =
-      CreateAndIterator(std::move(iters));
+
   for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::unique_ptr<DocHitInfoIterator>> iters;
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(first_infos));
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(second_infos));
+    std::unique_ptr<DocHitInfoIterator> and_iter =
+        CreateAndIterator(std::move(iters));
+    state.ResumeTiming();
+
     while (and_iter->Advance().ok()) {
       // Intentionally left blank.
     }
@@ -127,8 +126,6 @@ void BM_DocHitInfoIteratorAndNaryBenchmark(benchmark::State& state) {
   std::vector<DocHitInfo> first_infos((starting_docid / interval) + 1);
   std::generate(first_infos.begin(), first_infos.end(),
                 GeneratorEveryOtherN(starting_docid, interval));
-  std::unique_ptr<DocHitInfoIterator> first_iter =
-      std::make_unique<DocHitInfoIteratorDummy>(first_infos);
 
   // Second iterator: An iterator with 1/2 of the hits as first_iter. If
   // starting_docid is 1024 and interval is 2, docids
@@ -137,8 +134,6 @@ void BM_DocHitInfoIteratorAndNaryBenchmark(benchmark::State& state) {
   std::vector<DocHitInfo> second_infos((starting_docid / interval) + 1);
   std::generate(second_infos.begin(), second_infos.end(),
                 GeneratorEveryOtherN(starting_docid, interval));
-  std::unique_ptr<DocHitInfoIterator> second_iter =
-      std::make_unique<DocHitInfoIteratorDummy>(second_infos);
 
   // Third iterator: An iterator with 1/4 of the hits as first_iter. If
   // starting_docid is 1024 and interval is 2, docids
@@ -147,16 +142,17 @@ void BM_DocHitInfoIteratorAndNaryBenchmark(benchmark::State& state) {
   std::vector<DocHitInfo> third_infos((starting_docid / interval) + 1);
   std::generate(third_infos.begin(), third_infos.end(),
                 GeneratorEveryOtherN(starting_docid, interval));
-  std::unique_ptr<DocHitInfoIterator> third_iter =
-      std::make_unique<DocHitInfoIteratorDummy>(third_infos);
-
-  std::vector<std::unique_ptr<DocHitInfoIterator>> iters;
-  iters.push_back(std::move(first_iter));
-  iters.push_back(std::move(second_iter));
-  iters.push_back(std::move(third_iter));
-  std::unique_ptr<DocHitInfoIterator> and_iter =
-      CreateAndIterator(std::move(iters));
+
   for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::unique_ptr<DocHitInfoIterator>> iters;
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(first_infos));
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(second_infos));
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(third_infos));
+    std::unique_ptr<DocHitInfoIterator> and_iter =
+        CreateAndIterator(std::move(iters));
+    state.ResumeTiming();
+
     while (and_iter->Advance().ok()) {
       // Intentionally left blank.
     }
@@ -179,6 +175,40 @@ BENCHMARK(BM_DocHitInfoIteratorAndNaryBenchmark)
     ->ArgPair(65536, 16)
     ->ArgPair(65536, 128);
 
+// Intersects an iterator with a hit in every document with one that has a hit
+// in every skew-th document, like a common term ANDed with a rare one. The AND
+// iterator skips over the hits of the common term in between.
+void BM_DocHitInfoIteratorAndSkewedBenchmark(benchmark::State& state) {
+  DocumentId starting_docid = state.range(0);
+  int skew = state.range(1);
+  std::vector<DocHitInfo> common_infos(starting_docid + 1);
+  std::generate(common_infos.begin(), common_infos.end(),
+                GeneratorEveryOtherN(starting_docid, 1));
+  std::vector<DocHitInfo> rare_infos((starting_docid / skew) + 1);
+  std::generate(rare_infos.begin(), rare_infos.end(),
+                GeneratorEveryOtherN(starting_docid, skew));
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::vector<std::unique_ptr<DocHitInfoIterator>> iters;
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(rare_infos));
+    iters.push_back(std::make_unique<DocHitInfoIteratorDummy>(common_infos));
+    std::unique_ptr<DocHitInfoIterator> and_iter =
+        CreateAndIterator(std::move(iters));
+    state.ResumeTiming();
+
+    while (and_iter->Advance().ok()) {
+      // Intentionally left blank.
+    }
+  }
+}
+BENCHMARK(BM_DocHitInfoIteratorAndSkewedBenchmark)
+    ->ArgPair(65536, 1)
+    ->ArgPair(65536, 8)
+    ->ArgPair(65536, 64)
+    ->ArgPair(65536, 512)
+    ->ArgPair(65536, 4096);
+
 }  // namespace
 
 }  // namespace lib
@@ -66,6 +66,22 @@ libtextclassifier3::Status DocHitInfoIteratorTermLite::Advance() {
   return libtextclassifier3::Status::OK;
 }
 
+libtextclassifier3::Status DocHitInfoIteratorTermLite::SkipTo(
+    DocumentId document_id) {
+  if (cached_hits_idx_ == -1) {
+    // All hits are retrieved on the first Advance.
+    ICING_RETURN_IF_ERROR(Advance());
+    if (doc_hit_info_.document_id() <= document_id) {
+      return libtextclassifier3::Status::OK;
+    }
+  }
+  // Stop right before the hit so that Advance returns it.
+  int next_idx = GallopTo(cached_hits_, cached_hits_idx_ + 1,
+                          cached_hits_.size(), document_id);
+  cached_hits_idx_ = next_idx - 1;
+  return Advance();
+}
+
 libtextclassifier3::Status DocHitInfoIteratorTermLiteExact::RetrieveMoreHits() {
   // Exact match only. All hits in lite lexicon are exact.
   ICING_ASSIGN_OR_RETURN(uint32_t tvi, lite_index_->GetTermId(term_));
@@ -24,6 +24,7 @@
 #include "icing/index/lite/lite-index.h"
 #include "icing/index/term-id-codec.h"
 #include "icing/schema/section.h"
+#include "icing/store/document-id.h"
 
 namespace icing {
 namespace lib {
@@ -43,6 +44,8 @@ class DocHitInfoIteratorTermLite : public DocHitInfoIterator {
 
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override {
     // TODO(b/137862424): Implement this once the main index is added.
     return 0;
@@ -30,6 +30,7 @@
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/mutex.h"
 #include "icing/absl_ports/str_cat.h"
 #include "icing/file/filesystem.h"
 #include "icing/index/hit/doc-hit-info.h"
@@ -63,6 +64,11 @@ std::string MakeHitBufferFilename(const std::string& filename_base) {
 
 size_t header_size() { return sizeof(IcingLiteIndex_HeaderImpl::HeaderData); }
 
+// The lite index header resets last_added_docid to the legacy invalid id, which
+// must agree with kInvalidDocumentId.
+static_assert(kIcingInvalidDocId == kInvalidDocumentId,
+              "Legacy and current invalid document ids must match");
+
 }  // namespace
 
 const TermIdHitPair::Value TermIdHitPair::kInvalidValue =
@@ -272,6 +278,10 @@ libtextclassifier3::Status LiteIndex::PersistToDisk() {
                          "Unable to sync lite index components.");
 }
 
+int64_t LiteIndex::ReleaseCleanPages() {
+  return hit_buffer_.ReleaseCleanPages() + lexicon_.ReleaseCleanPages();
+}
+
 void LiteIndex::UpdateChecksum() {
   header_->set_lite_index_crc(ComputeChecksum().Get());
 }
@@ -424,8 +434,10 @@ IndexStorageInfoProto LiteIndex::GetStorageInfo(
   return storage_info;
 }
 
-uint32_t LiteIndex::Seek(uint32_t term_id) {
-  // Make searchable by sorting by hit buffer.
+void LiteIndex::SortHits() {
+  // Make searchable by sorting by hit buffer. Concurrent searches may all find
+  // it unsorted, in which case the first one sorts it and the others wait.
+  absl_ports::unique_lock l(&sort_mutex_);
   uint32_t sort_len = header_->cur_size() - header_->searchable_end();
   if (sort_len > 0) {
     IcingTimer timer;
@@ -452,6 +464,10 @@ uint32_t LiteIndex::Seek(uint32_t term_id) {
     // Update crc in-line.
     UpdateChecksum();
   }
+}
+
+uint32_t LiteIndex::Seek(uint32_t term_id) {
+  SortHits();
 
   // Binary search for our term_id.  Make sure we get the first
   // element.  Using kBeginSortValue ensures this for the hit value.
@@ -27,6 +27,8 @@
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/mutex.h"
+#include "icing/absl_ports/thread_annotations.h"
 #include "icing/file/filesystem.h"
 #include "icing/index/hit/doc-hit-info.h"
 #include "icing/index/hit/hit.h"
@@ -81,6 +83,11 @@ class LiteIndex {
   //   INTERNAL on I/O error
   libtextclassifier3::Status PersistToDisk();
 
+  // Drops the mapped pages of the hit buffer and lexicon from memory. They are
+  // read back from disk when next accessed. Returns the number of bytes that
+  // were resident.
+  int64_t ReleaseCleanPages();
+
   // Calculate the checksum of all sub-components of the LiteIndex
   Crc32 ComputeChecksum();
 
@@ -141,6 +148,9 @@ class LiteIndex {
   // to hits_out. If hits_out is nullptr, no hits will be added.
   //
   // Returns the number of hits that would be added to hits_out.
+  //
+  // May be called from multiple threads at once, as long as no hits are added
+  // meanwhile.
   int AppendHits(uint32_t term_id, SectionIdMask section_id_mask,
                  bool only_from_prefix_sections,
                  std::vector<DocHitInfo>* hits_out);
@@ -271,9 +281,13 @@ class LiteIndex {
   // Sets the computed checksum in the header
   void UpdateChecksum();
 
+  // Sorts the hits added since the hit buffer was last sorted into the sorted
+  // ones.
+  void SortHits() ICING_LOCKS_EXCLUDED(sort_mutex_);
+
   // Returns the position of the first element with term_id, or the size of the
   // hit buffer if term_id is not present.
-  uint32_t Seek(uint32_t term_id);
+  uint32_t Seek(uint32_t term_id) ICING_LOCKS_EXCLUDED(sort_mutex_);
 
   // File descriptor that points to where the header and hit buffer are written
   // to.
@@ -295,6 +309,10 @@ class LiteIndex {
   // Wrapper around the mmapped header that contains stats on the lite index.
   std::unique_ptr<IcingLiteIndex_Header> header_;
 
+  // Serializes sorting the hit buffer between the searches that find it
+  // unsorted, since searches may run concurrently with each other.
+  absl_ports::shared_mutex sort_mutex_;
+
   // Options used to initialize the LiteIndex.
   const Options options_;
 
@@ -0,0 +1,219 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/champion-list-store.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/file-backed-vector.h"
+#include "icing/file/filesystem.h"
+#include "icing/file/memory-mapped-file.h"
+#include "icing/index/main/posting-list-identifier.h"
+#include "icing/store/document-id.h"
+#include "icing/util/logging.h"
+#include "icing/util/status-macros.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+// The entry of terms without a champion list.
+ChampionList NoChampionList() {
+  return {PostingListIdentifier::kInvalid,
+          {/*document_score=*/0, /*document_id=*/kInvalidDocumentId}};
+}
+
+std::string MakeHeaderFilename(const std::string& file_prefix) {
+  return absl_ports::StrCat(file_prefix, "-header");
+}
+
+std::string MakeChampionListsFilename(const std::string& file_prefix) {
+  return absl_ports::StrCat(file_prefix, "-lists");
+}
+
+// Returns whether the header at header_filename describes champion lists that
+// match a main index whose last indexed document is last_indexed_document_id.
+// Sets champion_list_size to the size that the lists were built with if so.
+bool ReadMatchingHeader(const Filesystem& filesystem,
+                        const std::string& header_filename,
+                        DocumentId last_indexed_document_id,
+                        int* champion_list_size) {
+  if (filesystem.GetFileSize(header_filename.c_str()) !=
+      sizeof(ChampionListStore::Header)) {
+    return false;
+  }
+  ChampionListStore::Header header;
+  if (!filesystem.Read(header_filename.c_str(), &header, sizeof(header))) {
+    return false;
+  }
+  if (header.magic != ChampionListStore::Header::kMagic ||
+      header.last_indexed_document_id != last_indexed_document_id) {
+    return false;
+  }
+  *champion_list_size = header.champion_list_size;
+  return true;
+}
+
+}  // namespace
+
+libtextclassifier3::StatusOr<std::unique_ptr<ChampionListStore>>
+ChampionListStore::Create(const Filesystem* filesystem,
+                          const std::string& file_prefix,
+                          DocumentId last_indexed_document_id) {
+  ICING_RETURN_ERROR_IF_NULL(filesystem);
+  std::string header_filename = MakeHeaderFilename(file_prefix);
+  std::string champion_lists_filename = MakeChampionListsFilename(file_prefix);
+
+  int champion_list_size = 0;
+  std::unique_ptr<FileBackedVector<ChampionList>> champion_lists;
+  if (ReadMatchingHeader(*filesystem, header_filename,
+                         last_indexed_document_id, &champion_list_size)) {
+    auto champion_lists_or = FileBackedVector<ChampionList>::Create(
+        *filesystem, champion_lists_filename,
+        MemoryMappedFile::READ_WRITE_AUTO_SYNC);
+    if (champion_lists_or.ok()) {
+      champion_lists = std::move(champion_lists_or).ValueOrDie();
+    } else {
+      ICING_LOG(WARNING) << "Discarding champion lists: "
+                         << champion_lists_or.status().error_message();
+    }
+  }
+
+  if (champion_lists == nullptr) {
+    // Either there were no champion lists or they can't be trusted. Start
+    // over without any.
+    champion_list_size = 0;
+    ICING_RETURN_IF_ERROR(FileBackedVector<ChampionList>::Delete(
+        *filesystem, champion_lists_filename));
+    ICING_ASSIGN_OR_RETURN(champion_lists,
+                           FileBackedVector<ChampionList>::Create(
+                               *filesystem, champion_lists_filename,
+                               MemoryMappedFile::READ_WRITE_AUTO_SYNC));
+  }
+
+  auto store = std::unique_ptr<ChampionListStore>(
+      new ChampionListStore(filesystem, std::move(header_filename),
+                            std::move(champion_lists), champion_list_size));
+  // Any change to the lists from here on invalidates the header until the
+  // next PersistToDisk. The header is overwritten rather than deleted so that
+  // the store's disk usage stays the same.
+  ICING_RETURN_IF_ERROR(store->WriteHeader(/*magic=*/0, kInvalidDocumentId));
+  return store;
+}
+
+libtextclassifier3::Status ChampionListStore::Delete(
+    const Filesystem* filesystem, const std::string& file_prefix) {
+  ICING_RETURN_ERROR_IF_NULL(filesystem);
+  ICING_RETURN_IF_ERROR(FileBackedVector<ChampionList>::Delete(
+      *filesystem, MakeChampionListsFilename(file_prefix)));
+  std::string header_filename = MakeHeaderFilename(file_prefix);
+  if (!filesystem->DeleteFile(header_filename.c_str())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to delete file: ", header_filename));
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<ChampionList> ChampionListStore::Get(
+    uint32_t tvi) const {
+  if (tvi >= champion_lists_->num_elements()) {
+    return absl_ports::NotFoundError("Term has no champion list.");
+  }
+  ICING_ASSIGN_OR_RETURN(const ChampionList* champion_list,
+                         champion_lists_->Get(tvi));
+  if (!champion_list->posting_list_id.is_valid()) {
+    return absl_ports::NotFoundError("Term has no champion list.");
+  }
+  return *champion_list;
+}
+
+libtextclassifier3::Status ChampionListStore::Put(
+    uint32_t tvi, const ChampionList& champion_list) {
+  int32_t num_elements = champion_lists_->num_elements();
+  ICING_RETURN_IF_ERROR(champion_lists_->Set(tvi, champion_list));
+  // Terms in between may not have been given a champion list yet. The file
+  // may still hold lists from before the last Clear for them.
+  ChampionList no_champion_list = NoChampionList();
+  for (uint32_t i = num_elements; i < tvi; ++i) {
+    ICING_RETURN_IF_ERROR(champion_lists_->Set(i, no_champion_list));
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status ChampionListStore::Remove(uint32_t tvi) {
+  if (tvi >= champion_lists_->num_elements()) {
+    return libtextclassifier3::Status::OK;
+  }
+  return champion_lists_->Set(tvi, NoChampionList());
+}
+
+std::vector<PostingListIdentifier> ChampionListStore::GetPostingListIds()
+    const {
+  std::vector<PostingListIdentifier> posting_list_ids;
+  const ChampionList* champion_lists = champion_lists_->array();
+  for (int32_t i = 0; i < champion_lists_->num_elements(); ++i) {
+    if (champion_lists[i].posting_list_id.is_valid()) {
+      posting_list_ids.push_back(champion_lists[i].posting_list_id);
+    }
+  }
+  return posting_list_ids;
+}
+
+libtextclassifier3::Status ChampionListStore::Clear(int champion_list_size) {
+  if (champion_lists_->num_elements() > 0) {
+    ICING_RETURN_IF_ERROR(champion_lists_->TruncateTo(0));
+  }
+  champion_list_size_ = champion_list_size;
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status ChampionListStore::PersistToDisk(
+    DocumentId last_indexed_document_id) {
+  ICING_RETURN_IF_ERROR(champion_lists_->PersistToDisk());
+  return WriteHeader(Header::kMagic, last_indexed_document_id);
+}
+
+libtextclassifier3::StatusOr<int64_t> ChampionListStore::GetElementsSize()
+    const {
+  return champion_lists_->GetElementsFileSize();
+}
+
+libtextclassifier3::Status ChampionListStore::WriteHeader(
+    int32_t magic, DocumentId last_indexed_document_id) {
+  Header header;
+  header.magic = magic;
+  header.champion_list_size = champion_list_size_;
+  header.last_indexed_document_id = last_indexed_document_id;
+
+  // This should overwrite the header.
+  ScopedFd sfd(filesystem_->OpenForWrite(header_filename_.c_str()));
+  if (!sfd.is_valid() ||
+      !filesystem_->Write(sfd.get(), &header, sizeof(header)) ||
+      !filesystem_->DataSync(sfd.get())) {
+    return absl_ports::InternalError(absl_ports::StrCat(
+        "Failed to write champion list header: ", header_filename_));
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+}  // namespace lib
+}  // namespace icing
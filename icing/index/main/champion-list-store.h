@@ -0,0 +1,187 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_INDEX_MAIN_CHAMPION_LIST_STORE_H_
+#define ICING_INDEX_MAIN_CHAMPION_LIST_STORE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/file/file-backed-vector.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/main/posting-list-identifier.h"
+#include "icing/store/document-id.h"
+
+namespace icing {
+namespace lib {
+
+// Where a document ranks in a champion list: by document score, with ties
+// broken by DocumentId. This is the order that DOCUMENT_SCORE ranking returns
+// results in.
+struct ChampionRank {
+  int32_t document_score;
+  DocumentId document_id;
+
+  bool operator<(const ChampionRank& other) const {
+    if (document_score != other.document_score) {
+      return document_score < other.document_score;
+    }
+    return document_id < other.document_id;
+  }
+
+  bool operator==(const ChampionRank& other) const {
+    return document_score == other.document_score &&
+           document_id == other.document_id;
+  }
+};
+
+// The champion list of a term holds the hits of the best ranked documents of
+// the term's posting list.
+struct ChampionList {
+  // The posting list chain holding the hits of the champion documents.
+  PostingListIdentifier posting_list_id;
+
+  // Every document of the term's posting list that ranks at or above
+  // threshold is in the champion list, unless it was deleted.
+  ChampionRank threshold;
+
+  bool operator==(const ChampionList& other) const {
+    return posting_list_id == other.posting_list_id &&
+           threshold == other.threshold;
+  }
+};
+
+// Stores the champion lists of the terms of the main lexicon, indexed by the
+// terms' value indices. The posting lists of the champion lists themselves
+// live in the main index's FlashIndexStorage.
+class ChampionListStore {
+ public:
+  struct Header {
+    static constexpr int32_t kMagic = 0x63686d70;
+
+    // Holds the magic as a quick sanity check against file corruption.
+    int32_t magic;
+
+    // The number of documents the champion lists were built with.
+    int32_t champion_list_size;
+
+    // The last document of the main index when the champion lists were
+    // persisted.
+    DocumentId last_indexed_document_id;
+  };
+
+  // Creates or loads the champion lists stored in the files starting with
+  // file_prefix.
+  //
+  // The stored champion lists are discarded if they can't be shown to match a
+  // main index whose last indexed document is last_indexed_document_id, e.g.
+  // after a crash. Their posting lists are not freed then, since they may not
+  // be valid anymore.
+  //
+  // Returns:
+  //   A ChampionListStore on success
+  //   INTERNAL on I/O error
+  static libtextclassifier3::StatusOr<std::unique_ptr<ChampionListStore>>
+  Create(const Filesystem* filesystem, const std::string& file_prefix,
+         DocumentId last_indexed_document_id);
+
+  // Deletes the files of the champion lists stored in the files starting with
+  // file_prefix. The files may not exist.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  static libtextclassifier3::Status Delete(const Filesystem* filesystem,
+                                           const std::string& file_prefix);
+
+  // The number of documents that the stored champion lists were built with.
+  int champion_list_size() const { return champion_list_size_; }
+
+  // Returns:
+  //   The champion list of the term with value index tvi on success
+  //   NOT_FOUND if the term has no champion list
+  libtextclassifier3::StatusOr<ChampionList> Get(uint32_t tvi) const;
+
+  // Sets the champion list of the term with value index tvi.
+  //
+  // Returns:
+  //   OK on success
+  //   OUT_OF_RANGE if tvi is too large
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Put(uint32_t tvi,
+                                 const ChampionList& champion_list);
+
+  // Removes the champion list of the term with value index tvi, if any.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Remove(uint32_t tvi);
+
+  // Returns the posting list ids of all stored champion lists.
+  std::vector<PostingListIdentifier> GetPostingListIds() const;
+
+  // Removes all champion lists. Lists that are built afterwards hold
+  // champion_list_size documents.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Clear(int champion_list_size);
+
+  // Syncs the champion lists to disk, marking them as matching a main index
+  // whose last indexed document is last_indexed_document_id.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status PersistToDisk(
+      DocumentId last_indexed_document_id);
+
+  // Returns:
+  //   The size of the stored champion lists, not counting their posting
+  //   lists, on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::StatusOr<int64_t> GetElementsSize() const;
+
+ private:
+  explicit ChampionListStore(
+      const Filesystem* filesystem, std::string header_filename,
+      std::unique_ptr<FileBackedVector<ChampionList>> champion_lists,
+      int champion_list_size)
+      : filesystem_(filesystem),
+        header_filename_(std::move(header_filename)),
+        champion_lists_(std::move(champion_lists)),
+        champion_list_size_(champion_list_size) {}
+
+  // Writes a header with the given magic. Only headers with Header::kMagic
+  // are ever loaded.
+  libtextclassifier3::Status WriteHeader(int32_t magic,
+                                         DocumentId last_indexed_document_id);
+
+  const Filesystem* filesystem_;
+  std::string header_filename_;
+  std::unique_ptr<FileBackedVector<ChampionList>> champion_lists_;
+  int champion_list_size_;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_INDEX_MAIN_CHAMPION_LIST_STORE_H_
@@ -0,0 +1,253 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/champion-list-store.h"
+
+#include <memory>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/main/posting-list-identifier.h"
+#include "icing/store/document-id.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+
+class ChampionListStoreTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = GetTestTempDir() + "/champion_list_store_test";
+    file_prefix_ = test_dir_ + "/champions";
+    ASSERT_TRUE(filesystem_.CreateDirectoryRecursively(test_dir_.c_str()));
+  }
+
+  void TearDown() override {
+    ASSERT_TRUE(filesystem_.DeleteDirectoryRecursively(test_dir_.c_str()));
+  }
+
+  std::string test_dir_;
+  std::string file_prefix_;
+  Filesystem filesystem_;
+};
+
+ChampionList MakeChampionList(uint32_t block_index, int32_t document_score,
+                              DocumentId document_id) {
+  return {PostingListIdentifier(block_index, /*posting_list_index=*/0,
+                                /*posting_list_index_bits=*/4),
+          {document_score, document_id}};
+}
+
+TEST_F(ChampionListStoreTest, CreateWithNullFilesystemFails) {
+  EXPECT_THAT(ChampionListStore::Create(/*filesystem=*/nullptr, file_prefix_,
+                                        /*last_indexed_document_id=*/0),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+}
+
+TEST_F(ChampionListStoreTest, EmptyStoreHasNoChampionLists) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/0));
+  EXPECT_THAT(store->champion_list_size(), Eq(0));
+  EXPECT_THAT(store->Get(0),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(store->GetPostingListIds(), IsEmpty());
+}
+
+TEST_F(ChampionListStoreTest, PutAndGet) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/0));
+  ChampionList champion_list = MakeChampionList(/*block_index=*/1,
+                                                /*document_score=*/5,
+                                                /*document_id=*/3);
+  ICING_ASSERT_OK(store->Put(/*tvi=*/2, champion_list));
+
+  EXPECT_THAT(store->Get(2), IsOkAndHolds(Eq(champion_list)));
+  // Terms before it have no champion list.
+  EXPECT_THAT(store->Get(0),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(store->Get(1),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(store->Get(3),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(store->GetPostingListIds(),
+              ElementsAre(champion_list.posting_list_id));
+}
+
+TEST_F(ChampionListStoreTest, Remove) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/0));
+  ICING_ASSERT_OK(store->Put(/*tvi=*/0, MakeChampionList(/*block_index=*/1,
+                                                         /*document_score=*/5,
+                                                         /*document_id=*/3)));
+  ICING_ASSERT_OK(store->Remove(/*tvi=*/0));
+  EXPECT_THAT(store->Get(0),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+
+  // Removing a champion list that doesn't exist is fine.
+  ICING_EXPECT_OK(store->Remove(/*tvi=*/10));
+}
+
+TEST_F(ChampionListStoreTest, ClearRemovesAllChampionLists) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/0));
+  ICING_ASSERT_OK(store->Put(/*tvi=*/3, MakeChampionList(/*block_index=*/1,
+                                                         /*document_score=*/5,
+                                                         /*document_id=*/3)));
+  ICING_ASSERT_OK(store->Clear(/*champion_list_size=*/10));
+  EXPECT_THAT(store->champion_list_size(), Eq(10));
+  EXPECT_THAT(store->GetPostingListIds(), IsEmpty());
+
+  // Terms before a new champion list don't get the old lists back.
+  ChampionList champion_list = MakeChampionList(/*block_index=*/2,
+                                                /*document_score=*/1,
+                                                /*document_id=*/7);
+  ICING_ASSERT_OK(store->Put(/*tvi=*/5, champion_list));
+  EXPECT_THAT(store->Get(3),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(store->GetPostingListIds(),
+              ElementsAre(champion_list.posting_list_id));
+}
+
+TEST_F(ChampionListStoreTest, PutWithTooLargeTviFails) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/0));
+  EXPECT_THAT(store->Put(/*tvi=*/1u << 24,
+                         MakeChampionList(/*block_index=*/1,
+                                          /*document_score=*/5,
+                                          /*document_id=*/3)),
+              StatusIs(libtextclassifier3::StatusCode::OUT_OF_RANGE));
+}
+
+TEST_F(ChampionListStoreTest, PersistedChampionListsAreLoaded) {
+  ChampionList champion_list = MakeChampionList(/*block_index=*/1,
+                                                /*document_score=*/5,
+                                                /*document_id=*/3);
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ChampionListStore> store,
+        ChampionListStore::Create(&filesystem_, file_prefix_,
+                                  /*last_indexed_document_id=*/0));
+    ICING_ASSERT_OK(store->Clear(/*champion_list_size=*/2));
+    ICING_ASSERT_OK(store->Put(/*tvi=*/1, champion_list));
+    ICING_ASSERT_OK(store->PersistToDisk(/*last_indexed_document_id=*/8));
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/8));
+  EXPECT_THAT(store->champion_list_size(), Eq(2));
+  EXPECT_THAT(store->Get(1), IsOkAndHolds(Eq(champion_list)));
+}
+
+TEST_F(ChampionListStoreTest, ChampionListsOfOtherIndexAreDiscarded) {
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ChampionListStore> store,
+        ChampionListStore::Create(&filesystem_, file_prefix_,
+                                  /*last_indexed_document_id=*/0));
+    ICING_ASSERT_OK(store->Clear(/*champion_list_size=*/2));
+    ICING_ASSERT_OK(store->Put(/*tvi=*/1, MakeChampionList(
+                                              /*block_index=*/1,
+                                              /*document_score=*/5,
+                                              /*document_id=*/3)));
+    ICING_ASSERT_OK(store->PersistToDisk(/*last_indexed_document_id=*/8));
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/9));
+  EXPECT_THAT(store->champion_list_size(), Eq(0));
+  EXPECT_THAT(store->GetPostingListIds(), IsEmpty());
+}
+
+TEST_F(ChampionListStoreTest, UnpersistedChangesDiscardChampionLists) {
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ChampionListStore> store,
+        ChampionListStore::Create(&filesystem_, file_prefix_,
+                                  /*last_indexed_document_id=*/0));
+    ICING_ASSERT_OK(store->Clear(/*champion_list_size=*/2));
+    ICING_ASSERT_OK(store->PersistToDisk(/*last_indexed_document_id=*/8));
+  }
+  {
+    // Changes after loading the lists that are never persisted, as if the
+    // process crashed.
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ChampionListStore> store,
+        ChampionListStore::Create(&filesystem_, file_prefix_,
+                                  /*last_indexed_document_id=*/8));
+    ICING_ASSERT_OK(store->Put(/*tvi=*/1, MakeChampionList(
+                                              /*block_index=*/1,
+                                              /*document_score=*/5,
+                                              /*document_id=*/3)));
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/8));
+  EXPECT_THAT(store->champion_list_size(), Eq(0));
+  EXPECT_THAT(store->GetPostingListIds(), IsEmpty());
+}
+
+TEST_F(ChampionListStoreTest, DeleteRemovesPersistedChampionLists) {
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<ChampionListStore> store,
+        ChampionListStore::Create(&filesystem_, file_prefix_,
+                                  /*last_indexed_document_id=*/0));
+    ICING_ASSERT_OK(store->Clear(/*champion_list_size=*/2));
+    ICING_ASSERT_OK(store->Put(/*tvi=*/1, MakeChampionList(
+                                              /*block_index=*/1,
+                                              /*document_score=*/5,
+                                              /*document_id=*/3)));
+    ICING_ASSERT_OK(store->PersistToDisk(/*last_indexed_document_id=*/8));
+  }
+  ICING_ASSERT_OK(ChampionListStore::Delete(&filesystem_, file_prefix_));
+  // Deleting files that are already gone is fine.
+  ICING_ASSERT_OK(ChampionListStore::Delete(&filesystem_, file_prefix_));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<ChampionListStore> store,
+      ChampionListStore::Create(&filesystem_, file_prefix_,
+                                /*last_indexed_document_id=*/8));
+  EXPECT_THAT(store->champion_list_size(), Eq(0));
+  EXPECT_THAT(store->GetPostingListIds(), IsEmpty());
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -14,6 +14,7 @@
 
 #include "icing/index/main/doc-hit-info-iterator-term-main.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
@@ -80,6 +81,27 @@ libtextclassifier3::Status DocHitInfoIteratorTermMain::Advance() {
   return libtextclassifier3::Status::OK;
 }
 
+libtextclassifier3::Status DocHitInfoIteratorTermMain::SkipTo(
+    DocumentId document_id) {
+  while (true) {
+    // Advance returns the cached hits up to the second to last one before it
+    // retrieves more hits. Skip the ones above document_id, so that the next
+    // batch is retrieved right away if all of them are.
+    int last_idx = static_cast<int>(cached_doc_hit_infos_.size()) - 2;
+    if (posting_list_accessor_ != nullptr &&
+        cached_doc_hit_infos_idx_ < last_idx) {
+      int next_idx = GallopTo(cached_doc_hit_infos_,
+                              cached_doc_hit_infos_idx_ + 1, last_idx + 1,
+                              document_id);
+      cached_doc_hit_infos_idx_ = next_idx - 1;
+    }
+    ICING_RETURN_IF_ERROR(Advance());
+    if (doc_hit_info_.document_id() <= document_id) {
+      return libtextclassifier3::Status::OK;
+    }
+  }
+}
+
 libtextclassifier3::Status DocHitInfoIteratorTermMainExact::RetrieveMoreHits() {
   DocHitInfo last_doc_hit_info;
   if (!cached_doc_hit_infos_.empty()) {
@@ -93,8 +115,10 @@ libtextclassifier3::Status DocHitInfoIteratorTermMainExact::RetrieveMoreHits() {
     cached_doc_hit_infos_.push_back(last_doc_hit_info);
   }
   if (posting_list_accessor_ == nullptr) {
-    ICING_ASSIGN_OR_RETURN(posting_list_accessor_,
-                           main_index_->GetAccessorForExactTerm(term_));
+    ICING_ASSIGN_OR_RETURN(
+        posting_list_accessor_,
+        champions_only_ ? main_index_->GetChampionAccessorForExactTerm(term_)
+                        : main_index_->GetAccessorForExactTerm(term_));
   }
 
   ICING_ASSIGN_OR_RETURN(std::vector<Hit> hits,
@@ -140,15 +164,31 @@ DocHitInfoIteratorTermMainPrefix::RetrieveMoreHits() {
   }
 
   ++num_blocks_inspected_;
+  std::vector<Hit> pending_backfill_hits;
   if (posting_list_accessor_ == nullptr) {
     ICING_ASSIGN_OR_RETURN(
         MainIndex::GetPrefixAccessorResult result,
-        main_index_->GetAccessorForPrefixTerm(term_));
+        champions_only_ ? main_index_->GetChampionAccessorForPrefixTerm(term_)
+                        : main_index_->GetAccessorForPrefixTerm(term_));
     posting_list_accessor_ = std::move(result.accessor);
     exact_ = result.exact;
+    pending_backfill_hits = std::move(result.pending_backfill_hits);
   }
   ICING_ASSIGN_OR_RETURN(std::vector<Hit> hits,
                          posting_list_accessor_->GetNextHitsBatch());
+  if (!pending_backfill_hits.empty()) {
+    // The hits are spread over several posting lists until the backfill is
+    // done. Read all of them at once to merge them in order.
+    ICING_ASSIGN_OR_RETURN(std::vector<Hit> batch,
+                           posting_list_accessor_->GetNextHitsBatch());
+    while (!batch.empty()) {
+      hits.insert(hits.end(), batch.begin(), batch.end());
+      ICING_ASSIGN_OR_RETURN(batch, posting_list_accessor_->GetNextHitsBatch());
+    }
+    hits.insert(hits.end(), pending_backfill_hits.begin(),
+                pending_backfill_hits.end());
+    std::sort(hits.begin(), hits.end());
+  }
   cached_doc_hit_infos_.reserve(hits.size());
   for (const Hit& hit : hits) {
     // Check sections.
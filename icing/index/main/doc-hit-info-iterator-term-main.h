@@ -25,17 +25,22 @@
 #include "icing/index/main/main-index.h"
 #include "icing/index/main/posting-list-accessor.h"
 #include "icing/schema/section.h"
+#include "icing/store/document-id.h"
 
 namespace icing {
 namespace lib {
 
 class DocHitInfoIteratorTermMain : public DocHitInfoIterator {
  public:
+  // If champions_only is true, only the hits in the champion lists of the
+  // main index are returned where there is one.
   explicit DocHitInfoIteratorTermMain(MainIndex* main_index,
                                       const std::string& term,
-                                      SectionIdMask section_restrict_mask)
+                                      SectionIdMask section_restrict_mask,
+                                      bool champions_only)
       : term_(term),
         main_index_(main_index),
+        champions_only_(champions_only),
         cached_doc_hit_infos_idx_(-1),
         num_advance_calls_(0),
         num_blocks_inspected_(0),
@@ -44,6 +49,8 @@ class DocHitInfoIteratorTermMain : public DocHitInfoIterator {
 
   libtextclassifier3::Status Advance() override;
 
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
   int32_t GetNumBlocksInspected() const override {
     return num_blocks_inspected_;
   }
@@ -89,6 +96,8 @@ class DocHitInfoIteratorTermMain : public DocHitInfoIterator {
   std::unique_ptr<PostingListAccessor> posting_list_accessor_;
 
   MainIndex* main_index_;
+  // Whether to read the term's champion list instead of its full posting list.
+  const bool champions_only_;
   // Stores hits retrieved from the index. This may only be a subset of the hits
   // that are present in the index. Current value pointed to by the Iterator is
   // tracked by cached_doc_hit_infos_idx_.
@@ -106,8 +115,10 @@ class DocHitInfoIteratorTermMainExact : public DocHitInfoIteratorTermMain {
  public:
   explicit DocHitInfoIteratorTermMainExact(MainIndex* main_index,
                                            const std::string& term,
-                                           SectionIdMask section_restrict_mask)
-      : DocHitInfoIteratorTermMain(main_index, term, section_restrict_mask) {}
+                                           SectionIdMask section_restrict_mask,
+                                           bool champions_only)
+      : DocHitInfoIteratorTermMain(main_index, term, section_restrict_mask,
+                                   champions_only) {}
 
   std::string ToString() const override;
 
@@ -119,8 +130,10 @@ class DocHitInfoIteratorTermMainPrefix : public DocHitInfoIteratorTermMain {
  public:
   explicit DocHitInfoIteratorTermMainPrefix(MainIndex* main_index,
                                             const std::string& term,
-                                            SectionIdMask section_restrict_mask)
-      : DocHitInfoIteratorTermMain(main_index, term, section_restrict_mask) {}
+                                            SectionIdMask section_restrict_mask,
+                                            bool champions_only)
+      : DocHitInfoIteratorTermMain(main_index, term, section_restrict_mask,
+                                   champions_only) {}
 
   std::string ToString() const override;
 
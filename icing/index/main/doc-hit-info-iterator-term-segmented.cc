@@ -0,0 +1,162 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/doc-hit-info-iterator-term-segmented.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/index/hit/doc-hit-info.h"
+#include "icing/schema/section.h"
+#include "icing/util/logging.h"
+#include "icing/util/status-macros.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+std::string SectionIdMaskToString(SectionIdMask section_id_mask) {
+  std::string mask(kMaxSectionId + 1, '0');
+  for (SectionId i = kMaxSectionId; i >= 0; --i) {
+    if (section_id_mask & (1U << i)) {
+      mask[kMaxSectionId - i] = '1';
+    }
+  }
+  return mask;
+}
+
+}  // namespace
+
+libtextclassifier3::Status DocHitInfoIteratorTermSegmented::Advance() {
+  ++num_advance_calls_;
+  if (cached_hits_idx_ == -1) {
+    libtextclassifier3::Status status = RetrieveHits();
+    if (!status.ok()) {
+      ICING_LOG(ERROR) << "Failed to retrieve hits " << status.error_message();
+      return absl_ports::ResourceExhaustedError(
+          "No more DocHitInfos in iterator");
+    }
+    cached_hits_idx_ = 0;
+  } else {
+    ++cached_hits_idx_;
+  }
+  if (cached_hits_idx_ >= static_cast<int>(cached_hits_.size())) {
+    // Nothing more for the iterator to return. Set these members to invalid
+    // values.
+    doc_hit_info_ = DocHitInfo();
+    hit_intersect_section_ids_mask_ = kSectionIdMaskNone;
+    return absl_ports::ResourceExhaustedError(
+        "No more DocHitInfos in iterator");
+  }
+  doc_hit_info_ = cached_hits_[cached_hits_idx_];
+  hit_intersect_section_ids_mask_ = doc_hit_info_.hit_section_ids_mask();
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status DocHitInfoIteratorTermSegmented::SkipTo(
+    DocumentId document_id) {
+  if (cached_hits_idx_ == -1) {
+    // All hits are retrieved on the first Advance.
+    ICING_RETURN_IF_ERROR(Advance());
+    if (doc_hit_info_.document_id() <= document_id) {
+      return libtextclassifier3::Status::OK;
+    }
+  }
+  // Stop right before the hit so that Advance returns it.
+  int next_idx = GallopTo(cached_hits_, cached_hits_idx_ + 1,
+                          cached_hits_.size(), document_id);
+  cached_hits_idx_ = next_idx - 1;
+  return Advance();
+}
+
+void DocHitInfoIteratorTermSegmented::PopulateMatchedTermsStats(
+    std::vector<TermMatchInfo>* matched_terms_stats,
+    SectionIdMask filtering_section_mask) const {
+  if (doc_hit_info_.document_id() == kInvalidDocumentId) {
+    // Current hit isn't valid, return.
+    return;
+  }
+  SectionIdMask section_mask =
+      doc_hit_info_.hit_section_ids_mask() & filtering_section_mask;
+  SectionIdMask section_mask_copy = section_mask;
+  std::array<Hit::TermFrequency, kMaxSectionId> section_term_frequencies = {
+      Hit::kNoTermFrequency};
+  while (section_mask_copy) {
+    SectionId section_id = __builtin_ctz(section_mask_copy);
+    section_term_frequencies.at(section_id) =
+        doc_hit_info_.hit_term_frequency(section_id);
+    section_mask_copy &= ~(1u << section_id);
+  }
+  TermMatchInfo term_stats(term_, section_mask,
+                           std::move(section_term_frequencies));
+
+  for (const TermMatchInfo& cur_term_stats : *matched_terms_stats) {
+    if (cur_term_stats.term == term_stats.term) {
+      // Same docId and same term, we don't need to add the term and the term
+      // frequency should always be the same
+      return;
+    }
+  }
+  matched_terms_stats->push_back(std::move(term_stats));
+}
+
+libtextclassifier3::Status
+DocHitInfoIteratorTermSegmentedExact::RetrieveHits() {
+  // Segments hold disjoint, increasing ranges of documents, so the hits are
+  // already in order.
+  return segmented_main_index_->AppendHits(term_, /*is_prefix=*/false,
+                                           section_restrict_mask_,
+                                           &cached_hits_);
+}
+
+std::string DocHitInfoIteratorTermSegmentedExact::ToString() const {
+  return absl_ports::StrCat(SectionIdMaskToString(section_restrict_mask_), ":",
+                            term_);
+}
+
+libtextclassifier3::Status
+DocHitInfoIteratorTermSegmentedPrefix::RetrieveHits() {
+  ICING_RETURN_IF_ERROR(segmented_main_index_->AppendHits(
+      term_, /*is_prefix=*/true, section_restrict_mask_, &cached_hits_));
+  // A document has a DocHitInfo for each matching term in its segment. Sort
+  // and merge them.
+  std::sort(cached_hits_.begin(), cached_hits_.end());
+  size_t idx = 0;
+  for (size_t i = 1; i < cached_hits_.size(); ++i) {
+    if (cached_hits_[idx].document_id() == cached_hits_[i].document_id()) {
+      cached_hits_[idx].MergeSectionsFrom(cached_hits_[i]);
+    } else {
+      cached_hits_[++idx] = cached_hits_[i];
+    }
+  }
+  if (!cached_hits_.empty()) {
+    cached_hits_.resize(idx + 1);
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+std::string DocHitInfoIteratorTermSegmentedPrefix::ToString() const {
+  return absl_ports::StrCat(SectionIdMaskToString(section_restrict_mask_), ":",
+                            term_, "*");
+}
+
+}  // namespace lib
+}  // namespace icing
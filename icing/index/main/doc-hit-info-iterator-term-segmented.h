@@ -0,0 +1,92 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_INDEX_ITERATOR_DOC_HIT_INFO_ITERATOR_TERM_SEGMENTED_H_
+#define ICING_INDEX_ITERATOR_DOC_HIT_INFO_ITERATOR_TERM_SEGMENTED_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/index/hit/doc-hit-info.h"
+#include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/index/main/segmented-main-index.h"
+#include "icing/schema/section.h"
+#include "icing/store/document-id.h"
+
+namespace icing {
+namespace lib {
+
+// Iterates over the hits of a term in all segments of a SegmentedMainIndex.
+class DocHitInfoIteratorTermSegmented : public DocHitInfoIterator {
+ public:
+  explicit DocHitInfoIteratorTermSegmented(
+      const SegmentedMainIndex* segmented_main_index, const std::string& term,
+      SectionIdMask section_restrict_mask)
+      : term_(term),
+        segmented_main_index_(segmented_main_index),
+        section_restrict_mask_(section_restrict_mask) {}
+
+  libtextclassifier3::Status Advance() override;
+
+  libtextclassifier3::Status SkipTo(DocumentId document_id) override;
+
+  int32_t GetNumBlocksInspected() const override { return 0; }
+  int32_t GetNumLeafAdvanceCalls() const override { return num_advance_calls_; }
+
+  void PopulateMatchedTermsStats(
+      std::vector<TermMatchInfo>* matched_terms_stats,
+      SectionIdMask filtering_section_mask = kSectionIdMaskAll) const override;
+
+ protected:
+  // Adds DocHitInfos corresponding to term_ to cached_hits_.
+  virtual libtextclassifier3::Status RetrieveHits() = 0;
+
+  const std::string term_;
+  const SegmentedMainIndex* const segmented_main_index_;
+  // All hits of term_. The current one is at cached_hits_idx_.
+  std::vector<DocHitInfo> cached_hits_;
+  int cached_hits_idx_ = -1;
+  int num_advance_calls_ = 0;
+  // Mask indicating which sections hits should be considered for.
+  const SectionIdMask section_restrict_mask_;
+};
+
+class DocHitInfoIteratorTermSegmentedExact
+    : public DocHitInfoIteratorTermSegmented {
+ public:
+  using DocHitInfoIteratorTermSegmented::DocHitInfoIteratorTermSegmented;
+
+  std::string ToString() const override;
+
+ protected:
+  libtextclassifier3::Status RetrieveHits() override;
+};
+
+class DocHitInfoIteratorTermSegmentedPrefix
+    : public DocHitInfoIteratorTermSegmented {
+ public:
+  using DocHitInfoIteratorTermSegmented::DocHitInfoIteratorTermSegmented;
+
+  std::string ToString() const override;
+
+ protected:
+  libtextclassifier3::Status RetrieveHits() override;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_INDEX_ITERATOR_DOC_HIT_INFO_ITERATOR_TERM_SEGMENTED_H_
@@ -32,8 +32,10 @@ class HeaderBlock {
  public:
   // The class used to access the actual header.
   struct Header {
-    // A magic used to mark the beginning of a valid header.
-    static constexpr int kMagic = 0x6dfba6ae;
+    // A magic used to mark the beginning of a valid header. Bumped whenever
+    // the Hit encoding changes so that main indices written with an older
+    // encoding are discarded and rebuilt.
+    static constexpr int kMagic = 0x6dfba6af;
     int magic;
     int block_size;
     int last_indexed_docid;
@@ -265,6 +265,7 @@ FlashIndexStorage::GetPostingList(PostingListIdentifier id) const {
   ICING_ASSIGN_OR_RETURN(
       PostingListUsed posting_list,
       block.GetAllocatedPostingList(id.posting_list_index()));
+  TouchBlock(id.block_index());
   PostingListHolder holder = {std::move(posting_list), std::move(block), id};
   return holder;
 }
@@ -399,17 +400,21 @@ FlashIndexStorage::AllocatePostingList(uint32_t min_posting_list_bytes) {
   int best_block_info_index = FindBestIndexBlockInfo(min_posting_list_bytes);
 
   auto holder_or = GetPostingListFromInMemoryFreeList(best_block_info_index);
-  if (holder_or.ok()) {
-    return std::move(holder_or).ValueOrDie();
+  if (!holder_or.ok()) {
+    // Nothing in memory. Look for something in the block file.
+    holder_or = GetPostingListFromOnDiskFreeList(best_block_info_index);
   }
-
-  // Nothing in memory. Look for something in the block file.
-  holder_or = GetPostingListFromOnDiskFreeList(best_block_info_index);
-  if (holder_or.ok()) {
-    return std::move(holder_or).ValueOrDie();
+  if (!holder_or.ok()) {
+    holder_or = AllocateNewPostingList(best_block_info_index);
   }
-
-  return AllocateNewPostingList(best_block_info_index);
+  if (counting_ && holder_or.ok()) {
+    const PostingListHolder& holder = holder_or.ValueOrDie();
+    ++counters_.num_posting_lists_allocated;
+    counters_.posting_list_bytes_allocated +=
+        holder.block.get_posting_list_bytes();
+    TouchBlock(holder.id.block_index());
+  }
+  return holder_or;
 }
 
 void FlashIndexStorage::AddToOnDiskFreeList(uint32_t block_index,
@@ -434,6 +439,10 @@ void FlashIndexStorage::RemoveFromOnDiskFreeList(uint32_t block_index,
 }
 
 void FlashIndexStorage::FreePostingList(PostingListHolder holder) {
+  if (counting_) {
+    ++counters_.num_posting_lists_freed;
+    TouchBlock(holder.id.block_index());
+  }
   uint32_t posting_list_bytes = holder.block.get_posting_list_bytes();
   int best_block_info_index = FindBestIndexBlockInfo(posting_list_bytes);
 
@@ -454,6 +463,25 @@ void FlashIndexStorage::FreePostingList(PostingListHolder holder) {
   }
 }
 
+void FlashIndexStorage::StartCounting() {
+  counting_ = true;
+  counters_ = Counters();
+  touched_blocks_.assign(num_blocks_, false);
+}
+
+void FlashIndexStorage::TouchBlock(uint32_t block_index) const {
+  if (!counting_) {
+    return;
+  }
+  if (block_index >= touched_blocks_.size()) {
+    touched_blocks_.resize(block_index + 1, false);
+  }
+  if (!touched_blocks_[block_index]) {
+    touched_blocks_[block_index] = true;
+    ++counters_.num_blocks_touched;
+  }
+}
+
 int FlashIndexStorage::GrowIndex() {
   if (num_blocks_ >= kMaxBlockIndex) {
     ICING_VLOG(1) << IcingStringUtil::StringPrintf("Reached max block index %u",
@@ -503,6 +531,15 @@ void FlashIndexStorage::FlushInMemoryFreeList() {
   }
 }
 
+int64_t FlashIndexStorage::ReleaseInMemoryFreeLists() {
+  FlushInMemoryFreeList();
+  int64_t released_bytes = 0;
+  for (FreeList& freelist : in_memory_freelists_) {
+    released_bytes += freelist.ReleaseMemory();
+  }
+  return released_bytes;
+}
+
 void FlashIndexStorage::GetDebugInfo(int verbosity, std::string* out) const {
   // Dump and check integrity of the index block free lists.
   out->append("Free lists:\n");
@@ -577,6 +614,13 @@ FlashIndexStorage::FreeList::TryPop() {
   return id;
 }
 
+int64_t FlashIndexStorage::FreeList::ReleaseMemory() {
+  int64_t released_bytes =
+      free_list_.capacity() * sizeof(PostingListIdentifier);
+  std::vector<PostingListIdentifier>().swap(free_list_);
+  return released_bytes;
+}
+
 std::string FlashIndexStorage::FreeList::DebugString() const {
   return IcingStringUtil::StringPrintf(
       "size %zu max %d dropped %d", free_list_.size(),
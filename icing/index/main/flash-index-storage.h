@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/absl_ports/canonical_errors.h"
@@ -159,8 +160,50 @@ class FlashIndexStorage {
 
   libtextclassifier3::Status Reset();
 
+  // Moves the posting lists on the in-memory free lists to the on-disk free
+  // lists and frees the memory the in-memory free lists held on to. Returns
+  // the number of bytes released.
+  int64_t ReleaseInMemoryFreeLists();
+
   void GetDebugInfo(int verbosity, std::string* out) const;
 
+  // Work done on the index file while counting.
+  struct Counters {
+    int num_posting_lists_allocated = 0;
+    int num_posting_lists_freed = 0;
+    // Posting lists whose hits outgrew them and were moved to a larger one.
+    int num_posting_lists_moved = 0;
+    // Number of distinct blocks that posting lists were read from, allocated
+    // in or freed in.
+    int num_blocks_touched = 0;
+    int64_t posting_list_bytes_allocated = 0;
+    // Hit bytes written to posting lists, whether in place or by moving an
+    // in-memory posting list into an allocated one.
+    int64_t bytes_written = 0;
+  };
+
+  // Starts counting the work done on the index file from zero, until
+  // StopCounting is called. Used to attribute the work to index merges.
+  void StartCounting();
+  void StopCounting() { counting_ = false; }
+  const Counters& counters() const { return counters_; }
+
+  // Records that a posting list was freed because its hits were moved to a
+  // larger one. Only called by PostingListAccessor.
+  void CountPostingListMove() {
+    if (counting_) {
+      ++counters_.num_posting_lists_moved;
+    }
+  }
+
+  // Records that num_bytes of hits were written to posting lists. Only called
+  // by PostingListAccessor.
+  void CountBytesWritten(int64_t num_bytes) {
+    if (counting_) {
+      counters_.bytes_written += num_bytes;
+    }
+  }
+
  private:
   FlashIndexStorage(const std::string& index_filename,
                     const Filesystem* filesystem, bool has_in_memory_freelists);
@@ -244,6 +287,9 @@ class FlashIndexStorage {
   // Flushes the in-memory free list to disk.
   void FlushInMemoryFreeList();
 
+  // Adds block_index to the touched blocks if counting.
+  void TouchBlock(uint32_t block_index) const;
+
   // Underlying filename.
   std::string index_filename_;
 
@@ -269,6 +315,10 @@ class FlashIndexStorage {
     //  - NOT_FOUND if there are no free posting lists on this free list.
     libtextclassifier3::StatusOr<PostingListIdentifier> TryPop();
 
+    // Frees the memory held by the list, which must be empty. Returns the
+    // number of bytes freed.
+    int64_t ReleaseMemory();
+
     std::string DebugString() const;
 
    private:
@@ -281,6 +331,11 @@ class FlashIndexStorage {
   const Filesystem* filesystem_;  // not owned; can't be null
 
   bool has_in_memory_freelists_;
+
+  bool counting_ = false;
+  // Mutable since reading posting lists touches blocks.
+  mutable Counters counters_;
+  mutable std::vector<bool> touched_blocks_;
 };
 
 }  // namespace lib
@@ -534,6 +534,54 @@ TEST_F(FlashIndexStorageTest, AllocateTooLargePostingList) {
               StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
 }
 
+TEST_F(FlashIndexStorageTest, CountersCountWorkWhileCounting) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      FlashIndexStorage flash_index_storage,
+      FlashIndexStorage::Create(file_name_, &filesystem_));
+  flash_index_storage.StartCounting();
+
+  // Two small posting lists share a block.
+  const int kSmallPostingListBytes = sizeof(Hit) * 2;
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PostingListHolder holder1,
+      flash_index_storage.AllocatePostingList(kSmallPostingListBytes));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PostingListHolder holder2,
+      flash_index_storage.AllocatePostingList(kSmallPostingListBytes));
+  PostingListIdentifier id2 = holder2.id;
+  EXPECT_THAT(id2.block_index(), Eq(holder1.id.block_index()));
+  int64_t small_posting_list_bytes = holder1.block.get_posting_list_bytes();
+  flash_index_storage.FreePostingList(std::move(holder1));
+  ICING_ASSERT_OK(flash_index_storage.GetPostingList(id2));
+
+  // A max-sized posting list gets a block of its own.
+  const int kMaxPostingListBytes = IndexBlock::CalculateMaxPostingListBytes(
+      flash_index_storage.block_size());
+  ICING_ASSERT_OK(
+      flash_index_storage.AllocatePostingList(kMaxPostingListBytes));
+
+  FlashIndexStorage::Counters counters = flash_index_storage.counters();
+  EXPECT_THAT(counters.num_posting_lists_allocated, Eq(3));
+  EXPECT_THAT(counters.num_posting_lists_freed, Eq(1));
+  EXPECT_THAT(counters.num_blocks_touched, Eq(2));
+  EXPECT_THAT(counters.posting_list_bytes_allocated,
+              Eq(2 * small_posting_list_bytes + kMaxPostingListBytes));
+
+  // Nothing is counted once counting stops.
+  flash_index_storage.StopCounting();
+  ICING_ASSERT_OK(
+      flash_index_storage.AllocatePostingList(kMaxPostingListBytes));
+  EXPECT_THAT(flash_index_storage.counters().num_posting_lists_allocated,
+              Eq(3));
+  EXPECT_THAT(flash_index_storage.counters().num_blocks_touched, Eq(2));
+
+  // Starting again counts from zero.
+  flash_index_storage.StartCounting();
+  EXPECT_THAT(flash_index_storage.counters().num_posting_lists_allocated,
+              Eq(0));
+  EXPECT_THAT(flash_index_storage.counters().num_blocks_touched, Eq(0));
+}
+
 }  // namespace
 
 }  // namespace lib
@@ -0,0 +1,545 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/front-coded-lexicon.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/filesystem.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/util/crc32.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+struct Header {
+  static constexpr int32_t kMagic = 0x66636c79;
+
+  int32_t magic;
+  int32_t value_size;
+  uint32_t num_terms;
+  uint32_t num_blocks;
+  uint32_t blocks_size;
+  uint32_t num_properties;
+  uint32_t checksum;
+};
+
+constexpr int kBitsPerWord = 64;
+
+void AppendVarint(uint32_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+uint32_t ReadVarint(const std::string& in, uint32_t* offset) {
+  uint32_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = static_cast<uint8_t>(in[(*offset)++]);
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+// Returns the smallest string that's greater than every string starting with
+// prefix, or an empty string if there's none.
+std::string PrefixSuccessor(std::string_view prefix) {
+  std::string successor(prefix);
+  while (!successor.empty()) {
+    unsigned char last = successor.back();
+    if (last != 0xff) {
+      successor.back() = static_cast<char>(last + 1);
+      return successor;
+    }
+    successor.pop_back();
+  }
+  return successor;
+}
+
+uint32_t ComputeChecksum(
+    const std::vector<uint32_t>& block_offsets, const std::string& blocks,
+    const std::vector<uint8_t>& values,
+    const std::vector<uint32_t>& property_bitmap_sizes,
+    const std::vector<std::vector<uint64_t>>& property_bitmaps) {
+  Crc32 crc;
+  crc.Append(std::string_view(
+      reinterpret_cast<const char*>(block_offsets.data()),
+      block_offsets.size() * sizeof(uint32_t)));
+  crc.Append(blocks);
+  crc.Append(std::string_view(reinterpret_cast<const char*>(values.data()),
+                              values.size()));
+  crc.Append(std::string_view(
+      reinterpret_cast<const char*>(property_bitmap_sizes.data()),
+      property_bitmap_sizes.size() * sizeof(uint32_t)));
+  for (const std::vector<uint64_t>& bitmap : property_bitmaps) {
+    crc.Append(std::string_view(reinterpret_cast<const char*>(bitmap.data()),
+                                bitmap.size() * sizeof(uint64_t)));
+  }
+  return crc.Get();
+}
+
+}  // namespace
+
+FrontCodedLexicon::Builder::Builder(int value_size)
+    : lexicon_(new FrontCodedLexicon(value_size)) {}
+
+libtextclassifier3::Status FrontCodedLexicon::Builder::Add(
+    std::string_view term, const void* value) {
+  uint32_t num_terms = lexicon_->num_terms_;
+  if (num_terms > 0 && term <= last_term_) {
+    return absl_ports::InvalidArgumentError(absl_ports::StrCat(
+        "Term '", term, "' doesn't sort after '", last_term_, "'"));
+  }
+
+  if (num_terms % kBlockSize == 0) {
+    lexicon_->block_offsets_.push_back(lexicon_->blocks_.size());
+    AppendVarint(term.size(), &lexicon_->blocks_);
+    lexicon_->blocks_.append(term);
+  } else {
+    size_t shared = 0;
+    size_t max_shared = std::min(term.size(), last_term_.size());
+    while (shared < max_shared && term[shared] == last_term_[shared]) {
+      ++shared;
+    }
+    AppendVarint(shared, &lexicon_->blocks_);
+    AppendVarint(term.size() - shared, &lexicon_->blocks_);
+    lexicon_->blocks_.append(term.substr(shared));
+  }
+  last_term_ = std::string(term);
+
+  const uint8_t* value_bytes = static_cast<const uint8_t*>(value);
+  lexicon_->values_.insert(lexicon_->values_.end(), value_bytes,
+                           value_bytes + lexicon_->value_size_);
+  ++lexicon_->num_terms_;
+  return libtextclassifier3::Status::OK;
+}
+
+void FrontCodedLexicon::Builder::SetProperty(uint32_t property_id) {
+  lexicon_->SetProperty(lexicon_->num_terms_ - 1, property_id);
+}
+
+std::unique_ptr<FrontCodedLexicon> FrontCodedLexicon::Builder::Build() {
+  lexicon_->blocks_.shrink_to_fit();
+  lexicon_->block_offsets_.shrink_to_fit();
+  lexicon_->values_.shrink_to_fit();
+  for (std::vector<uint64_t>& bitmap : lexicon_->property_bitmaps_) {
+    bitmap.shrink_to_fit();
+  }
+  return std::move(lexicon_);
+}
+
+FrontCodedLexicon::Iterator::Iterator(const FrontCodedLexicon* lexicon,
+                                      uint32_t term_index,
+                                      uint32_t end_term_index)
+    : lexicon_(lexicon),
+      term_index_(term_index),
+      end_term_index_(end_term_index) {
+  if (!IsValid()) {
+    return;
+  }
+  // Decode the terms of the block up to term_index.
+  uint32_t block = term_index / kBlockSize;
+  next_term_offset_ = lexicon_->DecodeTerm(lexicon_->block_offsets_[block],
+                                           /*first_in_block=*/true, &term_);
+  for (uint32_t i = block * kBlockSize; i < term_index; ++i) {
+    next_term_offset_ = lexicon_->DecodeTerm(
+        next_term_offset_, /*first_in_block=*/false, &term_);
+  }
+}
+
+bool FrontCodedLexicon::Iterator::Advance() {
+  if (!IsValid()) {
+    return false;
+  }
+  ++term_index_;
+  if (!IsValid()) {
+    return false;
+  }
+  if (term_index_ % kBlockSize == 0) {
+    next_term_offset_ = lexicon_->DecodeTerm(
+        lexicon_->block_offsets_[term_index_ / kBlockSize],
+        /*first_in_block=*/true, &term_);
+  } else {
+    next_term_offset_ = lexicon_->DecodeTerm(
+        next_term_offset_, /*first_in_block=*/false, &term_);
+  }
+  return true;
+}
+
+std::unique_ptr<FrontCodedLexicon> FrontCodedLexicon::Merge(
+    const FrontCodedLexicon& lexicon, const IcingDynamicTrie& other,
+    const MergeValueFn& merge_value) {
+  Builder builder(lexicon.value_size_);
+  std::vector<uint8_t> merged_value(lexicon.value_size_);
+  // The index of each term of lexicon in the merged lexicon.
+  std::vector<uint32_t> merged_term_indices;
+  merged_term_indices.reserve(lexicon.size());
+  uint32_t merged_term_index = 0;
+  Iterator itr = lexicon.GetIterator(/*prefix=*/"");
+  IcingDynamicTrie::Iterator other_itr(other, /*prefix=*/"");
+  while (itr.IsValid() || other_itr.IsValid()) {
+    std::string_view term;
+    const void* existing_value = nullptr;
+    int64_t other_value_index = -1;
+    int comparison;
+    if (!itr.IsValid()) {
+      comparison = 1;
+    } else if (!other_itr.IsValid()) {
+      comparison = -1;
+    } else {
+      comparison = itr.GetTerm().compare(other_itr.GetKey());
+    }
+    if (comparison <= 0) {
+      term = itr.GetTerm();
+      existing_value = itr.GetValue();
+      merged_term_indices.push_back(merged_term_index);
+    } else {
+      term = other_itr.GetKey();
+    }
+    if (comparison >= 0) {
+      other_value_index = other_itr.GetValueIndex();
+    }
+
+    std::fill(merged_value.begin(), merged_value.end(), 0);
+    merge_value(term, existing_value, other_value_index, merged_value.data());
+    // Both inputs are sorted, so this can't fail.
+    builder.Add(term, merged_value.data());
+    ++merged_term_index;
+
+    if (comparison <= 0) {
+      itr.Advance();
+    }
+    if (comparison >= 0) {
+      other_itr.Advance();
+    }
+  }
+  std::unique_ptr<FrontCodedLexicon> merged = builder.Build();
+  for (uint32_t property_id = 0; property_id < lexicon.num_properties();
+       ++property_id) {
+    lexicon.ForEachTermWithProperty(
+        property_id, [&merged, &merged_term_indices,
+                      property_id](uint32_t term_index) {
+          merged->SetProperty(merged_term_indices[term_index], property_id);
+        });
+  }
+  return merged;
+}
+
+libtextclassifier3::Status FrontCodedLexicon::Write(
+    const Filesystem& filesystem, const std::string& filename) const {
+  Header header;
+  header.magic = Header::kMagic;
+  header.value_size = value_size_;
+  header.num_terms = num_terms_;
+  header.num_blocks = block_offsets_.size();
+  header.blocks_size = blocks_.size();
+  header.num_properties = property_bitmaps_.size();
+  std::vector<uint32_t> property_bitmap_sizes;
+  property_bitmap_sizes.reserve(property_bitmaps_.size());
+  for (const std::vector<uint64_t>& bitmap : property_bitmaps_) {
+    property_bitmap_sizes.push_back(bitmap.size());
+  }
+  header.checksum = ComputeChecksum(block_offsets_, blocks_, values_,
+                                    property_bitmap_sizes, property_bitmaps_);
+
+  ScopedFd sfd(filesystem.OpenForWrite(filename.c_str()));
+  if (!sfd.is_valid() || !filesystem.Truncate(sfd.get(), 0) ||
+      !filesystem.Write(sfd.get(), &header, sizeof(header)) ||
+      !filesystem.Write(sfd.get(), block_offsets_.data(),
+                        block_offsets_.size() * sizeof(uint32_t)) ||
+      !filesystem.Write(sfd.get(), blocks_.data(), blocks_.size()) ||
+      !filesystem.Write(sfd.get(), values_.data(), values_.size()) ||
+      !filesystem.Write(sfd.get(), property_bitmap_sizes.data(),
+                        property_bitmap_sizes.size() * sizeof(uint32_t))) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to write lexicon: ", filename));
+  }
+  for (const std::vector<uint64_t>& bitmap : property_bitmaps_) {
+    if (!filesystem.Write(sfd.get(), bitmap.data(),
+                          bitmap.size() * sizeof(uint64_t))) {
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Failed to write lexicon: ", filename));
+    }
+  }
+  if (!filesystem.DataSync(sfd.get())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to sync lexicon: ", filename));
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<FrontCodedLexicon>>
+FrontCodedLexicon::Read(const Filesystem& filesystem,
+                        const std::string& filename) {
+  ScopedFd sfd(filesystem.OpenForRead(filename.c_str()));
+  if (!sfd.is_valid()) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to open lexicon: ", filename));
+  }
+  int64_t file_size = filesystem.GetFileSize(sfd.get());
+  if (file_size == Filesystem::kBadFileSize) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to get size of lexicon: ", filename));
+  }
+
+  Header header;
+  if (file_size < static_cast<int64_t>(sizeof(header))) {
+    return absl_ports::DataLossError("Lexicon file is too small");
+  }
+  if (!filesystem.Read(sfd.get(), &header, sizeof(header))) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to read lexicon: ", filename));
+  }
+  int64_t expected_num_blocks =
+      (static_cast<int64_t>(header.num_terms) + kBlockSize - 1) / kBlockSize;
+  int64_t properties_offset = static_cast<int64_t>(sizeof(header)) +
+                              header.num_blocks * sizeof(uint32_t) +
+                              header.blocks_size +
+                              static_cast<int64_t>(header.num_terms) *
+                                  header.value_size;
+  if (header.magic != Header::kMagic || header.value_size < 0 ||
+      header.num_blocks != expected_num_blocks ||
+      file_size < properties_offset +
+                      static_cast<int64_t>(header.num_properties) *
+                          sizeof(uint32_t)) {
+    return absl_ports::DataLossError("Lexicon header is corrupted");
+  }
+
+  std::unique_ptr<FrontCodedLexicon> lexicon(
+      new FrontCodedLexicon(header.value_size));
+  lexicon->num_terms_ = header.num_terms;
+  lexicon->block_offsets_.resize(header.num_blocks);
+  lexicon->blocks_.resize(header.blocks_size);
+  lexicon->values_.resize(static_cast<size_t>(header.num_terms) *
+                          header.value_size);
+  if (!filesystem.Read(sfd.get(), lexicon->block_offsets_.data(),
+                       lexicon->block_offsets_.size() * sizeof(uint32_t)) ||
+      !filesystem.Read(sfd.get(), lexicon->blocks_.data(),
+                       lexicon->blocks_.size()) ||
+      !filesystem.Read(sfd.get(), lexicon->values_.data(),
+                       lexicon->values_.size())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to read lexicon: ", filename));
+  }
+
+  std::vector<uint32_t> property_bitmap_sizes(header.num_properties);
+  if (!filesystem.Read(sfd.get(), property_bitmap_sizes.data(),
+                       property_bitmap_sizes.size() * sizeof(uint32_t))) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to read lexicon: ", filename));
+  }
+  int64_t max_bitmap_size =
+      (static_cast<int64_t>(header.num_terms) + kBitsPerWord - 1) /
+      kBitsPerWord;
+  int64_t expected_file_size =
+      properties_offset + property_bitmap_sizes.size() * sizeof(uint32_t);
+  for (uint32_t bitmap_size : property_bitmap_sizes) {
+    if (bitmap_size > max_bitmap_size) {
+      return absl_ports::DataLossError("Lexicon header is corrupted");
+    }
+    expected_file_size += bitmap_size * sizeof(uint64_t);
+  }
+  if (file_size != expected_file_size) {
+    return absl_ports::DataLossError("Lexicon header is corrupted");
+  }
+  lexicon->property_bitmaps_.resize(header.num_properties);
+  for (uint32_t i = 0; i < header.num_properties; ++i) {
+    std::vector<uint64_t>& bitmap = lexicon->property_bitmaps_[i];
+    bitmap.resize(property_bitmap_sizes[i]);
+    if (!filesystem.Read(sfd.get(), bitmap.data(),
+                         bitmap.size() * sizeof(uint64_t))) {
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Failed to read lexicon: ", filename));
+    }
+  }
+  if (ComputeChecksum(lexicon->block_offsets_, lexicon->blocks_,
+                      lexicon->values_, property_bitmap_sizes,
+                      lexicon->property_bitmaps_) != header.checksum) {
+    return absl_ports::DataLossError("Lexicon checksum doesn't match");
+  }
+  return lexicon;
+}
+
+bool FrontCodedLexicon::Find(std::string_view term,
+                             uint32_t* term_index) const {
+  bool found;
+  uint32_t index = LowerBound(term, &found);
+  if (!found) {
+    return false;
+  }
+  *term_index = index;
+  return true;
+}
+
+std::string FrontCodedLexicon::GetTerm(uint32_t term_index) const {
+  return Iterator(this, term_index, num_terms_).GetTerm();
+}
+
+void FrontCodedLexicon::SetValueAtIndex(uint32_t term_index,
+                                        const void* value) {
+  memcpy(&values_[static_cast<size_t>(term_index) * value_size_], value,
+         value_size_);
+}
+
+bool FrontCodedLexicon::HasProperty(uint32_t term_index,
+                                    uint32_t property_id) const {
+  if (property_id >= property_bitmaps_.size()) {
+    return false;
+  }
+  const std::vector<uint64_t>& bitmap = property_bitmaps_[property_id];
+  uint32_t word = term_index / kBitsPerWord;
+  return word < bitmap.size() &&
+         (bitmap[word] >> (term_index % kBitsPerWord)) & 1;
+}
+
+void FrontCodedLexicon::SetProperty(uint32_t term_index,
+                                    uint32_t property_id) {
+  if (property_id >= property_bitmaps_.size()) {
+    property_bitmaps_.resize(property_id + 1);
+  }
+  std::vector<uint64_t>& bitmap = property_bitmaps_[property_id];
+  uint32_t word = term_index / kBitsPerWord;
+  if (word >= bitmap.size()) {
+    bitmap.resize(word + 1);
+  }
+  bitmap[word] |= uint64_t{1} << (term_index % kBitsPerWord);
+}
+
+void FrontCodedLexicon::ClearProperty(uint32_t term_index,
+                                      uint32_t property_id) {
+  if (property_id >= property_bitmaps_.size()) {
+    return;
+  }
+  std::vector<uint64_t>& bitmap = property_bitmaps_[property_id];
+  uint32_t word = term_index / kBitsPerWord;
+  if (word < bitmap.size()) {
+    bitmap[word] &= ~(uint64_t{1} << (term_index % kBitsPerWord));
+  }
+}
+
+void FrontCodedLexicon::ForEachTermWithProperty(
+    uint32_t property_id, const std::function<void(uint32_t)>& fn) const {
+  if (property_id >= property_bitmaps_.size()) {
+    return;
+  }
+  const std::vector<uint64_t>& bitmap = property_bitmaps_[property_id];
+  for (uint32_t word = 0; word < bitmap.size(); ++word) {
+    for (uint64_t bits = bitmap[word]; bits != 0; bits &= bits - 1) {
+      fn(word * kBitsPerWord + __builtin_ctzll(bits));
+    }
+  }
+}
+
+std::pair<uint32_t, uint32_t> FrontCodedLexicon::GetPrefixRange(
+    std::string_view prefix) const {
+  std::string successor = PrefixSuccessor(prefix);
+  uint32_t end_term_index =
+      successor.empty() ? num_terms_ : LowerBound(successor, nullptr);
+  return {LowerBound(prefix, nullptr), end_term_index};
+}
+
+FrontCodedLexicon::Iterator FrontCodedLexicon::GetIterator(
+    std::string_view prefix) const {
+  auto [term_index, end_term_index] = GetPrefixRange(prefix);
+  return Iterator(this, term_index, end_term_index);
+}
+
+int64_t FrontCodedLexicon::GetMemoryUsage() const {
+  int64_t memory_usage = blocks_.capacity() +
+                         block_offsets_.capacity() * sizeof(uint32_t) +
+                         values_.capacity();
+  for (const std::vector<uint64_t>& bitmap : property_bitmaps_) {
+    memory_usage += bitmap.capacity() * sizeof(uint64_t);
+  }
+  return memory_usage;
+}
+
+uint32_t FrontCodedLexicon::LowerBound(std::string_view term,
+                                       bool* found) const {
+  if (found != nullptr) {
+    *found = false;
+  }
+  if (block_offsets_.empty()) {
+    return 0;
+  }
+  // Find the last block whose first term isn't greater than term.
+  auto first_term = [this](uint32_t block) {
+    uint32_t offset = block_offsets_[block];
+    uint32_t length = ReadVarint(blocks_, &offset);
+    return std::string_view(blocks_.data() + offset, length);
+  };
+  uint32_t low = 0;
+  uint32_t high = block_offsets_.size();
+  while (high - low > 1) {
+    uint32_t mid = low + (high - low) / 2;
+    if (first_term(mid) <= term) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  if (term < first_term(low)) {
+    // Only possible for the first block.
+    return 0;
+  }
+
+  // Scan the block for the first term that isn't less than term.
+  std::string current_term;
+  uint32_t index = low * kBlockSize;
+  uint32_t end_index = std::min(index + kBlockSize, num_terms_);
+  uint32_t offset =
+      DecodeTerm(block_offsets_[low], /*first_in_block=*/true, &current_term);
+  while (current_term < term) {
+    if (++index >= end_index) {
+      break;
+    }
+    offset = DecodeTerm(offset, /*first_in_block=*/false, &current_term);
+  }
+  if (found != nullptr && index < end_index) {
+    *found = current_term == term;
+  }
+  return index;
+}
+
+uint32_t FrontCodedLexicon::DecodeTerm(uint32_t offset, bool first_in_block,
+                                       std::string* term) const {
+  uint32_t shared = 0;
+  if (!first_in_block) {
+    shared = ReadVarint(blocks_, &offset);
+  }
+  uint32_t suffix_length = ReadVarint(blocks_, &offset);
+  term->resize(shared);
+  term->append(blocks_, offset, suffix_length);
+  return offset + suffix_length;
+}
+
+}  // namespace lib
+}  // namespace icing
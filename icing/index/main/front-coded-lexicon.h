@@ -0,0 +1,220 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_INDEX_MAIN_FRONT_CODED_LEXICON_H_
+#define ICING_INDEX_MAIN_FRONT_CODED_LEXICON_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/file/filesystem.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+
+namespace icing {
+namespace lib {
+
+// An immutable lexicon that maps terms to fixed-size values, as an
+// alternative to IcingDynamicTrie for lexicons that only change in bulk, like
+// the main index's.
+//
+// Terms are stored sorted, in blocks of kBlockSize terms. The first term of a
+// block is stored whole and every other term as the length of the prefix it
+// shares with the term before it followed by the rest of it. A top-level
+// index holds the offset of each block, so a lookup is a binary search over
+// the blocks' first terms followed by a scan of at most one block.
+//
+// Terms are identified by their index in sorted order. Their values, e.g.
+// posting list ids, and their properties are stored apart from the terms and
+// can be changed in place. Like IcingDynamicTrie's, properties are flags that
+// are kept in a bitmap per property id. The terms themselves can only be
+// changed by building a new lexicon, e.g. with Merge.
+//
+// This class is not thread-safe.
+class FrontCodedLexicon {
+ public:
+  static constexpr int kBlockSize = 16;
+
+  // Builds a lexicon out of terms added in sorted order.
+  class Builder {
+   public:
+    explicit Builder(int value_size);
+
+    // Adds a term along with value_size bytes of its value.
+    //
+    // Returns:
+    //   OK on success
+    //   INVALID_ARGUMENT if term doesn't sort after the previous term
+    libtextclassifier3::Status Add(std::string_view term, const void* value);
+
+    // Sets a property of the term added last.
+    //
+    // REQUIRES: a term was added
+    void SetProperty(uint32_t property_id);
+
+    // Returns the lexicon of all terms added so far. The builder must not be
+    // used afterwards.
+    std::unique_ptr<FrontCodedLexicon> Build();
+
+   private:
+    std::unique_ptr<FrontCodedLexicon> lexicon_;
+    std::string last_term_;
+  };
+
+  // Iterates over the terms with a given prefix, in sorted order.
+  class Iterator {
+   public:
+    bool IsValid() const { return term_index_ < end_term_index_; }
+
+    // Moves to the next term. Returns whether there is one.
+    bool Advance();
+
+    // REQUIRES: IsValid()
+    const std::string& GetTerm() const { return term_; }
+    uint32_t GetTermIndex() const { return term_index_; }
+    const void* GetValue() const {
+      return lexicon_->GetValueAtIndex(term_index_);
+    }
+
+   private:
+    friend class FrontCodedLexicon;
+
+    Iterator(const FrontCodedLexicon* lexicon, uint32_t term_index,
+             uint32_t end_term_index);
+
+    const FrontCodedLexicon* lexicon_;
+    uint32_t term_index_;
+    uint32_t end_term_index_;
+    std::string term_;
+    // The offset in blocks_ of the term after term_.
+    uint32_t next_term_offset_ = 0;
+  };
+
+  // Decides the value of a merged term. existing_value is the value that the
+  // term had in the lexicon, or nullptr if it's new. other_value_index is the
+  // term's value index in the other lexicon, or -1 if it isn't there.
+  using MergeValueFn =
+      std::function<void(std::string_view term, const void* existing_value,
+                         int64_t other_value_index, void* merged_value)>;
+
+  // Builds the lexicon holding the terms of both lexicon and other, with
+  // values chosen by merge_value. Terms keep the properties they had in
+  // lexicon. Terms are streamed out of both in sorted
+  // order, so no more than one term of each is held in memory at a time
+  // besides the new lexicon.
+  static std::unique_ptr<FrontCodedLexicon> Merge(
+      const FrontCodedLexicon& lexicon, const IcingDynamicTrie& other,
+      const MergeValueFn& merge_value);
+
+  // Writes the lexicon to filename, replacing any previous contents.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Write(const Filesystem& filesystem,
+                                   const std::string& filename) const;
+
+  // Reads a lexicon written by Write.
+  //
+  // Returns:
+  //   The lexicon on success
+  //   DATA_LOSS if the file is corrupted
+  //   INTERNAL on I/O error
+  static libtextclassifier3::StatusOr<std::unique_ptr<FrontCodedLexicon>> Read(
+      const Filesystem& filesystem, const std::string& filename);
+
+  // Number of terms in the lexicon.
+  uint32_t size() const { return num_terms_; }
+
+  int value_size() const { return value_size_; }
+
+  // Finds term. Returns whether it's in the lexicon and, if so, sets
+  // term_index to its index.
+  bool Find(std::string_view term, uint32_t* term_index) const;
+
+  // Returns the term at term_index.
+  //
+  // REQUIRES: term_index < size()
+  std::string GetTerm(uint32_t term_index) const;
+
+  // REQUIRES: term_index < size()
+  const void* GetValueAtIndex(uint32_t term_index) const {
+    return &values_[static_cast<size_t>(term_index) * value_size_];
+  }
+  void SetValueAtIndex(uint32_t term_index, const void* value);
+
+  // REQUIRES: term_index < size()
+  bool HasProperty(uint32_t term_index, uint32_t property_id) const;
+  void SetProperty(uint32_t term_index, uint32_t property_id);
+  void ClearProperty(uint32_t term_index, uint32_t property_id);
+
+  // One more than the largest property id that was set on any term.
+  uint32_t num_properties() const { return property_bitmaps_.size(); }
+
+  // Calls fn with the index of every term that has the property, in order.
+  void ForEachTermWithProperty(
+      uint32_t property_id, const std::function<void(uint32_t)>& fn) const;
+
+  // Returns the range [begin, end) of the indices of the terms starting with
+  // prefix.
+  std::pair<uint32_t, uint32_t> GetPrefixRange(std::string_view prefix) const;
+
+  // Returns an iterator over the terms starting with prefix. An empty prefix
+  // iterates over all terms.
+  Iterator GetIterator(std::string_view prefix) const;
+
+  // Returns the number of bytes that the terms, values and properties take up
+  // in memory.
+  int64_t GetMemoryUsage() const;
+
+ private:
+  explicit FrontCodedLexicon(int value_size) : value_size_(value_size) {}
+
+  // Returns the index of the first term that isn't less than term. If found
+  // isn't null, it's set to whether that term is equal to term.
+  uint32_t LowerBound(std::string_view term, bool* found) const;
+
+  // Decodes the term at offset into term, which must hold the term before it
+  // unless it's the first term of its block. Returns the offset of the next
+  // term.
+  uint32_t DecodeTerm(uint32_t offset, bool first_in_block,
+                      std::string* term) const;
+
+  int value_size_;
+  uint32_t num_terms_ = 0;
+
+  // The front-coded blocks of terms.
+  std::string blocks_;
+
+  // The offset in blocks_ of each block.
+  std::vector<uint32_t> block_offsets_;
+
+  // The values of the terms, value_size_ bytes each, by term index.
+  std::vector<uint8_t> values_;
+
+  // A bitmap of the terms that have the property, by property id. Bitmaps
+  // only extend up to the last term that has the property.
+  std::vector<std::vector<uint64_t>> property_bitmaps_;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_INDEX_MAIN_FRONT_CODED_LEXICON_H_
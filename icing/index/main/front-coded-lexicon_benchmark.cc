@@ -0,0 +1,191 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "testing/base/public/benchmark.h"
+#include "icing/index/main/front-coded-lexicon.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/legacy/index/icing-filesystem.h"
+#include "icing/testing/tmp-directory.h"
+
+// This is a benchmark comparing FrontCodedLexicon with IcingDynamicTrie, the
+// main index's lexicon, for memory usage, exact lookups and prefix iteration.
+// The memory usage of each is reported in the "bytes" counter.
+//
+// Run on a Linux workstation:
+//    $ blaze build -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/index/main:front-coded-lexicon_benchmark
+//
+//    $ blaze-bin/icing/index/main/front-coded-lexicon_benchmark
+//    --benchmarks=all
+//
+// Run on an Android device:
+//    $ blaze build --copt="-DGOOGLE_COMMANDLINEFLAGS_FULL_API=1"
+//    --config=android_arm64 -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/index/main:front-coded-lexicon_benchmark
+//
+//    $ adb push blaze-bin/icing/index/main/front-coded-lexicon_benchmark
+//    /data/local/tmp/
+//
+//    $ adb shell /data/local/tmp/front-coded-lexicon_benchmark
+//    --benchmarks=all
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+constexpr int kNumLookups = 1000;
+
+// Returns num_terms distinct sorted terms made of lowercase letters, with
+// lengths between 3 and 12.
+std::vector<std::string> CreateTerms(int num_terms) {
+  std::mt19937 random(/*seed=*/12345);
+  std::uniform_int_distribution<int> length_distribution(3, 12);
+  std::uniform_int_distribution<int> letter_distribution('a', 'z');
+  std::vector<std::string> terms;
+  terms.reserve(num_terms);
+  while (static_cast<int>(terms.size()) < num_terms) {
+    std::string term(length_distribution(random), ' ');
+    for (char& c : term) {
+      c = letter_distribution(random);
+    }
+    terms.push_back(std::move(term));
+    if (static_cast<int>(terms.size()) == num_terms) {
+      std::sort(terms.begin(), terms.end());
+      terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    }
+  }
+  return terms;
+}
+
+std::unique_ptr<FrontCodedLexicon> CreateLexicon(
+    const std::vector<std::string>& terms) {
+  FrontCodedLexicon::Builder builder(sizeof(uint32_t));
+  for (uint32_t i = 0; i < terms.size(); ++i) {
+    builder.Add(terms[i], &i);
+  }
+  return builder.Build();
+}
+
+std::unique_ptr<IcingDynamicTrie> CreateTrie(
+    const std::vector<std::string>& terms, const IcingFilesystem* filesystem) {
+  std::string trie_dir = GetTestTempDir() + "/front_coded_lexicon_benchmark";
+  filesystem->DeleteDirectoryRecursively(trie_dir.c_str());
+  filesystem->CreateDirectoryRecursively(trie_dir.c_str());
+  auto trie = std::make_unique<IcingDynamicTrie>(
+      trie_dir + "/trie_", IcingDynamicTrie::RuntimeOptions(), filesystem);
+  trie->CreateIfNotExist(IcingDynamicTrie::Options());
+  trie->Init();
+  for (uint32_t i = 0; i < terms.size(); ++i) {
+    trie->Insert(terms[i].c_str(), &i);
+  }
+  return trie;
+}
+
+// Returns kNumLookups of terms, chosen at random.
+std::vector<std::string> SampleTerms(const std::vector<std::string>& terms) {
+  std::mt19937 random(/*seed=*/54321);
+  std::uniform_int_distribution<int> index_distribution(0, terms.size() - 1);
+  std::vector<std::string> samples;
+  for (int i = 0; i < kNumLookups; ++i) {
+    samples.push_back(terms[index_distribution(random)]);
+  }
+  return samples;
+}
+
+void BM_LexiconFind(benchmark::State& state) {
+  std::vector<std::string> terms = CreateTerms(state.range(0));
+  std::unique_ptr<FrontCodedLexicon> lexicon = CreateLexicon(terms);
+  std::vector<std::string> samples = SampleTerms(terms);
+  for (auto _ : state) {
+    for (const std::string& term : samples) {
+      uint32_t term_index;
+      benchmark::DoNotOptimize(lexicon->Find(term, &term_index));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+  state.counters["bytes"] = lexicon->GetMemoryUsage();
+}
+BENCHMARK(BM_LexiconFind)->Arg(10000)->Arg(100000)->Arg(500000);
+
+void BM_TrieFind(benchmark::State& state) {
+  IcingFilesystem filesystem;
+  std::vector<std::string> terms = CreateTerms(state.range(0));
+  std::unique_ptr<IcingDynamicTrie> trie = CreateTrie(terms, &filesystem);
+  std::vector<std::string> samples = SampleTerms(terms);
+  for (auto _ : state) {
+    for (const std::string& term : samples) {
+      uint32_t value;
+      benchmark::DoNotOptimize(trie->Find(term.c_str(), &value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+  state.counters["bytes"] = trie->GetElementsSize();
+}
+BENCHMARK(BM_TrieFind)->Arg(10000)->Arg(100000)->Arg(500000);
+
+void BM_LexiconPrefixIteration(benchmark::State& state) {
+  std::vector<std::string> terms = CreateTerms(state.range(0));
+  std::unique_ptr<FrontCodedLexicon> lexicon = CreateLexicon(terms);
+  std::vector<std::string> samples = SampleTerms(terms);
+  for (std::string& sample : samples) {
+    sample.resize(2);
+  }
+  int64_t num_terms = 0;
+  for (auto _ : state) {
+    for (const std::string& prefix : samples) {
+      for (FrontCodedLexicon::Iterator itr = lexicon->GetIterator(prefix);
+           itr.IsValid(); itr.Advance()) {
+        benchmark::DoNotOptimize(itr.GetValue());
+        ++num_terms;
+      }
+    }
+  }
+  state.SetItemsProcessed(num_terms);
+}
+BENCHMARK(BM_LexiconPrefixIteration)->Arg(10000)->Arg(100000)->Arg(500000);
+
+void BM_TriePrefixIteration(benchmark::State& state) {
+  IcingFilesystem filesystem;
+  std::vector<std::string> terms = CreateTerms(state.range(0));
+  std::unique_ptr<IcingDynamicTrie> trie = CreateTrie(terms, &filesystem);
+  std::vector<std::string> samples = SampleTerms(terms);
+  for (std::string& sample : samples) {
+    sample.resize(2);
+  }
+  int64_t num_terms = 0;
+  for (auto _ : state) {
+    for (const std::string& prefix : samples) {
+      for (IcingDynamicTrie::Iterator itr(*trie, prefix.c_str());
+           itr.IsValid(); itr.Advance()) {
+        benchmark::DoNotOptimize(itr.GetValue());
+        ++num_terms;
+      }
+    }
+  }
+  state.SetItemsProcessed(num_terms);
+}
+BENCHMARK(BM_TriePrefixIteration)->Arg(10000)->Arg(100000)->Arg(500000);
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,316 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/front-coded-lexicon.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/filesystem.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/legacy/index/icing-filesystem.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+class FrontCodedLexiconTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = GetTestTempDir() + "/front_coded_lexicon";
+    filesystem_.CreateDirectoryRecursively(test_dir_.c_str());
+  }
+
+  void TearDown() override {
+    filesystem_.DeleteDirectoryRecursively(test_dir_.c_str());
+  }
+
+  // Builds a lexicon mapping each of terms, which must be sorted, to its
+  // index.
+  static std::unique_ptr<FrontCodedLexicon> BuildLexicon(
+      const std::vector<std::string>& terms) {
+    FrontCodedLexicon::Builder builder(sizeof(uint32_t));
+    for (uint32_t i = 0; i < terms.size(); ++i) {
+      EXPECT_THAT(builder.Add(terms[i], &i), IsOk());
+    }
+    return builder.Build();
+  }
+
+  static uint32_t GetValue(const void* value) {
+    uint32_t result;
+    memcpy(&result, value, sizeof(result));
+    return result;
+  }
+
+  static std::vector<std::string> GetTerms(FrontCodedLexicon::Iterator itr) {
+    std::vector<std::string> terms;
+    for (; itr.IsValid(); itr.Advance()) {
+      terms.push_back(itr.GetTerm());
+    }
+    return terms;
+  }
+
+  // Returns enough sorted terms to span several blocks.
+  static std::vector<std::string> CreateTerms() {
+    std::vector<std::string> terms;
+    char term[16];
+    for (int i = 0; i < 100; ++i) {
+      snprintf(term, sizeof(term), "term%03d", i);
+      terms.push_back(term);
+    }
+    return terms;
+  }
+
+  Filesystem filesystem_;
+  std::string test_dir_;
+};
+
+TEST_F(FrontCodedLexiconTest, Empty) {
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon({});
+  EXPECT_THAT(lexicon->size(), Eq(0));
+
+  uint32_t term_index;
+  EXPECT_THAT(lexicon->Find("foo", &term_index), IsFalse());
+  EXPECT_THAT(lexicon->GetIterator("").IsValid(), IsFalse());
+}
+
+TEST_F(FrontCodedLexiconTest, Find) {
+  std::vector<std::string> terms = CreateTerms();
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon(terms);
+  EXPECT_THAT(lexicon->size(), Eq(terms.size()));
+
+  for (uint32_t i = 0; i < terms.size(); ++i) {
+    uint32_t term_index;
+    ASSERT_THAT(lexicon->Find(terms[i], &term_index), IsTrue()) << terms[i];
+    EXPECT_THAT(term_index, Eq(i));
+    EXPECT_THAT(lexicon->GetTerm(i), Eq(terms[i]));
+    EXPECT_THAT(GetValue(lexicon->GetValueAtIndex(i)), Eq(i));
+  }
+
+  uint32_t term_index;
+  EXPECT_THAT(lexicon->Find("", &term_index), IsFalse());
+  EXPECT_THAT(lexicon->Find("a", &term_index), IsFalse());
+  EXPECT_THAT(lexicon->Find("term", &term_index), IsFalse());
+  EXPECT_THAT(lexicon->Find("term0505", &term_index), IsFalse());
+  EXPECT_THAT(lexicon->Find("zzz", &term_index), IsFalse());
+}
+
+TEST_F(FrontCodedLexiconTest, SetValueAtIndex) {
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon({"bar", "foo"});
+  uint32_t value = 42;
+  lexicon->SetValueAtIndex(1, &value);
+  EXPECT_THAT(GetValue(lexicon->GetValueAtIndex(0)), Eq(0));
+  EXPECT_THAT(GetValue(lexicon->GetValueAtIndex(1)), Eq(42));
+}
+
+TEST_F(FrontCodedLexiconTest, Properties) {
+  FrontCodedLexicon::Builder builder(sizeof(uint32_t));
+  uint32_t value = 0;
+  ICING_ASSERT_OK(builder.Add("bar", &value));
+  builder.SetProperty(/*property_id=*/1);
+  ICING_ASSERT_OK(builder.Add("foo", &value));
+  std::unique_ptr<FrontCodedLexicon> lexicon = builder.Build();
+  EXPECT_THAT(lexicon->num_properties(), Eq(2));
+  EXPECT_THAT(lexicon->HasProperty(0, /*property_id=*/1), IsTrue());
+  EXPECT_THAT(lexicon->HasProperty(1, /*property_id=*/1), IsFalse());
+  EXPECT_THAT(lexicon->HasProperty(0, /*property_id=*/0), IsFalse());
+  EXPECT_THAT(lexicon->HasProperty(0, /*property_id=*/7), IsFalse());
+
+  lexicon->SetProperty(1, /*property_id=*/7);
+  lexicon->ClearProperty(0, /*property_id=*/1);
+  EXPECT_THAT(lexicon->num_properties(), Eq(8));
+  EXPECT_THAT(lexicon->HasProperty(0, /*property_id=*/1), IsFalse());
+  EXPECT_THAT(lexicon->HasProperty(1, /*property_id=*/7), IsTrue());
+  EXPECT_THAT(lexicon->HasProperty(0, /*property_id=*/7), IsFalse());
+}
+
+TEST_F(FrontCodedLexiconTest, PrefixIteration) {
+  std::vector<std::string> terms = CreateTerms();
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon(terms);
+
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("")), ElementsAreArray(terms));
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("term02")),
+              ElementsAreArray(terms.begin() + 20, terms.begin() + 30));
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("term099")),
+              ElementsAre("term099"));
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("term1")), ElementsAre());
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("a")), ElementsAre());
+
+  FrontCodedLexicon::Iterator itr = lexicon->GetIterator("term05");
+  ASSERT_THAT(itr.IsValid(), IsTrue());
+  EXPECT_THAT(itr.GetTermIndex(), Eq(50));
+  EXPECT_THAT(GetValue(itr.GetValue()), Eq(50));
+}
+
+TEST_F(FrontCodedLexiconTest, PrefixIterationWithMaxByte) {
+  std::unique_ptr<FrontCodedLexicon> lexicon =
+      BuildLexicon({"a", "a\xff", "a\xff\xff", "b"});
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("a\xff")),
+              ElementsAre("a\xff", "a\xff\xff"));
+  EXPECT_THAT(GetTerms(lexicon->GetIterator("\xff")), ElementsAre());
+}
+
+TEST_F(FrontCodedLexiconTest, BuilderRejectsUnsortedTerms) {
+  FrontCodedLexicon::Builder builder(sizeof(uint32_t));
+  uint32_t value = 0;
+  ICING_ASSERT_OK(builder.Add("foo", &value));
+  EXPECT_THAT(builder.Add("bar", &value),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+  EXPECT_THAT(builder.Add("foo", &value),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+  ICING_EXPECT_OK(builder.Add("fool", &value));
+  EXPECT_THAT(builder.Build()->size(), Eq(2));
+}
+
+TEST_F(FrontCodedLexiconTest, MergeWithTrie) {
+  std::unique_ptr<FrontCodedLexicon> lexicon =
+      BuildLexicon({"bar", "baz", "foo"});
+
+  IcingFilesystem icing_filesystem;
+  IcingDynamicTrie trie(test_dir_ + "/trie_",
+                        IcingDynamicTrie::RuntimeOptions(),
+                        &icing_filesystem);
+  ASSERT_TRUE(trie.CreateIfNotExist(IcingDynamicTrie::Options()));
+  ASSERT_TRUE(trie.Init());
+  uint32_t trie_value = 100;
+  ASSERT_TRUE(trie.Insert("baz", &trie_value));
+  trie_value = 200;
+  ASSERT_TRUE(trie.Insert("aaa", &trie_value));
+  trie_value = 300;
+  ASSERT_TRUE(trie.Insert("qux", &trie_value));
+
+  // Keeps the existing value of a term if it has one and otherwise takes the
+  // trie's.
+  std::unique_ptr<FrontCodedLexicon> merged = FrontCodedLexicon::Merge(
+      *lexicon, trie,
+      [&trie](std::string_view term, const void* existing_value,
+              int64_t other_value_index, void* merged_value) {
+        if (existing_value != nullptr) {
+          memcpy(merged_value, existing_value, sizeof(uint32_t));
+        } else {
+          memcpy(merged_value, trie.GetValueAtIndex(other_value_index),
+                 sizeof(uint32_t));
+        }
+      });
+
+  EXPECT_THAT(GetTerms(merged->GetIterator("")),
+              ElementsAre("aaa", "bar", "baz", "foo", "qux"));
+  EXPECT_THAT(GetValue(merged->GetValueAtIndex(0)), Eq(200));
+  EXPECT_THAT(GetValue(merged->GetValueAtIndex(1)), Eq(0));
+  EXPECT_THAT(GetValue(merged->GetValueAtIndex(2)), Eq(1));
+  EXPECT_THAT(GetValue(merged->GetValueAtIndex(3)), Eq(2));
+  EXPECT_THAT(GetValue(merged->GetValueAtIndex(4)), Eq(300));
+}
+
+TEST_F(FrontCodedLexiconTest, MergeKeepsProperties) {
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon({"bar", "foo"});
+  lexicon->SetProperty(1, /*property_id=*/3);
+
+  IcingFilesystem icing_filesystem;
+  IcingDynamicTrie trie(test_dir_ + "/trie_",
+                        IcingDynamicTrie::RuntimeOptions(),
+                        &icing_filesystem);
+  ASSERT_TRUE(trie.CreateIfNotExist(IcingDynamicTrie::Options()));
+  ASSERT_TRUE(trie.Init());
+  uint32_t trie_value = 100;
+  ASSERT_TRUE(trie.Insert("baz", &trie_value));
+  ASSERT_TRUE(trie.Insert("foo", &trie_value));
+
+  std::unique_ptr<FrontCodedLexicon> merged = FrontCodedLexicon::Merge(
+      *lexicon, trie,
+      [](std::string_view term, const void* existing_value,
+         int64_t other_value_index, void* merged_value) {});
+
+  EXPECT_THAT(GetTerms(merged->GetIterator("")),
+              ElementsAre("bar", "baz", "foo"));
+  EXPECT_THAT(merged->HasProperty(0, /*property_id=*/3), IsFalse());
+  EXPECT_THAT(merged->HasProperty(1, /*property_id=*/3), IsFalse());
+  EXPECT_THAT(merged->HasProperty(2, /*property_id=*/3), IsTrue());
+}
+
+TEST_F(FrontCodedLexiconTest, WriteAndRead) {
+  std::vector<std::string> terms = CreateTerms();
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon(terms);
+  std::string filename = test_dir_ + "/lexicon";
+  ICING_ASSERT_OK(lexicon->Write(filesystem_, filename));
+
+  ICING_ASSERT_OK_AND_ASSIGN(std::unique_ptr<FrontCodedLexicon> read_lexicon,
+                             FrontCodedLexicon::Read(filesystem_, filename));
+  EXPECT_THAT(read_lexicon->size(), Eq(terms.size()));
+  EXPECT_THAT(read_lexicon->value_size(), Eq(sizeof(uint32_t)));
+  EXPECT_THAT(GetTerms(read_lexicon->GetIterator("")),
+              ElementsAreArray(terms));
+  uint32_t term_index;
+  ASSERT_THAT(read_lexicon->Find("term042", &term_index), IsTrue());
+  EXPECT_THAT(GetValue(read_lexicon->GetValueAtIndex(term_index)), Eq(42));
+}
+
+TEST_F(FrontCodedLexiconTest, WriteAndReadProperties) {
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon(CreateTerms());
+  lexicon->SetProperty(3, /*property_id=*/0);
+  lexicon->SetProperty(99, /*property_id=*/0);
+  lexicon->SetProperty(70, /*property_id=*/2);
+  std::string filename = test_dir_ + "/lexicon";
+  ICING_ASSERT_OK(lexicon->Write(filesystem_, filename));
+
+  ICING_ASSERT_OK_AND_ASSIGN(std::unique_ptr<FrontCodedLexicon> read_lexicon,
+                             FrontCodedLexicon::Read(filesystem_, filename));
+  EXPECT_THAT(read_lexicon->num_properties(), Eq(3));
+  for (uint32_t i = 0; i < read_lexicon->size(); ++i) {
+    EXPECT_THAT(read_lexicon->HasProperty(i, /*property_id=*/0),
+                Eq(i == 3 || i == 99));
+    EXPECT_THAT(read_lexicon->HasProperty(i, /*property_id=*/1), IsFalse());
+    EXPECT_THAT(read_lexicon->HasProperty(i, /*property_id=*/2), Eq(i == 70));
+  }
+}
+
+TEST_F(FrontCodedLexiconTest, ReadCorruptedFileDataLoss) {
+  std::unique_ptr<FrontCodedLexicon> lexicon = BuildLexicon(CreateTerms());
+  std::string filename = test_dir_ + "/lexicon";
+  ICING_ASSERT_OK(lexicon->Write(filesystem_, filename));
+
+  // Flip a byte of the last value.
+  int64_t file_size = filesystem_.GetFileSize(filename.c_str());
+  ScopedFd sfd(filesystem_.OpenForWrite(filename.c_str()));
+  char byte = 0x7f;
+  ASSERT_TRUE(filesystem_.PWrite(sfd.get(), file_size - 1, &byte, 1));
+  sfd.reset();
+
+  EXPECT_THAT(FrontCodedLexicon::Read(filesystem_, filename),
+              StatusIs(libtextclassifier3::StatusCode::DATA_LOSS));
+
+  // Truncate the file.
+  ASSERT_TRUE(filesystem_.Truncate(filename.c_str(), file_size / 2));
+  EXPECT_THAT(FrontCodedLexicon::Read(filesystem_, filename),
+              StatusIs(libtextclassifier3::StatusCode::DATA_LOSS));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,262 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/index-segment.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/hit.h"
+#include "icing/index/main/front-coded-lexicon.h"
+#include "icing/legacy/index/icing-bit-util.h"
+#include "icing/util/status-macros.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+// Postings are written to the hits file in chunks of about this size.
+constexpr size_t kWriteBufferSize = 64 * 1024;
+
+// Where the postings of a term are in the hits file. Stored as the value of
+// the term in the lexicon.
+struct TermInfo {
+  uint64_t offset;
+  uint32_t length;
+  uint32_t num_hits;
+};
+
+std::string MakeHitsFilename(const std::string& directory) {
+  return directory + "/hits";
+}
+
+std::string MakeLexiconFilename(const std::string& directory) {
+  return directory + "/lexicon";
+}
+
+TermInfo GetTermInfo(const FrontCodedLexicon& lexicon, uint32_t term_index) {
+  TermInfo term_info;
+  memcpy(&term_info, lexicon.GetValueAtIndex(term_index), sizeof(term_info));
+  return term_info;
+}
+
+void AppendVarInt(uint64_t value, std::string* out) {
+  uint8_t buf[VarInt::kMaxEncodedLen64];
+  size_t len = VarInt::Encode(value, buf);
+  out->append(reinterpret_cast<const char*>(buf), len);
+}
+
+// Decodes a VarInt at *pos in [*pos, end), advancing *pos past it. Returns
+// false if it runs past end.
+template <typename T>
+bool ReadVarInt(const uint8_t** pos, const uint8_t* end, T* value) {
+  const uint8_t* last = *pos;
+  while (last < end && (*last & 0x80)) {
+    ++last;
+  }
+  if (last >= end) {
+    return false;
+  }
+  *pos += VarInt::Decode(*pos, value);
+  return true;
+}
+
+}  // namespace
+
+libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment::Builder>>
+IndexSegment::Builder::Create(const Filesystem* filesystem,
+                              const std::string& directory) {
+  if (!filesystem->CreateDirectoryRecursively(directory.c_str())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to create segment directory: ", directory));
+  }
+  std::string hits_filename = MakeHitsFilename(directory);
+  ScopedFd hits_fd(filesystem->OpenForWrite(hits_filename.c_str()));
+  if (!hits_fd.is_valid() || !filesystem->Truncate(hits_fd.get(), 0)) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to create hits file: ", hits_filename));
+  }
+  return std::unique_ptr<Builder>(
+      new Builder(filesystem, directory, std::move(hits_fd)));
+}
+
+IndexSegment::Builder::Builder(const Filesystem* filesystem,
+                               std::string directory, ScopedFd hits_fd)
+    : filesystem_(filesystem),
+      directory_(std::move(directory)),
+      hits_fd_(std::move(hits_fd)),
+      lexicon_builder_(sizeof(TermInfo)) {}
+
+libtextclassifier3::Status IndexSegment::Builder::AddTerm(
+    std::string_view term, const Postings& postings) {
+  TermInfo term_info;
+  term_info.offset = hits_size_;
+  term_info.num_hits = postings.hits.size();
+  size_t start = buffer_.size();
+
+  AppendVarInt(postings.namespace_ids.size(), &buffer_);
+  for (NamespaceId namespace_id : postings.namespace_ids) {
+    AppendVarInt(namespace_id, &buffer_);
+  }
+  AppendVarInt(postings.hits.size(), &buffer_);
+  Hit::Value prev_value = 0;
+  for (const Hit& hit : postings.hits) {
+    AppendVarInt(hit.value() - prev_value, &buffer_);
+    buffer_.push_back(static_cast<char>(hit.term_frequency()));
+    prev_value = hit.value();
+  }
+  term_info.length = buffer_.size() - start;
+
+  libtextclassifier3::Status status = lexicon_builder_.Add(term, &term_info);
+  if (!status.ok()) {
+    buffer_.resize(start);
+    return status;
+  }
+  hits_size_ += term_info.length;
+  if (buffer_.size() >= kWriteBufferSize) {
+    return FlushBuffer();
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status IndexSegment::Builder::FlushBuffer() {
+  if (!filesystem_->Write(hits_fd_.get(), buffer_.data(), buffer_.size())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to write hits of segment ", directory_));
+  }
+  buffer_.clear();
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>>
+IndexSegment::Builder::Finish() {
+  ICING_RETURN_IF_ERROR(FlushBuffer());
+  if (!filesystem_->DataSync(hits_fd_.get())) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to sync hits of segment ", directory_));
+  }
+  std::unique_ptr<FrontCodedLexicon> lexicon = lexicon_builder_.Build();
+  ICING_RETURN_IF_ERROR(
+      lexicon->Write(*filesystem_, MakeLexiconFilename(directory_)));
+  return std::unique_ptr<IndexSegment>(
+      new IndexSegment(filesystem_, std::move(directory_), std::move(lexicon),
+                       std::move(hits_fd_), hits_size_));
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>> IndexSegment::Open(
+    const Filesystem* filesystem, const std::string& directory) {
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<FrontCodedLexicon> lexicon,
+      FrontCodedLexicon::Read(*filesystem, MakeLexiconFilename(directory)));
+  if (lexicon->value_size() != sizeof(TermInfo)) {
+    return absl_ports::DataLossError(
+        absl_ports::StrCat("Lexicon of segment ", directory,
+                           " has the wrong value size"));
+  }
+
+  std::string hits_filename = MakeHitsFilename(directory);
+  ScopedFd hits_fd(filesystem->OpenForRead(hits_filename.c_str()));
+  if (!hits_fd.is_valid()) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to open hits file: ", hits_filename));
+  }
+  int64_t hits_size = filesystem->GetFileSize(hits_fd.get());
+  if (hits_size == Filesystem::kBadFileSize) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to get size of hits file: ", hits_filename));
+  }
+  return std::unique_ptr<IndexSegment>(
+      new IndexSegment(filesystem, directory, std::move(lexicon),
+                       std::move(hits_fd), hits_size));
+}
+
+IndexSegment::IndexSegment(const Filesystem* filesystem, std::string directory,
+                           std::unique_ptr<FrontCodedLexicon> lexicon,
+                           ScopedFd hits_fd, int64_t hits_size)
+    : filesystem_(filesystem),
+      directory_(std::move(directory)),
+      lexicon_(std::move(lexicon)),
+      hits_fd_(std::move(hits_fd)),
+      hits_size_(hits_size) {
+  for (uint32_t i = 0; i < lexicon_->size(); ++i) {
+    num_hits_ += GetNumHits(i);
+  }
+}
+
+libtextclassifier3::StatusOr<IndexSegment::Postings> IndexSegment::GetPostings(
+    uint32_t term_index) const {
+  TermInfo term_info = GetTermInfo(*lexicon_, term_index);
+  if (term_info.offset + term_info.length > hits_size_) {
+    return absl_ports::DataLossError(absl_ports::StrCat(
+        "Postings run past the hits file of segment ", directory_));
+  }
+  std::vector<uint8_t> buf(term_info.length);
+  if (!filesystem_->PRead(hits_fd_.get(), buf.data(), buf.size(),
+                          term_info.offset)) {
+    return absl_ports::InternalError(
+        absl_ports::StrCat("Failed to read hits of segment ", directory_));
+  }
+
+  Postings postings;
+  const uint8_t* pos = buf.data();
+  const uint8_t* end = buf.data() + buf.size();
+  uint32_t num_namespaces;
+  if (!ReadVarInt(&pos, end, &num_namespaces)) {
+    return absl_ports::DataLossError("Corrupted postings");
+  }
+  for (uint32_t i = 0; i < num_namespaces; ++i) {
+    NamespaceId namespace_id;
+    if (!ReadVarInt(&pos, end, &namespace_id)) {
+      return absl_ports::DataLossError("Corrupted postings");
+    }
+    postings.namespace_ids.push_back(namespace_id);
+  }
+  uint32_t num_hits;
+  if (!ReadVarInt(&pos, end, &num_hits) || num_hits != term_info.num_hits) {
+    return absl_ports::DataLossError("Corrupted postings");
+  }
+  postings.hits.reserve(num_hits);
+  Hit::Value value = 0;
+  for (uint32_t i = 0; i < num_hits; ++i) {
+    Hit::Value delta;
+    if (!ReadVarInt(&pos, end, &delta) || pos >= end) {
+      return absl_ports::DataLossError("Corrupted postings");
+    }
+    value += delta;
+    postings.hits.push_back(Hit(value, /*term_frequency=*/*pos++));
+  }
+  return postings;
+}
+
+uint32_t IndexSegment::GetNumHits(uint32_t term_index) const {
+  return GetTermInfo(*lexicon_, term_index).num_hits;
+}
+
+int64_t IndexSegment::GetDiskUsage() const {
+  return filesystem_->GetDiskUsage(directory_.c_str());
+}
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,144 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_INDEX_MAIN_INDEX_SEGMENT_H_
+#define ICING_INDEX_MAIN_INDEX_SEGMENT_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/hit.h"
+#include "icing/index/main/front-coded-lexicon.h"
+#include "icing/store/namespace-id.h"
+
+namespace icing {
+namespace lib {
+
+// An immutable part of a segmented main index, holding the hits of a range of
+// documents. A segment is a directory with two files that are each written
+// once, sequentially:
+//   - "hits", the postings of all terms back to back. A term's postings are
+//     the namespaces it appears in followed by its hits, delta-encoded.
+//   - "lexicon", a FrontCodedLexicon mapping each term to where its postings
+//     are in "hits".
+//
+// The lexicon is held in memory. Postings are read from disk on demand.
+class IndexSegment {
+ public:
+  // The postings of a term.
+  struct Postings {
+    std::vector<NamespaceId> namespace_ids;
+    // Sorted by Hit value, i.e. in descending document id order.
+    std::vector<Hit> hits;
+  };
+
+  // Writes a new segment out of terms added in sorted order.
+  class Builder {
+   public:
+    // Creates a builder of a segment in directory, which must not exist yet.
+    //
+    // Returns:
+    //   A builder on success
+    //   INTERNAL on I/O error
+    static libtextclassifier3::StatusOr<std::unique_ptr<Builder>> Create(
+        const Filesystem* filesystem, const std::string& directory);
+
+    // Adds the postings of term. postings.hits must be sorted and not empty.
+    //
+    // Returns:
+    //   OK on success
+    //   INVALID_ARGUMENT if term doesn't sort after the previous term
+    //   INTERNAL on I/O error
+    libtextclassifier3::Status AddTerm(std::string_view term,
+                                       const Postings& postings);
+
+    // Syncs the segment to disk and opens it. The builder must not be used
+    // afterwards.
+    //
+    // Returns:
+    //   The segment on success
+    //   INTERNAL on I/O error
+    libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>> Finish();
+
+   private:
+    Builder(const Filesystem* filesystem, std::string directory,
+            ScopedFd hits_fd);
+
+    // Writes buffer_ to the end of the hits file.
+    libtextclassifier3::Status FlushBuffer();
+
+    const Filesystem* filesystem_;
+    std::string directory_;
+    ScopedFd hits_fd_;
+    FrontCodedLexicon::Builder lexicon_builder_;
+    // Postings that haven't been written to the hits file yet.
+    std::string buffer_;
+    // The size of the hits file once buffer_ is written.
+    uint64_t hits_size_ = 0;
+  };
+
+  // Opens the segment in directory.
+  //
+  // Returns:
+  //   The segment on success
+  //   DATA_LOSS if the segment is corrupted
+  //   INTERNAL on I/O error
+  static libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>> Open(
+      const Filesystem* filesystem, const std::string& directory);
+
+  const FrontCodedLexicon& lexicon() const { return *lexicon_; }
+
+  // Reads the postings of the term at term_index in lexicon().
+  //
+  // Returns:
+  //   The postings on success
+  //   DATA_LOSS if they're corrupted
+  //   INTERNAL on I/O error
+  libtextclassifier3::StatusOr<Postings> GetPostings(
+      uint32_t term_index) const;
+
+  // Returns the number of hits of the term at term_index in lexicon().
+  uint32_t GetNumHits(uint32_t term_index) const;
+
+  // The number of hits of all terms.
+  int64_t num_hits() const { return num_hits_; }
+
+  // The number of bytes the segment takes up on disk.
+  int64_t GetDiskUsage() const;
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  IndexSegment(const Filesystem* filesystem, std::string directory,
+               std::unique_ptr<FrontCodedLexicon> lexicon, ScopedFd hits_fd,
+               int64_t hits_size);
+
+  const Filesystem* filesystem_;
+  std::string directory_;
+  std::unique_ptr<FrontCodedLexicon> lexicon_;
+  ScopedFd hits_fd_;
+  int64_t hits_size_;
+  int64_t num_hits_ = 0;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_INDEX_MAIN_INDEX_SEGMENT_H_
@@ -0,0 +1,130 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/index-segment.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/hit.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsTrue;
+
+class IndexSegmentTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = GetTestTempDir() + "/index_segment_test";
+    segment_dir_ = test_dir_ + "/segment";
+  }
+
+  void TearDown() override {
+    filesystem_.DeleteDirectoryRecursively(test_dir_.c_str());
+  }
+
+  Filesystem filesystem_;
+  std::string test_dir_;
+  std::string segment_dir_;
+};
+
+// Returns the hits of the given documents, in sorted order.
+std::vector<Hit> CreateHits(const std::vector<DocumentId>& document_ids) {
+  std::vector<Hit> hits;
+  for (DocumentId document_id : document_ids) {
+    hits.push_back(Hit(/*section_id=*/1, document_id,
+                       /*term_frequency=*/document_id % 10 + 1));
+  }
+  std::sort(hits.begin(), hits.end());
+  return hits;
+}
+
+TEST_F(IndexSegmentTest, WriteAndOpen) {
+  IndexSegment::Postings bar = {/*namespace_ids=*/{0, 3},
+                                CreateHits({1, 5, 1000, 70000})};
+  IndexSegment::Postings foo = {/*namespace_ids=*/{2}, CreateHits({7})};
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<IndexSegment::Builder> builder,
+        IndexSegment::Builder::Create(&filesystem_, segment_dir_));
+    ICING_ASSERT_OK(builder->AddTerm("bar", bar));
+    ICING_ASSERT_OK(builder->AddTerm("foo", foo));
+    ICING_ASSERT_OK(builder->Finish());
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(std::unique_ptr<IndexSegment> segment,
+                             IndexSegment::Open(&filesystem_, segment_dir_));
+  EXPECT_THAT(segment->num_hits(), Eq(5));
+  uint32_t term_index;
+  ASSERT_THAT(segment->lexicon().Find("bar", &term_index), IsTrue());
+  EXPECT_THAT(segment->GetNumHits(term_index), Eq(4));
+  ICING_ASSERT_OK_AND_ASSIGN(IndexSegment::Postings postings,
+                             segment->GetPostings(term_index));
+  EXPECT_THAT(postings.namespace_ids, ElementsAre(0, 3));
+  ASSERT_THAT(postings.hits.size(), Eq(4));
+  for (size_t i = 0; i < bar.hits.size(); ++i) {
+    EXPECT_THAT(postings.hits[i], Eq(bar.hits[i]));
+    EXPECT_THAT(postings.hits[i].term_frequency(),
+                Eq(bar.hits[i].term_frequency()));
+  }
+
+  ASSERT_THAT(segment->lexicon().Find("foo", &term_index), IsTrue());
+  ICING_ASSERT_OK_AND_ASSIGN(postings, segment->GetPostings(term_index));
+  EXPECT_THAT(postings.namespace_ids, ElementsAre(2));
+  EXPECT_THAT(postings.hits, ElementsAre(foo.hits[0]));
+}
+
+TEST_F(IndexSegmentTest, AddTermOutOfOrderFails) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<IndexSegment::Builder> builder,
+      IndexSegment::Builder::Create(&filesystem_, segment_dir_));
+  ICING_ASSERT_OK(builder->AddTerm("foo", {{}, CreateHits({1})}));
+  EXPECT_THAT(builder->AddTerm("bar", {{}, CreateHits({2})}),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+}
+
+TEST_F(IndexSegmentTest, TruncatedHitsDataLoss) {
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<IndexSegment::Builder> builder,
+        IndexSegment::Builder::Create(&filesystem_, segment_dir_));
+    ICING_ASSERT_OK(builder->AddTerm("foo", {{}, CreateHits({1, 2, 3})}));
+    ICING_ASSERT_OK(builder->Finish());
+  }
+  std::string hits_filename = segment_dir_ + "/hits";
+  int64_t hits_size = filesystem_.GetFileSize(hits_filename.c_str());
+  ASSERT_TRUE(filesystem_.Truncate(hits_filename.c_str(), hits_size - 1));
+
+  ICING_ASSERT_OK_AND_ASSIGN(std::unique_ptr<IndexSegment> segment,
+                             IndexSegment::Open(&filesystem_, segment_dir_));
+  EXPECT_THAT(segment->GetPostings(0),
+              StatusIs(libtextclassifier3::StatusCode::DATA_LOSS));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -13,16 +13,34 @@
 // limitations under the License.
 #include "icing/index/main/main-index.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "icing/absl_ports/canonical_errors.h"
 #include "icing/absl_ports/str_cat.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/hit.h"
+#include "icing/index/main/front-coded-lexicon.h"
 #include "icing/index/main/index-block.h"
 #include "icing/index/term-id-codec.h"
 #include "icing/index/term-property-id.h"
 #include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/util/crc32.h"
+#include "icing/util/i18n-utils.h"
+#include "icing/util/logging.h"
 #include "icing/util/status-macros.h"
 
 namespace icing {
@@ -30,6 +48,114 @@ namespace lib {
 
 namespace {
 
+// The uncompressed size of a hit, used to account for backfill work.
+constexpr int kHitBytes = sizeof(Hit::Value) + sizeof(Hit::TermFrequency);
+
+constexpr char kLexiconFilename[] = "/main-lexicon";
+constexpr char kFrontCodedLexiconFilename[] = "/main-front-coded-lexicon";
+constexpr char kChampionListsFilePrefix[] = "/main-champions";
+constexpr char kPendingBackfillsFilename[] = "/main-pending-backfills";
+// The suffix of the file that every IcingDynamicTrie has once it was created.
+constexpr char kLexiconHeaderSuffix[] = ".h";
+// Holds the generation of the files above that is in use.
+constexpr char kLexiconGenerationFilename[] = "/main-lexicon-generation";
+
+std::atomic<uint64_t> next_version{0};
+
+struct LexiconGenerationFile {
+  static constexpr int32_t kMagic = 0x6c786772;
+
+  int32_t magic;
+  uint32_t generation;
+};
+
+// Returns the name of the file that generation holds for base_filename, one
+// of the lexicon files above. Generation 0 is that of lexicons that were never
+// compacted, whose files have no suffix.
+std::string MakeLexiconFilename(const std::string& index_directory,
+                                const char* base_filename,
+                                uint32_t generation) {
+  if (generation == 0) {
+    return absl_ports::StrCat(index_directory, base_filename);
+  }
+  return absl_ports::StrCat(index_directory, base_filename, "-",
+                            std::to_string(generation));
+}
+
+// Returns the generation of the lexicon files in index_directory, or 0 if no
+// generation was ever written.
+libtextclassifier3::StatusOr<uint32_t> ReadLexiconGeneration(
+    const Filesystem& filesystem, const std::string& index_directory) {
+  std::string filename = index_directory + kLexiconGenerationFilename;
+  if (!filesystem.FileExists(filename.c_str())) {
+    return uint32_t{0};
+  }
+  LexiconGenerationFile generation_file;
+  if (filesystem.GetFileSize(filename.c_str()) != sizeof(generation_file) ||
+      !filesystem.Read(filename.c_str(), &generation_file,
+                       sizeof(generation_file))) {
+    return absl_ports::InternalError("Failed to read lexicon generation");
+  }
+  if (generation_file.magic != LexiconGenerationFile::kMagic) {
+    return absl_ports::DataLossError("Lexicon generation is corrupt");
+  }
+  return generation_file.generation;
+}
+
+// Makes generation the generation of the lexicon files in index_directory.
+// The file is replaced in one rename, so a crash leaves either the old or the
+// new generation in use.
+libtextclassifier3::Status WriteLexiconGeneration(
+    const Filesystem& filesystem, const std::string& index_directory,
+    uint32_t generation) {
+  LexiconGenerationFile generation_file;
+  generation_file.magic = LexiconGenerationFile::kMagic;
+  generation_file.generation = generation;
+  std::string filename = index_directory + kLexiconGenerationFilename;
+  std::string temp_filename = filename + ".tmp";
+  {
+    ScopedFd sfd(filesystem.OpenForWrite(temp_filename.c_str()));
+    if (!sfd.is_valid() || !filesystem.Truncate(sfd.get(), 0) ||
+        !filesystem.Write(sfd.get(), &generation_file,
+                          sizeof(generation_file)) ||
+        !filesystem.DataSync(sfd.get())) {
+      return absl_ports::InternalError("Failed to write lexicon generation");
+    }
+  }
+  if (!filesystem.RenameFile(temp_filename.c_str(), filename.c_str())) {
+    return absl_ports::InternalError("Failed to replace lexicon generation");
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+struct PendingBackfillsHeader {
+  static constexpr int32_t kMagic = 0x70626b66;
+
+  int32_t magic;
+  // The last document of the main index when the file was written.
+  DocumentId last_indexed_document_id;
+  int32_t num_pending_backfills;
+  // Checksum of the rest of the header and the entries.
+  uint32_t checksum;
+};
+
+struct PendingBackfill {
+  uint32_t branch_point_tvi;
+  uint32_t source_tvi;
+};
+
+uint32_t ComputePendingBackfillsChecksum(
+    const PendingBackfillsHeader& header,
+    const std::vector<PendingBackfill>& pending_backfills) {
+  Crc32 crc;
+  crc.Append(std::string_view(reinterpret_cast<const char*>(&header),
+                              offsetof(PendingBackfillsHeader, checksum)));
+  crc.Append(std::string_view(
+      reinterpret_cast<const char*>(pending_backfills.data()),
+      pending_backfills.size() * sizeof(PendingBackfill)));
+  return crc.Get();
+}
+
 // Finds the shortest,valid prefix term with prefix hits in lexicon for which
 // "prefix" is a prefix.
 // Returns a valid FindTermResult with found=true if either:
@@ -81,26 +207,229 @@ FindTermResult FindShortestValidTermWithPrefixHits(
   return result;
 }
 
+// Keeps the values of all terms except the ones with the given value indices.
+class DropTermsValueMap : public IcingDynamicTrie::NewValueMap {
+ public:
+  DropTermsValueMap(const IcingDynamicTrie* lexicon,
+                    const std::unordered_set<uint32_t>* tvis_to_drop)
+      : lexicon_(*lexicon), tvis_to_drop_(*tvis_to_drop) {}
+
+  const void* GetNewValue(uint32_t old_value_index) const override {
+    if (tvis_to_drop_.count(old_value_index) > 0) {
+      return nullptr;
+    }
+    return lexicon_.GetValueAtIndex(old_value_index);
+  }
+
+ private:
+  const IcingDynamicTrie& lexicon_;
+  const std::unordered_set<uint32_t>& tvis_to_drop_;
+};
+
+// Iterates over the terms with a given prefix in either type of main lexicon.
+class LexiconTermIterator {
+ public:
+  // Exactly one of trie and front_coded_lexicon must be set.
+  LexiconTermIterator(const IcingDynamicTrie* trie,
+                      const FrontCodedLexicon* front_coded_lexicon,
+                      const std::string& prefix) {
+    if (front_coded_lexicon != nullptr) {
+      front_coded_itr_.emplace(front_coded_lexicon->GetIterator(prefix));
+    } else {
+      trie_itr_.emplace(*trie, prefix.c_str());
+    }
+  }
+
+  bool IsValid() const {
+    return front_coded_itr_.has_value() ? front_coded_itr_->IsValid()
+                                        : trie_itr_->IsValid();
+  }
+
+  void Advance() {
+    if (front_coded_itr_.has_value()) {
+      front_coded_itr_->Advance();
+    } else {
+      trie_itr_->Advance();
+    }
+  }
+
+  std::string_view GetTerm() const {
+    return front_coded_itr_.has_value() ? front_coded_itr_->GetTerm()
+                                        : trie_itr_->GetKey();
+  }
+
+  uint32_t GetValueIndex() const {
+    return front_coded_itr_.has_value() ? front_coded_itr_->GetTermIndex()
+                                        : trie_itr_->GetValueIndex();
+  }
+
+ private:
+  std::optional<IcingDynamicTrie::Iterator> trie_itr_;
+  std::optional<FrontCodedLexicon::Iterator> front_coded_itr_;
+};
+
+// Reads the properties of the terms of either type of main lexicon.
+class LexiconPropertyReader {
+ public:
+  // Exactly one of trie and front_coded_lexicon must be set.
+  LexiconPropertyReader(const IcingDynamicTrie* trie,
+                        const FrontCodedLexicon* front_coded_lexicon)
+      : front_coded_lexicon_(front_coded_lexicon) {
+    if (trie != nullptr) {
+      trie_reader_.emplace(*trie);
+    }
+  }
+
+  bool HasProperty(uint32_t property_id, uint32_t value_index) const {
+    if (front_coded_lexicon_ != nullptr) {
+      return front_coded_lexicon_->HasProperty(value_index, property_id);
+    }
+    return trie_reader_->HasProperty(property_id, value_index);
+  }
+
+ private:
+  std::optional<IcingDynamicTrie::PropertyReadersAll> trie_reader_;
+  const FrontCodedLexicon* front_coded_lexicon_;
+};
+
+std::unique_ptr<FrontCodedLexicon> CreateEmptyFrontCodedLexicon() {
+  return FrontCodedLexicon::Builder(sizeof(PostingListIdentifier)).Build();
+}
+
+int CommonPrefixLength(std::string_view a, std::string_view b) {
+  size_t length = 0;
+  size_t max_length = std::min(a.length(), b.length());
+  while (length < max_length && a[length] == b[length]) {
+    ++length;
+  }
+  return length;
+}
+
+// A term that a merge adds to a front-coded main lexicon, unless it's already
+// there.
+struct NewFrontCodedTerm {
+  // The value index of the term in the lite lexicon, or -1 if the term is
+  // only a branch point.
+  int64_t other_tvi = -1;
+
+  // For new branch points whose hits have to be backfilled, the index of the
+  // term in the old lexicon that they are backfilled from. -1 otherwise.
+  int64_t backfill_source = -1;
+
+  // Whether the term is a branch point that gets the hits from prefix
+  // sections of the lite terms below it.
+  bool is_prefix_branch_point = false;
+
+  // For lite terms with hits in prefix sections, the lengths of the branch
+  // points above them, shortest first.
+  std::vector<int> prefix_lengths;
+
+  // Whether the term was in the old lexicon, and its index in the new one.
+  bool existed = false;
+  uint32_t term_index = 0;
+};
+
+using NewFrontCodedTerms = std::map<std::string, NewFrontCodedTerm>;
+
+// Calls fn(term, term_index, new_term_itr) for every term that is in lexicon
+// or in new_terms, in sorted order. term_index is the index of the term in
+// lexicon, or -1 if it isn't there. new_term_itr points to the term in
+// new_terms, or is new_terms.end() if it isn't there.
+template <typename Fn>
+void ForEachMergedTerm(const FrontCodedLexicon& lexicon,
+                       NewFrontCodedTerms& new_terms, Fn fn) {
+  FrontCodedLexicon::Iterator itr = lexicon.GetIterator(/*prefix=*/"");
+  auto new_term_itr = new_terms.begin();
+  while (itr.IsValid() || new_term_itr != new_terms.end()) {
+    int comparison;
+    if (!itr.IsValid()) {
+      comparison = 1;
+    } else if (new_term_itr == new_terms.end()) {
+      comparison = -1;
+    } else {
+      comparison = itr.GetTerm().compare(new_term_itr->first);
+    }
+    if (comparison < 0) {
+      fn(itr.GetTerm(), static_cast<int64_t>(itr.GetTermIndex()),
+         new_terms.end());
+      itr.Advance();
+    } else if (comparison > 0) {
+      fn(new_term_itr->first, int64_t{-1}, new_term_itr);
+      ++new_term_itr;
+    } else {
+      fn(itr.GetTerm(), static_cast<int64_t>(itr.GetTermIndex()),
+         new_term_itr);
+      itr.Advance();
+      ++new_term_itr;
+    }
+  }
+}
+
 }  // namespace
 
+bool MainIndex::HasLexiconOfOtherType(const std::string& index_directory,
+                                      const Filesystem& filesystem,
+                                      LexiconType lexicon_type) {
+  // A generation that can't be read is reported by Create.
+  auto generation_or = ReadLexiconGeneration(filesystem, index_directory);
+  uint32_t generation = generation_or.ok() ? generation_or.ValueOrDie() : 0;
+  std::string other_lexicon_filename =
+      lexicon_type == LexiconType::kFrontCoded
+          ? MakeLexiconFilename(index_directory, kLexiconFilename,
+                                generation) +
+                kLexiconHeaderSuffix
+          : MakeLexiconFilename(index_directory, kFrontCodedLexiconFilename,
+                                generation);
+  return filesystem.FileExists(other_lexicon_filename.c_str());
+}
+
+uint64_t MainIndex::NewVersion() { return next_version.fetch_add(1); }
+
 libtextclassifier3::StatusOr<std::unique_ptr<MainIndex>> MainIndex::Create(
     const std::string& index_directory, const Filesystem* filesystem,
-    const IcingFilesystem* icing_filesystem) {
+    const IcingFilesystem* icing_filesystem,
+    ChampionListOptions champion_list_options, LexiconType lexicon_type) {
   ICING_RETURN_ERROR_IF_NULL(filesystem);
   ICING_RETURN_ERROR_IF_NULL(icing_filesystem);
+  if (champion_list_options.champion_list_size < 0) {
+    return absl_ports::InvalidArgumentError(
+        "Champion list size must not be negative.");
+  }
+  if (champion_list_options.champion_list_size > 0 &&
+      champion_list_options.get_document_score == nullptr) {
+    return absl_ports::InvalidArgumentError(
+        "Champion lists need a way to get document scores.");
+  }
+  if (HasLexiconOfOtherType(index_directory, *filesystem, lexicon_type)) {
+    return absl_ports::FailedPreconditionError(
+        "Main index was created with another type of lexicon.");
+  }
   auto main_index = std::make_unique<MainIndex>();
-  ICING_RETURN_IF_ERROR(
-      main_index->Init(index_directory, filesystem, icing_filesystem));
+  main_index->champion_list_options_ = std::move(champion_list_options);
+  ICING_RETURN_IF_ERROR(main_index->Init(index_directory, filesystem,
+                                         icing_filesystem, lexicon_type));
   return main_index;
 }
 
 // TODO(b/139087650) : Migrate off of IcingFilesystem.
 libtextclassifier3::Status MainIndex::Init(
     const std::string& index_directory, const Filesystem* filesystem,
-    const IcingFilesystem* icing_filesystem) {
+    const IcingFilesystem* icing_filesystem, LexiconType lexicon_type) {
   if (!filesystem->CreateDirectoryRecursively(index_directory.c_str())) {
     return absl_ports::InternalError("Unable to create main index directory.");
   }
+  filesystem_ = filesystem;
+  icing_filesystem_ = icing_filesystem;
+  index_directory_ = index_directory;
+  ICING_ASSIGN_OR_RETURN(uint32_t lexicon_generation,
+                         ReadLexiconGeneration(*filesystem, index_directory));
+  SetLexiconGeneration(lexicon_generation);
+  // A crash during CompactLexicon may have left the files of the generation
+  // it switched from, or of the one it never switched to, behind.
+  if (lexicon_generation > 0) {
+    ICING_RETURN_IF_ERROR(DeleteLexiconFiles(lexicon_generation - 1));
+  }
+  ICING_RETURN_IF_ERROR(DeleteLexiconFiles(lexicon_generation + 1));
   std::string flash_index_file = index_directory + "/main_index";
   ICING_ASSIGN_OR_RETURN(
       FlashIndexStorage flash_index,
@@ -108,15 +437,245 @@ libtextclassifier3::Status MainIndex::Init(
   flash_index_storage_ =
       std::make_unique<FlashIndexStorage>(std::move(flash_index));
 
-  std::string lexicon_file = index_directory + "/main-lexicon";
+  if (lexicon_type == LexiconType::kFrontCoded) {
+    ICING_RETURN_IF_ERROR(InitFrontCodedLexicon());
+  } else {
+    ICING_ASSIGN_OR_RETURN(main_lexicon_, OpenLexicon(lexicon_filename_));
+  }
+
+  ICING_ASSIGN_OR_RETURN(
+      champion_list_store_,
+      ChampionListStore::Create(filesystem, champion_lists_file_prefix_,
+                                last_added_document_id()));
+  if (champion_list_store_->champion_list_size() !=
+      champion_list_options_.champion_list_size) {
+    // The champion lists were discarded or built with another size. Terms get
+    // new ones as they get new hits and until then, their full posting lists
+    // are used.
+    ICING_RETURN_IF_ERROR(
+        ClearChampionLists(champion_list_options_.champion_list_size));
+  }
+  return LoadPendingBackfills();
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<IcingDynamicTrie>>
+MainIndex::OpenLexicon(const std::string& filename) const {
   IcingDynamicTrie::RuntimeOptions runtime_options;
-  main_lexicon_ = std::make_unique<IcingDynamicTrie>(
-      lexicon_file, runtime_options, icing_filesystem);
+  auto lexicon = std::make_unique<IcingDynamicTrie>(filename, runtime_options,
+                                                    icing_filesystem_);
   IcingDynamicTrie::Options lexicon_options;
-  if (!main_lexicon_->CreateIfNotExist(lexicon_options) ||
-      !main_lexicon_->Init()) {
+  if (!lexicon->CreateIfNotExist(lexicon_options) || !lexicon->Init()) {
     return absl_ports::InternalError("Failed to initialize lexicon trie");
   }
+  return lexicon;
+}
+
+void MainIndex::SetLexiconGeneration(uint32_t generation) {
+  lexicon_generation_ = generation;
+  lexicon_filename_ =
+      MakeLexiconFilename(index_directory_, kLexiconFilename, generation);
+  front_coded_lexicon_filename_ = MakeLexiconFilename(
+      index_directory_, kFrontCodedLexiconFilename, generation);
+  champion_lists_file_prefix_ = MakeLexiconFilename(
+      index_directory_, kChampionListsFilePrefix, generation);
+  pending_backfills_filename_ = MakeLexiconFilename(
+      index_directory_, kPendingBackfillsFilename, generation);
+}
+
+libtextclassifier3::Status MainIndex::DeleteLexiconFiles(
+    uint32_t generation) const {
+  IcingDynamicTrie lexicon(
+      MakeLexiconFilename(index_directory_, kLexiconFilename, generation),
+      IcingDynamicTrie::RuntimeOptions(), icing_filesystem_);
+  std::string front_coded_lexicon_filename = MakeLexiconFilename(
+      index_directory_, kFrontCodedLexiconFilename, generation);
+  std::string pending_backfills_filename = MakeLexiconFilename(
+      index_directory_, kPendingBackfillsFilename, generation);
+  if (!lexicon.Remove() ||
+      !filesystem_->DeleteFile(front_coded_lexicon_filename.c_str()) ||
+      !filesystem_->DeleteFile(
+          (front_coded_lexicon_filename + ".tmp").c_str()) ||
+      !filesystem_->DeleteFile(pending_backfills_filename.c_str()) ||
+      !filesystem_->DeleteFile((pending_backfills_filename + ".tmp").c_str())) {
+    return absl_ports::InternalError("Failed to delete lexicon files");
+  }
+  return ChampionListStore::Delete(
+      filesystem_, MakeLexiconFilename(index_directory_,
+                                       kChampionListsFilePrefix, generation));
+}
+
+libtextclassifier3::Status MainIndex::InitFrontCodedLexicon() {
+  if (filesystem_->FileExists(front_coded_lexicon_filename_.c_str())) {
+    ICING_ASSIGN_OR_RETURN(front_coded_lexicon_,
+                           FrontCodedLexicon::Read(
+                               *filesystem_, front_coded_lexicon_filename_));
+    return libtextclassifier3::Status::OK;
+  }
+  front_coded_lexicon_ = CreateEmptyFrontCodedLexicon();
+  // Written right away so that the type of the lexicon can be told from the
+  // files. See HasLexiconOfOtherType.
+  front_coded_lexicon_dirty_ = true;
+  return WriteFrontCodedLexicon();
+}
+
+libtextclassifier3::Status MainIndex::WriteFrontCodedLexicon() {
+  if (!front_coded_lexicon_dirty_) {
+    return libtextclassifier3::Status::OK;
+  }
+  // Write to a temporary file first so that a crash never leaves a partially
+  // written lexicon behind.
+  std::string temp_filename = front_coded_lexicon_filename_ + ".tmp";
+  ICING_RETURN_IF_ERROR(
+      front_coded_lexicon_->Write(*filesystem_, temp_filename));
+  if (!filesystem_->RenameFile(temp_filename.c_str(),
+                               front_coded_lexicon_filename_.c_str())) {
+    return absl_ports::InternalError("Failed to replace front-coded lexicon");
+  }
+  front_coded_lexicon_dirty_ = false;
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::PersistToDisk() {
+  if ((main_lexicon_ != nullptr && !main_lexicon_->Sync()) ||
+      !flash_index_storage_->PersistToDisk()) {
+    return absl_ports::InternalError("Unable to sync lite index components.");
+  }
+  if (front_coded_lexicon_ != nullptr) {
+    ICING_RETURN_IF_ERROR(WriteFrontCodedLexicon());
+  }
+  ICING_RETURN_IF_ERROR(WritePendingBackfills());
+  // The champion lists are only trusted on the next Create if the rest of
+  // the main index was synced first.
+  return champion_list_store_->PersistToDisk(last_added_document_id());
+}
+
+libtextclassifier3::Status MainIndex::Reset() {
+  version_ = NewVersion();
+  ICING_RETURN_IF_ERROR(flash_index_storage_->Reset());
+  if (front_coded_lexicon_ != nullptr) {
+    front_coded_lexicon_ = CreateEmptyFrontCodedLexicon();
+    front_coded_lexicon_dirty_ = true;
+    ICING_RETURN_IF_ERROR(WriteFrontCodedLexicon());
+  } else {
+    // Clearing the lexicon would keep its files at the size they grew to.
+    ICING_RETURN_IF_ERROR(RecreateLexicon());
+  }
+  pending_backfills_.clear();
+  ICING_RETURN_IF_ERROR(WritePendingBackfills());
+  return champion_list_store_->Clear(champion_list_options_.champion_list_size);
+}
+
+PostingListIdentifier MainIndex::GetLexiconPostingListId(uint32_t tvi) const {
+  const void* value = front_coded_lexicon_ != nullptr
+                          ? front_coded_lexicon_->GetValueAtIndex(tvi)
+                          : main_lexicon_->GetValueAtIndex(tvi);
+  PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
+  memcpy(&posting_list_id, value, sizeof(posting_list_id));
+  return posting_list_id;
+}
+
+void MainIndex::SetLexiconPostingListId(uint32_t tvi,
+                                        PostingListIdentifier posting_list_id) {
+  if (front_coded_lexicon_ != nullptr) {
+    front_coded_lexicon_->SetValueAtIndex(tvi, &posting_list_id);
+    front_coded_lexicon_dirty_ = true;
+  } else {
+    main_lexicon_->SetValueAtIndex(tvi, &posting_list_id);
+  }
+}
+
+libtextclassifier3::Status MainIndex::RecreateLexicon() {
+  if (!main_lexicon_->Remove()) {
+    return absl_ports::InternalError("Failed to remove lexicon trie");
+  }
+  ICING_ASSIGN_OR_RETURN(main_lexicon_, OpenLexicon(lexicon_filename_));
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::LoadPendingBackfills() {
+  if (!filesystem_->FileExists(pending_backfills_filename_.c_str())) {
+    return libtextclassifier3::Status::OK;
+  }
+  int64_t file_size =
+      filesystem_->GetFileSize(pending_backfills_filename_.c_str());
+  if (file_size == Filesystem::kBadFileSize) {
+    return absl_ports::InternalError("Failed to get pending backfills size");
+  }
+  PendingBackfillsHeader header;
+  if (file_size < static_cast<int64_t>(sizeof(header))) {
+    return absl_ports::DataLossError("Pending backfills file is truncated");
+  }
+  std::vector<PendingBackfill> pending_backfills(
+      (file_size - sizeof(header)) / sizeof(PendingBackfill));
+  if (!filesystem_->PRead(pending_backfills_filename_.c_str(), &header,
+                          sizeof(header), /*offset=*/0) ||
+      !filesystem_->PRead(pending_backfills_filename_.c_str(),
+                          pending_backfills.data(),
+                          pending_backfills.size() * sizeof(PendingBackfill),
+                          /*offset=*/sizeof(header))) {
+    return absl_ports::InternalError("Failed to read pending backfills");
+  }
+  if (header.magic != PendingBackfillsHeader::kMagic ||
+      header.num_pending_backfills !=
+          static_cast<int32_t>(pending_backfills.size()) ||
+      header.checksum !=
+          ComputePendingBackfillsChecksum(header, pending_backfills)) {
+    return absl_ports::DataLossError("Pending backfills are corrupt");
+  }
+  if (header.last_indexed_document_id != last_added_document_id()) {
+    return absl_ports::DataLossError(
+        "Pending backfills don't match the main index");
+  }
+  for (const PendingBackfill& pending_backfill : pending_backfills) {
+    pending_backfills_[pending_backfill.branch_point_tvi] =
+        pending_backfill.source_tvi;
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::WritePendingBackfills() {
+  return WritePendingBackfills(pending_backfills_filename_,
+                               pending_backfills_);
+}
+
+libtextclassifier3::Status MainIndex::WritePendingBackfills(
+    const std::string& filename,
+    const std::map<uint32_t, uint32_t>& pending_backfill_map) const {
+  if (pending_backfill_map.empty()) {
+    if (filesystem_->FileExists(filename.c_str()) &&
+        !filesystem_->DeleteFile(filename.c_str())) {
+      return absl_ports::InternalError("Failed to delete pending backfills");
+    }
+    return libtextclassifier3::Status::OK;
+  }
+  std::vector<PendingBackfill> pending_backfills;
+  pending_backfills.reserve(pending_backfill_map.size());
+  for (const auto& [branch_point_tvi, source_tvi] : pending_backfill_map) {
+    pending_backfills.push_back({branch_point_tvi, source_tvi});
+  }
+  PendingBackfillsHeader header;
+  header.magic = PendingBackfillsHeader::kMagic;
+  header.last_indexed_document_id = last_added_document_id();
+  header.num_pending_backfills = pending_backfills.size();
+  header.checksum = ComputePendingBackfillsChecksum(header, pending_backfills);
+
+  // Write to a temporary file first so that a crash never leaves a partially
+  // written file behind.
+  std::string temp_filename = filename + ".tmp";
+  {
+    ScopedFd sfd(filesystem_->OpenForWrite(temp_filename.c_str()));
+    if (!sfd.is_valid() || !filesystem_->Truncate(sfd.get(), 0) ||
+        !filesystem_->Write(sfd.get(), &header, sizeof(header)) ||
+        !filesystem_->Write(sfd.get(), pending_backfills.data(),
+                            pending_backfills.size() *
+                                sizeof(PendingBackfill)) ||
+        !filesystem_->DataSync(sfd.get())) {
+      return absl_ports::InternalError("Failed to write pending backfills");
+    }
+  }
+  if (!filesystem_->RenameFile(temp_filename.c_str(), filename.c_str())) {
+    return absl_ports::InternalError("Failed to replace pending backfills");
+  }
   return libtextclassifier3::Status::OK;
 }
 
@@ -127,13 +686,24 @@ libtextclassifier3::StatusOr<int64_t> MainIndex::GetElementsSize() const {
     return absl_ports::AbortedError(
         "Failed to get size of MainIndex's members.");
   }
+  ICING_ASSIGN_OR_RETURN(int64_t champion_lists_size,
+                         champion_list_store_->GetElementsSize());
   return storage_info.main_index_storage_size() +
-         storage_info.main_index_lexicon_size();
+         storage_info.main_index_lexicon_size() + champion_lists_size;
 }
 
 IndexStorageInfoProto MainIndex::GetStorageInfo(
     IndexStorageInfoProto storage_info) const {
-  int64_t lexicon_elt_size = main_lexicon_->GetElementsSize();
+  int64_t lexicon_elt_size;
+  if (front_coded_lexicon_ != nullptr) {
+    lexicon_elt_size =
+        filesystem_->GetFileSize(front_coded_lexicon_filename_.c_str());
+    if (lexicon_elt_size == Filesystem::kBadFileSize) {
+      lexicon_elt_size = IcingFilesystem::kBadFileSize;
+    }
+  } else {
+    lexicon_elt_size = main_lexicon_->GetElementsSize();
+  }
   if (lexicon_elt_size != IcingFilesystem::kBadFileSize) {
     storage_info.set_main_index_lexicon_size(lexicon_elt_size);
   } else {
@@ -153,20 +723,68 @@ IndexStorageInfoProto MainIndex::GetStorageInfo(
 
 libtextclassifier3::StatusOr<std::unique_ptr<PostingListAccessor>>
 MainIndex::GetAccessorForExactTerm(const std::string& term) {
-  PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
-  if (!main_lexicon_->Find(term.c_str(), &posting_list_id)) {
+  return GetExactTermAccessor(term, /*champions_only=*/false);
+}
+
+libtextclassifier3::StatusOr<MainIndex::GetPrefixAccessorResult>
+MainIndex::GetAccessorForPrefixTerm(const std::string& prefix) {
+  return GetPrefixTermAccessor(prefix, /*champions_only=*/false);
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<PostingListAccessor>>
+MainIndex::GetChampionAccessorForExactTerm(const std::string& term) {
+  return GetExactTermAccessor(term, /*champions_only=*/true);
+}
+
+libtextclassifier3::StatusOr<MainIndex::GetPrefixAccessorResult>
+MainIndex::GetChampionAccessorForPrefixTerm(const std::string& prefix) {
+  return GetPrefixTermAccessor(prefix, /*champions_only=*/true);
+}
+
+libtextclassifier3::StatusOr<ChampionRank>
+MainIndex::GetChampionThresholdForExactTerm(const std::string& term) const {
+  ICING_ASSIGN_OR_RETURN(uint32_t tvi, FindExactTerm(term));
+  ICING_ASSIGN_OR_RETURN(ChampionList champion_list,
+                         champion_list_store_->Get(tvi));
+  return champion_list.threshold;
+}
+
+libtextclassifier3::StatusOr<ChampionRank>
+MainIndex::GetChampionThresholdForPrefixTerm(const std::string& prefix) const {
+  ICING_ASSIGN_OR_RETURN(FindPrefixTermResult result, FindPrefixTerm(prefix));
+  if (!result.has_hits) {
+    return absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
+        "Term: %s has no hits in the main lexicon.", prefix.c_str()));
+  }
+  if (pending_backfills_.count(result.tvi) > 0) {
+    // The champion list misses the hits that weren't backfilled yet.
+    return absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
+        "Term: %s has a pending backfill.", prefix.c_str()));
+  }
+  ICING_ASSIGN_OR_RETURN(ChampionList champion_list,
+                         champion_list_store_->Get(result.tvi));
+  return champion_list.threshold;
+}
+
+libtextclassifier3::StatusOr<uint32_t> MainIndex::FindExactTerm(
+    const std::string& term) const {
+  uint32_t tvi;
+  bool found;
+  if (front_coded_lexicon_ != nullptr) {
+    found = front_coded_lexicon_->Find(term, &tvi);
+  } else {
+    PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
+    found = main_lexicon_->Find(term.c_str(), &posting_list_id, &tvi);
+  }
+  if (!found) {
     return absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
         "Term %s is not present in main lexicon.", term.c_str()));
   }
-  ICING_ASSIGN_OR_RETURN(PostingListAccessor accessor,
-                         PostingListAccessor::CreateFromExisting(
-                             flash_index_storage_.get(), posting_list_id));
-  return std::make_unique<PostingListAccessor>(std::move(accessor));
+  return tvi;
 }
 
-libtextclassifier3::StatusOr<MainIndex::GetPrefixAccessorResult>
-MainIndex::GetAccessorForPrefixTerm(const std::string& prefix) {
-  bool exact = false;
+libtextclassifier3::StatusOr<MainIndex::FindPrefixTermResult>
+MainIndex::FindPrefixTerm(const std::string& prefix) const {
   // For prefix indexing: when we are doing a prefix match for
   // "prefix", find the tvi to the equivalent posting list. prefix's
   // own posting list might not exist but its shortest child acts as a proxy.
@@ -174,34 +792,118 @@ MainIndex::GetAccessorForPrefixTerm(const std::string& prefix) {
   // For example, if there are only two hits in the index are prefix hits for
   // "bar" and "bat", then both will appear on a posting list for "ba". "b"
   // won't have a posting list, but "ba" will suffice.
-  IcingDynamicTrie::PropertyReader hits_in_prefix_section(
-      *main_lexicon_, GetHasHitsInPrefixSectionPropertyId());
-  IcingDynamicTrie::Iterator main_itr(*main_lexicon_, prefix.c_str());
+  LexiconTermIterator main_itr(main_lexicon_.get(), front_coded_lexicon_.get(),
+                               prefix);
   if (!main_itr.IsValid()) {
     return absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
         "Term: %s is not present in the main lexicon.", prefix.c_str()));
   }
-  exact = (prefix.length() == strlen(main_itr.GetKey()));
+  LexiconPropertyReader property_reader(main_lexicon_.get(),
+                                        front_coded_lexicon_.get());
+  FindPrefixTermResult result;
+  result.tvi = main_itr.GetValueIndex();
+  result.exact = (prefix.length() == main_itr.GetTerm().length());
+  result.has_hits =
+      result.exact ||
+      property_reader.HasProperty(GetHasHitsInPrefixSectionPropertyId(),
+                                  result.tvi);
+  return result;
+}
+
+PostingListIdentifier MainIndex::GetPostingListId(uint32_t tvi,
+                                                  bool champions_only) const {
+  if (champions_only) {
+    auto champion_list_or = champion_list_store_->Get(tvi);
+    if (champion_list_or.ok()) {
+      return champion_list_or.ValueOrDie().posting_list_id;
+    }
+  }
+  return GetLexiconPostingListId(tvi);
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<PostingListAccessor>>
+MainIndex::GetExactTermAccessor(const std::string& term, bool champions_only) {
+  ICING_ASSIGN_OR_RETURN(uint32_t tvi, FindExactTerm(term));
+  ICING_ASSIGN_OR_RETURN(
+      PostingListAccessor accessor,
+      PostingListAccessor::CreateFromExisting(
+          flash_index_storage_.get(), GetPostingListId(tvi, champions_only)));
+  return std::make_unique<PostingListAccessor>(std::move(accessor));
+}
 
-  if (!exact && !hits_in_prefix_section.HasProperty(main_itr.GetValueIndex())) {
+libtextclassifier3::StatusOr<MainIndex::GetPrefixAccessorResult>
+MainIndex::GetPrefixTermAccessor(const std::string& prefix,
+                                 bool champions_only) {
+  ICING_ASSIGN_OR_RETURN(FindPrefixTermResult result, FindPrefixTerm(prefix));
+  if (!result.has_hits) {
     // Found it, but it doesn't have prefix hits. Exit early. No need to
     // retrieve the posting list because there's nothing there for us.
     return libtextclassifier3::Status::OK;
   }
-  PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
-  memcpy(&posting_list_id, main_itr.GetValue(), sizeof(posting_list_id));
+  if (pending_backfills_.count(result.tvi) > 0) {
+    // The champion list misses the hits that weren't backfilled yet, so the
+    // full posting list is needed.
+    champions_only = false;
+  }
+  PostingListIdentifier posting_list_id =
+      GetPostingListId(result.tvi, champions_only);
+  ICING_ASSIGN_OR_RETURN(std::vector<Hit> pending_backfill_hits,
+                         GetPendingBackfillHits(result.tvi));
+  if (!posting_list_id.is_valid()) {
+    // A branch point that got no hits of its own since its backfill was
+    // deferred. All its hits are in the posting lists of its sources.
+    if (pending_backfill_hits.empty()) {
+      return absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
+          "Term: %s has no posting list.", prefix.c_str()));
+    }
+    GetPrefixAccessorResult accessor_result;
+    ICING_ASSIGN_OR_RETURN(
+        PostingListAccessor pl_accessor,
+        PostingListAccessor::CreateFromExisting(
+            flash_index_storage_.get(),
+            GetPostingListId(pending_backfills_.at(result.tvi),
+                             /*champions_only=*/false)));
+    accessor_result.accessor =
+        std::make_unique<PostingListAccessor>(std::move(pl_accessor));
+    accessor_result.exact = false;
+    accessor_result.pending_backfill_hits = std::move(pending_backfill_hits);
+    return accessor_result;
+  }
   ICING_ASSIGN_OR_RETURN(PostingListAccessor pl_accessor,
                          PostingListAccessor::CreateFromExisting(
                              flash_index_storage_.get(), posting_list_id));
-  GetPrefixAccessorResult result = {
-      std::make_unique<PostingListAccessor>(std::move(pl_accessor)), exact};
-  return result;
+  GetPrefixAccessorResult accessor_result = {
+      std::make_unique<PostingListAccessor>(std::move(pl_accessor)),
+      result.exact, std::move(pending_backfill_hits)};
+  return accessor_result;
+}
+
+libtextclassifier3::StatusOr<std::vector<Hit>>
+MainIndex::GetPendingBackfillHits(uint32_t tvi) const {
+  std::vector<Hit> hits;
+  for (auto itr = pending_backfills_.find(tvi); itr != pending_backfills_.end();
+       itr = pending_backfills_.find(itr->second)) {
+    PostingListIdentifier posting_list_id =
+        GetPostingListId(itr->second, /*champions_only=*/false);
+    if (!posting_list_id.is_valid()) {
+      continue;
+    }
+    ICING_ASSIGN_OR_RETURN(std::vector<Hit> source_hits,
+                           GetAllHits(posting_list_id));
+    for (const Hit& hit : source_hits) {
+      if (hit.is_in_prefix_section()) {
+        hits.push_back(hit);
+      }
+    }
+  }
+  std::sort(hits.begin(), hits.end());
+  return hits;
 }
 
 // TODO(tjbarron): Implement a method PropertyReadersAll.HasAnyProperty().
-bool IsTermInNamespaces(
-    const IcingDynamicTrie::PropertyReadersAll& property_reader,
-    uint32_t value_index, const std::vector<NamespaceId>& namespace_ids) {
+bool IsTermInNamespaces(const LexiconPropertyReader& property_reader,
+                        uint32_t value_index,
+                        const std::vector<NamespaceId>& namespace_ids) {
   if (namespace_ids.empty()) {
     return true;
   }
@@ -220,10 +922,12 @@ MainIndex::FindTermsByPrefix(const std::string& prefix,
                              const std::vector<NamespaceId>& namespace_ids,
                              int num_to_return) {
   // Finds all the terms that start with the given prefix in the lexicon.
-  IcingDynamicTrie::Iterator term_iterator(*main_lexicon_, prefix.c_str());
+  LexiconTermIterator term_iterator(main_lexicon_.get(),
+                                    front_coded_lexicon_.get(), prefix);
 
   // A property reader to help check if a term has some property.
-  IcingDynamicTrie::PropertyReadersAll property_reader(*main_lexicon_);
+  LexiconPropertyReader property_reader(main_lexicon_.get(),
+                                        front_coded_lexicon_.get());
 
   std::vector<TermMetadata> term_metadata_list;
   while (term_iterator.IsValid() && term_metadata_list.size() < num_to_return) {
@@ -235,8 +939,8 @@ MainIndex::FindTermsByPrefix(const std::string& prefix,
       term_iterator.Advance();
       continue;
     }
-    PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
-    memcpy(&posting_list_id, term_iterator.GetValue(), sizeof(posting_list_id));
+    PostingListIdentifier posting_list_id =
+        GetLexiconPostingListId(term_value_index);
     // Getting the actual hit count would require reading the entire posting
     // list chain. We take an approximation to avoid all of those IO ops.
     // Because we are not reading the posting lists, it is impossible to
@@ -246,7 +950,8 @@ MainIndex::FindTermsByPrefix(const std::string& prefix,
     int approx_hit_count = IndexBlock::ApproximateFullPostingListHitsForBlock(
         flash_index_storage_->block_size(),
         posting_list_id.posting_list_index_bits());
-    term_metadata_list.emplace_back(term_iterator.GetKey(), approx_hit_count);
+    term_metadata_list.emplace_back(std::string(term_iterator.GetTerm()),
+                                    approx_hit_count);
 
     term_iterator.Advance();
   }
@@ -260,6 +965,243 @@ MainIndex::FindTermsByPrefix(const std::string& prefix,
   return term_metadata_list;
 }
 
+libtextclassifier3::StatusOr<MainIndex::DeadTerms> MainIndex::FindDeadTerms(
+    const std::function<bool(DocumentId)>& is_document_live) const {
+  // The lexicon is iterated in order, so the terms that extend a term come
+  // right after it. The terms that the current term extends are kept on a
+  // stack until a term that doesn't extend them comes up. By then, it is known
+  // how many branches below them still hold terms.
+  struct OpenTerm {
+    std::string term;
+    uint32_t tvi;
+    bool live;
+    // The number of distinct characters following term in the kept terms that
+    // extend it, and the last one of them.
+    int num_kept_branches;
+    char last_kept_branch;
+  };
+  std::vector<OpenTerm> open_terms;
+  DeadTerms dead_terms;
+  dead_terms.version = version_;
+  std::unordered_set<uint32_t>& dead_tvis = dead_terms.tvis;
+  auto close_term = [&open_terms, &dead_tvis]() {
+    OpenTerm closed = std::move(open_terms.back());
+    open_terms.pop_back();
+    bool keep = closed.live || closed.num_kept_branches > 1;
+    if (!keep) {
+      dead_tvis.insert(closed.tvi);
+    }
+    if ((keep || closed.num_kept_branches > 0) && !open_terms.empty()) {
+      OpenTerm& parent = open_terms.back();
+      char branch = closed.term[parent.term.length()];
+      if (parent.num_kept_branches == 0 || parent.last_kept_branch != branch) {
+        ++parent.num_kept_branches;
+        parent.last_kept_branch = branch;
+      }
+    }
+  };
+
+  std::unordered_set<uint32_t> pending_backfill_tvis;
+  for (const auto& [branch_point_tvi, source_tvi] : pending_backfills_) {
+    pending_backfill_tvis.insert(branch_point_tvi);
+    pending_backfill_tvis.insert(source_tvi);
+  }
+  for (LexiconTermIterator term_iterator(main_lexicon_.get(),
+                                         front_coded_lexicon_.get(),
+                                         /*prefix=*/"");
+       term_iterator.IsValid(); term_iterator.Advance()) {
+    std::string_view term = term_iterator.GetTerm();
+    while (!open_terms.empty() &&
+           term.compare(0, open_terms.back().term.length(),
+                        open_terms.back().term) != 0) {
+      close_term();
+    }
+    uint32_t tvi = term_iterator.GetValueIndex();
+    bool live = pending_backfill_tvis.count(tvi) > 0;
+    if (!live) {
+      ICING_ASSIGN_OR_RETURN(
+          live, HasHitsOfLiveDocuments(
+                    GetPostingListId(tvi, /*champions_only=*/false),
+                    is_document_live));
+    }
+    open_terms.push_back({std::string(term), tvi, live,
+                          /*num_kept_branches=*/0,
+                          /*last_kept_branch=*/'\0'});
+  }
+  while (!open_terms.empty()) {
+    close_term();
+  }
+  return dead_terms;
+}
+
+libtextclassifier3::StatusOr<int> MainIndex::DeleteDeadTerms(
+    DeadTerms dead_terms) {
+  if (dead_terms.version != version_) {
+    return absl_ports::FailedPreconditionError(
+        "Main index changed since the dead terms were found.");
+  }
+  const std::unordered_set<uint32_t>& dead_tvis = dead_terms.tvis;
+  if (dead_tvis.empty()) {
+    return 0;
+  }
+
+  // The posting lists of the dead terms are only freed once the lexicon that
+  // refers to them is replaced for good. Otherwise a failure or a crash in
+  // between would leave terms behind whose posting lists get reused.
+  std::vector<PostingListIdentifier> posting_lists_to_free;
+  for (uint32_t tvi : dead_tvis) {
+    posting_lists_to_free.push_back(GetLexiconPostingListId(tvi));
+    auto champion_list_or = champion_list_store_->Get(tvi);
+    if (champion_list_or.ok()) {
+      posting_lists_to_free.push_back(
+          champion_list_or.ValueOrDie().posting_list_id);
+    }
+  }
+  // The compacted lexicon is persisted as matching the posting lists on disk,
+  // so those have to be up to date first.
+  ICING_RETURN_IF_ERROR(PersistToDisk());
+  ICING_RETURN_IF_ERROR(CompactLexicon(dead_tvis));
+  for (PostingListIdentifier posting_list_id : posting_lists_to_free) {
+    ICING_RETURN_IF_ERROR(FreePostingListChain(posting_list_id));
+  }
+  ICING_RETURN_IF_ERROR(PersistToDisk());
+  return dead_tvis.size();
+}
+
+libtextclassifier3::Status MainIndex::CompactLexicon(
+    const std::unordered_set<uint32_t>& tvis_to_drop) {
+  uint32_t old_generation = lexicon_generation_;
+  uint32_t new_generation = old_generation + 1;
+  auto compacted_or = WriteCompactedLexicon(tvis_to_drop, new_generation);
+  libtextclassifier3::Status status = compacted_or.status();
+  if (status.ok()) {
+    // Everything the new generation needs is on disk, so this is where a crash
+    // stops falling back to the old one.
+    status = WriteLexiconGeneration(*filesystem_, index_directory_,
+                                    new_generation);
+  }
+  if (!status.ok()) {
+    libtextclassifier3::Status delete_status =
+        DeleteLexiconFiles(new_generation);
+    if (!delete_status.ok()) {
+      ICING_LOG(WARNING) << "Failed to delete partially compacted lexicon: "
+                         << delete_status.error_message();
+    }
+    return status;
+  }
+
+  CompactedLexicon compacted = std::move(compacted_or).ValueOrDie();
+  version_ = NewVersion();
+  main_lexicon_ = std::move(compacted.lexicon);
+  front_coded_lexicon_ = std::move(compacted.front_coded_lexicon);
+  front_coded_lexicon_dirty_ = false;
+  champion_list_store_ = std::move(compacted.champion_list_store);
+  pending_backfills_ = std::move(compacted.pending_backfills);
+  SetLexiconGeneration(new_generation);
+
+  // Init deletes them if this fails.
+  libtextclassifier3::Status delete_status = DeleteLexiconFiles(old_generation);
+  if (!delete_status.ok()) {
+    ICING_LOG(WARNING) << "Failed to delete old lexicon: "
+                       << delete_status.error_message();
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<MainIndex::CompactedLexicon>
+MainIndex::WriteCompactedLexicon(
+    const std::unordered_set<uint32_t>& tvis_to_drop,
+    uint32_t generation) const {
+  CompactedLexicon compacted;
+  std::unordered_map<uint32_t, uint32_t> old_to_new_tvi;
+  if (front_coded_lexicon_ != nullptr) {
+    FrontCodedLexicon::Builder builder(sizeof(PostingListIdentifier));
+    std::vector<uint32_t> new_term_indices(front_coded_lexicon_->size(),
+                                           kInvalidTermIndex);
+    uint32_t new_term_index = 0;
+    for (FrontCodedLexicon::Iterator itr =
+             front_coded_lexicon_->GetIterator(/*prefix=*/"");
+         itr.IsValid(); itr.Advance()) {
+      if (tvis_to_drop.count(itr.GetTermIndex()) > 0) {
+        continue;
+      }
+      ICING_RETURN_IF_ERROR(builder.Add(itr.GetTerm(), itr.GetValue()));
+      old_to_new_tvi[itr.GetTermIndex()] = new_term_index;
+      new_term_indices[itr.GetTermIndex()] = new_term_index++;
+    }
+    compacted.front_coded_lexicon = builder.Build();
+    CopyFrontCodedProperties(new_term_indices,
+                             compacted.front_coded_lexicon.get());
+    ICING_RETURN_IF_ERROR(compacted.front_coded_lexicon->Write(
+        *filesystem_, MakeLexiconFilename(index_directory_,
+                                          kFrontCodedLexiconFilename,
+                                          generation)));
+  } else {
+    ICING_ASSIGN_OR_RETURN(
+        compacted.lexicon,
+        OpenLexicon(MakeLexiconFilename(index_directory_, kLexiconFilename,
+                                        generation)));
+    if (!main_lexicon_->Compact(
+            DropTermsValueMap(main_lexicon_.get(), &tvis_to_drop),
+            compacted.lexicon.get(), &old_to_new_tvi) ||
+        !compacted.lexicon->Sync()) {
+      return absl_ports::InternalError("Failed to compact lexicon trie");
+    }
+  }
+
+  ICING_ASSIGN_OR_RETURN(
+      compacted.champion_list_store,
+      ChampionListStore::Create(
+          filesystem_,
+          MakeLexiconFilename(index_directory_, kChampionListsFilePrefix,
+                              generation),
+          last_added_document_id()));
+  ICING_RETURN_IF_ERROR(compacted.champion_list_store->Clear(
+      champion_list_options_.champion_list_size));
+  for (const auto& [old_tvi, new_tvi] : old_to_new_tvi) {
+    auto champion_list_or = champion_list_store_->Get(old_tvi);
+    if (champion_list_or.ok()) {
+      ICING_RETURN_IF_ERROR(compacted.champion_list_store->Put(
+          new_tvi, champion_list_or.ValueOrDie()));
+    }
+  }
+  ICING_RETURN_IF_ERROR(
+      compacted.champion_list_store->PersistToDisk(last_added_document_id()));
+
+  for (const auto& [branch_point_tvi, source_tvi] : pending_backfills_) {
+    compacted.pending_backfills[old_to_new_tvi[branch_point_tvi]] =
+        old_to_new_tvi[source_tvi];
+  }
+  ICING_RETURN_IF_ERROR(WritePendingBackfills(
+      MakeLexiconFilename(index_directory_, kPendingBackfillsFilename,
+                          generation),
+      compacted.pending_backfills));
+  return compacted;
+}
+
+libtextclassifier3::StatusOr<bool> MainIndex::HasHitsOfLiveDocuments(
+    PostingListIdentifier posting_list_id,
+    const std::function<bool(DocumentId)>& is_document_live) const {
+  if (!posting_list_id.is_valid()) {
+    return false;
+  }
+  ICING_ASSIGN_OR_RETURN(
+      PostingListAccessor pl_accessor,
+      PostingListAccessor::CreateFromExisting(flash_index_storage_.get(),
+                                              posting_list_id));
+  ICING_ASSIGN_OR_RETURN(std::vector<Hit> hits,
+                         pl_accessor.GetNextHitsBatch());
+  while (!hits.empty()) {
+    for (const Hit& hit : hits) {
+      if (is_document_live(hit.document_id())) {
+        return true;
+      }
+    }
+    ICING_ASSIGN_OR_RETURN(hits, pl_accessor.GetNextHitsBatch());
+  }
+  return false;
+}
+
 libtextclassifier3::StatusOr<MainIndex::LexiconMergeOutputs>
 MainIndex::AddBackfillBranchPoints(const IcingDynamicTrie& other_lexicon) {
   // Maps new branching points in main lexicon to the term such that
@@ -302,6 +1244,9 @@ MainIndex::AddBackfillBranchPoints(const IcingDynamicTrie& other_lexicon) {
                                &new_key)) {
       return absl_ports::InternalError("Could not insert branching prefix");
     }
+    if (new_key) {
+      ++outputs.num_new_branch_points;
+    }
 
     // Backfills only contain prefix hits by default. So set these here but
     // could be overridden when adding hits from the other index later.
@@ -324,13 +1269,17 @@ MainIndex::AddTerms(const IcingDynamicTrie& other_lexicon,
   for (IcingDynamicTrie::Iterator other_term_itr(other_lexicon, /*prefix=*/"");
        other_term_itr.IsValid(); other_term_itr.Advance()) {
     uint32_t new_main_tvi;
+    bool new_key;
     PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
     if (!main_lexicon_->Insert(other_term_itr.GetKey(), &posting_list_id,
                                &new_main_tvi,
-                               /*replace=*/false)) {
+                               /*replace=*/false, &new_key)) {
       return absl_ports::InternalError(absl_ports::StrCat(
           "Could not insert term: ", other_term_itr.GetKey()));
     }
+    if (new_key) {
+      ++outputs.num_new_terms;
+    }
 
     // Copy the properties from the other lexicon over to the main lexicon.
     uint32_t other_tvi = other_term_itr.GetValueIndex();
@@ -390,6 +1339,9 @@ MainIndex::AddBranchPoints(const IcingDynamicTrie& other_lexicon,
         return absl_ports::InternalError(
             absl_ports::StrCat("Could not insert prefix: ", prefix));
       }
+      if (new_key) {
+        ++outputs.num_new_branch_points;
+      }
 
       // Prefix tvi will have hits in prefix section.
       if (!main_lexicon_->SetProperty(prefix_tvi,
@@ -454,13 +1406,365 @@ bool MainIndex::CopyProperties(
   return true;
 }
 
+void MainIndex::CopyFrontCodedProperties(
+    const std::vector<uint32_t>& new_term_indices,
+    FrontCodedLexicon* new_lexicon) const {
+  for (uint32_t property_id = 0;
+       property_id < front_coded_lexicon_->num_properties(); ++property_id) {
+    front_coded_lexicon_->ForEachTermWithProperty(
+        property_id, [&](uint32_t term_index) {
+          if (new_term_indices[term_index] != kInvalidTermIndex) {
+            new_lexicon->SetProperty(new_term_indices[term_index],
+                                     property_id);
+          }
+        });
+  }
+}
+
+libtextclassifier3::Status MainIndex::ReplaceFrontCodedLexicon(
+    std::unique_ptr<FrontCodedLexicon> new_lexicon,
+    const std::vector<uint32_t>& new_term_indices) {
+  CopyFrontCodedProperties(new_term_indices, new_lexicon.get());
+
+  if (champion_list_options_.champion_list_size > 0) {
+    std::vector<std::pair<uint32_t, ChampionList>> champion_lists;
+    for (uint32_t term_index = 0; term_index < new_term_indices.size();
+         ++term_index) {
+      if (new_term_indices[term_index] == kInvalidTermIndex) {
+        continue;
+      }
+      auto champion_list_or = champion_list_store_->Get(term_index);
+      if (champion_list_or.ok()) {
+        champion_lists.emplace_back(new_term_indices[term_index],
+                                    std::move(champion_list_or).ValueOrDie());
+      }
+    }
+    ICING_RETURN_IF_ERROR(champion_list_store_->Clear(
+        champion_list_options_.champion_list_size));
+    for (const auto& [tvi, champion_list] : champion_lists) {
+      ICING_RETURN_IF_ERROR(champion_list_store_->Put(tvi, champion_list));
+    }
+  }
+
+  std::map<uint32_t, uint32_t> pending_backfills;
+  for (const auto& [branch_point_tvi, source_tvi] : pending_backfills_) {
+    pending_backfills[new_term_indices[branch_point_tvi]] =
+        new_term_indices[source_tvi];
+  }
+  pending_backfills_ = std::move(pending_backfills);
+
+  // The lexicon and the pending backfills that refer to its term indices are
+  // both written by the next PersistToDisk.
+  front_coded_lexicon_ = std::move(new_lexicon);
+  front_coded_lexicon_dirty_ = true;
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<MainIndex::LexiconMergeOutputs>
+MainIndex::MergeIntoFrontCodedLexicon(const IcingDynamicTrie& other_lexicon) {
+  const FrontCodedLexicon& lexicon = *front_coded_lexicon_;
+  IcingDynamicTrie::PropertyReadersAll other_prop_readers(other_lexicon);
+  auto other_has_prefix_hits = [&other_prop_readers](uint32_t other_tvi) {
+    return other_prop_readers.HasProperty(
+        GetHasHitsInPrefixSectionPropertyId(), other_tvi);
+  };
+
+  // Finds the lite terms and the backfill branch points, like
+  // AddBackfillBranchPoints. A new term creates a branch where it diverges
+  // from its closest neighbors in the lexicon, unless the lexicon already
+  // branches there.
+  NewFrontCodedTerms new_terms;
+  std::vector<std::pair<std::string, uint32_t>> backfill_points;
+  for (IcingDynamicTrie::Iterator other_term_itr(other_lexicon, /*prefix=*/"");
+       other_term_itr.IsValid(); other_term_itr.Advance()) {
+    std::string term = other_term_itr.GetKey();
+    new_terms[term].other_tvi = other_term_itr.GetValueIndex();
+    uint32_t lower = lexicon.GetPrefixRange(term).first;
+    if (lower < lexicon.size() && lexicon.GetTerm(lower) == term) {
+      continue;
+    }
+    int prefix_len = 0;
+    if (lower > 0) {
+      prefix_len = CommonPrefixLength(term, lexicon.GetTerm(lower - 1));
+    }
+    if (lower < lexicon.size()) {
+      prefix_len = std::max(prefix_len,
+                            CommonPrefixLength(term, lexicon.GetTerm(lower)));
+    }
+    if (prefix_len <= 0) {
+      continue;
+    }
+    std::string_view prefix(term.data(), prefix_len);
+    auto [begin, end] = lexicon.GetPrefixRange(prefix);
+    if (end - begin >= 2 &&
+        (lexicon.GetTerm(begin) == prefix ||
+         CommonPrefixLength(lexicon.GetTerm(begin),
+                            lexicon.GetTerm(end - 1)) == prefix_len)) {
+      // Already a branch point.
+      continue;
+    }
+    if (prefix_len < term.length()) {
+      prefix_len = i18n_utils::SafeTruncateUtf8Length(term.c_str(), prefix_len);
+      if (prefix_len <= 0) {
+        continue;
+      }
+      prefix = std::string_view(term.data(), prefix_len);
+    }
+
+    // Like FindShortestValidTermWithPrefixHits, the first term with a posting
+    // list is the one to backfill from.
+    for (FrontCodedLexicon::Iterator itr = lexicon.GetIterator(prefix);
+         itr.IsValid(); itr.Advance()) {
+      PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
+      memcpy(&posting_list_id, itr.GetValue(), sizeof(posting_list_id));
+      if (!posting_list_id.is_valid()) {
+        continue;
+      }
+      if (itr.GetTerm().length() != prefix.length() &&
+          lexicon.HasProperty(itr.GetTermIndex(),
+                              GetHasHitsInPrefixSectionPropertyId())) {
+        backfill_points.emplace_back(prefix, itr.GetTermIndex());
+      }
+      break;
+    }
+  }
+  for (const auto& [prefix, source_term_index] : backfill_points) {
+    new_terms[prefix].backfill_source = source_term_index;
+  }
+
+  // Finds the branch points above the lite terms with hits in prefix
+  // sections, like AddBranchPoints. A term branches at the depth d along the
+  // path of another term exactly if d is the length of their longest common
+  // prefix. Those lengths are the running minima of the common prefix
+  // lengths of neighboring terms, going left and going right.
+  std::vector<int> neighbor_prefix_lengths;
+  std::vector<std::pair<size_t, NewFrontCodedTerms::iterator>> prefix_terms;
+  std::string previous_term;
+  ForEachMergedTerm(
+      lexicon, new_terms,
+      [&](std::string_view term, int64_t term_index,
+          NewFrontCodedTerms::iterator new_term_itr) {
+        neighbor_prefix_lengths.push_back(
+            CommonPrefixLength(previous_term, term));
+        if (new_term_itr != new_terms.end() &&
+            new_term_itr->second.other_tvi >= 0 &&
+            other_has_prefix_hits(new_term_itr->second.other_tvi)) {
+          prefix_terms.emplace_back(neighbor_prefix_lengths.size() - 1,
+                                    new_term_itr);
+        }
+        previous_term.assign(term);
+      });
+  std::vector<std::vector<int>> branch_depths(prefix_terms.size());
+  std::vector<int> running_minima;
+  for (size_t i = 0, next = 0; i < neighbor_prefix_lengths.size(); ++i) {
+    if (i > 0) {
+      while (!running_minima.empty() &&
+             running_minima.back() >= neighbor_prefix_lengths[i]) {
+        running_minima.pop_back();
+      }
+      running_minima.push_back(neighbor_prefix_lengths[i]);
+    }
+    if (next < prefix_terms.size() && prefix_terms[next].first == i) {
+      branch_depths[next++] = running_minima;
+    }
+  }
+  running_minima.clear();
+  for (size_t i = neighbor_prefix_lengths.size(), next = prefix_terms.size();
+       i-- > 0;) {
+    if (i + 1 < neighbor_prefix_lengths.size()) {
+      while (!running_minima.empty() &&
+             running_minima.back() >= neighbor_prefix_lengths[i + 1]) {
+        running_minima.pop_back();
+      }
+      running_minima.push_back(neighbor_prefix_lengths[i + 1]);
+    }
+    if (next > 0 && prefix_terms[next - 1].first == i) {
+      --next;
+      branch_depths[next].insert(branch_depths[next].end(),
+                                 running_minima.begin(), running_minima.end());
+    }
+  }
+  for (size_t i = 0; i < prefix_terms.size(); ++i) {
+    const std::string& term = prefix_terms[i].second->first;
+    std::vector<int>& prefix_lengths = prefix_terms[i].second->second
+                                           .prefix_lengths;
+    for (int depth : branch_depths[i]) {
+      if (depth > 0 && depth < term.length()) {
+        prefix_lengths.push_back(
+            i18n_utils::SafeTruncateUtf8Length(term.c_str(), depth));
+      }
+    }
+    std::sort(prefix_lengths.begin(), prefix_lengths.end());
+    prefix_lengths.erase(
+        std::unique(prefix_lengths.begin(), prefix_lengths.end()),
+        prefix_lengths.end());
+    if (!prefix_lengths.empty() && prefix_lengths.front() == 0) {
+      prefix_lengths.erase(prefix_lengths.begin());
+    }
+  }
+  for (const auto& [position, new_term_itr] : prefix_terms) {
+    for (int prefix_length : new_term_itr->second.prefix_lengths) {
+      new_terms[new_term_itr->first.substr(0, prefix_length)]
+          .is_prefix_branch_point = true;
+    }
+  }
+
+  // Rebuilds the lexicon with the new terms, which start out without posting
+  // lists.
+  FrontCodedLexicon::Builder builder(sizeof(PostingListIdentifier));
+  std::vector<uint32_t> new_term_indices(lexicon.size(), kInvalidTermIndex);
+  uint32_t num_terms = 0;
+  libtextclassifier3::Status status;
+  PostingListIdentifier invalid_posting_list_id =
+      PostingListIdentifier::kInvalid;
+  ForEachMergedTerm(
+      lexicon, new_terms,
+      [&](std::string_view term, int64_t term_index,
+          NewFrontCodedTerms::iterator new_term_itr) {
+        if (!status.ok()) {
+          return;
+        }
+        if (term_index >= 0) {
+          status = builder.Add(term, lexicon.GetValueAtIndex(term_index));
+          new_term_indices[term_index] = num_terms;
+        } else {
+          status = builder.Add(term, &invalid_posting_list_id);
+        }
+        if (new_term_itr != new_terms.end()) {
+          new_term_itr->second.existed = term_index >= 0;
+          new_term_itr->second.term_index = num_terms;
+        }
+        ++num_terms;
+      });
+  ICING_RETURN_IF_ERROR(status);
+  // Term indices are used as main tvis, so they must fit in a term id.
+  if (num_terms >
+      IcingDynamicTrie::max_value_index(IcingDynamicTrie::Options())) {
+    return absl_ports::ResourceExhaustedError(
+        "Too many terms in the main lexicon");
+  }
+  ICING_RETURN_IF_ERROR(
+      ReplaceFrontCodedLexicon(builder.Build(), new_term_indices));
+
+  // Sets the properties of the new terms and fills in the outputs, like
+  // AddBackfillBranchPoints, AddTerms and AddBranchPoints.
+  LexiconMergeOutputs outputs;
+  auto record_block_index = [this, &outputs](uint32_t tvi) {
+    PostingListIdentifier posting_list_id = GetLexiconPostingListId(tvi);
+    if (posting_list_id.block_index() != kInvalidBlockIndex) {
+      outputs.main_tvi_to_block_index[tvi] = posting_list_id.block_index();
+    }
+  };
+  for (const auto& [term, new_term] : new_terms) {
+    uint32_t tvi = new_term.term_index;
+    bool is_backfill_point = new_term.backfill_source >= 0;
+    bool is_lite_term = new_term.other_tvi >= 0;
+    if (is_backfill_point) {
+      front_coded_lexicon_->SetProperty(tvi, GetHasNoExactHitsPropertyId());
+      front_coded_lexicon_->SetProperty(tvi,
+                                        GetHasHitsInPrefixSectionPropertyId());
+      outputs.backfill_map[tvi] = new_term_indices[new_term.backfill_source];
+      if (!new_term.existed) {
+        ++outputs.num_new_branch_points;
+      }
+    }
+    if (is_lite_term) {
+      uint32_t other_tvi = new_term.other_tvi;
+      for (uint32_t property_id = 0; property_id < other_prop_readers.size();
+           ++property_id) {
+        bool has_property =
+            other_prop_readers.HasProperty(property_id, other_tvi);
+        // HasNoExactHitsProperty is an inverse. See CopyProperties.
+        if (property_id == GetHasNoExactHitsPropertyId()) {
+          if (!has_property) {
+            front_coded_lexicon_->ClearProperty(tvi, property_id);
+          }
+        } else if (has_property) {
+          front_coded_lexicon_->SetProperty(tvi, property_id);
+        }
+      }
+      outputs.other_tvi_to_main_tvi.emplace(other_tvi, tvi);
+      if (!new_term.existed && !is_backfill_point) {
+        ++outputs.num_new_terms;
+      }
+    }
+    if (new_term.is_prefix_branch_point) {
+      front_coded_lexicon_->SetProperty(tvi,
+                                        GetHasHitsInPrefixSectionPropertyId());
+      if (!new_term.existed && !is_backfill_point && !is_lite_term) {
+        front_coded_lexicon_->SetProperty(tvi, GetHasNoExactHitsPropertyId());
+        ++outputs.num_new_branch_points;
+      }
+    }
+    if (is_lite_term || new_term.is_prefix_branch_point) {
+      record_block_index(tvi);
+    }
+  }
+  for (const auto& [position, new_term_itr] : prefix_terms) {
+    const NewFrontCodedTerm& new_term = new_term_itr->second;
+    if (new_term.prefix_lengths.empty()) {
+      continue;
+    }
+    int buf_start = outputs.prefix_tvis_buf.size();
+    for (int prefix_length : new_term.prefix_lengths) {
+      outputs.prefix_tvis_buf.push_back(
+          new_terms.at(new_term_itr->first.substr(0, prefix_length))
+              .term_index);
+    }
+    outputs.other_tvi_to_prefix_main_tvis[new_term.other_tvi] = {
+        buf_start, outputs.prefix_tvis_buf.size() - buf_start};
+  }
+  return outputs;
+}
+
 libtextclassifier3::Status MainIndex::AddHits(
     const TermIdCodec& term_id_codec,
     std::unordered_map<uint32_t, uint32_t>&& backfill_map,
-    std::vector<TermIdHitPair>&& hits, DocumentId last_added_document_id) {
+    std::vector<TermIdHitPair>&& hits, DocumentId last_added_document_id,
+    IndexMergeStatsProto* merge_stats) {
+  version_ = NewVersion();
+  flash_index_storage_->StartCounting();
+  int64_t num_backfill_hits = 0;
+  int64_t backfill_bytes = 0;
+  libtextclassifier3::Status status = AddHitsAndBackfills(
+      term_id_codec, std::move(backfill_map), std::move(hits),
+      &num_backfill_hits, &backfill_bytes);
+  flash_index_storage_->StopCounting();
+  ICING_RETURN_IF_ERROR(status);
+  flash_index_storage_->set_last_indexed_docid(last_added_document_id);
+  if (merge_stats != nullptr) {
+    const FlashIndexStorage::Counters& counters =
+        flash_index_storage_->counters();
+    merge_stats->set_num_backfill_hits(num_backfill_hits);
+    merge_stats->set_backfill_bytes(backfill_bytes);
+    merge_stats->set_num_pending_backfills(pending_backfills_.size());
+    merge_stats->set_num_posting_lists_allocated(
+        counters.num_posting_lists_allocated);
+    merge_stats->set_num_posting_lists_freed(counters.num_posting_lists_freed);
+    merge_stats->set_num_posting_lists_moved(counters.num_posting_lists_moved);
+    merge_stats->set_num_blocks_touched(counters.num_blocks_touched);
+    merge_stats->set_posting_list_bytes_allocated(
+        counters.posting_list_bytes_allocated);
+    merge_stats->set_bytes_written(counters.bytes_written);
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::AddHitsAndBackfills(
+    const TermIdCodec& term_id_codec,
+    std::unordered_map<uint32_t, uint32_t>&& backfill_map,
+    std::vector<TermIdHitPair>&& hits, int64_t* num_backfill_hits,
+    int64_t* backfill_bytes) {
+  if (max_backfill_hits_per_merge_ >= 0) {
+    // Defer the backfills so that a new branch point above a large subtree
+    // doesn't make this merge copy all of its hits.
+    for (const auto& [branch_point_tvi, source_tvi] : backfill_map) {
+      pending_backfills_[branch_point_tvi] = source_tvi;
+    }
+    backfill_map.clear();
+  }
   if (hits.empty()) {
-    flash_index_storage_->set_last_indexed_docid(last_added_document_id);
-    return libtextclassifier3::Status::OK;
+    return MaterializePendingBackfills(num_backfill_hits, backfill_bytes);
   }
   uint32_t cur_term_id = hits[0].term_id();
   ICING_ASSIGN_OR_RETURN(TermIdCodec::DecodedTermInfo cur_decoded_term,
@@ -480,14 +1784,16 @@ libtextclassifier3::Status MainIndex::AddHits(
         PostingListIdentifier::kInvalid;
     auto itr = backfill_map.find(cur_decoded_term.tvi);
     if (itr != backfill_map.end()) {
-      const void* value = main_lexicon_->GetValueAtIndex(itr->second);
-      memcpy(&backfill_posting_list_id, value,
-             sizeof(backfill_posting_list_id));
+      backfill_posting_list_id = GetLexiconPostingListId(itr->second);
       backfill_map.erase(itr);
     }
-    ICING_RETURN_IF_ERROR(AddHitsForTerm(cur_decoded_term.tvi,
-                                         backfill_posting_list_id,
-                                         &hits[k_start], k_end - k_start));
+    ICING_RETURN_IF_ERROR(AddHitsForTerm(
+        cur_decoded_term.tvi, backfill_posting_list_id, &hits[k_start],
+        k_end - k_start, num_backfill_hits));
+    if (champion_list_options_.champion_list_size > 0) {
+      ICING_RETURN_IF_ERROR(UpdateChampionList(
+          cur_decoded_term.tvi, &hits[k_start], k_end - k_start));
+    }
     cur_term_id = term_id;
     ICING_ASSIGN_OR_RETURN(cur_decoded_term,
                            term_id_codec.DecodeTermInfo(cur_term_id));
@@ -499,33 +1805,130 @@ libtextclassifier3::Status MainIndex::AddHits(
                                                  backfill_map.size());
   for (auto other_tvi_main_tvi_pair : backfill_map) {
     PostingListIdentifier backfill_posting_list_id =
-        PostingListIdentifier::kInvalid;
-    memcpy(&backfill_posting_list_id,
-           main_lexicon_->GetValueAtIndex(other_tvi_main_tvi_pair.second),
-           sizeof(backfill_posting_list_id));
+        GetLexiconPostingListId(other_tvi_main_tvi_pair.second);
     ICING_ASSIGN_OR_RETURN(
         PostingListAccessor hit_accum,
         PostingListAccessor::Create(flash_index_storage_.get()));
-    ICING_RETURN_IF_ERROR(
+    ICING_ASSIGN_OR_RETURN(
+        int num_hits,
         AddPrefixBackfillHits(backfill_posting_list_id, &hit_accum));
+    *num_backfill_hits += num_hits;
     PostingListAccessor::FinalizeResult result =
         PostingListAccessor::Finalize(std::move(hit_accum));
     if (result.id.is_valid()) {
-      main_lexicon_->SetValueAtIndex(other_tvi_main_tvi_pair.first, &result.id);
+      SetLexiconPostingListId(other_tvi_main_tvi_pair.first, result.id);
+    }
+    if (champion_list_options_.champion_list_size > 0) {
+      ICING_RETURN_IF_ERROR(UpdateChampionList(other_tvi_main_tvi_pair.first,
+                                               /*new_hits=*/nullptr,
+                                               /*len=*/0));
+    }
+  }
+  // Eager backfills only copy hits.
+  *backfill_bytes += *num_backfill_hits * kHitBytes;
+
+  return MaterializePendingBackfills(num_backfill_hits, backfill_bytes);
+}
+
+libtextclassifier3::Status MainIndex::MaterializePendingBackfills(
+    int64_t* num_backfill_hits, int64_t* backfill_bytes) {
+  // A branch point can only be backfilled once its source has all its hits,
+  // so keep going over the pending backfills as long as some got done.
+  bool materialized_any = true;
+  while (materialized_any) {
+    materialized_any = false;
+    for (auto itr = pending_backfills_.begin();
+         itr != pending_backfills_.end();) {
+      if (max_backfill_hits_per_merge_ >= 0 &&
+          *num_backfill_hits >= max_backfill_hits_per_merge_) {
+        return libtextclassifier3::Status::OK;
+      }
+      if (pending_backfills_.count(itr->second) > 0) {
+        ++itr;
+        continue;
+      }
+      ICING_ASSIGN_OR_RETURN(
+          int num_hits,
+          MaterializeBackfill(itr->first, itr->second, backfill_bytes));
+      *num_backfill_hits += num_hits;
+      itr = pending_backfills_.erase(itr);
+      materialized_any = true;
     }
   }
-  flash_index_storage_->set_last_indexed_docid(last_added_document_id);
   return libtextclassifier3::Status::OK;
 }
 
+libtextclassifier3::StatusOr<int> MainIndex::MaterializeBackfill(
+    uint32_t branch_point_tvi, uint32_t source_tvi, int64_t* backfill_bytes) {
+  // The branch point got hits of its own since the backfill was deferred, some
+  // of which may also be in the source. Merge both into a new posting list.
+  std::vector<Hit> hits;
+  PostingListIdentifier posting_list_id =
+      GetPostingListId(branch_point_tvi, /*champions_only=*/false);
+  if (posting_list_id.is_valid()) {
+    ICING_ASSIGN_OR_RETURN(hits, GetAllHits(posting_list_id));
+  }
+  size_t num_own_hits = hits.size();
+  PostingListIdentifier source_posting_list_id =
+      GetPostingListId(source_tvi, /*champions_only=*/false);
+  if (source_posting_list_id.is_valid()) {
+    ICING_ASSIGN_OR_RETURN(std::vector<Hit> source_hits,
+                           GetAllHits(source_posting_list_id));
+    for (const Hit& hit : source_hits) {
+      if (!hit.is_in_prefix_section()) {
+        continue;
+      }
+      // A backfill hit is a prefix hit in a prefix section.
+      hits.push_back(Hit(hit.section_id(), hit.document_id(),
+                         hit.term_frequency(), /*is_in_prefix_section=*/true,
+                         /*is_prefix_hit=*/true));
+    }
+  }
+  int num_backfill_hits = hits.size() - num_own_hits;
+
+  // Hits have to be prepended in descending order.
+  std::sort(hits.begin(), hits.end());
+  hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+  if (hits.empty()) {
+    return 0;
+  }
+  ICING_ASSIGN_OR_RETURN(
+      PostingListAccessor pl_accessor,
+      PostingListAccessor::Create(flash_index_storage_.get()));
+  for (auto itr = hits.rbegin(); itr != hits.rend(); ++itr) {
+    ICING_RETURN_IF_ERROR(pl_accessor.PrependHit(*itr));
+  }
+  PostingListAccessor::FinalizeResult result =
+      PostingListAccessor::Finalize(std::move(pl_accessor));
+  ICING_RETURN_IF_ERROR(result.status);
+  SetLexiconPostingListId(branch_point_tvi, result.id);
+  *backfill_bytes += hits.size() * kHitBytes;
+
+  if (posting_list_id.is_valid()) {
+    libtextclassifier3::Status status = FreePostingListChain(posting_list_id);
+    if (!status.ok()) {
+      ICING_LOG(WARNING) << "Leaked posting lists of branch point: "
+                         << status.error_message();
+    }
+  }
+  if (champion_list_options_.champion_list_size > 0) {
+    // The champion list was built from the incomplete posting list. Build it
+    // again from scratch.
+    ICING_RETURN_IF_ERROR(RemoveChampionList(branch_point_tvi));
+    ICING_RETURN_IF_ERROR(UpdateChampionList(branch_point_tvi,
+                                             /*new_hits=*/nullptr,
+                                             /*len=*/0));
+  }
+  return num_backfill_hits;
+}
+
 libtextclassifier3::Status MainIndex::AddHitsForTerm(
     uint32_t tvi, PostingListIdentifier backfill_posting_list_id,
-    const TermIdHitPair* hit_elements, size_t len) {
+    const TermIdHitPair* hit_elements, size_t len,
+    int64_t* num_backfill_hits) {
   // 1. Create a PostingListAccessor - either from the pre-existing block, if
   // one exists, or from scratch.
-  PostingListIdentifier posting_list_id = PostingListIdentifier::kInvalid;
-  memcpy(&posting_list_id, main_lexicon_->GetValueAtIndex(tvi),
-         sizeof(posting_list_id));
+  PostingListIdentifier posting_list_id = GetLexiconPostingListId(tvi);
   std::unique_ptr<PostingListAccessor> pl_accessor;
   if (posting_list_id.is_valid()) {
     if (posting_list_id.block_index() >= flash_index_storage_->num_blocks()) {
@@ -553,8 +1956,10 @@ libtextclassifier3::Status MainIndex::AddHitsForTerm(
 
   // 2. Backfill any hits if necessary.
   if (backfill_posting_list_id.is_valid()) {
-    ICING_RETURN_IF_ERROR(
+    ICING_ASSIGN_OR_RETURN(
+        int num_hits,
         AddPrefixBackfillHits(backfill_posting_list_id, pl_accessor.get()));
+    *num_backfill_hits += num_hits;
   }
 
   // 3. Add all the new hits.
@@ -567,12 +1972,12 @@ libtextclassifier3::Status MainIndex::AddHitsForTerm(
   PostingListAccessor::FinalizeResult result =
       PostingListAccessor::Finalize(std::move(*pl_accessor));
   if (result.id.is_valid()) {
-    main_lexicon_->SetValueAtIndex(tvi, &result.id);
+    SetLexiconPostingListId(tvi, result.id);
   }
   return libtextclassifier3::Status::OK;
 }
 
-libtextclassifier3::Status MainIndex::AddPrefixBackfillHits(
+libtextclassifier3::StatusOr<int> MainIndex::AddPrefixBackfillHits(
     PostingListIdentifier backfill_posting_list_id,
     PostingListAccessor* hit_accum) {
   ICING_ASSIGN_OR_RETURN(
@@ -587,6 +1992,7 @@ libtextclassifier3::Status MainIndex::AddPrefixBackfillHits(
     ICING_ASSIGN_OR_RETURN(tmp, backfill_accessor.GetNextHitsBatch());
   }
 
+  int num_hits = 0;
   Hit last_added_hit;
   // The hits in backfill_hits are in the reverse order of how they were added.
   // Iterate in reverse to add them to this new posting list in the correct
@@ -609,6 +2015,215 @@ libtextclassifier3::Status MainIndex::AddPrefixBackfillHits(
     }
     last_added_hit = backfill_hit;
     ICING_RETURN_IF_ERROR(hit_accum->PrependHit(backfill_hit));
+    ++num_hits;
+  }
+  return num_hits;
+}
+
+libtextclassifier3::Status MainIndex::UpdateChampionList(
+    uint32_t tvi, const TermIdHitPair* new_hits, size_t len) {
+  libtextclassifier3::Status status = RebuildChampionList(tvi, new_hits, len);
+  if (status.ok()) {
+    return status;
+  }
+  ICING_LOG(WARNING) << "Dropping champion list of term " << tvi << ": "
+                     << status.error_message();
+  // Queries fall back to the full posting list once the champion list is
+  // gone, so only failing to remove it is an error.
+  return RemoveChampionList(tvi);
+}
+
+libtextclassifier3::Status MainIndex::RemoveChampionList(uint32_t tvi) {
+  auto champion_list_or = champion_list_store_->Get(tvi);
+  if (!champion_list_or.ok()) {
+    return libtextclassifier3::Status::OK;
+  }
+  ICING_RETURN_IF_ERROR(champion_list_store_->Remove(tvi));
+  libtextclassifier3::Status status =
+      FreePostingListChain(champion_list_or.ValueOrDie().posting_list_id);
+  if (!status.ok()) {
+    ICING_LOG(WARNING) << "Leaked champion list posting lists: "
+                       << status.error_message();
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::RebuildChampionList(
+    uint32_t tvi, const TermIdHitPair* new_hits, size_t len) {
+  const size_t champion_list_size = champion_list_options_.champion_list_size;
+
+  // 1. Gather the hits of all documents that may be champions. If the term
+  // already has a champion list, those are the documents in it and the new
+  // documents that rank at or above its threshold. Otherwise, it's all the
+  // documents in the posting list.
+  std::vector<Hit> hits;
+  std::optional<ChampionList> old_champion_list;
+  auto champion_list_or = champion_list_store_->Get(tvi);
+  if (champion_list_or.ok()) {
+    old_champion_list = std::move(champion_list_or).ValueOrDie();
+    ICING_ASSIGN_OR_RETURN(hits,
+                           GetAllHits(old_champion_list->posting_list_id));
+    for (size_t i = 0; i < len; ++i) {
+      hits.push_back(new_hits[i].hit());
+    }
+  } else {
+    PostingListIdentifier posting_list_id =
+        GetPostingListId(tvi, /*champions_only=*/false);
+    if (!posting_list_id.is_valid() ||
+        !MayHoldMoreHitsThan(posting_list_id, champion_list_size)) {
+      // Too few documents to need a champion list.
+      return libtextclassifier3::Status::OK;
+    }
+    ICING_ASSIGN_OR_RETURN(hits, GetAllHits(posting_list_id));
+  }
+
+  // 2. Rank the documents. Sorting hits by value groups them by document.
+  std::sort(hits.begin(), hits.end());
+  hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+  struct Candidate {
+    ChampionRank rank;
+    // The range of the document's hits in 'hits'.
+    size_t hits_begin;
+    size_t hits_end;
+  };
+  std::vector<Candidate> candidates;
+  for (size_t begin = 0, end = 0; begin < hits.size(); begin = end) {
+    DocumentId document_id = hits[begin].document_id();
+    while (end < hits.size() && hits[end].document_id() == document_id) {
+      ++end;
+    }
+    libtextclassifier3::StatusOr<int32_t> document_score_or =
+        champion_list_options_.get_document_score(document_id);
+    if (absl_ports::IsNotFound(document_score_or.status())) {
+      // Deleted documents can't be returned by queries anyway.
+      continue;
+    }
+    ICING_RETURN_IF_ERROR(document_score_or.status());
+    ChampionRank rank = {document_score_or.ValueOrDie(), document_id};
+    if (old_champion_list.has_value() &&
+        rank < old_champion_list->threshold) {
+      continue;
+    }
+    candidates.push_back({rank, begin, end});
+  }
+  if (!old_champion_list.has_value() &&
+      candidates.size() <= champion_list_size) {
+    return libtextclassifier3::Status::OK;
+  }
+  if (candidates.empty()) {
+    // All champions were deleted. The full posting list has to do.
+    ICING_RETURN_IF_ERROR(champion_list_store_->Remove(tvi));
+    return FreePostingListChain(old_champion_list->posting_list_id);
+  }
+
+  // 3. Keep the best champion_list_size documents.
+  ChampionRank threshold = {/*document_score=*/0,
+                            /*document_id=*/kInvalidDocumentId};
+  if (old_champion_list.has_value()) {
+    threshold = old_champion_list->threshold;
+  }
+  if (candidates.size() > champion_list_size) {
+    auto better = [](const Candidate& lhs, const Candidate& rhs) {
+      return rhs.rank < lhs.rank;
+    };
+    std::nth_element(candidates.begin(),
+                     candidates.begin() + champion_list_size - 1,
+                     candidates.end(), better);
+    candidates.resize(champion_list_size);
+    threshold = candidates.back().rank;
+  }
+
+  // 4. Write the hits of the champions to a new posting list. Hits have to be
+  // prepended in descending order.
+  std::vector<Hit> champion_hits;
+  for (const Candidate& candidate : candidates) {
+    champion_hits.insert(champion_hits.end(),
+                         hits.begin() + candidate.hits_begin,
+                         hits.begin() + candidate.hits_end);
+  }
+  std::sort(champion_hits.begin(), champion_hits.end());
+  ICING_ASSIGN_OR_RETURN(
+      PostingListAccessor pl_accessor,
+      PostingListAccessor::Create(flash_index_storage_.get()));
+  for (auto itr = champion_hits.rbegin(); itr != champion_hits.rend(); ++itr) {
+    ICING_RETURN_IF_ERROR(pl_accessor.PrependHit(*itr));
+  }
+  PostingListAccessor::FinalizeResult result =
+      PostingListAccessor::Finalize(std::move(pl_accessor));
+  ICING_RETURN_IF_ERROR(result.status);
+  ICING_RETURN_IF_ERROR(
+      champion_list_store_->Put(tvi, ChampionList{result.id, threshold}));
+
+  // 5. The old champion list isn't needed anymore.
+  if (old_champion_list.has_value()) {
+    libtextclassifier3::Status status =
+        FreePostingListChain(old_champion_list->posting_list_id);
+    if (!status.ok()) {
+      ICING_LOG(WARNING) << "Leaked champion list posting lists: "
+                         << status.error_message();
+    }
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status MainIndex::ClearChampionLists(
+    int champion_list_size) {
+  for (PostingListIdentifier posting_list_id :
+       champion_list_store_->GetPostingListIds()) {
+    libtextclassifier3::Status status = FreePostingListChain(posting_list_id);
+    if (!status.ok()) {
+      ICING_LOG(WARNING) << "Leaked champion list posting lists: "
+                         << status.error_message();
+    }
+  }
+  return champion_list_store_->Clear(champion_list_size);
+}
+
+libtextclassifier3::StatusOr<std::vector<Hit>> MainIndex::GetAllHits(
+    PostingListIdentifier posting_list_id) const {
+  ICING_ASSIGN_OR_RETURN(
+      PostingListAccessor pl_accessor,
+      PostingListAccessor::CreateFromExisting(flash_index_storage_.get(),
+                                              posting_list_id));
+  std::vector<Hit> hits;
+  ICING_ASSIGN_OR_RETURN(std::vector<Hit> tmp, pl_accessor.GetNextHitsBatch());
+  while (!tmp.empty()) {
+    hits.insert(hits.end(), tmp.begin(), tmp.end());
+    ICING_ASSIGN_OR_RETURN(tmp, pl_accessor.GetNextHitsBatch());
+  }
+  return hits;
+}
+
+bool MainIndex::MayHoldMoreHitsThan(PostingListIdentifier posting_list_id,
+                                    int num_hits) const {
+  int posting_list_index_bits = posting_list_id.posting_list_index_bits();
+  if (posting_list_index_bits == 0) {
+    // Max-sized posting lists may be chained.
+    return true;
+  }
+  // A block holds more than 2^(bits - 1) posting lists of this size and every
+  // hit takes up at least a byte.
+  uint32_t max_posting_list_bytes =
+      IndexBlock::CalculateMaxPostingListBytes(
+          flash_index_storage_->block_size()) >>
+      (posting_list_index_bits - 1);
+  return max_posting_list_bytes > num_hits;
+}
+
+libtextclassifier3::Status MainIndex::FreePostingListChain(
+    PostingListIdentifier posting_list_id) {
+  while (posting_list_id.is_valid()) {
+    ICING_ASSIGN_OR_RETURN(
+        PostingListHolder holder,
+        flash_index_storage_->GetPostingList(posting_list_id));
+    uint32_t next_block_index = holder.block.next_block_index();
+    int posting_list_index_bits = holder.block.posting_list_index_bits();
+    flash_index_storage_->FreePostingList(std::move(holder));
+    if (next_block_index == kInvalidBlockIndex) {
+      break;
+    }
+    posting_list_id = PostingListIdentifier(
+        next_block_index, /*posting_list_index=*/0, posting_list_index_bits);
   }
   return libtextclassifier3::Status::OK;
 }
@@ -616,7 +2231,13 @@ libtextclassifier3::Status MainIndex::AddPrefixBackfillHits(
 void MainIndex::GetDebugInfo(int verbosity, std::string* out) const {
   // Lexicon.
   out->append("Main Lexicon stats:\n");
-  main_lexicon_->GetDebugInfo(verbosity, out);
+  if (front_coded_lexicon_ != nullptr) {
+    IcingStringUtil::SStringAppendF(
+        out, 100, "Front-coded lexicon: %u terms, %" PRId64 " bytes\n",
+        front_coded_lexicon_->size(), front_coded_lexicon_->GetMemoryUsage());
+  } else {
+    main_lexicon_->GetDebugInfo(verbosity, out);
+  }
 
   if (verbosity <= 0) {
     return;
@@ -15,19 +15,30 @@
 #ifndef ICING_INDEX_MAIN_MAIN_INDEX_H_
 #define ICING_INDEX_MAIN_MAIN_INDEX_H_
 
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/file/filesystem.h"
 #include "icing/index/lite/term-id-hit-pair.h"
+#include "icing/index/main/champion-list-store.h"
 #include "icing/index/main/flash-index-storage.h"
+#include "icing/index/main/front-coded-lexicon.h"
 #include "icing/index/main/posting-list-accessor.h"
 #include "icing/index/term-id-codec.h"
 #include "icing/index/term-metadata.h"
 #include "icing/legacy/index/icing-dynamic-trie.h"
 #include "icing/legacy/index/icing-filesystem.h"
+#include "icing/proto/logging.pb.h"
 #include "icing/proto/storage.pb.h"
+#include "icing/store/document-id.h"
 #include "icing/store/namespace-id.h"
 #include "icing/util/status-macros.h"
 
@@ -36,12 +47,65 @@ namespace lib {
 
 class MainIndex {
  public:
+  // Returns the document score of the document with the given id, or
+  // NOT_FOUND if the document doesn't exist anymore.
+  using GetDocumentScoreFn =
+      std::function<libtextclassifier3::StatusOr<int32_t>(DocumentId)>;
+
+  struct ChampionListOptions {
+    // The number of best ranked documents kept in a champion list. A term gets
+    // a champion list once its posting list holds more documents than that.
+    // Champion lists are disabled if this is 0.
+    int champion_list_size = 0;
+
+    // Ranks the documents of champion lists. Required if champion_list_size is
+    // positive.
+    GetDocumentScoreFn get_document_score;
+  };
+
+  // The data structure that holds the terms of the main lexicon.
+  enum class LexiconType {
+    // An IcingDynamicTrie that merges insert new terms into.
+    kDynamicTrie,
+    // A FrontCodedLexicon that is kept in memory and rebuilt by every merge
+    // in one pass over the old lexicon and the new terms. It takes less
+    // memory and is faster to search, but merges take time linear in the size
+    // of the lexicon.
+    kFrontCoded,
+  };
+
   // RETURNS:
   //  - valid instance of MainIndex, on success.
   //  - INTERNAL error if unable to create the lexicon or flash storage.
   static libtextclassifier3::StatusOr<std::unique_ptr<MainIndex>> Create(
       const std::string& index_directory, const Filesystem* filesystem,
-      const IcingFilesystem* icing_filesystem);
+      const IcingFilesystem* icing_filesystem) {
+    return Create(index_directory, filesystem, icing_filesystem,
+                  ChampionListOptions());
+  }
+
+  // Creates a MainIndex that keeps champion lists as described by
+  // champion_list_options and its terms in a lexicon of type lexicon_type.
+  //
+  // RETURNS:
+  //  - valid instance of MainIndex, on success.
+  //  - INVALID_ARGUMENT if champion_list_options is invalid.
+  //  - FAILED_PRECONDITION if index_directory holds a main index with another
+  //    type of lexicon.
+  //  - INTERNAL error if unable to create the lexicon, flash storage or
+  //    champion lists.
+  static libtextclassifier3::StatusOr<std::unique_ptr<MainIndex>> Create(
+      const std::string& index_directory, const Filesystem* filesystem,
+      const IcingFilesystem* icing_filesystem,
+      ChampionListOptions champion_list_options,
+      LexiconType lexicon_type = LexiconType::kDynamicTrie);
+
+  // Returns true if index_directory holds a main index whose lexicon isn't of
+  // type lexicon_type. Its posting lists can only be found through the
+  // lexicon it was created with.
+  static bool HasLexiconOfOtherType(const std::string& index_directory,
+                                    const Filesystem& filesystem,
+                                    LexiconType lexicon_type);
 
   // Get a PostingListAccessor that holds the posting list chain for 'term'.
   //
@@ -64,10 +128,41 @@ class MainIndex {
     // True if the returned posting list chain is for 'prefix' or false if the
     // returned posting list chain is for a term for which 'prefix' is a prefix.
     bool exact;
+    // Hits from prefix sections that belong to the posting list chain but
+    // haven't been backfilled into it yet, sorted. Only set if the term is a
+    // branch point whose backfill is pending, in which case the accessor
+    // holds its full posting list even if champions were asked for.
+    std::vector<Hit> pending_backfill_hits;
   };
   libtextclassifier3::StatusOr<GetPrefixAccessorResult>
   GetAccessorForPrefixTerm(const std::string& prefix);
 
+  // Like GetAccessorForExactTerm, but the accessor holds the champion list of
+  // the term's posting list instead if it has one.
+  libtextclassifier3::StatusOr<std::unique_ptr<PostingListAccessor>>
+  GetChampionAccessorForExactTerm(const std::string& term);
+
+  // Like GetAccessorForPrefixTerm, but the accessor holds the champion list of
+  // the posting list instead if it has one.
+  libtextclassifier3::StatusOr<GetPrefixAccessorResult>
+  GetChampionAccessorForPrefixTerm(const std::string& prefix);
+
+  // RETURNS:
+  //  - On success, the threshold of the champion list that
+  //    GetChampionAccessorForExactTerm returns for 'term'.
+  //  - NOT_FOUND if GetChampionAccessorForExactTerm returns a full posting
+  //    list.
+  libtextclassifier3::StatusOr<ChampionRank> GetChampionThresholdForExactTerm(
+      const std::string& term) const;
+
+  // RETURNS:
+  //  - On success, the threshold of the champion list that
+  //    GetChampionAccessorForPrefixTerm returns for 'prefix'.
+  //  - NOT_FOUND if GetChampionAccessorForPrefixTerm returns a full posting
+  //    list.
+  libtextclassifier3::StatusOr<ChampionRank> GetChampionThresholdForPrefixTerm(
+      const std::string& prefix) const;
+
   // Finds terms with the given prefix in the given namespaces. If
   // 'namespace_ids' is empty, returns results from all the namespaces. The
   // input prefix must be normalized, otherwise inaccurate results may be
@@ -103,6 +198,12 @@ class MainIndex {
 
     // Stores tvis that are mapped to by other_tvi_to_prefix_tvis.
     std::vector<uint32_t> prefix_tvis_buf;
+
+    // Number of terms of the lexicon that weren't in the main lexicon yet.
+    int num_new_terms = 0;
+
+    // Number of prefixes that were added to the main lexicon as branch points.
+    int num_new_branch_points = 0;
   };
 
   // Merge the lexicon into the main lexicon and populate the data
@@ -114,6 +215,10 @@ class MainIndex {
   //   - INTERNAL on IO error while writing to the main lexicon.
   libtextclassifier3::StatusOr<LexiconMergeOutputs> MergeLexicon(
       const IcingDynamicTrie& other_lexicon) {
+    version_ = NewVersion();
+    if (front_coded_lexicon_ != nullptr) {
+      return MergeIntoFrontCodedLexicon(other_lexicon);
+    }
     // Backfill branch points need to be added first so that the backfill_map
     // can be correctly populated.
     ICING_ASSIGN_OR_RETURN(LexiconMergeOutputs outputs,
@@ -130,13 +235,19 @@ class MainIndex {
   }
 
   // Add hits to the main index and backfill from existing posting lists to new
-  // backfill branch points.
+  // backfill branch points. Updates the champion lists of the terms that got
+  // hits.
   //
   // The backfill_map maps from main_lexicon tvi for a newly added branching
   // point to the main_lexicon tvi for the posting list whose hits must be
   // backfilled. backfill_map should be populated as part of LexiconMergeOutputs
   // in MergeLexicon and be blindly passed to this function.
   //
+  // If max_backfill_hits_per_merge is set, the backfills are only recorded as
+  // pending. Pending backfills, including ones left over from earlier merges,
+  // are then carried out until that many hits were copied. The backfill and
+  // posting list work is recorded in merge_stats if it isn't null.
+  //
   // RETURNS:
   //  - OK on success
   //  - INVALID_ARGUMENT if one of the elements in the lite index has a term_id
@@ -147,26 +258,102 @@ class MainIndex {
   libtextclassifier3::Status AddHits(
       const TermIdCodec& term_id_codec,
       std::unordered_map<uint32_t, uint32_t>&& backfill_map,
-      std::vector<TermIdHitPair>&& hits, DocumentId last_added_document_id);
+      std::vector<TermIdHitPair>&& hits, DocumentId last_added_document_id,
+      IndexMergeStatsProto* merge_stats = nullptr);
+
+  // Sets the number of hits that a merge may copy into new branch points.
+  // Branch points whose backfill doesn't fit are served by merging in the
+  // hits of their backfill source at query time until a later merge has room
+  // for them. Negative values, the default, backfill every new branch point
+  // right away. 0 defers all backfills.
+  void set_max_backfill_hits_per_merge(int max_backfill_hits_per_merge) {
+    max_backfill_hits_per_merge_ = max_backfill_hits_per_merge;
+  }
+
+  // The number of branch points whose backfill is pending.
+  int num_pending_backfills() const { return pending_backfills_.size(); }
+
+  // The terms found by FindDeadTerms, as value indices into the lexicon of
+  // the given version.
+  struct DeadTerms {
+    uint64_t version;
+    std::unordered_set<uint32_t> tvis;
+  };
 
-  libtextclassifier3::Status PersistToDisk() {
-    if (main_lexicon_->Sync() && flash_index_storage_->PersistToDisk()) {
-      return libtextclassifier3::Status::OK;
+  // Finds the terms that only have hits of documents for which
+  // is_document_live returns false. A dead term is kept if it is the branch
+  // point between live terms, so that prefix lookups still find a posting list
+  // covering all of them. Branch points whose backfill is pending and the
+  // terms they are backfilled from are always kept.
+  //
+  // This reads every posting list of the main index, but doesn't change it, so
+  // it may run alongside queries. is_document_live must keep returning false
+  // for a document once it did.
+  //
+  // RETURNS:
+  //  - The dead terms, on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::StatusOr<DeadTerms> FindDeadTerms(
+      const std::function<bool(DocumentId)>& is_document_live) const;
+
+  // Deletes the dead terms and frees their posting lists. If any term was
+  // deleted, the lexicon is then rebuilt without the space the deleted terms
+  // took up, see CompactLexicon.
+  //
+  // RETURNS:
+  //  - The number of terms deleted, on success
+  //  - FAILED_PRECONDITION if the index changed since dead_terms were found,
+  //    in which case nothing is deleted
+  //  - INTERNAL_ERROR on I/O error. The index may have been compacted without
+  //    all posting lists of the deleted terms being freed, so callers should
+  //    reset it.
+  libtextclassifier3::StatusOr<int> DeleteDeadTerms(DeadTerms dead_terms);
+
+  // Finds the dead terms and deletes them, see above.
+  libtextclassifier3::StatusOr<int> DeleteDeadTerms(
+      const std::function<bool(DocumentId)>& is_document_live) {
+    ICING_ASSIGN_OR_RETURN(DeadTerms dead_terms,
+                           FindDeadTerms(is_document_live));
+    return DeleteDeadTerms(std::move(dead_terms));
+  }
+
+  // The number of terms in the lexicon, including branch points.
+  int num_terms() const {
+    if (front_coded_lexicon_ != nullptr) {
+      return front_coded_lexicon_->size();
     }
-    return absl_ports::InternalError("Unable to sync lite index components.");
+    return main_lexicon_->size();
   }
 
+  libtextclassifier3::Status PersistToDisk();
+
   DocumentId last_added_document_id() const {
     return flash_index_storage_->get_last_indexed_docid();
   }
 
-  libtextclassifier3::Status Reset() {
-    ICING_RETURN_IF_ERROR(flash_index_storage_->Reset());
-    main_lexicon_->Clear();
-    return libtextclassifier3::Status::OK;
+  libtextclassifier3::Status Reset();
+
+  void Warm() {
+    if (main_lexicon_ != nullptr) {
+      main_lexicon_->Warm();
+    }
   }
 
-  void Warm() { main_lexicon_->Warm(); }
+  // Drops the pages of the lexicon that have no unsynced changes from memory.
+  // Returns the number of bytes that were resident. A front-coded lexicon
+  // isn't mapped, so this is always 0 for it.
+  int64_t ReleaseCleanPages() {
+    if (main_lexicon_ == nullptr) {
+      return 0;
+    }
+    return main_lexicon_->ReleaseCleanPages();
+  }
+
+  // Returns the in-memory cache of free posting lists to the on-disk free
+  // lists. Returns the number of bytes released.
+  int64_t ReleaseInMemoryFreeLists() {
+    return flash_index_storage_->ReleaseInMemoryFreeLists();
+  }
 
   // Returns:
   //  - elements size of lexicon and index, on success
@@ -188,9 +375,212 @@ class MainIndex {
   void GetDebugInfo(int verbosity, std::string* out) const;
 
  private:
+  // Marks a term that a front-coded lexicon rebuild dropped.
+  static constexpr uint32_t kInvalidTermIndex = UINT32_MAX;
+
+  // Returns a version that no MainIndex of the process had before.
+  static uint64_t NewVersion();
+
   libtextclassifier3::Status Init(const std::string& index_directory,
                                   const Filesystem* filesystem,
-                                  const IcingFilesystem* icing_filesystem);
+                                  const IcingFilesystem* icing_filesystem,
+                                  LexiconType lexicon_type);
+
+  // Returns an initialized lexicon trie stored in the files starting with
+  // filename, creating them if they don't exist.
+  //
+  // RETURNS:
+  //  - The lexicon, on success
+  //  - INTERNAL_ERROR if the trie couldn't be created or initialized
+  libtextclassifier3::StatusOr<std::unique_ptr<IcingDynamicTrie>> OpenLexicon(
+      const std::string& filename) const;
+
+  // Reads the front-coded lexicon, or creates an empty one if there's none.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - DATA_LOSS if the lexicon is corrupted
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status InitFrontCodedLexicon();
+
+  // Replaces the file of the front-coded lexicon if the lexicon changed since
+  // it was last written.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status WriteFrontCodedLexicon();
+
+  // Sets the properties of the terms of the front-coded lexicon on the same
+  // terms in new_lexicon. Term index i of the front-coded lexicon is term
+  // index new_term_indices[i] of new_lexicon, or kInvalidTermIndex.
+  void CopyFrontCodedProperties(const std::vector<uint32_t>& new_term_indices,
+                                FrontCodedLexicon* new_lexicon) const;
+
+  // Replaces the front-coded lexicon with new_lexicon. Term index i of the old
+  // lexicon is term index new_term_indices[i] of the new one, or
+  // kInvalidTermIndex if the term was dropped. Moves the champion lists and
+  // pending backfills to the new term indices.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status ReplaceFrontCodedLexicon(
+      std::unique_ptr<FrontCodedLexicon> new_lexicon,
+      const std::vector<uint32_t>& new_term_indices);
+
+  // Does the work of MergeLexicon for a front-coded lexicon. The branch
+  // points that AddBackfillBranchPoints and AddBranchPoints would insert into
+  // the trie are found from the longest common prefixes of neighboring terms,
+  // since the branches of a trie are where neighboring keys diverge. The
+  // lexicon is then rebuilt with the new terms and branch points.
+  libtextclassifier3::StatusOr<LexiconMergeOutputs> MergeIntoFrontCodedLexicon(
+      const IcingDynamicTrie& other_lexicon);
+
+  // Returns the posting list that the lexicon holds for the term with value
+  // index tvi.
+  PostingListIdentifier GetLexiconPostingListId(uint32_t tvi) const;
+  void SetLexiconPostingListId(uint32_t tvi,
+                               PostingListIdentifier posting_list_id);
+
+  // Deletes the files of the lexicon and starts over with an empty one.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status RecreateLexicon();
+
+  // Rebuilds the lexicon without the terms with value indices in
+  // tvis_to_drop, nor the space taken up by terms deleted before. The value
+  // indices of the remaining terms change, so the champion lists and pending
+  // backfills are moved to the new ones.
+  //
+  // All of them are written to the files of the next lexicon generation,
+  // which is switched to once they are on disk. A crash at any point leaves
+  // one generation or the other in use, and the index is left unchanged on
+  // errors.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status CompactLexicon(
+      const std::unordered_set<uint32_t>& tvis_to_drop);
+
+  // A lexicon with the champion lists and pending backfills that refer to its
+  // value indices. Only one of the lexicons is set, as in MainIndex.
+  struct CompactedLexicon {
+    std::unique_ptr<IcingDynamicTrie> lexicon;
+    std::unique_ptr<FrontCodedLexicon> front_coded_lexicon;
+    std::unique_ptr<ChampionListStore> champion_list_store;
+    std::map<uint32_t, uint32_t> pending_backfills;
+  };
+
+  // Does the work of CompactLexicon up to the switch, writing the compacted
+  // lexicon to the files of generation.
+  //
+  // RETURNS:
+  //  - The compacted lexicon on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::StatusOr<CompactedLexicon> WriteCompactedLexicon(
+      const std::unordered_set<uint32_t>& tvis_to_drop,
+      uint32_t generation) const;
+
+  // Points the lexicon filenames at the files of generation.
+  void SetLexiconGeneration(uint32_t generation);
+
+  // Deletes the lexicon files of generation, if there are any.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status DeleteLexiconFiles(uint32_t generation) const;
+
+  // Returns true if the posting list chain starting at posting_list_id has a
+  // hit of a document for which is_document_live returns true.
+  libtextclassifier3::StatusOr<bool> HasHitsOfLiveDocuments(
+      PostingListIdentifier posting_list_id,
+      const std::function<bool(DocumentId)>& is_document_live) const;
+
+  // Finds the posting list of 'term'.
+  //
+  // RETURNS:
+  //  - On success, the value index of 'term' in the main lexicon
+  //  - NOT_FOUND if term is not present in the main index.
+  libtextclassifier3::StatusOr<uint32_t> FindExactTerm(
+      const std::string& term) const;
+
+  // Finds the posting list that best represents 'prefix'.
+  //
+  // RETURNS:
+  //  - On success, the value index of the term in the main lexicon
+  //  - NOT_FOUND if neither 'prefix' nor any terms for which 'prefix' is a
+  //    prefix are present in the main index.
+  struct FindPrefixTermResult {
+    uint32_t tvi;
+    // Whether the term is 'prefix' itself.
+    bool exact;
+    // Whether the posting list has any hits for 'prefix'. It only has hits
+    // from prefix sections for it if exact is false.
+    bool has_hits;
+  };
+  libtextclassifier3::StatusOr<FindPrefixTermResult> FindPrefixTerm(
+      const std::string& prefix) const;
+
+  // Returns the posting list of the term with value index tvi, or its
+  // champion list if champions_only is true and it has one.
+  PostingListIdentifier GetPostingListId(uint32_t tvi,
+                                         bool champions_only) const;
+
+  libtextclassifier3::StatusOr<std::unique_ptr<PostingListAccessor>>
+  GetExactTermAccessor(const std::string& term, bool champions_only);
+
+  libtextclassifier3::StatusOr<GetPrefixAccessorResult> GetPrefixTermAccessor(
+      const std::string& prefix, bool champions_only);
+
+  // Brings the champion list of the term with value index tvi up to date after
+  // hits [new_hits, new_hits + len) were added to its posting list. Builds a
+  // champion list if the term doesn't have one yet and now has more than
+  // champion_list_size documents. The term is left without a champion list if
+  // that fails, so that its full posting list is used.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR if the champion list could neither be updated nor
+  //    removed.
+  libtextclassifier3::Status UpdateChampionList(uint32_t tvi,
+                                                const TermIdHitPair* new_hits,
+                                                size_t len);
+
+  // Does the work of UpdateChampionList, without falling back to removing
+  // the champion list on errors.
+  libtextclassifier3::Status RebuildChampionList(uint32_t tvi,
+                                                 const TermIdHitPair* new_hits,
+                                                 size_t len);
+
+  // Removes the champion list of the term with value index tvi, if any.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR if the champion list couldn't be removed.
+  libtextclassifier3::Status RemoveChampionList(uint32_t tvi);
+
+  // Frees the posting lists of all champion lists and removes the champion
+  // lists. Lists that are built afterwards hold champion_list_size documents.
+  libtextclassifier3::Status ClearChampionLists(int champion_list_size);
+
+  // Returns all hits of the posting list chain starting at posting_list_id.
+  libtextclassifier3::StatusOr<std::vector<Hit>> GetAllHits(
+      PostingListIdentifier posting_list_id) const;
+
+  // Returns false if the posting list identified by posting_list_id can't
+  // hold more than num_hits hits.
+  bool MayHoldMoreHitsThan(PostingListIdentifier posting_list_id,
+                           int num_hits) const;
+
+  // Frees all posting lists in the posting list chain starting at
+  // posting_list_id.
+  libtextclassifier3::Status FreePostingListChain(
+      PostingListIdentifier posting_list_id);
 
   // Helpers for merging the lexicon
   // Add all 'backfill' branch points. Backfill branch points are prefix
@@ -268,13 +658,22 @@ class MainIndex {
   //  posting list.
   libtextclassifier3::Status AddHitsForTerm(
       uint32_t tvi, PostingListIdentifier backfill_posting_list_id,
-      const TermIdHitPair* hit_elements, size_t len);
+      const TermIdHitPair* hit_elements, size_t len,
+      int64_t* num_backfill_hits);
+
+  // Does the work of AddHits, adding the backfilled hits to
+  // *num_backfill_hits and their size to *backfill_bytes.
+  libtextclassifier3::Status AddHitsAndBackfills(
+      const TermIdCodec& term_id_codec,
+      std::unordered_map<uint32_t, uint32_t>&& backfill_map,
+      std::vector<TermIdHitPair>&& hits, int64_t* num_backfill_hits,
+      int64_t* backfill_bytes);
 
   // Adds all prefix hits or hits from prefix sections present on the posting
   // list identified by backfill_posting_list_id to hit_accum.
   //
   // RETURNS:
-  //  - OK, on success
+  //  - The number of hits added, on success
   //  - INVALID_ARGUMENT if backfill_posting_list_id points out of bounds in the
   //  IndexBlock referred to by id.block_index()
   //  - INTERNAL_ERROR if unable to mmap the block identified by
@@ -282,12 +681,89 @@ class MainIndex {
   //  backfill_posting_list_id has been corrupted.
   //  - RESOURCE_EXHAUSTED error if unable to grow the index to allocate a new
   //  posting list.
-  libtextclassifier3::Status AddPrefixBackfillHits(
+  libtextclassifier3::StatusOr<int> AddPrefixBackfillHits(
       PostingListIdentifier backfill_posting_list_id,
       PostingListAccessor* hit_accum);
 
+  // Carries out pending backfills until max_backfill_hits_per_merge_ hits
+  // were copied, counting from *num_backfill_hits. A backfill is only carried
+  // out once its source isn't pending anymore. Adds the hits copied to
+  // *num_backfill_hits and the bytes written to *backfill_bytes.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR or RESOURCE_EXHAUSTED on errors rewriting posting lists
+  libtextclassifier3::Status MaterializePendingBackfills(
+      int64_t* num_backfill_hits, int64_t* backfill_bytes);
+
+  // Rewrites the posting list of the branch point with value index
+  // branch_point_tvi to also hold the hits from prefix sections of the term
+  // with value index source_tvi. Adds the bytes written to *backfill_bytes.
+  //
+  // RETURNS:
+  //  - The number of hits copied from the source, on success
+  //  - INTERNAL_ERROR or RESOURCE_EXHAUSTED on errors rewriting posting lists
+  libtextclassifier3::StatusOr<int> MaterializeBackfill(
+      uint32_t branch_point_tvi, uint32_t source_tvi, int64_t* backfill_bytes);
+
+  // Returns the hits from prefix sections that the branch point with value
+  // index tvi is missing because its backfill, or that of the terms it is
+  // backfilled from, is pending. Hits are sorted.
+  libtextclassifier3::StatusOr<std::vector<Hit>> GetPendingBackfillHits(
+      uint32_t tvi) const;
+
+  // Loads the pending backfills written by the last PersistToDisk.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - DATA_LOSS if they don't match the rest of the main index, e.g. after a
+  //    crash. Hits would be missing from branch points then.
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status LoadPendingBackfills();
+
+  // Replaces the file of pending backfills, or deletes it if there are none.
+  //
+  // RETURNS:
+  //  - OK on success
+  //  - INTERNAL_ERROR on I/O error
+  libtextclassifier3::Status WritePendingBackfills();
+
+  // Writes pending_backfill_map to filename, which is replaced, or deleted if
+  // there are none.
+  libtextclassifier3::Status WritePendingBackfills(
+      const std::string& filename,
+      const std::map<uint32_t, uint32_t>& pending_backfill_map) const;
+
+  const Filesystem* filesystem_;
+  const IcingFilesystem* icing_filesystem_;
+  std::string index_directory_;
+  // The files of the lexicon, and of the state that refers to its value
+  // indices, are named after their generation. CompactLexicon writes a new
+  // one.
+  uint32_t lexicon_generation_ = 0;
+  // Replaced by every change to the terms or hits, so that DeleteDeadTerms
+  // can tell whether the dead terms it is given are still dead.
+  uint64_t version_ = NewVersion();
+  std::string pending_backfills_filename_;
+  std::string lexicon_filename_;
+  std::string front_coded_lexicon_filename_;
+  std::string champion_lists_file_prefix_;
+
   std::unique_ptr<FlashIndexStorage> flash_index_storage_;
+  // Exactly one of the lexicons is set, depending on the LexiconType. The
+  // value index of a front-coded lexicon's term is its term index.
   std::unique_ptr<IcingDynamicTrie> main_lexicon_;
+  std::unique_ptr<FrontCodedLexicon> front_coded_lexicon_;
+  // Whether front_coded_lexicon_ changed since it was last written.
+  bool front_coded_lexicon_dirty_ = false;
+  std::unique_ptr<ChampionListStore> champion_list_store_;
+  ChampionListOptions champion_list_options_;
+
+  // Maps the value indices of branch points whose backfill is pending to the
+  // value indices of the terms they will be backfilled from. A source may
+  // itself be pending.
+  std::map<uint32_t, uint32_t> pending_backfills_;
+  int max_backfill_hits_per_merge_ = -1;
 };
 
 }  // namespace lib
@@ -14,10 +14,13 @@
 
 #include "icing/index/main/main-index.h"
 
+#include <unordered_map>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "icing/absl_ports/canonical_errors.h"
 #include "icing/file/filesystem.h"
+#include "icing/file/mock-filesystem.h"
 #include "icing/index/iterator/doc-hit-info-iterator.h"
 #include "icing/index/lite/term-id-hit-pair.h"
 #include "icing/index/main/doc-hit-info-iterator-term-main.h"
@@ -29,6 +32,7 @@
 #include "icing/legacy/index/icing-filesystem.h"
 #include "icing/legacy/index/icing-mock-filesystem.h"
 #include "icing/schema/section.h"
+#include "icing/store/document-id.h"
 #include "icing/store/namespace-id.h"
 #include "icing/testing/common-matchers.h"
 #include "icing/testing/tmp-directory.h"
@@ -38,8 +42,13 @@ namespace lib {
 
 namespace {
 
+using ::testing::_;
 using ::testing::ElementsAre;
+using ::testing::EndsWith;
+using ::testing::Eq;
+using ::testing::Gt;
 using ::testing::IsEmpty;
+using ::testing::Le;
 using ::testing::NiceMock;
 using ::testing::Return;
 using ::testing::SizeIs;
@@ -54,23 +63,26 @@ std::vector<DocHitInfo> GetHits(std::unique_ptr<DocHitInfoIterator> iterator) {
 
 std::vector<DocHitInfo> GetExactHits(
     MainIndex* main_index, const std::string& term,
-    SectionIdMask section_mask = kSectionIdMaskAll) {
+    SectionIdMask section_mask = kSectionIdMaskAll,
+    bool champions_only = false) {
   auto iterator = std::make_unique<DocHitInfoIteratorTermMainExact>(
-      main_index, term, section_mask);
+      main_index, term, section_mask, champions_only);
   return GetHits(std::move(iterator));
 }
 
 std::vector<DocHitInfo> GetPrefixHits(
     MainIndex* main_index, const std::string& term,
-    SectionIdMask section_mask = kSectionIdMaskAll) {
+    SectionIdMask section_mask = kSectionIdMaskAll,
+    bool champions_only = false) {
   auto iterator = std::make_unique<DocHitInfoIteratorTermMainPrefix>(
-      main_index, term, section_mask);
+      main_index, term, section_mask, champions_only);
   return GetHits(std::move(iterator));
 }
 
 libtextclassifier3::Status Merge(const LiteIndex& lite_index,
                                  const TermIdCodec& term_id_codec,
-                                 MainIndex* main_index) {
+                                 MainIndex* main_index,
+                                 IndexMergeStatsProto* merge_stats = nullptr) {
   ICING_ASSIGN_OR_RETURN(MainIndex::LexiconMergeOutputs outputs,
                          main_index->MergeLexicon(lite_index.lexicon()));
   ICING_ASSIGN_OR_RETURN(std::vector<TermIdHitPair> term_id_hit_pairs,
@@ -78,7 +90,7 @@ libtextclassifier3::Status Merge(const LiteIndex& lite_index,
                              lite_index, term_id_codec, outputs));
   return main_index->AddHits(term_id_codec, std::move(outputs.backfill_map),
                              std::move(term_id_hit_pairs),
-                             lite_index.last_added_document_id());
+                             lite_index.last_added_document_id(), merge_stats);
 }
 
 class MainIndexTest : public testing::Test {
@@ -589,6 +601,875 @@ TEST_F(MainIndexTest, MergeIndexBackfilling) {
                         std::vector<SectionId>{doc0_hit.section_id()})));
 }
 
+MainIndex::ChampionListOptions MakeChampionListOptions(
+    int champion_list_size,
+    const std::unordered_map<DocumentId, int32_t>* document_scores) {
+  MainIndex::ChampionListOptions options;
+  options.champion_list_size = champion_list_size;
+  options.get_document_score = [document_scores](DocumentId document_id)
+      -> libtextclassifier3::StatusOr<int32_t> {
+    auto itr = document_scores->find(document_id);
+    if (itr == document_scores->end()) {
+      return absl_ports::NotFoundError("Document deleted");
+    }
+    return itr->second;
+  };
+  return options;
+}
+
+// Adds a hit for term in document_id to lite_index.
+void AddHit(const TermIdCodec& term_id_codec, LiteIndex* lite_index,
+            const std::string& term, DocumentId document_id) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      uint32_t tvi,
+      lite_index->InsertTerm(term, TermMatchType::PREFIX, kNamespace0));
+  ICING_ASSERT_OK_AND_ASSIGN(uint32_t term_id,
+                             term_id_codec.EncodeTvi(tvi, TviType::LITE));
+  Hit hit(/*section_id=*/0, document_id, Hit::kDefaultTermFrequency,
+          /*is_in_prefix_section=*/true);
+  ICING_ASSERT_OK(lite_index->AddHit(term_id, hit));
+  lite_index->set_last_added_document_id(document_id);
+}
+
+std::vector<DocumentId> GetDocumentIds(const std::vector<DocHitInfo>& hits) {
+  std::vector<DocumentId> document_ids;
+  for (const DocHitInfo& hit : hits) {
+    document_ids.push_back(hit.document_id());
+  }
+  return document_ids;
+}
+
+TEST_F(MainIndexTest, ChampionListsWithoutDocumentScoresAreInvalid) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  MainIndex::ChampionListOptions options;
+  options.champion_list_size = 2;
+  EXPECT_THAT(MainIndex::Create(main_index_file_name, &filesystem_,
+                                &icing_filesystem_, options),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+
+  options.champion_list_size = -1;
+  EXPECT_THAT(MainIndex::Create(main_index_file_name, &filesystem_,
+                                &icing_filesystem_, options),
+              StatusIs(libtextclassifier3::StatusCode::INVALID_ARGUMENT));
+}
+
+TEST_F(MainIndexTest, ChampionListHoldsBestDocuments) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}};
+  for (const auto& [document_id, document_score] : document_scores) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo")),
+              ElementsAre(3, 2, 1, 0));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(2, 0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo",
+                                           kSectionIdMaskAll,
+                                           /*champions_only=*/true)),
+              ElementsAre(2, 0));
+
+  ChampionRank expected_threshold = {/*document_score=*/5, /*document_id=*/0};
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              IsOkAndHolds(Eq(expected_threshold)));
+  EXPECT_THAT(main_index->GetChampionThresholdForPrefixTerm("fo"),
+              IsOkAndHolds(Eq(expected_threshold)));
+}
+
+TEST_F(MainIndexTest, TermsWithFewDocumentsHaveNoChampionList) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {{0, 5}, {1, 1}};
+  for (const auto& [document_id, document_score] : document_scores) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  // The full posting list is used instead.
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(1, 0));
+}
+
+TEST_F(MainIndexTest, ChampionListLeavesOutDeletedDocuments) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}};
+  for (const auto& [document_id, document_score] : document_scores) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+  document_scores.erase(2);
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(3, 0));
+  ChampionRank expected_threshold = {/*document_score=*/3, /*document_id=*/3};
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              IsOkAndHolds(Eq(expected_threshold)));
+}
+
+TEST_F(MainIndexTest, ChampionListIsUpdatedByMerges) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}, {4, 7}, {5, 2}};
+  for (DocumentId document_id = 0; document_id < 4; ++document_id) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  // Merge two more documents, one of which is a champion.
+  std::string lite_index_file_name2 = index_dir_ + "/test_file.lite-idx.index2";
+  LiteIndex::Options options(lite_index_file_name2,
+                             /*hit_buffer_want_merge_bytes=*/1024 * 1024);
+  ICING_ASSERT_OK_AND_ASSIGN(lite_index_,
+                             LiteIndex::Create(options, &icing_filesystem_));
+  AddHit(*term_id_codec_, lite_index_.get(), "foo", /*document_id=*/4);
+  AddHit(*term_id_codec_, lite_index_.get(), "foo", /*document_id=*/5);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo")),
+              ElementsAre(5, 4, 3, 2, 1, 0));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(4, 2));
+  ChampionRank expected_threshold = {/*document_score=*/7, /*document_id=*/4};
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              IsOkAndHolds(Eq(expected_threshold)));
+}
+
+TEST_F(MainIndexTest, ChampionListsArePersisted) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}};
+  for (const auto& [document_id, document_score] : document_scores) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_,
+                          MakeChampionListOptions(/*champion_list_size=*/2,
+                                                  &document_scores)));
+    ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(2, 0));
+}
+
+TEST_F(MainIndexTest, ChangingChampionListSizeDiscardsChampionLists) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}};
+  for (const auto& [document_id, document_score] : document_scores) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_,
+                          MakeChampionListOptions(/*champion_list_size=*/2,
+                                                  &document_scores)));
+    ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/3,
+                                                &document_scores)));
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(3, 2, 1, 0));
+}
+
+// Merges "fool" and "foot" into main_index, and then "fox", which makes "fo" a
+// new branch point that needs the prefix hits of "foo" backfilled.
+void MergeNewBranchPoint(const TermIdCodec& term_id_codec,
+                         LiteIndex* lite_index, MainIndex* main_index,
+                         IndexMergeStatsProto* merge_stats) {
+  AddHit(term_id_codec, lite_index, "fool", /*document_id=*/0);
+  AddHit(term_id_codec, lite_index, "foot", /*document_id=*/1);
+  ICING_ASSERT_OK(Merge(*lite_index, term_id_codec, main_index));
+  ICING_ASSERT_OK(lite_index->Reset());
+  AddHit(term_id_codec, lite_index, "fox", /*document_id=*/2);
+  ICING_ASSERT_OK(Merge(*lite_index, term_id_codec, main_index, merge_stats));
+  ICING_ASSERT_OK(lite_index->Reset());
+}
+
+TEST_F(MainIndexTest, EagerBackfillIsReportedInMergeStats) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  IndexMergeStatsProto merge_stats;
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      &merge_stats);
+
+  EXPECT_THAT(merge_stats.num_backfill_hits(), Eq(2));
+  EXPECT_THAT(merge_stats.backfill_bytes(), Gt(0));
+  EXPECT_THAT(merge_stats.num_pending_backfills(), Eq(0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+}
+
+TEST_F(MainIndexTest, DeferredBackfillIsMergedInByQueries) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  main_index->set_max_backfill_hits_per_merge(0);
+  IndexMergeStatsProto merge_stats;
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      &merge_stats);
+
+  EXPECT_THAT(merge_stats.num_backfill_hits(), Eq(0));
+  EXPECT_THAT(merge_stats.backfill_bytes(), Eq(0));
+  EXPECT_THAT(merge_stats.num_pending_backfills(), Eq(1));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(1));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "f")),
+              ElementsAre(2, 1, 0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "foo")),
+              ElementsAre(1, 0));
+}
+
+TEST_F(MainIndexTest, DeferredBackfillIsDoneByALaterMerge) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  main_index->set_max_backfill_hits_per_merge(0);
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+
+  // "foxes" gets added to the posting list of "fo" before its backfill.
+  main_index->set_max_backfill_hits_per_merge(1);
+  AddHit(*term_id_codec_, lite_index_.get(), "foxes", /*document_id=*/3);
+  IndexMergeStatsProto merge_stats;
+  ICING_ASSERT_OK(
+      Merge(*lite_index_, *term_id_codec_, main_index.get(), &merge_stats));
+
+  // The budget is exceeded by the one backfill that it allowed to start.
+  EXPECT_THAT(merge_stats.num_backfill_hits(), Eq(2));
+  EXPECT_THAT(merge_stats.num_pending_backfills(), Eq(0));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(3, 2, 1, 0));
+}
+
+TEST_F(MainIndexTest, PendingBackfillsArePersisted) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_));
+    main_index->set_max_backfill_hits_per_merge(0);
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(1));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+
+  // Backfills are done right away by default, including pending ones.
+  AddHit(*term_id_codec_, lite_index_.get(), "bar", /*document_id=*/3);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+}
+
+TEST_F(MainIndexTest, CorruptPendingBackfillsAreDataLoss) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_));
+    main_index->set_max_backfill_hits_per_merge(0);
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+
+  std::string pending_backfills_file_name =
+      main_index_file_name + "/main-pending-backfills";
+  int64_t file_size =
+      filesystem_.GetFileSize(pending_backfills_file_name.c_str());
+  ASSERT_THAT(file_size, Gt(0));
+  uint8_t byte = 0xff;
+  ASSERT_TRUE(filesystem_.PWrite(pending_backfills_file_name.c_str(),
+                                 file_size - 1, &byte, sizeof(byte)));
+
+  EXPECT_THAT(MainIndex::Create(main_index_file_name, &filesystem_,
+                                &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::DATA_LOSS));
+}
+
+// Returns the terms of main_index that start with prefix.
+std::vector<std::string> GetTerms(MainIndex* main_index,
+                                  const std::string& prefix) {
+  std::vector<std::string> terms;
+  auto terms_or = main_index->FindTermsByPrefix(prefix, /*namespace_ids=*/{},
+                                                /*num_to_return=*/100);
+  if (terms_or.ok()) {
+    for (const TermMetadata& term_metadata : terms_or.ValueOrDie()) {
+      terms.push_back(term_metadata.content);
+    }
+  }
+  return terms;
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsDropsTermsOfDeletedDocuments) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+  ASSERT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "fool", "foot", "fox"));
+
+  // "foo" still has the prefix hit of "foot".
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id != 0; }),
+              IsOkAndHolds(1));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "foot", "fox"));
+  EXPECT_THAT(GetExactHits(main_index.get(), "fool"), IsEmpty());
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foot")),
+              ElementsAre(1));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+
+  // Nothing else is dead.
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id != 0; }),
+              IsOkAndHolds(0));
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsDropsBranchPointsOfDeadTerms) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+  int num_terms = main_index->num_terms();
+
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id == 2; }),
+              IsOkAndHolds(3));
+  EXPECT_THAT(main_index->num_terms(), Eq(num_terms - 3));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"), ElementsAre("fo", "fox"));
+
+  // Merges keep working with the rebuilt lexicon.
+  AddHit(*term_id_codec_, lite_index_.get(), "fool", /*document_id=*/3);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "fool", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "foo")),
+              ElementsAre(3));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(3, 2, 1, 0));
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsFailsIfIndexChangedSinceFound) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+  auto is_document_live = [](DocumentId document_id) {
+    return document_id != 0;
+  };
+  ICING_ASSERT_OK_AND_ASSIGN(MainIndex::DeadTerms dead_terms,
+                             main_index->FindDeadTerms(is_document_live));
+  EXPECT_THAT(dead_terms.tvis, SizeIs(1));
+
+  // "fool" gets a live hit in between.
+  AddHit(*term_id_codec_, lite_index_.get(), "fool", /*document_id=*/3);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(main_index->DeleteDeadTerms(std::move(dead_terms)),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "fool", "foot", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "fool")),
+              ElementsAre(3, 0));
+
+  // Found again, nothing is dead.
+  ICING_ASSERT_OK_AND_ASSIGN(dead_terms,
+                             main_index->FindDeadTerms(is_document_live));
+  EXPECT_THAT(main_index->DeleteDeadTerms(std::move(dead_terms)),
+              IsOkAndHolds(0));
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsKeepsPendingBackfills) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  main_index->set_max_backfill_hits_per_merge(0);
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+
+  // "foo" is where "fo" gets its backfill from, so it stays even though the
+  // documents of "fool" and "foot" are gone.
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id == 2; }),
+              IsOkAndHolds(2));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"), ElementsAre("fo", "foo", "fox"));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(1));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+
+  // The pending backfill still finds its source once it is carried out.
+  main_index->set_max_backfill_hits_per_merge(-1);
+  AddHit(*term_id_codec_, lite_index_.get(), "bar", /*document_id=*/3);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(0));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsKeepsChampionLists) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}, {4, 4}};
+  for (DocumentId document_id = 0; document_id < 4; ++document_id) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+  AddHit(*term_id_codec_, lite_index_.get(), "bar", /*document_id=*/4);
+
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores)));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+
+  // "bar" goes away and "foo" takes its place in the lexicon.
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id != 4; }),
+              IsOkAndHolds(1));
+  EXPECT_THAT(GetTerms(main_index.get(), ""), ElementsAre("foo"));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(2, 0));
+  ChampionRank expected_threshold = {/*document_score=*/5, /*document_id=*/0};
+  EXPECT_THAT(main_index->GetChampionThresholdForExactTerm("foo"),
+              IsOkAndHolds(Eq(expected_threshold)));
+}
+
+TEST_F(MainIndexTest, DeleteDeadTermsIsPersisted) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_));
+    main_index->set_max_backfill_hits_per_merge(0);
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ASSERT_THAT(main_index->DeleteDeadTerms(
+                    [](DocumentId document_id) { return document_id == 2; }),
+                IsOkAndHolds(2));
+  }
+  // The lexicon was written to new files, and the old ones are gone.
+  EXPECT_FALSE(filesystem_.FileExists(
+      (main_index_file_name + "/main-lexicon.h").c_str()));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"), ElementsAre("fo", "foo", "fox"));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(1));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+
+  // Deleting more terms moves on to yet another generation of files.
+  EXPECT_THAT(
+      main_index->DeleteDeadTerms([](DocumentId) { return false; }),
+      IsOkAndHolds(1));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"), ElementsAre("fo", "foo"));
+}
+
+TEST_F(MainIndexTest, FailedDeleteDeadTermsLeavesIndexUnchanged) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    // Switching to the compacted lexicon fails.
+    NiceMock<MockFilesystem> mock_filesystem;
+    ON_CALL(mock_filesystem,
+            RenameFile(_, EndsWith("/main-lexicon-generation")))
+        .WillByDefault(Return(false));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &mock_filesystem,
+                          &icing_filesystem_));
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    EXPECT_THAT(main_index->DeleteDeadTerms(
+                    [](DocumentId document_id) { return document_id != 0; }),
+                StatusIs(libtextclassifier3::StatusCode::INTERNAL));
+
+    // The dead term and its posting list are still there.
+    EXPECT_THAT(GetTerms(main_index.get(), "f"),
+                ElementsAre("fo", "foo", "fool", "foot", "fox"));
+    EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "fool")),
+                ElementsAre(0));
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+  EXPECT_FALSE(filesystem_.FileExists(
+      (main_index_file_name + "/main-lexicon-1.h").c_str()));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "fool", "foot", "fox"));
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id != 0; }),
+              IsOkAndHolds(1));
+}
+
+TEST_F(MainIndexTest, CreateDeletesFilesOfOtherLexiconGenerations) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_));
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ASSERT_THAT(main_index->DeleteDeadTerms(
+                    [](DocumentId document_id) { return document_id != 0; }),
+                IsOkAndHolds(1));
+  }
+  // As if a crash kept the old generation from being deleted, and another
+  // compaction from being switched to.
+  std::string old_generation_file_name =
+      main_index_file_name + "/main-pending-backfills";
+  std::string next_generation_file_name =
+      main_index_file_name + "/main-pending-backfills-2";
+  ASSERT_TRUE(filesystem_.Write(old_generation_file_name.c_str(), "x", 1));
+  ASSERT_TRUE(filesystem_.Write(next_generation_file_name.c_str(), "x", 1));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  EXPECT_FALSE(filesystem_.FileExists(old_generation_file_name.c_str()));
+  EXPECT_FALSE(filesystem_.FileExists(next_generation_file_name.c_str()));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "foot", "fox"));
+}
+
+TEST_F(MainIndexTest, ResetShrinksLexicon) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_,
+                        &icing_filesystem_));
+  int64_t empty_size = main_index->GetStorageInfo(IndexStorageInfoProto())
+                           .main_index_lexicon_size();
+  for (int i = 0; i < 1000; ++i) {
+    AddHit(*term_id_codec_, lite_index_.get(), "term" + std::to_string(i),
+           /*document_id=*/i);
+  }
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  ASSERT_THAT(main_index->GetStorageInfo(IndexStorageInfoProto())
+                  .main_index_lexicon_size(),
+              Gt(empty_size));
+
+  ICING_ASSERT_OK(main_index->Reset());
+  EXPECT_THAT(main_index->num_terms(), Eq(0));
+  EXPECT_THAT(main_index->GetStorageInfo(IndexStorageInfoProto())
+                  .main_index_lexicon_size(),
+              Le(empty_size));
+}
+
+// Adds a hit for term in document_id to lite_index, in a prefix section if
+// is_in_prefix_section.
+void AddHitInSection(const TermIdCodec& term_id_codec, LiteIndex* lite_index,
+                     const std::string& term, DocumentId document_id,
+                     bool is_in_prefix_section) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      uint32_t tvi,
+      lite_index->InsertTerm(term,
+                             is_in_prefix_section ? TermMatchType::PREFIX
+                                                  : TermMatchType::EXACT_ONLY,
+                             kNamespace0));
+  ICING_ASSERT_OK_AND_ASSIGN(uint32_t term_id,
+                             term_id_codec.EncodeTvi(tvi, TviType::LITE));
+  Hit hit(/*section_id=*/0, document_id, Hit::kDefaultTermFrequency,
+          is_in_prefix_section);
+  ICING_ASSERT_OK(lite_index->AddHit(term_id, hit));
+  lite_index->set_last_added_document_id(document_id);
+}
+
+TEST_F(MainIndexTest, FrontCodedLexiconMatchesDynamicTrie) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> trie_main_index,
+      MainIndex::Create(index_dir_ + "/trie.idx.index", &filesystem_,
+                        &icing_filesystem_));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> front_coded_main_index,
+      MainIndex::Create(index_dir_ + "/front-coded.idx.index", &filesystem_,
+                        &icing_filesystem_, MainIndex::ChampionListOptions(),
+                        MainIndex::LexiconType::kFrontCoded));
+
+  // Each batch is merged separately, so later batches add branch points and
+  // backfills to the terms of earlier ones.
+  std::vector<std::vector<std::string>> batches = {
+      {"fool", "foot", "bar"},
+      {"fox", "foo", "barn", "bark"},
+      {"f", "barnyard", "food", "caf\xC3\xA9", "caf\xC3\xA8"},
+      {"fo", "ba", "ca", "zebra", "caf\xC3\xA9s"}};
+  DocumentId document_id = 0;
+  for (const std::vector<std::string>& batch : batches) {
+    for (const std::string& term : batch) {
+      AddHitInSection(*term_id_codec_, lite_index_.get(), term, document_id++,
+                      /*is_in_prefix_section=*/true);
+      // Some terms also have a hit that is only in an exact section.
+      if (document_id % 3 == 0) {
+        AddHitInSection(*term_id_codec_, lite_index_.get(), term, document_id++,
+                        /*is_in_prefix_section=*/false);
+      }
+    }
+    ICING_ASSERT_OK(
+        Merge(*lite_index_, *term_id_codec_, trie_main_index.get()));
+    ICING_ASSERT_OK(
+        Merge(*lite_index_, *term_id_codec_, front_coded_main_index.get()));
+    ICING_ASSERT_OK(lite_index_->Reset());
+
+    std::vector<std::string> terms = GetTerms(trie_main_index.get(), "");
+    ASSERT_THAT(GetTerms(front_coded_main_index.get(), ""), Eq(terms));
+    EXPECT_THAT(front_coded_main_index->num_terms(),
+                Eq(trie_main_index->num_terms()));
+    for (const std::string& term : terms) {
+      for (int length = 1; length <= term.length(); ++length) {
+        std::string prefix = term.substr(0, length);
+        EXPECT_THAT(
+            GetDocumentIds(GetPrefixHits(front_coded_main_index.get(), prefix)),
+            Eq(GetDocumentIds(GetPrefixHits(trie_main_index.get(), prefix))))
+            << prefix;
+      }
+      EXPECT_THAT(
+          GetDocumentIds(GetExactHits(front_coded_main_index.get(), term)),
+          Eq(GetDocumentIds(GetExactHits(trie_main_index.get(), term))))
+          << term;
+    }
+  }
+}
+
+TEST_F(MainIndexTest, FrontCodedLexiconIsPersisted) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_, MainIndex::ChampionListOptions(),
+                          MainIndex::LexiconType::kFrontCoded));
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ICING_ASSERT_OK(main_index->PersistToDisk());
+  }
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MainIndex::ChampionListOptions(),
+                        MainIndex::LexiconType::kFrontCoded));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "fool", "foot", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "fox")),
+              ElementsAre(2));
+}
+
+TEST_F(MainIndexTest, FrontCodedLexiconKeepsPendingBackfillsAndDeletes) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MainIndex::ChampionListOptions(),
+                        MainIndex::LexiconType::kFrontCoded));
+  main_index->set_max_backfill_hits_per_merge(0);
+  MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                      /*merge_stats=*/nullptr);
+  ASSERT_THAT(main_index->num_pending_backfills(), Eq(1));
+
+  EXPECT_THAT(main_index->DeleteDeadTerms(
+                  [](DocumentId document_id) { return document_id == 2; }),
+              IsOkAndHolds(2));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"), ElementsAre("fo", "foo", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+
+  // The pending backfill still finds its source once it is carried out.
+  main_index->set_max_backfill_hits_per_merge(-1);
+  AddHit(*term_id_codec_, lite_index_.get(), "bar", /*document_id=*/3);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(main_index->num_pending_backfills(), Eq(0));
+  EXPECT_THAT(GetTerms(main_index.get(), ""),
+              ElementsAre("bar", "fo", "foo", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+}
+
+TEST_F(MainIndexTest, FrontCodedLexiconDeleteDeadTermsIsPersisted) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_, MainIndex::ChampionListOptions(),
+                          MainIndex::LexiconType::kFrontCoded));
+    MergeNewBranchPoint(*term_id_codec_, lite_index_.get(), main_index.get(),
+                        /*merge_stats=*/nullptr);
+    ASSERT_THAT(main_index->DeleteDeadTerms(
+                    [](DocumentId document_id) { return document_id != 0; }),
+                IsOkAndHolds(1));
+  }
+  // The type of the lexicon is still told apart after it moved to new files.
+  EXPECT_TRUE(MainIndex::HasLexiconOfOtherType(
+      main_index_file_name, filesystem_, MainIndex::LexiconType::kDynamicTrie));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MainIndex::ChampionListOptions(),
+                        MainIndex::LexiconType::kFrontCoded));
+  EXPECT_THAT(GetTerms(main_index.get(), "f"),
+              ElementsAre("fo", "foo", "foot", "fox"));
+  EXPECT_THAT(GetDocumentIds(GetPrefixHits(main_index.get(), "fo")),
+              ElementsAre(2, 1, 0));
+}
+
+TEST_F(MainIndexTest, FrontCodedLexiconKeepsChampionLists) {
+  std::unordered_map<DocumentId, int32_t> document_scores = {
+      {0, 5}, {1, 1}, {2, 9}, {3, 3}, {4, 4}};
+  for (DocumentId document_id = 0; document_id < 4; ++document_id) {
+    AddHit(*term_id_codec_, lite_index_.get(), "foo", document_id);
+  }
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<MainIndex> main_index,
+      MainIndex::Create(main_index_file_name, &filesystem_, &icing_filesystem_,
+                        MakeChampionListOptions(/*champion_list_size=*/2,
+                                                &document_scores),
+                        MainIndex::LexiconType::kFrontCoded));
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  ICING_ASSERT_OK(lite_index_->Reset());
+
+  // "bar" comes before "foo", which moves to another term index.
+  AddHit(*term_id_codec_, lite_index_.get(), "bar", /*document_id=*/4);
+  ICING_ASSERT_OK(Merge(*lite_index_, *term_id_codec_, main_index.get()));
+  EXPECT_THAT(GetDocumentIds(GetExactHits(main_index.get(), "foo",
+                                          kSectionIdMaskAll,
+                                          /*champions_only=*/true)),
+              ElementsAre(2, 0));
+}
+
+TEST_F(MainIndexTest, CreateWithOtherLexiconTypeFails) {
+  std::string main_index_file_name = index_dir_ + "/test_file.idx.index";
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_));
+  }
+  EXPECT_TRUE(MainIndex::HasLexiconOfOtherType(
+      main_index_file_name, filesystem_, MainIndex::LexiconType::kFrontCoded));
+  EXPECT_THAT(MainIndex::Create(main_index_file_name, &filesystem_,
+                                &icing_filesystem_,
+                                MainIndex::ChampionListOptions(),
+                                MainIndex::LexiconType::kFrontCoded),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+
+  ASSERT_TRUE(
+      filesystem_.DeleteDirectoryRecursively(main_index_file_name.c_str()));
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<MainIndex> main_index,
+        MainIndex::Create(main_index_file_name, &filesystem_,
+                          &icing_filesystem_, MainIndex::ChampionListOptions(),
+                          MainIndex::LexiconType::kFrontCoded));
+  }
+  EXPECT_THAT(MainIndex::Create(main_index_file_name, &filesystem_,
+                                &icing_filesystem_),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+}
+
 }  // namespace
 
 }  // namespace lib
@@ -86,8 +86,13 @@ libtextclassifier3::Status PostingListAccessor::PrependHit(const Hit &hit) {
   PostingListUsed &active_pl = (preexisting_posting_list_ != nullptr)
                                    ? preexisting_posting_list_->posting_list
                                    : posting_list_buffer_;
+  uint32_t bytes_used = active_pl.BytesUsed();
   libtextclassifier3::Status status = active_pl.PrependHit(hit);
   if (!absl_ports::IsResourceExhausted(status)) {
+    if (status.ok() && preexisting_posting_list_ != nullptr) {
+      // The hit went straight into the posting list in storage.
+      storage_->CountBytesWritten(active_pl.BytesUsed() - bytes_used);
+    }
     return status;
   }
   // There is no more room to add hits to this current posting list! Therefore,
@@ -124,6 +129,7 @@ void PostingListAccessor::FlushPreexistingPostingList() {
     // no more use for it. Make it available to be used for another posting
     // list.
     storage_->FreePostingList(std::move(*preexisting_posting_list_));
+    storage_->CountPostingListMove();
   }
   preexisting_posting_list_.reset();
 }
@@ -137,6 +143,7 @@ libtextclassifier3::Status PostingListAccessor::FlushInMemoryPostingList() {
                          storage_->AllocatePostingList(max_posting_list_bytes));
   holder.block.set_next_block_index(prev_block_identifier_.block_index());
   prev_block_identifier_ = holder.id;
+  storage_->CountBytesWritten(posting_list_buffer_.BytesUsed());
   return holder.posting_list.MoveFrom(&posting_list_buffer_);
 }
 
@@ -180,6 +187,8 @@ PostingListAccessor::FinalizeResult PostingListAccessor::Finalize(
   // is valid because we created it in-memory. And finally, we know that the
   // hits from posting_list_buffer_ will fit in editor.posting_list() because we
   // requested it be at at least posting_list_bytes large.
+  accessor.storage_->CountBytesWritten(
+      accessor.posting_list_buffer_.BytesUsed());
   auto status = holder.posting_list.MoveFrom(&accessor.posting_list_buffer_);
   if (!status.ok()) {
     FinalizeResult result = {std::move(status),
@@ -0,0 +1,557 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/segmented-main-index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/doc-hit-info.h"
+#include "icing/index/hit/hit.h"
+#include "icing/index/lite/lite-index.h"
+#include "icing/index/lite/term-id-hit-pair.h"
+#include "icing/index/main/front-coded-lexicon.h"
+#include "icing/index/main/index-segment.h"
+#include "icing/index/term-id-codec.h"
+#include "icing/index/term-property-id.h"
+#include "icing/legacy/core/icing-string-util.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/util/crc32.h"
+#include "icing/util/logging.h"
+#include "icing/util/status-macros.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+constexpr char kManifestFilename[] = "manifest";
+constexpr char kSegmentDirectoryPrefix[] = "segment_";
+
+struct ManifestHeader {
+  static constexpr int32_t kMagic = 0x736d6978;
+
+  int32_t magic;
+  DocumentId last_added_document_id;
+  uint32_t next_segment_id;
+  uint32_t num_segments;
+  // Of the fields above and the segment ids that follow the header.
+  uint32_t checksum;
+};
+
+uint32_t ComputeManifestChecksum(const ManifestHeader& header,
+                                 const std::vector<uint32_t>& segment_ids) {
+  Crc32 crc;
+  crc.Append(std::string_view(reinterpret_cast<const char*>(&header),
+                              offsetof(ManifestHeader, checksum)));
+  return crc.Append(
+      std::string_view(reinterpret_cast<const char*>(segment_ids.data()),
+                       segment_ids.size() * sizeof(uint32_t)));
+}
+
+int GetTier(int64_t num_hits) {
+  int tier = 0;
+  for (int64_t max_num_hits = SegmentedMainIndex::kTier0MaxNumHits;
+       num_hits >= max_num_hits;
+       max_num_hits *= SegmentedMainIndex::kMergeFactor) {
+    ++tier;
+  }
+  return tier;
+}
+
+// Adds the DocHitInfos of hits in the sections of section_id_mask to
+// hits_out, skipping hits in non-prefix sections if only_from_prefix_sections
+// is true. hits must be sorted.
+void AppendDocHitInfos(const std::vector<Hit>& hits,
+                       SectionIdMask section_id_mask,
+                       bool only_from_prefix_sections,
+                       std::vector<DocHitInfo>* hits_out) {
+  DocumentId last_document_id = kInvalidDocumentId;
+  for (const Hit& hit : hits) {
+    if (((1u << hit.section_id()) & section_id_mask) == 0 ||
+        (only_from_prefix_sections && !hit.is_in_prefix_section())) {
+      continue;
+    }
+    if (hit.document_id() != last_document_id) {
+      last_document_id = hit.document_id();
+      hits_out->push_back(DocHitInfo(last_document_id));
+    }
+    hits_out->back().UpdateSection(hit.section_id(), hit.term_frequency());
+  }
+}
+
+std::atomic<uint64_t> next_instance_id{0};
+
+}  // namespace
+
+SegmentedMainIndex::SegmentedMainIndex(std::string index_directory,
+                                       const Filesystem* filesystem)
+    : index_directory_(std::move(index_directory)),
+      filesystem_(filesystem),
+      instance_id_(next_instance_id++) {}
+
+libtextclassifier3::StatusOr<std::unique_ptr<SegmentedMainIndex>>
+SegmentedMainIndex::Create(const std::string& index_directory,
+                           const Filesystem* filesystem) {
+  ICING_RETURN_ERROR_IF_NULL(filesystem);
+  std::unique_ptr<SegmentedMainIndex> index(
+      new SegmentedMainIndex(index_directory, filesystem));
+  ICING_RETURN_IF_ERROR(index->Initialize());
+  return index;
+}
+
+libtextclassifier3::Status SegmentedMainIndex::Initialize() {
+  if (!filesystem_->CreateDirectoryRecursively(index_directory_.c_str())) {
+    return absl_ports::InternalError(absl_ports::StrCat(
+        "Failed to create directory: ", index_directory_));
+  }
+
+  std::string manifest_filename =
+      absl_ports::StrCat(index_directory_, "/", kManifestFilename);
+  if (filesystem_->FileExists(manifest_filename.c_str())) {
+    ScopedFd sfd(filesystem_->OpenForRead(manifest_filename.c_str()));
+    ManifestHeader header;
+    if (!sfd.is_valid() ||
+        !filesystem_->Read(sfd.get(), &header, sizeof(header))) {
+      return absl_ports::InternalError("Failed to read manifest");
+    }
+    if (header.magic != ManifestHeader::kMagic ||
+        filesystem_->GetFileSize(sfd.get()) !=
+            static_cast<int64_t>(sizeof(header) +
+                                 header.num_segments * sizeof(uint32_t))) {
+      return absl_ports::DataLossError("Manifest is corrupted");
+    }
+    std::vector<uint32_t> segment_ids(header.num_segments);
+    if (!filesystem_->Read(sfd.get(), segment_ids.data(),
+                           segment_ids.size() * sizeof(uint32_t))) {
+      return absl_ports::InternalError("Failed to read manifest");
+    }
+    if (ComputeManifestChecksum(header, segment_ids) != header.checksum) {
+      return absl_ports::DataLossError("Manifest checksum doesn't match");
+    }
+    last_added_document_id_ = header.last_added_document_id;
+    next_segment_id_ = header.next_segment_id;
+    for (uint32_t segment_id : segment_ids) {
+      ICING_ASSIGN_OR_RETURN(
+          std::unique_ptr<IndexSegment> segment,
+          IndexSegment::Open(filesystem_, MakeSegmentDirectory(segment_id)));
+      segments_.push_back(std::move(segment));
+      segment_ids_.push_back(segment_id);
+    }
+  }
+
+  // Delete segments written by merges that didn't finish.
+  std::vector<std::string> entries;
+  if (!filesystem_->ListDirectory(index_directory_.c_str(), &entries)) {
+    return absl_ports::InternalError(absl_ports::StrCat(
+        "Failed to list directory: ", index_directory_));
+  }
+  std::unordered_set<std::string> live_directories;
+  for (uint32_t segment_id : segment_ids_) {
+    live_directories.insert(absl_ports::StrCat(kSegmentDirectoryPrefix,
+                                               std::to_string(segment_id)));
+  }
+  for (const std::string& entry : entries) {
+    if (entry.rfind(kSegmentDirectoryPrefix, 0) == 0 &&
+        live_directories.find(entry) == live_directories.end()) {
+      ICING_LOG(WARNING) << "Deleting leftover segment " << entry;
+      filesystem_->DeleteDirectoryRecursively(
+          absl_ports::StrCat(index_directory_, "/", entry).c_str());
+    }
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status SegmentedMainIndex::WriteManifest() {
+  ManifestHeader header;
+  header.magic = ManifestHeader::kMagic;
+  header.last_added_document_id = last_added_document_id_;
+  header.next_segment_id = next_segment_id_;
+  header.num_segments = segment_ids_.size();
+  header.checksum = ComputeManifestChecksum(header, segment_ids_);
+
+  std::string manifest_filename =
+      absl_ports::StrCat(index_directory_, "/", kManifestFilename);
+  std::string temp_filename = manifest_filename + ".tmp";
+  {
+    ScopedFd sfd(filesystem_->OpenForWrite(temp_filename.c_str()));
+    if (!sfd.is_valid() || !filesystem_->Truncate(sfd.get(), 0) ||
+        !filesystem_->Write(sfd.get(), &header, sizeof(header)) ||
+        !filesystem_->Write(sfd.get(), segment_ids_.data(),
+                            segment_ids_.size() * sizeof(uint32_t)) ||
+        !filesystem_->DataSync(sfd.get())) {
+      return absl_ports::InternalError("Failed to write manifest");
+    }
+  }
+  if (!filesystem_->RenameFile(temp_filename.c_str(),
+                               manifest_filename.c_str())) {
+    return absl_ports::InternalError("Failed to replace manifest");
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+std::string SegmentedMainIndex::MakeSegmentDirectory(
+    uint32_t segment_id) const {
+  return absl_ports::StrCat(index_directory_, "/", kSegmentDirectoryPrefix,
+                            std::to_string(segment_id));
+}
+
+libtextclassifier3::Status SegmentedMainIndex::Merge(
+    const LiteIndex& lite_index, const TermIdCodec& term_id_codec) {
+  // Sorting by value groups the hits by term id, and sorts each term's hits.
+  std::vector<TermIdHitPair> term_id_hit_pairs;
+  term_id_hit_pairs.reserve(lite_index.size());
+  for (const TermIdHitPair& term_id_hit_pair : lite_index) {
+    term_id_hit_pairs.push_back(term_id_hit_pair);
+  }
+  std::sort(term_id_hit_pairs.begin(), term_id_hit_pairs.end(),
+            [](const TermIdHitPair& lhs, const TermIdHitPair& rhs) {
+              return lhs.value() < rhs.value();
+            });
+
+  if (!term_id_hit_pairs.empty()) {
+    uint32_t segment_id = next_segment_id_++;
+    ICING_ASSIGN_OR_RETURN(
+        std::unique_ptr<IndexSegment::Builder> builder,
+        IndexSegment::Builder::Create(filesystem_,
+                                      MakeSegmentDirectory(segment_id)));
+    const IcingDynamicTrie& lexicon = lite_index.lexicon();
+    IcingDynamicTrie::PropertyReadersAll property_reader(lexicon);
+    IndexSegment::Postings postings;
+    for (IcingDynamicTrie::Iterator itr(lexicon, /*prefix=*/"");
+         itr.IsValid(); itr.Advance()) {
+      ICING_ASSIGN_OR_RETURN(
+          uint32_t term_id,
+          term_id_codec.EncodeTvi(itr.GetValueIndex(), TviType::LITE));
+      auto range = std::equal_range(
+          term_id_hit_pairs.begin(), term_id_hit_pairs.end(),
+          TermIdHitPair(term_id, Hit(Hit::kMaxDocumentIdSortValue)),
+          [](const TermIdHitPair& lhs, const TermIdHitPair& rhs) {
+            return lhs.term_id() < rhs.term_id();
+          });
+      if (range.first == range.second) {
+        continue;
+      }
+
+      postings.hits.clear();
+      for (auto pair = range.first; pair != range.second; ++pair) {
+        Hit hit = pair->hit();
+        if (!postings.hits.empty() && postings.hits.back() == hit) {
+          continue;
+        }
+        postings.hits.push_back(hit);
+      }
+      postings.namespace_ids.clear();
+      for (uint32_t property_id = GetNamespacePropertyId(0);
+           property_id < property_reader.size(); ++property_id) {
+        if (property_reader.HasProperty(property_id, itr.GetValueIndex())) {
+          postings.namespace_ids.push_back(property_id -
+                                           GetNamespacePropertyId(0));
+        }
+      }
+      ICING_RETURN_IF_ERROR(builder->AddTerm(itr.GetKey(), postings));
+    }
+    ICING_ASSIGN_OR_RETURN(std::unique_ptr<IndexSegment> segment,
+                           builder->Finish());
+    segments_.push_back(std::move(segment));
+    segment_ids_.push_back(segment_id);
+  }
+  if (lite_index.last_added_document_id() != kInvalidDocumentId) {
+    last_added_document_id_ = lite_index.last_added_document_id();
+  }
+  return WriteManifest();
+}
+
+libtextclassifier3::Status SegmentedMainIndex::Compact() {
+  while (true) {
+    ICING_ASSIGN_OR_RETURN(std::unique_ptr<Compaction> compaction,
+                           PrepareCompaction());
+    if (compaction == nullptr) {
+      return libtextclassifier3::Status::OK;
+    }
+    ICING_RETURN_IF_ERROR(CommitCompaction(std::move(compaction)));
+  }
+}
+
+libtextclassifier3::StatusOr<bool> SegmentedMainIndex::CompactNextRun() {
+  ICING_ASSIGN_OR_RETURN(std::unique_ptr<Compaction> compaction,
+                         PrepareCompaction());
+  if (compaction != nullptr) {
+    ICING_RETURN_IF_ERROR(CommitCompaction(std::move(compaction)));
+  }
+  return WantsCompaction();
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<SegmentedMainIndex::Compaction>>
+SegmentedMainIndex::PrepareCompaction() const {
+  int begin;
+  int end;
+  if (!FindRunToCompact(&begin, &end)) {
+    return nullptr;
+  }
+  auto compaction = std::make_unique<Compaction>();
+  compaction->instance_id = instance_id_;
+  compaction->run_segment_ids.assign(segment_ids_.begin() + begin,
+                                     segment_ids_.begin() + end);
+  compaction->segment_id = next_segment_id_++;
+  libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>> segment_or =
+      WriteCompactedSegment(begin, end, compaction->segment_id);
+  if (!segment_or.ok()) {
+    filesystem_->DeleteDirectoryRecursively(
+        MakeSegmentDirectory(compaction->segment_id).c_str());
+    return segment_or.status();
+  }
+  compaction->segment = std::move(segment_or).ValueOrDie();
+  return compaction;
+}
+
+libtextclassifier3::Status SegmentedMainIndex::CommitCompaction(
+    std::unique_ptr<Compaction> compaction) {
+  if (!PreparedCompaction(*compaction)) {
+    // The directory may belong to a segment of the index that replaced the
+    // one that prepared the compaction, so leave it alone. Create deleted it
+    // if not.
+    return absl_ports::FailedPreconditionError(
+        "Compaction was prepared by another index");
+  }
+  auto run = std::search(segment_ids_.begin(), segment_ids_.end(),
+                         compaction->run_segment_ids.begin(),
+                         compaction->run_segment_ids.end());
+  if (run == segment_ids_.end()) {
+    std::string directory = compaction->segment->directory();
+    compaction.reset();
+    filesystem_->DeleteDirectoryRecursively(directory.c_str());
+    return absl_ports::FailedPreconditionError(
+        "Segments changed since the compaction was prepared");
+  }
+  int begin = run - segment_ids_.begin();
+  int end = begin + compaction->run_segment_ids.size();
+
+  // Swap in the new segment. The old ones can only be deleted once the
+  // manifest doesn't list them anymore.
+  std::vector<std::string> old_directories;
+  for (int i = begin; i < end; ++i) {
+    old_directories.push_back(segments_[i]->directory());
+  }
+  segments_.erase(segments_.begin() + begin + 1, segments_.begin() + end);
+  segment_ids_.erase(segment_ids_.begin() + begin + 1,
+                     segment_ids_.begin() + end);
+  segments_[begin] = std::move(compaction->segment);
+  segment_ids_[begin] = compaction->segment_id;
+  ICING_RETURN_IF_ERROR(WriteManifest());
+  for (const std::string& directory : old_directories) {
+    filesystem_->DeleteDirectoryRecursively(directory.c_str());
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+bool SegmentedMainIndex::FindRunToCompact(int* begin, int* end) const {
+  *end = segments_.size();
+  while (*end > 0) {
+    int tier = GetTier(segments_[*end - 1]->num_hits());
+    *begin = *end - 1;
+    while (*begin > 0 && GetTier(segments_[*begin - 1]->num_hits()) == tier) {
+      --*begin;
+    }
+    if (*end - *begin >= kMergeFactor) {
+      return true;
+    }
+    *end = *begin;
+  }
+  return false;
+}
+
+libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>>
+SegmentedMainIndex::WriteCompactedSegment(int begin, int end,
+                                          uint32_t segment_id) const {
+  ICING_ASSIGN_OR_RETURN(
+      std::unique_ptr<IndexSegment::Builder> builder,
+      IndexSegment::Builder::Create(filesystem_,
+                                    MakeSegmentDirectory(segment_id)));
+
+  // Merge the segments' lexicons. A term's hits in newer segments are for
+  // larger document ids, so concatenating them newest first keeps them
+  // sorted.
+  std::vector<FrontCodedLexicon::Iterator> itrs;
+  for (int i = end - 1; i >= begin; --i) {
+    itrs.push_back(segments_[i]->lexicon().GetIterator(/*prefix=*/""));
+  }
+  IndexSegment::Postings merged;
+  while (true) {
+    const std::string* term = nullptr;
+    for (const FrontCodedLexicon::Iterator& itr : itrs) {
+      if (itr.IsValid() && (term == nullptr || itr.GetTerm() < *term)) {
+        term = &itr.GetTerm();
+      }
+    }
+    if (term == nullptr) {
+      break;
+    }
+    std::string current_term = *term;
+
+    merged.namespace_ids.clear();
+    merged.hits.clear();
+    for (size_t i = 0; i < itrs.size(); ++i) {
+      FrontCodedLexicon::Iterator& itr = itrs[i];
+      if (!itr.IsValid() || itr.GetTerm() != current_term) {
+        continue;
+      }
+      ICING_ASSIGN_OR_RETURN(
+          IndexSegment::Postings postings,
+          segments_[end - 1 - i]->GetPostings(itr.GetTermIndex()));
+      merged.namespace_ids.insert(merged.namespace_ids.end(),
+                                  postings.namespace_ids.begin(),
+                                  postings.namespace_ids.end());
+      merged.hits.insert(merged.hits.end(), postings.hits.begin(),
+                         postings.hits.end());
+      itr.Advance();
+    }
+    std::sort(merged.namespace_ids.begin(), merged.namespace_ids.end());
+    merged.namespace_ids.erase(
+        std::unique(merged.namespace_ids.begin(), merged.namespace_ids.end()),
+        merged.namespace_ids.end());
+    ICING_RETURN_IF_ERROR(builder->AddTerm(current_term, merged));
+  }
+  return builder->Finish();
+}
+
+libtextclassifier3::Status SegmentedMainIndex::AppendHits(
+    const std::string& term, bool is_prefix, SectionIdMask section_id_mask,
+    std::vector<DocHitInfo>* hits_out) const {
+  for (auto segment = segments_.rbegin(); segment != segments_.rend();
+       ++segment) {
+    const FrontCodedLexicon& lexicon = (*segment)->lexicon();
+    if (!is_prefix) {
+      uint32_t term_index;
+      if (!lexicon.Find(term, &term_index)) {
+        continue;
+      }
+      ICING_ASSIGN_OR_RETURN(IndexSegment::Postings postings,
+                             (*segment)->GetPostings(term_index));
+      AppendDocHitInfos(postings.hits, section_id_mask,
+                        /*only_from_prefix_sections=*/false, hits_out);
+      continue;
+    }
+    for (FrontCodedLexicon::Iterator itr = lexicon.GetIterator(term);
+         itr.IsValid(); itr.Advance()) {
+      ICING_ASSIGN_OR_RETURN(IndexSegment::Postings postings,
+                             (*segment)->GetPostings(itr.GetTermIndex()));
+      AppendDocHitInfos(
+          postings.hits, section_id_mask,
+          /*only_from_prefix_sections=*/itr.GetTerm().size() != term.size(),
+          hits_out);
+    }
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<std::vector<TermMetadata>>
+SegmentedMainIndex::FindTermsByPrefix(
+    const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
+    int num_to_return) const {
+  // The first num_to_return terms of each segment include the first
+  // num_to_return terms of all segments.
+  std::map<std::string, int> hit_counts;
+  for (const std::unique_ptr<IndexSegment>& segment : segments_) {
+    int num_terms = 0;
+    for (FrontCodedLexicon::Iterator itr =
+             segment->lexicon().GetIterator(prefix);
+         itr.IsValid() && num_terms < num_to_return; itr.Advance()) {
+      if (!namespace_ids.empty()) {
+        ICING_ASSIGN_OR_RETURN(IndexSegment::Postings postings,
+                               segment->GetPostings(itr.GetTermIndex()));
+        if (std::none_of(postings.namespace_ids.begin(),
+                         postings.namespace_ids.end(),
+                         [&namespace_ids](NamespaceId namespace_id) {
+                           return std::find(namespace_ids.begin(),
+                                            namespace_ids.end(),
+                                            namespace_id) !=
+                                  namespace_ids.end();
+                         })) {
+          continue;
+        }
+      }
+      hit_counts[itr.GetTerm()] += segment->GetNumHits(itr.GetTermIndex());
+      ++num_terms;
+    }
+  }
+
+  std::vector<TermMetadata> term_metadata_list;
+  for (auto& [term, hit_count] : hit_counts) {
+    if (static_cast<int>(term_metadata_list.size()) >= num_to_return) {
+      break;
+    }
+    term_metadata_list.emplace_back(term, hit_count);
+  }
+  return term_metadata_list;
+}
+
+libtextclassifier3::Status SegmentedMainIndex::Reset() {
+  std::vector<std::string> directories;
+  for (const std::unique_ptr<IndexSegment>& segment : segments_) {
+    directories.push_back(segment->directory());
+  }
+  segments_.clear();
+  segment_ids_.clear();
+  last_added_document_id_ = kInvalidDocumentId;
+  ICING_RETURN_IF_ERROR(WriteManifest());
+  for (const std::string& directory : directories) {
+    filesystem_->DeleteDirectoryRecursively(directory.c_str());
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::StatusOr<int64_t> SegmentedMainIndex::GetElementsSize()
+    const {
+  int64_t size = 0;
+  for (const std::unique_ptr<IndexSegment>& segment : segments_) {
+    int64_t segment_size = segment->GetDiskUsage();
+    if (segment_size == Filesystem::kBadFileSize) {
+      return absl_ports::InternalError("Failed to get size of segment");
+    }
+    size += segment_size;
+  }
+  return size;
+}
+
+void SegmentedMainIndex::GetDebugInfo(int verbosity, std::string* out) const {
+  IcingStringUtil::SStringAppendF(
+      out, 0, "Segmented main index: %zu segments\n", segments_.size());
+  if (verbosity <= 0) {
+    return;
+  }
+  for (size_t i = 0; i < segments_.size(); ++i) {
+    IcingStringUtil::SStringAppendF(
+        out, 0, "  segment %u: %u terms, %lld hits, tier %d\n",
+        segment_ids_[i], segments_[i]->lexicon().size(),
+        static_cast<long long>(segments_[i]->num_hits()),
+        GetTier(segments_[i]->num_hits()));
+  }
+}
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,232 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_INDEX_MAIN_SEGMENTED_MAIN_INDEX_H_
+#define ICING_INDEX_MAIN_SEGMENTED_MAIN_INDEX_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/doc-hit-info.h"
+#include "icing/index/lite/lite-index.h"
+#include "icing/index/main/index-segment.h"
+#include "icing/index/term-id-codec.h"
+#include "icing/index/term-metadata.h"
+#include "icing/schema/section.h"
+#include "icing/store/document-id.h"
+#include "icing/store/namespace-id.h"
+
+namespace icing {
+namespace lib {
+
+// A log-structured alternative to MainIndex. Every merge of the lite index
+// writes a new immutable IndexSegment sequentially instead of updating posting
+// lists in place, and queries union the hits of all segments.
+//
+// Segments are ordered by the documents they hold: since document ids only
+// grow, every segment holds larger document ids than the segments before it.
+// To keep the number of segments bounded, runs of kMergeFactor adjacent
+// segments of the same tier are compacted into one. Merges only write their
+// own segment and leave compaction to the caller, who can run it in the
+// background. A segment's tier grows with the log of its number of hits, so
+// every hit is rewritten O(log(num_hits)) times in total.
+//
+// The list of segments is kept in a manifest, which is replaced atomically
+// whenever it changes. Segment directories that aren't in the manifest are
+// leftovers of interrupted merges and are deleted on Create.
+//
+// Since segments are immutable, compacting them is split in two: writing the
+// compacted segment only reads the index and can run alongside queries, and
+// only swapping it into the manifest changes the index.
+class SegmentedMainIndex {
+ public:
+  // A compacted segment that isn't part of the index yet. Made by
+  // PrepareCompaction and swapped in by CommitCompaction.
+  struct Compaction {
+    // The index that prepared the compaction.
+    uint64_t instance_id;
+    // The ids of the run of segments that were compacted.
+    std::vector<uint32_t> run_segment_ids;
+    uint32_t segment_id;
+    std::unique_ptr<IndexSegment> segment;
+  };
+
+  // The number of adjacent segments of a tier that are compacted together.
+  static constexpr int kMergeFactor = 4;
+
+  // Segments with fewer hits than this are in tier 0. Each following tier
+  // holds segments with kMergeFactor times as many hits.
+  static constexpr int64_t kTier0MaxNumHits = 64 * 1024;
+
+  // Returns:
+  //   A SegmentedMainIndex on success
+  //   DATA_LOSS if the manifest or a segment is corrupted
+  //   INTERNAL on I/O error
+  static libtextclassifier3::StatusOr<std::unique_ptr<SegmentedMainIndex>>
+  Create(const std::string& index_directory, const Filesystem* filesystem);
+
+  // Writes the hits in lite_index to a new segment. Doesn't compact
+  // segments, see WantsCompaction.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Merge(const LiteIndex& lite_index,
+                                   const TermIdCodec& term_id_codec);
+
+  // Writes the newest run of kMergeFactor or more adjacent segments of the
+  // same tier into a new segment, without changing the index. Only reads the
+  // index, so it may run alongside queries, but not alongside calls that
+  // change the index.
+  //
+  // Returns:
+  //   The compaction on success, or nullptr if there is no run to compact
+  //   DATA_LOSS if a segment is corrupted
+  //   INTERNAL on I/O error
+  libtextclassifier3::StatusOr<std::unique_ptr<Compaction>>
+  PrepareCompaction() const;
+
+  // Whether compaction was prepared by this index.
+  bool PreparedCompaction(const Compaction& compaction) const {
+    return compaction.instance_id == instance_id_;
+  }
+
+  // Replaces the run of segments that compaction was prepared from with the
+  // compacted segment.
+  //
+  // Returns:
+  //   OK on success
+  //   FAILED_PRECONDITION if compaction was prepared by another index, or if
+  //     the run was changed since. The compaction is dropped.
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status CommitCompaction(
+      std::unique_ptr<Compaction> compaction);
+
+  // Compacts runs of kMergeFactor or more adjacent segments of the same tier
+  // until there are none left.
+  //
+  // Returns:
+  //   OK on success
+  //   DATA_LOSS if a segment is corrupted
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status Compact();
+
+  // Whether there is a run of kMergeFactor or more adjacent segments of the
+  // same tier that Compact or CompactNextRun would compact.
+  bool WantsCompaction() const {
+    int begin;
+    int end;
+    return FindRunToCompact(&begin, &end);
+  }
+
+  // Compacts the newest run of kMergeFactor or more adjacent segments of the
+  // same tier, if there is one. Lets callers spread compaction out into
+  // pieces of bounded length.
+  //
+  // Returns:
+  //   Whether there are more runs to compact on success
+  //   DATA_LOSS if a segment is corrupted
+  //   INTERNAL on I/O error
+  libtextclassifier3::StatusOr<bool> CompactNextRun();
+
+  // Adds the DocHitInfos of term's hits in the sections of section_id_mask to
+  // hits_out, newest segment first. If is_prefix is true, hits of terms that
+  // term is a prefix of are added too, if they're in prefix sections. Each
+  // segment's DocHitInfos are in descending document id order, but with
+  // is_prefix the same document may be added more than once.
+  //
+  // Returns:
+  //   OK on success
+  //   DATA_LOSS if a segment is corrupted
+  //   INTERNAL on I/O error
+  libtextclassifier3::Status AppendHits(
+      const std::string& term, bool is_prefix, SectionIdMask section_id_mask,
+      std::vector<DocHitInfo>* hits_out) const;
+
+  // Finds terms with the given prefix in the given namespaces, or in all
+  // namespaces if namespace_ids is empty. Results are in lexicographical
+  // order and no more than num_to_return.
+  //
+  // Returns:
+  //   A list of TermMetadata on success
+  //   INTERNAL_ERROR if failed to access term data
+  libtextclassifier3::StatusOr<std::vector<TermMetadata>> FindTermsByPrefix(
+      const std::string& prefix, const std::vector<NamespaceId>& namespace_ids,
+      int num_to_return) const;
+
+  // Deletes all segments.
+  libtextclassifier3::Status Reset();
+
+  // The largest document id merged into the index, or kInvalidDocumentId.
+  DocumentId last_added_document_id() const { return last_added_document_id_; }
+
+  int num_segments() const { return segments_.size(); }
+
+  // Returns:
+  //   The number of bytes the segments take up on disk on success
+  //   INTERNAL on I/O error
+  libtextclassifier3::StatusOr<int64_t> GetElementsSize() const;
+
+  // Returns debug information about the segments in out.
+  void GetDebugInfo(int verbosity, std::string* out) const;
+
+ private:
+  SegmentedMainIndex(std::string index_directory, const Filesystem* filesystem);
+
+  // Loads the manifest and the segments it lists, and deletes leftover
+  // segment directories. Creates an empty index if there's no manifest.
+  libtextclassifier3::Status Initialize();
+
+  // Replaces the manifest with one that lists segments_.
+  libtextclassifier3::Status WriteManifest();
+
+  // Returns the directory of the segment with the given id.
+  std::string MakeSegmentDirectory(uint32_t segment_id) const;
+
+  // Finds the newest run of at least kMergeFactor adjacent segments of one
+  // tier and sets [begin, end) to it. Returns false if there is none.
+  bool FindRunToCompact(int* begin, int* end) const;
+
+  // Merges segments_[begin, end) into a new segment with the given id.
+  libtextclassifier3::StatusOr<std::unique_ptr<IndexSegment>>
+  WriteCompactedSegment(int begin, int end, uint32_t segment_id) const;
+
+  std::string index_directory_;
+  const Filesystem* filesystem_;
+
+  // Unique among all SegmentedMainIndex instances of the process, so that
+  // compactions are never committed to an index that was recreated since.
+  const uint64_t instance_id_;
+
+  // Oldest first, along with their ids.
+  std::vector<std::unique_ptr<IndexSegment>> segments_;
+  std::vector<uint32_t> segment_ids_;
+
+  // Compactions take segment ids while they're prepared alongside each other.
+  // Ids are never reused by an instance, so a run of segment ids always
+  // refers to the same segments.
+  mutable std::atomic<uint32_t> next_segment_id_{0};
+  DocumentId last_added_document_id_ = kInvalidDocumentId;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_INDEX_MAIN_SEGMENTED_MAIN_INDEX_H_
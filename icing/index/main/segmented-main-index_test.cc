@@ -0,0 +1,438 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/index/main/segmented-main-index.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/filesystem.h"
+#include "icing/index/hit/doc-hit-info.h"
+#include "icing/index/iterator/doc-hit-info-iterator.h"
+#include "icing/index/lite/lite-index.h"
+#include "icing/index/main/doc-hit-info-iterator-term-segmented.h"
+#include "icing/index/term-id-codec.h"
+#include "icing/legacy/index/icing-dynamic-trie.h"
+#include "icing/legacy/index/icing-filesystem.h"
+#include "icing/schema/section.h"
+#include "icing/store/document-id.h"
+#include "icing/store/namespace-id.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::NotNull;
+
+constexpr SectionId kSectionId0 = 0;
+constexpr SectionId kSectionId1 = 1;
+constexpr NamespaceId kNamespace0 = 0;
+constexpr NamespaceId kNamespace1 = 1;
+
+std::vector<DocHitInfo> GetHits(std::unique_ptr<DocHitInfoIterator> iterator) {
+  std::vector<DocHitInfo> infos;
+  while (iterator->Advance().ok()) {
+    infos.push_back(iterator->doc_hit_info());
+  }
+  return infos;
+}
+
+std::vector<DocHitInfo> GetExactHits(
+    const SegmentedMainIndex* index, const std::string& term,
+    SectionIdMask section_mask = kSectionIdMaskAll) {
+  return GetHits(std::make_unique<DocHitInfoIteratorTermSegmentedExact>(
+      index, term, section_mask));
+}
+
+std::vector<DocHitInfo> GetPrefixHits(
+    const SegmentedMainIndex* index, const std::string& term,
+    SectionIdMask section_mask = kSectionIdMaskAll) {
+  return GetHits(std::make_unique<DocHitInfoIteratorTermSegmentedPrefix>(
+      index, term, section_mask));
+}
+
+MATCHER_P2(EqualsDocHitInfo, document_id, section_mask, "") {
+  const DocHitInfo& actual = arg;
+  *result_listener << "actual is {document_id=" << actual.document_id()
+                   << ", section_mask=" << actual.hit_section_ids_mask()
+                   << "}";
+  return actual.document_id() == document_id &&
+         actual.hit_section_ids_mask() == section_mask;
+}
+
+class SegmentedMainIndexTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = GetTestTempDir() + "/segmented_main_index_test";
+    index_dir_ = test_dir_ + "/segments";
+    ASSERT_TRUE(filesystem_.CreateDirectoryRecursively(test_dir_.c_str()));
+
+    LiteIndex::Options options(test_dir_ + "/lite.",
+                               /*hit_buffer_want_merge_bytes=*/1024 * 1024);
+    ICING_ASSERT_OK_AND_ASSIGN(lite_index_,
+                               LiteIndex::Create(options, &icing_filesystem_));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        term_id_codec_,
+        TermIdCodec::Create(
+            IcingDynamicTrie::max_value_index(IcingDynamicTrie::Options()),
+            IcingDynamicTrie::max_value_index(options.lexicon_options)));
+  }
+
+  void TearDown() override {
+    ASSERT_TRUE(filesystem_.DeleteDirectoryRecursively(test_dir_.c_str()));
+  }
+
+  // Adds a hit of term to the lite index.
+  void AddHit(const std::string& term, DocumentId document_id,
+              SectionId section_id, bool is_in_prefix_section,
+              NamespaceId namespace_id = kNamespace0) {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        uint32_t tvi,
+        lite_index_->InsertTerm(
+            term,
+            is_in_prefix_section ? TermMatchType::PREFIX
+                                 : TermMatchType::EXACT_ONLY,
+            namespace_id));
+    ICING_ASSERT_OK_AND_ASSIGN(uint32_t term_id,
+                               term_id_codec_->EncodeTvi(tvi, TviType::LITE));
+    Hit hit(section_id, document_id, Hit::kDefaultTermFrequency,
+            is_in_prefix_section);
+    ICING_ASSERT_OK(lite_index_->AddHit(term_id, hit));
+    lite_index_->set_last_added_document_id(document_id);
+  }
+
+  // Merges the lite index into index and resets the lite index.
+  void Merge(SegmentedMainIndex* index) {
+    ICING_ASSERT_OK(index->Merge(*lite_index_, *term_id_codec_));
+    ICING_ASSERT_OK(lite_index_->Reset());
+  }
+
+  std::string test_dir_;
+  std::string index_dir_;
+  Filesystem filesystem_;
+  IcingFilesystem icing_filesystem_;
+  std::unique_ptr<LiteIndex> lite_index_;
+  std::unique_ptr<TermIdCodec> term_id_codec_;
+};
+
+TEST_F(SegmentedMainIndexTest, EmptyIndex) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->num_segments(), Eq(0));
+  EXPECT_THAT(index->last_added_document_id(), Eq(kInvalidDocumentId));
+  EXPECT_THAT(GetExactHits(index.get(), "foo"), IsEmpty());
+  EXPECT_THAT(GetPrefixHits(index.get(), "foo"), IsEmpty());
+}
+
+TEST_F(SegmentedMainIndexTest, ExactHitsAcrossSegments) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  AddHit("foo", /*document_id=*/0, kSectionId0, /*is_in_prefix_section=*/false);
+  AddHit("foo", /*document_id=*/1, kSectionId1, /*is_in_prefix_section=*/false);
+  AddHit("fool", /*document_id=*/1, kSectionId0,
+         /*is_in_prefix_section=*/false);
+  Merge(index.get());
+  AddHit("foo", /*document_id=*/2, kSectionId0, /*is_in_prefix_section=*/false);
+  AddHit("foo", /*document_id=*/2, kSectionId1, /*is_in_prefix_section=*/false);
+  Merge(index.get());
+
+  EXPECT_THAT(index->num_segments(), Eq(2));
+  EXPECT_THAT(index->last_added_document_id(), Eq(2));
+  EXPECT_THAT(GetExactHits(index.get(), "foo"),
+              ElementsAre(EqualsDocHitInfo(2, 0b11), EqualsDocHitInfo(1, 0b10),
+                          EqualsDocHitInfo(0, 0b01)));
+  EXPECT_THAT(GetExactHits(index.get(), "foo", /*section_mask=*/0b01),
+              ElementsAre(EqualsDocHitInfo(2, 0b01),
+                          EqualsDocHitInfo(0, 0b01)));
+  EXPECT_THAT(GetExactHits(index.get(), "fo"), IsEmpty());
+}
+
+TEST_F(SegmentedMainIndexTest, PrefixHitsOnlyFromPrefixSections) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  AddHit("foo", /*document_id=*/0, kSectionId0, /*is_in_prefix_section=*/false);
+  AddHit("fool", /*document_id=*/0, kSectionId1,
+         /*is_in_prefix_section=*/true);
+  AddHit("foot", /*document_id=*/1, kSectionId0,
+         /*is_in_prefix_section=*/false);
+  Merge(index.get());
+  AddHit("food", /*document_id=*/2, kSectionId0,
+         /*is_in_prefix_section=*/true);
+  Merge(index.get());
+
+  // "foot" isn't in a prefix section, so it only matches exactly.
+  EXPECT_THAT(GetPrefixHits(index.get(), "foo"),
+              ElementsAre(EqualsDocHitInfo(2, 0b01),
+                          EqualsDocHitInfo(0, 0b11)));
+  EXPECT_THAT(GetPrefixHits(index.get(), "foot"),
+              ElementsAre(EqualsDocHitInfo(1, 0b01)));
+}
+
+TEST_F(SegmentedMainIndexTest, PersistsAcrossCreate) {
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        std::unique_ptr<SegmentedMainIndex> index,
+        SegmentedMainIndex::Create(index_dir_, &filesystem_));
+    AddHit("foo", /*document_id=*/0, kSectionId0,
+           /*is_in_prefix_section=*/false);
+    Merge(index.get());
+    AddHit("foo", /*document_id=*/1, kSectionId0,
+           /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->num_segments(), Eq(2));
+  EXPECT_THAT(index->last_added_document_id(), Eq(1));
+  EXPECT_THAT(GetExactHits(index.get(), "foo"),
+              ElementsAre(EqualsDocHitInfo(1, 0b01),
+                          EqualsDocHitInfo(0, 0b01)));
+}
+
+TEST_F(SegmentedMainIndexTest, CompactsSegmentsOfATier) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor - 1; ++document_id) {
+    AddHit("foo", document_id, kSectionId0, /*is_in_prefix_section=*/false);
+    AddHit(document_id % 2 == 0 ? "bar" : "baz", document_id, kSectionId0,
+           /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+  EXPECT_THAT(index->num_segments(), Eq(SegmentedMainIndex::kMergeFactor - 1));
+  EXPECT_FALSE(index->WantsCompaction());
+
+  // Merges leave compaction to the caller.
+  DocumentId last_document_id = SegmentedMainIndex::kMergeFactor - 1;
+  AddHit("foo", last_document_id, kSectionId0, /*is_in_prefix_section=*/false);
+  Merge(index.get());
+  EXPECT_THAT(index->num_segments(), Eq(SegmentedMainIndex::kMergeFactor));
+  EXPECT_TRUE(index->WantsCompaction());
+  ICING_ASSERT_OK(index->Compact());
+  EXPECT_THAT(index->num_segments(), Eq(1));
+  EXPECT_FALSE(index->WantsCompaction());
+
+  std::vector<DocHitInfo> foo_hits = GetExactHits(index.get(), "foo");
+  ASSERT_THAT(foo_hits.size(), Eq(SegmentedMainIndex::kMergeFactor));
+  for (int i = 0; i < SegmentedMainIndex::kMergeFactor; ++i) {
+    EXPECT_THAT(foo_hits[i].document_id(), Eq(last_document_id - i));
+  }
+  EXPECT_THAT(GetExactHits(index.get(), "bar"),
+              ElementsAre(EqualsDocHitInfo(2, 0b01),
+                          EqualsDocHitInfo(0, 0b01)));
+
+  // The compacted segments are gone from disk, and the new one is found on the
+  // next Create.
+  index.reset();
+  std::vector<std::string> entries;
+  ASSERT_TRUE(filesystem_.ListDirectory(index_dir_.c_str(), &entries));
+  EXPECT_THAT(entries.size(), Eq(2));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index, SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->num_segments(), Eq(1));
+  EXPECT_THAT(GetExactHits(index.get(), "bar"),
+              ElementsAre(EqualsDocHitInfo(2, 0b01),
+                          EqualsDocHitInfo(0, 0b01)));
+}
+
+TEST_F(SegmentedMainIndexTest, CompactNextRun) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->CompactNextRun(), IsOkAndHolds(false));
+
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor + 1; ++document_id) {
+    AddHit("foo", document_id, kSectionId0, /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+  // The whole run of tier 0 segments is compacted in one go.
+  EXPECT_THAT(index->CompactNextRun(), IsOkAndHolds(false));
+  EXPECT_THAT(index->num_segments(), Eq(1));
+  EXPECT_THAT(GetExactHits(index.get(), "foo").size(),
+              Eq(SegmentedMainIndex::kMergeFactor + 1));
+}
+
+TEST_F(SegmentedMainIndexTest, PreparedCompactionIsOnlyVisibleOnceCommitted) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex::Compaction> compaction,
+      index->PrepareCompaction());
+  EXPECT_THAT(compaction, Eq(nullptr));
+
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor; ++document_id) {
+    AddHit("foo", document_id, kSectionId0, /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+  ICING_ASSERT_OK_AND_ASSIGN(compaction, index->PrepareCompaction());
+  ASSERT_THAT(compaction, NotNull());
+  EXPECT_THAT(index->num_segments(), Eq(SegmentedMainIndex::kMergeFactor));
+  EXPECT_TRUE(index->WantsCompaction());
+
+  // A merge in between doesn't touch the run that was compacted.
+  AddHit("foo", SegmentedMainIndex::kMergeFactor, kSectionId0,
+         /*is_in_prefix_section=*/false);
+  Merge(index.get());
+  ICING_ASSERT_OK(index->CommitCompaction(std::move(compaction)));
+  EXPECT_THAT(index->num_segments(), Eq(2));
+  EXPECT_THAT(GetExactHits(index.get(), "foo").size(),
+              Eq(SegmentedMainIndex::kMergeFactor + 1));
+
+  index.reset();
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index, SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->num_segments(), Eq(2));
+  EXPECT_THAT(GetExactHits(index.get(), "foo").size(),
+              Eq(SegmentedMainIndex::kMergeFactor + 1));
+}
+
+TEST_F(SegmentedMainIndexTest, CommitCompactionFailsIfRunChanged) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor; ++document_id) {
+    AddHit("foo", document_id, kSectionId0, /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex::Compaction> compaction,
+      index->PrepareCompaction());
+  ASSERT_THAT(compaction, NotNull());
+  std::string compacted_directory = compaction->segment->directory();
+
+  ICING_ASSERT_OK(index->Reset());
+  EXPECT_THAT(index->CommitCompaction(std::move(compaction)),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+  EXPECT_THAT(index->num_segments(), Eq(0));
+  EXPECT_THAT(GetExactHits(index.get(), "foo"), IsEmpty());
+  EXPECT_THAT(filesystem_.DirectoryExists(compacted_directory.c_str()),
+              IsFalse());
+}
+
+TEST_F(SegmentedMainIndexTest, CommitCompactionFailsForAnotherIndex) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  for (DocumentId document_id = 0;
+       document_id < SegmentedMainIndex::kMergeFactor; ++document_id) {
+    AddHit("foo", document_id, kSectionId0, /*is_in_prefix_section=*/false);
+    Merge(index.get());
+  }
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex::Compaction> compaction,
+      index->PrepareCompaction());
+  ASSERT_THAT(compaction, NotNull());
+
+  // The same segments, but opened by another instance.
+  index.reset();
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index, SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_FALSE(index->PreparedCompaction(*compaction));
+  EXPECT_THAT(index->CommitCompaction(std::move(compaction)),
+              StatusIs(libtextclassifier3::StatusCode::FAILED_PRECONDITION));
+  EXPECT_THAT(index->num_segments(), Eq(SegmentedMainIndex::kMergeFactor));
+}
+
+TEST_F(SegmentedMainIndexTest, CreateDeletesLeftoverSegments) {
+  std::string leftover_directory = index_dir_ + "/segment_100";
+  ASSERT_TRUE(
+      filesystem_.CreateDirectoryRecursively(leftover_directory.c_str()));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(filesystem_.DirectoryExists(leftover_directory.c_str()),
+              IsFalse());
+}
+
+TEST_F(SegmentedMainIndexTest, FindTermsByPrefix) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  AddHit("foo", /*document_id=*/0, kSectionId0, /*is_in_prefix_section=*/false,
+         kNamespace0);
+  AddHit("fool", /*document_id=*/0, kSectionId0,
+         /*is_in_prefix_section=*/false, kNamespace0);
+  Merge(index.get());
+  AddHit("foo", /*document_id=*/1, kSectionId0, /*is_in_prefix_section=*/false,
+         kNamespace1);
+  AddHit("food", /*document_id=*/1, kSectionId0,
+         /*is_in_prefix_section=*/false, kNamespace1);
+  Merge(index.get());
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::vector<TermMetadata> terms,
+      index->FindTermsByPrefix("foo", /*namespace_ids=*/{},
+                               /*num_to_return=*/10));
+  ASSERT_THAT(terms.size(), Eq(3));
+  EXPECT_THAT(terms[0].content, Eq("foo"));
+  EXPECT_THAT(terms[0].hit_count, Eq(2));
+  EXPECT_THAT(terms[1].content, Eq("food"));
+  EXPECT_THAT(terms[2].content, Eq("fool"));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      terms, index->FindTermsByPrefix("foo", /*namespace_ids=*/{kNamespace1},
+                                      /*num_to_return=*/10));
+  ASSERT_THAT(terms.size(), Eq(2));
+  EXPECT_THAT(terms[0].content, Eq("foo"));
+  EXPECT_THAT(terms[0].hit_count, Eq(1));
+  EXPECT_THAT(terms[1].content, Eq("food"));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      terms, index->FindTermsByPrefix("foo", /*namespace_ids=*/{},
+                                      /*num_to_return=*/1));
+  ASSERT_THAT(terms.size(), Eq(1));
+  EXPECT_THAT(terms[0].content, Eq("foo"));
+}
+
+TEST_F(SegmentedMainIndexTest, Reset) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<SegmentedMainIndex> index,
+      SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  AddHit("foo", /*document_id=*/0, kSectionId0, /*is_in_prefix_section=*/false);
+  Merge(index.get());
+  ICING_ASSERT_OK(index->Reset());
+  EXPECT_THAT(index->num_segments(), Eq(0));
+  EXPECT_THAT(index->last_added_document_id(), Eq(kInvalidDocumentId));
+  EXPECT_THAT(GetExactHits(index.get(), "foo"), IsEmpty());
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      index, SegmentedMainIndex::Create(index_dir_, &filesystem_));
+  EXPECT_THAT(index->num_segments(), Eq(0));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -14,14 +14,20 @@
 
 #include <jni.h>
 
+#include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "icing/jni/jni-cache.h"
+#include <google/protobuf/arena.h>
 #include <google/protobuf/message_lite.h>
 #include "icing/absl_ports/status_imports.h"
 #include "icing/icing-search-engine.h"
 #include "icing/proto/document.pb.h"
 #include "icing/proto/initialize.pb.h"
+#include "icing/proto/memory.pb.h"
 #include "icing/proto/optimize.pb.h"
 #include "icing/proto/persist.pb.h"
 #include "icing/proto/schema.pb.h"
@@ -64,6 +70,34 @@ jbyteArray SerializeProtoToJniByteArray(
   return ret;
 }
 
+// Size of the first block of the arenas that search results are built on.
+// Resetting an arena keeps its first block, so pages of results that fit in
+// it don't allocate any memory for their protos.
+constexpr size_t kSearchResultArenaBlockSize = 64 * 1024;
+
+// Returns the arena for the search results of the calling thread. It must be
+// reset once the results have been serialized.
+google::protobuf::Arena* GetSearchResultArena() {
+  struct SearchResultArena {
+    static google::protobuf::ArenaOptions MakeOptions(char* initial_block) {
+      google::protobuf::ArenaOptions options;
+      options.initial_block = initial_block;
+      options.initial_block_size = kSearchResultArenaBlockSize;
+      return options;
+    }
+
+    SearchResultArena()
+        : initial_block(std::make_unique<char[]>(kSearchResultArenaBlockSize)),
+          arena(MakeOptions(initial_block.get())) {}
+
+    // Declared before the arena so that it outlives it.
+    std::unique_ptr<char[]> initial_block;
+    google::protobuf::Arena arena;
+  };
+  thread_local SearchResultArena search_result_arena;
+  return &search_result_arena.arena;
+}
+
 icing::lib::IcingSearchEngine* GetIcingSearchEnginePointer(JNIEnv* env,
                                                            jobject object) {
   jclass cls = env->GetObjectClass(object);
@@ -209,6 +243,79 @@ Java_com_google_android_icing_IcingSearchEngine_nativeGet(
   return SerializeProtoToJniByteArray(env, get_result_proto);
 }
 
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeBatchGet(
+    JNIEnv* env, jclass clazz, jobject object, jobjectArray name_spaces,
+    jobjectArray uris, jbyteArray result_spec_bytes) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  icing::lib::GetResultSpecProto get_result_spec;
+  if (!ParseProtoFromJniByteArray(env, result_spec_bytes, &get_result_spec)) {
+    ICING_LOG(ERROR) << "Failed to parse GetResultSpecProto in nativeBatchGet";
+    return nullptr;
+  }
+
+  jsize num_keys = env->GetArrayLength(name_spaces);
+  if (env->GetArrayLength(uris) != num_keys) {
+    ICING_LOG(ERROR) << "Got different numbers of namespaces and uris in "
+                        "nativeBatchGet";
+    return nullptr;
+  }
+  std::vector<std::string> native_name_spaces;
+  std::vector<std::string> native_uris;
+  native_name_spaces.reserve(num_keys);
+  native_uris.reserve(num_keys);
+  for (jsize i = 0; i < num_keys; ++i) {
+    jstring name_space =
+        static_cast<jstring>(env->GetObjectArrayElement(name_spaces, i));
+    jstring uri = static_cast<jstring>(env->GetObjectArrayElement(uris, i));
+    const char* native_name_space =
+        env->GetStringUTFChars(name_space, /*isCopy=*/nullptr);
+    const char* native_uri = env->GetStringUTFChars(uri, /*isCopy=*/nullptr);
+    native_name_spaces.push_back(native_name_space);
+    native_uris.push_back(native_uri);
+    env->ReleaseStringUTFChars(name_space, native_name_space);
+    env->ReleaseStringUTFChars(uri, native_uri);
+    env->DeleteLocalRef(name_space);
+    env->DeleteLocalRef(uri);
+  }
+
+  std::vector<std::pair<std::string_view, std::string_view>> keys;
+  keys.reserve(num_keys);
+  for (jsize i = 0; i < num_keys; ++i) {
+    keys.push_back({native_name_spaces[i], native_uris[i]});
+  }
+  icing::lib::BatchGetResultProto batch_get_result_proto =
+      icing->BatchGet(keys, get_result_spec);
+
+  return SerializeProtoToJniByteArray(env, batch_get_result_proto);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeGetByUriPrefix(
+    JNIEnv* env, jclass clazz, jobject object, jstring name_space,
+    jstring uri_prefix, jbyteArray result_spec_bytes) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  const char* native_name_space =
+      env->GetStringUTFChars(name_space, /*isCopy=*/nullptr);
+  const char* native_uri_prefix =
+      env->GetStringUTFChars(uri_prefix, /*isCopy=*/nullptr);
+  icing::lib::GetResultSpecProto get_result_spec;
+  if (!ParseProtoFromJniByteArray(env, result_spec_bytes, &get_result_spec)) {
+    ICING_LOG(ERROR)
+        << "Failed to parse GetResultSpecProto in nativeGetByUriPrefix";
+    return nullptr;
+  }
+  icing::lib::GetByUriPrefixResultProto get_by_uri_prefix_result_proto =
+      icing->GetByUriPrefix(native_name_space, native_uri_prefix,
+                            get_result_spec);
+
+  return SerializeProtoToJniByteArray(env, get_by_uri_prefix_result_proto);
+}
+
 JNIEXPORT jbyteArray JNICALL
 Java_com_google_android_icing_IcingSearchEngine_nativeReportUsage(
     JNIEnv* env, jclass clazz, jobject object, jbyteArray usage_report_bytes) {
@@ -245,10 +352,16 @@ Java_com_google_android_icing_IcingSearchEngine_nativeGetNextPage(
   icing::lib::IcingSearchEngine* icing =
       GetIcingSearchEnginePointer(env, object);
 
-  icing::lib::SearchResultProto next_page_result_proto =
-      icing->GetNextPage(next_page_token);
+  google::protobuf::Arena* arena = GetSearchResultArena();
+  icing::lib::SearchResultProto* next_page_result_proto =
+      google::protobuf::Arena::CreateMessage<icing::lib::SearchResultProto>(
+          arena);
+  icing->GetNextPage(next_page_token, next_page_result_proto);
 
-  return SerializeProtoToJniByteArray(env, next_page_result_proto);
+  jbyteArray result =
+      SerializeProtoToJniByteArray(env, *next_page_result_proto);
+  arena->Reset();
+  return result;
 }
 
 JNIEXPORT void JNICALL
@@ -262,6 +375,52 @@ Java_com_google_android_icing_IcingSearchEngine_nativeInvalidateNextPageToken(
   return;
 }
 
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeScan(
+    JNIEnv* env, jclass clazz, jobject object, jbyteArray scan_spec_bytes,
+    jbyteArray result_spec_bytes) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  icing::lib::ScanSpecProto scan_spec;
+  if (!ParseProtoFromJniByteArray(env, scan_spec_bytes, &scan_spec)) {
+    ICING_LOG(ERROR) << "Failed to parse ScanSpecProto in nativeScan";
+    return nullptr;
+  }
+  icing::lib::GetResultSpecProto get_result_spec;
+  if (!ParseProtoFromJniByteArray(env, result_spec_bytes, &get_result_spec)) {
+    ICING_LOG(ERROR) << "Failed to parse GetResultSpecProto in nativeScan";
+    return nullptr;
+  }
+  icing::lib::ScanResultProto scan_result_proto =
+      icing->Scan(scan_spec, get_result_spec);
+
+  return SerializeProtoToJniByteArray(env, scan_result_proto);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeGetNextScanPage(
+    JNIEnv* env, jclass clazz, jobject object, jlong next_page_token) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  icing::lib::ScanResultProto scan_result_proto =
+      icing->GetNextScanPage(next_page_token);
+
+  return SerializeProtoToJniByteArray(env, scan_result_proto);
+}
+
+JNIEXPORT void JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeInvalidateScanToken(
+    JNIEnv* env, jclass clazz, jobject object, jlong next_page_token) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  icing->InvalidateScanToken(next_page_token);
+
+  return;
+}
+
 JNIEXPORT jbyteArray JNICALL
 Java_com_google_android_icing_IcingSearchEngine_nativeSearch(
     JNIEnv* env, jclass clazz, jobject object, jbyteArray search_spec_bytes,
@@ -288,10 +447,16 @@ Java_com_google_android_icing_IcingSearchEngine_nativeSearch(
     return nullptr;
   }
 
-  icing::lib::SearchResultProto search_result_proto =
-      icing->Search(search_spec_proto, scoring_spec_proto, result_spec_proto);
+  google::protobuf::Arena* arena = GetSearchResultArena();
+  icing::lib::SearchResultProto* search_result_proto =
+      google::protobuf::Arena::CreateMessage<icing::lib::SearchResultProto>(
+          arena);
+  icing->Search(search_spec_proto, scoring_spec_proto, result_spec_proto,
+                search_result_proto);
 
-  return SerializeProtoToJniByteArray(env, search_result_proto);
+  jbyteArray result = SerializeProtoToJniByteArray(env, *search_result_proto);
+  arena->Reset();
+  return result;
 }
 
 JNIEXPORT jbyteArray JNICALL
@@ -338,6 +503,23 @@ Java_com_google_android_icing_IcingSearchEngine_nativeDeleteBySchemaType(
   return SerializeProtoToJniByteArray(env, delete_by_schema_type_result_proto);
 }
 
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeDeleteByUriPrefix(
+    JNIEnv* env, jclass clazz, jobject object, jstring name_space,
+    jstring uri_prefix) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  const char* native_name_space =
+      env->GetStringUTFChars(name_space, /*isCopy=*/nullptr);
+  const char* native_uri_prefix =
+      env->GetStringUTFChars(uri_prefix, /*isCopy=*/nullptr);
+  icing::lib::DeleteByUriPrefixResultProto delete_by_uri_prefix_result_proto =
+      icing->DeleteByUriPrefix(native_name_space, native_uri_prefix);
+
+  return SerializeProtoToJniByteArray(env, delete_by_uri_prefix_result_proto);
+}
+
 JNIEXPORT jbyteArray JNICALL
 Java_com_google_android_icing_IcingSearchEngine_nativeDeleteByQuery(
     JNIEnv* env, jclass clazz, jobject object, jbyteArray search_spec_bytes) {
@@ -374,6 +556,25 @@ Java_com_google_android_icing_IcingSearchEngine_nativePersistToDisk(
   return SerializeProtoToJniByteArray(env, persist_to_disk_result_proto);
 }
 
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_android_icing_IcingSearchEngine_nativeTrimMemory(
+    JNIEnv* env, jclass clazz, jobject object, jint trim_memory_level_code) {
+  icing::lib::IcingSearchEngine* icing =
+      GetIcingSearchEnginePointer(env, object);
+
+  if (!icing::lib::TrimMemoryLevel::Code_IsValid(trim_memory_level_code)) {
+    ICING_LOG(ERROR) << trim_memory_level_code
+                     << " is an invalid value for TrimMemoryLevel::Code";
+    return nullptr;
+  }
+  icing::lib::TrimMemoryLevel::Code trim_memory_level_code_enum =
+      static_cast<icing::lib::TrimMemoryLevel::Code>(trim_memory_level_code);
+  icing::lib::TrimMemoryResultProto trim_memory_result_proto =
+      icing->TrimMemory(trim_memory_level_code_enum);
+
+  return SerializeProtoToJniByteArray(env, trim_memory_result_proto);
+}
+
 JNIEXPORT jbyteArray JNICALL
 Java_com_google_android_icing_IcingSearchEngine_nativeOptimize(
     JNIEnv* env, jclass clazz, jobject object) {
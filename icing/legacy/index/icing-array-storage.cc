@@ -25,6 +25,7 @@
 #include "icing/legacy/index/icing-filesystem.h"
 #include "icing/legacy/index/icing-mmapper.h"
 #include "icing/util/logging.h"
+#include "icing/util/page-util.h"
 
 using std::max;
 using std::min;
@@ -307,6 +308,33 @@ void IcingArrayStorage::Warm() const {
   }
 }
 
+int64_t IcingArrayStorage::ReleaseCleanPages() {
+  if (!is_initialized()) {
+    return 0;
+  }
+  // With map_shared_, every change is already in the page cache and nothing
+  // is lost by dropping our mapping of it. Otherwise only pages that haven't
+  // been written since the last Sync() can be dropped.
+  const size_t page_size = IcingMMapper::system_page_size();
+  const size_t num_pages =
+      IcingMMapper::page_aligned_size(cur_num_ * elt_size_) / page_size;
+  int64_t released_bytes = 0;
+  size_t clean_start = 0;
+  for (size_t i = 0; i <= num_pages; i++) {
+    bool is_clean = i < num_pages && (map_shared_ || i >= dirty_pages_.size() ||
+                                      !dirty_pages_[i]);
+    if (!is_clean) {
+      if (i > clean_start) {
+        released_bytes += page_util::ReleasePages(
+            MakeVoidPtr(array() + clean_start * page_size),
+            (i - clean_start) * page_size);
+      }
+      clean_start = i + 1;
+    }
+  }
+  return released_bytes;
+}
+
 void IcingArrayStorage::Clear() {
   cur_num_ = 0;
   changes_end_ = 0;
@@ -68,6 +68,11 @@ class IcingArrayStorage {
   // Attempt to swap into RAM.
   void Warm() const;
 
+  // Drops the pages of the array that have no unsynced changes from RAM. They
+  // are read back from fd when next accessed. Returns the number of bytes
+  // that were resident.
+  int64_t ReleaseCleanPages();
+
   // Make array empty again.
   void Clear();
 
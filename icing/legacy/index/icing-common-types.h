@@ -88,7 +88,7 @@ constexpr int kIcingQueryTermLimit = 50;  // Maximum number of terms in a query
 constexpr int kIcingMaxVariantsPerToken = 10;  // Maximum number of variants
 
 // LINT.IfChange
-constexpr int kIcingDocIdBits = 20;  // 1M docs
+constexpr int kIcingDocIdBits = 24;  // 16M docs
 constexpr IcingDocId kIcingInvalidDocId = (1u << kIcingDocIdBits) - 1;
 constexpr IcingDocId kIcingMaxDocId = kIcingInvalidDocId - 1;
 // LINT.ThenChange(//depot/google3/wireless/android/icing/plx/google_sql_common_macros.sql)
@@ -268,6 +268,8 @@ class IcingDynamicTrie::IcingDynamicTrieStorage {
 
   void Warm();
 
+  int64_t ReleaseCleanPages();
+
   void Clear();
 
   bool empty() const { return hdr().num_nodes() == 0; }
@@ -633,6 +635,14 @@ void IcingDynamicTrie::IcingDynamicTrieStorage::Warm() {
   }
 }
 
+int64_t IcingDynamicTrie::IcingDynamicTrieStorage::ReleaseCleanPages() {
+  int64_t released_bytes = 0;
+  for (int i = 0; i < NUM_ARRAY_TYPES; i++) {
+    released_bytes += array_storage_[i].ReleaseCleanPages();
+  }
+  return released_bytes;
+}
+
 void IcingDynamicTrie::IcingDynamicTrieStorage::Clear() {
   if (!is_initialized()) {
     ICING_LOG(FATAL) << "DynamicTrie not initialized";
@@ -1304,6 +1314,14 @@ void IcingDynamicTrie::Warm() const {
   return storage_->Warm();
 }
 
+int64_t IcingDynamicTrie::ReleaseCleanPages() {
+  if (!is_initialized()) {
+    ICING_LOG(FATAL) << "DynamicTrie not initialized";
+  }
+
+  return storage_->ReleaseCleanPages();
+}
+
 void IcingDynamicTrie::OnSleep() {
   if (!is_initialized()) {
     ICING_LOG(FATAL) << "DynamicTrie not initialized";
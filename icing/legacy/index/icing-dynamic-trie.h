@@ -304,6 +304,10 @@ class IcingDynamicTrie : public IIcingStorage {
   // Tell kernel we will access the memory shortly.
   void Warm() const;
 
+  // Tell kernel to drop the memory that can be read back from disk. Returns
+  // the number of bytes that were resident.
+  int64_t ReleaseCleanPages();
+
   // Potentially about to get nuked.
   void OnSleep() override;
 
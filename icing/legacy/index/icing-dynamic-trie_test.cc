@@ -374,6 +374,36 @@ TEST_F(IcingDynamicTrieTest, Persistence) {
   }
 }
 
+TEST_F(IcingDynamicTrieTest, ReleaseCleanPagesKeepsContents) {
+  IcingFilesystem filesystem;
+  for (auto storage_policy :
+       {IcingDynamicTrie::RuntimeOptions::kMapSharedWithCrc,
+        IcingDynamicTrie::RuntimeOptions::kExplicitFlush}) {
+    IcingDynamicTrie::RuntimeOptions ropt;
+    ropt.storage_policy = storage_policy;
+    IcingDynamicTrie trie(trie_files_prefix_, ropt, &filesystem);
+    ASSERT_TRUE(trie.Remove());
+    ASSERT_TRUE(trie.CreateIfNotExist(IcingDynamicTrie::Options()));
+    ASSERT_TRUE(trie.Init());
+
+    for (uint32_t i = 0; i < kCommonEnglishWordArrayLen; i++) {
+      ASSERT_TRUE(trie.Insert(kCommonEnglishWords[i].data(), &i));
+    }
+    // Pages of a shared mapping can always be given back. Pages of a private
+    // mapping that haven't been flushed yet must be kept.
+    int64_t released_bytes = trie.ReleaseCleanPages();
+    if (storage_policy == IcingDynamicTrie::RuntimeOptions::kMapSharedWithCrc) {
+      EXPECT_GT(released_bytes, 0);
+    }
+
+    for (uint32_t i = 0; i < kCommonEnglishWordArrayLen; i++) {
+      uint32_t val;
+      ASSERT_TRUE(trie.Find(kCommonEnglishWords[i].data(), &val));
+      EXPECT_EQ(val, i);
+    }
+  }
+}
+
 TEST_F(IcingDynamicTrieTest, PersistenceShared) {
   // Test persistence on the English dictionary.
   IcingFilesystem filesystem;
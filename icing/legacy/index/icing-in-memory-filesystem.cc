@@ -0,0 +1,151 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/legacy/index/icing-in-memory-filesystem.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "icing/file/in-memory-file-tree.h"
+#include "icing/legacy/core/icing-string-util.h"
+#include "icing/util/logging.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+uint64_t ToIcingFilesystemSize(int64_t size) {
+  return size == InMemoryFileTree::kBadFileSize ? IcingFilesystem::kBadFileSize
+                                                : size;
+}
+
+}  // namespace
+
+bool IcingInMemoryFilesystem::DeleteFile(const char *file_name) const {
+  if (!file_tree_->DeleteFile(file_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting file %s failed: %s", file_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool IcingInMemoryFilesystem::DeleteDirectory(const char *dir_name) const {
+  if (!file_tree_->DeleteDirectory(dir_name, /*recursive=*/false)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool IcingInMemoryFilesystem::DeleteDirectoryRecursively(
+    const char *dir_name) const {
+  if (!file_tree_->DeleteDirectory(dir_name, /*recursive=*/true)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Deleting directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool IcingInMemoryFilesystem::FileExists(const char *file_name) const {
+  return file_tree_->FileExists(file_name);
+}
+
+bool IcingInMemoryFilesystem::DirectoryExists(const char *dir_name) const {
+  return file_tree_->DirectoryExists(dir_name);
+}
+
+bool IcingInMemoryFilesystem::ListDirectory(
+    const char *dir_name, const std::unordered_set<std::string> &exclude,
+    bool recursive, std::vector<std::string> *entries) const {
+  if (!file_tree_->ListDirectory(dir_name, exclude, recursive, entries)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Unable to list directory %s: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int IcingInMemoryFilesystem::OpenForWrite(const char *file_name) const {
+  int fd = file_tree_->Open(file_name, O_RDWR, /*create=*/true);
+  if (fd < 0) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Opening file %s for write failed: %s", file_name, strerror(errno));
+  }
+  return fd;
+}
+
+int IcingInMemoryFilesystem::OpenForAppend(const char *file_name) const {
+  int fd = OpenForWrite(file_name);
+  if (fd >= 0) {
+    lseek(fd, 0, SEEK_END);
+  }
+  return fd;
+}
+
+int IcingInMemoryFilesystem::OpenForRead(const char *file_name) const {
+  int fd = file_tree_->Open(file_name, O_RDONLY, /*create=*/false);
+  if (fd < 0) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Opening file %s for read failed: %s", file_name, strerror(errno));
+  }
+  return fd;
+}
+
+uint64_t IcingInMemoryFilesystem::GetFileSize(const char *filename) const {
+  return ToIcingFilesystemSize(file_tree_->GetFileSize(filename));
+}
+
+bool IcingInMemoryFilesystem::RenameFile(const char *old_name,
+                                         const char *new_name) const {
+  if (!file_tree_->Rename(old_name, new_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Unable to rename file %s to %s: %s", old_name, new_name,
+        strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool IcingInMemoryFilesystem::CreateDirectory(const char *dir_name) const {
+  if (!file_tree_->CreateDirectory(dir_name)) {
+    ICING_LOG(ERROR) << IcingStringUtil::StringPrintf(
+        "Creating directory %s failed: %s", dir_name, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+uint64_t IcingInMemoryFilesystem::GetFileDiskUsage(const char *path) const {
+  return ToIcingFilesystemSize(
+      file_tree_->GetMemoryUsage(path, /*recursive=*/false));
+}
+
+uint64_t IcingInMemoryFilesystem::GetDiskUsage(const char *path) const {
+  return ToIcingFilesystemSize(
+      file_tree_->GetMemoryUsage(path, /*recursive=*/true));
+}
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,72 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_LEGACY_INDEX_ICING_IN_MEMORY_FILESYSTEM_H_
+#define ICING_LEGACY_INDEX_ICING_IN_MEMORY_FILESYSTEM_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "icing/file/in-memory-file-tree.h"
+#include "icing/legacy/index/icing-filesystem.h"
+
+namespace icing {
+namespace lib {
+
+// IcingFilesystem counterpart of InMemoryFilesystem. Files live in an
+// InMemoryFileTree, which may be shared with an InMemoryFilesystem.
+class IcingInMemoryFilesystem : public IcingFilesystem {
+ public:
+  explicit IcingInMemoryFilesystem(std::shared_ptr<InMemoryFileTree> file_tree)
+      : file_tree_(std::move(file_tree)) {}
+
+  bool DeleteFile(const char *file_name) const override;
+  bool DeleteDirectory(const char *dir_name) const override;
+  bool DeleteDirectoryRecursively(const char *dir_name) const override;
+  bool FileExists(const char *file_name) const override;
+  bool DirectoryExists(const char *dir_name) const override;
+  bool ListDirectory(const char *dir_name,
+                     const std::unordered_set<std::string> &exclude,
+                     bool recursive,
+                     std::vector<std::string> *entries) const override;
+  int OpenForWrite(const char *file_name) const override;
+  int OpenForAppend(const char *file_name) const override;
+  int OpenForRead(const char *file_name) const override;
+  uint64_t GetFileSize(int fd) const override {
+    return IcingFilesystem::GetFileSize(fd);
+  }
+  uint64_t GetFileSize(const char *filename) const override;
+  bool DataSync(int fd) const override { return true; }
+  bool RenameFile(const char *old_name, const char *new_name) const override;
+  bool CreateDirectory(const char *dir_name) const override;
+  uint64_t GetDiskUsage(int fd) const override {
+    return IcingFilesystem::GetDiskUsage(fd);
+  }
+  uint64_t GetFileDiskUsage(const char *path) const override;
+  uint64_t GetDiskUsage(const char *path) const override;
+
+  // Pulls in the overloads that aren't overridden here.
+  using IcingFilesystem::ListDirectory;
+
+ private:
+  std::shared_ptr<InMemoryFileTree> file_tree_;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_LEGACY_INDEX_ICING_IN_MEMORY_FILESYSTEM_H_
@@ -50,7 +50,9 @@ class IcingLiteIndex_Header {
 class IcingLiteIndex_HeaderImpl : public IcingLiteIndex_Header {
  public:
   struct HeaderData {
-    static const uint32_t kMagic = 0x6dfba6a0;
+    // Bumped whenever the Hit encoding changes so that lite indices written
+    // with an older encoding are discarded and rebuilt.
+    static const uint32_t kMagic = 0x6dfba6a1;
 
     uint32_t lite_index_crc;
     uint32_t magic;
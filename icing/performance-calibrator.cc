@@ -0,0 +1,254 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/performance-calibrator.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/str_cat.h"
+#include "icing/file/file-backed-proto.h"
+#include "icing/file/filesystem.h"
+#include "icing/legacy/index/icing-bit-util.h"
+#include "icing/proto/internal/performance.pb.h"
+#include "icing/scoring/ranker.h"
+#include "icing/scoring/scored-document-hit.h"
+#include "icing/util/clock.h"
+#include "icing/util/logging.h"
+#include "icing/util/status-macros.h"
+
+namespace icing {
+namespace lib {
+
+namespace performance_calibrator {
+
+namespace {
+
+// Every probe is run this many times and the fastest run is kept, which
+// filters out runs that were interrupted by the rest of the device.
+constexpr int kNumProbeRuns = 3;
+
+constexpr int kNumRankProbeHits = 16384;
+constexpr int kNumRankProbeResults = 10;
+constexpr int kNumDecodeProbeValues = 65536;
+
+constexpr std::string_view kReadProbeFilename = "read_probe";
+constexpr int kReadProbeFileSize = 1024 * 1024;  // 1 MiB
+constexpr int kReadProbeBlockSize = 4096;
+constexpr int kNumReadProbeReads = 64;
+
+// A small deterministic generator, so that every run of a probe does the same
+// amount of work.
+class ProbeRandom {
+ public:
+  uint32_t Next() {
+    state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<uint32_t>(state_ >> 33);
+  }
+
+ private:
+  uint64_t state_ = 0x853c49e6748fea9bULL;
+};
+
+// Builds a heap of scored hits and pops the first page off it, like Search does
+// for every query.
+double ProbeRankNsPerHit(const Clock& clock) {
+  ProbeRandom random;
+  std::vector<ScoredDocumentHit> hits;
+  hits.reserve(kNumRankProbeHits);
+  for (int i = 0; i < kNumRankProbeHits; ++i) {
+    hits.emplace_back(/*document_id=*/i, /*hit_section_id_mask=*/1,
+                      /*score=*/random.Next());
+  }
+  ScoredDocumentHitComparator comparator;
+
+  int64_t fastest_ns = std::numeric_limits<int64_t>::max();
+  for (int run = 0; run < kNumProbeRuns; ++run) {
+    std::vector<ScoredDocumentHit> heap = hits;
+    std::unique_ptr<Timer> timer = clock.GetNewTimer();
+    BuildHeapInPlace(&heap, comparator);
+    std::vector<ScoredDocumentHit> results =
+        PopTopResultsFromHeap(&heap, kNumRankProbeResults, comparator);
+    fastest_ns = std::min(fastest_ns, timer->GetElapsedNanoseconds());
+    if (results.size() != kNumRankProbeResults) {
+      ICING_LOG(WARNING) << "Rank probe returned " << results.size()
+                         << " hits";
+    }
+  }
+  return static_cast<double>(fastest_ns) / kNumRankProbeHits;
+}
+
+// Decodes a buffer of VarInt encoded deltas, like posting lists are read on
+// every query.
+double ProbeDecodeNsPerValue(const Clock& clock) {
+  ProbeRandom random;
+  std::vector<uint8_t> buffer(kNumDecodeProbeValues * VarInt::kMaxEncodedLen64);
+  size_t buffer_len = 0;
+  for (int i = 0; i < kNumDecodeProbeValues; ++i) {
+    // Mostly small deltas, as in a dense posting list.
+    uint64_t delta = random.Next() >> (random.Next() % 32);
+    buffer_len += VarInt::Encode(delta, buffer.data() + buffer_len);
+  }
+
+  int64_t fastest_ns = std::numeric_limits<int64_t>::max();
+  for (int run = 0; run < kNumProbeRuns; ++run) {
+    uint64_t sum = 0;
+    std::unique_ptr<Timer> timer = clock.GetNewTimer();
+    for (size_t offset = 0; offset < buffer_len;) {
+      uint64_t value;
+      offset += VarInt::Decode(buffer.data() + offset, &value);
+      sum += value;
+    }
+    fastest_ns = std::min(fastest_ns, timer->GetElapsedNanoseconds());
+    // Keeps the loop from being optimized away.
+    if (sum == 0) {
+      ICING_LOG(WARNING) << "Decode probe decoded nothing";
+    }
+  }
+  return static_cast<double>(fastest_ns) / kNumDecodeProbeValues;
+}
+
+// Reads random blocks of a scratch file that isn't in the page cache, like the
+// first reads of an index block after it was evicted.
+libtextclassifier3::StatusOr<double> ProbeRandomReadLatencyUs(
+    const Filesystem& filesystem, const std::string& scratch_dir,
+    const Clock& clock) {
+  const std::string filename =
+      absl_ports::StrCat(scratch_dir, "/", kReadProbeFilename);
+  std::vector<uint8_t> block(kReadProbeBlockSize);
+  {
+    ScopedFd fd(filesystem.OpenForWrite(filename.c_str()));
+    if (!fd.is_valid()) {
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Unable to open read probe file: ", filename));
+    }
+    for (int offset = 0; offset < kReadProbeFileSize;
+         offset += kReadProbeBlockSize) {
+      if (!filesystem.Write(fd.get(), block.data(), block.size())) {
+        filesystem.DeleteFile(filename.c_str());
+        return absl_ports::InternalError(
+            absl_ports::StrCat("Unable to write read probe file: ", filename));
+      }
+    }
+    // Only clean pages can be dropped from the page cache below.
+    filesystem.DataSync(fd.get());
+  }
+
+  ProbeRandom random;
+  int64_t fastest_ns = std::numeric_limits<int64_t>::max();
+  {
+    ScopedFd fd(filesystem.OpenForRead(filename.c_str()));
+    if (!fd.is_valid()) {
+      filesystem.DeleteFile(filename.c_str());
+      return absl_ports::InternalError(
+          absl_ports::StrCat("Unable to open read probe file: ", filename));
+    }
+    constexpr int kNumBlocks = kReadProbeFileSize / kReadProbeBlockSize;
+    for (int run = 0; run < kNumProbeRuns; ++run) {
+      // Makes the reads go to storage rather than to the copy the page cache
+      // kept from writing the file. This is only advice, so reads may still be
+      // served from memory on some file systems.
+      posix_fadvise(fd.get(), /*offset=*/0, /*len=*/0, POSIX_FADV_DONTNEED);
+      std::unique_ptr<Timer> timer = clock.GetNewTimer();
+      for (int i = 0; i < kNumReadProbeReads; ++i) {
+        off_t offset = static_cast<off_t>(random.Next() % kNumBlocks) *
+                       kReadProbeBlockSize;
+        if (!filesystem.PRead(fd.get(), block.data(), block.size(), offset)) {
+          filesystem.DeleteFile(filename.c_str());
+          return absl_ports::InternalError(
+              absl_ports::StrCat("Unable to read read probe file: ", filename));
+        }
+      }
+      fastest_ns = std::min(fastest_ns, timer->GetElapsedNanoseconds());
+    }
+  }
+  filesystem.DeleteFile(filename.c_str());
+  return static_cast<double>(fastest_ns) / kNumReadProbeReads / 1000;
+}
+
+int GetNumCores() {
+  unsigned int num_cores = std::thread::hardware_concurrency();
+  return num_cores > 0 ? num_cores : 1;
+}
+
+// Prefers MemAvailable, which unlike the free page count includes the page
+// cache that the kernel would give up under pressure.
+int64_t GetAvailableMemoryBytes() {
+  ScopedFILE meminfo(fopen("/proc/meminfo", "r"));
+  if (meminfo != nullptr) {
+    char line[128];
+    int64_t available_kb;
+    while (fgets(line, sizeof(line), meminfo.get()) != nullptr) {
+      if (sscanf(line, "MemAvailable: %" SCNd64 " kB", &available_kb) == 1) {
+        return available_kb * 1024;
+      }
+    }
+  }
+  return static_cast<int64_t>(sysconf(_SC_AVPHYS_PAGES)) *
+         sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace
+
+libtextclassifier3::StatusOr<DeviceProfileProto> ProbeDevice(
+    const Filesystem& filesystem, const std::string& scratch_dir,
+    const Clock& clock) {
+  DeviceProfileProto profile;
+  profile.set_probe_version(kProbeVersion);
+  profile.set_rank_ns_per_hit(ProbeRankNsPerHit(clock));
+  profile.set_decode_ns_per_value(ProbeDecodeNsPerValue(clock));
+  ICING_ASSIGN_OR_RETURN(
+      double random_read_latency_us,
+      ProbeRandomReadLatencyUs(filesystem, scratch_dir, clock));
+  profile.set_random_read_latency_us(random_read_latency_us);
+  profile.set_num_cores(GetNumCores());
+  profile.set_available_memory_bytes(GetAvailableMemoryBytes());
+  return profile;
+}
+
+libtextclassifier3::StatusOr<DeviceProfileProto> GetOrCreateDeviceProfile(
+    const Filesystem& filesystem, const std::string& profile_filename,
+    const std::string& scratch_dir, const Clock& clock) {
+  FileBackedProto<DeviceProfileProto> profile_file(filesystem,
+                                                   profile_filename);
+  auto profile_or = profile_file.Read();
+  if (profile_or.ok() &&
+      profile_or.ValueOrDie()->probe_version() == kProbeVersion) {
+    return *profile_or.ValueOrDie();
+  }
+
+  ICING_ASSIGN_OR_RETURN(DeviceProfileProto profile,
+                         ProbeDevice(filesystem, scratch_dir, clock));
+  ICING_RETURN_IF_ERROR(
+      profile_file.Write(std::make_unique<DeviceProfileProto>(profile)));
+  return profile;
+}
+
+}  // namespace performance_calibrator
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,63 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_PERFORMANCE_CALIBRATOR_H_
+#define ICING_PERFORMANCE_CALIBRATOR_H_
+
+#include <string>
+
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/file/filesystem.h"
+#include "icing/proto/internal/performance.pb.h"
+#include "icing/util/clock.h"
+
+namespace icing {
+namespace lib {
+
+namespace performance_calibrator {
+
+// Version of the probes run by ProbeDevice. Bump it whenever a probe changes
+// in a way that changes what it reports.
+inline constexpr int kProbeVersion = 1;
+
+// Runs a few short micro-benchmarks that approximate the hot loops of Search,
+// and collects the resources available to the process. A scratch file is
+// written to and removed from scratch_dir to measure read latency.
+//
+// Probing takes in the order of tens of milliseconds.
+//
+// Returns:
+//   The measured profile on success
+//   INTERNAL_ERROR on I/O error
+libtextclassifier3::StatusOr<DeviceProfileProto> ProbeDevice(
+    const Filesystem& filesystem, const std::string& scratch_dir,
+    const Clock& clock);
+
+// Returns the profile saved in profile_filename. If there's none, or it was
+// produced by a different version of the probes, probes the device and saves
+// the new profile there.
+//
+// Returns:
+//   The device profile on success
+//   INTERNAL_ERROR on I/O error
+libtextclassifier3::StatusOr<DeviceProfileProto> GetOrCreateDeviceProfile(
+    const Filesystem& filesystem, const std::string& profile_filename,
+    const std::string& scratch_dir, const Clock& clock);
+
+}  // namespace performance_calibrator
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_PERFORMANCE_CALIBRATOR_H_
@@ -0,0 +1,141 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/performance-calibrator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/file-backed-proto.h"
+#include "icing/file/filesystem.h"
+#include "icing/portable/equals-proto.h"
+#include "icing/proto/internal/performance.pb.h"
+#include "icing/testing/common-matchers.h"
+#include "icing/testing/tmp-directory.h"
+#include "icing/util/clock.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::icing::lib::portable_equals_proto::EqualsProto;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsEmpty;
+using ::testing::IsFalse;
+
+class PerformanceCalibratorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    test_dir_ = GetTestTempDir() + "/performance_calibrator";
+    profile_filename_ = test_dir_ + "/device_profile";
+    filesystem_.CreateDirectoryRecursively(test_dir_.c_str());
+  }
+
+  void TearDown() override {
+    filesystem_.DeleteDirectoryRecursively(test_dir_.c_str());
+  }
+
+  Filesystem filesystem_;
+  Clock clock_;
+  std::string test_dir_;
+  std::string profile_filename_;
+};
+
+TEST_F(PerformanceCalibratorTest, ProbeDeviceMeasuresEverything) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DeviceProfileProto profile,
+      performance_calibrator::ProbeDevice(filesystem_, test_dir_, clock_));
+  EXPECT_THAT(profile.probe_version(),
+              Eq(performance_calibrator::kProbeVersion));
+  EXPECT_THAT(profile.rank_ns_per_hit(), Gt(0));
+  EXPECT_THAT(profile.decode_ns_per_value(), Gt(0));
+  EXPECT_THAT(profile.random_read_latency_us(), Gt(0));
+  EXPECT_THAT(profile.num_cores(), Gt(0));
+  EXPECT_THAT(profile.available_memory_bytes(), Gt(0));
+}
+
+TEST_F(PerformanceCalibratorTest, ProbeDeviceRemovesScratchFile) {
+  ICING_ASSERT_OK(
+      performance_calibrator::ProbeDevice(filesystem_, test_dir_, clock_));
+  std::vector<std::string> entries;
+  ASSERT_TRUE(filesystem_.ListDirectory(test_dir_.c_str(), &entries));
+  EXPECT_THAT(entries, IsEmpty());
+}
+
+TEST_F(PerformanceCalibratorTest, ProbeDeviceFailsWithoutScratchDir) {
+  EXPECT_THAT(performance_calibrator::ProbeDevice(
+                  filesystem_, test_dir_ + "/does_not_exist", clock_),
+              StatusIs(libtextclassifier3::StatusCode::INTERNAL));
+}
+
+TEST_F(PerformanceCalibratorTest, GetOrCreateDeviceProfileSavesProfile) {
+  ASSERT_THAT(filesystem_.FileExists(profile_filename_.c_str()), IsFalse());
+  ICING_ASSERT_OK_AND_ASSIGN(DeviceProfileProto profile,
+                             performance_calibrator::GetOrCreateDeviceProfile(
+                                 filesystem_, profile_filename_, test_dir_,
+                                 clock_));
+
+  FileBackedProto<DeviceProfileProto> profile_file(filesystem_,
+                                                   profile_filename_);
+  ICING_ASSERT_OK_AND_ASSIGN(const DeviceProfileProto* saved_profile,
+                             profile_file.Read());
+  EXPECT_THAT(*saved_profile, EqualsProto(profile));
+}
+
+TEST_F(PerformanceCalibratorTest, GetOrCreateDeviceProfileReusesProfile) {
+  DeviceProfileProto profile;
+  profile.set_probe_version(performance_calibrator::kProbeVersion);
+  profile.set_rank_ns_per_hit(123);
+  profile.set_num_cores(7);
+  {
+    FileBackedProto<DeviceProfileProto> profile_file(filesystem_,
+                                                     profile_filename_);
+    ICING_ASSERT_OK(
+        profile_file.Write(std::make_unique<DeviceProfileProto>(profile)));
+  }
+
+  EXPECT_THAT(performance_calibrator::GetOrCreateDeviceProfile(
+                  filesystem_, profile_filename_, test_dir_, clock_),
+              IsOkAndHolds(EqualsProto(profile)));
+}
+
+TEST_F(PerformanceCalibratorTest, GetOrCreateDeviceProfileReprobesOldVersion) {
+  DeviceProfileProto old_profile;
+  old_profile.set_probe_version(performance_calibrator::kProbeVersion - 1);
+  old_profile.set_rank_ns_per_hit(-1);
+  {
+    FileBackedProto<DeviceProfileProto> profile_file(filesystem_,
+                                                     profile_filename_);
+    ICING_ASSERT_OK(
+        profile_file.Write(std::make_unique<DeviceProfileProto>(old_profile)));
+  }
+
+  ICING_ASSERT_OK_AND_ASSIGN(DeviceProfileProto profile,
+                             performance_calibrator::GetOrCreateDeviceProfile(
+                                 filesystem_, profile_filename_, test_dir_,
+                                 clock_));
+  EXPECT_THAT(profile.probe_version(),
+              Eq(performance_calibrator::kProbeVersion));
+  EXPECT_THAT(profile.rank_ns_per_hit(), Gt(0));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -14,6 +14,10 @@
 
 #include "icing/performance-configuration.h"
 
+#include <algorithm>
+#include <cstdint>
+
+#include "icing/proto/internal/performance.pb.h"
 #include "icing/result/result-state.h"
 #include "icing/scoring/scored-document-hit.h"
 
@@ -65,11 +69,96 @@ constexpr int kSafeMemoryUsage = 4 * 1024 * 1024;  // 4MB
 // The maximum number of hits that can fit below the kSafeMemoryUsage threshold.
 constexpr int kMaxNumTotalHits = kSafeMemoryUsage / sizeof(ScoredDocumentHit);
 
+// Same as the default of IcingSearchEngineOptions.index_merge_size.
+constexpr int kDefaultIndexMergeSize = 1024 * 1024;  // 1 MiB
+
+// Device-dependent thresholds:
+// FromDeviceProfile scales the thresholds above by how the device compares to
+// the one they were chosen for, as measured by //icing:performance-calibrator.
+//
+// 1. num_to_score scales with the rank probe. The 3 ms that the search budget
+//    above gives scoring and ranking 30000 hits leaves 100 ns per hit.
+// 2. max_query_length scales with the decode probe, since QueryProcessor
+//    spends most of its time decoding posting lists. kReferenceDecodeNsPerValue
+//    is about three times what the probe reports on a current desktop core,
+//    a conservative stand-in for the phone the default was chosen on.
+// 3. If the device has a single core, everything else running on it competes
+//    with the query for that core, so only half the measured speed is counted
+//    on.
+//
+// Scale factors are clamped so that a disturbed probe can't make the limits
+// unreasonable.
+constexpr double kReferenceRankNsPerHit = 100;
+constexpr double kReferenceDecodeNsPerValue = 30;
+constexpr double kMinSpeedFactor = 0.25;
+constexpr double kMaxSpeedFactor = 4;
+
+// 4. Result states may use 1/256th of the available memory, which gives the
+//    4 MB above on a device with 1 GB available, and are kept between 1 MB and
+//    16 MB.
+constexpr int64_t kMemoryToResultStatesRatio = 256;
+constexpr int64_t kMinResultStateMemory = 1024 * 1024;       // 1 MB
+constexpr int64_t kMaxResultStateMemory = 16 * 1024 * 1024;  // 16 MB
+
+// 5. The lite index may use 1/1024th of the available memory, which gives the
+//    default 1 MiB on a device with 1 GiB available. Every merge rewrites
+//    posting lists in the main index, so on devices with slow storage merges
+//    are made less frequent by up to 4 times. kReferenceReadLatencyUs is
+//    typical of an uncached random read from phone flash storage.
+constexpr int64_t kMemoryToIndexMergeSizeRatio = 1024;
+constexpr double kReferenceReadLatencyUs = 100;
+constexpr double kMaxStorageFactor = 4;
+constexpr int64_t kMinIndexMergeSize = 256 * 1024;       // 256 KiB
+constexpr int64_t kMaxIndexMergeSize = 4 * 1024 * 1024;  // 4 MiB
+
+// Returns how many times faster than the reference the device ran a probe.
+double SpeedFactor(double reference_ns, double measured_ns, int num_cores) {
+  double factor = measured_ns > 0 ? reference_ns / measured_ns : 1;
+  if (num_cores <= 1) {
+    factor /= 2;
+  }
+  return std::clamp(factor, kMinSpeedFactor, kMaxSpeedFactor);
+}
+
 }  // namespace
 
 PerformanceConfiguration::PerformanceConfiguration()
     : PerformanceConfiguration(kMaxQueryLength, kDefaultNumToScore,
                                kMaxNumTotalHits) {}
 
+PerformanceConfiguration::PerformanceConfiguration(int max_query_length_in,
+                                                   int num_to_score_in,
+                                                   int max_num_total_hits)
+    : PerformanceConfiguration(max_query_length_in, num_to_score_in,
+                               max_num_total_hits, kDefaultIndexMergeSize) {}
+
+PerformanceConfiguration PerformanceConfiguration::FromDeviceProfile(
+    const DeviceProfileProto& profile) {
+  int max_query_length =
+      kMaxQueryLength * SpeedFactor(kReferenceDecodeNsPerValue,
+                                    profile.decode_ns_per_value(),
+                                    profile.num_cores());
+  int num_to_score =
+      kDefaultNumToScore * SpeedFactor(kReferenceRankNsPerHit,
+                                       profile.rank_ns_per_hit(),
+                                       profile.num_cores());
+
+  int64_t result_state_memory =
+      std::clamp(profile.available_memory_bytes() / kMemoryToResultStatesRatio,
+                 kMinResultStateMemory, kMaxResultStateMemory);
+  int max_num_total_hits = result_state_memory / sizeof(ScoredDocumentHit);
+
+  double storage_factor =
+      std::clamp(profile.random_read_latency_us() / kReferenceReadLatencyUs,
+                 1.0, kMaxStorageFactor);
+  int64_t index_merge_size = std::clamp(
+      static_cast<int64_t>(profile.available_memory_bytes() /
+                           kMemoryToIndexMergeSizeRatio * storage_factor),
+      kMinIndexMergeSize, kMaxIndexMergeSize);
+
+  return PerformanceConfiguration(max_query_length, num_to_score,
+                                  max_num_total_hits, index_merge_size);
+}
+
 }  // namespace lib
 }  // namespace icing
@@ -15,6 +15,8 @@
 #ifndef ICING_PERFORMANCE_CONFIGURATION_H_
 #define ICING_PERFORMANCE_CONFIGURATION_H_
 
+#include "icing/proto/internal/performance.pb.h"
+
 namespace icing {
 namespace lib {
 
@@ -24,10 +26,20 @@ struct PerformanceConfiguration {
   PerformanceConfiguration();
 
   PerformanceConfiguration(int max_query_length_in, int num_to_score_in,
-                           int max_num_total_hits)
+                           int max_num_total_hits);
+
+  PerformanceConfiguration(int max_query_length_in, int num_to_score_in,
+                           int max_num_total_hits, int index_merge_size_in)
       : max_query_length(max_query_length_in),
         num_to_score(num_to_score_in),
-        max_num_total_hits(max_num_total_hits) {}
+        max_num_total_hits(max_num_total_hits),
+        index_merge_size(index_merge_size_in) {}
+
+  // Derives the thresholds from what was measured about the device, scaling
+  // the defaults by how much faster or slower the device is than the one they
+  // were chosen for.
+  static PerformanceConfiguration FromDeviceProfile(
+      const DeviceProfileProto& profile);
 
   // Search performance
 
@@ -42,11 +54,13 @@ struct PerformanceConfiguration {
   // Maximum number of ScoredDocumentHits to cache in the ResultStateManager at
   // one time.
   int max_num_total_hits;
-};
 
-// TODO(b/149040810): Consider creating a class to manage performance
-// configurations according to different devices/platforms/clients and even
-// real-time memory usage.
+  // Indexing performance
+
+  // Size, in bytes, that the lite index may grow to before it's merged into
+  // the main index.
+  int index_merge_size;
+};
 
 }  // namespace lib
 }  // namespace icing
@@ -0,0 +1,128 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/performance-configuration.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/proto/internal/performance.pb.h"
+#include "icing/scoring/scored-document-hit.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::Eq;
+
+// A device on which the derived thresholds are the defaults.
+DeviceProfileProto CreateReferenceProfile() {
+  DeviceProfileProto profile;
+  profile.set_rank_ns_per_hit(100);
+  profile.set_decode_ns_per_value(30);
+  profile.set_random_read_latency_us(100);
+  profile.set_num_cores(8);
+  profile.set_available_memory_bytes(1024 * 1024 * 1024);
+  return profile;
+}
+
+TEST(PerformanceConfigurationTest, ReferenceDeviceGetsDefaults) {
+  PerformanceConfiguration defaults;
+  PerformanceConfiguration configuration =
+      PerformanceConfiguration::FromDeviceProfile(CreateReferenceProfile());
+  EXPECT_THAT(configuration.max_query_length, Eq(defaults.max_query_length));
+  EXPECT_THAT(configuration.num_to_score, Eq(defaults.num_to_score));
+  EXPECT_THAT(configuration.max_num_total_hits,
+              Eq(defaults.max_num_total_hits));
+  EXPECT_THAT(configuration.index_merge_size, Eq(defaults.index_merge_size));
+}
+
+TEST(PerformanceConfigurationTest, FasterDeviceGetsHigherSearchLimits) {
+  DeviceProfileProto profile = CreateReferenceProfile();
+  profile.set_rank_ns_per_hit(50);
+  profile.set_decode_ns_per_value(15);
+
+  PerformanceConfiguration defaults;
+  PerformanceConfiguration configuration =
+      PerformanceConfiguration::FromDeviceProfile(profile);
+  EXPECT_THAT(configuration.max_query_length,
+              Eq(2 * defaults.max_query_length));
+  EXPECT_THAT(configuration.num_to_score, Eq(2 * defaults.num_to_score));
+}
+
+TEST(PerformanceConfigurationTest, SingleCoreDeviceGetsLowerSearchLimits) {
+  DeviceProfileProto profile = CreateReferenceProfile();
+  profile.set_num_cores(1);
+
+  PerformanceConfiguration defaults;
+  PerformanceConfiguration configuration =
+      PerformanceConfiguration::FromDeviceProfile(profile);
+  EXPECT_THAT(configuration.max_query_length,
+              Eq(defaults.max_query_length / 2));
+  EXPECT_THAT(configuration.num_to_score, Eq(defaults.num_to_score / 2));
+}
+
+TEST(PerformanceConfigurationTest, SearchLimitsAreClamped) {
+  DeviceProfileProto profile = CreateReferenceProfile();
+  profile.set_rank_ns_per_hit(1e6);
+  profile.set_decode_ns_per_value(1e-3);
+
+  PerformanceConfiguration defaults;
+  PerformanceConfiguration configuration =
+      PerformanceConfiguration::FromDeviceProfile(profile);
+  EXPECT_THAT(configuration.max_query_length,
+              Eq(4 * defaults.max_query_length));
+  EXPECT_THAT(configuration.num_to_score, Eq(defaults.num_to_score / 4));
+}
+
+TEST(PerformanceConfigurationTest, MemoryLimitsFollowAvailableMemory) {
+  DeviceProfileProto profile = CreateReferenceProfile();
+  PerformanceConfiguration defaults;
+
+  profile.set_available_memory_bytes(2LL * 1024 * 1024 * 1024);
+  PerformanceConfiguration configuration =
+      PerformanceConfiguration::FromDeviceProfile(profile);
+  EXPECT_THAT(configuration.max_num_total_hits,
+              Eq(2 * defaults.max_num_total_hits));
+  EXPECT_THAT(configuration.index_merge_size,
+              Eq(2 * defaults.index_merge_size));
+
+  // Even a device with hardly any memory left gets something to work with.
+  profile.set_available_memory_bytes(0);
+  configuration = PerformanceConfiguration::FromDeviceProfile(profile);
+  EXPECT_THAT(configuration.max_num_total_hits,
+              Eq(1024 * 1024 / sizeof(ScoredDocumentHit)));
+  EXPECT_THAT(configuration.index_merge_size, Eq(256 * 1024));
+}
+
+TEST(PerformanceConfigurationTest, SlowStorageGetsLargerIndexMergeSize) {
+  DeviceProfileProto profile = CreateReferenceProfile();
+  PerformanceConfiguration defaults;
+
+  profile.set_random_read_latency_us(200);
+  EXPECT_THAT(PerformanceConfiguration::FromDeviceProfile(profile)
+                  .index_merge_size,
+              Eq(2 * defaults.index_merge_size));
+
+  // Faster storage than the reference doesn't make merges more frequent.
+  profile.set_random_read_latency_us(10);
+  EXPECT_THAT(PerformanceConfiguration::FromDeviceProfile(profile)
+                  .index_merge_size,
+              Eq(defaults.index_merge_size));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
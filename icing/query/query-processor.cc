@@ -40,6 +40,7 @@
 #include "icing/schema/section.h"
 #include "icing/store/document-id.h"
 #include "icing/store/document-store.h"
+#include "icing/store/namespace-id.h"
 #include "icing/tokenization/language-segmenter.h"
 #include "icing/tokenization/raw-query-tokenizer.h"
 #include "icing/tokenization/token.h"
@@ -97,6 +98,22 @@ std::unique_ptr<DocHitInfoIterator> ProcessParserStateFrame(
   return CreateAndIterator(std::move(parser_state_frame.and_iterators));
 }
 
+// Returns the ids of the namespaces that search_spec is restricted to, so that
+// a partitioned index only searches their partitions. Returns an empty vector,
+// which searches all partitions, if there's no restriction or none of the
+// namespaces exist.
+std::vector<NamespaceId> GetNamespaceIds(const SearchSpecProto& search_spec,
+                                         const DocumentStore& document_store) {
+  std::vector<NamespaceId> namespace_ids;
+  for (const std::string& name_space : search_spec.namespace_filters()) {
+    auto namespace_id_or = document_store.GetNamespaceId(name_space);
+    if (namespace_id_or.ok()) {
+      namespace_ids.push_back(namespace_id_or.ValueOrDie());
+    }
+  }
+  return namespace_ids;
+}
+
 }  // namespace
 
 libtextclassifier3::StatusOr<std::unique_ptr<QueryProcessor>>
@@ -146,7 +163,14 @@ DocHitInfoIteratorFilter::Options QueryProcessor::getFilterOptions(
 
 libtextclassifier3::StatusOr<QueryProcessor::QueryResults>
 QueryProcessor::ParseSearch(const SearchSpecProto& search_spec) {
-  ICING_ASSIGN_OR_RETURN(QueryResults results, ParseRawQuery(search_spec));
+  return ParseSearch(search_spec, Index::HitScope::kAll);
+}
+
+libtextclassifier3::StatusOr<QueryProcessor::QueryResults>
+QueryProcessor::ParseSearch(const SearchSpecProto& search_spec,
+                            Index::HitScope hit_scope) {
+  ICING_ASSIGN_OR_RETURN(QueryResults results,
+                         ParseRawQuery(search_spec, hit_scope));
 
   DocHitInfoIteratorFilter::Options options = getFilterOptions(search_spec);
   results.root_iterator = std::make_unique<DocHitInfoIteratorFilter>(
@@ -157,8 +181,17 @@ QueryProcessor::ParseSearch(const SearchSpecProto& search_spec) {
 
 // TODO(cassiewang): Collect query stats to populate the SearchResultsProto
 libtextclassifier3::StatusOr<QueryProcessor::QueryResults>
-QueryProcessor::ParseRawQuery(const SearchSpecProto& search_spec) {
+QueryProcessor::ParseRawQuery(const SearchSpecProto& search_spec,
+                              Index::HitScope hit_scope) {
+  // Only the documents that match the query terms rank among the champions.
+  // Excluded terms and query_term_iterators need all hits within the scope.
+  Index::HitScope all_hits_scope = hit_scope == Index::HitScope::kChampions
+                                       ? Index::HitScope::kAll
+                                       : hit_scope;
+
   DocHitInfoIteratorFilter::Options options = getFilterOptions(search_spec);
+  std::vector<NamespaceId> namespace_ids =
+      GetNamespaceIds(search_spec, document_store_);
 
   // Tokenize the incoming raw query
   //
@@ -257,8 +290,11 @@ QueryProcessor::ParseRawQuery(const SearchSpecProto& search_spec) {
 
         ICING_ASSIGN_OR_RETURN(
             result_iterator,
-            index_.GetIterator(normalized_text, kSectionIdMaskAll,
-                               search_spec.term_match_type()));
+            index_.GetIterator(
+                normalized_text, kSectionIdMaskAll,
+                search_spec.term_match_type(),
+                frames.top().saw_exclude ? all_hits_scope : hit_scope,
+                &results.champion_threshold, namespace_ids));
 
         // Add term iterator and terms to match if this is not a negation term.
         // WARNING: setting query terms at this point is not compatible with
@@ -269,7 +305,8 @@ QueryProcessor::ParseRawQuery(const SearchSpecProto& search_spec) {
           ICING_ASSIGN_OR_RETURN(
               std::unique_ptr<DocHitInfoIterator> term_iterator,
               index_.GetIterator(normalized_text, kSectionIdMaskAll,
-                                 search_spec.term_match_type()));
+                                 search_spec.term_match_type(), all_hits_scope,
+                                 &results.champion_threshold, namespace_ids));
 
           results.query_term_iterators[normalized_text] =
               std::make_unique<DocHitInfoIteratorFilter>(
@@ -16,6 +16,7 @@
 #define ICING_QUERY_QUERY_PROCESSOR_H_
 
 #include <memory>
+#include <optional>
 
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/index/index.h"
@@ -58,6 +59,10 @@ class QueryProcessor {
     // beginning with root_iterator.
     std::unordered_map<std::string, std::unique_ptr<DocHitInfoIterator>>
         query_term_iterators;
+    // Only set for Index::HitScope::kChampions. If set, root_iterator is only
+    // guaranteed to return the matching documents that rank at or above this
+    // by document score.
+    std::optional<ChampionRank> champion_threshold;
   };
   // Parse the search configurations (including the query, any additional
   // filters, etc.) in the SearchSpecProto into one DocHitInfoIterator.
@@ -71,6 +76,21 @@ class QueryProcessor {
   libtextclassifier3::StatusOr<QueryResults> ParseSearch(
       const SearchSpecProto& search_spec);
 
+  // Like ParseSearch, but the query's terms only retrieve the hits in
+  // hit_scope. Excluded terms retrieve all their hits for kChampions.
+  // query_term_iterators are unaffected unless hit_scope is kMain.
+  //
+  // Returns:
+  //   On success,
+  //     - One iterator that represents the entire query within hit_scope
+  //     - A map representing the query terms and any section restrictions
+  //     - For kChampions, the rank from which on down the results may
+  //       be incomplete
+  //   INVALID_ARGUMENT if query syntax is incorrect and cannot be tokenized
+  //   INTERNAL_ERROR on all other errors
+  libtextclassifier3::StatusOr<QueryResults> ParseSearch(
+      const SearchSpecProto& search_spec, Index::HitScope hit_scope);
+
  private:
   explicit QueryProcessor(Index* index,
                           const LanguageSegmenter* language_segmenter,
@@ -88,7 +108,7 @@ class QueryProcessor {
   //   INVALID_ARGUMENT if query syntax is incorrect and cannot be tokenized
   //   INTERNAL_ERROR on all other errors
   libtextclassifier3::StatusOr<QueryResults> ParseRawQuery(
-      const SearchSpecProto& search_spec);
+      const SearchSpecProto& search_spec, Index::HitScope hit_scope);
 
   // Return the options for the DocHitInfoIteratorFilter based on the
   // search_spec.
@@ -16,8 +16,10 @@
 #define ICING_RESULT_PAGE_RESULT_STATE_H_
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
+#include "icing/proto/search.pb.h"
 #include "icing/result/projection-tree.h"
 #include "icing/result/snippet-context.h"
 #include "icing/scoring/scored-document-hit.h"
@@ -57,6 +59,13 @@ struct PageResultState {
   // The page size for this query. This should always be >=
   // scored_document_hits.size();
   int requested_page_size;
+
+  // Whether the page after this one should be prefetched.
+  bool prefetch_next_page = false;
+
+  // The retrieved results of scored_document_hits, if this page was
+  // prefetched and no document has changed since.
+  std::optional<std::vector<SearchResultProto::ResultProto>> prefetched_results;
 };
 
 }  // namespace lib
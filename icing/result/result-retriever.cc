@@ -14,10 +14,14 @@
 
 #include "icing/result/result-retriever.h"
 
+#include <iterator>
 #include <string_view>
 #include <utility>
+#include <vector>
 
+#include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include <google/protobuf/repeated_field.h>
 #include "icing/proto/search.pb.h"
 #include "icing/proto/term.pb.h"
 #include "icing/result/page-result-state.h"
@@ -50,8 +54,20 @@ ResultRetriever::Create(const DocumentStore* doc_store,
 libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>
 ResultRetriever::RetrieveResults(
     const PageResultState& page_result_state) const {
-  std::vector<SearchResultProto::ResultProto> search_results;
-  search_results.reserve(page_result_state.scored_document_hits.size());
+  google::protobuf::RepeatedPtrField<SearchResultProto::ResultProto> results;
+  ICING_RETURN_IF_ERROR(RetrieveResults(page_result_state, &results));
+  return std::vector<SearchResultProto::ResultProto>(
+      std::make_move_iterator(results.begin()),
+      std::make_move_iterator(results.end()));
+}
+
+libtextclassifier3::Status ResultRetriever::RetrieveResults(
+    const PageResultState& page_result_state,
+    google::protobuf::RepeatedPtrField<SearchResultProto::ResultProto>* results)
+    const {
+  results->Reserve(results->size() +
+                   page_result_state.scored_document_hits.size());
+  int num_results = 0;
 
   const SnippetContext& snippet_context = page_result_state.snippet_context;
   // Calculates how many snippets to return for this page.
@@ -67,50 +83,50 @@ ResultRetriever::RetrieveResults(
           std::string(ProjectionTree::kSchemaTypeWildcard));
   for (const auto& scored_document_hit :
        page_result_state.scored_document_hits) {
-    libtextclassifier3::StatusOr<DocumentProto> document_or =
-        doc_store_.Get(scored_document_hit.document_id());
-
-    if (!document_or.ok()) {
+    // The document is read straight into the result, which is dropped again
+    // if the document can't be read.
+    SearchResultProto::ResultProto* result = results->Add();
+    DocumentProto* document = result->mutable_document();
+    libtextclassifier3::Status status =
+        doc_store_.Get(scored_document_hit.document_id(), document);
+
+    if (!status.ok()) {
+      results->RemoveLast();
       // Internal errors from document store are IO errors, return directly.
-      if (absl_ports::IsInternal(document_or.status())) {
-        return document_or.status();
+      if (absl_ports::IsInternal(status)) {
+        return status;
       }
 
       if (ignore_bad_document_ids_) {
         continue;
       } else {
-        return document_or.status();
+        return status;
       }
     }
 
-    DocumentProto document = std::move(document_or).ValueOrDie();
     // Apply projection
-    auto itr = page_result_state.projection_tree_map.find(document.schema());
+    auto itr = page_result_state.projection_tree_map.find(document->schema());
     if (itr != page_result_state.projection_tree_map.end()) {
-      projector::Project(itr->second.root().children, &document);
+      projector::Project(itr->second.root().children, document);
     } else if (wildcard_projection_tree_itr !=
                page_result_state.projection_tree_map.end()) {
       projector::Project(wildcard_projection_tree_itr->second.root().children,
-                         &document);
+                         document);
     }
 
-    SearchResultProto::ResultProto result;
     // Add the snippet if requested.
     if (snippet_context.snippet_spec.num_matches_per_property() > 0 &&
-        remaining_num_to_snippet > search_results.size()) {
-      SnippetProto snippet_proto = snippet_retriever_->RetrieveSnippet(
+        remaining_num_to_snippet > num_results) {
+      snippet_retriever_->RetrieveSnippet(
           snippet_context.query_terms, snippet_context.match_type,
-          snippet_context.snippet_spec, document,
-          scored_document_hit.hit_section_id_mask());
-      *result.mutable_snippet() = std::move(snippet_proto);
+          snippet_context.snippet_spec, *document,
+          scored_document_hit.hit_section_id_mask(), result->mutable_snippet());
     }
 
-    // Add the document, itself.
-    *result.mutable_document() = std::move(document);
-    result.set_score(scored_document_hit.score());
-    search_results.push_back(std::move(result));
+    result->set_score(scored_document_hit.score());
+    ++num_results;
   }
-  return search_results;
+  return libtextclassifier3::Status::OK;
 }
 
 }  // namespace lib
@@ -18,7 +18,9 @@
 #include <utility>
 #include <vector>
 
+#include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include <google/protobuf/repeated_field.h>
 #include "icing/proto/search.pb.h"
 #include "icing/proto/term.pb.h"
 #include "icing/query/query-terms.h"
@@ -76,6 +78,19 @@ class ResultRetriever {
   libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>
   RetrieveResults(const PageResultState& page_result_state) const;
 
+  // Same as above, but appends the results to the given ones. Everything that
+  // is decoded, projected and snippeted for them is allocated directly on the
+  // arena of results, if it has one. On error, results may hold some of the
+  // page's results.
+  //
+  // Returns:
+  //   OK on success
+  //   Otherwise the same errors as above
+  libtextclassifier3::Status RetrieveResults(
+      const PageResultState& page_result_state,
+      google::protobuf::RepeatedPtrField<SearchResultProto::ResultProto>*
+          results) const;
+
  private:
   explicit ResultRetriever(const DocumentStore* doc_store,
                            std::unique_ptr<SnippetRetriever> snippet_retriever,
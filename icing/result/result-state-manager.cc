@@ -14,6 +14,9 @@
 
 #include "icing/result/result-state-manager.h"
 
+#include <memory>
+#include <utility>
+
 #include "icing/proto/search.pb.h"
 #include "icing/util/clock.h"
 #include "icing/util/logging.h"
@@ -27,6 +30,7 @@ ResultStateManager::ResultStateManager(int max_total_hits,
     : document_store_(document_store),
       max_total_hits_(max_total_hits),
       num_total_hits_(0),
+      num_result_states_(0),
       random_generator_(GetSteadyTimeNanoseconds()) {}
 
 libtextclassifier3::StatusOr<PageResultState>
@@ -39,6 +43,7 @@ ResultStateManager::RankAndPaginate(ResultState result_state) {
   // change after returning more results.
   int num_previously_returned = result_state.num_returned();
   int num_per_page = result_state.num_per_page();
+  bool prefetch_next_page = result_state.prefetch_next_page();
 
   std::vector<ScoredDocumentHit> page_result_document_hits =
       result_state.GetNextPage(document_store_);
@@ -60,10 +65,12 @@ ResultStateManager::RankAndPaginate(ResultState result_state) {
   // ResultState has multiple pages, storing it
   uint64_t next_page_token = Add(std::move(result_state));
 
-  return PageResultState(std::move(page_result_document_hits), next_page_token,
-                         std::move(snippet_context_copy),
-                         std::move(projection_tree_map_copy),
-                         num_previously_returned, num_per_page);
+  PageResultState page_result_state(
+      std::move(page_result_document_hits), next_page_token,
+      std::move(snippet_context_copy), std::move(projection_tree_map_copy),
+      num_previously_returned, num_per_page);
+  page_result_state.prefetch_next_page = prefetch_next_page;
+  return page_result_state;
 }
 
 uint64_t ResultStateManager::Add(ResultState result_state) {
@@ -72,51 +79,147 @@ uint64_t ResultStateManager::Add(ResultState result_state) {
 
   uint64_t new_token = GetUniqueToken();
 
-  num_total_hits_ += result_state.num_remaining();
-  result_state_map_.emplace(new_token, std::move(result_state));
+  int num_hits = result_state.num_remaining();
+  num_total_hits_ += num_hits;
+  ++num_result_states_;
+  Shard& shard = GetShard(new_token);
+  {
+    absl_ports::unique_lock shard_lock(&shard.mutex);
+    shard.result_states.emplace(new_token,
+                                std::make_shared<GuardedResultState>(
+                                    std::move(result_state), num_hits));
+  }
   // Tracks the insertion order
   token_queue_.push(new_token);
 
   return new_token;
 }
 
+std::shared_ptr<ResultStateManager::GuardedResultState>
+ResultStateManager::FindResultState(uint64_t token) {
+  Shard& shard = GetShard(token);
+  absl_ports::shared_lock shard_lock(&shard.mutex);
+  auto itr = shard.result_states.find(token);
+  if (itr == shard.result_states.end()) {
+    return nullptr;
+  }
+  return itr->second;
+}
+
 libtextclassifier3::StatusOr<PageResultState> ResultStateManager::GetNextPage(
     uint64_t next_page_token) {
-  absl_ports::unique_lock l(&mutex_);
+  std::shared_ptr<GuardedResultState> state = FindResultState(next_page_token);
+  if (state == nullptr) {
+    return absl_ports::NotFoundError("next_page_token not found");
+  }
 
-  const auto& state_iterator = result_state_map_.find(next_page_token);
-  if (state_iterator == result_state_map_.end()) {
+  absl_ports::unique_lock state_lock(&state->mutex);
+  if (state->invalidated) {
     return absl_ports::NotFoundError("next_page_token not found");
   }
 
-  int num_returned = state_iterator->second.num_returned();
-  int num_per_page = state_iterator->second.num_per_page();
-  std::vector<ScoredDocumentHit> result_of_page =
-      state_iterator->second.GetNextPage(document_store_);
-  if (result_of_page.empty()) {
-    // This shouldn't happen, all our active states should contain results, but
-    // a sanity check here in case of any data inconsistency.
-    InternalInvalidateResultState(next_page_token);
-    return absl_ports::NotFoundError(
-        "No more results, token has been invalidated.");
+  PageResultState page_result_state = TakePrefetchedOrNextPage(*state);
+  bool has_more_results = state->result_state.HasMoreResults();
+
+  {
+    absl_ports::unique_lock l(&mutex_);
+    if (page_result_state.scored_document_hits.empty()) {
+      // This shouldn't happen, all our active states should contain results,
+      // but a sanity check here in case of any data inconsistency.
+      InternalInvalidateResultState(next_page_token);
+      return absl_ports::NotFoundError(
+          "No more results, token has been invalidated.");
+    }
+
+    int num_hits = page_result_state.scored_document_hits.size();
+    if (state->invalidated) {
+      // The state was evicted while this page was being retrieved. Its hits
+      // are no longer counted, but the page can still be returned.
+      next_page_token = kInvalidNextPageToken;
+    } else {
+      // Hits loaded from the lower tier of the state are counted once they
+      // exist.
+      int num_loaded_hits = state->result_state.num_lower_tier_hits() -
+                            state->num_accounted_lower_tier_hits;
+      state->num_accounted_lower_tier_hits += num_loaded_hits;
+      num_hits -= num_loaded_hits;
+      num_total_hits_ -= num_hits;
+      state->num_accounted_hits -= num_hits;
+      if (!has_more_results) {
+        InternalInvalidateResultState(next_page_token);
+        next_page_token = kInvalidNextPageToken;
+      }
+    }
+  }
+
+  page_result_state.next_page_token = next_page_token;
+  return page_result_state;
+}
+
+libtextclassifier3::Status ResultStateManager::PrefetchNextPage(
+    uint64_t next_page_token, const RetrieveResultsFn& retrieve_results) {
+  std::shared_ptr<GuardedResultState> state = FindResultState(next_page_token);
+  if (state == nullptr) {
+    return libtextclassifier3::Status::OK;
+  }
+
+  // Holding the state's lock while retrieving makes a concurrent GetNextPage
+  // wait for the prefetched page rather than retrieve the one after it.
+  absl_ports::unique_lock state_lock(&state->mutex);
+  if (state->invalidated || state->prefetched_page.has_value() ||
+      !state->result_state.HasMoreResults()) {
+    return libtextclassifier3::Status::OK;
+  }
+
+  uint64_t results_generation = results_generation_;
+  state->prefetched_page = TakeNextPage(*state);
+  state->prefetched_results_generation = results_generation;
+  if (state->prefetched_page->scored_document_hits.empty()) {
+    return libtextclassifier3::Status::OK;
   }
+  ICING_ASSIGN_OR_RETURN(state->prefetched_page->prefetched_results,
+                         retrieve_results(*state->prefetched_page));
+  return libtextclassifier3::Status::OK;
+}
+
+PageResultState ResultStateManager::TakeNextPage(GuardedResultState& state) {
+  // Gets the number before calling GetNextPage() because num_returned() may
+  // change after returning more results.
+  int num_returned = state.result_state.num_returned();
+  int num_per_page = state.result_state.num_per_page();
+  std::vector<ScoredDocumentHit> result_of_page =
+      state.result_state.GetNextPage(document_store_);
 
   // Copies the SnippetContext in case the ResultState is invalidated.
-  SnippetContext snippet_context_copy =
-      state_iterator->second.snippet_context();
+  SnippetContext snippet_context_copy = state.result_state.snippet_context();
 
   std::unordered_map<std::string, ProjectionTree> projection_tree_map_copy =
-      state_iterator->second.projection_tree_map();
+      state.result_state.projection_tree_map();
+
+  PageResultState page_result_state(
+      std::move(result_of_page), kInvalidNextPageToken,
+      std::move(snippet_context_copy), std::move(projection_tree_map_copy),
+      num_returned, num_per_page);
+  page_result_state.prefetch_next_page =
+      state.result_state.prefetch_next_page();
+  return page_result_state;
+}
 
-  if (!state_iterator->second.HasMoreResults()) {
-    InternalInvalidateResultState(next_page_token);
-    next_page_token = kInvalidNextPageToken;
+PageResultState ResultStateManager::TakePrefetchedOrNextPage(
+    GuardedResultState& state) {
+  if (!state.prefetched_page.has_value()) {
+    return TakeNextPage(state);
   }
-
-  num_total_hits_ -= result_of_page.size();
-  return PageResultState(
-      result_of_page, next_page_token, std::move(snippet_context_copy),
-      std::move(projection_tree_map_copy), num_returned, num_per_page);
+  PageResultState page_result_state = std::move(*state.prefetched_page);
+  state.prefetched_page.reset();
+  if (state.prefetched_results_generation != results_generation_) {
+    // Documents may have changed since the page was prefetched, so takes it
+    // again to leave out the hits of deleted documents and make up for them.
+    state.result_state.UndoLastPage(
+        std::move(page_result_state.scored_document_hits));
+    return TakeNextPage(state);
+  }
+  return page_result_state;
 }
 
 void ResultStateManager::InvalidateResultState(uint64_t next_page_token) {
@@ -134,8 +237,29 @@ void ResultStateManager::InvalidateAllResultStates() {
   InternalInvalidateAllResultStates();
 }
 
+int ResultStateManager::InvalidateOldestResultStates(int num_states_to_keep) {
+  absl_ports::unique_lock l(&mutex_);
+  int num_total_hits_before = num_total_hits_;
+  // Every token in shards_ is also in token_queue_, so the queue can't run out
+  // before enough states have been removed.
+  while (num_result_states_ > num_states_to_keep && !token_queue_.empty()) {
+    uint64_t token = token_queue_.front();
+    token_queue_.pop();
+    invalidated_token_set_.erase(token);
+    RemoveResultState(token);
+  }
+  return num_total_hits_before - num_total_hits_;
+}
+
 void ResultStateManager::InternalInvalidateAllResultStates() {
-  result_state_map_.clear();
+  for (Shard& shard : shards_) {
+    absl_ports::unique_lock shard_lock(&shard.mutex);
+    for (auto& [token, state] : shard.result_states) {
+      state->invalidated = true;
+    }
+    shard.result_states.clear();
+  }
+  num_result_states_ = 0;
   invalidated_token_set_.clear();
   token_queue_ = std::queue<uint64_t>();
   num_total_hits_ = 0;
@@ -145,7 +269,7 @@ uint64_t ResultStateManager::GetUniqueToken() {
   uint64_t new_token = random_generator_();
   // There's a small chance of collision between the random numbers, here we're
   // trying to avoid any collisions by checking the keys.
-  while (result_state_map_.find(new_token) != result_state_map_.end() ||
+  while (FindResultState(new_token) != nullptr ||
          invalidated_token_set_.find(new_token) !=
              invalidated_token_set_.end() ||
          new_token == kInvalidNextPageToken) {
@@ -155,7 +279,7 @@ uint64_t ResultStateManager::GetUniqueToken() {
 }
 
 void ResultStateManager::RemoveStatesIfNeeded(const ResultState& result_state) {
-  if (result_state_map_.empty() || token_queue_.empty()) {
+  if (num_result_states_ == 0 || token_queue_.empty()) {
     return;
   }
 
@@ -186,17 +310,30 @@ void ResultStateManager::RemoveStatesIfNeeded(const ResultState& result_state) {
 }
 
 void ResultStateManager::InternalInvalidateResultState(uint64_t token) {
-  // Removes the entry in result_state_map_ and insert the token into
+  // Removes the entry in shards_ and insert the token into
   // invalidated_token_set_. The entry in token_queue_ can't be easily removed
   // right now (may need O(n) time), so we leave it there and later completely
   // remove the token in RemoveStatesIfNeeded().
-  auto itr = result_state_map_.find(token);
-  if (itr != result_state_map_.end()) {
-    num_total_hits_ -= itr->second.num_remaining();
-    result_state_map_.erase(itr);
+  if (RemoveResultState(token)) {
     invalidated_token_set_.insert(token);
   }
 }
 
+bool ResultStateManager::RemoveResultState(uint64_t token) {
+  Shard& shard = GetShard(token);
+  absl_ports::unique_lock shard_lock(&shard.mutex);
+  auto itr = shard.result_states.find(token);
+  if (itr == shard.result_states.end()) {
+    return false;
+  }
+  // The state's own lock isn't needed, anyone paging through it checks
+  // invalidated under mutex_ before touching the accounting.
+  itr->second->invalidated = true;
+  num_total_hits_ -= itr->second->num_accounted_hits;
+  --num_result_states_;
+  shard.result_states.erase(itr);
+  return true;
+}
+
 }  // namespace lib
 }  // namespace icing
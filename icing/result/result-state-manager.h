@@ -15,11 +15,19 @@
 #ifndef ICING_RESULT_RESULT_STATE_MANAGER_H_
 #define ICING_RESULT_RESULT_STATE_MANAGER_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
+#include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/absl_ports/mutex.h"
 #include "icing/proto/scoring.pb.h"
@@ -35,8 +43,22 @@ namespace lib {
 inline constexpr uint64_t kInvalidNextPageToken = 0;
 
 // Used to store and manage ResultState.
+//
+// Result states are spread over several shards by their token, and each one
+// has its own lock. Paging through independent result states therefore only
+// contends on mutex_, which guards the eviction accounting and is only held
+// for constant time by GetNextPage.
+//
+// Locks are taken in the order: result state, mutex_, shard.
+//
+// This class is thread-safe.
 class ResultStateManager {
  public:
+  // Retrieves the documents, snippets and projections of a page.
+  using RetrieveResultsFn = std::function<
+      libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>(
+          const PageResultState&)>;
+
   explicit ResultStateManager(int max_total_hits,
                               const DocumentStore& document_store);
 
@@ -68,6 +90,25 @@ class ResultStateManager {
   libtextclassifier3::StatusOr<PageResultState> GetNextPage(
       uint64_t next_page_token) ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Takes the next page of results off the result state ahead of time and
+  // retrieves it with retrieve_results. The following GetNextPage returns that
+  // page along with its prefetched_results, unless InvalidatePrefetchedResults
+  // is called in between. Does nothing if the token is invalid or its next
+  // page has already been prefetched.
+  //
+  // Returns:
+  //   OK on success or if there was nothing to prefetch
+  //   Any error from retrieve_results, in which case the following GetNextPage
+  //   still returns the page, without prefetched_results
+  libtextclassifier3::Status PrefetchNextPage(
+      uint64_t next_page_token, const RetrieveResultsFn& retrieve_results)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Drops all prefetched pages, so that they're taken off their result states
+  // and retrieved again when requested. Must be called whenever a document is
+  // added, changed or deleted. Takes constant time.
+  void InvalidatePrefetchedResults() { ++results_generation_; }
+
   // Invalidates the result state associated with the given next-page token.
   void InvalidateResultState(uint64_t next_page_token)
       ICING_LOCKS_EXCLUDED(mutex_);
@@ -75,7 +116,68 @@ class ResultStateManager {
   // Invalidates all result states / tokens currently in ResultStateManager.
   void InvalidateAllResultStates() ICING_LOCKS_EXCLUDED(mutex_);
 
+  // Invalidates result states from oldest to newest until at most
+  // num_states_to_keep are left.
+  //
+  // Returns:
+  //   The number of scored document hits that the invalidated states held
+  int InvalidateOldestResultStates(int num_states_to_keep)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
  private:
+  // A result state along with the lock that serializes paging through it.
+  struct GuardedResultState {
+    GuardedResultState(ResultState result_state_in, int num_accounted_hits_in)
+        : result_state(std::move(result_state_in)),
+          num_accounted_hits(num_accounted_hits_in) {}
+
+    absl_ports::shared_mutex mutex;
+    ResultState result_state ICING_GUARDED_BY(mutex);
+
+    // The number of hits of this state counted in num_total_hits_. Guarded by
+    // the manager's mutex_.
+    int num_accounted_hits;
+
+    // The number of lower tier hits of result_state that have been added to
+    // num_accounted_hits. Guarded by the manager's mutex_.
+    int num_accounted_lower_tier_hits = 0;
+
+    // Set, under the manager's mutex_, once the state has been removed from
+    // its shard. Its hits are no longer counted in num_total_hits_ then.
+    std::atomic<bool> invalidated{false};
+
+    // The next page, if it has been prefetched. Its hits have already been
+    // taken off result_state, but are still counted in num_accounted_hits.
+    std::optional<PageResultState> prefetched_page ICING_GUARDED_BY(mutex);
+
+    // The manager's results_generation_ when prefetched_page was retrieved.
+    uint64_t prefetched_results_generation ICING_GUARDED_BY(mutex) = 0;
+  };
+
+  // A part of the (next-page token -> result state) map.
+  struct Shard {
+    absl_ports::shared_mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<GuardedResultState>>
+        result_states ICING_GUARDED_BY(mutex);
+  };
+
+  static constexpr int kNumShards = 16;
+
+  Shard& GetShard(uint64_t token) { return shards_[token % kNumShards]; }
+
+  // Returns the result state of the token, or nullptr if there's none.
+  std::shared_ptr<GuardedResultState> FindResultState(uint64_t token);
+
+  // Takes the next page of hits off the result state. Its next_page_token is
+  // left to the caller.
+  PageResultState TakeNextPage(GuardedResultState& state)
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(state.mutex);
+
+  // Takes the prefetched page off the result state if there's one, otherwise
+  // the next page. A prefetched page that may be stale is taken again.
+  PageResultState TakePrefetchedOrNextPage(GuardedResultState& state)
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(state.mutex);
+
   absl_ports::shared_mutex mutex_;
 
   const DocumentStore& document_store_;
@@ -88,11 +190,18 @@ class ResultStateManager {
 
   // The number of scored document hits that all result states currently held by
   // the result state manager have.
-  int num_total_hits_;
+  int num_total_hits_ ICING_GUARDED_BY(mutex_);
 
-  // A hash map of (next-page token -> result state)
-  std::unordered_map<uint64_t, ResultState> result_state_map_
-      ICING_GUARDED_BY(mutex_);
+  // The number of result states in shards_.
+  int num_result_states_ ICING_GUARDED_BY(mutex_);
+
+  // Incremented by InvalidatePrefetchedResults. Prefetched results retrieved
+  // at an older generation are stale.
+  std::atomic<uint64_t> results_generation_{0};
+
+  // The (next-page token -> result state) map, sharded by token. States are
+  // only ever added or removed under mutex_.
+  std::array<Shard, kNumShards> shards_;
 
   // A queue used to track the insertion order of tokens
   std::queue<uint64_t> token_queue_ ICING_GUARDED_BY(mutex_);
@@ -120,12 +229,16 @@ class ResultStateManager {
   void RemoveStatesIfNeeded(const ResultState& result_state)
       ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Helper method to remove a result state from result_state_map_, the token
-  // will then be temporarily kept in invalidated_token_set_ until it's finally
-  // removed from token_queue_.
+  // Helper method to remove a result state from shards_, the token will then
+  // be temporarily kept in invalidated_token_set_ until it's finally removed
+  // from token_queue_.
   void InternalInvalidateResultState(uint64_t token)
       ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Removes the result state of the token from shards_ and stops counting its
+  // hits. Returns whether there was one.
+  bool RemoveResultState(uint64_t token) ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Internal method to invalidates all result states / tokens currently in
   // ResultStateManager. We need this separate method so that other public
   // methods don't need to call InvalidateAllResultStates(). Public methods
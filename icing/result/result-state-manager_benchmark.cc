@@ -0,0 +1,168 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "testing/base/public/benchmark.h"
+#include "icing/document-builder.h"
+#include "icing/file/filesystem.h"
+#include "icing/proto/document.pb.h"
+#include "icing/proto/schema.pb.h"
+#include "icing/proto/scoring.pb.h"
+#include "icing/proto/search.pb.h"
+#include "icing/result/page-result-state.h"
+#include "icing/result/result-state-manager.h"
+#include "icing/result/result-state.h"
+#include "icing/schema/schema-store.h"
+#include "icing/scoring/scored-document-hit.h"
+#include "icing/store/document-id.h"
+#include "icing/store/document-store.h"
+#include "icing/testing/tmp-directory.h"
+#include "icing/util/clock.h"
+
+// This is a benchmark for paging through the results of independent queries
+// from several threads at once. It shows how GetNextPage throughput varies with
+// the number of concurrent clients.
+//
+// Run on a Linux workstation:
+//    $ blaze build -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/result:result-state-manager_benchmark
+//
+//    $ blaze-bin/icing/result/result-state-manager_benchmark
+//    --benchmarks=all
+//
+// Run on an Android device:
+//    $ blaze build --copt="-DGOOGLE_COMMANDLINEFLAGS_FULL_API=1"
+//    --config=android_arm64 -c opt --dynamic_mode=off --copt=-gmlt
+//    //icing/result:result-state-manager_benchmark
+//
+//    $ adb push blaze-bin/icing/result/result-state-manager_benchmark
+//    /data/local/tmp/
+//
+//    $ adb shell /data/local/tmp/result-state-manager_benchmark
+//    --benchmarks=all
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+constexpr int kNumHitsPerQuery = 10000;
+constexpr int kNumPerPage = 10;
+
+// The ResultStateManager shared by all benchmark threads, along with what it
+// depends on. Created on first use.
+class PaginationEnvironment {
+ public:
+  static PaginationEnvironment& Get() {
+    static PaginationEnvironment* environment = new PaginationEnvironment();
+    return *environment;
+  }
+
+  ResultStateManager& result_state_manager() { return *result_state_manager_; }
+
+  // Returns the results of a new query.
+  ResultState CreateResultState() const {
+    ScoringSpecProto scoring_spec;
+    scoring_spec.set_rank_by(ScoringSpecProto::RankingStrategy::DOCUMENT_SCORE);
+    ResultSpecProto result_spec;
+    result_spec.set_num_per_page(kNumPerPage);
+    return ResultState(scored_document_hits_, /*query_terms=*/{},
+                       SearchSpecProto::default_instance(), scoring_spec,
+                       result_spec, *document_store_);
+  }
+
+ private:
+  PaginationEnvironment() {
+    const std::string base_dir = GetTestTempDir() + "/result_state_manager";
+    const std::string schema_store_dir = base_dir + "/schema_store";
+    const std::string document_store_dir = base_dir + "/document_store";
+    filesystem_.DeleteDirectoryRecursively(base_dir.c_str());
+    filesystem_.CreateDirectoryRecursively(schema_store_dir.c_str());
+    filesystem_.CreateDirectoryRecursively(document_store_dir.c_str());
+
+    schema_store_ =
+        SchemaStore::Create(&filesystem_, schema_store_dir, &clock_)
+            .ValueOrDie();
+    SchemaProto schema;
+    schema.add_types()->set_schema_type("Document");
+    schema_store_->SetSchema(std::move(schema)).ValueOrDie();
+
+    document_store_ =
+        std::move(DocumentStore::Create(&filesystem_, document_store_dir,
+                                        &clock_, schema_store_.get())
+                      .ValueOrDie()
+                      .document_store);
+
+    // Hits of documents that don't exist are dropped when a page is
+    // retrieved.
+    for (int i = 0; i < kNumHitsPerQuery; ++i) {
+      DocumentProto document = DocumentBuilder()
+                                   .SetKey("namespace", std::to_string(i))
+                                   .SetSchema("Document")
+                                   .Build();
+      DocumentId document_id =
+          document_store_->Put(std::move(document)).ValueOrDie();
+      scored_document_hits_.emplace_back(document_id, kSectionIdMaskNone,
+                                         /*score=*/i);
+    }
+
+    result_state_manager_ = std::make_unique<ResultStateManager>(
+        /*max_total_hits=*/std::numeric_limits<int>::max(), *document_store_);
+  }
+
+  Filesystem filesystem_;
+  Clock clock_;
+  std::unique_ptr<SchemaStore> schema_store_;
+  std::unique_ptr<DocumentStore> document_store_;
+  std::vector<ScoredDocumentHit> scored_document_hits_;
+  std::unique_ptr<ResultStateManager> result_state_manager_;
+};
+
+// Every thread pages through the results of its own queries, issuing a new
+// query whenever it runs out of results.
+void BM_GetNextPage(benchmark::State& state) {
+  PaginationEnvironment& environment = PaginationEnvironment::Get();
+  ResultStateManager& result_state_manager =
+      environment.result_state_manager();
+
+  uint64_t next_page_token = kInvalidNextPageToken;
+  for (auto _ : state) {
+    if (next_page_token == kInvalidNextPageToken) {
+      next_page_token =
+          result_state_manager
+              .RankAndPaginate(environment.CreateResultState())
+              .ValueOrDie()
+              .next_page_token;
+      continue;
+    }
+    libtextclassifier3::StatusOr<PageResultState> page_result_state_or =
+        result_state_manager.GetNextPage(next_page_token);
+    next_page_token = page_result_state_or.ok()
+                          ? page_result_state_or.ValueOrDie().next_page_token
+                          : kInvalidNextPageToken;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetNextPage)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
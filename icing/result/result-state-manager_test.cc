@@ -14,10 +14,17 @@
 
 #include "icing/result/result-state-manager.h"
 
+#include <atomic>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "icing/absl_ports/canonical_errors.h"
 #include "icing/file/filesystem.h"
 #include "icing/portable/equals-proto.h"
+#include "icing/proto/search.pb.h"
 #include "icing/schema/schema-store.h"
 #include "icing/store/document-store.h"
 #include "icing/testing/common-matchers.h"
@@ -32,6 +39,7 @@ using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Gt;
 using ::testing::IsEmpty;
+using ::testing::Le;
 
 ScoringSpecProto CreateScoringSpec() {
   ScoringSpecProto scoring_spec;
@@ -49,6 +57,28 @@ ScoredDocumentHit CreateScoredHit(DocumentId document_id) {
   return ScoredDocumentHit(document_id, kSectionIdMaskNone, /*score=*/1);
 }
 
+// Stands in for ResultRetriever, returning one result per hit with the
+// document id as its uri.
+libtextclassifier3::StatusOr<std::vector<SearchResultProto::ResultProto>>
+RetrieveDocumentIds(const PageResultState& page_result_state) {
+  std::vector<SearchResultProto::ResultProto> results;
+  for (const ScoredDocumentHit& hit : page_result_state.scored_document_hits) {
+    SearchResultProto::ResultProto result;
+    result.mutable_document()->set_uri(std::to_string(hit.document_id()));
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+std::vector<std::string> GetUris(
+    const std::vector<SearchResultProto::ResultProto>& results) {
+  std::vector<std::string> uris;
+  for (const SearchResultProto::ResultProto& result : results) {
+    uris.push_back(result.document().uri());
+  }
+  return uris;
+}
+
 class ResultStateManagerTest : public testing::Test {
  protected:
   void SetUp() override {
@@ -83,6 +113,16 @@ class ResultStateManagerTest : public testing::Test {
                        CreateResultSpec(num_per_page), *document_store_);
   }
 
+  ResultState CreatePrefetchingResultState(
+      const std::vector<ScoredDocumentHit>& scored_document_hits,
+      int num_per_page) {
+    ResultSpecProto result_spec = CreateResultSpec(num_per_page);
+    result_spec.set_prefetch_next_page(true);
+    return ResultState(scored_document_hits, /*query_terms=*/{},
+                       SearchSpecProto::default_instance(), CreateScoringSpec(),
+                       result_spec, *document_store_);
+  }
+
   ScoredDocumentHit AddScoredDocument(DocumentId document_id) {
     DocumentProto document;
     document.set_namespace_("namespace");
@@ -1004,6 +1044,312 @@ TEST_F(ResultStateManagerTest, ShouldStoreAllHits) {
               StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
 }
 
+TEST_F(ResultStateManagerTest, InvalidateOldestResultStatesKeepsNewest) {
+  ResultState result_state1 =
+      CreateResultState({AddScoredDocument(/*document_id=*/0),
+                         AddScoredDocument(/*document_id=*/1)},
+                        /*num_per_page=*/1);
+  ResultState result_state2 =
+      CreateResultState({AddScoredDocument(/*document_id=*/2),
+                         AddScoredDocument(/*document_id=*/3),
+                         AddScoredDocument(/*document_id=*/4)},
+                        /*num_per_page=*/1);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state1)));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state2,
+      result_state_manager.RankAndPaginate(std::move(result_state2)));
+
+  // The first state has one hit left, the second has two.
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/1),
+              Eq(1));
+  EXPECT_THAT(
+      result_state_manager.GetNextPage(page_result_state1.next_page_token),
+      StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_EXPECT_OK(
+      result_state_manager.GetNextPage(page_result_state2.next_page_token));
+
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Eq(1));
+  EXPECT_THAT(
+      result_state_manager.GetNextPage(page_result_state2.next_page_token),
+      StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+
+  // Nothing is left to drop.
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Eq(0));
+}
+
+TEST_F(ResultStateManagerTest, GetNextPageReturnsPrefetchedPage) {
+  ResultState result_state = CreatePrefetchingResultState(
+      {AddScoredDocument(/*document_id=*/0),
+       AddScoredDocument(/*document_id=*/1),
+       AddScoredDocument(/*document_id=*/2),
+       AddScoredDocument(/*document_id=*/3),
+       AddScoredDocument(/*document_id=*/4)},
+      /*num_per_page=*/2);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state)));
+  EXPECT_TRUE(page_result_state1.prefetch_next_page);
+  EXPECT_FALSE(page_result_state1.prefetched_results.has_value());
+
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+  // The page has already been prefetched.
+  int num_retrievals = 0;
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token,
+      [&num_retrievals](const PageResultState& page_result_state) {
+        ++num_retrievals;
+        return RetrieveDocumentIds(page_result_state);
+      }));
+  EXPECT_THAT(num_retrievals, Eq(0));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state2,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  EXPECT_THAT(page_result_state2.next_page_token,
+              Eq(page_result_state1.next_page_token));
+  EXPECT_THAT(page_result_state2.num_previously_returned, Eq(2));
+  EXPECT_THAT(
+      page_result_state2.scored_document_hits,
+      ElementsAre(EqualsScoredDocumentHit(CreateScoredHit(/*document_id=*/2)),
+                  EqualsScoredDocumentHit(CreateScoredHit(/*document_id=*/1))));
+  ASSERT_TRUE(page_result_state2.prefetched_results.has_value());
+  EXPECT_THAT(GetUris(*page_result_state2.prefetched_results),
+              ElementsAre("2", "1"));
+
+  // Pages that weren't prefetched are returned without results.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state3,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  EXPECT_THAT(page_result_state3.next_page_token, Eq(kInvalidNextPageToken));
+  EXPECT_THAT(
+      page_result_state3.scored_document_hits,
+      ElementsAre(EqualsScoredDocumentHit(CreateScoredHit(/*document_id=*/0))));
+  EXPECT_FALSE(page_result_state3.prefetched_results.has_value());
+}
+
+TEST_F(ResultStateManagerTest, PrefetchingLastPageKeepsToken) {
+  ResultState result_state = CreatePrefetchingResultState(
+      {AddScoredDocument(/*document_id=*/0),
+       AddScoredDocument(/*document_id=*/1)},
+      /*num_per_page=*/1);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state)));
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+
+  // The prefetched page is the last one, so returning it ends the query.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state2,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  EXPECT_THAT(page_result_state2.next_page_token, Eq(kInvalidNextPageToken));
+  ASSERT_TRUE(page_result_state2.prefetched_results.has_value());
+  EXPECT_THAT(GetUris(*page_result_state2.prefetched_results),
+              ElementsAre("0"));
+  EXPECT_THAT(
+      result_state_manager.GetNextPage(page_result_state1.next_page_token),
+      StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST_F(ResultStateManagerTest,
+       InvalidatePrefetchedResultsRetakesPrefetchedPage) {
+  ResultState result_state = CreatePrefetchingResultState(
+      {AddScoredDocument(/*document_id=*/0),
+       AddScoredDocument(/*document_id=*/1),
+       AddScoredDocument(/*document_id=*/2)},
+      /*num_per_page=*/1);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state)));
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+  result_state_manager.InvalidatePrefetchedResults();
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state2,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  EXPECT_THAT(
+      page_result_state2.scored_document_hits,
+      ElementsAre(EqualsScoredDocumentHit(CreateScoredHit(/*document_id=*/1))));
+  EXPECT_FALSE(page_result_state2.prefetched_results.has_value());
+
+  // Pages prefetched afterwards aren't affected.
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state3,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  ASSERT_TRUE(page_result_state3.prefetched_results.has_value());
+  EXPECT_THAT(GetUris(*page_result_state3.prefetched_results),
+              ElementsAre("0"));
+}
+
+TEST_F(ResultStateManagerTest, FailedPrefetchStillReturnsPage) {
+  ResultState result_state = CreatePrefetchingResultState(
+      {AddScoredDocument(/*document_id=*/0),
+       AddScoredDocument(/*document_id=*/1)},
+      /*num_per_page=*/1);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state)));
+  EXPECT_THAT(
+      result_state_manager.PrefetchNextPage(
+          page_result_state1.next_page_token,
+          [](const PageResultState&)
+              -> libtextclassifier3::StatusOr<
+                  std::vector<SearchResultProto::ResultProto>> {
+            return absl_ports::InternalError("Retrieval failed");
+          }),
+      StatusIs(libtextclassifier3::StatusCode::INTERNAL));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state2,
+      result_state_manager.GetNextPage(page_result_state1.next_page_token));
+  EXPECT_THAT(
+      page_result_state2.scored_document_hits,
+      ElementsAre(EqualsScoredDocumentHit(CreateScoredHit(/*document_id=*/0))));
+  EXPECT_FALSE(page_result_state2.prefetched_results.has_value());
+}
+
+TEST_F(ResultStateManagerTest, InvalidatedStateDropsPrefetchedPage) {
+  ResultState result_state = CreatePrefetchingResultState(
+      {AddScoredDocument(/*document_id=*/0),
+       AddScoredDocument(/*document_id=*/1),
+       AddScoredDocument(/*document_id=*/2)},
+      /*num_per_page=*/1);
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  ICING_ASSERT_OK_AND_ASSIGN(
+      PageResultState page_result_state1,
+      result_state_manager.RankAndPaginate(std::move(result_state)));
+  ICING_ASSERT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+
+  // The prefetched page is still counted with the state.
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Eq(2));
+  EXPECT_THAT(
+      result_state_manager.GetNextPage(page_result_state1.next_page_token),
+      StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  // There's nothing left to prefetch.
+  ICING_EXPECT_OK(result_state_manager.PrefetchNextPage(
+      page_result_state1.next_page_token, RetrieveDocumentIds));
+}
+
+TEST_F(ResultStateManagerTest, ConcurrentPaginationReturnsEveryHitOnce) {
+  constexpr int kNumThreads = 4;
+  constexpr int kNumHitsPerState = 50;
+
+  std::vector<ScoredDocumentHit> scored_document_hits;
+  for (int i = 0; i < kNumHitsPerState; ++i) {
+    scored_document_hits.push_back(AddScoredDocument(/*document_id=*/i));
+  }
+
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/std::numeric_limits<int>::max(), document_store());
+  std::vector<uint64_t> tokens;
+  for (int i = 0; i < kNumThreads; ++i) {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        PageResultState page_result_state,
+        result_state_manager.RankAndPaginate(
+            CreateResultState(scored_document_hits, /*num_per_page=*/1)));
+    tokens.push_back(page_result_state.next_page_token);
+  }
+
+  std::vector<int> num_hits_returned(kNumThreads, 1);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      while (result_state_manager.GetNextPage(tokens[i]).ok()) {
+        ++num_hits_returned[i];
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < kNumThreads; ++i) {
+    EXPECT_THAT(num_hits_returned[i], Eq(kNumHitsPerState));
+  }
+  // Every hit has been accounted for.
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Eq(0));
+}
+
+TEST_F(ResultStateManagerTest, ConcurrentPaginationAndEviction) {
+  constexpr int kNumHitsPerState = 20;
+
+  std::vector<ScoredDocumentHit> scored_document_hits;
+  for (int i = 0; i < kNumHitsPerState; ++i) {
+    scored_document_hits.push_back(AddScoredDocument(/*document_id=*/i));
+  }
+
+  // Only two states fit, so adding states keeps evicting the ones being paged
+  // through.
+  ResultStateManager result_state_manager(
+      /*max_total_hits=*/2 * kNumHitsPerState, document_store());
+  std::atomic<bool> done(false);
+  std::thread adder([&]() {
+    while (!done) {
+      ICING_ASSERT_OK(result_state_manager.RankAndPaginate(
+          CreateResultState(scored_document_hits, /*num_per_page=*/1)));
+    }
+  });
+
+  for (int i = 0; i < 100; ++i) {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        PageResultState page_result_state,
+        result_state_manager.RankAndPaginate(
+            CreateResultState(scored_document_hits, /*num_per_page=*/1)));
+    uint64_t token = page_result_state.next_page_token;
+    int num_hits_returned = 1;
+    libtextclassifier3::StatusOr<PageResultState> page_or;
+    while (token != kInvalidNextPageToken &&
+           (page_or = result_state_manager.GetNextPage(token)).ok()) {
+      ++num_hits_returned;
+      token = page_or.ValueOrDie().next_page_token;
+    }
+    EXPECT_THAT(num_hits_returned, Le(kNumHitsPerState));
+  }
+  done = true;
+  adder.join();
+
+  // Whatever is left is still accounted for exactly.
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Le(2 * kNumHitsPerState));
+  EXPECT_THAT(result_state_manager.InvalidateOldestResultStates(
+                  /*num_states_to_keep=*/0),
+              Eq(0));
+}
+
 }  // namespace
 }  // namespace lib
 }  // namespace icing
@@ -46,9 +46,12 @@ ResultState::ResultState(std::vector<ScoredDocumentHit> scored_document_hits,
       snippet_context_(CreateSnippetContext(std::move(query_terms), search_spec,
                                             result_spec)),
       num_per_page_(result_spec.num_per_page()),
+      prefetch_next_page_(result_spec.prefetch_next_page()),
       num_returned_(0),
       scored_document_hit_comparator_(scoring_spec.order_by() ==
-                                      ScoringSpecProto::Order::DESC) {
+                                      ScoringSpecProto::Order::DESC),
+      max_lower_tier_hits_(-1),
+      num_lower_tier_hits_(0) {
   for (const TypePropertyMask& type_field_mask :
        result_spec.type_property_masks()) {
     projection_tree_map_.insert(
@@ -107,15 +110,49 @@ class GroupResultLimiter {
   const DocumentStore& document_store_;
 };
 
+void ResultState::SetLowerTier(LowerTierLoader load_lower_tier) {
+  load_lower_tier_ = std::move(load_lower_tier);
+}
+
+void ResultState::LoadLowerTier() {
+  LowerTierLoader load_lower_tier = std::move(load_lower_tier_);
+  load_lower_tier_ = nullptr;
+  libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> hits_or =
+      load_lower_tier();
+  if (!hits_or.ok()) {
+    // The results end early rather than failing the page.
+    ICING_LOG(WARNING) << "Failed to load lower ranked results: "
+                       << hits_or.status().error_message();
+    return;
+  }
+  std::vector<ScoredDocumentHit> hits = std::move(hits_or).ValueOrDie();
+  BuildHeapInPlace(&hits, scored_document_hit_comparator_);
+  if (max_lower_tier_hits_ >= 0 && hits.size() > max_lower_tier_hits_) {
+    hits = PopTopResultsFromHeap(&hits, max_lower_tier_hits_,
+                                 scored_document_hit_comparator_);
+    BuildHeapInPlace(&hits, scored_document_hit_comparator_);
+  }
+  num_lower_tier_hits_ = hits.size();
+  for (ScoredDocumentHit& hit : hits) {
+    PushToHeap(std::move(hit), &scored_document_hits_,
+               scored_document_hit_comparator_);
+  }
+}
+
 std::vector<ScoredDocumentHit> ResultState::GetNextPage(
     const DocumentStore& document_store) {
+  last_group_result_limits_ = group_result_limits_;
   int num_requested = num_per_page_;
   bool more_results_available = true;
   std::vector<ScoredDocumentHit> final_scored_document_hits;
   while (more_results_available && num_requested > 0) {
+    if (scored_document_hits_.empty() && load_lower_tier_ != nullptr) {
+      LoadLowerTier();
+    }
     std::vector<ScoredDocumentHit> scored_document_hits = PopTopResultsFromHeap(
         &scored_document_hits_, num_requested, scored_document_hit_comparator_);
-    more_results_available = scored_document_hits.size() == num_requested;
+    more_results_available = scored_document_hits.size() == num_requested ||
+                             load_lower_tier_ != nullptr;
     auto itr = std::remove_if(
         scored_document_hits.begin(), scored_document_hits.end(),
         GroupResultLimiter(namespace_group_id_map_, group_result_limits_,
@@ -132,10 +169,28 @@ std::vector<ScoredDocumentHit> ResultState::GetNextPage(
   return final_scored_document_hits;
 }
 
+void ResultState::UndoLastPage(std::vector<ScoredDocumentHit> page) {
+  num_returned_ -= page.size();
+  group_result_limits_ = last_group_result_limits_;
+  for (ScoredDocumentHit& scored_document_hit : page) {
+    PushToHeap(std::move(scored_document_hit), &scored_document_hits_,
+               scored_document_hit_comparator_);
+  }
+}
+
 void ResultState::TruncateHitsTo(int new_size) {
-  if (new_size < 0 || scored_document_hits_.size() <= new_size) {
+  if (new_size < 0) {
+    return;
+  }
+  if (scored_document_hits_.size() <= new_size) {
+    // Lower tier hits rank below all others, so they fill up what's left.
+    max_lower_tier_hits_ = new_size - scored_document_hits_.size();
+    if (max_lower_tier_hits_ == 0) {
+      load_lower_tier_ = nullptr;
+    }
     return;
   }
+  load_lower_tier_ = nullptr;
 
   // Copying the best new_size results.
   scored_document_hits_ = PopTopResultsFromHeap(
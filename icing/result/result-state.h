@@ -15,9 +15,11 @@
 #ifndef ICING_RESULT_RESULT_STATE_H_
 #define ICING_RESULT_RESULT_STATE_H_
 
+#include <functional>
 #include <iostream>
 #include <vector>
 
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/proto/scoring.pb.h"
 #include "icing/proto/search.pb.h"
 #include "icing/result/projection-tree.h"
@@ -33,6 +35,11 @@ namespace lib {
 // same query. Stored in ResultStateManager.
 class ResultState {
  public:
+  // Returns hits that all rank below the hits that a ResultState was created
+  // with.
+  using LowerTierLoader = std::function<
+      libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>>()>;
+
   ResultState(std::vector<ScoredDocumentHit> scored_document_hits,
               SectionRestrictQueryTermsMap query_terms,
               const SearchSpecProto& search_spec,
@@ -47,12 +54,25 @@ class ResultState {
   std::vector<ScoredDocumentHit> GetNextPage(
       const DocumentStore& document_store);
 
+  // Sets where to get the hits that rank below the ones this ResultState was
+  // created with. load_lower_tier is called once those hits run out, so that
+  // it isn't called at all if the lower ranked hits are never requested.
+  void SetLowerTier(LowerTierLoader load_lower_tier);
+
+  // Puts back the hits of the page returned by the last GetNextPage() call,
+  // as if that call had never been made. The hits that it left out stay left
+  // out.
+  void UndoLastPage(std::vector<ScoredDocumentHit> page);
+
   // Truncates the vector of ScoredDocumentHits to the given size. The best
-  // ScoredDocumentHits are kept.
+  // ScoredDocumentHits are kept. This includes the hits of the lower tier.
   void TruncateHitsTo(int new_size);
 
-  // Returns if the current state has more results to return.
-  bool HasMoreResults() const { return !scored_document_hits_.empty(); }
+  // Returns if the current state has more results to return. A lower tier
+  // that hasn't been loaded yet is assumed to have results.
+  bool HasMoreResults() const {
+    return !scored_document_hits_.empty() || load_lower_tier_ != nullptr;
+  }
 
   // Returns a SnippetContext generated from the specs passed in via
   // constructor.
@@ -67,14 +87,22 @@ class ResultState {
 
   int num_per_page() const { return num_per_page_; }
 
+  // Whether the next page should be prepared in the background after a page
+  // has been returned.
+  bool prefetch_next_page() const { return prefetch_next_page_; }
+
   // The number of results that have already been returned. This number is
   // increased when GetNextPage() is called.
   int num_returned() const { return num_returned_; }
 
   // The number of results yet to be returned. This number is decreased when
-  // GetNextPage is called.
+  // GetNextPage is called. The hits of the lower tier are only counted once it
+  // has been loaded.
   int num_remaining() const { return scored_document_hits_.size(); }
 
+  // The number of hits that were loaded from the lower tier.
+  int num_lower_tier_hits() const { return num_lower_tier_hits_; }
+
  private:
   // The scored document hits. It represents a heap data structure when ranking
   // is required so that we can get top K hits in O(KlgN) time. If no ranking is
@@ -94,14 +122,31 @@ class ResultState {
   // index.
   std::vector<int> group_result_limits_;
 
+  // group_result_limits_ before the last GetNextPage() call.
+  std::vector<int> last_group_result_limits_;
+
   // Number of results to return in each page.
   int num_per_page_;
 
+  bool prefetch_next_page_;
+
   // Number of results that have already been returned.
   int num_returned_;
 
   // Used to compare two scored document hits.
   ScoredDocumentHitComparator scored_document_hit_comparator_;
+
+  // Loads the lower ranked hits. Reset once they have been loaded.
+  LowerTierLoader load_lower_tier_;
+
+  // The maximum number of lower tier hits to keep. Negative if there is no
+  // limit.
+  int max_lower_tier_hits_;
+
+  int num_lower_tier_hits_;
+
+  // Moves the hits of the lower tier into scored_document_hits_.
+  void LoadLowerTier();
 };
 
 }  // namespace lib
@@ -15,6 +15,7 @@
 #include "icing/result/result-state.h"
 
 #include "gtest/gtest.h"
+#include "icing/absl_ports/canonical_errors.h"
 #include "icing/document-builder.h"
 #include "icing/file/filesystem.h"
 #include "icing/portable/equals-proto.h"
@@ -270,6 +271,123 @@ TEST_F(ResultStateTest, ShouldNotTruncateToNegative) {
           EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/0))));
 }
 
+TEST_F(ResultStateTest, ShouldLoadLowerTierOnceHitsRunOut) {
+  ScoredDocumentHit scored_hit_0 = AddScoredDocument(/*document_id=*/0);
+  ScoredDocumentHit scored_hit_1 = AddScoredDocument(/*document_id=*/1);
+  ScoredDocumentHit scored_hit_2 = AddScoredDocument(/*document_id=*/2);
+  ScoredDocumentHit scored_hit_3 = AddScoredDocument(/*document_id=*/3);
+  ScoredDocumentHit scored_hit_4 = AddScoredDocument(/*document_id=*/4);
+
+  ResultState result_state({scored_hit_4, scored_hit_3}, /*query_terms=*/{},
+                           CreateSearchSpec(TermMatchType::EXACT_ONLY),
+                           CreateScoringSpec(/*is_descending_order=*/true),
+                           CreateResultSpec(/*num_per_page=*/2),
+                           document_store());
+  int num_loads = 0;
+  result_state.SetLowerTier(
+      [&]() -> libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> {
+        ++num_loads;
+        return std::vector<ScoredDocumentHit>{scored_hit_1, scored_hit_0,
+                                              scored_hit_2};
+      });
+
+  EXPECT_THAT(
+      result_state.GetNextPage(document_store()),
+      ElementsAre(
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/4)),
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/3))));
+  // The lower tier isn't needed yet.
+  EXPECT_THAT(num_loads, Eq(0));
+  EXPECT_TRUE(result_state.HasMoreResults());
+
+  EXPECT_THAT(
+      result_state.GetNextPage(document_store()),
+      ElementsAre(
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/2)),
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/1))));
+  EXPECT_THAT(num_loads, Eq(1));
+  EXPECT_THAT(result_state.num_lower_tier_hits(), Eq(3));
+
+  EXPECT_THAT(result_state.GetNextPage(document_store()),
+              ElementsAre(EqualsScoredDocumentHit(
+                  CreateScoredDocumentHit(/*document_id=*/0))));
+  EXPECT_FALSE(result_state.HasMoreResults());
+  EXPECT_THAT(num_loads, Eq(1));
+}
+
+TEST_F(ResultStateTest, ShouldFillPageFromLowerTier) {
+  ScoredDocumentHit scored_hit_0 = AddScoredDocument(/*document_id=*/0);
+  ScoredDocumentHit scored_hit_1 = AddScoredDocument(/*document_id=*/1);
+  ScoredDocumentHit scored_hit_2 = AddScoredDocument(/*document_id=*/2);
+
+  ResultState result_state({scored_hit_2}, /*query_terms=*/{},
+                           CreateSearchSpec(TermMatchType::EXACT_ONLY),
+                           CreateScoringSpec(/*is_descending_order=*/true),
+                           CreateResultSpec(/*num_per_page=*/2),
+                           document_store());
+  result_state.SetLowerTier(
+      [&]() -> libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> {
+        return std::vector<ScoredDocumentHit>{scored_hit_0, scored_hit_1};
+      });
+
+  // The page is filled up with the best hit of the lower tier.
+  EXPECT_THAT(
+      result_state.GetNextPage(document_store()),
+      ElementsAre(
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/2)),
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/1))));
+  EXPECT_THAT(result_state.GetNextPage(document_store()),
+              ElementsAre(EqualsScoredDocumentHit(
+                  CreateScoredDocumentHit(/*document_id=*/0))));
+}
+
+TEST_F(ResultStateTest, ShouldTruncateLowerTier) {
+  ScoredDocumentHit scored_hit_0 = AddScoredDocument(/*document_id=*/0);
+  ScoredDocumentHit scored_hit_1 = AddScoredDocument(/*document_id=*/1);
+  ScoredDocumentHit scored_hit_2 = AddScoredDocument(/*document_id=*/2);
+  ScoredDocumentHit scored_hit_3 = AddScoredDocument(/*document_id=*/3);
+
+  ResultState result_state({scored_hit_3}, /*query_terms=*/{},
+                           CreateSearchSpec(TermMatchType::EXACT_ONLY),
+                           CreateScoringSpec(/*is_descending_order=*/true),
+                           CreateResultSpec(/*num_per_page=*/5),
+                           document_store());
+  result_state.SetLowerTier(
+      [&]() -> libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> {
+        return std::vector<ScoredDocumentHit>{scored_hit_0, scored_hit_2,
+                                              scored_hit_1};
+      });
+
+  result_state.TruncateHitsTo(/*new_size=*/3);
+  // The best 3 are left, 2 of them from the lower tier.
+  EXPECT_THAT(
+      result_state.GetNextPage(document_store()),
+      ElementsAre(
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/3)),
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/2)),
+          EqualsScoredDocumentHit(CreateScoredDocumentHit(/*document_id=*/1))));
+  EXPECT_THAT(result_state.num_lower_tier_hits(), Eq(2));
+}
+
+TEST_F(ResultStateTest, ShouldEndResultsIfLowerTierFailsToLoad) {
+  ScoredDocumentHit scored_hit_0 = AddScoredDocument(/*document_id=*/0);
+
+  ResultState result_state({scored_hit_0}, /*query_terms=*/{},
+                           CreateSearchSpec(TermMatchType::EXACT_ONLY),
+                           CreateScoringSpec(/*is_descending_order=*/true),
+                           CreateResultSpec(/*num_per_page=*/2),
+                           document_store());
+  result_state.SetLowerTier(
+      []() -> libtextclassifier3::StatusOr<std::vector<ScoredDocumentHit>> {
+        return absl_ports::InternalError("Failed to load.");
+      });
+
+  EXPECT_THAT(result_state.GetNextPage(document_store()),
+              ElementsAre(EqualsScoredDocumentHit(
+                  CreateScoredDocumentHit(/*document_id=*/0))));
+  EXPECT_FALSE(result_state.HasMoreResults());
+}
+
 TEST_F(ResultStateTest, ResultGroupingShouldLimitResults) {
   // Creates 2 documents and ensures the relationship in terms of document
   // score is: document1 < document2
@@ -567,6 +685,55 @@ TEST_F(ResultStateTest, ResultGroupingOnlyNonexistentNamespaces) {
                           EqualsScoredDocumentHit(scored_hit_1)));
 }
 
+TEST_F(ResultStateTest, UndoLastPageShouldRestoreState) {
+  DocumentProto document1 = DocumentBuilder()
+                                .SetKey("namespace", "uri/1")
+                                .SetSchema("Document")
+                                .SetScore(1)
+                                .Build();
+  DocumentProto document2 = DocumentBuilder()
+                                .SetKey("namespace", "uri/2")
+                                .SetSchema("Document")
+                                .SetScore(2)
+                                .Build();
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id1,
+                             document_store().Put(document1));
+  ScoredDocumentHit scored_hit_1(document_id1, kSectionIdMaskNone,
+                                 document1.score());
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id2,
+                             document_store().Put(document2));
+  ScoredDocumentHit scored_hit_2(document_id2, kSectionIdMaskNone,
+                                 document2.score());
+
+  // Create a ResultSpec that limits "namespace" to a single result.
+  ResultSpecProto result_spec;
+  result_spec.set_num_per_page(1);
+  ResultSpecProto::ResultGrouping* result_grouping =
+      result_spec.add_result_groupings();
+  result_grouping->set_max_results(1);
+  result_grouping->add_namespaces("namespace");
+
+  ResultState result_state({scored_hit_1, scored_hit_2}, /*query_terms=*/{},
+                           CreateSearchSpec(TermMatchType::EXACT_ONLY),
+                           CreateScoringSpec(/*is_descending_order=*/true),
+                           result_spec, document_store());
+
+  std::vector<ScoredDocumentHit> page =
+      result_state.GetNextPage(document_store());
+  EXPECT_THAT(page, ElementsAre(EqualsScoredDocumentHit(scored_hit_2)));
+  EXPECT_THAT(result_state.num_returned(), Eq(1));
+
+  result_state.UndoLastPage(std::move(page));
+  EXPECT_THAT(result_state.num_returned(), Eq(0));
+  EXPECT_THAT(result_state.num_remaining(), Eq(2));
+
+  // With document2 gone, document1 is within the limit of "namespace" again.
+  ICING_ASSERT_OK(document_store().Delete("namespace", "uri/2"));
+  EXPECT_THAT(result_state.GetNextPage(document_store()),
+              ElementsAre(EqualsScoredDocumentHit(scored_hit_1)));
+  EXPECT_FALSE(result_state.HasMoreResults());
+}
+
 }  // namespace
 }  // namespace lib
 }  // namespace icing
@@ -0,0 +1,97 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/result/scan-state-manager.h"
+
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/canonical_errors.h"
+#include "icing/absl_ports/mutex.h"
+#include "icing/result/result-state-manager.h"
+#include "icing/util/clock.h"
+
+namespace icing {
+namespace lib {
+
+ScanStateManager::ScanStateManager(int max_num_scan_states)
+    : max_num_scan_states_(max_num_scan_states),
+      random_generator_(GetSteadyTimeNanoseconds()) {}
+
+uint64_t ScanStateManager::Add(ScanState scan_state) {
+  absl_ports::unique_lock l(&mutex_);
+  while (!token_list_.empty() &&
+         static_cast<int>(token_list_.size()) >= max_num_scan_states_) {
+    InternalInvalidate(token_list_.front());
+  }
+
+  uint64_t new_token = random_generator_();
+  // There's a small chance of collision between the random numbers, here we're
+  // trying to avoid any collisions by checking the keys.
+  while (scan_states_.find(new_token) != scan_states_.end() ||
+         new_token == kInvalidNextPageToken) {
+    new_token = random_generator_();
+  }
+  token_list_.push_back(new_token);
+  scan_states_.emplace(
+      new_token, Entry{std::move(scan_state), std::prev(token_list_.end())});
+  return new_token;
+}
+
+libtextclassifier3::StatusOr<ScanState> ScanStateManager::Get(
+    uint64_t next_page_token) const {
+  absl_ports::shared_lock l(&mutex_);
+  auto itr = scan_states_.find(next_page_token);
+  if (itr == scan_states_.end()) {
+    return absl_ports::NotFoundError("next_page_token not found");
+  }
+  return itr->second.scan_state;
+}
+
+libtextclassifier3::Status ScanStateManager::Update(uint64_t next_page_token,
+                                                    ScanState scan_state) {
+  absl_ports::unique_lock l(&mutex_);
+  auto itr = scan_states_.find(next_page_token);
+  if (itr == scan_states_.end()) {
+    return absl_ports::NotFoundError("next_page_token not found");
+  }
+  itr->second.scan_state = std::move(scan_state);
+  return libtextclassifier3::Status::OK;
+}
+
+void ScanStateManager::Invalidate(uint64_t next_page_token) {
+  absl_ports::unique_lock l(&mutex_);
+  InternalInvalidate(next_page_token);
+}
+
+void ScanStateManager::InvalidateAll() {
+  absl_ports::unique_lock l(&mutex_);
+  scan_states_.clear();
+  token_list_.clear();
+}
+
+void ScanStateManager::InternalInvalidate(uint64_t next_page_token) {
+  auto itr = scan_states_.find(next_page_token);
+  if (itr == scan_states_.end()) {
+    return;
+  }
+  token_list_.erase(itr->second.token_itr);
+  scan_states_.erase(itr);
+}
+
+}  // namespace lib
+}  // namespace icing
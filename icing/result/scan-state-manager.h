@@ -0,0 +1,117 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_RESULT_SCAN_STATE_MANAGER_H_
+#define ICING_RESULT_SCAN_STATE_MANAGER_H_
+
+#include <cstdint>
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "icing/text_classifier/lib3/utils/base/status.h"
+#include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/mutex.h"
+#include "icing/proto/search.pb.h"
+#include "icing/store/document-filter-data.h"
+#include "icing/store/document-id.h"
+#include "icing/store/namespace-id.h"
+
+namespace icing {
+namespace lib {
+
+// Where a scan over the document store is between two pages.
+struct ScanState {
+  // Only documents in these namespaces are returned. Empty to allow all.
+  std::unordered_set<NamespaceId> namespace_ids;
+
+  // Only documents of these schema types are returned. Empty to allow all.
+  std::unordered_set<SchemaTypeId> schema_type_ids;
+
+  int num_per_page;
+
+  // The projection to apply to the returned documents.
+  GetResultSpecProto result_spec;
+
+  // The first DocumentId of the next page.
+  DocumentId next_document_id;
+};
+
+// Stores the states of scans that have more pages, by their next-page
+// tokens. Since the states hold DocumentIds, they must be dropped whenever
+// DocumentIds are reassigned, i.e. by Optimize.
+//
+// This class is thread-safe.
+class ScanStateManager {
+ public:
+  // When a state is added while max_num_scan_states are stored, the oldest
+  // one is evicted.
+  explicit ScanStateManager(int max_num_scan_states);
+
+  ScanStateManager(const ScanStateManager&) = delete;
+  ScanStateManager& operator=(const ScanStateManager&) = delete;
+
+  // Stores the scan state and returns a next-page token for it, which is
+  // never 0.
+  uint64_t Add(ScanState scan_state) ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Returns:
+  //   The scan state of the token on success
+  //   NOT_FOUND if the token is unknown or has been invalidated
+  libtextclassifier3::StatusOr<ScanState> Get(uint64_t next_page_token) const
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Replaces the scan state of the token, once the scan has moved on.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if the token is unknown or has been invalidated
+  libtextclassifier3::Status Update(uint64_t next_page_token,
+                                    ScanState scan_state)
+      ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Invalidates the scan state of the token, if any.
+  void Invalidate(uint64_t next_page_token) ICING_LOCKS_EXCLUDED(mutex_);
+
+  // Invalidates all scan states.
+  void InvalidateAll() ICING_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // A stored scan state along with its position in token_list_.
+  struct Entry {
+    ScanState scan_state;
+    std::list<uint64_t>::iterator token_itr;
+  };
+
+  void InternalInvalidate(uint64_t next_page_token)
+      ICING_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable absl_ports::shared_mutex mutex_;
+
+  const int max_num_scan_states_;
+
+  std::unordered_map<uint64_t, Entry> scan_states_ ICING_GUARDED_BY(mutex_);
+
+  // The tokens of scan_states_, oldest first.
+  std::list<uint64_t> token_list_ ICING_GUARDED_BY(mutex_);
+
+  std::mt19937_64 random_generator_ ICING_GUARDED_BY(mutex_);
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_RESULT_SCAN_STATE_MANAGER_H_
@@ -0,0 +1,110 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/result/scan-state-manager.h"
+
+#include <cstdint>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/result/result-state-manager.h"
+#include "icing/store/document-id.h"
+#include "icing/testing/common-matchers.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::UnorderedElementsAre;
+
+ScanState CreateScanState(DocumentId next_document_id) {
+  ScanState scan_state;
+  scan_state.num_per_page = 10;
+  scan_state.next_document_id = next_document_id;
+  return scan_state;
+}
+
+TEST(ScanStateManagerTest, AddAndGet) {
+  ScanStateManager scan_state_manager(/*max_num_scan_states=*/2);
+  ScanState scan_state = CreateScanState(/*next_document_id=*/5);
+  scan_state.namespace_ids = {1, 2};
+  uint64_t token = scan_state_manager.Add(scan_state);
+  EXPECT_THAT(token, Ne(kInvalidNextPageToken));
+
+  ICING_ASSERT_OK_AND_ASSIGN(ScanState stored_scan_state,
+                             scan_state_manager.Get(token));
+  EXPECT_THAT(stored_scan_state.next_document_id, Eq(5));
+  EXPECT_THAT(stored_scan_state.namespace_ids, UnorderedElementsAre(1, 2));
+}
+
+TEST(ScanStateManagerTest, GetUnknownTokenNotFound) {
+  ScanStateManager scan_state_manager(/*max_num_scan_states=*/2);
+  EXPECT_THAT(scan_state_manager.Get(kInvalidNextPageToken),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST(ScanStateManagerTest, Update) {
+  ScanStateManager scan_state_manager(/*max_num_scan_states=*/2);
+  uint64_t token = scan_state_manager.Add(CreateScanState(0));
+  ICING_ASSERT_OK(scan_state_manager.Update(token, CreateScanState(7)));
+
+  ICING_ASSERT_OK_AND_ASSIGN(ScanState stored_scan_state,
+                             scan_state_manager.Get(token));
+  EXPECT_THAT(stored_scan_state.next_document_id, Eq(7));
+
+  scan_state_manager.Invalidate(token);
+  EXPECT_THAT(scan_state_manager.Update(token, CreateScanState(9)),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST(ScanStateManagerTest, Invalidate) {
+  ScanStateManager scan_state_manager(/*max_num_scan_states=*/2);
+  uint64_t token1 = scan_state_manager.Add(CreateScanState(0));
+  uint64_t token2 = scan_state_manager.Add(CreateScanState(0));
+
+  scan_state_manager.Invalidate(token1);
+  EXPECT_THAT(scan_state_manager.Get(token1),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_EXPECT_OK(scan_state_manager.Get(token2));
+
+  scan_state_manager.InvalidateAll();
+  EXPECT_THAT(scan_state_manager.Get(token2),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST(ScanStateManagerTest, AddEvictsOldestState) {
+  ScanStateManager scan_state_manager(/*max_num_scan_states=*/2);
+  uint64_t token1 = scan_state_manager.Add(CreateScanState(0));
+  uint64_t token2 = scan_state_manager.Add(CreateScanState(0));
+  uint64_t token3 = scan_state_manager.Add(CreateScanState(0));
+
+  EXPECT_THAT(scan_state_manager.Get(token1),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_EXPECT_OK(scan_state_manager.Get(token2));
+  ICING_EXPECT_OK(scan_state_manager.Get(token3));
+
+  // Invalidated states leave room for new ones.
+  scan_state_manager.Invalidate(token2);
+  uint64_t token4 = scan_state_manager.Add(CreateScanState(0));
+  ICING_EXPECT_OK(scan_state_manager.Get(token3));
+  ICING_EXPECT_OK(scan_state_manager.Get(token4));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
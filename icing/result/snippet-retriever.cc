@@ -355,8 +355,15 @@ void GetEntriesFromProperty(const PropertyProto* current_property,
                             SnippetProto* snippet_proto) {
   // We're at the end. Let's check our values.
   for (int i = 0; i < current_property->string_values_size(); ++i) {
-    SnippetProto::EntryProto snippet_entry;
-    snippet_entry.set_property_name(AddIndexToPath(
+    // The entry is built in place, on snippet_proto's arena if it has one,
+    // and dropped again if nothing in the value matches.
+    SnippetProto::EntryProto* snippet_entry = snippet_proto->add_entries();
+    auto drop_entry_if_empty = [snippet_proto, snippet_entry]() {
+      if (snippet_entry->snippet_matches().empty()) {
+        snippet_proto->mutable_entries()->RemoveLast();
+      }
+    };
+    snippet_entry->set_property_name(AddIndexToPath(
         current_property->string_values_size(), /*index=*/i, property_path));
     std::string_view value = current_property->string_values(i);
     std::unique_ptr<Tokenizer::Iterator> iterator =
@@ -369,9 +376,7 @@ void GetEntriesFromProperty(const PropertyProto* current_property,
           // We can't get the char_iterator to a valid position, so there's no
           // way for us to provide valid utf-16 indices. There's nothing more we
           // can do here, so just return whatever we've built up so far.
-          if (!snippet_entry.snippet_matches().empty()) {
-            *snippet_proto->add_entries() = std::move(snippet_entry);
-          }
+          drop_entry_if_empty();
           return;
         }
         SectionData data = {property_path, value};
@@ -386,23 +391,18 @@ void GetEntriesFromProperty(const PropertyProto* current_property,
             // Probably an internal error. The tokenizer iterator is probably in
             // an invalid state. There's nothing more we can do here, so just
             // return whatever we've built up so far.
-            if (!snippet_entry.snippet_matches().empty()) {
-              *snippet_proto->add_entries() = std::move(snippet_entry);
-            }
+            drop_entry_if_empty();
             return;
           }
         }
-        SnippetMatchProto match = std::move(match_or).ValueOrDie();
-        snippet_entry.mutable_snippet_matches()->Add(std::move(match));
+        *snippet_entry->add_snippet_matches() =
+            std::move(match_or).ValueOrDie();
         if (--match_options->max_matches_remaining <= 0) {
-          *snippet_proto->add_entries() = std::move(snippet_entry);
           return;
         }
       }
     }
-    if (!snippet_entry.snippet_matches().empty()) {
-      *snippet_proto->add_entries() = std::move(snippet_entry);
-    }
+    drop_entry_if_empty();
   }
 }
 
@@ -482,9 +482,22 @@ SnippetProto SnippetRetriever::RetrieveSnippet(
     const ResultSpecProto::SnippetSpecProto& snippet_spec,
     const DocumentProto& document, SectionIdMask section_id_mask) const {
   SnippetProto snippet_proto;
-  ICING_ASSIGN_OR_RETURN(SchemaTypeId type_id,
-                         schema_store_.GetSchemaTypeId(document.schema()),
-                         snippet_proto);
+  RetrieveSnippet(query_terms, match_type, snippet_spec, document,
+                  section_id_mask, &snippet_proto);
+  return snippet_proto;
+}
+
+void SnippetRetriever::RetrieveSnippet(
+    const SectionRestrictQueryTermsMap& query_terms,
+    TermMatchType::Code match_type,
+    const ResultSpecProto::SnippetSpecProto& snippet_spec,
+    const DocumentProto& document, SectionIdMask section_id_mask,
+    SnippetProto* snippet_proto) const {
+  auto type_id_or = schema_store_.GetSchemaTypeId(document.schema());
+  if (!type_id_or.ok()) {
+    return;
+  }
+  SchemaTypeId type_id = type_id_or.ValueOrDie();
   const std::unordered_set<std::string> empty_set;
   auto itr = query_terms.find("");
   const std::unordered_set<std::string>& unrestricted_set =
@@ -537,9 +550,8 @@ SnippetProto SnippetRetriever::RetrieveSnippet(
     std::unique_ptr<Tokenizer> tokenizer = std::move(tokenizer_or).ValueOrDie();
     RetrieveSnippetForSection(
         document, matcher.get(), tokenizer.get(), section_path,
-        /*section_path_index=*/0, "", &match_options, &snippet_proto);
+        /*section_path_index=*/0, "", &match_options, snippet_proto);
   }
-  return snippet_proto;
 }
 
 }  // namespace lib
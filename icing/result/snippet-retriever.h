@@ -63,6 +63,15 @@ class SnippetRetriever {
       const ResultSpecProto::SnippetSpecProto& snippet_spec,
       const DocumentProto& document, SectionIdMask section_id_mask) const;
 
+  // Same as above, but adds the snippet entries to snippet_proto. They are
+  // allocated on snippet_proto's arena, if it has one.
+  void RetrieveSnippet(const SectionRestrictQueryTermsMap& query_terms,
+                       TermMatchType::Code match_type,
+                       const ResultSpecProto::SnippetSpecProto& snippet_spec,
+                       const DocumentProto& document,
+                       SectionIdMask section_id_mask,
+                       SnippetProto* snippet_proto) const;
+
  private:
   explicit SnippetRetriever(const SchemaStore* schema_store,
                             const LanguageSegmenter* language_segmenter,
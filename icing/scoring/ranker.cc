@@ -134,5 +134,25 @@ std::vector<ScoredDocumentHit> PopTopResultsFromHeap(
   return scored_document_hit_result;
 }
 
+void PushToHeap(
+    ScoredDocumentHit scored_document_hit,
+    std::vector<ScoredDocumentHit>* scored_document_hits_heap,
+    const ScoredDocumentHitComparator& scored_document_hit_comparator) {
+  scored_document_hits_heap->push_back(std::move(scored_document_hit));
+  // Moves the new node up until its parent is better than it.
+  int node_index = scored_document_hits_heap->size() - 1;
+  while (node_index > 0) {
+    const int parent_index = (node_index - 1) / 2;
+    if (!scored_document_hit_comparator(
+            scored_document_hits_heap->at(node_index),
+            scored_document_hits_heap->at(parent_index))) {
+      break;
+    }
+    std::swap(scored_document_hits_heap->at(node_index),
+              scored_document_hits_heap->at(parent_index));
+    node_index = parent_index;
+  }
+}
+
 }  // namespace lib
 }  // namespace icing
@@ -39,6 +39,14 @@ std::vector<ScoredDocumentHit> PopTopResultsFromHeap(
     std::vector<ScoredDocumentHit>* scored_document_hits_heap, int num_results,
     const ScoredDocumentHitComparator& scored_document_hit_comparator);
 
+// Adds a result to the given heap.
+//
+// REQUIRED: scored_document_hits_heap is not null.
+void PushToHeap(
+    ScoredDocumentHit scored_document_hit,
+    std::vector<ScoredDocumentHit>* scored_document_hits_heap,
+    const ScoredDocumentHitComparator& scored_document_hit_comparator);
+
 }  // namespace lib
 }  // namespace icing
 
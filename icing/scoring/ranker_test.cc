@@ -252,6 +252,40 @@ TEST(RankerTest, ShouldPopResultsFromHeapMultipleTimes) {
   EXPECT_THAT(scored_document_hits.size(), Eq(0));
 }
 
+TEST(RankerTest, ShouldPopPushedResultsInOrder) {
+  ScoredDocumentHit scored_document_hit1 =
+      CreateScoredDocumentHit(/*document_id=*/1, /*score=*/1);
+  ScoredDocumentHit scored_document_hit2 =
+      CreateScoredDocumentHit(/*document_id=*/2, /*score=*/2);
+  ScoredDocumentHit scored_document_hit3 =
+      CreateScoredDocumentHit(/*document_id=*/3, /*score=*/3);
+  ScoredDocumentHit scored_document_hit4 =
+      CreateScoredDocumentHit(/*document_id=*/4, /*score=*/4);
+  ScoredDocumentHit scored_document_hit5 =
+      CreateScoredDocumentHit(/*document_id=*/5, /*score=*/5);
+
+  std::vector<ScoredDocumentHit> scored_document_hits = {scored_document_hit2,
+                                                         scored_document_hit4};
+
+  const ScoredDocumentHitComparator scored_document_hit_comparator(
+      /*is_descending=*/true);
+  BuildHeapInPlace(&scored_document_hits, scored_document_hit_comparator);
+  PushToHeap(scored_document_hit1, &scored_document_hits,
+             scored_document_hit_comparator);
+  PushToHeap(scored_document_hit5, &scored_document_hits,
+             scored_document_hit_comparator);
+  PushToHeap(scored_document_hit3, &scored_document_hits,
+             scored_document_hit_comparator);
+
+  EXPECT_THAT(PopTopResultsFromHeap(&scored_document_hits, /*num_results=*/5,
+                                    scored_document_hit_comparator),
+              ElementsAre(EqualsScoredDocumentHit(scored_document_hit5),
+                          EqualsScoredDocumentHit(scored_document_hit4),
+                          EqualsScoredDocumentHit(scored_document_hit3),
+                          EqualsScoredDocumentHit(scored_document_hit2),
+                          EqualsScoredDocumentHit(scored_document_hit1)));
+}
+
 }  // namespace
 
 }  // namespace lib
@@ -23,9 +23,14 @@ namespace lib {
 // Id of a document
 using DocumentId = int32_t;
 
-// We use 20 bits to encode document_ids and use the largest value (1M - 1) to
+// We use 24 bits to encode document_ids and use the largest value (16M - 1) to
 // represent an invalid document_id.
-inline constexpr int kDocumentIdBits = 20;
+//
+// WARNING: Changing this value changes the layout of Hit::Value and will
+// invalidate any pre-existing lite and main indices on user devices. The index
+// header magics must be updated along with it so that stale indices are
+// detected and rebuilt from the document store.
+inline constexpr int kDocumentIdBits = 24;
 inline constexpr DocumentId kInvalidDocumentId = (1u << kDocumentIdBits) - 1;
 inline constexpr DocumentId kMinDocumentId = 0;
 inline constexpr DocumentId kMaxDocumentId = kInvalidDocumentId - 1;
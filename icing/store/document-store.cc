@@ -14,18 +14,21 @@
 
 #include "icing/store/document-store.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/text_classifier/lib3/utils/hash/farmhash.h"
+#include <google/protobuf/arena.h>
 #include "icing/absl_ports/annotate.h"
 #include "icing/absl_ports/canonical_errors.h"
 #include "icing/absl_ports/str_cat.h"
@@ -72,6 +75,7 @@ constexpr char kFilterCacheFilename[] = "filter_cache";
 constexpr char kNamespaceMapperFilename[] = "namespace_mapper";
 constexpr char kUsageStoreDirectoryName[] = "usage_store";
 constexpr char kCorpusIdMapperFilename[] = "corpus_mapper";
+constexpr char kUriPrefixMapperFilename[] = "uri_prefix_mapper";
 
 // Determined through manual testing to allow for 1 million uris. 1 million
 // because we allow up to 1 million DocumentIds.
@@ -82,6 +86,14 @@ constexpr int32_t kUriMapperMaxSize = 36 * 1024 * 1024;  // 36 MiB
 constexpr int32_t kNamespaceMapperMaxSize = 3 * 128 * 1024;  // 384 KiB
 constexpr int32_t kCorpusMapperMaxSize = 3 * 128 * 1024;     // 384 KiB
 
+// Holds the full uris rather than fingerprints of them, which takes about
+// twice as much space for typical uris.
+constexpr int32_t kUriPrefixMapperMaxSize = 72 * 1024 * 1024;  // 72 MiB
+
+// Number of bytes that a NamespaceId takes up at the start of a uri prefix
+// mapper key.
+constexpr int kUriPrefixKeyNamespaceIdBytes = 3;
+
 DocumentWrapper CreateDocumentWrapper(DocumentProto&& document) {
   DocumentWrapper document_wrapper;
   *document_wrapper.mutable_document() = std::move(document);
@@ -120,6 +132,26 @@ std::string MakeCorpusMapperFilename(const std::string& base_dir) {
   return absl_ports::StrCat(base_dir, "/", kCorpusIdMapperFilename);
 }
 
+std::string MakeUriPrefixMapperFilename(const std::string& base_dir) {
+  return absl_ports::StrCat(base_dir, "/", kUriPrefixMapperFilename);
+}
+
+// Makes the key of the uri prefix mapper for a uri, or a prefix of one, in the
+// namespace with namespace_id. The namespace id is encoded into a fixed number
+// of bytes, none of which is '0' since DynamicTrie can't handle those, so that
+// keys of the same namespace share their first bytes.
+std::string MakeUriPrefixKey(NamespaceId namespace_id, std::string_view uri) {
+  std::string key;
+  key.reserve(kUriPrefixKeyNamespaceIdBytes + uri.size());
+  uint32_t id = namespace_id;
+  for (int i = 0; i < kUriPrefixKeyNamespaceIdBytes; ++i) {
+    key.push_back((id & 0x7F) + 1);
+    id >>= 7;
+  }
+  absl_ports::StrAppend(&key, uri);
+  return key;
+}
+
 // TODO(adorokhine): This class internally uses an 8-byte fingerprint of the
 // Key and stores the key/value in a file-backed-trie that adds an ~80 byte
 // overhead per key. As we know that these fingerprints are always 8-bytes in
@@ -302,6 +334,8 @@ libtextclassifier3::StatusOr<DataLoss> DocumentStore::Initialize(
     }
   }
 
+  ICING_RETURN_IF_ERROR(InitializeExpiryQueue());
+
   initialized_ = true;
   if (initialize_stats != nullptr) {
     initialize_stats->set_num_documents(document_id_mapper_->num_elements());
@@ -383,6 +417,12 @@ libtextclassifier3::Status DocumentStore::InitializeExistingDerivedFiles() {
                              *filesystem_, MakeCorpusScoreCache(base_dir_),
                              MemoryMappedFile::READ_WRITE_AUTO_SYNC));
 
+  ICING_ASSIGN_OR_RETURN(
+      uri_prefix_mapper_,
+      KeyMapper<DocumentId>::Create(*filesystem_,
+                                    MakeUriPrefixMapperFilename(base_dir_),
+                                    kUriPrefixMapperMaxSize));
+
   // Ensure the usage store is the correct size.
   ICING_RETURN_IF_ERROR(
       usage_store_->TruncateTo(document_id_mapper_->num_elements()));
@@ -393,6 +433,10 @@ libtextclassifier3::Status DocumentStore::InitializeExistingDerivedFiles() {
         "Combined checksum of DocStore was inconsistent");
   }
 
+  num_deleted_documents_ = header.num_deleted_documents;
+  deleted_document_bytes_ = header.deleted_document_bytes;
+  deleted_document_tokens_ = header.deleted_document_tokens;
+  total_document_tokens_ = header.total_document_tokens;
   return libtextclassifier3::Status::OK;
 }
 
@@ -405,6 +449,11 @@ libtextclassifier3::Status DocumentStore::RegenerateDerivedFiles(
   ICING_RETURN_IF_ERROR(ResetNamespaceMapper());
   ICING_RETURN_IF_ERROR(ResetCorpusMapper());
   ICING_RETURN_IF_ERROR(ResetCorpusAssociatedScoreCache());
+  ICING_RETURN_IF_ERROR(ResetUriPrefixMapper());
+  num_deleted_documents_ = 0;
+  deleted_document_bytes_ = 0;
+  deleted_document_tokens_ = 0;
+  total_document_tokens_ = 0;
 
   // Creates a new UsageStore instance. Note that we don't reset the data in
   // usage store here because we're not able to regenerate the usage scores.
@@ -422,7 +471,10 @@ libtextclassifier3::Status DocumentStore::RegenerateDerivedFiles(
     if (absl_ports::IsNotFound(document_wrapper_or.status())) {
       // The erased document still occupies 1 document id.
       DocumentId new_document_id = document_id_mapper_->num_elements();
-      ICING_RETURN_IF_ERROR(ClearDerivedData(new_document_id));
+      ICING_ASSIGN_OR_RETURN(
+          int64_t record_size,
+          document_log_->GetRecordSize(iterator.GetOffset()));
+      ICING_RETURN_IF_ERROR(ClearDerivedData(new_document_id, record_size));
       iterator_status = iterator.Advance();
       continue;
     } else if (!document_wrapper_or.ok()) {
@@ -437,8 +489,11 @@ libtextclassifier3::Status DocumentStore::RegenerateDerivedFiles(
         // Document is no longer valid with the current schema. Mark as
         // deleted
         DocumentId new_document_id = document_id_mapper_->num_elements();
+        ICING_ASSIGN_OR_RETURN(
+            int64_t record_size,
+            document_log_->GetRecordSize(iterator.GetOffset()));
         ICING_RETURN_IF_ERROR(document_log_->EraseProto(iterator.GetOffset()));
-        ICING_RETURN_IF_ERROR(ClearDerivedData(new_document_id));
+        ICING_RETURN_IF_ERROR(ClearDerivedData(new_document_id, record_size));
         continue;
       }
     }
@@ -474,6 +529,9 @@ libtextclassifier3::Status DocumentStore::RegenerateDerivedFiles(
         NamespaceId namespace_id,
         namespace_mapper_->GetOrPut(document_wrapper.document().namespace_(),
                                     namespace_mapper_->num_keys()));
+    ICING_RETURN_IF_ERROR(uri_prefix_mapper_->Put(
+        MakeUriPrefixKey(namespace_id, document_wrapper.document().uri()),
+        new_document_id));
 
     // Update corpus maps
     std::string corpus =
@@ -497,6 +555,8 @@ libtextclassifier3::Status DocumentStore::RegenerateDerivedFiles(
             corpusId, document_wrapper.document().score(),
             document_wrapper.document().creation_timestamp_ms(),
             document_wrapper.document().internal_fields().length_in_tokens())));
+    total_document_tokens_ +=
+        document_wrapper.document().internal_fields().length_in_tokens();
 
     int64_t expiration_timestamp_ms = CalculateExpirationTimestampMs(
         document_wrapper.document().creation_timestamp_ms(),
@@ -635,6 +695,23 @@ libtextclassifier3::Status DocumentStore::ResetNamespaceMapper() {
   return libtextclassifier3::Status::OK;
 }
 
+libtextclassifier3::Status DocumentStore::ResetUriPrefixMapper() {
+  uri_prefix_mapper_.reset();
+  libtextclassifier3::Status status = KeyMapper<DocumentId>::Delete(
+      *filesystem_, MakeUriPrefixMapperFilename(base_dir_));
+  if (!status.ok()) {
+    ICING_LOG(ERROR) << status.error_message()
+                     << "Failed to delete old uri prefix mapper";
+    return status;
+  }
+  ICING_ASSIGN_OR_RETURN(
+      uri_prefix_mapper_,
+      KeyMapper<DocumentId>::Create(*filesystem_,
+                                    MakeUriPrefixMapperFilename(base_dir_),
+                                    kUriPrefixMapperMaxSize));
+  return libtextclassifier3::Status::OK;
+}
+
 libtextclassifier3::Status DocumentStore::ResetCorpusMapper() {
   // TODO(b/139734457): Replace ptr.reset()->Delete->Create flow with Reset().
   corpus_mapper_.reset();
@@ -703,6 +780,8 @@ libtextclassifier3::StatusOr<Crc32> DocumentStore::ComputeChecksum() const {
 
   Crc32 corpus_mapper_checksum = corpus_mapper_->ComputeChecksum();
 
+  Crc32 uri_prefix_mapper_checksum = uri_prefix_mapper_->ComputeChecksum();
+
   // TODO(b/144458732): Implement a more robust version of TC_ASSIGN_OR_RETURN
   // that can support error logging.
   checksum_or = corpus_score_cache_->ComputeChecksum();
@@ -726,6 +805,7 @@ libtextclassifier3::StatusOr<Crc32> DocumentStore::ComputeChecksum() const {
   total_checksum.Append(std::to_string(namespace_mapper_checksum.Get()));
   total_checksum.Append(std::to_string(corpus_mapper_checksum.Get()));
   total_checksum.Append(std::to_string(corpus_score_cache_checksum.Get()));
+  total_checksum.Append(std::to_string(uri_prefix_mapper_checksum.Get()));
 
   return total_checksum;
 }
@@ -747,6 +827,10 @@ libtextclassifier3::Status DocumentStore::UpdateHeader(const Crc32& checksum) {
   DocumentStore::Header header;
   header.magic = DocumentStore::Header::kMagic;
   header.checksum = checksum.Get();
+  header.num_deleted_documents = num_deleted_documents_;
+  header.deleted_document_bytes = deleted_document_bytes_;
+  header.deleted_document_tokens = deleted_document_tokens_;
+  header.total_document_tokens = total_document_tokens_;
 
   // This should overwrite the header.
   ScopedFd sfd(
@@ -821,6 +905,8 @@ libtextclassifier3::StatusOr<DocumentId> DocumentStore::InternalPut(
   ICING_ASSIGN_OR_RETURN(
       NamespaceId namespace_id,
       namespace_mapper_->GetOrPut(name_space, namespace_mapper_->num_keys()));
+  ICING_RETURN_IF_ERROR(uri_prefix_mapper_->Put(
+      MakeUriPrefixKey(namespace_id, uri), new_document_id));
 
   // Update corpus maps
   ICING_ASSIGN_OR_RETURN(
@@ -846,6 +932,8 @@ libtextclassifier3::StatusOr<DocumentId> DocumentStore::InternalPut(
   ICING_RETURN_IF_ERROR(UpdateFilterCache(
       new_document_id, DocumentFilterData(namespace_id, schema_type_id,
                                           expiration_timestamp_ms)));
+  total_document_tokens_ += length_in_tokens;
+  AddToExpiryQueue(new_document_id, expiration_timestamp_ms);
 
   if (old_document_id_or.ok()) {
     // The old document exists, copy over the usage scores and delete the old
@@ -873,6 +961,54 @@ libtextclassifier3::StatusOr<DocumentId> DocumentStore::InternalPut(
   return new_document_id;
 }
 
+libtextclassifier3::StatusOr<DocumentId> DocumentStore::InternalCopyDocument(
+    const PortableFileBackedProtoLog<DocumentWrapper>& document_log,
+    int64_t document_log_offset, const DocumentAssociatedScoreData& score_data,
+    const DocumentFilterData& filter_data, std::string_view key,
+    std::string_view name_space, std::string_view uri,
+    std::string_view corpus_key) {
+  DocumentId new_document_id = document_id_mapper_->num_elements();
+  if (!IsDocumentIdValid(new_document_id)) {
+    return absl_ports::ResourceExhaustedError(
+        "Exceeded maximum number of documents. Try calling Optimize to reclaim "
+        "some space.");
+  }
+
+  ICING_ASSIGN_OR_RETURN(
+      int64_t file_offset,
+      document_log_->CopyRecordFrom(document_log, document_log_offset));
+  ICING_RETURN_IF_ERROR(document_key_mapper_->Put(key, new_document_id));
+  ICING_RETURN_IF_ERROR(document_id_mapper_->Set(new_document_id, file_offset));
+
+  ICING_ASSIGN_OR_RETURN(
+      NamespaceId namespace_id,
+      namespace_mapper_->GetOrPut(name_space, namespace_mapper_->num_keys()));
+  ICING_RETURN_IF_ERROR(uri_prefix_mapper_->Put(
+      MakeUriPrefixKey(namespace_id, uri), new_document_id));
+
+  ICING_ASSIGN_OR_RETURN(
+      CorpusId corpus_id,
+      corpus_mapper_->GetOrPut(corpus_key, corpus_mapper_->num_keys()));
+  ICING_ASSIGN_OR_RETURN(CorpusAssociatedScoreData scoring_data,
+                         GetCorpusAssociatedScoreDataToUpdate(corpus_id));
+  scoring_data.AddDocument(score_data.length_in_tokens());
+  ICING_RETURN_IF_ERROR(
+      UpdateCorpusAssociatedScoreCache(corpus_id, scoring_data));
+
+  ICING_RETURN_IF_ERROR(UpdateDocumentAssociatedScoreCache(
+      new_document_id,
+      DocumentAssociatedScoreData(corpus_id, score_data.document_score(),
+                                  score_data.creation_timestamp_ms(),
+                                  score_data.length_in_tokens())));
+  ICING_RETURN_IF_ERROR(UpdateFilterCache(
+      new_document_id,
+      DocumentFilterData(namespace_id, filter_data.schema_type_id(),
+                         filter_data.expiration_timestamp_ms())));
+  total_document_tokens_ += score_data.length_in_tokens();
+  AddToExpiryQueue(new_document_id, filter_data.expiration_timestamp_ms());
+  return new_document_id;
+}
+
 libtextclassifier3::StatusOr<DocumentProto> DocumentStore::Get(
     const std::string_view name_space, const std::string_view uri,
     bool clear_internal_fields) const {
@@ -903,6 +1039,14 @@ libtextclassifier3::StatusOr<DocumentProto> DocumentStore::Get(
 
 libtextclassifier3::StatusOr<DocumentProto> DocumentStore::Get(
     DocumentId document_id, bool clear_internal_fields) const {
+  DocumentProto document;
+  ICING_RETURN_IF_ERROR(Get(document_id, &document, clear_internal_fields));
+  return document;
+}
+
+libtextclassifier3::Status DocumentStore::Get(
+    DocumentId document_id, DocumentProto* document,
+    bool clear_internal_fields) const {
   ICING_RETURN_IF_ERROR(DoesDocumentExistWithStatus(document_id));
 
   auto document_log_offset_or = document_id_mapper_->Get(document_id);
@@ -914,21 +1058,183 @@ libtextclassifier3::StatusOr<DocumentProto> DocumentStore::Get(
   }
   int64_t document_log_offset = *document_log_offset_or.ValueOrDie();
 
-  // TODO(b/144458732): Implement a more robust version of TC_ASSIGN_OR_RETURN
-  // that can support error logging.
-  auto document_wrapper_or = document_log_->ReadProto(document_log_offset);
-  if (!document_wrapper_or.ok()) {
-    ICING_LOG(ERROR) << document_wrapper_or.status().error_message()
+  // The wrapper lives on the same arena as the document, so that the document
+  // can be swapped out of it without a copy.
+  google::protobuf::Arena* arena = document->GetArena();
+  std::unique_ptr<DocumentWrapper> owned_document_wrapper;
+  DocumentWrapper* document_wrapper;
+  if (arena != nullptr) {
+    document_wrapper =
+        google::protobuf::Arena::CreateMessage<DocumentWrapper>(arena);
+  } else {
+    owned_document_wrapper = std::make_unique<DocumentWrapper>();
+    document_wrapper = owned_document_wrapper.get();
+  }
+  libtextclassifier3::Status status =
+      document_log_->ReadProto(document_log_offset, document_wrapper);
+  if (!status.ok()) {
+    ICING_LOG(ERROR) << status.error_message()
                      << "Failed to read from document log";
-    return document_wrapper_or.status();
+    return status;
   }
-  DocumentWrapper document_wrapper =
-      std::move(document_wrapper_or).ValueOrDie();
   if (clear_internal_fields) {
-    document_wrapper.mutable_document()->clear_internal_fields();
+    document_wrapper->mutable_document()->clear_internal_fields();
+  }
+
+  document->Swap(document_wrapper->mutable_document());
+  return libtextclassifier3::Status::OK;
+}
+
+std::vector<libtextclassifier3::Status> DocumentStore::BatchGet(
+    const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+    const std::vector<DocumentProto*>& documents,
+    bool clear_internal_fields) const {
+  std::vector<DocumentId> document_ids;
+  document_ids.reserve(keys.size());
+  std::vector<libtextclassifier3::Status> key_statuses(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto document_id_or = GetDocumentId(keys[i].first, keys[i].second);
+    if (!document_id_or.ok()) {
+      key_statuses[i] = std::move(document_id_or).status();
+      document_ids.push_back(kInvalidDocumentId);
+    } else {
+      document_ids.push_back(document_id_or.ValueOrDie());
+    }
+  }
+
+  std::vector<libtextclassifier3::Status> statuses =
+      BatchGet(document_ids, documents, clear_internal_fields);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!key_statuses[i].ok() && !absl_ports::IsNotFound(key_statuses[i])) {
+      statuses[i] = std::move(key_statuses[i]);
+    } else if (!key_statuses[i].ok() || absl_ports::IsNotFound(statuses[i])) {
+      const auto& [name_space, uri] = keys[i];
+      statuses[i] = absl_ports::NotFoundError(IcingStringUtil::StringPrintf(
+          "Document (%s, %s) not found.", name_space.data(), uri.data()));
+    }
+  }
+  return statuses;
+}
+
+std::vector<libtextclassifier3::Status> DocumentStore::BatchGet(
+    const std::vector<DocumentId>& document_ids,
+    const std::vector<DocumentProto*>& documents,
+    bool clear_internal_fields) const {
+  std::vector<libtextclassifier3::Status> statuses(document_ids.size());
+
+  // The log offsets of the documents that exist, along with their positions
+  // in document_ids.
+  std::vector<std::pair<int64_t, size_t>> offsets_and_indices;
+  offsets_and_indices.reserve(document_ids.size());
+  for (size_t i = 0; i < document_ids.size(); ++i) {
+    statuses[i] = DoesDocumentExistWithStatus(document_ids[i]);
+    if (!statuses[i].ok()) {
+      continue;
+    }
+    auto document_log_offset_or = document_id_mapper_->Get(document_ids[i]);
+    if (!document_log_offset_or.ok()) {
+      statuses[i] =
+          absl_ports::InternalError("Failed to find document offset.");
+      continue;
+    }
+    offsets_and_indices.push_back({*document_log_offset_or.ValueOrDie(), i});
+  }
+  std::sort(offsets_and_indices.begin(), offsets_and_indices.end());
+
+  // As in Get, the wrappers live on the same arenas as the documents.
+  std::vector<std::unique_ptr<DocumentWrapper>> owned_document_wrappers;
+  std::vector<int64_t> document_log_offsets;
+  std::vector<DocumentWrapper*> document_wrappers;
+  document_log_offsets.reserve(offsets_and_indices.size());
+  document_wrappers.reserve(offsets_and_indices.size());
+  for (const auto& [document_log_offset, index] : offsets_and_indices) {
+    google::protobuf::Arena* arena = documents[index]->GetArena();
+    if (arena != nullptr) {
+      document_wrappers.push_back(
+          google::protobuf::Arena::CreateMessage<DocumentWrapper>(arena));
+    } else {
+      owned_document_wrappers.push_back(std::make_unique<DocumentWrapper>());
+      document_wrappers.push_back(owned_document_wrappers.back().get());
+    }
+    document_log_offsets.push_back(document_log_offset);
   }
 
-  return std::move(*document_wrapper.mutable_document());
+  std::vector<libtextclassifier3::Status> read_statuses =
+      document_log_->ReadProtos(document_log_offsets, document_wrappers);
+  for (size_t i = 0; i < offsets_and_indices.size(); ++i) {
+    size_t index = offsets_and_indices[i].second;
+    if (!read_statuses[i].ok()) {
+      ICING_LOG(ERROR) << read_statuses[i].error_message()
+                       << "Failed to read from document log";
+      statuses[index] = std::move(read_statuses[i]);
+      continue;
+    }
+    DocumentProto* document = document_wrappers[i]->mutable_document();
+    if (clear_internal_fields) {
+      document->clear_internal_fields();
+    }
+    documents[index]->Swap(document);
+  }
+  return statuses;
+}
+
+std::vector<DocumentId> DocumentStore::GetDocumentIdsByUriPrefix(
+    std::string_view name_space, std::string_view uri_prefix) const {
+  std::vector<DocumentId> document_ids;
+  auto namespace_id_or = namespace_mapper_->Get(name_space);
+  if (!namespace_id_or.ok()) {
+    return document_ids;
+  }
+  // Documents that were replaced or deleted may still have a key, pointing to
+  // their last DocumentId, until the next Optimize.
+  for (DocumentId document_id : uri_prefix_mapper_->GetValuesWithKeyPrefix(
+           MakeUriPrefixKey(namespace_id_or.ValueOrDie(), uri_prefix))) {
+    if (DoesDocumentExist(document_id)) {
+      document_ids.push_back(document_id);
+    }
+  }
+  return document_ids;
+}
+
+std::vector<DocumentId> DocumentStore::ScanDocumentIds(
+    const std::unordered_set<NamespaceId>& namespace_ids,
+    const std::unordered_set<SchemaTypeId>& schema_type_ids,
+    int max_documents, DocumentId* next_document_id) const {
+  std::vector<DocumentId> document_ids;
+  DocumentId document_id = *next_document_id;
+  for (; document_id != kInvalidDocumentId &&
+         document_id < filter_cache_->num_elements() &&
+         static_cast<int>(document_ids.size()) < max_documents;
+       ++document_id) {
+    auto filter_data_or = filter_cache_->Get(document_id);
+    if (!filter_data_or.ok()) {
+      continue;
+    }
+    const DocumentFilterData* data = filter_data_or.ValueOrDie();
+    if (data->namespace_id() == kInvalidNamespaceId) {
+      // The document has been hard-deleted.
+      continue;
+    }
+    if (!namespace_ids.empty() &&
+        namespace_ids.count(data->namespace_id()) == 0) {
+      continue;
+    }
+    if (!schema_type_ids.empty() &&
+        schema_type_ids.count(data->schema_type_id()) == 0) {
+      continue;
+    }
+    if (DoesDocumentExist(document_id)) {
+      document_ids.push_back(document_id);
+    }
+  }
+
+  if (document_id == kInvalidDocumentId ||
+      document_id >= filter_cache_->num_elements()) {
+    *next_document_id = kInvalidDocumentId;
+  } else {
+    *next_document_id = document_id;
+  }
+  return document_ids;
 }
 
 libtextclassifier3::StatusOr<DocumentId> DocumentStore::GetDocumentId(
@@ -1067,10 +1373,12 @@ libtextclassifier3::Status DocumentStore::Delete(DocumentId document_id) {
     return absl_ports::InternalError("Failed to find document offset.");
   }
   int64_t document_log_offset = *document_log_offset_or.ValueOrDie();
+  ICING_ASSIGN_OR_RETURN(int64_t record_size,
+                         document_log_->GetRecordSize(document_log_offset));
 
   // Erases document proto.
   ICING_RETURN_IF_ERROR(document_log_->EraseProto(document_log_offset));
-  return ClearDerivedData(document_id);
+  return ClearDerivedData(document_id, record_size);
 }
 
 libtextclassifier3::StatusOr<NamespaceId> DocumentStore::GetNamespaceId(
@@ -1106,6 +1414,35 @@ DocumentStore::GetDocumentAssociatedScoreData(DocumentId document_id) const {
   return document_associated_score_data;
 }
 
+libtextclassifier3::Status DocumentStore::SetLengthInTokens(
+    DocumentId document_id, int32_t length_in_tokens) {
+  ICING_ASSIGN_OR_RETURN(DocumentAssociatedScoreData score_data,
+                         GetDocumentAssociatedScoreData(document_id));
+  if (score_data.length_in_tokens() == length_in_tokens) {
+    return libtextclassifier3::Status::OK;
+  }
+
+  ICING_ASSIGN_OR_RETURN(
+      CorpusAssociatedScoreData corpus_data,
+      GetCorpusAssociatedScoreDataToUpdate(score_data.corpus_id()));
+  // Clamped the same way as CorpusAssociatedScoreData::AddDocument.
+  int64_t sum_length_in_tokens =
+      static_cast<int64_t>(corpus_data.sum_length_in_tokens()) -
+      score_data.length_in_tokens() + length_in_tokens;
+  corpus_data.set_sum_length_in_tokens(std::clamp<int64_t>(
+      sum_length_in_tokens, 0, std::numeric_limits<int>::max()));
+  ICING_RETURN_IF_ERROR(
+      UpdateCorpusAssociatedScoreCache(score_data.corpus_id(), corpus_data));
+
+  ICING_RETURN_IF_ERROR(UpdateDocumentAssociatedScoreCache(
+      document_id,
+      DocumentAssociatedScoreData(
+          score_data.corpus_id(), score_data.document_score(),
+          score_data.creation_timestamp_ms(), length_in_tokens)));
+  total_document_tokens_ += length_in_tokens - score_data.length_in_tokens();
+  return libtextclassifier3::Status::OK;
+}
+
 libtextclassifier3::StatusOr<CorpusAssociatedScoreData>
 DocumentStore::GetCorpusAssociatedScoreData(CorpusId corpus_id) const {
   auto score_data_or = corpus_score_cache_->GetCopy(corpus_id);
@@ -1237,6 +1574,29 @@ DocumentStore::DeleteByGroupResult DocumentStore::DeleteBySchemaType(
   return result;
 }
 
+DocumentStore::DeleteByGroupResult DocumentStore::DeleteByUriPrefix(
+    std::string_view name_space, std::string_view uri_prefix) {
+  DeleteByGroupResult result;
+  for (DocumentId document_id :
+       GetDocumentIdsByUriPrefix(name_space, uri_prefix)) {
+    libtextclassifier3::Status delete_status = Delete(document_id);
+    if (absl_ports::IsNotFound(delete_status)) {
+      continue;
+    } else if (!delete_status.ok()) {
+      result.status = std::move(delete_status);
+      return result;
+    }
+    ++result.num_docs_deleted;
+  }
+
+  if (result.num_docs_deleted <= 0) {
+    result.status = absl_ports::NotFoundError(
+        absl_ports::StrCat("No documents found in namespace '", name_space,
+                           "' with uri prefix '", uri_prefix, "'"));
+  }
+  return result;
+}
+
 libtextclassifier3::StatusOr<int> DocumentStore::BatchDelete(
     NamespaceId namespace_id, SchemaTypeId schema_type_id) {
   // Tracks if there were any existing documents with this namespace that we
@@ -1300,6 +1660,7 @@ libtextclassifier3::Status DocumentStore::PersistToDisk(
   ICING_RETURN_IF_ERROR(usage_store_->PersistToDisk());
   ICING_RETURN_IF_ERROR(corpus_mapper_->PersistToDisk());
   ICING_RETURN_IF_ERROR(corpus_score_cache_->PersistToDisk());
+  ICING_RETURN_IF_ERROR(uri_prefix_mapper_->PersistToDisk());
 
   // Update the combined checksum and write to header file.
   ICING_ASSIGN_OR_RETURN(Crc32 checksum, ComputeChecksum());
@@ -1308,6 +1669,18 @@ libtextclassifier3::Status DocumentStore::PersistToDisk(
   return libtextclassifier3::Status::OK;
 }
 
+int64_t DocumentStore::ReleaseCleanPages() {
+  return document_key_mapper_->ReleaseCleanPages() +
+         document_id_mapper_->ReleaseCleanPages() +
+         score_cache_->ReleaseCleanPages() +
+         filter_cache_->ReleaseCleanPages() +
+         namespace_mapper_->ReleaseCleanPages() +
+         usage_store_->ReleaseCleanPages() +
+         corpus_mapper_->ReleaseCleanPages() +
+         corpus_score_cache_->ReleaseCleanPages() +
+         uri_prefix_mapper_->ReleaseCleanPages();
+}
+
 int64_t GetValueOrDefault(const libtextclassifier3::StatusOr<int64_t>& value_or,
                           int64_t default_value) {
   return (value_or.ok()) ? value_or.ValueOrDie() : default_value;
@@ -1331,6 +1704,8 @@ DocumentStorageInfoProto DocumentStore::GetMemberStorageInfo() const {
       GetValueOrDefault(corpus_mapper_->GetDiskUsage(), -1));
   storage_info.set_corpus_score_cache_size(
       GetValueOrDefault(corpus_score_cache_->GetDiskUsage(), -1));
+  storage_info.set_uri_prefix_mapper_size(
+      GetValueOrDefault(uri_prefix_mapper_->GetDiskUsage(), -1));
   return storage_info;
 }
 
@@ -1573,51 +1948,89 @@ libtextclassifier3::Status DocumentStore::OptimizeInto(
   std::unique_ptr<DocumentStore> new_doc_store =
       std::move(doc_store_create_result.document_store);
 
+  // Documents are copied by their raw records in the document log, and their
+  // derived data is rebuilt from this store's, so that they don't have to be
+  // decompressed, parsed and compressed again. The keys of the mappers are
+  // needed for that, so look them up by value once.
+  std::unordered_map<DocumentId, std::string> document_keys =
+      document_key_mapper_->GetValuesToKeys();
+  std::unordered_map<DocumentId, std::string> uri_prefix_keys =
+      uri_prefix_mapper_->GetValuesToKeys();
+  std::unordered_map<NamespaceId, std::string> namespaces =
+      namespace_mapper_->GetValuesToKeys();
+  std::unordered_map<CorpusId, std::string> corpus_keys =
+      corpus_mapper_->GetValuesToKeys();
+
   // Writes all valid docs into new document store (new directory)
   int size = document_id_mapper_->num_elements();
   int num_deleted = 0;
   int num_expired = 0;
   UsageStore::UsageScores default_usage;
   for (DocumentId document_id = 0; document_id < size; document_id++) {
-    auto document_or = Get(document_id, /*clear_internal_fields=*/false);
-    if (absl_ports::IsNotFound(document_or.status())) {
-      if (IsDeleted(document_id)) {
-        ++num_deleted;
-      } else if (IsExpired(document_id)) {
-        ++num_expired;
-      }
+    if (IsDeleted(document_id)) {
+      ++num_deleted;
+      continue;
+    } else if (IsExpired(document_id)) {
+      ++num_expired;
       continue;
-    } else if (!document_or.ok()) {
-      // Real error, pass up
-      return absl_ports::Annotate(
-          document_or.status(),
-          IcingStringUtil::StringPrintf(
-              "Failed to retrieve Document for DocumentId %d", document_id));
     }
 
-    // Guaranteed to have a document now.
-    DocumentProto document_to_keep = document_or.ValueOrDie();
+    ICING_ASSIGN_OR_RETURN(DocumentAssociatedScoreData score_data,
+                           GetDocumentAssociatedScoreData(document_id));
+    ICING_ASSIGN_OR_RETURN(DocumentFilterData filter_data,
+                           GetDocumentFilterData(document_id));
+    auto key_itr = document_keys.find(document_id);
+    auto uri_prefix_key_itr = uri_prefix_keys.find(document_id);
+    auto namespace_itr = namespaces.find(filter_data.namespace_id());
+    auto corpus_key_itr = corpus_keys.find(score_data.corpus_id());
 
     libtextclassifier3::StatusOr<DocumentId> new_document_id_or;
-    if (document_to_keep.internal_fields().length_in_tokens() == 0) {
-      auto tokenized_document_or = TokenizedDocument::Create(
-          schema_store_, lang_segmenter, document_to_keep);
-      if (!tokenized_document_or.ok()) {
+    if (score_data.length_in_tokens() > 0 && key_itr != document_keys.end() &&
+        uri_prefix_key_itr != uri_prefix_keys.end() &&
+        namespace_itr != namespaces.end() &&
+        corpus_key_itr != corpus_keys.end()) {
+      ICING_ASSIGN_OR_RETURN(const int64_t* document_log_offset,
+                             document_id_mapper_->Get(document_id));
+      std::string_view uri(uri_prefix_key_itr->second);
+      uri.remove_prefix(kUriPrefixKeyNamespaceIdBytes);
+      new_document_id_or = new_doc_store->InternalCopyDocument(
+          *document_log_, *document_log_offset, score_data, filter_data,
+          key_itr->second, namespace_itr->second, uri, corpus_key_itr->second);
+    } else {
+      // Documents written before length_in_tokens was kept need to be
+      // tokenized, so they're put into the new document store as usual.
+      auto document_or = Get(document_id, /*clear_internal_fields=*/false);
+      if (absl_ports::IsNotFound(document_or.status())) {
+        continue;
+      } else if (!document_or.ok()) {
         return absl_ports::Annotate(
-            tokenized_document_or.status(),
+            document_or.status(),
             IcingStringUtil::StringPrintf(
-                "Failed to tokenize Document for DocumentId %d", document_id));
+                "Failed to retrieve Document for DocumentId %d", document_id));
+      }
+      DocumentProto document_to_keep = std::move(document_or).ValueOrDie();
+      if (document_to_keep.internal_fields().length_in_tokens() == 0) {
+        auto tokenized_document_or = TokenizedDocument::Create(
+            schema_store_, lang_segmenter, document_to_keep);
+        if (!tokenized_document_or.ok()) {
+          return absl_ports::Annotate(
+              tokenized_document_or.status(),
+              IcingStringUtil::StringPrintf(
+                  "Failed to tokenize Document for DocumentId %d",
+                  document_id));
+        }
+        TokenizedDocument tokenized_document(
+            std::move(tokenized_document_or).ValueOrDie());
+        new_document_id_or = new_doc_store->Put(
+            document_to_keep, tokenized_document.num_tokens());
+      } else {
+        new_document_id_or = new_doc_store->InternalPut(document_to_keep);
       }
-      TokenizedDocument tokenized_document(
-          std::move(tokenized_document_or).ValueOrDie());
-      new_document_id_or =
-          new_doc_store->Put(document_to_keep, tokenized_document.num_tokens());
-    } else {
-      // TODO(b/144458732): Implement a more robust version of
-      // TC_ASSIGN_OR_RETURN that can support error logging.
-      new_document_id_or = new_doc_store->InternalPut(document_to_keep);
     }
-    if (!new_document_id_or.ok()) {
+    if (absl_ports::IsNotFound(new_document_id_or.status())) {
+      // The document's record has been erased, so there's nothing to keep.
+      continue;
+    } else if (!new_document_id_or.ok()) {
       ICING_LOG(ERROR) << new_document_id_or.status().error_message()
                        << "Failed to write into new document store";
       return new_document_id_or.status();
@@ -1647,30 +2060,35 @@ libtextclassifier3::Status DocumentStore::OptimizeInto(
 libtextclassifier3::StatusOr<DocumentStore::OptimizeInfo>
 DocumentStore::GetOptimizeInfo() const {
   OptimizeInfo optimize_info;
-
-  // Figure out our ratio of optimizable/total docs.
-  int32_t num_documents = document_id_mapper_->num_elements();
-  for (DocumentId document_id = kMinDocumentId; document_id < num_documents;
-       ++document_id) {
-    if (!InternalDoesDocumentExist(document_id)) {
-      ++optimize_info.optimizable_docs;
-    }
-
-    ++optimize_info.total_docs;
-  }
-
+  optimize_info.total_docs = document_id_mapper_->num_elements();
   if (optimize_info.total_docs == 0) {
     // Can exit early since there's nothing to calculate.
     return optimize_info;
   }
 
-  // Get the total element size.
+  // Figure out our ratio of optimizable/total docs.
+  ICING_RETURN_IF_ERROR(CountExpiredDocuments());
+  int64_t optimizable_document_log_bytes;
+  {
+    absl_ports::shared_lock l(&expiry_mutex_);
+    optimize_info.optimizable_docs =
+        num_deleted_documents_ + expiry_queue_.num_expired_documents;
+    optimizable_document_log_bytes =
+        deleted_document_bytes_ + expiry_queue_.expired_document_bytes;
+    optimize_info.optimizable_tokens =
+        deleted_document_tokens_ + expiry_queue_.expired_document_tokens;
+  }
+  optimize_info.total_tokens = total_document_tokens_;
+  if (optimize_info.optimizable_docs == 0) {
+    return optimize_info;
+  }
+
+  // Get the total element size of the derived files. The optimizable part of
+  // the document log is known exactly.
   //
   // We use file size instead of disk usage here because the files are not
   // sparse, so it's more accurate. Disk usage rounds up to the nearest block
   // size.
-  ICING_ASSIGN_OR_RETURN(const int64_t document_log_file_size,
-                         document_log_->GetElementsFileSize());
   ICING_ASSIGN_OR_RETURN(const int64_t document_id_mapper_file_size,
                          document_id_mapper_->GetElementsFileSize());
   ICING_ASSIGN_OR_RETURN(const int64_t score_cache_file_size,
@@ -1689,22 +2107,77 @@ DocumentStore::GetOptimizeInfo() const {
   // backed by a trie, which has some sparse property bitmaps.
   ICING_ASSIGN_OR_RETURN(const int64_t document_key_mapper_size,
                          document_key_mapper_->GetElementsSize());
+  ICING_ASSIGN_OR_RETURN(const int64_t uri_prefix_mapper_size,
+                         uri_prefix_mapper_->GetElementsSize());
 
   // We don't include the namespace_mapper or the corpus_mapper because it's
   // not clear if we could recover any space even if Optimize were called.
   // Deleting 100s of documents could still leave a few documents of a
   // namespace, and then there would be no change.
 
-  int64_t total_size = document_log_file_size + document_key_mapper_size +
-                       document_id_mapper_file_size + score_cache_file_size +
-                       filter_cache_file_size + corpus_score_cache_file_size +
-                       usage_store_file_size;
+  int64_t derived_files_size =
+      document_key_mapper_size + document_id_mapper_file_size +
+      score_cache_file_size + filter_cache_file_size +
+      corpus_score_cache_file_size + usage_store_file_size +
+      uri_prefix_mapper_size;
 
   optimize_info.estimated_optimizable_bytes =
-      total_size * optimize_info.optimizable_docs / optimize_info.total_docs;
+      optimizable_document_log_bytes +
+      derived_files_size * optimize_info.optimizable_docs /
+          optimize_info.total_docs;
   return optimize_info;
 }
 
+void DocumentStore::AddToExpiryQueue(DocumentId document_id,
+                                     int64_t expiration_timestamp_ms) {
+  if (expiration_timestamp_ms == std::numeric_limits<int64_t>::max()) {
+    return;
+  }
+  absl_ports::unique_lock l(&expiry_mutex_);
+  expiry_queue_.documents.emplace(expiration_timestamp_ms, document_id);
+}
+
+libtextclassifier3::Status DocumentStore::InitializeExpiryQueue() {
+  {
+    absl_ports::unique_lock l(&expiry_mutex_);
+    expiry_queue_ = ExpiryQueue();
+  }
+  for (DocumentId document_id = 0; document_id < filter_cache_->num_elements();
+       ++document_id) {
+    ICING_ASSIGN_OR_RETURN(const DocumentFilterData* filter_data,
+                           filter_cache_->Get(document_id));
+    // Deleted documents have a negative expiration timestamp, and the ones
+    // that have already expired are counted by the next GetOptimizeInfo.
+    if (filter_data->expiration_timestamp_ms() >= 0) {
+      AddToExpiryQueue(document_id, filter_data->expiration_timestamp_ms());
+    }
+  }
+  return libtextclassifier3::Status::OK;
+}
+
+libtextclassifier3::Status DocumentStore::CountExpiredDocuments() const {
+  int64_t current_time_ms = clock_.GetSystemTimeMilliseconds();
+  absl_ports::unique_lock l(&expiry_mutex_);
+  while (!expiry_queue_.documents.empty() &&
+         expiry_queue_.documents.top().first <= current_time_ms) {
+    DocumentId document_id = expiry_queue_.documents.top().second;
+    if (!IsDeleted(document_id)) {
+      ICING_ASSIGN_OR_RETURN(const int64_t* document_log_offset,
+                             document_id_mapper_->Get(document_id));
+      ICING_ASSIGN_OR_RETURN(
+          int64_t record_size,
+          document_log_->GetRecordSize(*document_log_offset));
+      ICING_ASSIGN_OR_RETURN(const DocumentAssociatedScoreData* score_data,
+                             score_cache_->Get(document_id));
+      ++expiry_queue_.num_expired_documents;
+      expiry_queue_.expired_document_bytes += record_size;
+      expiry_queue_.expired_document_tokens += score_data->length_in_tokens();
+    }
+    expiry_queue_.documents.pop();
+  }
+  return libtextclassifier3::Status::OK;
+}
+
 libtextclassifier3::Status DocumentStore::UpdateCorpusAssociatedScoreCache(
     CorpusId corpus_id, const CorpusAssociatedScoreData& score_data) {
   return corpus_score_cache_->Set(corpus_id, score_data);
@@ -1721,11 +2194,20 @@ libtextclassifier3::Status DocumentStore::UpdateFilterCache(
 }
 
 libtextclassifier3::Status DocumentStore::ClearDerivedData(
-    DocumentId document_id) {
+    DocumentId document_id, int64_t document_log_bytes) {
   // We intentionally leave the data in key_mapper_ because locating that data
   // requires fetching namespace and uri. Leaving data in key_mapper_ should
   // be fine because the data is hashed.
 
+  // Count the document as deleted. Documents whose record got erased before
+  // the derived files were regenerated don't have a score cache entry.
+  auto score_data_or = score_cache_->Get(document_id);
+  if (score_data_or.ok()) {
+    deleted_document_tokens_ += score_data_or.ValueOrDie()->length_in_tokens();
+  }
+  ++num_deleted_documents_;
+  deleted_document_bytes_ += document_log_bytes;
+
   ICING_RETURN_IF_ERROR(document_id_mapper_->Set(document_id, kDocDeletedFlag));
 
   // Resets the score cache entry
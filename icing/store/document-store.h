@@ -16,13 +16,19 @@
 #define ICING_STORE_DOCUMENT_STORE_H_
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <queue>
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/mutex.h"
+#include "icing/absl_ports/thread_annotations.h"
 #include "icing/file/file-backed-proto-log.h"
 #include "icing/file/file-backed-vector.h"
 #include "icing/file/filesystem.h"
@@ -62,13 +68,23 @@ class DocumentStore {
 
     // Checksum of the DocumentStore's sub-component's checksums.
     uint32_t checksum;
+
+    // Number of deleted documents, the size of their records in the document
+    // log and their number of tokens. Kept so that GetOptimizeInfo doesn't
+    // need to scan the documents.
+    int64_t num_deleted_documents;
+    int64_t deleted_document_bytes;
+    int64_t deleted_document_tokens;
+
+    // Number of tokens of all documents, including deleted ones.
+    int64_t total_document_tokens;
   };
 
   struct OptimizeInfo {
-    // The estimated size in bytes of the optimizable docs. We don't track the
-    // size of each document, so we estimate by taking the size of the entire
-    // DocumentStore and dividing that by the total number of documents we have.
-    // So we end up with an average document size.
+    // The estimated size in bytes of the optimizable docs. The size of the
+    // optimizable docs in the document log is exact. The rest of the
+    // DocumentStore's files are estimated by taking their size and dividing
+    // that by the total number of documents we have.
     int64_t estimated_optimizable_bytes = 0;
 
     // Number of total documents the DocumentStore tracks.
@@ -76,6 +92,11 @@ class DocumentStore {
 
     // Number of optimizable (deleted + expired) docs the DocumentStore tracks.
     int32_t optimizable_docs = 0;
+
+    // Number of tokens of the optimizable docs and of all docs. Their ratio
+    // estimates the share of the index that belongs to optimizable docs.
+    int64_t optimizable_tokens = 0;
+    int64_t total_tokens = 0;
   };
 
   struct DeleteByGroupResult {
@@ -193,6 +214,59 @@ class DocumentStore {
   libtextclassifier3::StatusOr<DocumentProto> Get(
       DocumentId document_id, bool clear_internal_fields = true) const;
 
+  // Same as above, but reads the document into the given one, replacing its
+  // contents. The document is decoded directly on document's arena, if it
+  // has one.
+  //
+  // Returns:
+  //   OK on success
+  //   INVALID_ARGUMENT if document_id is less than 0 or greater than the
+  //                    maximum value
+  //   NOT_FOUND if the document doesn't exist or has been deleted
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status Get(DocumentId document_id,
+                                 DocumentProto* document,
+                                 bool clear_internal_fields = true) const;
+
+  // Reads the documents identified by the given keys (namespace + uri) into
+  // documents, which must hold as many. The documents are read in the order
+  // that they're stored in the log, which is cheaper than calling Get for
+  // each of them.
+  //
+  // Returns:
+  //   The status of getting each document, as Get would return it
+  std::vector<libtextclassifier3::Status> BatchGet(
+      const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+      const std::vector<DocumentProto*>& documents,
+      bool clear_internal_fields = true) const;
+
+  // Same as above, but for the documents with the given ids.
+  std::vector<libtextclassifier3::Status> BatchGet(
+      const std::vector<DocumentId>& document_ids,
+      const std::vector<DocumentProto*>& documents,
+      bool clear_internal_fields = true) const;
+
+  // Returns the ids of the existing documents in name_space whose uris start
+  // with uri_prefix, ordered by uri. Takes time proportional to the number of
+  // matching documents rather than to the number of documents in the store.
+  std::vector<DocumentId> GetDocumentIdsByUriPrefix(
+      std::string_view name_space, std::string_view uri_prefix) const;
+
+  // Finds the next documents of a sequential scan over the store, starting at
+  // *next_document_id and going in DocumentId order, which is also the order
+  // of the documents in the document log. Documents that don't exist or
+  // whose namespace or schema type isn't in the given filters are skipped
+  // without reading the document log. An empty filter allows all namespaces
+  // or schema types.
+  //
+  // Returns the ids of up to max_documents documents, and sets
+  // *next_document_id to where the scan resumes, or to kInvalidDocumentId if
+  // there are no more documents.
+  std::vector<DocumentId> ScanDocumentIds(
+      const std::unordered_set<NamespaceId>& namespace_ids,
+      const std::unordered_set<SchemaTypeId>& schema_type_ids,
+      int max_documents, DocumentId* next_document_id) const;
+
   // Returns all namespaces which have at least 1 active document (not deleted
   // or expired). Order of namespaces is undefined.
   std::vector<std::string> GetAllNamespaces() const;
@@ -265,6 +339,18 @@ class DocumentStore {
   libtextclassifier3::StatusOr<DocumentAssociatedScoreData>
   GetDocumentAssociatedScoreData(DocumentId document_id) const;
 
+  // Sets the length in tokens of a document that was put before it was
+  // tokenized, and updates the total length of its corpus to match. Only the
+  // derived files are updated, so the length is lost again if they have to
+  // be regenerated. Optimize tokenizes such documents again.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if the document doesn't exist
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status SetLengthInTokens(DocumentId document_id,
+                                               int32_t length_in_tokens);
+
   // Returns the CorpusAssociatedScoreData of the corpus specified by the
   // corpus_id.
   //
@@ -333,6 +419,20 @@ class DocumentStore {
   //   INTERNAL_ERROR on IO error
   DeleteByGroupResult DeleteBySchemaType(std::string_view schema_type);
 
+  // Deletes all documents in the given namespace whose uris start with
+  // uri_prefix. The documents will be erased immediately.
+  //
+  // NOTE:
+  //    Space is not reclaimed for deleted documents until Optimize() is
+  //    called.
+  //
+  // Returns:
+  //   OK on success
+  //   NOT_FOUND if there are no such documents
+  //   INTERNAL_ERROR on IO error
+  DeleteByGroupResult DeleteByUriPrefix(std::string_view name_space,
+                                        std::string_view uri_prefix);
+
   // Syncs all the data and metadata changes to disk.
   //
   // Returns:
@@ -340,6 +440,13 @@ class DocumentStore {
   //   INTERNAL on I/O error
   libtextclassifier3::Status PersistToDisk(PersistType::Code persist_type);
 
+  // Drops the memory-mapped pages of the derived files from memory. They are
+  // read back from disk when next accessed.
+  //
+  // Returns:
+  //   The number of bytes that were resident
+  int64_t ReleaseCleanPages();
+
   // Calculates the StorageInfo for the Document Store.
   //
   // If an IO error occurs while trying to calculate the value for a field, then
@@ -409,6 +516,10 @@ class DocumentStore {
   // there are vs how many would be optimized away. And also includes an
   // estimated size gains, in bytes, if Optimize were called.
   //
+  // This doesn't scan the documents. Deleted documents are counted as they
+  // are deleted, and documents are counted as expired once this call finds
+  // their expiration time has passed.
+  //
   // Returns:
   //   OptimizeInfo on success
   //   INTERNAL_ERROR on IO error
@@ -481,11 +592,41 @@ class DocumentStore {
   // DocumentStore. Corpus ids may be removed from the mapper during compaction.
   std::unique_ptr<KeyMapper<CorpusId>> corpus_mapper_;
 
+  // Maps (NamespaceId + uri) to DocumentId. Unlike document_key_mapper_, it
+  // holds the uris themselves, so that documents can be found by uri prefix.
+  std::unique_ptr<KeyMapper<DocumentId>> uri_prefix_mapper_;
+
   // A storage class that caches all usage scores. Usage scores are not
   // considered as ground truth. Usage scores are associated with document ids
   // so they need to be updated when document ids change.
   std::unique_ptr<UsageStore> usage_store_;
 
+  // Counters of the deleted documents, see Header. They're persisted in the
+  // header along with the checksum that they're consistent with.
+  int64_t num_deleted_documents_ = 0;
+  int64_t deleted_document_bytes_ = 0;
+  int64_t deleted_document_tokens_ = 0;
+  int64_t total_document_tokens_ = 0;
+
+  // Documents that will expire, as (expiration timestamp, document id) pairs
+  // with the earliest expiration on top, and the counters of the documents
+  // that have been taken off the queue because they expired. Deleted
+  // documents are dropped as they come up. The queue isn't persisted but
+  // rebuilt by Initialize.
+  struct ExpiryQueue {
+    std::priority_queue<std::pair<int64_t, DocumentId>,
+                        std::vector<std::pair<int64_t, DocumentId>>,
+                        std::greater<std::pair<int64_t, DocumentId>>>
+        documents;
+    int32_t num_expired_documents = 0;
+    int64_t expired_document_bytes = 0;
+    int64_t expired_document_tokens = 0;
+  };
+  // Guards expiry_queue_, which GetOptimizeInfo updates even though it's
+  // const, so concurrent calls are safe.
+  mutable absl_ports::shared_mutex expiry_mutex_;
+  mutable ExpiryQueue expiry_queue_ ICING_GUARDED_BY(expiry_mutex_);
+
   // Used internally to indicate whether the class has been initialized. This is
   // to guard against cases where the object has been created, but Initialize
   // fails in the constructor. If we have successfully exited the constructor,
@@ -586,6 +727,12 @@ class DocumentStore {
   // Returns OK or any IO errors.
   libtextclassifier3::Status ResetCorpusMapper();
 
+  // Resets the unique_ptr to the uri_prefix_mapper, deletes the underlying
+  // file, and re-creates a new instance of the uri_prefix_mapper.
+  //
+  // Returns OK or any IO errors.
+  libtextclassifier3::Status ResetUriPrefixMapper();
+
   // Checks if the header exists already. This does not create the header file
   // if it doesn't exist.
   bool HeaderExists();
@@ -602,6 +749,25 @@ class DocumentStore {
       DocumentProto& document,
       PutDocumentStatsProto* put_document_stats = nullptr);
 
+  // Appends a document of another store to this one by copying its record in
+  // document_log at document_log_offset as is, without parsing it. Its derived
+  // data is rebuilt from score_data and filter_data, the document's data in
+  // the other store's caches, along with its key in the document key mapper,
+  // its namespace and uri, and its key in the corpus mapper.
+  //
+  // Returns:
+  //   A newly generated document id on success
+  //   NOT_FOUND if the document's record has been erased
+  //   RESOURCE_EXHAUSTED if exceeds maximum number of allowed documents
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::StatusOr<DocumentId> InternalCopyDocument(
+      const PortableFileBackedProtoLog<DocumentWrapper>& document_log,
+      int64_t document_log_offset,
+      const DocumentAssociatedScoreData& score_data,
+      const DocumentFilterData& filter_data, std::string_view key,
+      std::string_view name_space, std::string_view uri,
+      std::string_view corpus_key);
+
   // Helper function to do batch deletes. Documents with the given
   // "namespace_id" and "schema_type_id" will be deleted. If callers don't need
   // to specify the namespace or schema type, pass in kInvalidNamespaceId or
@@ -698,8 +864,29 @@ class DocumentStore {
   libtextclassifier3::Status UpdateFilterCache(
       DocumentId document_id, const DocumentFilterData& filter_data);
 
-  // Helper method to clear the derived data of a document
-  libtextclassifier3::Status ClearDerivedData(DocumentId document_id);
+  // Helper method to clear the derived data of a document and count it as
+  // deleted. document_log_bytes is the size of its record in the document log.
+  libtextclassifier3::Status ClearDerivedData(DocumentId document_id,
+                                              int64_t document_log_bytes);
+
+  // Adds document_id to the expiry queue unless it never expires.
+  void AddToExpiryQueue(DocumentId document_id,
+                        int64_t expiration_timestamp_ms);
+
+  // Rebuilds the expiry queue from the filter cache.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status InitializeExpiryQueue();
+
+  // Takes the documents whose expiration time has passed off the expiry queue
+  // and counts the ones that haven't been deleted as expired.
+  //
+  // Returns:
+  //   OK on success
+  //   INTERNAL_ERROR on IO error
+  libtextclassifier3::Status CountExpiredDocuments() const;
 
   // Sets usage scores for the given document.
   libtextclassifier3::Status SetUsageScores(
@@ -19,10 +19,13 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include <google/protobuf/arena.h>
 #include "icing/absl_ports/str_cat.h"
 #include "icing/document-builder.h"
 #include "icing/file/file-backed-vector.h"
@@ -59,6 +62,7 @@ namespace {
 
 using ::icing::lib::portable_equals_proto::EqualsProto;
 using ::testing::_;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Ge;
 using ::testing::Gt;
@@ -68,6 +72,7 @@ using ::testing::IsFalse;
 using ::testing::IsTrue;
 using ::testing::Not;
 using ::testing::Return;
+using ::testing::SizeIs;
 using ::testing::UnorderedElementsAre;
 
 const NamespaceStorageInfoProto& GetNamespaceStorageInfo(
@@ -283,6 +288,69 @@ TEST_F(DocumentStoreTest, PutAndGetInSameNamespaceOk) {
               IsOkAndHolds(EqualsProto(test_document2_)));
 }
 
+TEST_F(DocumentStoreTest, GetIntoArenaMessageOk) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id,
+                             doc_store->Put(test_document1_));
+
+  google::protobuf::Arena arena;
+  DocumentProto* document =
+      google::protobuf::Arena::CreateMessage<DocumentProto>(&arena);
+  ICING_ASSERT_OK(doc_store->Get(document_id, document));
+  EXPECT_THAT(*document, EqualsProto(test_document1_));
+  EXPECT_THAT(document->GetArena(), Eq(&arena));
+
+  // Works without an arena too.
+  DocumentProto heap_document;
+  ICING_ASSERT_OK(doc_store->Get(document_id, &heap_document));
+  EXPECT_THAT(heap_document, EqualsProto(test_document1_));
+
+  EXPECT_THAT(doc_store->Get(document_id + 1, document),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST_F(DocumentStoreTest, BatchGetOk) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  ICING_ASSERT_OK(doc_store->Put(test_document1_).status());
+  ICING_ASSERT_OK(doc_store->Put(test_document2_).status());
+  ICING_ASSERT_OK(doc_store->Delete("icing", "email/1"));
+
+  google::protobuf::Arena arena;
+  DocumentProto heap_document;
+  DocumentProto deleted_document;
+  DocumentProto nonexistent_document;
+  DocumentProto* arena_document =
+      google::protobuf::Arena::CreateMessage<DocumentProto>(&arena);
+  std::vector<libtextclassifier3::Status> statuses = doc_store->BatchGet(
+      {{"icing", "email/2"},
+       {"icing", "email/1"},
+       {"icing", "nonexistent"},
+       {"icing", "email/2"}},
+      {&heap_document, &deleted_document, &nonexistent_document,
+       arena_document});
+  ASSERT_THAT(statuses, SizeIs(4));
+  ICING_EXPECT_OK(statuses[0]);
+  EXPECT_THAT(heap_document, EqualsProto(test_document2_));
+  EXPECT_THAT(statuses[1],
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(statuses[2],
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_EXPECT_OK(statuses[3]);
+  EXPECT_THAT(*arena_document, EqualsProto(test_document2_));
+}
+
 TEST_F(DocumentStoreTest, PutAndGetAcrossNamespacesOk) {
   ICING_ASSERT_OK_AND_ASSIGN(
       DocumentStore::CreateResult create_result,
@@ -664,6 +732,197 @@ TEST_F(DocumentStoreTest, DeleteByNamespaceRecoversOk) {
               StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
 }
 
+TEST_F(DocumentStoreTest, GetDocumentIdsByUriPrefix) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  DocumentProto document1 = test_document1_;
+  document1.set_uri("thread/1/b");
+  DocumentProto document2 = test_document1_;
+  document2.set_uri("thread/1/a");
+  DocumentProto document3 = test_document1_;
+  document3.set_uri("thread/2/a");
+  DocumentProto document4 = test_document1_;
+  document4.set_namespace_("other_namespace");
+  document4.set_uri("thread/1/a");
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id1,
+                             doc_store->Put(document1));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id2,
+                             doc_store->Put(document2));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id3,
+                             doc_store->Put(document3));
+  ICING_ASSERT_OK(doc_store->Put(document4));
+
+  // Documents are ordered by uri.
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("icing", "thread/1/"),
+              ElementsAre(document_id2, document_id1));
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("icing", "thread/"),
+              ElementsAre(document_id2, document_id1, document_id3));
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("icing", "thread/3/"),
+              IsEmpty());
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("nonexistent", "thread/"),
+              IsEmpty());
+
+  // Replaced and deleted documents aren't returned.
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId new_document_id1,
+                             doc_store->Put(document1));
+  ICING_ASSERT_OK(doc_store->Delete(document_id2));
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("icing", "thread/1/"),
+              ElementsAre(new_document_id1));
+
+  // The ids can be used to fetch the documents.
+  std::vector<DocumentId> document_ids =
+      doc_store->GetDocumentIdsByUriPrefix("icing", "thread/");
+  DocumentProto fetched_document1;
+  DocumentProto fetched_document3;
+  std::vector<libtextclassifier3::Status> statuses = doc_store->BatchGet(
+      document_ids, {&fetched_document1, &fetched_document3});
+  ASSERT_THAT(statuses, SizeIs(2));
+  ICING_EXPECT_OK(statuses[0]);
+  EXPECT_THAT(fetched_document1, EqualsProto(document1));
+  ICING_EXPECT_OK(statuses[1]);
+  EXPECT_THAT(fetched_document3, EqualsProto(document3));
+}
+
+TEST_F(DocumentStoreTest, DeleteByUriPrefixOk) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  DocumentProto document1 = test_document1_;
+  document1.set_uri("thread/1/a");
+  DocumentProto document2 = test_document1_;
+  document2.set_uri("thread/1/b");
+  DocumentProto document3 = test_document1_;
+  document3.set_uri("thread/2/a");
+  DocumentProto document4 = test_document1_;
+  document4.set_namespace_("other_namespace");
+  document4.set_uri("thread/1/a");
+  ICING_ASSERT_OK(doc_store->Put(document1));
+  ICING_ASSERT_OK(doc_store->Put(document2));
+  ICING_ASSERT_OK(doc_store->Put(document3));
+  ICING_ASSERT_OK(doc_store->Put(document4));
+
+  DocumentStore::DeleteByGroupResult group_result =
+      doc_store->DeleteByUriPrefix("icing", "thread/1/");
+  EXPECT_THAT(group_result.status, IsOk());
+  EXPECT_THAT(group_result.num_docs_deleted, Eq(2));
+  EXPECT_THAT(doc_store->Get(document1.namespace_(), document1.uri()),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(doc_store->Get(document2.namespace_(), document2.uri()),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(doc_store->Get(document3.namespace_(), document3.uri()),
+              IsOkAndHolds(EqualsProto(document3)));
+  EXPECT_THAT(doc_store->Get(document4.namespace_(), document4.uri()),
+              IsOkAndHolds(EqualsProto(document4)));
+
+  // Nothing is left to delete under the prefix.
+  EXPECT_THAT(doc_store->DeleteByUriPrefix("icing", "thread/1/").status,
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  EXPECT_THAT(doc_store->DeleteByUriPrefix("nonexistent", "thread/").status,
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
+TEST_F(DocumentStoreTest, GetDocumentIdsByUriPrefixRecoversOk) {
+  DocumentProto document1 = test_document1_;
+  document1.set_uri("thread/1/a");
+  DocumentProto document2 = test_document1_;
+  document2.set_uri("thread/1/b");
+  DocumentProto document3 = test_document1_;
+  document3.set_uri("thread/2/a");
+
+  DocumentId document_id2;
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::CreateResult create_result,
+        DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                              schema_store_.get()));
+    std::unique_ptr<DocumentStore> doc_store =
+        std::move(create_result.document_store);
+
+    ICING_ASSERT_OK(doc_store->Put(document1));
+    ICING_ASSERT_OK_AND_ASSIGN(document_id2, doc_store->Put(document2));
+    ICING_ASSERT_OK(doc_store->Put(document3));
+    ICING_ASSERT_OK(doc_store->Delete(document1.namespace_(), document1.uri()));
+  }  // Destructors should update checksum and persist all data to file.
+
+  CorruptDocStoreHeaderChecksumFile();
+  // The uri prefixes are regenerated along with the other derived files.
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+  EXPECT_THAT(doc_store->GetDocumentIdsByUriPrefix("icing", "thread/1/"),
+              ElementsAre(document_id2));
+}
+
+TEST_F(DocumentStoreTest, ScanDocumentIds) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  DocumentProto document3 = test_document1_;
+  document3.set_namespace_("other_namespace");
+  DocumentProto document4 = test_document1_;
+  document4.set_uri("email/4");
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id1,
+                             doc_store->Put(test_document1_));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id2,
+                             doc_store->Put(test_document2_));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id3,
+                             doc_store->Put(document3));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id4,
+                             doc_store->Put(document4));
+  ICING_ASSERT_OK(doc_store->Delete(document_id2));
+
+  // Pages skip the deleted document.
+  DocumentId next_document_id = 0;
+  EXPECT_THAT(doc_store->ScanDocumentIds(/*namespace_ids=*/{},
+                                         /*schema_type_ids=*/{},
+                                         /*max_documents=*/2,
+                                         &next_document_id),
+              ElementsAre(document_id1, document_id3));
+  EXPECT_THAT(next_document_id, Eq(document_id3 + 1));
+  EXPECT_THAT(doc_store->ScanDocumentIds(/*namespace_ids=*/{},
+                                         /*schema_type_ids=*/{},
+                                         /*max_documents=*/2,
+                                         &next_document_id),
+              ElementsAre(document_id4));
+  EXPECT_THAT(next_document_id, Eq(kInvalidDocumentId));
+
+  // Documents of other namespaces are skipped.
+  ICING_ASSERT_OK_AND_ASSIGN(NamespaceId namespace_id,
+                             doc_store->GetNamespaceId("icing"));
+  ICING_ASSERT_OK_AND_ASSIGN(SchemaTypeId schema_type_id,
+                             schema_store_->GetSchemaTypeId("email"));
+  next_document_id = 0;
+  EXPECT_THAT(doc_store->ScanDocumentIds({namespace_id}, {schema_type_id},
+                                         /*max_documents=*/10,
+                                         &next_document_id),
+              ElementsAre(document_id1, document_id4));
+  EXPECT_THAT(next_document_id, Eq(kInvalidDocumentId));
+
+  // Scanning past the end finds nothing.
+  EXPECT_THAT(doc_store->ScanDocumentIds(/*namespace_ids=*/{},
+                                         /*schema_type_ids=*/{},
+                                         /*max_documents=*/10,
+                                         &next_document_id),
+              IsEmpty());
+  EXPECT_THAT(next_document_id, Eq(kInvalidDocumentId));
+}
+
 TEST_F(DocumentStoreTest, DeleteBySchemaTypeOk) {
   SchemaProto schema =
       SchemaBuilder()
@@ -1062,6 +1321,122 @@ TEST_F(DocumentStoreTest, OptimizeInto) {
   EXPECT_THAT(optimized_size2, Gt(optimized_size3));
 }
 
+TEST_F(DocumentStoreTest, OptimizeIntoCopiesDocumentsAndDerivedData) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  DocumentProto document1 = DocumentBuilder()
+                                .SetKey("namespace1", "uri1")
+                                .SetSchema("email")
+                                .SetScore(1)
+                                .SetCreationTimestampMs(100)
+                                .SetTtlMs(1000)
+                                .Build();
+  DocumentProto document2 = DocumentBuilder()
+                                .SetKey("namespace2", "uri2")
+                                .SetSchema("email")
+                                .SetScore(2)
+                                .SetCreationTimestampMs(200)
+                                .SetTtlMs(1000)
+                                .Build();
+  DocumentProto document3 = DocumentBuilder()
+                                .SetKey("namespace3", "uri3")
+                                .SetSchema("email")
+                                .SetScore(3)
+                                .SetCreationTimestampMs(300)
+                                .Build();
+  fake_clock_.SetSystemTimeMilliseconds(300);
+  ICING_ASSERT_OK(doc_store->Put(document1, /*num_tokens=*/4));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id2,
+                             doc_store->Put(document2, /*num_tokens=*/5));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id3,
+                             doc_store->Put(document3, /*num_tokens=*/6));
+  ICING_ASSERT_OK(doc_store->ReportUsage(CreateUsageReport(
+      "namespace3", "uri3", /*timestamp_ms=*/0, UsageReport::USAGE_TYPE1)));
+  // Deleting document1 leaves namespace1 without documents, so the other
+  // namespaces get new namespace ids.
+  ICING_ASSERT_OK(doc_store->Delete("namespace1", "uri1"));
+
+  std::string optimized_dir = document_store_dir_ + "_optimize";
+  ASSERT_TRUE(filesystem_.DeleteDirectoryRecursively(optimized_dir.c_str()));
+  ASSERT_TRUE(filesystem_.CreateDirectoryRecursively(optimized_dir.c_str()));
+  ICING_ASSERT_OK(
+      doc_store->OptimizeInto(optimized_dir, lang_segmenter_.get()));
+
+  ICING_ASSERT_OK_AND_ASSIGN(
+      create_result, DocumentStore::Create(&filesystem_, optimized_dir,
+                                           &fake_clock_, schema_store_.get()));
+  std::unique_ptr<DocumentStore> optimized_doc_store =
+      std::move(create_result.document_store);
+  EXPECT_THAT(optimized_doc_store->Get("namespace2", "uri2"),
+              IsOkAndHolds(EqualsProto(document2)));
+  EXPECT_THAT(optimized_doc_store->Get("namespace3", "uri3"),
+              IsOkAndHolds(EqualsProto(document3)));
+  EXPECT_THAT(optimized_doc_store->GetDocumentIdsByUriPrefix("namespace3",
+                                                             "uri"),
+              ElementsAre(1));
+
+  for (auto [document_id, new_document_id, name_space] :
+       std::vector<std::tuple<DocumentId, DocumentId, std::string>>{
+           {document_id2, 0, "namespace2"}, {document_id3, 1, "namespace3"}}) {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentAssociatedScoreData score_data,
+        doc_store->GetDocumentAssociatedScoreData(document_id));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentAssociatedScoreData new_score_data,
+        optimized_doc_store->GetDocumentAssociatedScoreData(new_document_id));
+    EXPECT_THAT(new_score_data.document_score(),
+                Eq(score_data.document_score()));
+    EXPECT_THAT(new_score_data.creation_timestamp_ms(),
+                Eq(score_data.creation_timestamp_ms()));
+    EXPECT_THAT(new_score_data.length_in_tokens(),
+                Eq(score_data.length_in_tokens()));
+    EXPECT_THAT(optimized_doc_store->GetCorpusId(name_space, "email"),
+                IsOkAndHolds(new_score_data.corpus_id()));
+    EXPECT_THAT(
+        optimized_doc_store->GetCorpusAssociatedScoreData(
+            new_score_data.corpus_id()),
+        IsOkAndHolds(CorpusAssociatedScoreData(
+            /*num_docs=*/1,
+            /*sum_length_in_tokens=*/score_data.length_in_tokens())));
+
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentFilterData filter_data,
+        doc_store->GetDocumentFilterData(document_id));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentFilterData new_filter_data,
+        optimized_doc_store->GetDocumentFilterData(new_document_id));
+    EXPECT_THAT(optimized_doc_store->GetNamespaceId(name_space),
+                IsOkAndHolds(new_filter_data.namespace_id()));
+    EXPECT_THAT(new_filter_data.schema_type_id(),
+                Eq(filter_data.schema_type_id()));
+    EXPECT_THAT(new_filter_data.expiration_timestamp_ms(),
+                Eq(filter_data.expiration_timestamp_ms()));
+  }
+  EXPECT_THAT(optimized_doc_store->GetUsageScores(/*document_id=*/1),
+              IsOkAndHolds(doc_store->GetUsageScores(document_id3)
+                               .ValueOrDie()));
+
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentStore::OptimizeInfo optimize_info,
+                             optimized_doc_store->GetOptimizeInfo());
+  EXPECT_THAT(optimize_info.total_docs, Eq(2));
+  EXPECT_THAT(optimize_info.optimizable_docs, Eq(0));
+  EXPECT_THAT(optimize_info.total_tokens, Eq(11));
+
+  // Documents expire in the optimized document store as they would have in
+  // the original one.
+  fake_clock_.SetSystemTimeMilliseconds(1200);
+  EXPECT_THAT(optimized_doc_store->Get("namespace2", "uri2"),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_ASSERT_OK_AND_ASSIGN(optimize_info,
+                             optimized_doc_store->GetOptimizeInfo());
+  EXPECT_THAT(optimize_info.optimizable_docs, Eq(1));
+}
+
 TEST_F(DocumentStoreTest, ShouldRecoverFromDataLoss) {
   DocumentId document_id1, document_id2;
   {
@@ -1684,6 +2059,52 @@ TEST_F(DocumentStoreTest, GetDocumentAssociatedScoreDataDifferentCorpus) {
           /*length_in_tokens=*/7)));
 }
 
+TEST_F(DocumentStoreTest, SetLengthInTokensUpdatesScoreData) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> doc_store =
+      std::move(create_result.document_store);
+
+  DocumentProto document1 =
+      DocumentBuilder()
+          .SetKey("namespace", "1")
+          .SetSchema("email")
+          .SetScore(document1_score_)
+          .SetCreationTimestampMs(document1_creation_timestamp_)
+          .Build();
+  DocumentProto document2 =
+      DocumentBuilder().SetKey("namespace", "2").SetSchema("email").Build();
+
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentId document_id1,
+                             doc_store->Put(document1, /*num_tokens=*/0));
+  ICING_ASSERT_OK(doc_store->Put(document2, /*num_tokens=*/7));
+
+  ICING_EXPECT_OK(
+      doc_store->SetLengthInTokens(document_id1, /*length_in_tokens=*/5));
+  EXPECT_THAT(
+      doc_store->GetDocumentAssociatedScoreData(document_id1),
+      IsOkAndHolds(DocumentAssociatedScoreData(
+          /*corpus_id=*/0, document1_score_, document1_creation_timestamp_,
+          /*length_in_tokens=*/5)));
+  EXPECT_THAT(doc_store->GetCorpusAssociatedScoreData(/*corpus_id=*/0),
+              IsOkAndHolds(CorpusAssociatedScoreData(
+                  /*num_docs=*/2, /*sum_length_in_tokens=*/12)));
+
+  // Setting the same length again changes nothing.
+  ICING_EXPECT_OK(
+      doc_store->SetLengthInTokens(document_id1, /*length_in_tokens=*/5));
+  EXPECT_THAT(doc_store->GetCorpusAssociatedScoreData(/*corpus_id=*/0),
+              IsOkAndHolds(CorpusAssociatedScoreData(
+                  /*num_docs=*/2, /*sum_length_in_tokens=*/12)));
+
+  ICING_ASSERT_OK(doc_store->Delete("namespace", "1"));
+  EXPECT_THAT(
+      doc_store->SetLengthInTokens(document_id1, /*length_in_tokens=*/3),
+      StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+}
+
 TEST_F(DocumentStoreTest, NonexistentDocumentAssociatedScoreDataNotFound) {
   ICING_ASSERT_OK_AND_ASSIGN(
       DocumentStore::CreateResult create_result,
@@ -2702,6 +3123,111 @@ TEST_F(DocumentStoreTest, GetOptimizeInfo) {
   EXPECT_THAT(optimize_info.estimated_optimizable_bytes, Eq(0));
 }
 
+TEST_F(DocumentStoreTest, GetOptimizeInfoCountsExpiredDocuments) {
+  DocumentProto document = DocumentBuilder()
+                               .SetKey("namespace", "uri")
+                               .SetSchema("email")
+                               .SetCreationTimestampMs(10)
+                               .SetTtlMs(100)
+                               .Build();
+  ICING_ASSERT_OK_AND_ASSIGN(
+      DocumentStore::CreateResult create_result,
+      DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                            schema_store_.get()));
+  std::unique_ptr<DocumentStore> document_store =
+      std::move(create_result.document_store);
+  fake_clock_.SetSystemTimeMilliseconds(50);
+  ICING_EXPECT_OK(document_store->Put(document, /*num_tokens=*/7));
+  ICING_EXPECT_OK(
+      document_store->Put(DocumentProto(test_document1_), /*num_tokens=*/3));
+
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentStore::OptimizeInfo optimize_info,
+                             document_store->GetOptimizeInfo());
+  EXPECT_THAT(optimize_info.optimizable_docs, Eq(0));
+  EXPECT_THAT(optimize_info.optimizable_tokens, Eq(0));
+  EXPECT_THAT(optimize_info.total_tokens, Eq(10));
+
+  // The document expires at its creation time (10) + ttl (100).
+  fake_clock_.SetSystemTimeMilliseconds(110);
+  ICING_ASSERT_OK_AND_ASSIGN(optimize_info, document_store->GetOptimizeInfo());
+  EXPECT_THAT(optimize_info.total_docs, Eq(2));
+  EXPECT_THAT(optimize_info.optimizable_docs, Eq(1));
+  EXPECT_THAT(optimize_info.optimizable_tokens, Eq(7));
+  EXPECT_THAT(optimize_info.estimated_optimizable_bytes, Gt(0));
+
+  // Expired documents can't be deleted, so they're only counted once.
+  EXPECT_THAT(document_store->Delete("namespace", "uri"),
+              StatusIs(libtextclassifier3::StatusCode::NOT_FOUND));
+  ICING_ASSERT_OK_AND_ASSIGN(DocumentStore::OptimizeInfo optimize_info2,
+                             document_store->GetOptimizeInfo());
+  EXPECT_THAT(optimize_info2.optimizable_docs, Eq(1));
+  EXPECT_THAT(optimize_info2.estimated_optimizable_bytes,
+              Eq(optimize_info.estimated_optimizable_bytes));
+}
+
+TEST_F(DocumentStoreTest, GetOptimizeInfoIsConsistentAcrossInitialization) {
+  DocumentStore::OptimizeInfo expected_optimize_info;
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::CreateResult create_result,
+        DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                              schema_store_.get()));
+    std::unique_ptr<DocumentStore> document_store =
+        std::move(create_result.document_store);
+    ICING_EXPECT_OK(
+        document_store->Put(DocumentProto(test_document1_), /*num_tokens=*/4));
+    ICING_EXPECT_OK(
+        document_store->Put(DocumentProto(test_document2_), /*num_tokens=*/6));
+    // Replacing a document deletes the old one.
+    ICING_EXPECT_OK(
+        document_store->Put(DocumentProto(test_document1_), /*num_tokens=*/5));
+    ICING_ASSERT_OK_AND_ASSIGN(expected_optimize_info,
+                               document_store->GetOptimizeInfo());
+    EXPECT_THAT(expected_optimize_info.total_docs, Eq(3));
+    EXPECT_THAT(expected_optimize_info.optimizable_docs, Eq(1));
+    EXPECT_THAT(expected_optimize_info.optimizable_tokens, Eq(4));
+    EXPECT_THAT(expected_optimize_info.total_tokens, Eq(15));
+  }
+
+  // The counters are read back from the header.
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::CreateResult create_result,
+        DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                              schema_store_.get()));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::OptimizeInfo optimize_info,
+        create_result.document_store->GetOptimizeInfo());
+    EXPECT_THAT(optimize_info.optimizable_docs,
+                Eq(expected_optimize_info.optimizable_docs));
+    EXPECT_THAT(optimize_info.optimizable_tokens,
+                Eq(expected_optimize_info.optimizable_tokens));
+    EXPECT_THAT(optimize_info.total_tokens,
+                Eq(expected_optimize_info.total_tokens));
+    EXPECT_THAT(optimize_info.estimated_optimizable_bytes,
+                Eq(expected_optimize_info.estimated_optimizable_bytes));
+  }
+
+  // Regenerating the derived files counts the same erased document, but its
+  // tokens are gone with its record.
+  CorruptDocStoreHeaderChecksumFile();
+  {
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::CreateResult create_result,
+        DocumentStore::Create(&filesystem_, document_store_dir_, &fake_clock_,
+                              schema_store_.get()));
+    ICING_ASSERT_OK_AND_ASSIGN(
+        DocumentStore::OptimizeInfo optimize_info,
+        create_result.document_store->GetOptimizeInfo());
+    EXPECT_THAT(optimize_info.optimizable_docs,
+                Eq(expected_optimize_info.optimizable_docs));
+    EXPECT_THAT(optimize_info.optimizable_tokens, Eq(0));
+    EXPECT_THAT(optimize_info.total_tokens, Eq(11));
+    EXPECT_THAT(optimize_info.estimated_optimizable_bytes,
+                Eq(expected_optimize_info.estimated_optimizable_bytes));
+  }
+}
+
 TEST_F(DocumentStoreTest, GetAllNamespaces) {
   ICING_ASSERT_OK_AND_ASSIGN(
       DocumentStore::CreateResult create_result,
@@ -21,14 +21,18 @@
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/status.h"
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/absl_ports/canonical_errors.h"
 #include "icing/absl_ports/str_cat.h"
 #include "icing/file/filesystem.h"
+#include "icing/file/in-memory-file-tree.h"
 #include "icing/legacy/index/icing-dynamic-trie.h"
 #include "icing/legacy/index/icing-filesystem.h"
+#include "icing/legacy/index/icing-in-memory-filesystem.h"
 #include "icing/util/crc32.h"
 #include "icing/util/status-macros.h"
 
@@ -90,6 +94,10 @@ class KeyMapper {
   // Returns a map of values to keys. Empty map if the mapper is empty.
   std::unordered_map<T, std::string> GetValuesToKeys() const;
 
+  // Returns the values of all keys that start with prefix, ordered by key.
+  // Takes time proportional to the number of matching keys.
+  std::vector<T> GetValuesWithKeyPrefix(std::string_view prefix) const;
+
   // Count of unique keys stored in the KeyMapper.
   int32_t num_keys() const { return trie_.size(); }
 
@@ -125,12 +133,18 @@ class KeyMapper {
   // Computes and returns the checksum of the header and contents.
   Crc32 ComputeChecksum();
 
+  // Drops the mapped pages of the key mapper from memory. They are read back
+  // from disk when next accessed. Returns the number of bytes that were
+  // resident.
+  int64_t ReleaseCleanPages() { return trie_.ReleaseCleanPages(); }
+
  private:
   static constexpr char kKeyMapperDir[] = "key_mapper_dir";
   static constexpr char kKeyMapperPrefix[] = "key_mapper";
 
   // Use KeyMapper::Create() to instantiate.
-  explicit KeyMapper(std::string_view key_mapper_dir);
+  KeyMapper(std::string_view key_mapper_dir,
+            std::unique_ptr<const IcingFilesystem> icing_filesystem);
 
   // Load any existing KeyMapper data from disk, or creates a new instance
   // of KeyMapper on disk and gets ready to process read/write operations.
@@ -146,7 +160,7 @@ class KeyMapper {
   // to have a single definition across both namespaces. Such a class should
   // use icing (and general google3) coding conventions and behave like
   // a proper C++ class.
-  const IcingFilesystem icing_filesystem_;
+  const std::unique_ptr<const IcingFilesystem> icing_filesystem_;
   IcingDynamicTrie trie_;
 
   static_assert(std::is_trivially_copyable<T>::value,
@@ -166,7 +180,17 @@ KeyMapper<T>::Create(const Filesystem& filesystem, std::string_view base_dir,
     return absl_ports::InternalError(absl_ports::StrCat(
         "Failed to create KeyMapper directory: ", key_mapper_dir));
   }
-  auto mapper = std::unique_ptr<KeyMapper<T>>(new KeyMapper<T>(key_mapper_dir));
+  // The trie must see the same files as filesystem, which may not be on disk.
+  std::shared_ptr<InMemoryFileTree> file_tree =
+      filesystem.GetInMemoryFileTree();
+  std::unique_ptr<const IcingFilesystem> icing_filesystem;
+  if (file_tree != nullptr) {
+    icing_filesystem = std::make_unique<IcingInMemoryFilesystem>(file_tree);
+  } else {
+    icing_filesystem = std::make_unique<IcingFilesystem>();
+  }
+  auto mapper = std::unique_ptr<KeyMapper<T>>(
+      new KeyMapper<T>(key_mapper_dir, std::move(icing_filesystem)));
   ICING_RETURN_IF_ERROR(mapper->Initialize(maximum_size_bytes));
   return mapper;
 }
@@ -183,12 +207,15 @@ libtextclassifier3::Status KeyMapper<T>::Delete(const Filesystem& filesystem,
 }
 
 template <typename T>
-KeyMapper<T>::KeyMapper(std::string_view key_mapper_dir)
+KeyMapper<T>::KeyMapper(
+    std::string_view key_mapper_dir,
+    std::unique_ptr<const IcingFilesystem> icing_filesystem)
     : file_prefix_(absl_ports::StrCat(key_mapper_dir, "/", kKeyMapperPrefix)),
+      icing_filesystem_(std::move(icing_filesystem)),
       trie_(file_prefix_,
             IcingDynamicTrie::RuntimeOptions().set_storage_policy(
                 IcingDynamicTrie::RuntimeOptions::kMapSharedWithCrc),
-            &icing_filesystem_) {}
+            icing_filesystem_.get()) {}
 
 template <typename T>
 libtextclassifier3::Status KeyMapper<T>::Initialize(int maximum_size_bytes) {
@@ -277,6 +304,20 @@ std::unordered_map<T, std::string> KeyMapper<T>::GetValuesToKeys() const {
   return values_to_keys;
 }
 
+template <typename T>
+std::vector<T> KeyMapper<T>::GetValuesWithKeyPrefix(
+    std::string_view prefix) const {
+  std::vector<T> values;
+  std::string string_prefix(prefix);
+  for (IcingDynamicTrie::Iterator itr(trie_, string_prefix.c_str());
+       itr.IsValid(); itr.Advance()) {
+    T value;
+    memcpy(&value, itr.GetValue(), sizeof(T));
+    values.push_back(value);
+  }
+  return values;
+}
+
 template <typename T>
 libtextclassifier3::Status KeyMapper<T>::PersistToDisk() {
   if (!trie_.Sync()) {
@@ -21,6 +21,7 @@
 #include "icing/testing/tmp-directory.h"
 
 using ::testing::_;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::Pair;
@@ -183,6 +184,27 @@ TEST_F(KeyMapperTest, GetValuesToKeys) {
       UnorderedElementsAre(Pair(1, "foo"), Pair(2, "bar"), Pair(3, "baz")));
 }
 
+TEST_F(KeyMapperTest, GetValuesWithKeyPrefix) {
+  ICING_ASSERT_OK_AND_ASSIGN(
+      std::unique_ptr<KeyMapper<DocumentId>> key_mapper,
+      KeyMapper<DocumentId>::Create(filesystem_, base_dir_, kMaxKeyMapperSize));
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix("foo"), IsEmpty());
+
+  ICING_EXPECT_OK(key_mapper->Put("foo/2", /*value=*/1));
+  ICING_EXPECT_OK(key_mapper->Put("foo/1", /*value=*/2));
+  ICING_EXPECT_OK(key_mapper->Put("foobar", /*value=*/3));
+  ICING_EXPECT_OK(key_mapper->Put("fo", /*value=*/4));
+  ICING_EXPECT_OK(key_mapper->Put("bar", /*value=*/5));
+
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix("foo/"), ElementsAre(2, 1));
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix("foo"),
+              ElementsAre(2, 1, 3));
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix("foobar"), ElementsAre(3));
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix(""),
+              UnorderedElementsAre(1, 2, 3, 4, 5));
+  EXPECT_THAT(key_mapper->GetValuesWithKeyPrefix("foo/3"), IsEmpty());
+}
+
 }  // namespace
 }  // namespace lib
 }  // namespace icing
@@ -165,6 +165,12 @@ class UsageStore {
   //   INTERNAL_ERROR on IO error
   libtextclassifier3::StatusOr<int64_t> GetDiskUsage() const;
 
+  // Drops the mapped usage scores from memory. They are read back from disk
+  // when next accessed. Returns the number of bytes that were resident.
+  int64_t ReleaseCleanPages() {
+    return usage_score_cache_->ReleaseCleanPages();
+  }
+
   // Resizes the storage so that only the usage scores of and before
   // last_document_id are stored.
   //
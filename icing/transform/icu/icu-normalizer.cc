@@ -15,10 +15,13 @@
 #include "icing/transform/icu/icu-normalizer.h"
 
 #include <cctype>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
 #include "icing/absl_ports/canonical_errors.h"
@@ -27,8 +30,12 @@
 #include "icing/util/i18n-utils.h"
 #include "icing/util/logging.h"
 #include "icing/util/status-macros.h"
+#include "unicode/uchar.h"
 #include "unicode/umachine.h"
 #include "unicode/unorm2.h"
+#include "unicode/uscript.h"
+#include "unicode/utf16.h"
+#include "unicode/utf8.h"
 #include "unicode/utrans.h"
 
 namespace icing {
@@ -96,6 +103,65 @@ bool DiacriticCharToAscii(const UNormalizer2* normalizer2, UChar32 uchar32_in,
   return false;
 }
 
+// Returns true if the transform rules are known to leave the term unchanged,
+// so that it can skip the UTF16 round-trip and transliteration entirely.
+//
+// This is conservative. It only accepts characters that:
+//   1. belong to a specific script that none of the script-specific rules
+//      (Latin-ASCII, Hiragana-Katakana, [:Latin:] NFD) apply to,
+//   2. are not changed by lowercasing and are not nonspacing marks,
+//   3. are NFKC-normalized on their own and never combine with a preceding
+//      character, so that the whole term is NFKC-normalized as well.
+// E.g. most CJK, Hangul, Katakana and lowercase Cyrillic or Greek terms.
+bool IsAlreadyNormalized(std::string_view term) {
+  UErrorCode status = U_ZERO_ERROR;
+  // ICU manages the singleton instance
+  const UNormalizer2* nfkc_normalizer = unorm2_getNFKCInstance(&status);
+  if (U_FAILURE(status)) {
+    return false;
+  }
+
+  const uint8_t* utf8 = reinterpret_cast<const uint8_t*>(term.data());
+  int32_t length = term.length();
+  int32_t i = 0;
+  while (i < length) {
+    UChar32 uchar32;
+    U8_NEXT(utf8, i, length, uchar32);
+    if (uchar32 < 0) {
+      return false;
+    }
+
+    switch (uscript_getScript(uchar32, &status)) {
+      case USCRIPT_COMMON:
+      case USCRIPT_INHERITED:
+      case USCRIPT_UNKNOWN:
+      case USCRIPT_LATIN:
+      case USCRIPT_HIRAGANA:
+        return false;
+      default:
+        break;
+    }
+    if (U_FAILURE(status) ||
+        u_hasBinaryProperty(uchar32, UCHAR_CHANGES_WHEN_LOWERCASED) ||
+        u_charType(uchar32) == U_NON_SPACING_MARK ||
+        !unorm2_hasBoundaryBefore(nfkc_normalizer, uchar32)) {
+      return false;
+    }
+
+    UChar utf16[U16_MAX_LENGTH];
+    int32_t utf16_length = 0;
+    UBool is_error = false;
+    U16_APPEND(utf16, utf16_length, U16_MAX_LENGTH, uchar32, is_error);
+    if (is_error ||
+        unorm2_quickCheck(nfkc_normalizer, utf16, utf16_length, &status) !=
+            UNORM_YES ||
+        U_FAILURE(status)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 // Creates a IcuNormalizer with a valid TermTransformer instance.
@@ -153,6 +219,10 @@ std::string IcuNormalizer::NormalizeTerm(const std::string_view term) const {
   return normalized_text;
 }
 
+int64_t IcuNormalizer::ReleaseCaches() const {
+  return term_transformer_->ReleaseCaches();
+}
+
 std::string IcuNormalizer::NormalizeLatin(const UNormalizer2* normalizer2,
                                           const std::string_view term) const {
   std::string result;
@@ -202,16 +272,106 @@ IcuNormalizer::TermTransformer::Create() {
 
 IcuNormalizer::TermTransformer::TermTransformer(
     UTransliterator* u_transliterator)
-    : u_transliterator_(u_transliterator) {}
+    : prototype_transliterator_(u_transliterator) {}
 
 IcuNormalizer::TermTransformer::~TermTransformer() {
-  if (u_transliterator_ != nullptr) {
-    utrans_close(u_transliterator_);
+  for (UTransliterator* u_transliterator : idle_transliterators_) {
+    utrans_close(u_transliterator);
+  }
+  if (prototype_transliterator_ != nullptr) {
+    utrans_close(prototype_transliterator_);
+  }
+}
+
+int64_t IcuNormalizer::TermTransformer::ReleaseCaches() const {
+  std::unordered_map<std::string, std::string> transform_cache;
+  std::vector<UTransliterator*> idle_transliterators;
+  {
+    absl_ports::unique_lock l(&mutex_);
+    transform_cache.swap(transform_cache_);
+    idle_transliterators.swap(idle_transliterators_);
+  }
+  for (UTransliterator* u_transliterator : idle_transliterators) {
+    utrans_close(u_transliterator);
+  }
+  int64_t released_bytes = 0;
+  for (const auto& [term, transformed_term] : transform_cache) {
+    released_bytes += sizeof(std::pair<const std::string, std::string>) +
+                      term.capacity() + transformed_term.capacity();
   }
+  return released_bytes;
 }
 
 std::string IcuNormalizer::TermTransformer::Transform(
     const std::string_view term) const {
+  if (IsAlreadyNormalized(term)) {
+    return std::string(term);
+  }
+
+  bool is_cacheable = term.length() <= kMaxCachedTermByteSize;
+  std::string cache_key;
+  if (is_cacheable) {
+    cache_key = std::string(term);
+    absl_ports::shared_lock l(&mutex_);
+    auto itr = transform_cache_.find(cache_key);
+    if (itr != transform_cache_.end()) {
+      return itr->second;
+    }
+  }
+
+  UTransliterator* u_transliterator = AcquireTransliterator();
+  if (u_transliterator == nullptr) {
+    ICING_LOG(WARNING) << "Failed to clone UTransliterator, unable to "
+                          "normalize UTF8 term: "
+                       << term;
+    return std::string(term);
+  }
+  std::string transformed_term = Transliterate(u_transliterator, term);
+  ReleaseTransliterator(u_transliterator);
+
+  if (is_cacheable) {
+    absl_ports::unique_lock l(&mutex_);
+    if (transform_cache_.size() >= kMaxCachedTerms) {
+      transform_cache_.clear();
+    }
+    transform_cache_.emplace(std::move(cache_key), transformed_term);
+  }
+  return transformed_term;
+}
+
+UTransliterator* IcuNormalizer::TermTransformer::AcquireTransliterator()
+    const {
+  absl_ports::unique_lock l(&mutex_);
+  if (!idle_transliterators_.empty()) {
+    UTransliterator* u_transliterator = idle_transliterators_.back();
+    idle_transliterators_.pop_back();
+    return u_transliterator;
+  }
+  // Cloning only reads from the prototype, but it still happens under the lock
+  // so that the prototype is never accessed concurrently.
+  UErrorCode status = U_ZERO_ERROR;
+  UTransliterator* u_transliterator =
+      utrans_clone(prototype_transliterator_, &status);
+  if (U_FAILURE(status)) {
+    return nullptr;
+  }
+  return u_transliterator;
+}
+
+void IcuNormalizer::TermTransformer::ReleaseTransliterator(
+    UTransliterator* u_transliterator) const {
+  {
+    absl_ports::unique_lock l(&mutex_);
+    if (idle_transliterators_.size() < kMaxPooledTransliterators) {
+      idle_transliterators_.push_back(u_transliterator);
+      return;
+    }
+  }
+  utrans_close(u_transliterator);
+}
+
+std::string IcuNormalizer::TermTransformer::Transliterate(
+    UTransliterator* u_transliterator, const std::string_view term) const {
   auto utf16_term_or = i18n_utils::Utf8ToUtf16(term);
   if (!utf16_term_or.ok()) {
     ICING_VLOG(0) << "Failed to convert UTF8 term '" << term << "' to UTF16";
@@ -221,7 +381,7 @@ std::string IcuNormalizer::TermTransformer::Transform(
   UErrorCode status = U_ZERO_ERROR;
   int utf16_term_desired_length = utf16_term.length();
   int limit = utf16_term.length();
-  utrans_transUChars(u_transliterator_, &utf16_term[0],
+  utrans_transUChars(u_transliterator, &utf16_term[0],
                      &utf16_term_desired_length, utf16_term.length(),
                      /*start=*/0, &limit, &status);
 
@@ -242,7 +402,7 @@ std::string IcuNormalizer::TermTransformer::Transform(
     utf16_term_desired_length = original_content_length;
     limit = original_content_length;
     status = U_ZERO_ERROR;
-    utrans_transUChars(u_transliterator_, &utf16_term[0],
+    utrans_transUChars(u_transliterator, &utf16_term[0],
                        &utf16_term_desired_length, utf16_term.length(),
                        /*start=*/0, &limit, &status);
   }
@@ -252,6 +412,9 @@ std::string IcuNormalizer::TermTransformer::Transform(
     ICING_LOG(WARNING) << "Failed to normalize UTF8 term: " << term;
     return std::string(term);
   }
+  // The transformed text may also be shorter than the original one, e.g. when
+  // nonspacing marks are removed. Drop the leftover tail.
+  utf16_term.resize(utf16_term_desired_length);
 
   auto utf8_term_or = i18n_utils::Utf16ToUtf8(utf16_term);
   if (!utf8_term_or.ok()) {
@@ -15,11 +15,16 @@
 #ifndef ICING_TRANSFORM_ICU_ICU_NORMALIZER_H_
 #define ICING_TRANSFORM_ICU_ICU_NORMALIZER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "icing/text_classifier/lib3/utils/base/statusor.h"
+#include "icing/absl_ports/mutex.h"
+#include "icing/absl_ports/thread_annotations.h"
 #include "icing/transform/normalizer.h"
 #include "unicode/unorm2.h"
 #include "unicode/utrans.h"
@@ -37,6 +42,8 @@ namespace lib {
 //
 // There're some other rules from ICU not listed here, please see .cc file for
 // details.
+//
+// This class is thread-safe.
 class IcuNormalizer : public Normalizer {
  public:
   // Creates a normalizer with the subcomponents it needs. max_term_byte_size
@@ -56,9 +63,19 @@ class IcuNormalizer : public Normalizer {
   // result in the non-Latin characters not properly being normalized
   std::string NormalizeTerm(std::string_view term) const override;
 
+  // Clears the memo cache and closes idle UTransliterators. The returned byte
+  // count only covers the memo cache, since ICU doesn't expose the size of a
+  // UTransliterator.
+  int64_t ReleaseCaches() const override;
+
  private:
-  // A handler class that helps manage the lifecycle of UTransliterator. It's
+  // A handler class that helps manage the lifecycle of UTransliterators. It's
   // used in IcuNormalizer to transform terms into the formats we need.
+  //
+  // UTransliterator is not thread-safe, so each call to Transform() borrows an
+  // instance from a small pool, cloning a new one from the prototype if none
+  // is idle. Results for short terms are memoized in a bounded cache, and terms
+  // that are already in their normalized form skip transliteration entirely.
   class TermTransformer {
    public:
     // Creates TermTransformer with a valid UTransliterator instance
@@ -69,18 +86,54 @@ class IcuNormalizer : public Normalizer {
     static libtextclassifier3::StatusOr<std::unique_ptr<TermTransformer>>
     Create();
 
-    // Closes the UTransliterator instance
+    // Closes all UTransliterator instances
     ~TermTransformer();
 
     // Transforms the text based on our rules described at top of this file
     std::string Transform(std::string_view term) const;
 
+    // Clears the memo cache and closes the idle UTransliterators. Returns the
+    // number of bytes the memo cache held.
+    int64_t ReleaseCaches() const;
+
    private:
     explicit TermTransformer(UTransliterator* u_transliterator);
 
+    // Returns an idle UTransliterator from the pool, or a new clone of the
+    // prototype if the pool is empty. Returns nullptr if cloning fails.
+    UTransliterator* AcquireTransliterator() const;
+
+    // Returns u_transliterator to the pool, or closes it if the pool is full.
+    void ReleaseTransliterator(UTransliterator* u_transliterator) const;
+
+    // Runs the transform rules over term with the given transliterator.
+    std::string Transliterate(UTransliterator* u_transliterator,
+                              std::string_view term) const;
+
+    // Max number of idle UTransliterators kept around for reuse.
+    static constexpr int kMaxPooledTransliterators = 8;
+
+    // Max number of entries in the memo cache. The cache is cleared once it
+    // fills up, which keeps memory bounded without per-lookup bookkeeping.
+    static constexpr int kMaxCachedTerms = 4096;
+
+    // Terms longer than this many bytes are not memoized.
+    static constexpr int kMaxCachedTermByteSize = 64;
+
     // An ICU class to execute custom term transformation / normalization rules.
-    // utrans_close() must by called after using.
-    UTransliterator* u_transliterator_;
+    // Only ever cloned, never used to transform directly. utrans_close() must
+    // be called after using.
+    UTransliterator* prototype_transliterator_;
+
+    mutable absl_ports::shared_mutex mutex_;
+
+    // Idle transliterators cloned from prototype_transliterator_.
+    mutable std::vector<UTransliterator*> idle_transliterators_
+        ICING_GUARDED_BY(mutex_);
+
+    // Memo cache from input term to its transformed form.
+    mutable std::unordered_map<std::string, std::string> transform_cache_
+        ICING_GUARDED_BY(mutex_);
   };
 
   explicit IcuNormalizer(std::unique_ptr<TermTransformer> term_transformer,
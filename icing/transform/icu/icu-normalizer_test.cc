@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -27,6 +30,7 @@ namespace icing {
 namespace lib {
 namespace {
 using ::testing::Eq;
+using ::testing::Gt;
 
 class IcuNormalizerTest : public testing::Test {
  protected:
@@ -127,6 +131,56 @@ TEST_F(IcuNormalizerTest, NonLatinLetterNotRemoveAccent) {
   // will be removed.
 }
 
+TEST_F(IcuNormalizerTest, Cyrillic) {
+  EXPECT_THAT(normalizer_->NormalizeTerm("ПРИВЕТ"), Eq("привет"));
+  EXPECT_THAT(normalizer_->NormalizeTerm("привет"), Eq("привет"));
+  EXPECT_THAT(normalizer_->NormalizeTerm("Ёлка"), Eq("ёлка"));
+  // The standalone combining breve is a nonspacing mark and is removed.
+  EXPECT_THAT(normalizer_->NormalizeTerm("и\u0306"), Eq("и"));
+}
+
+TEST_F(IcuNormalizerTest, RepeatedTermsAreStable) {
+  // The second call for each term is served from the memo cache.
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(normalizer_->NormalizeTerm("ПРИВЕТ"), Eq("привет"));
+    EXPECT_THAT(normalizer_->NormalizeTerm("あいうえお"), Eq("アイウエオ"));
+    EXPECT_THAT(normalizer_->NormalizeTerm("ｶ"), Eq("カ"));
+    EXPECT_THAT(normalizer_->NormalizeTerm("你好"), Eq("你好"));
+  }
+}
+
+TEST_F(IcuNormalizerTest, ConcurrentNormalization) {
+  // Enough distinct terms to exercise the transliterator pool and to evict
+  // from the memo cache while other threads are reading it.
+  std::vector<std::string> terms;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 5000; ++i) {
+    std::string suffix = std::to_string(i);
+    terms.push_back("ПРИВЕТ" + suffix);
+    expected.push_back("привет" + suffix);
+    terms.push_back("あいう" + suffix);
+    expected.push_back("アイウ" + suffix);
+  }
+
+  constexpr int kNumThreads = 8;
+  std::vector<int> num_mismatches(kNumThreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < terms.size(); ++i) {
+        int index = (i + t * 997) % terms.size();
+        if (normalizer_->NormalizeTerm(terms[index]) != expected[index]) {
+          ++num_mismatches[t];
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(num_mismatches, testing::Each(Eq(0)));
+}
+
 TEST_F(IcuNormalizerTest, FullWidthCharsToASCII) {
   // Full-width punctuation to ASCII punctuation
   EXPECT_THAT(normalizer_->NormalizeTerm("‘’．，！？：“”"), Eq("''.,!?:\"\""));
@@ -231,6 +285,17 @@ TEST_F(IcuNormalizerTest, Truncate) {
   }
 }
 
+TEST_F(IcuNormalizerTest, ReleaseCaches) {
+  // Only terms that go through the transliterator are cached.
+  EXPECT_THAT(normalizer_->NormalizeTerm("ＡＢＣ"), Eq("abc"));
+  EXPECT_THAT(normalizer_->NormalizeTerm("Ⓐ"), Eq("a"));
+  EXPECT_THAT(normalizer_->ReleaseCaches(), Gt(0));
+  EXPECT_THAT(normalizer_->ReleaseCaches(), Eq(0));
+
+  // Normalization still works once the caches are gone.
+  EXPECT_THAT(normalizer_->NormalizeTerm("Ⓐ"), Eq("a"));
+}
+
 }  // namespace
 }  // namespace lib
 }  // namespace icing
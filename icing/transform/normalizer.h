@@ -15,6 +15,7 @@
 #ifndef ICING_TRANSFORM_NORMALIZER_H_
 #define ICING_TRANSFORM_NORMALIZER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -39,6 +40,10 @@ class Normalizer {
   // Normalizes the input term based on rules. See implementation classes for
   // specific transformation rules.
   virtual std::string NormalizeTerm(std::string_view term) const = 0;
+
+  // Drops any caches kept to speed up normalization. Returns the number of
+  // bytes released.
+  virtual int64_t ReleaseCaches() const { return 0; }
 };
 
 }  // namespace lib
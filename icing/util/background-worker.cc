@@ -0,0 +1,69 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/background-worker.h"
+
+#include <functional>
+#include <mutex>  // NOLINT
+#include <utility>
+
+namespace icing {
+namespace lib {
+
+BackgroundWorker::BackgroundWorker(std::function<bool()> task)
+    : task_(std::move(task)), thread_(&BackgroundWorker::Run, this) {}
+
+BackgroundWorker::~BackgroundWorker() {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    stopping_ = true;
+  }
+  state_changed_.notify_all();
+  thread_.join();
+}
+
+void BackgroundWorker::Notify() {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    pending_ = true;
+  }
+  state_changed_.notify_all();
+}
+
+void BackgroundWorker::WaitUntilIdle() {
+  std::unique_lock<std::mutex> l(mutex_);
+  state_changed_.wait(
+      l, [this]() { return stopping_ || (!pending_ && !running_); });
+}
+
+void BackgroundWorker::Run() {
+  std::unique_lock<std::mutex> l(mutex_);
+  while (true) {
+    state_changed_.wait(l, [this]() { return stopping_ || pending_; });
+    if (stopping_) {
+      return;
+    }
+    pending_ = false;
+    running_ = true;
+    l.unlock();
+    bool has_more_work = task_();
+    l.lock();
+    running_ = false;
+    pending_ = pending_ || has_more_work;
+    state_changed_.notify_all();
+  }
+}
+
+}  // namespace lib
+}  // namespace icing
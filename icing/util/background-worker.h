@@ -0,0 +1,70 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_UTIL_BACKGROUND_WORKER_H_
+#define ICING_UTIL_BACKGROUND_WORKER_H_
+
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+
+namespace icing {
+namespace lib {
+
+// Runs a task on a dedicated thread whenever it is notified. Notifications
+// that arrive while the task is already pending are coalesced. Notifications
+// that arrive while the task is running cause it to run once more afterwards.
+//
+// The task returns whether it has more work to do, in which case it is run
+// again right away. Tasks with a lot of work can use this to do it in small
+// pieces, so that the destructor doesn't have to wait for all of it.
+//
+// The destructor waits for a running task to finish, but drops a pending one.
+//
+// This class is thread-safe.
+class BackgroundWorker {
+ public:
+  explicit BackgroundWorker(std::function<bool()> task);
+  BackgroundWorker(const BackgroundWorker&) = delete;
+  BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+
+  ~BackgroundWorker();
+
+  // Schedules the task to run on the worker thread.
+  void Notify();
+
+  // Blocks until the task has run to completion after all the notifications
+  // received so far.
+  void WaitUntilIdle();
+
+ private:
+  void Run();
+
+  std::function<bool()> task_;
+
+  std::mutex mutex_;
+  std::condition_variable state_changed_;
+  bool pending_ = false;
+  bool running_ = false;
+  bool stopping_ = false;
+
+  // Declared last so that everything above is set up before the thread starts.
+  std::thread thread_;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_UTIL_BACKGROUND_WORKER_H_
@@ -0,0 +1,119 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/background-worker.h"
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Le;
+
+TEST(BackgroundWorkerTest, NeverRunsWithoutNotify) {
+  std::atomic<int> num_runs(0);
+  {
+    BackgroundWorker worker([&num_runs]() {
+    ++num_runs;
+    return false;
+  });
+    worker.WaitUntilIdle();
+  }
+  EXPECT_THAT(num_runs.load(), Eq(0));
+}
+
+TEST(BackgroundWorkerTest, RunsAfterNotify) {
+  std::atomic<int> num_runs(0);
+  BackgroundWorker worker([&num_runs]() {
+    ++num_runs;
+    return false;
+  });
+  worker.Notify();
+  worker.WaitUntilIdle();
+  EXPECT_THAT(num_runs.load(), Eq(1));
+
+  worker.Notify();
+  worker.WaitUntilIdle();
+  EXPECT_THAT(num_runs.load(), Eq(2));
+}
+
+TEST(BackgroundWorkerTest, CoalescesPendingNotifications) {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool release = false;
+  std::atomic<int> num_runs(0);
+  BackgroundWorker worker([&]() {
+    std::unique_lock<std::mutex> l(mutex);
+    cv.wait(l, [&]() { return release; });
+    ++num_runs;
+    return false;
+  });
+
+  // The first notification starts a run that blocks, the rest pile up behind
+  // it and should only cause one more run.
+  worker.Notify();
+  for (int i = 0; i < 10; ++i) {
+    worker.Notify();
+  }
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    release = true;
+  }
+  cv.notify_all();
+  worker.WaitUntilIdle();
+  EXPECT_THAT(num_runs.load(), Ge(1));
+  EXPECT_THAT(num_runs.load(), Le(2));
+}
+
+TEST(BackgroundWorkerTest, RunsAgainWhileThereIsMoreWork) {
+  std::atomic<int> work_left(5);
+  BackgroundWorker worker([&work_left]() { return --work_left > 0; });
+  worker.Notify();
+  worker.WaitUntilIdle();
+  EXPECT_THAT(work_left.load(), Eq(0));
+}
+
+TEST(BackgroundWorkerTest, DestructorWaitsForRunningTask) {
+  std::atomic<bool> started(false);
+  std::atomic<bool> finished(false);
+  {
+    BackgroundWorker worker([&]() {
+      started = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      finished = true;
+      return false;
+    });
+    worker.Notify();
+    while (!started) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_TRUE(finished);
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
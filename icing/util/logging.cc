@@ -0,0 +1,37 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/logging.h"
+
+#include <atomic>
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+// Read by every enabled ICING_VLOG statement, so it's only ever accessed with
+// relaxed ordering.
+std::atomic<int> vlog_level{0};
+
+}  // namespace
+
+void SetVlogLevel(int verbose_level) {
+  vlog_level.store(verbose_level, std::memory_order_relaxed);
+}
+
+int GetVlogLevel() { return vlog_level.load(std::memory_order_relaxed); }
+
+}  // namespace lib
+}  // namespace icing
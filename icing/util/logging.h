@@ -20,8 +20,44 @@
 namespace icing {
 namespace lib {
 
-// TODO(b/146903474) Add verbose level control
-#define ICING_VLOG(verbose_level) TC3_VLOG(verbose_level)
+// Sets the highest level that ICING_VLOG statements log at. Statements with a
+// higher level are skipped without evaluating their arguments. Defaults to 0.
+//
+// This has no effect unless verbose logging was compiled in with
+// TC3_ENABLE_VLOG. Without it, ICING_VLOG statements compile down to nothing.
+void SetVlogLevel(int verbose_level);
+
+// Returns the level set by SetVlogLevel.
+int GetVlogLevel();
+
+namespace logging_internal {
+
+// Turns a logging stream into void, so that it can be the second operand of
+// the conditional in ICING_LAZY_STREAM. operator& binds more loosely than <<
+// and more tightly than ?:.
+class Voidify {
+ public:
+  template <typename Stream>
+  void operator&(const Stream&) {}
+};
+
+}  // namespace logging_internal
+
+// Only evaluates stream, including everything <<-pumped into it, if condition
+// holds. With a constant false condition, the compiler drops it altogether.
+#define ICING_LAZY_STREAM(stream, condition) \
+  !(condition) ? (void)0 : ::icing::lib::logging_internal::Voidify() & (stream)
+
+#ifdef TC3_ENABLE_VLOG
+#define ICING_VLOG_IS_ON(verbose_level) \
+  ((verbose_level) <= ::icing::lib::GetVlogLevel())
+#define ICING_VLOG(verbose_level) \
+  ICING_LAZY_STREAM(TC3_VLOG(verbose_level), ICING_VLOG_IS_ON(verbose_level))
+#else
+#define ICING_VLOG_IS_ON(verbose_level) false
+#define ICING_VLOG(verbose_level) ICING_LAZY_STREAM(TC3_NULLSTREAM, false)
+#endif
+
 #define ICING_LOG(severity) TC3_LOG(severity)
 
 }  // namespace lib
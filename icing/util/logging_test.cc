@@ -0,0 +1,87 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/logging.h"
+
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::Eq;
+
+class LoggingTest : public testing::Test {
+ protected:
+  void TearDown() override { SetVlogLevel(0); }
+};
+
+std::string CountCall(int* num_calls) {
+  ++(*num_calls);
+  return "message";
+}
+
+TEST_F(LoggingTest, SetVlogLevel) {
+  EXPECT_THAT(GetVlogLevel(), Eq(0));
+  SetVlogLevel(2);
+  EXPECT_THAT(GetVlogLevel(), Eq(2));
+}
+
+TEST_F(LoggingTest, DisabledVlogDoesNotEvaluateArguments) {
+  int num_calls = 0;
+  ICING_VLOG(1) << CountCall(&num_calls);
+  ICING_VLOG(1) << "a" << CountCall(&num_calls) << 1;
+  EXPECT_THAT(num_calls, Eq(0));
+  EXPECT_FALSE(ICING_VLOG_IS_ON(1));
+}
+
+TEST_F(LoggingTest, VlogCanBeTheBodyOfAnIf) {
+  int num_calls = 0;
+  bool condition = false;
+  // Must not take the else branch away from the if.
+  if (condition)
+    ICING_VLOG(1) << CountCall(&num_calls);
+  else
+    ++num_calls;
+  EXPECT_THAT(num_calls, Eq(1));
+}
+
+#ifdef TC3_ENABLE_VLOG
+TEST_F(LoggingTest, EnabledVlogEvaluatesArguments) {
+  SetVlogLevel(1);
+  int num_calls = 0;
+  ICING_VLOG(1) << CountCall(&num_calls);
+  ICING_VLOG(2) << CountCall(&num_calls);
+  EXPECT_THAT(num_calls, Eq(1));
+  EXPECT_TRUE(ICING_VLOG_IS_ON(1));
+  EXPECT_FALSE(ICING_VLOG_IS_ON(2));
+}
+#else
+TEST_F(LoggingTest, VlogIsCompiledOut) {
+  SetVlogLevel(5);
+  int num_calls = 0;
+  ICING_VLOG(1) << CountCall(&num_calls);
+  EXPECT_THAT(num_calls, Eq(0));
+  EXPECT_FALSE(ICING_VLOG_IS_ON(1));
+}
+#endif  // TC3_ENABLE_VLOG
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,109 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/operation-scheduler.h"
+
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+
+namespace icing {
+namespace lib {
+
+OperationScheduler::Admission OperationScheduler::Admit(
+    OperationPriority priority, bool exclusive) {
+  if (!enabled_) {
+    return Admission(/*scheduler=*/nullptr, exclusive, /*num_overtaken=*/0);
+  }
+
+  std::unique_lock<std::mutex> l(mutex_);
+  uint64_t arrival = next_arrival_++;
+  WaiterKey key(priority, arrival);
+  waiters_.emplace(key, Waiter{exclusive, /*num_overtaken=*/0});
+  waiter_keys_.emplace(arrival, key);
+  admitted_or_released_.wait(l, [&]() {
+    // The key changes if the waiter gets promoted.
+    return CanAdmit(waiter_keys_.at(arrival), exclusive);
+  });
+  auto waiter_itr = waiters_.find(waiter_keys_.at(arrival));
+  int num_overtaken = waiter_itr->second.num_overtaken;
+  waiters_.erase(waiter_itr);
+  waiter_keys_.erase(arrival);
+  CountOvertakes(arrival);
+  if (exclusive) {
+    running_exclusive_ = true;
+  } else {
+    ++num_running_shared_;
+    // Shared waiters right behind this one may be able to run now too.
+    admitted_or_released_.notify_all();
+  }
+  return Admission(this, exclusive, num_overtaken);
+}
+
+int OperationScheduler::num_waiting() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return waiters_.size();
+}
+
+int OperationScheduler::num_promoted() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return num_promoted_;
+}
+
+bool OperationScheduler::CanAdmit(const WaiterKey& key, bool exclusive) const {
+  if (running_exclusive_ || (exclusive && num_running_shared_ > 0)) {
+    return false;
+  }
+  for (auto itr = waiters_.begin(); itr->first != key; ++itr) {
+    if (exclusive || itr->second.exclusive) {
+      // Something ahead of us has to run on its own first.
+      return false;
+    }
+  }
+  return true;
+}
+
+void OperationScheduler::CountOvertakes(uint64_t arrival) {
+  for (auto itr = waiter_keys_.begin();
+       itr != waiter_keys_.end() && itr->first < arrival; ++itr) {
+    WaiterKey& key = itr->second;
+    auto waiter_itr = waiters_.find(key);
+    Waiter& waiter = waiter_itr->second;
+    ++waiter.num_overtaken;
+    if (waiter.num_overtaken < max_overtakes_ ||
+        key.first == OperationPriority::kInteractiveRead) {
+      continue;
+    }
+    // Move the waiter ahead of everything that arrived after it.
+    Waiter promoted_waiter = waiter;
+    waiters_.erase(waiter_itr);
+    key.first = OperationPriority::kInteractiveRead;
+    waiters_.emplace(key, promoted_waiter);
+    ++num_promoted_;
+  }
+}
+
+void OperationScheduler::Release(bool exclusive) {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    if (exclusive) {
+      running_exclusive_ = false;
+    } else {
+      --num_running_shared_;
+    }
+  }
+  admitted_or_released_.notify_all();
+}
+
+}  // namespace lib
+}  // namespace icing
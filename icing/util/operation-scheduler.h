@@ -0,0 +1,150 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_UTIL_OPERATION_SCHEDULER_H_
+#define ICING_UTIL_OPERATION_SCHEDULER_H_
+
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <map>
+#include <mutex>  // NOLINT
+#include <utility>
+
+namespace icing {
+namespace lib {
+
+// Priorities of the operations admitted by OperationScheduler, from highest to
+// lowest.
+enum class OperationPriority {
+  kInteractiveRead = 0,
+  kInteractiveWrite = 1,
+  kBackgroundWrite = 2,
+  kMaintenance = 3,
+};
+
+// Decides the order in which callers get to run operations on a shared
+// resource. It behaves like a reader/writer lock, except that waiters are
+// admitted by priority rather than in arrival order. Waiters of the same
+// priority are admitted first-come, first-served.
+//
+// An operation is admitted once nothing incompatible is running and every
+// waiter ahead of it is shared and so is the operation itself. Exclusive
+// operations therefore only ever wait behind the operations already running
+// and the waiters of higher or equal priority, which bounds how long a
+// high-priority caller can be starved by a stream of low-priority ones to a
+// single running operation.
+//
+// Lower priorities age so that a steady stream of higher-priority callers
+// can't starve them: once max_overtakes operations have been admitted ahead
+// of a waiter that arrived before them, the waiter is promoted to the highest
+// priority. It is then admitted before every caller that arrives after it, so
+// it waits for at most max_overtakes admissions plus whatever was queued or
+// running when it arrived.
+//
+// When disabled, Admit() returns immediately and the caller is left to
+// whatever ordering its own locks provide.
+//
+// This class is thread-safe.
+class OperationScheduler {
+ public:
+  // Marks an admitted operation. The operation is done when this is destroyed.
+  class Admission {
+   public:
+    Admission(Admission&& other)
+        : scheduler_(std::exchange(other.scheduler_, nullptr)),
+          exclusive_(other.exclusive_),
+          num_overtaken_(other.num_overtaken_) {}
+    Admission(const Admission&) = delete;
+    Admission& operator=(Admission&&) = delete;
+    Admission& operator=(const Admission&) = delete;
+
+    ~Admission() {
+      if (scheduler_ != nullptr) {
+        scheduler_->Release(exclusive_);
+      }
+    }
+
+    // Number of operations that arrived later but were admitted while this
+    // one was waiting.
+    int num_overtaken() const { return num_overtaken_; }
+
+   private:
+    friend class OperationScheduler;
+
+    Admission(OperationScheduler* scheduler, bool exclusive, int num_overtaken)
+        : scheduler_(scheduler),
+          exclusive_(exclusive),
+          num_overtaken_(num_overtaken) {}
+
+    OperationScheduler* scheduler_;
+    bool exclusive_;
+    int num_overtaken_;
+  };
+
+  static constexpr int kDefaultMaxOvertakes = 32;
+
+  explicit OperationScheduler(bool enabled,
+                              int max_overtakes = kDefaultMaxOvertakes)
+      : enabled_(enabled), max_overtakes_(max_overtakes) {}
+  OperationScheduler(const OperationScheduler&) = delete;
+  OperationScheduler& operator=(const OperationScheduler&) = delete;
+
+  // Blocks until an operation of the given priority may run. Exclusive
+  // operations run alone, shared operations may run alongside each other.
+  Admission Admit(OperationPriority priority, bool exclusive);
+
+  // Returns the number of callers currently blocked in Admit().
+  int num_waiting() const;
+
+  // Returns the number of waiters that have been promoted so far.
+  int num_promoted() const;
+
+ private:
+  // Waiters are ordered by priority, then by arrival. Promoted waiters keep
+  // their arrival.
+  using WaiterKey = std::pair<OperationPriority, uint64_t>;
+
+  struct Waiter {
+    bool exclusive;
+    int num_overtaken;
+  };
+
+  bool CanAdmit(const WaiterKey& key, bool exclusive) const;
+
+  // Counts the admission of an operation that arrived at arrival against
+  // every waiter that arrived before it, and promotes the waiters that were
+  // overtaken too often.
+  void CountOvertakes(uint64_t arrival);
+
+  void Release(bool exclusive);
+
+  const bool enabled_;
+  const int max_overtakes_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable admitted_or_released_;
+
+  std::map<WaiterKey, Waiter> waiters_;
+  // Maps the arrival of every waiter to its current key.
+  std::map<uint64_t, WaiterKey> waiter_keys_;
+  uint64_t next_arrival_ = 0;
+  int num_promoted_ = 0;
+  int num_running_shared_ = 0;
+  bool running_exclusive_ = false;
+};
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_UTIL_OPERATION_SCHEDULER_H_
@@ -0,0 +1,245 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/operation-scheduler.h"
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+// Blocks until the scheduler has num_waiting callers queued up.
+void WaitForWaiters(const OperationScheduler& scheduler, int num_waiting) {
+  while (scheduler.num_waiting() != num_waiting) {
+    std::this_thread::yield();
+  }
+}
+
+// Records the order in which operations were admitted.
+class AdmissionRecorder {
+ public:
+  void Record(const std::string& name) {
+    std::lock_guard<std::mutex> l(mutex_);
+    order_.push_back(name);
+  }
+
+  std::vector<std::string> order() {
+    std::lock_guard<std::mutex> l(mutex_);
+    return order_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::string> order_;
+};
+
+TEST(OperationSchedulerTest, DisabledNeverBlocks) {
+  OperationScheduler scheduler(/*enabled=*/false);
+  OperationScheduler::Admission first = scheduler.Admit(
+      OperationPriority::kMaintenance, /*exclusive=*/true);
+  OperationScheduler::Admission second = scheduler.Admit(
+      OperationPriority::kInteractiveWrite, /*exclusive=*/true);
+  EXPECT_THAT(scheduler.num_waiting(), Eq(0));
+}
+
+TEST(OperationSchedulerTest, SharedOperationsRunTogether) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  OperationScheduler::Admission first = scheduler.Admit(
+      OperationPriority::kInteractiveRead, /*exclusive=*/false);
+  OperationScheduler::Admission second = scheduler.Admit(
+      OperationPriority::kMaintenance, /*exclusive=*/false);
+  EXPECT_THAT(scheduler.num_waiting(), Eq(0));
+}
+
+TEST(OperationSchedulerTest, ExclusiveOperationWaitsForRunningOperation) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  std::atomic<bool> admitted(false);
+  std::thread writer;
+  {
+    OperationScheduler::Admission reader = scheduler.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    writer = std::thread([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kInteractiveRead, /*exclusive=*/true);
+      admitted = true;
+    });
+    WaitForWaiters(scheduler, 1);
+    EXPECT_THAT(admitted.load(), IsFalse());
+  }
+  writer.join();
+  EXPECT_THAT(admitted.load(), IsTrue());
+}
+
+TEST(OperationSchedulerTest, HigherPriorityIsAdmittedFirst) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  AdmissionRecorder recorder;
+  std::vector<std::thread> threads;
+  {
+    OperationScheduler::Admission running = scheduler.Admit(
+        OperationPriority::kMaintenance, /*exclusive=*/true);
+
+    auto run = [&](std::string name, OperationPriority priority) {
+      OperationScheduler::Admission admission =
+          scheduler.Admit(priority, /*exclusive=*/true);
+      recorder.Record(name);
+    };
+    threads.emplace_back(run, "maintenance", OperationPriority::kMaintenance);
+    WaitForWaiters(scheduler, 1);
+    threads.emplace_back(run, "background_write",
+                         OperationPriority::kBackgroundWrite);
+    WaitForWaiters(scheduler, 2);
+    threads.emplace_back(run, "interactive_write",
+                         OperationPriority::kInteractiveWrite);
+    WaitForWaiters(scheduler, 3);
+    threads.emplace_back(run, "interactive_read",
+                         OperationPriority::kInteractiveRead);
+    WaitForWaiters(scheduler, 4);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(recorder.order(),
+              ElementsAre("interactive_read", "interactive_write",
+                          "background_write", "maintenance"));
+}
+
+TEST(OperationSchedulerTest, SamePriorityIsFirstComeFirstServed) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  AdmissionRecorder recorder;
+  std::vector<std::thread> threads;
+  {
+    OperationScheduler::Admission running = scheduler.Admit(
+        OperationPriority::kBackgroundWrite, /*exclusive=*/true);
+
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&, i]() {
+        OperationScheduler::Admission admission = scheduler.Admit(
+            OperationPriority::kBackgroundWrite, /*exclusive=*/true);
+        recorder.Record(std::to_string(i));
+      });
+      WaitForWaiters(scheduler, i + 1);
+    }
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(recorder.order(), ElementsAre("0", "1", "2", "3"));
+}
+
+TEST(OperationSchedulerTest, HigherPriorityReadOvertakesWaitingWrite) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  std::atomic<bool> write_admitted(false);
+  std::thread writer;
+  {
+    OperationScheduler::Admission running_read = scheduler.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    writer = std::thread([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kBackgroundWrite, /*exclusive=*/true);
+      write_admitted = true;
+    });
+    WaitForWaiters(scheduler, 1);
+
+    // The interactive read doesn't queue up behind the background write.
+    OperationScheduler::Admission new_read = scheduler.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    EXPECT_THAT(write_admitted.load(), IsFalse());
+  }
+  writer.join();
+  EXPECT_THAT(write_admitted.load(), IsTrue());
+}
+
+TEST(OperationSchedulerTest, LowerPriorityReadQueuesBehindWaitingWrite) {
+  OperationScheduler scheduler(/*enabled=*/true);
+  AdmissionRecorder recorder;
+  std::vector<std::thread> threads;
+  {
+    OperationScheduler::Admission running_read = scheduler.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    threads.emplace_back([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kInteractiveWrite, /*exclusive=*/true);
+      recorder.Record("write");
+    });
+    WaitForWaiters(scheduler, 1);
+    threads.emplace_back([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kMaintenance, /*exclusive=*/false);
+      recorder.Record("maintenance_read");
+    });
+    WaitForWaiters(scheduler, 2);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(recorder.order(), ElementsAre("write", "maintenance_read"));
+}
+
+TEST(OperationSchedulerTest, MaintenanceIsAdmittedWhileReadersKeepArriving) {
+  OperationScheduler scheduler(/*enabled=*/true, /*max_overtakes=*/3);
+  AdmissionRecorder recorder;
+  std::atomic<int> num_overtaken(-1);
+  std::vector<std::thread> threads;
+  {
+    OperationScheduler::Admission running_read = scheduler.Admit(
+        OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    threads.emplace_back([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kMaintenance, /*exclusive=*/true);
+      num_overtaken = admission.num_overtaken();
+      recorder.Record("maintenance");
+    });
+    WaitForWaiters(scheduler, 1);
+
+    // Readers overtake the waiting maintenance operation until it's promoted.
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_THAT(scheduler.num_promoted(), Eq(0));
+      OperationScheduler::Admission read = scheduler.Admit(
+          OperationPriority::kInteractiveRead, /*exclusive=*/false);
+    }
+    EXPECT_THAT(scheduler.num_promoted(), Eq(1));
+
+    // From now on, new readers queue up behind it.
+    threads.emplace_back([&]() {
+      OperationScheduler::Admission admission = scheduler.Admit(
+          OperationPriority::kInteractiveRead, /*exclusive=*/false);
+      recorder.Record("read");
+    });
+    WaitForWaiters(scheduler, 2);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(recorder.order(), ElementsAre("maintenance", "read"));
+  EXPECT_THAT(num_overtaken.load(), Eq(3));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,124 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/page-util.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "icing/util/logging.h"
+
+namespace icing {
+namespace lib {
+
+namespace page_util {
+
+namespace {
+
+// Number of /proc/self/pagemap entries read at a time.
+constexpr size_t kPagemapBatchSize = 512;
+
+// Bit set in a pagemap entry if the page is present in RAM.
+constexpr uint64_t kPagemapPresentBit = uint64_t{1} << 63;
+
+size_t PageSize() {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+// Counts the present pages of [start, start + num_pages * page size) using
+// /proc/self/pagemap. Returns -1 if pagemap can't be read.
+int64_t CountPresentPagesFromPagemap(uintptr_t start, size_t num_pages) {
+  int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  std::vector<uint64_t> entries(std::min(num_pages, kPagemapBatchSize));
+  int64_t num_present = 0;
+  for (size_t i = 0; i < num_pages; i += entries.size()) {
+    size_t num_entries = std::min(entries.size(), num_pages - i);
+    ssize_t bytes_to_read = num_entries * sizeof(uint64_t);
+    off_t offset = (start / PageSize() + i) * sizeof(uint64_t);
+    if (pread(fd, entries.data(), bytes_to_read, offset) != bytes_to_read) {
+      close(fd);
+      return -1;
+    }
+    for (size_t j = 0; j < num_entries; ++j) {
+      if (entries[j] & kPagemapPresentBit) {
+        ++num_present;
+      }
+    }
+  }
+  close(fd);
+  return num_present;
+}
+
+// Counts the pages of [start, start + num_pages * page size) that are in the
+// page cache. This overcounts file pages that are cached but not mapped into
+// this process, so it is only used when pagemap isn't available.
+int64_t CountPresentPagesFromMincore(uintptr_t start, size_t num_pages) {
+  std::vector<unsigned char> residency(num_pages);
+  if (mincore(reinterpret_cast<void*>(start), num_pages * PageSize(),
+              residency.data()) != 0) {
+    return 0;
+  }
+  return std::count_if(residency.begin(), residency.end(),
+                       [](unsigned char page) { return page & 1; });
+}
+
+}  // namespace
+
+int64_t CountResidentBytes(const void* addr, size_t len) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr) / PageSize() * PageSize();
+  uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + len + PageSize() - 1) /
+                  PageSize() * PageSize();
+  size_t num_pages = (end - start) / PageSize();
+  if (num_pages == 0) {
+    return 0;
+  }
+  int64_t num_present = CountPresentPagesFromPagemap(start, num_pages);
+  if (num_present < 0) {
+    num_present = CountPresentPagesFromMincore(start, num_pages);
+  }
+  return num_present * PageSize();
+}
+
+int64_t ReleasePages(void* addr, size_t len) {
+  uintptr_t start = (reinterpret_cast<uintptr_t>(addr) + PageSize() - 1) /
+                    PageSize() * PageSize();
+  uintptr_t end =
+      (reinterpret_cast<uintptr_t>(addr) + len) / PageSize() * PageSize();
+  if (end <= start) {
+    return 0;
+  }
+  void* aligned_addr = reinterpret_cast<void*>(start);
+  int64_t resident_bytes = CountResidentBytes(aligned_addr, end - start);
+  if (madvise(aligned_addr, end - start, MADV_DONTNEED) != 0) {
+    ICING_LOG(WARNING) << "Failed to release pages: " << strerror(errno);
+    return 0;
+  }
+  return resident_bytes;
+}
+
+}  // namespace page_util
+
+}  // namespace lib
+}  // namespace icing
@@ -0,0 +1,45 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ICING_UTIL_PAGE_UTIL_H_
+#define ICING_UTIL_PAGE_UTIL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace icing {
+namespace lib {
+
+namespace page_util {
+
+// Returns how many bytes of the pages overlapping [addr, addr + len) are
+// currently mapped into this process' memory.
+int64_t CountResidentBytes(const void* addr, size_t len);
+
+// Drops the pages that lie entirely within [addr, addr + len) from this
+// process' memory with madvise(MADV_DONTNEED), and returns how many bytes of
+// them were resident.
+//
+// The next access to a released page reads it back from the backing file, or
+// zero-fills it for anonymous memory. It is therefore only safe to call this on
+// shared file mappings and on pages of private mappings that were never
+// written to since the last time they were flushed to the file.
+int64_t ReleasePages(void* addr, size_t len);
+
+}  // namespace page_util
+
+}  // namespace lib
+}  // namespace icing
+
+#endif  // ICING_UTIL_PAGE_UTIL_H_
@@ -0,0 +1,111 @@
+// Copyright (C) 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "icing/util/page-util.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "icing/file/filesystem.h"
+#include "icing/testing/tmp-directory.h"
+
+namespace icing {
+namespace lib {
+
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Le;
+
+class PageUtilTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    page_size_ = sysconf(_SC_PAGESIZE);
+    file_path_ = GetTestTempDir() + "/page_util_test_file";
+    fd_ = filesystem_.OpenForWrite(file_path_.c_str());
+    ASSERT_GE(fd_, 0);
+    ASSERT_TRUE(filesystem_.Grow(fd_, kNumPages * page_size_));
+    mapping_ = mmap(nullptr, kNumPages * page_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd_, 0);
+    ASSERT_NE(mapping_, MAP_FAILED);
+  }
+
+  void TearDown() override {
+    munmap(mapping_, kNumPages * page_size_);
+    close(fd_);
+    filesystem_.DeleteFile(file_path_.c_str());
+  }
+
+  char* page(int index) {
+    return static_cast<char*>(mapping_) + index * page_size_;
+  }
+
+  static constexpr int kNumPages = 16;
+
+  Filesystem filesystem_;
+  std::string file_path_;
+  size_t page_size_;
+  int fd_ = -1;
+  void* mapping_ = nullptr;
+};
+
+TEST_F(PageUtilTest, CountsTouchedPages) {
+  EXPECT_THAT(page_util::CountResidentBytes(mapping_, kNumPages * page_size_),
+              Le(kNumPages * page_size_));
+
+  for (int i = 0; i < kNumPages; ++i) {
+    page(i)[0] = 'a';
+  }
+  EXPECT_THAT(page_util::CountResidentBytes(mapping_, kNumPages * page_size_),
+              Eq(kNumPages * page_size_));
+}
+
+TEST_F(PageUtilTest, ReleasePagesKeepsSharedFileContents) {
+  for (int i = 0; i < kNumPages; ++i) {
+    memset(page(i), 'a' + i, page_size_);
+  }
+
+  EXPECT_THAT(page_util::ReleasePages(mapping_, kNumPages * page_size_),
+              Eq(kNumPages * page_size_));
+
+  for (int i = 0; i < kNumPages; ++i) {
+    EXPECT_THAT(page(i)[page_size_ - 1], Eq('a' + i));
+  }
+}
+
+TEST_F(PageUtilTest, ReleasePagesOnlyReleasesWholePages) {
+  for (int i = 0; i < kNumPages; ++i) {
+    page(i)[0] = 'a';
+  }
+
+  // Covers the second half of page 0 through the first half of page 3, which
+  // only contains pages 1 and 2 entirely.
+  EXPECT_THAT(page_util::ReleasePages(page(0) + page_size_ / 2,
+                                      3 * page_size_),
+              Eq(2 * page_size_));
+  EXPECT_THAT(page_util::ReleasePages(page(5) + 1, page_size_ - 1), Eq(0));
+  EXPECT_THAT(page_util::CountResidentBytes(mapping_, kNumPages * page_size_),
+              Ge((kNumPages - 2) * page_size_));
+}
+
+}  // namespace
+
+}  // namespace lib
+}  // namespace icing
@@ -16,12 +16,15 @@ package com.google.android.icing;
 
 import android.util.Log;
 import androidx.annotation.NonNull;
+import com.google.android.icing.proto.BatchGetResultProto;
 import com.google.android.icing.proto.DeleteByNamespaceResultProto;
 import com.google.android.icing.proto.DeleteByQueryResultProto;
 import com.google.android.icing.proto.DeleteBySchemaTypeResultProto;
+import com.google.android.icing.proto.DeleteByUriPrefixResultProto;
 import com.google.android.icing.proto.DeleteResultProto;
 import com.google.android.icing.proto.DocumentProto;
 import com.google.android.icing.proto.GetAllNamespacesResultProto;
+import com.google.android.icing.proto.GetByUriPrefixResultProto;
 import com.google.android.icing.proto.GetOptimizeInfoResultProto;
 import com.google.android.icing.proto.GetResultProto;
 import com.google.android.icing.proto.GetResultSpecProto;
@@ -36,6 +39,8 @@ import com.google.android.icing.proto.PutResultProto;
 import com.google.android.icing.proto.ReportUsageResultProto;
 import com.google.android.icing.proto.ResetResultProto;
 import com.google.android.icing.proto.ResultSpecProto;
+import com.google.android.icing.proto.ScanResultProto;
+import com.google.android.icing.proto.ScanSpecProto;
 import com.google.android.icing.proto.SchemaProto;
 import com.google.android.icing.proto.ScoringSpecProto;
 import com.google.android.icing.proto.SearchResultProto;
@@ -43,6 +48,8 @@ import com.google.android.icing.proto.SearchSpecProto;
 import com.google.android.icing.proto.SetSchemaResultProto;
 import com.google.android.icing.proto.StatusProto;
 import com.google.android.icing.proto.StorageInfoResultProto;
+import com.google.android.icing.proto.TrimMemoryLevel;
+import com.google.android.icing.proto.TrimMemoryResultProto;
 import com.google.android.icing.proto.UsageReport;
 import com.google.protobuf.ExtensionRegistryLite;
 import com.google.protobuf.InvalidProtocolBufferException;
@@ -246,6 +253,63 @@ public class IcingSearchEngine implements Closeable {
     }
   }
 
+  /**
+   * Gets the documents with the given namespaces and uris, which must be of the same length. The
+   * results are in the same order as the keys.
+   */
+  @NonNull
+  public BatchGetResultProto batchGet(
+      @NonNull String[] namespaces,
+      @NonNull String[] uris,
+      @NonNull GetResultSpecProto getResultSpec) {
+    throwIfClosed();
+
+    byte[] batchGetResultBytes =
+        nativeBatchGet(this, namespaces, uris, getResultSpec.toByteArray());
+    if (batchGetResultBytes == null) {
+      Log.e(TAG, "Received null BatchGetResultProto from native.");
+      return BatchGetResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+
+    try {
+      return BatchGetResultProto.parseFrom(batchGetResultBytes, EXTENSION_REGISTRY_LITE);
+    } catch (InvalidProtocolBufferException e) {
+      Log.e(TAG, "Error parsing BatchGetResultProto.", e);
+      return BatchGetResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+  }
+
+  @NonNull
+  public GetByUriPrefixResultProto getByUriPrefix(
+      @NonNull String namespace,
+      @NonNull String uriPrefix,
+      @NonNull GetResultSpecProto getResultSpec) {
+    throwIfClosed();
+
+    byte[] getByUriPrefixResultBytes =
+        nativeGetByUriPrefix(this, namespace, uriPrefix, getResultSpec.toByteArray());
+    if (getByUriPrefixResultBytes == null) {
+      Log.e(TAG, "Received null GetByUriPrefixResultProto from native.");
+      return GetByUriPrefixResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+
+    try {
+      return GetByUriPrefixResultProto.parseFrom(
+          getByUriPrefixResultBytes, EXTENSION_REGISTRY_LITE);
+    } catch (InvalidProtocolBufferException e) {
+      Log.e(TAG, "Error parsing GetByUriPrefixResultProto.", e);
+      return GetByUriPrefixResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+  }
+
   @NonNull
   public ReportUsageResultProto reportUsage(@NonNull UsageReport usageReport) {
     throwIfClosed();
@@ -347,6 +411,50 @@ public class IcingSearchEngine implements Closeable {
     nativeInvalidateNextPageToken(this, nextPageToken);
   }
 
+  @NonNull
+  public ScanResultProto scan(
+      @NonNull ScanSpecProto scanSpec, @NonNull GetResultSpecProto getResultSpec) {
+    throwIfClosed();
+
+    byte[] scanResultBytes =
+        nativeScan(this, scanSpec.toByteArray(), getResultSpec.toByteArray());
+    return parseScanResult(scanResultBytes);
+  }
+
+  @NonNull
+  public ScanResultProto getNextScanPage(long nextPageToken) {
+    throwIfClosed();
+
+    byte[] scanResultBytes = nativeGetNextScanPage(this, nextPageToken);
+    return parseScanResult(scanResultBytes);
+  }
+
+  @NonNull
+  public void invalidateScanToken(long nextPageToken) {
+    throwIfClosed();
+
+    nativeInvalidateScanToken(this, nextPageToken);
+  }
+
+  @NonNull
+  private static ScanResultProto parseScanResult(byte[] scanResultBytes) {
+    if (scanResultBytes == null) {
+      Log.e(TAG, "Received null ScanResultProto from native.");
+      return ScanResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+
+    try {
+      return ScanResultProto.parseFrom(scanResultBytes, EXTENSION_REGISTRY_LITE);
+    } catch (InvalidProtocolBufferException e) {
+      Log.e(TAG, "Error parsing ScanResultProto.", e);
+      return ScanResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+  }
+
   @NonNull
   public DeleteResultProto delete(@NonNull String namespace, @NonNull String uri) {
     throwIfClosed();
@@ -415,6 +523,30 @@ public class IcingSearchEngine implements Closeable {
     }
   }
 
+  @NonNull
+  public DeleteByUriPrefixResultProto deleteByUriPrefix(
+      @NonNull String namespace, @NonNull String uriPrefix) {
+    throwIfClosed();
+
+    byte[] deleteByUriPrefixResultBytes = nativeDeleteByUriPrefix(this, namespace, uriPrefix);
+    if (deleteByUriPrefixResultBytes == null) {
+      Log.e(TAG, "Received null DeleteByUriPrefixResultProto from native.");
+      return DeleteByUriPrefixResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+
+    try {
+      return DeleteByUriPrefixResultProto.parseFrom(
+          deleteByUriPrefixResultBytes, EXTENSION_REGISTRY_LITE);
+    } catch (InvalidProtocolBufferException e) {
+      Log.e(TAG, "Error parsing DeleteByUriPrefixResultProto.", e);
+      return DeleteByUriPrefixResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+  }
+
   @NonNull
   public DeleteByQueryResultProto deleteByQuery(@NonNull SearchSpecProto searchSpec) {
     throwIfClosed();
@@ -459,6 +591,28 @@ public class IcingSearchEngine implements Closeable {
     }
   }
 
+  @NonNull
+  public TrimMemoryResultProto trimMemory(@NonNull TrimMemoryLevel.Code trimMemoryLevelCode) {
+    throwIfClosed();
+
+    byte[] trimMemoryResultBytes = nativeTrimMemory(this, trimMemoryLevelCode.getNumber());
+    if (trimMemoryResultBytes == null) {
+      Log.e(TAG, "Received null TrimMemoryResultProto from native.");
+      return TrimMemoryResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+
+    try {
+      return TrimMemoryResultProto.parseFrom(trimMemoryResultBytes, EXTENSION_REGISTRY_LITE);
+    } catch (InvalidProtocolBufferException e) {
+      Log.e(TAG, "Error parsing TrimMemoryResultProto.", e);
+      return TrimMemoryResultProto.newBuilder()
+          .setStatus(StatusProto.newBuilder().setCode(StatusProto.Code.INTERNAL))
+          .build();
+    }
+  }
+
   @NonNull
   public OptimizeResultProto optimize() {
     throwIfClosed();
@@ -567,6 +721,12 @@ public class IcingSearchEngine implements Closeable {
   private static native byte[] nativeGet(
       IcingSearchEngine instance, String namespace, String uri, byte[] getResultSpecBytes);
 
+  private static native byte[] nativeBatchGet(
+      IcingSearchEngine instance, String[] namespaces, String[] uris, byte[] getResultSpecBytes);
+
+  private static native byte[] nativeGetByUriPrefix(
+      IcingSearchEngine instance, String namespace, String uriPrefix, byte[] getResultSpecBytes);
+
   private static native byte[] nativeReportUsage(
       IcingSearchEngine instance, byte[] usageReportBytes);
 
@@ -583,6 +743,15 @@ public class IcingSearchEngine implements Closeable {
   private static native void nativeInvalidateNextPageToken(
       IcingSearchEngine instance, long nextPageToken);
 
+  private static native byte[] nativeScan(
+      IcingSearchEngine instance, byte[] scanSpecBytes, byte[] getResultSpecBytes);
+
+  private static native byte[] nativeGetNextScanPage(
+      IcingSearchEngine instance, long nextPageToken);
+
+  private static native void nativeInvalidateScanToken(
+      IcingSearchEngine instance, long nextPageToken);
+
   private static native byte[] nativeDelete(
       IcingSearchEngine instance, String namespace, String uri);
 
@@ -592,11 +761,16 @@ public class IcingSearchEngine implements Closeable {
   private static native byte[] nativeDeleteBySchemaType(
       IcingSearchEngine instance, String schemaType);
 
+  private static native byte[] nativeDeleteByUriPrefix(
+      IcingSearchEngine instance, String namespace, String uriPrefix);
+
   private static native byte[] nativeDeleteByQuery(
       IcingSearchEngine instance, byte[] searchSpecBytes);
 
   private static native byte[] nativePersistToDisk(IcingSearchEngine instance, int persistType);
 
+  private static native byte[] nativeTrimMemory(IcingSearchEngine instance, int trimMemoryLevel);
+
   private static native byte[] nativeOptimize(IcingSearchEngine instance);
 
   private static native byte[] nativeGetOptimizeInfo(IcingSearchEngine instance);
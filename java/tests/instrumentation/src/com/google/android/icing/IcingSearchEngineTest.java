@@ -17,12 +17,15 @@ package com.google.android.icing;
 import static com.google.common.truth.Truth.assertThat;
 import static com.google.common.truth.Truth.assertWithMessage;
 
+import com.google.android.icing.proto.BatchGetResultProto;
 import com.google.android.icing.proto.DeleteByNamespaceResultProto;
 import com.google.android.icing.proto.DeleteByQueryResultProto;
 import com.google.android.icing.proto.DeleteBySchemaTypeResultProto;
+import com.google.android.icing.proto.DeleteByUriPrefixResultProto;
 import com.google.android.icing.proto.DeleteResultProto;
 import com.google.android.icing.proto.DocumentProto;
 import com.google.android.icing.proto.GetAllNamespacesResultProto;
+import com.google.android.icing.proto.GetByUriPrefixResultProto;
 import com.google.android.icing.proto.GetOptimizeInfoResultProto;
 import com.google.android.icing.proto.GetResultProto;
 import com.google.android.icing.proto.GetResultSpecProto;
@@ -39,6 +42,8 @@ import com.google.android.icing.proto.PutResultProto;
 import com.google.android.icing.proto.ReportUsageResultProto;
 import com.google.android.icing.proto.ResetResultProto;
 import com.google.android.icing.proto.ResultSpecProto;
+import com.google.android.icing.proto.ScanResultProto;
+import com.google.android.icing.proto.ScanSpecProto;
 import com.google.android.icing.proto.SchemaProto;
 import com.google.android.icing.proto.SchemaTypeConfigProto;
 import com.google.android.icing.proto.ScoringSpecProto;
@@ -175,6 +180,68 @@ public final class IcingSearchEngineTest {
     assertThat(getResultProto.getDocument()).isEqualTo(emailDocument);
   }
 
+  @Test
+  public void testBatchGet() throws Exception {
+    assertStatusOk(icingSearchEngine.initialize().getStatus());
+
+    SchemaTypeConfigProto emailTypeConfig = createEmailTypeConfig();
+    SchemaProto schema = SchemaProto.newBuilder().addTypes(emailTypeConfig).build();
+    assertThat(
+            icingSearchEngine
+                .setSchema(schema, /*ignoreErrorsAndDeleteDocuments=*/ false)
+                .getStatus()
+                .getCode())
+        .isEqualTo(StatusProto.Code.OK);
+
+    DocumentProto emailDocument1 = createEmailDocument("namespace", "uri1");
+    DocumentProto emailDocument2 = createEmailDocument("namespace", "uri2");
+    assertStatusOk(icingSearchEngine.put(emailDocument1).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument2).getStatus());
+
+    BatchGetResultProto batchGetResultProto =
+        icingSearchEngine.batchGet(
+            new String[] {"namespace", "namespace", "namespace"},
+            new String[] {"uri2", "nonexistent", "uri1"},
+            GetResultSpecProto.getDefaultInstance());
+    assertStatusOk(batchGetResultProto.getStatus());
+    assertThat(batchGetResultProto.getResultsCount()).isEqualTo(3);
+    assertStatusOk(batchGetResultProto.getResults(0).getStatus());
+    assertThat(batchGetResultProto.getResults(0).getDocument()).isEqualTo(emailDocument2);
+    assertThat(batchGetResultProto.getResults(1).getStatus().getCode())
+        .isEqualTo(StatusProto.Code.NOT_FOUND);
+    assertStatusOk(batchGetResultProto.getResults(2).getStatus());
+    assertThat(batchGetResultProto.getResults(2).getDocument()).isEqualTo(emailDocument1);
+  }
+
+  @Test
+  public void testGetByUriPrefix() throws Exception {
+    assertStatusOk(icingSearchEngine.initialize().getStatus());
+
+    SchemaTypeConfigProto emailTypeConfig = createEmailTypeConfig();
+    SchemaProto schema = SchemaProto.newBuilder().addTypes(emailTypeConfig).build();
+    assertThat(
+            icingSearchEngine
+                .setSchema(schema, /*ignoreErrorsAndDeleteDocuments=*/ false)
+                .getStatus()
+                .getCode())
+        .isEqualTo(StatusProto.Code.OK);
+
+    DocumentProto emailDocument1 = createEmailDocument("namespace", "thread/1/uri1");
+    DocumentProto emailDocument2 = createEmailDocument("namespace", "thread/1/uri2");
+    DocumentProto emailDocument3 = createEmailDocument("namespace", "thread/2/uri1");
+    assertStatusOk(icingSearchEngine.put(emailDocument2).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument3).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument1).getStatus());
+
+    GetByUriPrefixResultProto getByUriPrefixResultProto =
+        icingSearchEngine.getByUriPrefix(
+            "namespace", "thread/1/", GetResultSpecProto.getDefaultInstance());
+    assertStatusOk(getByUriPrefixResultProto.getStatus());
+    assertThat(getByUriPrefixResultProto.getDocumentsList())
+        .containsExactly(emailDocument1, emailDocument2)
+        .inOrder();
+  }
+
   @Test
   public void testSearch() throws Exception {
     assertStatusOk(icingSearchEngine.initialize().getStatus());
@@ -269,6 +336,44 @@ public final class IcingSearchEngineTest {
     assertThat(searchResultProto.getResultsCount()).isEqualTo(0);
   }
 
+  @Test
+  public void testScan() throws Exception {
+    assertStatusOk(icingSearchEngine.initialize().getStatus());
+
+    SchemaTypeConfigProto emailTypeConfig = createEmailTypeConfig();
+    SchemaProto schema = SchemaProto.newBuilder().addTypes(emailTypeConfig).build();
+    assertThat(
+            icingSearchEngine
+                .setSchema(schema, /*ignoreErrorsAndDeleteDocuments=*/ false)
+                .getStatus()
+                .getCode())
+        .isEqualTo(StatusProto.Code.OK);
+
+    DocumentProto emailDocument1 = createEmailDocument("namespace", "uri1");
+    DocumentProto emailDocument2 = createEmailDocument("namespace", "uri2");
+    DocumentProto emailDocument3 = createEmailDocument("other_namespace", "uri3");
+    assertStatusOk(icingSearchEngine.put(emailDocument1).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument2).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument3).getStatus());
+
+    ScanSpecProto scanSpec =
+        ScanSpecProto.newBuilder().addNamespaceFilters("namespace").setNumPerPage(1).build();
+    ScanResultProto scanResultProto =
+        icingSearchEngine.scan(scanSpec, GetResultSpecProto.getDefaultInstance());
+    assertStatusOk(scanResultProto.getStatus());
+    assertThat(scanResultProto.getDocumentsList()).containsExactly(emailDocument1);
+    assertThat(scanResultProto.getNextPageToken()).isNotEqualTo(0);
+
+    scanResultProto = icingSearchEngine.getNextScanPage(scanResultProto.getNextPageToken());
+    assertStatusOk(scanResultProto.getStatus());
+    assertThat(scanResultProto.getDocumentsList()).containsExactly(emailDocument2);
+
+    icingSearchEngine.invalidateScanToken(scanResultProto.getNextPageToken());
+    scanResultProto = icingSearchEngine.getNextScanPage(scanResultProto.getNextPageToken());
+    assertStatusOk(scanResultProto.getStatus());
+    assertThat(scanResultProto.getDocumentsCount()).isEqualTo(0);
+  }
+
   @Test
   public void testDelete() throws Exception {
     assertStatusOk(icingSearchEngine.initialize().getStatus());
@@ -343,6 +448,38 @@ public final class IcingSearchEngineTest {
     assertThat(getResultProto.getStatus().getCode()).isEqualTo(StatusProto.Code.NOT_FOUND);
   }
 
+  @Test
+  public void testDeleteByUriPrefix() throws Exception {
+    assertStatusOk(icingSearchEngine.initialize().getStatus());
+
+    SchemaTypeConfigProto emailTypeConfig = createEmailTypeConfig();
+    SchemaProto schema = SchemaProto.newBuilder().addTypes(emailTypeConfig).build();
+    assertThat(
+            icingSearchEngine
+                .setSchema(schema, /*ignoreErrorsAndDeleteDocuments=*/ false)
+                .getStatus()
+                .getCode())
+        .isEqualTo(StatusProto.Code.OK);
+
+    DocumentProto emailDocument1 = createEmailDocument("namespace", "thread/1/uri1");
+    DocumentProto emailDocument2 = createEmailDocument("namespace", "thread/2/uri1");
+    assertStatusOk(icingSearchEngine.put(emailDocument1).getStatus());
+    assertStatusOk(icingSearchEngine.put(emailDocument2).getStatus());
+
+    DeleteByUriPrefixResultProto deleteByUriPrefixResultProto =
+        icingSearchEngine.deleteByUriPrefix("namespace", "thread/1/");
+    assertStatusOk(deleteByUriPrefixResultProto.getStatus());
+
+    GetResultProto getResultProto =
+        icingSearchEngine.get(
+            "namespace", "thread/1/uri1", GetResultSpecProto.getDefaultInstance());
+    assertThat(getResultProto.getStatus().getCode()).isEqualTo(StatusProto.Code.NOT_FOUND);
+    getResultProto =
+        icingSearchEngine.get(
+            "namespace", "thread/2/uri1", GetResultSpecProto.getDefaultInstance());
+    assertStatusOk(getResultProto.getStatus());
+  }
+
   @Test
   public void testDeleteByQuery() throws Exception {
     assertStatusOk(icingSearchEngine.initialize().getStatus());